@@ -0,0 +1,204 @@
+#include <windows.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../MetroGame/Common/AssetPackFormat.h"
+#include "../MetroGame/Common/DDSParser.h"
+
+using namespace std;
+using namespace DX::AssetPackFormat;
+
+struct Asset
+{
+	wstring Name;		// Normalized, relative to the input folder
+	wstring Path;
+	vector<uint8_t> Data;
+	uint32_t RawSize;
+	uint32_t Compression;
+};
+
+vector<Asset> Assets;
+vector<wstring> StoredExtensions;
+
+// Compressed data is kept only when it saves at least this fraction
+const double MinSaving = 0.125;
+
+void CollectFiles(const wstring& root, const wstring& relative)
+{
+	WIN32_FIND_DATAW findData;
+	HANDLE find = FindFirstFileW((root + relative + L"*").c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+	do
+	{
+		wstring name = findData.cFileName;
+		if (name == L"." || name == L"..")
+			continue;
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			CollectFiles(root, relative + name + L"\\");
+			continue;
+		}
+		Asset asset;
+		asset.Name = NormalizeName(relative + name);
+		asset.Path = root + relative + name;
+		asset.RawSize = 0;
+		asset.Compression = Stored;
+		Assets.push_back(asset);
+	} while (FindNextFileW(find, &findData));
+	FindClose(find);
+}
+
+wstring GetExtension(const wstring& name)
+{
+	size_t dot = name.find_last_of(L'.');
+	return dot == wstring::npos ? wstring() : name.substr(dot + 1);
+}
+
+bool IsStoredExtension(const wstring& name)
+{
+	wstring extension = GetExtension(name);
+	return !extension.empty() && find(StoredExtensions.begin(), StoredExtensions.end(), extension) != StoredExtensions.end();
+}
+
+bool LoadAsset(Asset& asset)
+{
+	ifstream fin(asset.Path, ios::binary | ios::ate);
+	if (!fin)
+		return false;
+	size_t size = (size_t)fin.tellg();
+	if (size > 0xffffffffull)
+		return false;
+	vector<uint8_t> raw(size);
+	fin.seekg(0);
+	fin.read((char*)raw.data(), size);
+	asset.RawSize = (uint32_t)size;
+
+	// Catch textures the engine would reject at load time
+	DX::DDSTextureDesc desc;
+	if (GetExtension(asset.Name) == L"dds" && DX::ParseDDSHeader(raw.data(), size, desc) != DX::DDSResult::Ok)
+		wcout << L"Warning: " << asset.Name << L" is not a valid DDS texture" << endl;
+
+	if (size > 0 && !IsStoredExtension(asset.Name))
+	{
+		vector<uint8_t> compressed(LZ4CompressBound(size));
+		size_t compressedSize = LZ4Compress(raw.data(), size, compressed.data(), compressed.size());
+		if (compressedSize > 0 && compressedSize <= size - (size_t)(size * MinSaving))
+		{
+			compressed.resize(compressedSize);
+			asset.Data.swap(compressed);
+			asset.Compression = LZ4;
+			return true;
+		}
+	}
+	asset.Data.swap(raw);
+	asset.Compression = Stored;
+	return true;
+}
+
+void WritePadding(ofstream& fout, uint64_t& offset, uint64_t alignment)
+{
+	static const char zeros[EntryAlignment] = {};
+	uint64_t padding = (alignment - offset % alignment) % alignment;
+	fout.write(zeros, (streamsize)padding);
+	offset += padding;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	if (argc < 3)
+	{
+		wcout << L"Usage: AssetPacker <input folder> <output pack> [-store ext,ext,...]" << endl;
+		wcout << L"Files with a -store extension are never compressed, so they are read without a copy." << endl;
+		return -1;
+	}
+
+	wstring root = argv[1];
+	if (root.back() != L'\\' && root.back() != L'/')
+		root += L"\\";
+	wstring output = argv[2];
+	if (argc >= 5 && wstring(argv[3]) == L"-store")
+	{
+		wstring list = NormalizeName(argv[4]);
+		size_t start = 0;
+		while (start <= list.size())
+		{
+			size_t comma = list.find(L',', start);
+			if (comma == wstring::npos)
+				comma = list.size();
+			if (comma > start)
+				StoredExtensions.push_back(list.substr(start, comma - start));
+			start = comma + 1;
+		}
+	}
+
+	cout << "Read data ..." << endl;
+	CollectFiles(root, L"");
+	uint64_t rawBytes = 0;
+	for (auto& asset : Assets)
+	{
+		if (!LoadAsset(asset))
+		{
+			wcout << L"Cannot read " << asset.Path << endl;
+			return -1;
+		}
+		rawBytes += asset.RawSize;
+	}
+
+	// The index is sorted by name hash, the runtime binary searches it
+	vector<PackEntry> entries(Assets.size());
+	vector<wchar_t> names;
+	for (size_t i = 0; i < Assets.size(); ++i)
+	{
+		PackEntry& entry = entries[i];
+		entry.NameHash = HashName(Assets[i].Name.c_str(), Assets[i].Name.size());
+		entry.Size = (uint32_t)Assets[i].Data.size();
+		entry.RawSize = Assets[i].RawSize;
+		entry.Compression = Assets[i].Compression;
+		entry.NameOffset = (uint32_t)names.size();
+		names.insert(names.end(), Assets[i].Name.begin(), Assets[i].Name.end());
+		names.push_back(0);
+	}
+
+	cout << "Write data ..." << endl;
+	ofstream fout(output, ios::binary);
+	if (!fout)
+	{
+		wcout << L"Cannot create " << output << endl;
+		return -1;
+	}
+	PackHeader header = {};
+	fout.write((const char*)&header, sizeof(header));
+	uint64_t offset = sizeof(header);
+	for (size_t i = 0; i < Assets.size(); ++i)
+	{
+		WritePadding(fout, offset, EntryAlignment);
+		entries[i].Offset = offset;
+		fout.write((const char*)Assets[i].Data.data(), Assets[i].Data.size());
+		offset += Assets[i].Data.size();
+	}
+	sort(entries.begin(), entries.end(), [](const PackEntry& a, const PackEntry& b) { return a.NameHash < b.NameHash; });
+
+	WritePadding(fout, offset, sizeof(uint64_t));
+	header.Magic = Magic;
+	header.Version = Version;
+	header.EntryCount = (uint32_t)entries.size();
+	header.EntryAlignment = EntryAlignment;
+	header.IndexOffset = offset;
+	fout.write((const char*)entries.data(), entries.size() * sizeof(PackEntry));
+	offset += entries.size() * sizeof(PackEntry);
+	header.NamesOffset = offset;
+	fout.write((const char*)names.data(), names.size() * sizeof(wchar_t));
+	offset += names.size() * sizeof(wchar_t);
+	fout.seekp(0);
+	fout.write((const char*)&header, sizeof(header));
+	fout.close();
+
+	size_t compressedCount = count_if(Assets.begin(), Assets.end(), [](const Asset& a) { return a.Compression != Stored; });
+	cout << "Entries: " << Assets.size() << " (" << compressedCount << " compressed)" << endl;
+	cout << "Raw bytes: " << rawBytes << ", pack bytes: " << offset << endl;
+
+	return 0;
+}
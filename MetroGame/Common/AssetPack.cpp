@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "AssetPack.h"
+#include <algorithm>
+
+using namespace DX;
+using namespace DX::AssetPackFormat;
+using namespace Microsoft::WRL;
+
+AssetPack* AssetPack::m_instance = nullptr;
+
+AssetPack::AssetPack() :
+	m_mapping(nullptr), m_view(nullptr), m_size(0), m_header(nullptr), m_entries(nullptr), m_names(nullptr), m_nameCount(0)
+{
+	if (m_instance == nullptr)
+		m_instance = this;
+	else
+		throw ref new Platform::FailureException("Cannot create more than one AssetPack!");
+}
+
+AssetPack::~AssetPack()
+{
+	Close();
+	m_instance = nullptr;
+}
+
+bool AssetPack::Open(Platform::String^ filename)
+{
+	Close();
+
+	Platform::String^ path = Windows::ApplicationModel::Package::Current->InstalledLocation->Path + "\\" + filename;
+	CREATEFILE2_EXTENDED_PARAMETERS extendedParams = { 0 };
+	extendedParams.dwSize = sizeof(CREATEFILE2_EXTENDED_PARAMETERS);
+	extendedParams.dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
+	extendedParams.dwFileFlags = FILE_FLAG_RANDOM_ACCESS;
+	extendedParams.dwSecurityQosFlags = SECURITY_ANONYMOUS;
+	extendedParams.lpSecurityAttributes = nullptr;
+	extendedParams.hTemplateFile = nullptr;
+
+	m_file.Attach(CreateFile2(path->Data(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, &extendedParams));
+	if (!m_file.IsValid())
+	{
+		DWORD error = GetLastError();
+		if (error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND)
+			return false;
+		throw ref new Platform::FailureException("Cannot open asset pack " + filename);
+	}
+
+	FILE_STANDARD_INFO fileInfo = { 0 };
+	if (!GetFileInformationByHandleEx(m_file.Get(), FileStandardInfo, &fileInfo, sizeof(fileInfo)))
+		throw ref new Platform::FailureException("Cannot open asset pack " + filename);
+	m_size = (size_t)fileInfo.EndOfFile.QuadPart;
+	if (m_size < sizeof(PackHeader))
+		throw ref new Platform::FailureException("Invalid asset pack " + filename);
+
+	m_mapping = CreateFileMappingFromApp(m_file.Get(), nullptr, PAGE_READONLY, 0, nullptr);
+	if (m_mapping == nullptr)
+		throw ref new Platform::FailureException("Cannot map asset pack " + filename);
+	m_view = (const byte*)MapViewOfFileFromApp(m_mapping, FILE_MAP_READ, 0, 0);
+	if (m_view == nullptr)
+	{
+		Close();
+		throw ref new Platform::FailureException("Cannot map asset pack " + filename);
+	}
+
+	// Validate the whole index once, lookups trust it afterwards
+	m_header = (const PackHeader*)m_view;
+	bool valid = m_header->Magic == Magic && m_header->Version == Version &&
+		m_header->IndexOffset <= m_size && m_header->NamesOffset <= m_size &&
+		(m_size - m_header->IndexOffset) / sizeof(PackEntry) >= m_header->EntryCount &&
+		m_header->NamesOffset % sizeof(wchar_t) == 0;
+	if (valid)
+	{
+		m_entries = (const PackEntry*)(m_view + m_header->IndexOffset);
+		m_names = (const wchar_t*)(m_view + m_header->NamesOffset);
+		m_nameCount = (m_size - m_header->NamesOffset) / sizeof(wchar_t);
+		valid = m_nameCount > 0 && m_names[m_nameCount - 1] == 0;
+		for (UINT i = 0; valid && i < m_header->EntryCount; ++i)
+		{
+			const PackEntry& entry = m_entries[i];
+			valid = entry.Offset <= m_size && entry.Size <= m_size - entry.Offset && entry.NameOffset < m_nameCount &&
+				(entry.Compression == Stored ? entry.Size == entry.RawSize : entry.Compression == LZ4) &&
+				(i == 0 || m_entries[i - 1].NameHash <= entry.NameHash);
+		}
+	}
+	if (!valid)
+	{
+		Close();
+		throw ref new Platform::FailureException("Invalid asset pack " + filename);
+	}
+	return true;
+}
+
+void AssetPack::Close()
+{
+	if (m_view != nullptr)
+		UnmapViewOfFile(m_view);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	m_file.Close();
+	m_mapping = nullptr;
+	m_view = nullptr;
+	m_size = 0;
+	m_header = nullptr;
+	m_entries = nullptr;
+	m_names = nullptr;
+	m_nameCount = 0;
+}
+
+const PackEntry* AssetPack::Find(const std::wstring& name)const
+{
+	if (!IsOpen())
+		return nullptr;
+
+	std::wstring normalized = NormalizeName(name);
+	uint64_t hash = HashName(normalized.c_str(), normalized.size());
+	const PackEntry* end = m_entries + m_header->EntryCount;
+	const PackEntry* it = std::lower_bound(m_entries, end, hash, [](const PackEntry& entry, uint64_t h) { return entry.NameHash < h; });
+	for (; it != end && it->NameHash == hash; ++it)
+	{
+		if (normalized.compare(m_names + it->NameOffset) == 0)
+			return it;
+	}
+	return nullptr;
+}
+
+AssetSpan AssetPack::GetSpan(const PackEntry& entry)const
+{
+	if (!IsStored(entry))
+		throw ref new Platform::FailureException("Compressed asset pack entries have no span!");
+	AssetSpan span = { m_view + entry.Offset, entry.Size };
+	return span;
+}
+
+void AssetPack::Read(const PackEntry& entry, byte* dst)const
+{
+	const byte* src = m_view + entry.Offset;
+	if (IsStored(entry))
+	{
+		memcpy(dst, src, entry.Size);
+	}
+	else if (!LZ4Decompress(src, entry.Size, dst, entry.RawSize))
+	{
+		throw ref new Platform::FailureException("Corrupt asset pack entry!");
+	}
+}
+
+std::shared_ptr<std::vector<byte>> AssetPack::Read(const PackEntry& entry)const
+{
+	std::shared_ptr<std::vector<byte>> data = std::make_shared<std::vector<byte>>(entry.RawSize);
+	Read(entry, data->data());
+	return data;
+}
+
+concurrency::task<std::shared_ptr<std::vector<byte>>> AssetPack::ReadAsync(const PackEntry& entry)const
+{
+	const PackEntry* e = &entry;
+	return concurrency::create_task([this, e]()
+	{
+		return Read(*e);
+	});
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <ppltasks.h>
+#include <memory>
+#include <vector>
+#include "AssetPackFormat.h"
+
+// Read only view of an asset pack built by the AssetPacker tool. The pack is memory mapped
+// once, so reading an asset is an index lookup instead of a file open. Stored entries are
+// handed out as spans into the mapping without a copy, compressed entries are decompressed
+// into a buffer, by ReadAsync on a worker thread. The mounted pack is a singleton consulted
+// by BasicReaderWriter and DX::ReadData before the loose files.
+
+namespace DX
+{
+	struct AssetSpan
+	{
+		const byte* Data;
+		size_t Size;
+	};
+
+	class AssetPack
+	{
+	public:
+		AssetPack();
+		~AssetPack();
+		// Singleton
+		static AssetPack* Instance() { return m_instance; }
+
+		// filename is relative to the installed location. Returns false when there is no such
+		// file, throws when the file is not a valid pack.
+		bool Open(Platform::String^ filename);
+		void Close();
+		bool IsOpen()const { return m_view != nullptr; }
+
+		// nullptr when the pack has no such asset.
+		const AssetPackFormat::PackEntry* Find(const std::wstring& name)const;
+		UINT GetEntryCount()const { return m_header ? m_header->EntryCount : 0; }
+		bool IsStored(const AssetPackFormat::PackEntry& entry)const { return entry.Compression == AssetPackFormat::Stored; }
+
+		// Zero copy view of a stored entry, valid while the pack is open.
+		AssetSpan GetSpan(const AssetPackFormat::PackEntry& entry)const;
+		// Copy or decompress an entry into dst, which holds entry.RawSize bytes.
+		void Read(const AssetPackFormat::PackEntry& entry, byte* dst)const;
+		std::shared_ptr<std::vector<byte>> Read(const AssetPackFormat::PackEntry& entry)const;
+		// Same as Read on a worker thread.
+		concurrency::task<std::shared_ptr<std::vector<byte>>> ReadAsync(const AssetPackFormat::PackEntry& entry)const;
+
+	private:
+		Microsoft::WRL::Wrappers::FileHandle m_file;
+		HANDLE m_mapping;
+		const byte* m_view;
+		size_t m_size;
+		const AssetPackFormat::PackHeader* m_header;
+		const AssetPackFormat::PackEntry* m_entries;
+		const wchar_t* m_names;
+		size_t m_nameCount;		// Characters in the name table
+
+		static AssetPack* m_instance;
+	};
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// On disk layout of an asset pack, shared by the runtime reader (AssetPack) and the
+// AssetPacker tool, so it only depends on the standard library.
+//
+//   PackHeader | entry data, each entry aligned to EntryAlignment | PackEntry index | names
+//
+// The index is sorted by NameHash, the hash of the normalized name (lower case, '\' as
+// separator). Names are stored as null terminated UTF-16 strings to tell hash collisions
+// apart. An entry is stored as is or compressed with the LZ4 block format below.
+
+namespace DX
+{
+	namespace AssetPackFormat
+	{
+		const uint32_t Magic = 0x4B41504D;		// "MPAK"
+		const uint32_t Version = 1;
+		const uint32_t EntryAlignment = 64;
+
+		enum Compression : uint32_t
+		{
+			Stored = 0,
+			LZ4 = 1
+		};
+
+		struct PackHeader
+		{
+			uint32_t Magic;
+			uint32_t Version;
+			uint32_t EntryCount;
+			uint32_t EntryAlignment;
+			uint64_t IndexOffset;
+			uint64_t NamesOffset;
+		};
+
+		struct PackEntry
+		{
+			uint64_t NameHash;
+			uint64_t Offset;
+			uint32_t Size;			// Bytes in the pack
+			uint32_t RawSize;		// Bytes after decompression
+			uint32_t Compression;
+			uint32_t NameOffset;	// In characters from NamesOffset
+		};
+
+		inline std::wstring NormalizeName(const std::wstring& name)
+		{
+			std::wstring normalized(name);
+			for (auto& c : normalized)
+			{
+				if (c == L'/')
+					c = L'\\';
+				else if (c >= L'A' && c <= L'Z')
+					c = c - L'A' + L'a';
+			}
+			return normalized;
+		}
+
+		// FNV-1a over the UTF-16 code units of a normalized name.
+		inline uint64_t HashName(const wchar_t* name, size_t length)
+		{
+			uint64_t hash = 14695981039346656037ull;
+			for (size_t i = 0; i < length; ++i)
+				hash = (hash ^ (uint16_t)name[i]) * 1099511628211ull;
+			return hash;
+		}
+
+		// LZ4 block format: sequences of literals followed by a match of at least 4 bytes
+		// within the last 64 KB. The last 5 bytes are always literals.
+		inline size_t LZ4CompressBound(size_t size)
+		{
+			return size + size / 255 + 16;
+		}
+
+		namespace Detail
+		{
+			inline bool WriteLength(size_t length, uint8_t* dst, size_t capacity, size_t& op)
+			{
+				while (length >= 255)
+				{
+					if (op >= capacity)
+						return false;
+					dst[op++] = 255;
+					length -= 255;
+				}
+				if (op >= capacity)
+					return false;
+				dst[op++] = (uint8_t)length;
+				return true;
+			}
+
+			inline bool WriteSequence(const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength,
+				uint8_t* dst, size_t capacity, size_t& op)
+			{
+				if (op >= capacity)
+					return false;
+				size_t token = op++;
+				size_t matchCode = matchLength ? matchLength - 4 : 0;
+				dst[token] = (uint8_t)(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+				if (literalLength >= 15 && !WriteLength(literalLength - 15, dst, capacity, op))
+					return false;
+				if (op + literalLength > capacity)
+					return false;
+				memcpy(dst + op, literals, literalLength);
+				op += literalLength;
+				if (!matchLength)
+					return true;
+				if (op + 2 > capacity)
+					return false;
+				dst[op++] = (uint8_t)(offset & 0xff);
+				dst[op++] = (uint8_t)(offset >> 8);
+				return matchCode < 15 || WriteLength(matchCode - 15, dst, capacity, op);
+			}
+		}
+
+		// Returns the compressed size, 0 when the result does not fit capacity.
+		inline size_t LZ4Compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity)
+		{
+			const uint32_t HashBits = 16;
+			const size_t MinMatch = 4;
+			const size_t LastLiterals = 5;
+			const size_t MatchLimit = 12;
+			const size_t MaxOffset = 65535;
+			const uint32_t Empty = 0xffffffff;
+
+			std::vector<uint32_t> table((size_t)1 << HashBits, Empty);
+			size_t op = 0;
+			size_t anchor = 0;
+			size_t ip = 0;
+			if (size > MatchLimit)
+			{
+				size_t limit = size - MatchLimit;
+				size_t matchEnd = size - LastLiterals;
+				while (ip < limit)
+				{
+					uint32_t sequence;
+					memcpy(&sequence, src + ip, 4);
+					uint32_t h = (sequence * 2654435761u) >> (32 - HashBits);
+					uint32_t ref = table[h];
+					table[h] = (uint32_t)ip;
+					if (ref == Empty || ip - ref > MaxOffset || memcmp(src + ref, src + ip, 4) != 0)
+					{
+						++ip;
+						continue;
+					}
+
+					size_t length = MinMatch;
+					while (ip + length < matchEnd && src[ref + length] == src[ip + length])
+						++length;
+					if (!Detail::WriteSequence(src + anchor, ip - anchor, ip - ref, length, dst, capacity, op))
+						return 0;
+					ip += length;
+					anchor = ip;
+				}
+			}
+			if (!Detail::WriteSequence(src + anchor, size - anchor, 0, 0, dst, capacity, op))
+				return 0;
+			return op;
+		}
+
+		// Returns false on malformed input or when the output is not exactly size bytes.
+		inline bool LZ4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t size)
+		{
+			size_t ip = 0;
+			size_t op = 0;
+			while (ip < srcSize)
+			{
+				uint8_t token = src[ip++];
+				size_t literalLength = token >> 4;
+				if (literalLength == 15)
+				{
+					uint8_t b;
+					do
+					{
+						if (ip >= srcSize)
+							return false;
+						b = src[ip++];
+						literalLength += b;
+					} while (b == 255);
+				}
+				if (literalLength > srcSize - ip || literalLength > size - op)
+					return false;
+				memcpy(dst + op, src + ip, literalLength);
+				ip += literalLength;
+				op += literalLength;
+				if (ip == srcSize)
+					break;
+
+				if (srcSize - ip < 2)
+					return false;
+				size_t offset = src[ip] | ((size_t)src[ip + 1] << 8);
+				ip += 2;
+				if (offset == 0 || offset > op)
+					return false;
+				size_t matchLength = token & 15;
+				if (matchLength == 15)
+				{
+					uint8_t b;
+					do
+					{
+						if (ip >= srcSize)
+							return false;
+						b = src[ip++];
+						matchLength += b;
+					} while (b == 255);
+				}
+				matchLength += 4;
+				if (matchLength > size - op)
+					return false;
+				// Matches may overlap their own output
+				const uint8_t* match = dst + op - offset;
+				for (size_t i = 0; i < matchLength; ++i)
+					dst[op + i] = match[i];
+				op += matchLength;
+			}
+			return op == size;
+		}
+	}
+}
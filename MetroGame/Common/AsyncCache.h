@@ -0,0 +1,232 @@
+#pragma once
+
+#include <ppltasks.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Name to resource table shared by the resource managers. Every name is loaded once: the
+// first request starts the load, requests made while it is in flight join the same task and
+// later requests get the stored result. Names are normalized (case and path separators) and
+// hashed to pick one of several stripes, each with its own lock, so lookups of different
+// names rarely contend. A failed load is removed so that a later request retries it.
+// Entries carry the generation they were started in. Clear starts a new one, so loads still
+// in flight hand their result to their waiters but never store it.
+// Integer keys are used as they are, for resources that are looked up by a precomputed key.
+
+namespace DX
+{
+	struct AsyncCacheStats
+	{
+		UINT Hits;		// Served from a finished load
+		UINT Joins;		// Joined a load in flight
+		UINT Loads;		// Loads started
+		UINT Failures;
+	};
+
+	template<typename T, typename Key = std::wstring>
+	class AsyncCache
+	{
+	public:
+		static const UINT StripeCount = 16;
+
+		AsyncCache() : m_generation(0), m_hits(0), m_joins(0), m_loads(0), m_failures(0) {}
+
+		// Return the load of key, calling load only when no request for key was made before.
+		concurrency::task<T> GetOrLoadAsync(const Key& key, const std::function<concurrency::task<T>()>& load)
+		{
+			Key name = Normalize(key);
+			Stripe& stripe = GetStripe(name);
+			concurrency::task_completion_event<T> done;
+			UINT generation;
+			{
+				std::lock_guard<std::mutex> lock(stripe.Lock);
+				auto it = stripe.Entries.find(name);
+				if (it != stripe.Entries.end())
+				{
+					if (it->second.Ready)
+					{
+						++m_hits;
+						return concurrency::task_from_result(it->second.Value);
+					}
+					++m_joins;
+					return it->second.Task;
+				}
+				generation = m_generation;
+				Entry& entry = stripe.Entries[name];
+				entry.Task = concurrency::task<T>(done);
+				entry.Ready = false;
+				entry.Generation = generation;
+				++m_loads;
+			}
+
+			// Started outside the lock, joiners wait on the completion event
+			concurrency::task<T> loading;
+			try
+			{
+				loading = load();
+			}
+			catch (...)
+			{
+				loading = concurrency::task_from_exception<T>(std::current_exception());
+			}
+			loading.then([this, name, done, generation](concurrency::task<T> t)
+			{
+				Stripe& stripe = GetStripe(name);
+				try
+				{
+					T value = t.get();
+					{
+						// A synchronous load may have finished first, its result was handed out already.
+						// After a Clear the entry is gone or belongs to a newer load, it stays as is.
+						std::lock_guard<std::mutex> lock(stripe.Lock);
+						auto it = stripe.Entries.find(name);
+						if (it != stripe.Entries.end() && it->second.Generation == generation)
+						{
+							Entry& entry = it->second;
+							if (entry.Ready)
+								value = entry.Value;
+							entry.Value = value;
+							entry.Ready = true;
+						}
+					}
+					done.set(value);
+				}
+				catch (...)
+				{
+					{
+						std::lock_guard<std::mutex> lock(stripe.Lock);
+						auto it = stripe.Entries.find(name);
+						if (it != stripe.Entries.end() && !it->second.Ready && it->second.Generation == generation)
+							stripe.Entries.erase(it);
+					}
+					++m_failures;
+					done.set_exception(std::current_exception());
+				}
+			});
+			return concurrency::task<T>(done);
+		}
+
+		// Blocking variant for the synchronous getters. A load in flight is not waited for, since
+		// that would block the UI thread; key is loaded again and the first result is kept.
+		T GetOrLoad(const Key& key, const std::function<T()>& load)
+		{
+			Key name = Normalize(key);
+			Stripe& stripe = GetStripe(name);
+			UINT generation;
+			{
+				std::lock_guard<std::mutex> lock(stripe.Lock);
+				generation = m_generation;
+				auto it = stripe.Entries.find(name);
+				if (it != stripe.Entries.end() && it->second.Ready)
+				{
+					++m_hits;
+					return it->second.Value;
+				}
+			}
+
+			++m_loads;
+			T value = load();
+			std::lock_guard<std::mutex> lock(stripe.Lock);
+			// Cleared while loading, the result is not stored
+			if (m_generation != generation)
+				return value;
+			auto it = stripe.Entries.find(name);
+			if (it != stripe.Entries.end())
+			{
+				if (it->second.Ready)
+					return it->second.Value;
+				// A load in flight keeps its task, its waiters get its own result
+				it->second.Value = value;
+				it->second.Ready = true;
+				return value;
+			}
+			Entry& entry = stripe.Entries[name];
+			entry.Value = value;
+			entry.Ready = true;
+			entry.Generation = generation;
+			entry.Task = concurrency::task_from_result(value);
+			return value;
+		}
+
+		// Finished loads only.
+		bool TryGet(const Key& key, T& value)
+		{
+			Key name = Normalize(key);
+			Stripe& stripe = GetStripe(name);
+			std::lock_guard<std::mutex> lock(stripe.Lock);
+			auto it = stripe.Entries.find(name);
+			if (it == stripe.Entries.end() || !it->second.Ready)
+				return false;
+			value = it->second.Value;
+			return true;
+		}
+
+		// Drop every entry. Loads in flight still complete their waiters, but their results are
+		// not stored, the next request for the name loads it again.
+		void Clear()
+		{
+			++m_generation;
+			for (UINT i = 0; i < StripeCount; ++i)
+			{
+				std::lock_guard<std::mutex> lock(m_stripes[i].Lock);
+				m_stripes[i].Entries.clear();
+			}
+		}
+
+		AsyncCacheStats GetStats()const
+		{
+			AsyncCacheStats stats = { m_hits, m_joins, m_loads, m_failures };
+			return stats;
+		}
+
+	private:
+		struct Entry
+		{
+			Entry() : Value(), Ready(false), Generation(0) {}
+
+			concurrency::task<T> Task;
+			T Value;
+			bool Ready;
+			UINT Generation;
+		};
+
+		struct Stripe
+		{
+			std::mutex Lock;
+			std::unordered_map<Key, Entry> Entries;
+		};
+
+		static std::wstring Normalize(const std::wstring& key)
+		{
+			std::wstring name(key);
+			for (auto& c : name)
+			{
+				if (c == L'/')
+					c = L'\\';
+				else if (c >= L'A' && c <= L'Z')
+					c = c - L'A' + L'a';
+			}
+			return name;
+		}
+		static UINT Normalize(UINT key)
+		{
+			return key;
+		}
+
+		Stripe& GetStripe(const Key& name)
+		{
+			return m_stripes[std::hash<Key>()(name) % StripeCount];
+		}
+
+	private:
+		Stripe m_stripes[StripeCount];
+		std::atomic<UINT> m_generation;
+		std::atomic<UINT> m_hits;
+		std::atomic<UINT> m_joins;
+		std::atomic<UINT> m_loads;
+		std::atomic<UINT> m_failures;
+	};
+}
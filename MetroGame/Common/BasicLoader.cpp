@@ -8,9 +8,15 @@
 #include "pch.h"
 #include "BasicLoader.h"
 #include <vector>
+#include <algorithm>
 
 #include "DDSTextureLoader.h"
+#include "DDSParser.h"
 #include "DirectXHelper.h"
+#include "AssetPack.h"
+#include "MipGenerator.h"
+#include "MathHelper.h"
+#include <ppl.h>
 #include <collection.h>
 #include <memory>
 
@@ -107,6 +113,88 @@ Platform::String^ BasicLoader::GetExtension(
     return "";
 }
 
+std::unique_ptr<byte[]> BasicLoader::DecodeImage(
+    byte* data,
+    uint32 dataSize,
+    uint32* width,
+    uint32* height
+    )
+{
+    if (m_wicFactory.Get() == nullptr)
+    {
+        // A WIC factory object is required in order to load texture
+        // assets stored in non-DDS formats.  If BasicLoader was not
+        // initialized with one, create one as needed.
+        DX::ThrowIfFailed(
+            CoCreateInstance(
+                CLSID_WICImagingFactory,
+                nullptr,
+                CLSCTX_INPROC_SERVER,
+                IID_PPV_ARGS(&m_wicFactory)
+                )
+            );
+    }
+
+    ComPtr<IWICStream> stream;
+    DX::ThrowIfFailed(
+        m_wicFactory->CreateStream(&stream)
+        );
+
+    DX::ThrowIfFailed(
+        stream->InitializeFromMemory(
+            data,
+            dataSize
+            )
+        );
+
+    ComPtr<IWICBitmapDecoder> bitmapDecoder;
+    DX::ThrowIfFailed(
+        m_wicFactory->CreateDecoderFromStream(
+            stream.Get(),
+            nullptr,
+            WICDecodeMetadataCacheOnDemand,
+            &bitmapDecoder
+            )
+        );
+
+    ComPtr<IWICBitmapFrameDecode> bitmapFrame;
+    DX::ThrowIfFailed(
+        bitmapDecoder->GetFrame(0, &bitmapFrame)
+        );
+
+    ComPtr<IWICFormatConverter> formatConverter;
+    DX::ThrowIfFailed(
+        m_wicFactory->CreateFormatConverter(&formatConverter)
+        );
+
+    DX::ThrowIfFailed(
+        formatConverter->Initialize(
+            bitmapFrame.Get(),
+            GUID_WICPixelFormat32bppPBGRA,
+            WICBitmapDitherTypeNone,
+            nullptr,
+            0.0,
+            WICBitmapPaletteTypeCustom
+            )
+        );
+
+    DX::ThrowIfFailed(
+        bitmapFrame->GetSize(width, height)
+        );
+
+    std::unique_ptr<byte[]> bitmapPixels(new byte[*width * *height * 4]);
+    DX::ThrowIfFailed(
+        formatConverter->CopyPixels(
+            nullptr,
+            *width * 4,
+            *width * *height * 4,
+            bitmapPixels.get()
+            )
+        );
+
+    return bitmapPixels;
+}
+
 void BasicLoader::CreateTexture(
     bool decodeAsDDS,
 	bool needMap,
@@ -153,79 +241,9 @@ void BasicLoader::CreateTexture(
     }
     else
     {
-        if (m_wicFactory.Get() == nullptr)
-        {
-            // A WIC factory object is required in order to load texture
-            // assets stored in non-DDS formats.  If BasicLoader was not
-            // initialized with one, create one as needed.
-            DX::ThrowIfFailed(
-                CoCreateInstance(
-                    CLSID_WICImagingFactory,
-                    nullptr,
-                    CLSCTX_INPROC_SERVER,
-                    IID_PPV_ARGS(&m_wicFactory)
-                    )
-                );
-        }
-
-        ComPtr<IWICStream> stream;
-        DX::ThrowIfFailed(
-            m_wicFactory->CreateStream(&stream)
-            );
-
-        DX::ThrowIfFailed(
-            stream->InitializeFromMemory(
-                data,
-                dataSize
-                )
-            );
-
-        ComPtr<IWICBitmapDecoder> bitmapDecoder;
-        DX::ThrowIfFailed(
-            m_wicFactory->CreateDecoderFromStream(
-                stream.Get(),
-                nullptr,
-                WICDecodeMetadataCacheOnDemand,
-                &bitmapDecoder
-                )
-            );
-
-        ComPtr<IWICBitmapFrameDecode> bitmapFrame;
-        DX::ThrowIfFailed(
-            bitmapDecoder->GetFrame(0, &bitmapFrame)
-            );
-
-        ComPtr<IWICFormatConverter> formatConverter;
-        DX::ThrowIfFailed(
-            m_wicFactory->CreateFormatConverter(&formatConverter)
-            );
-
-        DX::ThrowIfFailed(
-            formatConverter->Initialize(
-                bitmapFrame.Get(),
-                GUID_WICPixelFormat32bppPBGRA,
-                WICBitmapDitherTypeNone,
-                nullptr,
-                0.0,
-                WICBitmapPaletteTypeCustom
-                )
-            );
-
         uint32 width;
         uint32 height;
-        DX::ThrowIfFailed(
-            bitmapFrame->GetSize(&width, &height)
-            );
-
-        std::unique_ptr<byte[]> bitmapPixels(new byte[width * height * 4]);
-        DX::ThrowIfFailed(
-            formatConverter->CopyPixels(
-                nullptr,
-                width * 4,
-                width * height * 4,
-                bitmapPixels.get()
-                )
-            );
+        std::unique_ptr<byte[]> bitmapPixels = DecodeImage(data, dataSize, &width, &height);
 
         D3D11_SUBRESOURCE_DATA initialData;
         ZeroMemory(&initialData, sizeof(initialData));
@@ -396,6 +414,23 @@ void BasicLoader::LoadTexture(
     ID3D11ShaderResourceView** textureView
     )
 {
+    // Stored pack entries are created straight from the mapping
+    const AssetPackFormat::PackEntry* entry = AssetPack::Instance() ? AssetPack::Instance()->Find(filename->Data()) : nullptr;
+    if (entry != nullptr && AssetPack::Instance()->IsStored(*entry))
+    {
+        AssetSpan span = AssetPack::Instance()->GetSpan(*entry);
+        CreateTexture(
+            GetExtension(filename) == "dds",
+            needMap,
+            const_cast<byte*>(span.Data),
+            static_cast<uint32>(span.Size),
+            texture,
+            textureView,
+            filename
+            );
+        return;
+    }
+
     Platform::Array<byte>^ textureData = m_basicReaderWriter->ReadData(filename);
 
     CreateTexture(
@@ -430,39 +465,237 @@ task<void> BasicLoader::LoadTextureAsync(
     });
 }
 
+task<void> BasicLoader::LoadDDSTextureAsync(
+    Platform::String^ filename,
+    size_t maxSize,
+    ID3D11ShaderResourceView** textureView,
+    DDSMipLayout* layout
+    )
+{
+    return m_basicReaderWriter->ReadDataAsync(filename).then([=](const Platform::Array<byte>^ textureData)
+    {
+        DDSMipLayout mipLayout;
+        GetDDSMipLayout(textureData->Data, textureData->Length, mipLayout);
+
+        // Files whose smallest mip is still larger than maxSize load that mip alone
+        size_t topSize = maxSize;
+        if (maxSize)
+        {
+            const DDSMipInfo& top = mipLayout.GetMip(0, mipLayout.GetTopMip(maxSize));
+            topSize = std::max<UINT>(std::max<UINT>(top.Width, top.Height), top.Depth);
+        }
+
+        ComPtr<ID3D11Resource> resource;
+        CreateDDSTextureFromMemory(
+            m_d3dDevice.Get(),
+            false,
+            textureData->Data,
+            textureData->Length,
+            &resource,
+            textureView,
+            topSize
+            );
+
+        SetDebugName(resource.Get(), filename);
+        if (layout != nullptr)
+        {
+            *layout = std::move(mipLayout);
+        }
+    });
+}
+
+concurrency::task<void> BasicLoader::LoadTextureWithMipsAsync(
+    Platform::String^ filename,
+    bool srgb,
+    ID3D11ShaderResourceView** textureView
+    )
+{
+    return m_basicReaderWriter->ReadDataAsync(filename).then([=](const Platform::Array<byte>^ textureData)
+    {
+        MipImage image;
+        DXGI_FORMAT format = DXGI_FORMAT_B8G8R8A8_UNORM;
+        if (GetExtension(filename) == "dds")
+        {
+            DDSTextureDesc desc;
+            if (ParseDDSHeader(textureData->Data, textureData->Length, desc) != DDSResult::Ok)
+            {
+                throw ref new Platform::FailureException("Invalid DDS file!");
+            }
+            if (desc.MipCount > 1 || desc.ArraySize != 1 || desc.Depth != 1 || !CanGenerateMips(desc.Format))
+            {
+                // Files that have their mips already, or a format the CPU path cannot filter
+                CreateTexture(true, false, textureData->Data, textureData->Length, nullptr, textureView, filename);
+                return;
+            }
+            DDSSubresource top = GetDDSSubresource(textureData->Data, desc, 0, 0);
+            image.Initialize(top.Data, top.Width, top.Height, static_cast<UINT>(top.RowPitch));
+            format = desc.Format;
+        }
+        else
+        {
+            uint32 width;
+            uint32 height;
+            std::unique_ptr<byte[]> bitmapPixels = DecodeImage(textureData->Data, textureData->Length, &width, &height);
+            image.Initialize(bitmapPixels.get(), width, height, width * 4);
+        }
+
+        GenerateMips(image, srgb || IsSrgbFormat(format));
+
+        std::vector<D3D11_SUBRESOURCE_DATA> initialData(image.GetMipCount());
+        image.FillSubresources(initialData.data(), image.GetMipCount());
+        CD3D11_TEXTURE2D_DESC textureDesc(
+            format,
+            image.Width,
+            image.Height,
+            1,
+            image.GetMipCount()
+            );
+
+        ComPtr<ID3D11Texture2D> texture2D;
+        DX::ThrowIfFailed(
+            m_d3dDevice->CreateTexture2D(
+                &textureDesc,
+                initialData.data(),
+                &texture2D
+                )
+            );
+        DX::ThrowIfFailed(
+            m_d3dDevice->CreateShaderResourceView(
+                texture2D.Get(),
+                nullptr,
+                textureView
+                )
+            );
+
+        SetDebugName(texture2D.Get(), filename);
+    });
+}
 
 void BasicLoader::LoadTextureArray(
 	Platform::Array<Platform::String^>^ filenames,
 	ID3D11ShaderResourceView** textureView
 	)
+{
+	std::vector<Platform::Array<byte>^> fileData(filenames->Length);
+	for (UINT i = 0; i < filenames->Length; ++i)
+		fileData[i] = m_basicReaderWriter->ReadData(filenames[i]);
+
+	CreateTextureArray(filenames, fileData, textureView);
+}
+
+concurrency::task<void> BasicLoader::LoadTextureArrayAsync(
+	Platform::Array<Platform::String^>^ filenames,
+	ID3D11ShaderResourceView** textureView
+	)
+{
+	std::vector<concurrency::task<Platform::Array<byte>^>> tasks(filenames->Length);
+	for (UINT i = 0; i < filenames->Length; ++i)
+		tasks[i] = m_basicReaderWriter->ReadDataAsync(filenames[i]);
+
+	return concurrency::when_all(tasks.begin(), tasks.end()).then([=](std::vector<Platform::Array<byte>^> fileData)
+	{
+		CreateTextureArray(filenames, fileData, textureView);
+	});
+}
+
+void BasicLoader::CreateTextureArray(
+	Platform::Array<Platform::String^>^ filenames,
+	const std::vector<Platform::Array<byte>^>& fileData,
+	ID3D11ShaderResourceView** textureView
+	)
 {
 	//
-	// Load the texture elements individually from file.  These textures
-	// won't be used by the GPU (0 bind flags), they are just used to 
-	// load the image data from file.  We use the STAGING usage so the
-	// CPU can read the resource.
+	// Decode the elements on the CPU. DDS elements that have their mips are used
+	// in place, the other elements get their mip chain generated in parallel.
+	// Like single textures, only sRGB elements are filtered in linear space.
 	//
 
 	UINT size = filenames->Length;
-	std::vector<ComPtr<ID3D11Texture2D>> srcTex(size);
+	std::vector<DDSTextureDesc> descs(size);
+	std::vector<MipImage> images(size);
+	std::vector<DXGI_FORMAT> formats(size);
+	for (UINT i = 0; i < size; ++i)
+	{
+		if (GetExtension(filenames[i]) == "dds")
+		{
+			DDSTextureDesc& desc = descs[i];
+			if (ParseDDSHeader(fileData[i]->Data, fileData[i]->Length, desc) != DDSResult::Ok)
+				throw ref new Platform::FailureException("Invalid DDS file!");
+			if (desc.ArraySize != 1 || desc.Depth != 1)
+				throw ref new Platform::FailureException("Texture array elements must be 2D textures!");
+			formats[i] = desc.Format;
+			if (desc.MipCount == 1 && CanGenerateMips(desc.Format))
+			{
+				DDSSubresource top = GetDDSSubresource(fileData[i]->Data, desc, 0, 0);
+				images[i].Initialize(top.Data, top.Width, top.Height, static_cast<UINT>(top.RowPitch));
+			}
+		}
+		else
+		{
+			uint32 width;
+			uint32 height;
+			std::unique_ptr<byte[]> bitmapPixels = DecodeImage(fileData[i]->Data, fileData[i]->Length, &width, &height);
+			images[i].Initialize(bitmapPixels.get(), width, height, width * 4);
+			formats[i] = DXGI_FORMAT_B8G8R8A8_UNORM;
+		}
+	}
+	concurrency::parallel_for(UINT(0), size, [&](UINT i)
+	{
+		if (images[i].Width > 0)
+			GenerateMips(images[i], IsSrgbFormat(formats[i]));
+	});
+
+	//
+	// Each element in the texture array has the same format/dimensions.
+	// Elements with a shorter mip chain limit the chain of the array.
+	//
 
+	UINT width = images[0].Width > 0 ? images[0].Width : descs[0].Width;
+	UINT height = images[0].Width > 0 ? images[0].Height : descs[0].Height;
+	UINT mipLevels = D3D11_REQ_MIP_LEVELS;
 	for (UINT i = 0; i < size; ++i)
-		LoadTexture(filenames[i], true, srcTex[i].GetAddressOf(), nullptr);
+	{
+		bool isImage = images[i].Width > 0;
+		if (formats[i] != formats[0] ||
+			(isImage ? images[i].Width : descs[i].Width) != width ||
+			(isImage ? images[i].Height : descs[i].Height) != height)
+		{
+			throw ref new Platform::FailureException("Texture array elements differ in format or size!");
+		}
+		mipLevels = MathHelper::Min(mipLevels, isImage ? images[i].GetMipCount() : descs[i].MipCount);
+	}
 
 	//
-	// Create the texture array.  Each element in the texture 
-	// array has the same format/dimensions.
+	// Point the initial data at the decoded elements, so the whole array
+	// is created and uploaded at once.
 	//
 
-	D3D11_TEXTURE2D_DESC texElementDesc;
-	srcTex[0]->GetDesc(&texElementDesc);
+	std::vector<D3D11_SUBRESOURCE_DATA> initialData(size * mipLevels);
+	for (UINT texElement = 0; texElement < size; ++texElement)
+	{
+		D3D11_SUBRESOURCE_DATA* element = &initialData[D3D11CalcSubresource(0, texElement, mipLevels)];
+		if (images[texElement].Width > 0)
+		{
+			images[texElement].FillSubresources(element, mipLevels);
+			continue;
+		}
+		DDSSubresource mips[DDSMaxMipLevels];
+		GetDDSMipChain(fileData[texElement]->Data, descs[texElement], 0, mips);
+		for (UINT mipLevel = 0; mipLevel < mipLevels; ++mipLevel)
+		{
+			const DDSSubresource& mip = mips[mipLevel];
+			element[mipLevel].pSysMem = mip.Data;
+			element[mipLevel].SysMemPitch = static_cast<UINT>(mip.RowPitch);
+			element[mipLevel].SysMemSlicePitch = static_cast<UINT>(mip.Size);
+		}
+	}
 
 	D3D11_TEXTURE2D_DESC texArrayDesc;
-	texArrayDesc.Width = texElementDesc.Width;
-	texArrayDesc.Height = texElementDesc.Height;
-	texArrayDesc.MipLevels = texElementDesc.MipLevels;
+	texArrayDesc.Width = width;
+	texArrayDesc.Height = height;
+	texArrayDesc.MipLevels = mipLevels;
 	texArrayDesc.ArraySize = size;
-	texArrayDesc.Format = texElementDesc.Format;
+	texArrayDesc.Format = formats[0];
 	texArrayDesc.SampleDesc.Count = 1;
 	texArrayDesc.SampleDesc.Quality = 0;
 	texArrayDesc.Usage = D3D11_USAGE_DEFAULT;
@@ -471,28 +704,7 @@ void BasicLoader::LoadTextureArray(
 	texArrayDesc.MiscFlags = 0;
 
 	ComPtr<ID3D11Texture2D> texArray;
-	DX::ThrowIfFailed(m_d3dDevice->CreateTexture2D(&texArrayDesc, 0, texArray.GetAddressOf()));
-
-	//
-	// Copy individual texture elements into texture array.
-	//
-
-	// for each texture element...
-	for (UINT texElement = 0; texElement < size; ++texElement)
-	{
-		// for each mipmap level...
-		for (UINT mipLevel = 0; mipLevel < texElementDesc.MipLevels; ++mipLevel)
-		{
-			D3D11_MAPPED_SUBRESOURCE mappedTex2D;
-			DX::ThrowIfFailed(m_d3dContext->Map(srcTex[texElement].Get(), mipLevel, D3D11_MAP_READ, 0, &mappedTex2D));
-
-			m_d3dContext->UpdateSubresource(texArray.Get(),
-				D3D11CalcSubresource(mipLevel, texElement, texElementDesc.MipLevels),
-				0, mappedTex2D.pData, mappedTex2D.RowPitch, mappedTex2D.DepthPitch);
-
-			m_d3dContext->Unmap(srcTex[texElement].Get(), mipLevel);
-		}
-	}
+	DX::ThrowIfFailed(m_d3dDevice->CreateTexture2D(&texArrayDesc, initialData.data(), texArray.GetAddressOf()));
 
 	//
 	// Create a resource view to the texture array.
@@ -509,104 +721,9 @@ void BasicLoader::LoadTextureArray(
 	ComPtr<ID3D11ShaderResourceView> texArraySRV;
 	DX::ThrowIfFailed(m_d3dDevice->CreateShaderResourceView(texArray.Get(), &viewDesc, texArraySRV.GetAddressOf()));
 
-	//
-	// Cleanup--we only need the resource view.
-	//
-
 	*textureView = texArraySRV.Detach();
 }
 
-// to do : check
-concurrency::task<void> BasicLoader::LoadTextureArrayAsync(
-	Platform::Array<Platform::String^>^ filenames,
-	ID3D11ShaderResourceView** textureView
-	)
-{
-	//
-	// Load the texture elements individually from file.  These textures
-	// won't be used by the GPU (0 bind flags), they are just used to 
-	// load the image data from file.  We use the STAGING usage so the
-	// CPU can read the resource.
-	//
-
-	UINT size = filenames->Length;
-
-	std::shared_ptr<std::vector<ComPtr<ID3D11Texture2D>>> srcTex(new std::vector<ComPtr<ID3D11Texture2D>>(size));
-	std::vector<concurrency::task<void>> tasks(size);
-
-	for (UINT i = 0; i < size; ++i)
-		tasks[i] = LoadTextureAsync(filenames[i], true, srcTex->at(i).GetAddressOf(), nullptr);
-
-	return concurrency::when_all(tasks.begin(), tasks.end()).then([=]()
-	{
-		//
-		// Create the texture array.  Each element in the texture 
-		// array has the same format/dimensions.
-		//
-
-		D3D11_TEXTURE2D_DESC texElementDesc;
-		srcTex->at(0)->GetDesc(&texElementDesc);
-
-		D3D11_TEXTURE2D_DESC texArrayDesc;
-		texArrayDesc.Width = texElementDesc.Width;
-		texArrayDesc.Height = texElementDesc.Height;
-		texArrayDesc.MipLevels = texElementDesc.MipLevels;
-		texArrayDesc.ArraySize = size;
-		texArrayDesc.Format = texElementDesc.Format;
-		texArrayDesc.SampleDesc.Count = 1;
-		texArrayDesc.SampleDesc.Quality = 0;
-		texArrayDesc.Usage = D3D11_USAGE_DEFAULT;
-		texArrayDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-		texArrayDesc.CPUAccessFlags = 0;
-		texArrayDesc.MiscFlags = 0;
-
-		ComPtr<ID3D11Texture2D> texArray;
-		DX::ThrowIfFailed(m_d3dDevice->CreateTexture2D(&texArrayDesc, 0, texArray.GetAddressOf()));
-
-		//
-		// Copy individual texture elements into texture array.
-		//
-
-		// for each texture element...
-		for (UINT texElement = 0; texElement < size; ++texElement)
-		{
-			// for each mipmap level...
-			for (UINT mipLevel = 0; mipLevel < texElementDesc.MipLevels; ++mipLevel)
-			{
-				D3D11_MAPPED_SUBRESOURCE mappedTex2D;
-				DX::ThrowIfFailed(m_d3dContext->Map(srcTex->at(texElement).Get(), mipLevel, D3D11_MAP_READ, 0, &mappedTex2D));
-
-				m_d3dContext->UpdateSubresource(texArray.Get(),
-					D3D11CalcSubresource(mipLevel, texElement, texElementDesc.MipLevels),
-					0, mappedTex2D.pData, mappedTex2D.RowPitch, mappedTex2D.DepthPitch);
-
-				m_d3dContext->Unmap(srcTex->at(texElement).Get(), mipLevel);
-			}
-		}
-
-		//
-		// Create a resource view to the texture array.
-		//
-
-		D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc;
-		viewDesc.Format = texArrayDesc.Format;
-		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
-		viewDesc.Texture2DArray.MostDetailedMip = 0;
-		viewDesc.Texture2DArray.MipLevels = texArrayDesc.MipLevels;
-		viewDesc.Texture2DArray.FirstArraySlice = 0;
-		viewDesc.Texture2DArray.ArraySize = size;
-
-		ComPtr<ID3D11ShaderResourceView> texArraySRV;
-		DX::ThrowIfFailed(m_d3dDevice->CreateShaderResourceView(texArray.Get(), &viewDesc, texArraySRV.GetAddressOf()));
-
-		//
-		// Cleanup--we only need the resource view.
-		//
-
-		*textureView = texArraySRV.Detach();
-	});
-}
-
 void BasicLoader::LoadShader(
     Platform::String^ filename,
     D3D11_INPUT_ELEMENT_DESC layoutDesc[],
@@ -1029,6 +1146,79 @@ task<void> BasicLoader::LoadShaderAsync(
     });
 }
 
+void BasicLoader::CreateShader(
+    const byte* bytecode,
+    uint32 bytecodeSize,
+    Platform::String^ name,
+    D3D11_INPUT_ELEMENT_DESC layoutDesc[],
+    uint32 layoutDescNumElements,
+    ID3D11VertexShader** shader,
+    ID3D11InputLayout** layout
+    )
+{
+    DX::ThrowIfFailed(
+        m_d3dDevice->CreateVertexShader(
+            bytecode,
+            bytecodeSize,
+            nullptr,
+            shader
+            )
+        );
+
+    SetDebugName(*shader, name);
+
+    if (layout != nullptr)
+    {
+        CreateInputLayout(
+            const_cast<byte*>(bytecode),
+            bytecodeSize,
+            layoutDesc,
+            layoutDescNumElements,
+            layout
+            );
+
+        SetDebugName(*layout, name);
+    }
+}
+
+void BasicLoader::CreateShader(
+    const byte* bytecode,
+    uint32 bytecodeSize,
+    Platform::String^ name,
+    ID3D11PixelShader** shader
+    )
+{
+    DX::ThrowIfFailed(
+        m_d3dDevice->CreatePixelShader(
+            bytecode,
+            bytecodeSize,
+            nullptr,
+            shader
+            )
+        );
+
+    SetDebugName(*shader, name);
+}
+
+void BasicLoader::CreateShader(
+    const byte* bytecode,
+    uint32 bytecodeSize,
+    Platform::String^ name,
+    ID3D11DomainShader** shader
+    )
+{
+    DX::ThrowIfFailed(
+        m_d3dDevice->CreateDomainShader(
+            bytecode,
+            bytecodeSize,
+            nullptr,
+            shader
+            )
+        );
+
+    SetDebugName(*shader, name);
+}
+
 //void BasicLoader::LoadMesh(
 //    Platform::String^ filename,
 //    ID3D11Buffer** vertexBuffer,
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "BasicReaderWriter.h"
+#include "DDSTextureLoader.h"
 
 // A simple loader class that provides support for loading shaders, textures,
 // and meshes from files on disk. Provides synchronous and asynchronous methods.
@@ -36,12 +37,29 @@ namespace DX
 			ID3D11ShaderResourceView** textureView
 			);
 
-		// Must be called on the render thread
+		// DDS only. Mips larger than maxSize are skipped, 0 loads every mip. When layout is
+		// given it receives the mip layout of the whole file.
+		concurrency::task<void> LoadDDSTextureAsync(
+			Platform::String^ filename,
+			size_t maxSize,
+			ID3D11ShaderResourceView** textureView,
+			DDSMipLayout* layout = nullptr
+			);
+
+		// Loads the texture with a full mip chain generated on the CPU, unless the file has
+		// mips already. With srgb the mips are filtered in linear space.
+		concurrency::task<void> LoadTextureWithMipsAsync(
+			Platform::String^ filename,
+			bool srgb,
+			ID3D11ShaderResourceView** textureView
+			);
+
+		// The elements are decoded and assembled on the CPU, the array is created with
+		// its initial data in one call. Only the device is used.
 		void LoadTextureArray(
 			Platform::Array<Platform::String^>^ filenames,
 			ID3D11ShaderResourceView** textureView
 			);
-		// Must be called on the render thread
 		concurrency::task<void> LoadTextureArrayAsync(
 			Platform::Array<Platform::String^>^ filenames,
 			ID3D11ShaderResourceView** textureView
@@ -133,6 +151,31 @@ namespace DX
 			ID3D11DomainShader** shader
 			);
 
+		// Shaders from bytecode that is already in memory, name is only used for debugging.
+		void CreateShader(
+			const byte* bytecode,
+			uint32 bytecodeSize,
+			Platform::String^ name,
+			D3D11_INPUT_ELEMENT_DESC layoutDesc[],
+			uint32 layoutDescNumElements,
+			ID3D11VertexShader** shader,
+			ID3D11InputLayout** layout
+			);
+
+		void CreateShader(
+			const byte* bytecode,
+			uint32 bytecodeSize,
+			Platform::String^ name,
+			ID3D11PixelShader** shader
+			);
+
+		void CreateShader(
+			const byte* bytecode,
+			uint32 bytecodeSize,
+			Platform::String^ name,
+			ID3D11DomainShader** shader
+			);
+
 		/*void LoadMesh(
 			Platform::String^ filename,
 			ID3D11Buffer** vertexBuffer,
@@ -165,6 +208,20 @@ namespace DX
 			Platform::String^ filename
 			);
 
+		// Decodes a non DDS image to 32bpp premultiplied BGRA.
+		std::unique_ptr<byte[]> DecodeImage(
+			byte* data,
+			uint32 dataSize,
+			uint32* width,
+			uint32* height
+			);
+
+		void CreateTextureArray(
+			Platform::Array<Platform::String^>^ filenames,
+			const std::vector<Platform::Array<byte>^>& fileData,
+			ID3D11ShaderResourceView** textureView
+			);
+
 		void CreateTexture(
 			bool decodeAsDDS,
 			bool needMap,
@@ -7,6 +7,7 @@
 
 #include "pch.h"
 #include "BasicReaderWriter.h"
+#include "AssetPack.h"
 
 using namespace Microsoft::WRL;
 using namespace Windows::Storage;
@@ -43,6 +44,15 @@ Platform::Array<byte>^ BasicReaderWriter::ReadData(
     Platform::String^ filename
     )
 {
+    // Assets in the mounted pack skip the file open
+    const AssetPackFormat::PackEntry* entry = AssetPack::Instance() ? AssetPack::Instance()->Find(filename->Data()) : nullptr;
+    if (entry != nullptr)
+    {
+        Platform::Array<byte>^ packData = ref new Platform::Array<byte>(entry->RawSize);
+        AssetPack::Instance()->Read(*entry, packData->Data);
+        return packData;
+    }
+
     CREATEFILE2_EXTENDED_PARAMETERS extendedParams = {0};
     extendedParams.dwSize = sizeof(CREATEFILE2_EXTENDED_PARAMETERS);
     extendedParams.dwFileAttributes = FILE_ATTRIBUTE_NORMAL;
@@ -101,6 +111,18 @@ task<Platform::Array<byte>^> BasicReaderWriter::ReadDataAsync(
     Platform::String^ filename
     )
 {
+    // Pack entries are copied or decompressed on a worker thread
+    const AssetPackFormat::PackEntry* entry = AssetPack::Instance() ? AssetPack::Instance()->Find(filename->Data()) : nullptr;
+    if (entry != nullptr)
+    {
+        return create_task([entry]()
+        {
+            Platform::Array<byte>^ packData = ref new Platform::Array<byte>(entry->RawSize);
+            AssetPack::Instance()->Read(*entry, packData->Data);
+            return packData;
+        });
+    }
+
     return task<StorageFile^>(m_location->GetFileAsync(filename)).then([=](StorageFile^ file)
     {
         return FileIO::ReadBufferAsync(file);
@@ -1,86 +1,19 @@
 #pragma once
 
 #include "DirectXHelper.h"
-#include "LightHelper.h"
+#include "ConstantBufferLayouts.h"
+#include "ConstantRing.h"
 
 //  brief Wrapper class for cbuffers that handles creation and updating
 //  for a fixed type specified by the template parameter T.
 namespace DX
 {
-	// Constant buffers shared by multi renderers
-	struct BasicPerFrameCB
-	{
-		DirectX::XMFLOAT4X4 View;
-		DirectX::XMFLOAT4X4 InvView;
-		DirectX::XMFLOAT4X4 Proj;
-		DirectX::XMFLOAT4X4 InvProj;
-		DirectX::XMFLOAT4X4 ViewProj;
-		DirectX::XMFLOAT4X4 LightProj;
-
-		DX::DirectionalLight DirLights[3];
-		DirectX::XMFLOAT3 EyePosW;
-		float Pad0;
-
-		DirectX::XMFLOAT4 FogColor;
-		float  FogStart;
-		float  FogRange;
-
-		float GameTime;
-		float ElapseTime;
-	};
-
-	struct BasicPerObjectCB
-	{
-		DirectX::XMFLOAT4X4 World;
-		DirectX::XMFLOAT4X4 WorldInvTranspose;
-		DirectX::XMFLOAT4X4 TexTransform;
-		DX::Material Mat;
-	};
-
-	struct BasicTessSettings
-	{
-		float HeightScale;
-		float MaxTessDistance;
-		float MinTessDistance;
-		float MinTessFactor;
-		float MaxTessFactor;
-	};
-
-	struct BasicSsaoSettings
-	{
-		DirectX::XMFLOAT4 OffsetVectors[14];
-		DirectX::XMFLOAT4 FrustumCorners[4];
-
-		// Coordinates given in view space.
-		float    OcclusionRadius;
-		float    OcclusionFadeStart;
-		float    OcclusionFadeEnd;
-		float    SurfaceEpsilon;
-	};
-
-	struct BasicTextureSettings
-	{
-		float TexelWidth;
-		float TexelHeight;
-	};
-
-	struct WorldMatrix
-	{
-		DirectX::XMFLOAT4X4 World;
-	};
-
-	struct SkinnedTransforms
-	{
-		DirectX::XMFLOAT4X4 BoneTransforms[96];
-	};
-
-
 	template<typename T>
 	class ConstantBuffer
 	{
 	public:
 		ConstantBuffer() :
-			m_initialized(false)
+			m_ring(nullptr), m_initialized(false)
 		{
 		}
 
@@ -93,6 +26,29 @@ namespace DX
 			return m_buffer.Get();
 		}
 
+		// Until the next ApplyChanges, Bind binds this allocation of ring instead of the buffer.
+		// The allocation must already hold Data, nothing is copied.
+		void UseAllocation(ConstantRing* ring, const RingAllocation& allocation)
+		{
+			m_ring = ring;
+			m_allocation = allocation;
+		}
+
+		// Binds the buffer, or the allocation in use, to one slot of a stage. An allocation the
+		// ring restarted over since is uploaded again from Data.
+		void Bind(StateTracker* tracker, ShaderStage stage, UINT slot) const
+		{
+			if (m_allocation.Buffer && !m_ring->IsValid(m_allocation))
+				m_allocation = m_ring->Upload(tracker->GetContext(), &Data, sizeof(T));
+			if (m_allocation.Buffer)
+			{
+				ConstantRing::Bind(tracker, stage, slot, m_allocation);
+				return;
+			}
+			ID3D11Buffer* buffer = m_buffer.Get();
+			tracker->SetConstantBuffers(stage, slot, 1, &buffer);
+		}
+
 		bool GetInitalizeState() { return m_initialized; }
 
 		// Initializes the constant buffer.
@@ -119,6 +75,7 @@ namespace DX
 		{
 			_ASSERT(m_initialized);
 
+			m_allocation = RingAllocation();
 			D3D11_MAPPED_SUBRESOURCE mappedResource;
 			dc->Map(m_buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
 			CopyMemory(mappedResource.pData, &Data, sizeof(T));
@@ -129,11 +86,14 @@ namespace DX
 		void Reset()
 		{
 			m_buffer.Reset();
+			m_allocation = RingAllocation();
 			m_initialized = false;
 		}
 
 	private:
 		Microsoft::WRL::ComPtr<ID3D11Buffer> m_buffer;
+		ConstantRing* m_ring;
+		mutable RingAllocation m_allocation;
 		bool m_initialized;
 	};
 }
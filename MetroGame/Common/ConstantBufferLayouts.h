@@ -0,0 +1,81 @@
+#pragma once
+
+#include "LightHelper.h"
+
+// Layouts of the constant buffers shared by the renderers, without the buffer wrapper of
+// ConstantBuffer.h, so code that only fills them builds without the rest of the framework.
+namespace DX
+{
+	// Constant buffers shared by multi renderers
+	struct BasicPerFrameCB
+	{
+		DirectX::XMFLOAT4X4 View;
+		DirectX::XMFLOAT4X4 InvView;
+		DirectX::XMFLOAT4X4 Proj;
+		DirectX::XMFLOAT4X4 InvProj;
+		DirectX::XMFLOAT4X4 ViewProj;
+		DirectX::XMFLOAT4X4 LightProj;
+
+		DX::DirectionalLight DirLights[3];
+		DirectX::XMFLOAT3 EyePosW;
+		float Pad0;
+
+		DirectX::XMFLOAT4 FogColor;
+		float  FogStart;
+		float  FogRange;
+
+		float GameTime;
+		float ElapseTime;
+	};
+
+	struct BasicPerObjectCB
+	{
+		DirectX::XMFLOAT4X4 World;
+		DirectX::XMFLOAT4X4 WorldInvTranspose;
+		DirectX::XMFLOAT4X4 TexTransform;
+		DX::Material Mat;
+	};
+
+	struct BasicTessSettings
+	{
+		float HeightScale;
+		float MaxTessDistance;
+		float MinTessDistance;
+		float MinTessFactor;
+		float MaxTessFactor;
+	};
+
+	struct BasicSsaoSettings
+	{
+		DirectX::XMFLOAT4 OffsetVectors[14];
+		DirectX::XMFLOAT4 FrustumCorners[4];
+
+		// Coordinates given in view space.
+		float    OcclusionRadius;
+		float    OcclusionFadeStart;
+		float    OcclusionFadeEnd;
+		float    SurfaceEpsilon;
+	};
+
+	struct BasicTextureSettings
+	{
+		float TexelWidth;
+		float TexelHeight;
+	};
+
+	struct WorldMatrix
+	{
+		DirectX::XMFLOAT4X4 World;
+	};
+
+	struct SkinnedTransforms
+	{
+		DirectX::XMFLOAT4X4 BoneTransforms[96];
+	};
+
+	// Real and dual part per bone, see SkinnedData::GetDualQuaternions.
+	struct SkinnedDualQuaternions
+	{
+		DirectX::XMFLOAT4 BoneDualQuaternions[96 * 2];
+	};
+}
@@ -0,0 +1,211 @@
+#include "pch.h"
+#include "ConstantRing.h"
+#include <cstring>
+
+using namespace DX;
+
+// FNV-1a over 8 byte words, the tail byte by byte.
+static uint64_t HashBytes(const void* data, uint32_t size)
+{
+	const uint64_t prime = 1099511628211ull;
+	uint64_t hash = 14695981039346656037ull;
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint32_t words = size / 8;
+	for (uint32_t i = 0; i < words; ++i)
+	{
+		uint64_t word;
+		memcpy(&word, bytes + i * 8, 8);
+		hash = (hash ^ word) * prime;
+	}
+	for (uint32_t i = words * 8; i < size; ++i)
+		hash = (hash ^ bytes[i]) * prime;
+	return hash;
+}
+
+static uint32_t AlignUp(uint32_t size)
+{
+	return (size + ConstantRing::Alignment - 1) & ~(ConstantRing::Alignment - 1);
+}
+
+ConstantRing::ConstantRing() :
+	m_buffer(nullptr), m_capacity(0), m_offset(0), m_epoch(1), m_discard(true), m_initialized(false)
+{
+}
+
+ConstantRing::~ConstantRing()
+{
+	Reset();
+}
+
+bool ConstantRing::IsSupported(ID3D11Device* device)
+{
+#ifdef _WIN32
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (FAILED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))))
+		return false;
+	return options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+#else
+	(void)device;
+	return false;
+#endif
+}
+
+bool ConstantRing::Initialize(ID3D11Device* device, uint32_t capacity)
+{
+	Reset();
+	m_capacity = AlignUp(capacity);
+	if (device)
+	{
+#ifdef _WIN32
+		D3D11_BUFFER_DESC desc;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags = 0;
+		desc.ByteWidth = m_capacity;
+		desc.StructureByteStride = 0;
+		if (FAILED(device->CreateBuffer(&desc, 0, &m_buffer)))
+		{
+			m_buffer = nullptr;
+			m_capacity = 0;
+			return false;
+		}
+#else
+		return false;
+#endif
+	}
+	else
+		m_memory.resize(m_capacity);
+	m_offset = 0;
+	m_discard = true;
+	++m_epoch;
+	m_initialized = true;
+	return true;
+}
+
+void ConstantRing::Reset()
+{
+#ifdef _WIN32
+	if (m_buffer)
+		m_buffer->Release();
+#endif
+	m_buffer = nullptr;
+	m_memory.clear();
+	m_capacity = 0;
+	++m_epoch;
+	m_initialized = false;
+}
+
+void ConstantRing::BeginFrame()
+{
+	m_offset = 0;
+	m_discard = true;
+	++m_epoch;
+	m_stats = ConstantRingStats();
+}
+
+RingAllocation ConstantRing::Upload(ID3D11DeviceContext* context, const void* data, uint32_t size)
+{
+	return UploadArray(context, data, size, 1);
+}
+
+RingAllocation ConstantRing::UploadArray(ID3D11DeviceContext* context, const void* data, uint32_t elementSize, uint32_t count)
+{
+	assert(m_initialized);
+
+	uint32_t alignedSize = AlignUp(elementSize);
+	// Checked in 64 bits, a large count must not wrap around and pass
+	if (count == 0 || (uint64_t)alignedSize * count > m_capacity)
+		return RingAllocation();
+	uint32_t totalSize = alignedSize * count;
+	if (m_offset + totalSize > m_capacity)
+	{
+		// Restart. DISCARD hands out fresh memory, draws still using the old contents are fine.
+		m_offset = 0;
+		m_discard = true;
+		++m_epoch;
+		++m_stats.Wraps;
+	}
+
+	RingAllocation allocation;
+	allocation.Buffer = m_buffer;
+	allocation.Offset = m_offset;
+	allocation.Size = totalSize;
+	allocation.Epoch = m_epoch;
+
+	uint8_t* target = nullptr;
+#ifdef _WIN32
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (m_buffer)
+	{
+		if (FAILED(context->Map(m_buffer, 0, m_discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mappedResource)))
+			return RingAllocation();
+		target = (uint8_t*)mappedResource.pData + m_offset;
+	}
+#else
+	(void)context;
+#endif
+	if (!m_buffer)
+		target = &m_memory[m_offset];
+
+	const uint8_t* source = (const uint8_t*)data;
+	for (uint32_t i = 0; i < count; ++i)
+		memcpy(target + i * alignedSize, source + i * elementSize, elementSize);
+
+#ifdef _WIN32
+	if (m_buffer)
+		context->Unmap(m_buffer, 0);
+#endif
+
+	m_discard = false;
+	m_offset += totalSize;
+	m_stats.Uploads += count;
+	++m_stats.Maps;
+	m_stats.BytesWritten += (uint64_t)elementSize * count;
+	return allocation;
+}
+
+RingAllocation ConstantRing::UploadIfDirty(ID3D11DeviceContext* context, const void* data, uint32_t size, RingSlot& slot)
+{
+	if (!slot.Dirty && IsValid(slot.Allocation))
+	{
+		++m_stats.SkippedUploads;
+		return slot.Allocation;
+	}
+	slot.Allocation = Upload(context, data, size);
+	slot.Dirty = false;
+	return slot.Allocation;
+}
+
+RingAllocation ConstantRing::UploadIfChanged(ID3D11DeviceContext* context, const void* data, uint32_t size, RingSlot& slot)
+{
+	uint64_t hash = HashBytes(data, size);
+	if (hash == slot.Hash && IsValid(slot.Allocation))
+	{
+		++m_stats.SkippedUploads;
+		return slot.Allocation;
+	}
+	slot.Allocation = Upload(context, data, size);
+	slot.Hash = hash;
+	slot.Dirty = false;
+	return slot.Allocation;
+}
+
+RingAllocation ConstantRing::GetElement(const RingAllocation& array, uint32_t elementSize, uint32_t index)
+{
+	RingAllocation element = array;
+	element.Size = AlignUp(elementSize);
+	element.Offset = array.Offset + index * element.Size;
+	return element;
+}
+
+void ConstantRing::Bind(StateTracker* tracker, ShaderStage stage, uint32_t slot, const RingAllocation& allocation)
+{
+	if (!allocation.Buffer)
+		return;
+
+	// Offsets and sizes are counted in 16 byte constants
+	uint32_t first = allocation.Offset / 16;
+	uint32_t count = allocation.Size / 16;
+	tracker->SetConstantBuffers1(stage, slot, 1, &allocation.Buffer, &first, &count);
+}
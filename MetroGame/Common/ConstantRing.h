@@ -0,0 +1,113 @@
+#pragma once
+
+#include "StateTracker.h"
+#include <vector>
+
+// Linear ring allocator for constant data. Uploads are appended to one large dynamic buffer
+// at 256 byte aligned offsets and bound by offset (D3D 11.1 *SetConstantBuffers1), instead of
+// mapping a whole fixed size buffer per draw. The first upload of a frame and an upload that
+// does not fit map with DISCARD and restart at offset 0, every other upload maps with
+// NO_OVERWRITE. Either case starts a new epoch, allocations of older epochs are invalid.
+// UploadArray writes many pieces of data under one map, the way a frame's worth of per-object
+// data is uploaded. Drivers without IsSupported get no ring, callers keep their plain buffers.
+// Without a device (the null backend) the ring lives in system memory and only the stats
+// change, so upload counts can be checked without a device. Like StateTracker the d3d11
+// interfaces are only declared here.
+
+struct ID3D11Device;
+struct ID3D11DeviceContext;
+
+namespace DX
+{
+	// Where an upload landed. Offset and Size are bytes, both multiples of 256.
+	struct RingAllocation
+	{
+		RingAllocation() : Buffer(nullptr), Offset(0), Size(0), Epoch(0) {}
+
+		ID3D11Buffer* Buffer;
+		uint32_t Offset;
+		uint32_t Size;
+		uint32_t Epoch;
+	};
+
+	// Last upload of one piece of constant data, lets unchanged data reuse its allocation.
+	struct RingSlot
+	{
+		RingSlot() : Hash(0), Dirty(true) {}
+
+		RingAllocation Allocation;
+		uint64_t Hash;
+		bool Dirty;		// Set by the owner when the data changes, see UploadIfDirty
+	};
+
+	struct ConstantRingStats
+	{
+		ConstantRingStats() : Uploads(0), SkippedUploads(0), Maps(0), Wraps(0), BytesWritten(0) {}
+
+		uint32_t Uploads;
+		uint32_t SkippedUploads;
+		uint32_t Maps;
+		uint32_t Wraps;		// Uploads that did not fit and restarted the ring within a frame
+		uint64_t BytesWritten;
+	};
+
+	class ConstantRing
+	{
+	public:
+		static const uint32_t Alignment = 256;
+
+		ConstantRing();
+		~ConstantRing();
+
+		// Binding by offset and NO_OVERWRITE maps of a dynamic constant buffer, both optional
+		// on 11.1 drivers (D3D11_FEATURE_D3D11_OPTIONS). Always false off Windows.
+		static bool IsSupported(ID3D11Device* device);
+
+		// capacity is rounded up to the alignment. A null device selects the null backend.
+		// Returns false when the buffer could not be created.
+		bool Initialize(ID3D11Device* device, uint32_t capacity);
+		void Reset();
+		bool GetInitalizeState()const { return m_initialized; }
+		uint32_t GetCapacity()const { return m_capacity; }
+
+		// Restart at offset 0 and reset the stats. Called once per frame, a full ring also
+		// restarts by itself.
+		void BeginFrame();
+
+		// Always uploads. An empty allocation comes back for data larger than the whole ring.
+		RingAllocation Upload(ID3D11DeviceContext* context, const void* data, uint32_t size);
+		// count pieces of elementSize bytes each, packed in data, under one map. Every piece
+		// starts on the alignment, see GetElement. Empty when they do not fit the whole ring.
+		RingAllocation UploadArray(ID3D11DeviceContext* context, const void* data, uint32_t elementSize, uint32_t count);
+		// Reuse the slot's allocation while it is valid and the slot is not dirty.
+		RingAllocation UploadIfDirty(ID3D11DeviceContext* context, const void* data, uint32_t size, RingSlot& slot);
+		// Reuse the slot's allocation while it is valid and the data hashes the same.
+		RingAllocation UploadIfChanged(ID3D11DeviceContext* context, const void* data, uint32_t size, RingSlot& slot);
+
+		// Allocations of the current epoch are valid, those of another ring (one recreated after
+		// a device loss for example) are not.
+		bool IsValid(const RingAllocation& allocation)const { return allocation.Size > 0 && allocation.Epoch == m_epoch && allocation.Buffer == m_buffer; }
+		const ConstantRingStats& GetStats()const { return m_stats; }
+		// Null backend only, the bytes of an allocation.
+		const uint8_t* GetMemory(const RingAllocation& allocation)const { return &m_memory[allocation.Offset]; }
+
+		// Piece index of an UploadArray allocation.
+		static RingAllocation GetElement(const RingAllocation& array, uint32_t elementSize, uint32_t index);
+		// Bind an allocation to one constant buffer slot of a stage.
+		static void Bind(StateTracker* tracker, ShaderStage stage, uint32_t slot, const RingAllocation& allocation);
+
+	private:
+		ConstantRing(const ConstantRing&);
+		ConstantRing& operator=(const ConstantRing&);
+
+	private:
+		ID3D11Buffer* m_buffer;
+		std::vector<uint8_t> m_memory;		// Null backend storage
+		uint32_t m_capacity;
+		uint32_t m_offset;
+		uint32_t m_epoch;
+		bool m_discard;
+		bool m_initialized;
+		ConstantRingStats m_stats;
+	};
+}
@@ -0,0 +1,874 @@
+//--------------------------------------------------------------------------------------
+// File: DDSParser.cpp
+//
+// DDS header validation and subresource layout, split out of DDSTextureLoader.cpp so it
+// can be used without a device. Only depends on the standard library and dxgiformat.h.
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248926
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "DDSParser.h"
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace DX;
+
+//--------------------------------------------------------------------------------------
+// Macros
+//--------------------------------------------------------------------------------------
+#ifndef MAKEFOURCC
+    #define MAKEFOURCC(ch0, ch1, ch2, ch3)                              \
+                ((uint32_t)(uint8_t)(ch0) | ((uint32_t)(uint8_t)(ch1) << 8) |       \
+                ((uint32_t)(uint8_t)(ch2) << 16) | ((uint32_t)(uint8_t)(ch3) << 24))
+#endif /* defined(MAKEFOURCC) */
+
+//--------------------------------------------------------------------------------------
+// DDS file structure definitions
+//
+// See DDS.h in the 'Texconv' sample and the 'DirectXTex' library
+//--------------------------------------------------------------------------------------
+#pragma pack(push, 1)
+
+#define DDS_MAGIC 0x20534444 // "DDS "
+
+struct DDS_PIXELFORMAT
+{
+    uint32_t size;
+    uint32_t flags;
+    uint32_t fourCC;
+    uint32_t RGBBitCount;
+    uint32_t RBitMask;
+    uint32_t GBitMask;
+    uint32_t BBitMask;
+    uint32_t ABitMask;
+};
+
+#define DDS_FOURCC      0x00000004  // DDPF_FOURCC
+#define DDS_RGB         0x00000040  // DDPF_RGB
+#define DDS_RGBA        0x00000041  // DDPF_RGB | DDPF_ALPHAPIXELS
+#define DDS_LUMINANCE   0x00020000  // DDPF_LUMINANCE
+#define DDS_LUMINANCEA  0x00020001  // DDPF_LUMINANCE | DDPF_ALPHAPIXELS
+#define DDS_ALPHA       0x00000002  // DDPF_ALPHA
+#define DDS_PAL8        0x00000020  // DDPF_PALETTEINDEXED8
+
+#define DDS_HEADER_FLAGS_TEXTURE        0x00001007  // DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT
+#define DDS_HEADER_FLAGS_MIPMAP         0x00020000  // DDSD_MIPMAPCOUNT
+#define DDS_HEADER_FLAGS_VOLUME         0x00800000  // DDSD_DEPTH
+#define DDS_HEADER_FLAGS_PITCH          0x00000008  // DDSD_PITCH
+#define DDS_HEADER_FLAGS_LINEARSIZE     0x00080000  // DDSD_LINEARSIZE
+
+#define DDS_HEIGHT 0x00000002 // DDSD_HEIGHT
+#define DDS_WIDTH  0x00000004 // DDSD_WIDTH
+
+#define DDS_SURFACE_FLAGS_TEXTURE 0x00001000 // DDSCAPS_TEXTURE
+#define DDS_SURFACE_FLAGS_MIPMAP  0x00400008 // DDSCAPS_COMPLEX | DDSCAPS_MIPMAP
+#define DDS_SURFACE_FLAGS_CUBEMAP 0x00000008 // DDSCAPS_COMPLEX
+
+#define DDS_CUBEMAP_POSITIVEX 0x00000600 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEX
+#define DDS_CUBEMAP_NEGATIVEX 0x00000a00 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEX
+#define DDS_CUBEMAP_POSITIVEY 0x00001200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEY
+#define DDS_CUBEMAP_NEGATIVEY 0x00002200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEY
+#define DDS_CUBEMAP_POSITIVEZ 0x00004200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_POSITIVEZ
+#define DDS_CUBEMAP_NEGATIVEZ 0x00008200 // DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_NEGATIVEZ
+
+#define DDS_CUBEMAP_ALLFACES (DDS_CUBEMAP_POSITIVEX | DDS_CUBEMAP_NEGATIVEX |\
+                              DDS_CUBEMAP_POSITIVEY | DDS_CUBEMAP_NEGATIVEY |\
+                              DDS_CUBEMAP_POSITIVEZ | DDS_CUBEMAP_NEGATIVEZ)
+
+#define DDS_CUBEMAP 0x00000200 // DDSCAPS2_CUBEMAP
+
+#define DDS_FLAGS_VOLUME 0x00200000 // DDSCAPS2_VOLUME
+
+enum DDS_MISC_FLAGS2
+{
+    DDS_MISC_FLAGS2_ALPHA_MODE_MASK = 0x7L,
+};
+
+enum DDS_ALPHA_MODE
+{
+    DDS_ALPHA_MODE_UNKNOWN       = 0,
+    DDS_ALPHA_MODE_STRAIGHT      = 1,
+    DDS_ALPHA_MODE_PREMULTIPLIED = 2,
+    DDS_ALPHA_MODE_OPAQUE        = 3,
+    DDS_ALPHA_MODE_CUSTOM        = 4,
+};
+
+typedef struct
+{
+    uint32_t        size;
+    uint32_t        flags;
+    uint32_t        height;
+    uint32_t        width;
+    uint32_t        pitchOrLinearSize;
+    uint32_t        depth; // only if DDS_HEADER_FLAGS_VOLUME is set in flags
+    uint32_t        mipMapCount;
+    uint32_t        reserved1[11];
+    DDS_PIXELFORMAT ddspf;
+    uint32_t        caps;
+    uint32_t        caps2;
+    uint32_t        caps3;
+    uint32_t        caps4;
+    uint32_t        reserved2;
+} DDS_HEADER;
+
+typedef struct
+{
+    uint32_t    dxgiFormat;
+    uint32_t    resourceDimension;
+    uint32_t    miscFlag; // see D3D11_RESOURCE_MISC_FLAG
+    uint32_t    arraySize;
+    uint32_t    miscFlags2;
+} DDS_HEADER_DXT10;
+
+#pragma pack(pop)
+
+//--------------------------------------------------------------------------------------
+// Return the BPP for a particular format
+//--------------------------------------------------------------------------------------
+static size_t BitsPerPixel(DXGI_FORMAT fmt)
+{
+    switch (fmt)
+    {
+    case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+    case DXGI_FORMAT_R32G32B32A32_UINT:
+    case DXGI_FORMAT_R32G32B32A32_SINT:
+        return 128;
+
+    case DXGI_FORMAT_R32G32B32_TYPELESS:
+    case DXGI_FORMAT_R32G32B32_FLOAT:
+    case DXGI_FORMAT_R32G32B32_UINT:
+    case DXGI_FORMAT_R32G32B32_SINT:
+        return 96;
+
+    case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+    case DXGI_FORMAT_R16G16B16A16_UNORM:
+    case DXGI_FORMAT_R16G16B16A16_UINT:
+    case DXGI_FORMAT_R16G16B16A16_SNORM:
+    case DXGI_FORMAT_R16G16B16A16_SINT:
+    case DXGI_FORMAT_R32G32_TYPELESS:
+    case DXGI_FORMAT_R32G32_FLOAT:
+    case DXGI_FORMAT_R32G32_UINT:
+    case DXGI_FORMAT_R32G32_SINT:
+    case DXGI_FORMAT_R32G8X24_TYPELESS:
+    case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+    case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+    case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+        return 64;
+
+    case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+    case DXGI_FORMAT_R10G10B10A2_UNORM:
+    case DXGI_FORMAT_R10G10B10A2_UINT:
+    case DXGI_FORMAT_R11G11B10_FLOAT:
+    case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_R8G8B8A8_UINT:
+    case DXGI_FORMAT_R8G8B8A8_SNORM:
+    case DXGI_FORMAT_R8G8B8A8_SINT:
+    case DXGI_FORMAT_R16G16_TYPELESS:
+    case DXGI_FORMAT_R16G16_FLOAT:
+    case DXGI_FORMAT_R16G16_UNORM:
+    case DXGI_FORMAT_R16G16_UINT:
+    case DXGI_FORMAT_R16G16_SNORM:
+    case DXGI_FORMAT_R16G16_SINT:
+    case DXGI_FORMAT_R32_TYPELESS:
+    case DXGI_FORMAT_D32_FLOAT:
+    case DXGI_FORMAT_R32_FLOAT:
+    case DXGI_FORMAT_R32_UINT:
+    case DXGI_FORMAT_R32_SINT:
+    case DXGI_FORMAT_R24G8_TYPELESS:
+    case DXGI_FORMAT_D24_UNORM_S8_UINT:
+    case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+    case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+    case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+    case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+        return 32;
+
+    case DXGI_FORMAT_R8G8_TYPELESS:
+    case DXGI_FORMAT_R8G8_UNORM:
+    case DXGI_FORMAT_R8G8_UINT:
+    case DXGI_FORMAT_R8G8_SNORM:
+    case DXGI_FORMAT_R8G8_SINT:
+    case DXGI_FORMAT_R16_TYPELESS:
+    case DXGI_FORMAT_R16_FLOAT:
+    case DXGI_FORMAT_D16_UNORM:
+    case DXGI_FORMAT_R16_UNORM:
+    case DXGI_FORMAT_R16_UINT:
+    case DXGI_FORMAT_R16_SNORM:
+    case DXGI_FORMAT_R16_SINT:
+    case DXGI_FORMAT_B5G6R5_UNORM:
+    case DXGI_FORMAT_B5G5R5A1_UNORM:
+    case DXGI_FORMAT_B4G4R4A4_UNORM:
+        return 16;
+
+    case DXGI_FORMAT_R8_TYPELESS:
+    case DXGI_FORMAT_R8_UNORM:
+    case DXGI_FORMAT_R8_UINT:
+    case DXGI_FORMAT_R8_SNORM:
+    case DXGI_FORMAT_R8_SINT:
+    case DXGI_FORMAT_A8_UNORM:
+        return 8;
+
+    case DXGI_FORMAT_R1_UNORM:
+        return 1;
+
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        return 4;
+
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        return 8;
+
+    default:
+        return 0;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Get surface information for a particular format. Sizes are 64 bit so a surface at the
+// D3D11 limits does not overflow a 32 bit size_t.
+//--------------------------------------------------------------------------------------
+static void GetSurfaceInfo(
+    uint64_t width,
+    uint64_t height,
+    DXGI_FORMAT fmt,
+    uint64_t* outNumBytes,
+    uint64_t* outRowBytes
+    )
+{
+    uint64_t rowBytes = 0;
+    uint64_t numRows = 0;
+
+    bool bc = false;
+    bool packed  = false;
+    uint64_t bcnumBytesPerBlock = 0;
+    switch (fmt)
+    {
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        bc = true;
+        bcnumBytesPerBlock = 8;
+        break;
+
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        bc = true;
+        bcnumBytesPerBlock = 16;
+        break;
+
+    case DXGI_FORMAT_R8G8_B8G8_UNORM:
+    case DXGI_FORMAT_G8R8_G8B8_UNORM:
+        packed = true;
+        break;
+
+    default:
+        break;
+    }
+
+    if (bc)
+    {
+        rowBytes = std::max<uint64_t>(1, (width + 3) / 4) * bcnumBytesPerBlock;
+        numRows = std::max<uint64_t>(1, (height + 3) / 4);
+    }
+    else if (packed)
+    {
+        rowBytes = ((width + 1) >> 1) * 4;
+        numRows = height;
+    }
+    else
+    {
+        rowBytes = (width * BitsPerPixel(fmt) + 7) / 8; // round up to nearest byte
+        numRows = height;
+    }
+
+    *outNumBytes = rowBytes * numRows;
+    *outRowBytes = rowBytes;
+}
+
+
+//--------------------------------------------------------------------------------------
+#define ISBITMASK(r, g, b, a) (ddpf.RBitMask == r && ddpf.GBitMask == g && ddpf.BBitMask == b && ddpf.ABitMask == a)
+
+static DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& ddpf)
+{
+    if (ddpf.flags & DDS_RGB)
+    {
+        // Note that sRGB formats are written using the "DX10" extended header
+
+        switch (ddpf.RGBBitCount)
+        {
+        case 32:
+            if (ISBITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000))
+            {
+                return DXGI_FORMAT_R8G8B8A8_UNORM;
+            }
+
+            if (ISBITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000))
+            {
+                return DXGI_FORMAT_B8G8R8A8_UNORM;
+            }
+
+            if (ISBITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000))
+            {
+                return DXGI_FORMAT_B8G8R8X8_UNORM;
+            }
+
+            // No DXGI format maps to ISBITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0x00000000) aka D3DFMT_X8B8G8R8
+
+            // Note that many common DDS reader/writers (including D3DX) swap the
+            // the RED/BLUE masks for 10:10:10:2 formats. We assumme
+            // below that the 'backwards' header mask is being used since it is most
+            // likely written by D3DX. The more robust solution is to use the 'DX10'
+            // header extension and specify the DXGI_FORMAT_R10G10B10A2_UNORM format directly
+
+            // For 'correct' writers, this should be 0x000003ff, 0x000ffc00, 0x3ff00000 for RGB data
+            if (ISBITMASK(0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000))
+            {
+                return DXGI_FORMAT_R10G10B10A2_UNORM;
+            }
+
+            // No DXGI format maps to ISBITMASK(0x000003ff, 0x000ffc00, 0x3ff00000, 0xc0000000) aka D3DFMT_A2R10G10B10
+
+            if (ISBITMASK(0x0000ffff, 0xffff0000, 0x00000000, 0x00000000))
+            {
+                return DXGI_FORMAT_R16G16_UNORM;
+            }
+
+            if (ISBITMASK(0xffffffff, 0x00000000, 0x00000000, 0x00000000))
+            {
+                // Only 32-bit color channel format in D3D9 was R32F
+                return DXGI_FORMAT_R32_FLOAT; // D3DX writes this out as a FourCC of 114
+            }
+            break;
+
+        case 24:
+            // No 24bpp DXGI formats aka D3DFMT_R8G8B8
+            break;
+
+        case 16:
+            if (ISBITMASK(0x7c00, 0x03e0, 0x001f, 0x8000))
+            {
+                return DXGI_FORMAT_B5G5R5A1_UNORM;
+            }
+            if (ISBITMASK(0xf800, 0x07e0, 0x001f, 0x0000))
+            {
+                return DXGI_FORMAT_B5G6R5_UNORM;
+            }
+
+            // No DXGI format maps to ISBITMASK(0x7c00, 0x03e0, 0x001f, 0x0000) aka D3DFMT_X1R5G5B5
+            if (ISBITMASK(0x0f00, 0x00f0, 0x000f, 0xf000))
+            {
+                return DXGI_FORMAT_B4G4R4A4_UNORM;
+            }
+
+            // No DXGI format maps to ISBITMASK(0x0f00, 0x00f0, 0x000f, 0x0000) aka D3DFMT_X4R4G4B4
+
+            // No 3:3:2, 3:3:2:8, or paletted DXGI formats aka D3DFMT_A8R3G3B2, D3DFMT_R3G3B2, D3DFMT_P8, D3DFMT_A8P8, etc.
+            break;
+        }
+    }
+    else if (ddpf.flags & DDS_LUMINANCE)
+    {
+        if (8 == ddpf.RGBBitCount)
+        {
+            if (ISBITMASK(0x000000ff, 0x00000000, 0x00000000, 0x00000000))
+            {
+                return DXGI_FORMAT_R8_UNORM; // D3DX10/11 writes this out as DX10 extension
+            }
+
+            // No DXGI format maps to ISBITMASK(0x0f, 0x00, 0x00, 0xf0) aka D3DFMT_A4L4
+        }
+
+        if (16 == ddpf.RGBBitCount)
+        {
+            if (ISBITMASK(0x0000ffff, 0x00000000, 0x00000000, 0x00000000))
+            {
+                return DXGI_FORMAT_R16_UNORM; // D3DX10/11 writes this out as DX10 extension
+            }
+            if (ISBITMASK(0x000000ff, 0x00000000, 0x00000000, 0x0000ff00))
+            {
+                return DXGI_FORMAT_R8G8_UNORM; // D3DX10/11 writes this out as DX10 extension
+            }
+        }
+    }
+    else if (ddpf.flags & DDS_ALPHA)
+    {
+        if (8 == ddpf.RGBBitCount)
+        {
+            return DXGI_FORMAT_A8_UNORM;
+        }
+    }
+    else if (ddpf.flags & DDS_FOURCC)
+    {
+        if (MAKEFOURCC('D', 'X', 'T', '1') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC1_UNORM;
+        }
+        if (MAKEFOURCC('D', 'X', 'T', '3') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC2_UNORM;
+        }
+        if (MAKEFOURCC('D', 'X', 'T', '5') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC3_UNORM;
+        }
+
+        // While pre-mulitplied alpha isn't directly supported by the DXGI formats,
+        // they are basically the same as these BC formats so they can be mapped
+        if (MAKEFOURCC('D', 'X', 'T', '2') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC2_UNORM;
+        }
+        if (MAKEFOURCC('D', 'X', 'T', '4') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC3_UNORM;
+        }
+
+        if (MAKEFOURCC('A', 'T', 'I', '1') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC4_UNORM;
+        }
+        if (MAKEFOURCC('B', 'C', '4', 'U') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC4_UNORM;
+        }
+        if (MAKEFOURCC('B', 'C', '4', 'S') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC4_SNORM;
+        }
+
+        if (MAKEFOURCC('A', 'T', 'I', '2') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC5_UNORM;
+        }
+        if (MAKEFOURCC('B', 'C', '5', 'U') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC5_UNORM;
+        }
+        if (MAKEFOURCC('B', 'C', '5', 'S') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_BC5_SNORM;
+        }
+
+        // BC6H and BC7 are written using the "DX10" extended header
+
+        if (MAKEFOURCC('R', 'G', 'B', 'G') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_R8G8_B8G8_UNORM;
+        }
+        if (MAKEFOURCC('G', 'R', 'G', 'B') == ddpf.fourCC)
+        {
+            return DXGI_FORMAT_G8R8_G8B8_UNORM;
+        }
+
+        // Check for D3DFORMAT enums being set here
+        switch (ddpf.fourCC)
+        {
+        case 36: // D3DFMT_A16B16G16R16
+            return DXGI_FORMAT_R16G16B16A16_UNORM;
+
+        case 110: // D3DFMT_Q16W16V16U16
+            return DXGI_FORMAT_R16G16B16A16_SNORM;
+
+        case 111: // D3DFMT_R16F
+            return DXGI_FORMAT_R16_FLOAT;
+
+        case 112: // D3DFMT_G16R16F
+            return DXGI_FORMAT_R16G16_FLOAT;
+
+        case 113: // D3DFMT_A16B16G16R16F
+            return DXGI_FORMAT_R16G16B16A16_FLOAT;
+
+        case 114: // D3DFMT_R32F
+            return DXGI_FORMAT_R32_FLOAT;
+
+        case 115: // D3DFMT_G32R32F
+            return DXGI_FORMAT_R32G32_FLOAT;
+
+        case 116: // D3DFMT_A32B32G32R32F
+            return DXGI_FORMAT_R32G32B32A32_FLOAT;
+        }
+    }
+
+    return DXGI_FORMAT_UNKNOWN;
+}
+
+//--------------------------------------------------------------------------------------
+// D3D11 limits, see the D3D11_REQ_* values in d3d11.h
+//--------------------------------------------------------------------------------------
+static const uint32_t MaxMipLevels = DDSMaxMipLevels;
+static const uint32_t MaxDimension = 16384;         // 1D, 2D and cube textures
+static const uint32_t MaxVolumeDimension = 2048;
+static const uint32_t MaxArraySize = 2048;
+static const uint32_t MiscTextureCube = 0x4;        // D3D11_RESOURCE_MISC_TEXTURECUBE
+
+
+//--------------------------------------------------------------------------------------
+static uint32_t GetFullMipCount(uint32_t width, uint32_t height, uint32_t depth)
+{
+    uint32_t count = 1;
+    while (width > 1 || height > 1 || depth > 1)
+    {
+        width = std::max<uint32_t>(width >> 1, 1);
+        height = std::max<uint32_t>(height >> 1, 1);
+        depth = std::max<uint32_t>(depth >> 1, 1);
+        ++count;
+    }
+    return count;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Walk the first count mips of one array slice. Returns the bytes they take, fills mips
+// when it is given.
+//--------------------------------------------------------------------------------------
+static uint64_t WalkMipChain(
+    const DDSTextureDesc& desc,
+    const uint8_t* sliceData,
+    uint32_t count,
+    DDSSubresource* mips
+    )
+{
+    uint64_t w = desc.Width;
+    uint64_t h = desc.Height;
+    uint64_t d = desc.Depth;
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint64_t numBytes = 0;
+        uint64_t rowBytes = 0;
+        GetSurfaceInfo(w, h, desc.Format, &numBytes, &rowBytes);
+
+        if (mips)
+        {
+            DDSSubresource& mip = mips[i];
+            mip.Data = sliceData + offset;
+            mip.Size = static_cast<size_t>(numBytes * d);
+            mip.RowPitch = static_cast<size_t>(rowBytes);
+            mip.SlicePitch = static_cast<size_t>(numBytes);
+            mip.Width = static_cast<uint32_t>(w);
+            mip.Height = static_cast<uint32_t>(h);
+            mip.Depth = static_cast<uint32_t>(d);
+        }
+        offset += numBytes * d;
+
+        w = std::max<uint64_t>(w >> 1, 1);
+        h = std::max<uint64_t>(h >> 1, 1);
+        d = std::max<uint64_t>(d >> 1, 1);
+    }
+    return offset;
+}
+
+
+//--------------------------------------------------------------------------------------
+static DDSAlphaMode GetAlphaMode(const DDS_HEADER& header, const DDS_HEADER_DXT10* d3d10ext)
+{
+    if (d3d10ext)
+    {
+        uint32_t mode = d3d10ext->miscFlags2 & DDS_MISC_FLAGS2_ALPHA_MODE_MASK;
+        return mode <= DDS_ALPHA_MODE_CUSTOM ? static_cast<DDSAlphaMode>(mode) : DDSAlphaMode::Unknown;
+    }
+
+    if ((header.ddspf.flags & DDS_FOURCC) &&
+        ((MAKEFOURCC('D', 'X', 'T', '2') == header.ddspf.fourCC) ||
+         (MAKEFOURCC('D', 'X', 'T', '4') == header.ddspf.fourCC)))
+    {
+        return DDSAlphaMode::Premultiplied;
+    }
+
+    // DXT1, DXT3, and DXT5 legacy files could be straight alpha or something else, so return "Unknown" to leave it up to the app
+    return DDSAlphaMode::Unknown;
+}
+
+
+//--------------------------------------------------------------------------------------
+DDSResult DX::ParseDDSHeader(const uint8_t* ddsData, size_t ddsDataSize, DDSTextureDesc& desc)
+{
+    memset(&desc, 0, sizeof(desc));
+    if (!ddsData)
+    {
+        return DDSResult::InvalidArgument;
+    }
+
+    // The headers are copied out, the data may have any alignment
+    if (ddsDataSize < (sizeof(uint32_t) + sizeof(DDS_HEADER)))
+    {
+        return DDSResult::NotDDS;
+    }
+
+    uint32_t magic;
+    DDS_HEADER header;
+    memcpy(&magic, ddsData, sizeof(uint32_t));
+    memcpy(&header, ddsData + sizeof(uint32_t), sizeof(DDS_HEADER));
+    if (magic != DDS_MAGIC ||
+        header.size != sizeof(DDS_HEADER) ||
+        header.ddspf.size != sizeof(DDS_PIXELFORMAT))
+    {
+        return DDSResult::NotDDS;
+    }
+
+    desc.Width = header.width;
+    desc.Height = header.height;
+    desc.Depth = 1;
+    desc.MipCount = header.mipMapCount ? header.mipMapCount : 1;
+    desc.ArraySize = 1;
+    desc.DataOffset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+
+    if ((header.ddspf.flags & DDS_FOURCC) &&
+        (MAKEFOURCC('D', 'X', '1', '0') == header.ddspf.fourCC))
+    {
+        // Must be long enough for both headers and magic value
+        if (ddsDataSize < (sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10)))
+        {
+            return DDSResult::NotDDS;
+        }
+
+        DDS_HEADER_DXT10 d3d10ext;
+        memcpy(&d3d10ext, ddsData + desc.DataOffset, sizeof(DDS_HEADER_DXT10));
+        desc.DataOffset += sizeof(DDS_HEADER_DXT10);
+        desc.AlphaMode = GetAlphaMode(header, &d3d10ext);
+
+        desc.Format = static_cast<DXGI_FORMAT>(d3d10ext.dxgiFormat);
+        if (BitsPerPixel(desc.Format) == 0)
+        {
+            return DDSResult::UnsupportedFormat;
+        }
+
+        desc.ArraySize = d3d10ext.arraySize;
+        if (desc.ArraySize == 0 || desc.ArraySize > MaxArraySize)
+        {
+            return DDSResult::InvalidDimensions;
+        }
+
+        switch (static_cast<DDSDimension>(d3d10ext.resourceDimension))
+        {
+        case DDSDimension::Texture1D:
+            // D3DX writes 1D textures with a fixed Height of 1
+            if ((header.flags & DDS_HEIGHT) && desc.Height != 1)
+            {
+                return DDSResult::InvalidDimensions;
+            }
+            desc.Height = 1;
+            break;
+
+        case DDSDimension::Texture2D:
+            if (d3d10ext.miscFlag & MiscTextureCube)
+            {
+                if (desc.ArraySize > MaxArraySize / 6)
+                {
+                    return DDSResult::InvalidDimensions;
+                }
+                desc.ArraySize *= 6;
+                desc.IsCubeMap = true;
+            }
+            break;
+
+        case DDSDimension::Texture3D:
+            if (!(header.flags & DDS_HEADER_FLAGS_VOLUME) || desc.ArraySize > 1)
+            {
+                return DDSResult::InvalidDimensions;
+            }
+            desc.Depth = header.depth;
+            break;
+
+        default:
+            return DDSResult::UnsupportedFormat;
+        }
+
+        desc.Dimension = static_cast<DDSDimension>(d3d10ext.resourceDimension);
+    }
+    else
+    {
+        desc.AlphaMode = GetAlphaMode(header, nullptr);
+        desc.Format = GetDXGIFormat(header.ddspf);
+        if (desc.Format == DXGI_FORMAT_UNKNOWN)
+        {
+            return DDSResult::UnsupportedFormat;
+        }
+
+        if (header.flags & DDS_HEADER_FLAGS_VOLUME)
+        {
+            desc.Depth = header.depth;
+            desc.Dimension = DDSDimension::Texture3D;
+        }
+        else
+        {
+            if (header.caps2 & DDS_CUBEMAP)
+            {
+                // We require all six faces to be defined
+                if ((header.caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES)
+                {
+                    return DDSResult::InvalidDimensions;
+                }
+
+                desc.ArraySize = 6;
+                desc.IsCubeMap = true;
+            }
+
+            // Note there's no way for a legacy Direct3D 9 DDS to express a '1D' texture
+            desc.Dimension = DDSDimension::Texture2D;
+        }
+    }
+
+    // Bound sizes (for security purposes we don't trust DDS file metadata larger than the D3D 11.x hardware requirements)
+    uint32_t maxDimension = (desc.Dimension == DDSDimension::Texture3D) ? MaxVolumeDimension : MaxDimension;
+    if (desc.Width == 0 || desc.Height == 0 || desc.Depth == 0 ||
+        desc.Width > maxDimension || desc.Height > maxDimension || desc.Depth > maxDimension ||
+        desc.MipCount > MaxMipLevels || desc.MipCount > GetFullMipCount(desc.Width, desc.Height, desc.Depth))
+    {
+        return DDSResult::InvalidDimensions;
+    }
+
+    // Every array slice has the same mip chain
+    uint64_t sliceBytes = WalkMipChain(desc, nullptr, desc.MipCount, nullptr);
+    uint64_t available = ddsDataSize - desc.DataOffset;
+    if (sliceBytes > available / desc.ArraySize)
+    {
+        return DDSResult::OutOfBounds;
+    }
+    desc.SliceBytes = static_cast<size_t>(sliceBytes);
+
+    return DDSResult::Ok;
+}
+
+
+//--------------------------------------------------------------------------------------
+DDSResult DX::ParseDDS(const uint8_t* ddsData, size_t ddsDataSize, DDSDescriptor& descriptor)
+{
+    descriptor.SubresourceCount = 0;
+    DDSResult result = ParseDDSHeader(ddsData, ddsDataSize, descriptor.Texture);
+    if (result != DDSResult::Ok)
+    {
+        return result;
+    }
+
+    const DDSTextureDesc& desc = descriptor.Texture;
+    if (desc.MipCount * desc.ArraySize > DDSMaxSubresources)
+    {
+        return DDSResult::TooManySubresources;
+    }
+
+    // Walk the first slice, the others repeat it SliceBytes further on
+    WalkMipChain(desc, ddsData + desc.DataOffset, desc.MipCount, descriptor.Subresources);
+    for (uint32_t j = 1; j < desc.ArraySize; ++j)
+    {
+        for (uint32_t i = 0; i < desc.MipCount; ++i)
+        {
+            DDSSubresource& mip = descriptor.Subresources[j * desc.MipCount + i];
+            mip = descriptor.Subresources[i];
+            mip.Data += desc.SliceBytes * j;
+        }
+    }
+    descriptor.SubresourceCount = desc.MipCount * desc.ArraySize;
+
+    return DDSResult::Ok;
+}
+
+
+//--------------------------------------------------------------------------------------
+DDSSubresource DX::GetDDSSubresource(const uint8_t* ddsData, const DDSTextureDesc& desc, uint32_t slice, uint32_t mip)
+{
+    assert(slice < desc.ArraySize && mip < desc.MipCount);
+
+    DDSSubresource mips[MaxMipLevels];
+    WalkMipChain(desc, ddsData + desc.DataOffset + desc.SliceBytes * slice, mip + 1, mips);
+    return mips[mip];
+}
+
+
+//--------------------------------------------------------------------------------------
+void DX::GetDDSMipChain(const uint8_t* ddsData, const DDSTextureDesc& desc, uint32_t slice, DDSSubresource* mips)
+{
+    assert(slice < desc.ArraySize);
+
+    WalkMipChain(desc, ddsData + desc.DataOffset + desc.SliceBytes * slice, desc.MipCount, mips);
+}
+
+
+//--------------------------------------------------------------------------------------
+size_t DDSMipLayout::GetBytes(uint32_t topMip)const
+{
+    size_t bytes = 0;
+    for (uint32_t j = 0; j < ArraySize; ++j)
+    {
+        for (uint32_t i = topMip; i < MipCount; ++i)
+        {
+            bytes += GetMip(j, i).Size;
+        }
+    }
+    return bytes;
+}
+
+
+//--------------------------------------------------------------------------------------
+uint32_t DDSMipLayout::GetTopMip(size_t maxSize)const
+{
+    if (!maxSize || MipCount <= 1)
+    {
+        return 0;
+    }
+    for (uint32_t i = 0; i < MipCount; ++i)
+    {
+        const DDSMipInfo& mip = Mips[i];
+        if (mip.Width <= maxSize && mip.Height <= maxSize && mip.Depth <= maxSize)
+        {
+            return i;
+        }
+    }
+    return MipCount - 1;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <dxgiformat.h>
+
+// DDS header validation and subresource layout, without a device. Only the standard library
+// and dxgiformat.h are used, so tools and the streaming code can read texture metadata, and
+// the parser builds off Windows for fuzzing. Nothing is allocated: the headers are copied out
+// of the given bytes and subresources point back into them. Every size in a file is checked
+// against the D3D11 limits and the data length before it is used.
+
+namespace DX
+{
+	enum class DDSResult
+	{
+		Ok,
+		InvalidArgument,
+		NotDDS,					// Too short, wrong magic or wrong header sizes
+		UnsupportedFormat,
+		InvalidDimensions,		// Zero, above the D3D11 limits or inconsistent header fields
+		OutOfBounds,			// The data ends before the last subresource
+		TooManySubresources		// Valid, but more than DDSMaxSubresources
+	};
+
+	// Same values as D3D11_RESOURCE_DIMENSION
+	enum class DDSDimension : uint32_t
+	{
+		Texture1D = 2,
+		Texture2D = 3,
+		Texture3D = 4
+	};
+
+	enum class DDSAlphaMode : uint32_t
+	{
+		Unknown,
+		Straight,
+		Premultiplied,
+		Opaque,
+		Custom
+	};
+
+	struct DDSTextureDesc
+	{
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Depth;
+		uint32_t MipCount;
+		uint32_t ArraySize;		// Six per cube
+		DXGI_FORMAT Format;
+		DDSDimension Dimension;
+		DDSAlphaMode AlphaMode;
+		bool IsCubeMap;
+		size_t DataOffset;		// First subresource, from the start of the file
+		size_t SliceBytes;		// Mip chain of one array slice
+	};
+
+	struct DDSSubresource
+	{
+		const uint8_t* Data;
+		size_t Size;			// All depth slices
+		size_t RowPitch;
+		size_t SlicePitch;
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Depth;
+	};
+
+	// Mips of a full chain at the D3D11 limits
+	const uint32_t DDSMaxMipLevels = 15;
+	// Full mip chains of a cube map or of an eight slice array
+	const uint32_t DDSMaxSubresources = DDSMaxMipLevels * 8;
+
+	struct DDSDescriptor
+	{
+		DDSTextureDesc Texture;
+		uint32_t SubresourceCount;
+		// MipCount entries per array slice, slice after slice
+		DDSSubresource Subresources[DDSMaxSubresources];
+
+		const DDSSubresource& Get(uint32_t slice, uint32_t mip)const { return Subresources[slice * Texture.MipCount + mip]; }
+	};
+
+	// One subresource of a DDS file. Offset is from the start of the file.
+	struct DDSMipInfo
+	{
+		size_t Offset;
+		size_t Size;		// Bytes of all depth slices
+		size_t RowPitch;
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Depth;
+	};
+
+	// Subresource layout of a DDS file as offsets, a copy of the ParseDDS result for callers
+	// that keep it after the file data is gone. See GetDDSMipLayout of DDSTextureLoader.h.
+	struct DDSMipLayout
+	{
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Depth;
+		uint32_t MipCount;
+		uint32_t ArraySize;		// Six per cube
+		DXGI_FORMAT Format;
+		bool IsCubeMap;
+		// MipCount entries per array slice, slice after slice
+		std::vector<DDSMipInfo> Mips;
+
+		const DDSMipInfo& GetMip(uint32_t slice, uint32_t mip)const { return Mips[slice * MipCount + mip]; }
+		// Bytes of mips topMip and smaller over every slice
+		size_t GetBytes(uint32_t topMip)const;
+		// Largest mip whose width, height and depth fit maxSize, 0 for no limit. Same rule as
+		// the maxsize argument of CreateDDSTextureFromMemory.
+		uint32_t GetTopMip(size_t maxSize)const;
+	};
+
+	// Read and validate the headers, including that the data holds every subresource.
+	DDSResult ParseDDSHeader(const uint8_t* ddsData, size_t ddsDataSize, DDSTextureDesc& desc);
+	// Headers and subresources. On TooManySubresources the texture desc is still valid and
+	// GetDDSSubresource reaches every subresource.
+	DDSResult ParseDDS(const uint8_t* ddsData, size_t ddsDataSize, DDSDescriptor& descriptor);
+	// One subresource of a file ParseDDSHeader accepted.
+	DDSSubresource GetDDSSubresource(const uint8_t* ddsData, const DDSTextureDesc& desc, uint32_t slice, uint32_t mip);
+	// The MipCount subresources of one array slice of a file ParseDDSHeader accepted, in one
+	// walk of the chain. Loops over every subresource call this once per slice.
+	void GetDDSMipChain(const uint8_t* ddsData, const DDSTextureDesc& desc, uint32_t slice, DDSSubresource* mips);
+}
@@ -20,8 +20,18 @@
 
 #pragma once
 
+#include <vector>
+#include "DDSParser.h"
+
 namespace DX
 {
+	// Throws like the loaders below when the data is not a valid DDS file.
+	void GetDDSMipLayout(
+		_In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+		_In_ size_t ddsDataSize,
+		_Out_ DDSMipLayout& layout
+		);
+
 	void CreateDDSTextureFromMemory(
 		_In_ ID3D11Device* d3dDevice,
 		_In_ bool needMap,
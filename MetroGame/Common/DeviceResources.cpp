@@ -28,6 +28,10 @@ namespace DisplayMetrics
 	static const float HeightThreshold = 1080.0f;	// 1080p height.
 };
 
+// Room for the per-object data, cube face frames and skinned palettes of a frame before the
+// constant ring restarts.
+static const UINT ConstantRingCapacity = 4 * 1024 * 1024;
+
 // Constants used to calculate screen rotations
 namespace ScreenRotation
 {
@@ -66,6 +70,7 @@ namespace ScreenRotation
 
 // Constructor for DeviceResources.
 DX::DeviceResources::DeviceResources(MSAATYPE msaaType, bool restrictDpi /* = false */) :
+	m_stateTracker(new StateTracker()),
 	m_screenViewport(),
 	m_d3dFeatureLevel(D3D_FEATURE_LEVEL_9_1),
 	m_d3dRenderTargetSize(),
@@ -207,6 +212,18 @@ void DX::DeviceResources::CreateDeviceResources()
 	DX::ThrowIfFailed(
 		context.As(&m_d3dContext)
 		);
+	m_stateTracker->SetContext(m_d3dContext.Get());
+
+	// Constant data shares one ring when the driver allows it, else the plain buffers stay.
+	m_constantRing.reset();
+	if (ConstantRing::IsSupported(m_d3dDevice.Get()))
+	{
+		m_constantRing.reset(new ConstantRing());
+		if (!m_constantRing->Initialize(m_d3dDevice.Get(), ConstantRingCapacity))
+			m_constantRing.reset();
+	}
+	if (!m_constantRing)
+		OutputDebugString(L"No constant buffer offsetting, constant data goes through plain buffers.\n");
 
 	// Create the Direct2D device object and a corresponding context.
 	ComPtr<IDXGIDevice3> dxgiDevice;
@@ -247,7 +264,7 @@ void DX::DeviceResources::CreateWindowSizeDependentResources()
 	m_offScreenSurface = nullptr;
 	m_backBuffer = nullptr;
 	ID3D11RenderTargetView* nullViews[] = { nullptr };
-	m_d3dContext->OMSetRenderTargets(ARRAYSIZE(nullViews), nullViews, nullptr);
+	m_stateTracker->OMSetRenderTargets(ARRAYSIZE(nullViews), nullViews, nullptr);
 	m_d3dRenderTargetView = nullptr;
 	m_d2dContext->SetTarget(nullptr);
 	m_d2dTargetBitmap = nullptr;
@@ -1,5 +1,8 @@
 ﻿#pragma once
 
+#include "StateTracker.h"
+#include "ConstantRing.h"
+
 namespace DX
 {
     // Provides an interface for an application that owns DeviceResources to be notified of the device being lost or created.
@@ -50,6 +53,10 @@ namespace DX
 		ID3D11RenderTargetView1*	GetBackBufferRenderTargetView() const { return m_d3dRenderTargetView.Get(); }
 		ID3D11DepthStencilView*		GetDepthStencilView() const { return m_d3dDepthStencilView.Get(); }
 		D3D11_VIEWPORT				GetScreenViewport() const { return m_screenViewport; }
+		// Shared by everything that binds on the immediate context, see StateTracker.
+		StateTracker*				GetStateTracker() const { return m_stateTracker.get(); }
+		// Shared ring for constant data, nullptr when the driver can not bind by offset.
+		ConstantRing*				GetConstantRing() const { return m_constantRing.get(); }
 		DirectX::XMFLOAT4X4			GetOrientationTransform3D() const { return m_orientationTransform3D; }
 
 		// D2D Accessors.
@@ -72,6 +79,8 @@ namespace DX
 		Microsoft::WRL::ComPtr<ID3D11Device3>			m_d3dDevice;
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext3>	m_d3dContext;
 		Microsoft::WRL::ComPtr<IDXGISwapChain3>			m_swapChain;
+		std::unique_ptr<StateTracker>					m_stateTracker;
+		std::unique_ptr<ConstantRing>					m_constantRing;
 
 		// Direct3D rendering objects. Required for 3D.
 		Microsoft::WRL::ComPtr<ID3D11RenderTargetView1>	m_d3dRenderTargetView;
@@ -88,8 +88,6 @@ namespace DX
 		return x;
 	}
 
-	void ExtractFrustumPlanes(DirectX::XMFLOAT4 planes[6], const DirectX::XMFLOAT4X4& M);
-
 	void CreateRandomTexture1DSRV(ID3D11Device* device, ID3D11ShaderResourceView** textureView);
 
 	// #define XMGLOBALCONST extern CONST __declspec(selectany)
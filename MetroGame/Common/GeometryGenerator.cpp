@@ -5,212 +5,63 @@
 #include "pch.h"
 #include "GeometryGenerator.h"
 #include "MathHelper.h"
+#include <ppl.h>
+#include <unordered_map>
 
 using namespace DX;
 using namespace DirectX;
 
 void GeometryGenerator::CreateBox(float width, float height, float depth, MeshData& meshData)
 {
-	//
-	// Create the vertices.
-	//
-
-	Vertex v[24];
-
-	float w2 = 0.5f*width;
-	float h2 = 0.5f*height;
-	float d2 = 0.5f*depth;
-	
-	// Fill in the front face vertex data.
-	v[0] = Vertex(-w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-	v[1] = Vertex(-w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	v[2] = Vertex(+w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-	v[3] = Vertex(+w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-
-	// Fill in the back face vertex data.
-	v[4] = Vertex(-w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-	v[5] = Vertex(+w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-	v[6] = Vertex(+w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	v[7] = Vertex(-w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-
-	// Fill in the top face vertex data.
-	v[8]  = Vertex(-w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-	v[9]  = Vertex(-w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	v[10] = Vertex(+w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-	v[11] = Vertex(+w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-
-	// Fill in the bottom face vertex data.
-	v[12] = Vertex(-w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
-	v[13] = Vertex(+w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
-	v[14] = Vertex(+w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	v[15] = Vertex(-w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-
-	// Fill in the left face vertex data.
-	v[16] = Vertex(-w2, -h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f);
-	v[17] = Vertex(-w2, +h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f);
-	v[18] = Vertex(-w2, +h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f);
-	v[19] = Vertex(-w2, -h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f);
-
-	// Fill in the right face vertex data.
-	v[20] = Vertex(+w2, -h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f);
-	v[21] = Vertex(+w2, +h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
-	v[22] = Vertex(+w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
-	v[23] = Vertex(+w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
-
-	meshData.Vertices.assign(&v[0], &v[24]);
- 
-	//
-	// Create the indices.
-	//
-
-	UINT i[36];
-
-	// Fill in the front face index data
-	i[0] = 0; i[1] = 1; i[2] = 2;
-	i[3] = 0; i[4] = 2; i[5] = 3;
-
-	// Fill in the back face index data
-	i[6] = 4; i[7]  = 5; i[8]  = 6;
-	i[9] = 4; i[10] = 6; i[11] = 7;
-
-	// Fill in the top face index data
-	i[12] = 8; i[13] =  9; i[14] = 10;
-	i[15] = 8; i[16] = 10; i[17] = 11;
-
-	// Fill in the bottom face index data
-	i[18] = 12; i[19] = 13; i[20] = 14;
-	i[21] = 12; i[22] = 14; i[23] = 15;
-
-	// Fill in the left face index data
-	i[24] = 16; i[25] = 17; i[26] = 18;
-	i[27] = 16; i[28] = 18; i[29] = 19;
-
-	// Fill in the right face index data
-	i[30] = 20; i[31] = 21; i[32] = 22;
-	i[33] = 20; i[34] = 22; i[35] = 23;
-
-	meshData.Indices.assign(&i[0], &i[36]);
+	meshData.Vertices.resize(GetBoxVertexCount());
+	meshData.Indices.resize(GetBoxIndexCount());
+	CreateBox<VertexPolicy>(width, height, depth, meshData.Vertices.data(), meshData.Indices.data());
 }
 
 void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, MeshData& meshData)
 {
-	meshData.Vertices.clear();
-	meshData.Indices.clear();
+	meshData.Vertices.resize(GetSphereVertexCount(sliceCount, stackCount));
+	meshData.Indices.resize(GetSphereIndexCount(sliceCount, stackCount));
+	CreateSphere<VertexPolicy>(radius, sliceCount, stackCount, meshData.Vertices.data(), meshData.Indices.data());
+}
 
-	//
-	// Compute the vertices stating at the top pole and moving down the stacks.
-	//
+// Undirected edge, the smaller index in the high half
+static inline UINT64 EdgeKey(UINT a, UINT b)
+{
+	return a < b ? ((UINT64)a << 32) | b : ((UINT64)b << 32) | a;
+}
 
-	// Poles: note that there will be texture coordinate distortion as there is
-	// not a unique point on the texture map to assign to the pole when mapping
-	// a rectangular texture onto a sphere.
-	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+static inline UINT EdgeStripe(UINT64 key)
+{
+	return (UINT)((key * 0x9E3779B97F4A7C15ull) >> 60);
+}
 
-	meshData.Vertices.push_back( topVertex );
+// Corner that ends the edge starting at corner i, in the same triangle
+static inline UINT NextCorner(UINT i)
+{
+	return (i % 3 == 2) ? i - 2 : i + 1;
+}
 
-	float phiStep   = XM_PI/stackCount;
-	float thetaStep = 2.0f*XM_PI/sliceCount;
+// Meshes with fewer triangles are subdivided on the calling thread
+static const UINT ParallelTriangles = 4096;
+static const UINT EdgeStripeCount = 16;
 
-	// Compute vertices for each stack ring (do not count the poles as rings).
-	for(UINT i = 1; i <= stackCount-1; ++i)
+template<typename Func>
+static void ForEachIndex(UINT count, bool parallel, const Func& func)
+{
+	if(parallel)
 	{
-		float phi = i*phiStep;
-
-		// Vertices of ring.
-		for(UINT j = 0; j <= sliceCount; ++j)
-		{
-			float theta = j*thetaStep;
-
-			Vertex v;
-
-			// spherical to cartesian
-			v.Position.x = radius*sinf(phi)*cosf(theta);
-			v.Position.y = radius*cosf(phi);
-			v.Position.z = radius*sinf(phi)*sinf(theta);
-
-			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius*sinf(phi)*sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius*sinf(phi)*cosf(theta);
-
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
-
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
-
-			v.TexC.x = theta / XM_2PI;
-			v.TexC.y = phi / XM_PI;
-
-			meshData.Vertices.push_back( v );
-		}
+		concurrency::parallel_for(UINT(0), count, func);
 	}
-
-	meshData.Vertices.push_back( bottomVertex );
-
-	//
-	// Compute indices for top stack.  The top stack was written first to the vertex buffer
-	// and connects the top pole to the first ring.
-	//
-
-	for(UINT i = 1; i <= sliceCount; ++i)
+	else
 	{
-		meshData.Indices.push_back(0);
-		meshData.Indices.push_back(i+1);
-		meshData.Indices.push_back(i);
-	}
-	
-	//
-	// Compute indices for inner stacks (not connected to poles).
-	//
-
-	// Offset the indices to the index of the first vertex in the first ring.
-	// This is just skipping the top pole vertex.
-	UINT baseIndex = 1;
-	UINT ringVertexCount = sliceCount+1;
-	for(UINT i = 0; i < stackCount-2; ++i)
-	{
-		for(UINT j = 0; j < sliceCount; ++j)
-		{
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices.push_back(baseIndex + (i+1)*ringVertexCount + j);
-
-			meshData.Indices.push_back(baseIndex + (i+1)*ringVertexCount + j);
-			meshData.Indices.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
-		}
-	}
-
-	//
-	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
-	// and connects the bottom pole to the bottom ring.
-	//
-
-	// South pole vertex was added last.
-	UINT southPoleIndex = (UINT)meshData.Vertices.size()-1;
-
-	// Offset the indices to the index of the first vertex in the last ring.
-	baseIndex = southPoleIndex - ringVertexCount;
-	
-	for(UINT i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices.push_back(southPoleIndex);
-		meshData.Indices.push_back(baseIndex+i);
-		meshData.Indices.push_back(baseIndex+i+1);
+		for(UINT i = 0; i < count; ++i)
+			func(i);
 	}
 }
- 
-void GeometryGenerator::Subdivide(MeshData& meshData)
-{
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
-
-	meshData.Vertices.resize(0);
-	meshData.Indices.resize(0);
 
+void GeometryGenerator::Subdivide(std::vector<XMFLOAT3>& positions, std::vector<UINT>& indices)
+{
 	//       v1
 	//       *
 	//      / \
@@ -221,70 +72,96 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	// *-----*-----*
 	// v0    m2     v2
 
-	UINT numTris = inputCopy.Indices.size()/3;
-	for(UINT i = 0; i < numTris; ++i)
-	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices[i*3+2] ];
-
-		//
-		// Generate the midpoints.
-		//
-
-		Vertex m0, m1, m2;
-
-		// For subdivision, we just care about the position component.  We derive the other
-		// vertex components in CreateGeosphere.
-
-		m0.Position = XMFLOAT3(
-			0.5f*(v0.Position.x + v1.Position.x),
-			0.5f*(v0.Position.y + v1.Position.y),
-			0.5f*(v0.Position.z + v1.Position.z));
-
-		m1.Position = XMFLOAT3(
-			0.5f*(v1.Position.x + v2.Position.x),
-			0.5f*(v1.Position.y + v2.Position.y),
-			0.5f*(v1.Position.z + v2.Position.z));
-
-		m2.Position = XMFLOAT3(
-			0.5f*(v0.Position.x + v2.Position.x),
-			0.5f*(v0.Position.y + v2.Position.y),
-			0.5f*(v0.Position.z + v2.Position.z));
-
-		//
-		// Add new geometry.
-		//
-
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices.push_back(i*6+0);
-		meshData.Indices.push_back(i*6+3);
-		meshData.Indices.push_back(i*6+5);
+	// Each edge gets one midpoint, shared by the two triangles on either side of it. Edges are
+	// hashed into stripes; every stripe numbers its edges in the order they are first met, so
+	// the result does not depend on the number of threads.
+	UINT numTris = (UINT)indices.size()/3;
+	UINT numVertices = (UINT)positions.size();
+	bool parallel = numTris >= ParallelTriangles;
+
+	// One pass sorts the corners by the stripe of the edge they start, in index order, so each
+	// stripe only walks its own corners.
+	std::vector<UINT> stripeCorners[EdgeStripeCount];
+	for(UINT stripe = 0; stripe < EdgeStripeCount; ++stripe)
+		stripeCorners[stripe].reserve(indices.size()/EdgeStripeCount*9/8 + 1);
+	for(UINT i = 0; i < (UINT)indices.size(); ++i)
+		stripeCorners[EdgeStripe(EdgeKey(indices[i], indices[NextCorner(i)]))].push_back(i);
+
+	// Midpoint of the edge from corner e to corner (e+1)%3 of triangle i, at i*3+e. Holds the
+	// index within the stripe until the stripe offsets are known.
+	std::vector<UINT> midpoints(indices.size());
+	std::vector<UINT64> stripeEdges[EdgeStripeCount];
+	ForEachIndex(EdgeStripeCount, parallel, [&](UINT stripe)
+	{
+		const std::vector<UINT>& corners = stripeCorners[stripe];
+		std::unordered_map<UINT64, UINT> edgeMap;
+		edgeMap.reserve(corners.size()/2 + 1);
+		std::vector<UINT64>& edges = stripeEdges[stripe];
+		edges.reserve(corners.size()/2 + 1);
+		for(UINT i : corners)
+		{
+			UINT64 key = EdgeKey(indices[i], indices[NextCorner(i)]);
+			auto result = edgeMap.emplace(key, (UINT)edges.size());
+			if(result.second)
+				edges.push_back(key);
+			midpoints[i] = result.first->second;
+		}
+	});
 
-		meshData.Indices.push_back(i*6+3);
-		meshData.Indices.push_back(i*6+4);
-		meshData.Indices.push_back(i*6+5);
+	UINT stripeOffsets[EdgeStripeCount];
+	UINT newVertexCount = numVertices;
+	for(UINT i = 0; i < EdgeStripeCount; ++i)
+	{
+		stripeOffsets[i] = newVertexCount;
+		newVertexCount += (UINT)stripeEdges[i].size();
+	}
 
-		meshData.Indices.push_back(i*6+5);
-		meshData.Indices.push_back(i*6+4);
-		meshData.Indices.push_back(i*6+2);
+	// For subdivision, we just care about the position component.  We derive the other
+	// vertex components in CreateGeosphere.
+	positions.resize(newVertexCount);
+	ForEachIndex(EdgeStripeCount, parallel, [&](UINT stripe)
+	{
+		const std::vector<UINT64>& edges = stripeEdges[stripe];
+		for(UINT i = 0; i < (UINT)edges.size(); ++i)
+		{
+			const XMFLOAT3& p0 = positions[(UINT)(edges[i] >> 32)];
+			const XMFLOAT3& p1 = positions[(UINT)edges[i]];
+			positions[stripeOffsets[stripe] + i] = XMFLOAT3(
+				0.5f*(p0.x + p1.x),
+				0.5f*(p0.y + p1.y),
+				0.5f*(p0.z + p1.z));
+		}
+		for(UINT i : stripeCorners[stripe])
+			midpoints[i] += stripeOffsets[stripe];
+	});
 
-		meshData.Indices.push_back(i*6+3);
-		meshData.Indices.push_back(i*6+1);
-		meshData.Indices.push_back(i*6+4);
-	}
+	std::vector<UINT> newIndices(numTris*12);
+	ForEachIndex(numTris, parallel, [&](UINT i)
+	{
+		UINT v[3];
+		UINT m[3];
+		for(UINT e = 0; e < 3; ++e)
+		{
+			v[e] = indices[i*3+e];
+			m[e] = midpoints[i*3+e];
+		}
+		// m[0] lies on v0-v1, m[1] on v1-v2 and m[2] on v2-v0
+		UINT tris[12] =
+		{
+			v[0], m[0], m[2],
+			m[0], m[1], m[2],
+			m[2], m[1], v[2],
+			m[0], v[1], m[1]
+		};
+		memcpy(&newIndices[i*12], tris, sizeof(tris));
+	});
+	indices.swap(newIndices);
 }
 
-void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData)
+void GeometryGenerator::BuildGeosphere(UINT numSubdivisions, std::vector<XMFLOAT3>& positions, std::vector<UINT>& indices)
 {
 	// Put a cap on the number of subdivisions.
-	numSubdivisions = MathHelper::Min(numSubdivisions, 5u);
+	numSubdivisions = MathHelper::Min(numSubdivisions, (UINT)MaxGeosphereSubdivisions);
 
 	// Approximate a sphere by tessellating an icosahedron.
 
@@ -309,314 +186,40 @@ void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, Mesh
 		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7 
 	};
 
-	meshData.Vertices.resize(12);
-	meshData.Indices.resize(60);
-
-	for(UINT i = 0; i < 12; ++i)
-		meshData.Vertices[i].Position = pos[i];
-
-	for(UINT i = 0; i < 60; ++i)
-		meshData.Indices[i] = k[i];
+	// Every subdivision adds one vertex per edge and turns each triangle into four, so the
+	// final sizes are known before the first one.
+	positions.reserve(GetGeosphereVertexCount(numSubdivisions));
+	positions.assign(&pos[0], &pos[12]);
+	indices.assign(&k[0], &k[60]);
 
 	for(UINT i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshData);
-
-	// Project vertices onto sphere and scale.
-	for(UINT i = 0; i < meshData.Vertices.size(); ++i)
-	{
-		// Project onto unit sphere.
-		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
-
-		// Project onto sphere.
-		XMVECTOR p = radius*n;
-
-		XMStoreFloat3(&meshData.Vertices[i].Position, p);
-		XMStoreFloat3(&meshData.Vertices[i].Normal, n);
-
-		// Derive texture coordinates from spherical coordinates.
-		float theta = MathHelper::AngleFromXY(
-			meshData.Vertices[i].Position.x, 
-			meshData.Vertices[i].Position.z);
-
-		float phi = acosf(meshData.Vertices[i].Position.y / radius);
-
-		meshData.Vertices[i].TexC.x = theta/XM_2PI;
-		meshData.Vertices[i].TexC.y = phi/XM_PI;
-
-		// Partial derivative of P with respect to theta
-		meshData.Vertices[i].TangentU.x = -radius*sinf(phi)*sinf(theta);
-		meshData.Vertices[i].TangentU.y = 0.0f;
-		meshData.Vertices[i].TangentU.z = +radius*sinf(phi)*cosf(theta);
-
-		XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
-		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
-	}
+		Subdivide(positions, indices);
 }
 
-void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData)
-{
-	meshData.Vertices.clear();
-	meshData.Indices.clear();
-
-	//
-	// Build Stacks.
-	// 
-
-	float stackHeight = height / stackCount;
-
-	// Amount to increment radius as we move up each stack level from bottom to top.
-	float radiusStep = (topRadius - bottomRadius) / stackCount;
-
-	UINT ringCount = stackCount+1;
-
-	// Compute vertices for each stack ring starting at the bottom and moving up.
-	for(UINT i = 0; i < ringCount; ++i)
-	{
-		float y = -0.5f*height + i*stackHeight;
-		float r = bottomRadius + i*radiusStep;
-
-		// vertices of ring
-		float dTheta = 2.0f*XM_PI/sliceCount;
-		for(UINT j = 0; j <= sliceCount; ++j)
-		{
-			Vertex vertex;
-
-			float c = cosf(j*dTheta);
-			float s = sinf(j*dTheta);
-
-			vertex.Position = XMFLOAT3(r*c, y, r*s);
-
-			vertex.TexC.x = (float)j/sliceCount;
-			vertex.TexC.y = 1.0f - (float)i/stackCount;
-
-			// Cylinder can be parameterized as follows, where we introduce v
-			// parameter that goes in the same direction as the v tex-coord
-			// so that the bitangent goes in the same direction as the v tex-coord.
-			//   Let r0 be the bottom radius and let r1 be the top radius.
-			//   y(v) = h - hv for v in [0,1].
-			//   r(v) = r1 + (r0-r1)v
-			//
-			//   x(t, v) = r(v)*cos(t)
-			//   y(t, v) = h - hv
-			//   z(t, v) = r(v)*sin(t)
-			// 
-			//  dx/dt = -r(v)*sin(t)
-			//  dy/dt = 0
-			//  dz/dt = +r(v)*cos(t)
-			//
-			//  dx/dv = (r0-r1)*cos(t)
-			//  dy/dv = -h
-			//  dz/dv = (r0-r1)*sin(t)
-
-			// This is unit length.
-			vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
-
-			float dr = bottomRadius-topRadius;
-			XMFLOAT3 bitangent(dr*c, -height, dr*s);
-
-			XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
-			XMVECTOR B = XMLoadFloat3(&bitangent);
-			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
-			XMStoreFloat3(&vertex.Normal, N);
-
-			meshData.Vertices.push_back(vertex);
-		}
-	}
-
-	// Add one because we duplicate the first and last vertex per ring
-	// since the texture coordinates are different.
-	UINT ringVertexCount = sliceCount+1;
-
-	// Compute indices for each stack.
-	for(UINT i = 0; i < stackCount; ++i)
-	{
-		for(UINT j = 0; j < sliceCount; ++j)
-		{
-			meshData.Indices.push_back(i*ringVertexCount + j);
-			meshData.Indices.push_back((i+1)*ringVertexCount + j);
-			meshData.Indices.push_back((i+1)*ringVertexCount + j+1);
-
-			meshData.Indices.push_back(i*ringVertexCount + j);
-			meshData.Indices.push_back((i+1)*ringVertexCount + j+1);
-			meshData.Indices.push_back(i*ringVertexCount + j+1);
-		}
-	}
-
-	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-}
-
-void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height, 
-											UINT sliceCount, UINT stackCount, MeshData& meshData)
+void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData)
 {
-	UINT baseIndex = (UINT)meshData.Vertices.size();
-
-	float y = 0.5f*height;
-	float dTheta = 2.0f*XM_PI/sliceCount;
-
-	// Duplicate cap ring vertices because the texture coordinates and normals differ.
-	for(UINT i = 0; i <= sliceCount; ++i)
-	{
-		float x = topRadius*cosf(i*dTheta);
-		float z = topRadius*sinf(i*dTheta);
-
-		// Scale down by the height to try and make top cap texture coord area
-		// proportional to base.
-		float u = x/height + 0.5f;
-		float v = z/height + 0.5f;
-
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
-	}
-
-	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
-
-	// Index of center vertex.
-	UINT centerIndex = (UINT)meshData.Vertices.size()-1;
-
-	for(UINT i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices.push_back(centerIndex);
-		meshData.Indices.push_back(baseIndex + i+1);
-		meshData.Indices.push_back(baseIndex + i);
-	}
+	meshData.Vertices.resize(GetGeosphereVertexCount(numSubdivisions));
+	meshData.Indices.resize(GetGeosphereIndexCount(numSubdivisions));
+	CreateGeosphere<VertexPolicy>(radius, numSubdivisions, meshData.Vertices.data(), meshData.Indices.data());
 }
 
-void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, 
-											   UINT sliceCount, UINT stackCount, MeshData& meshData)
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData)
 {
-	// 
-	// Build bottom cap.
-	//
-
-	UINT baseIndex = (UINT)meshData.Vertices.size();
-	float y = -0.5f*height;
-
-	// vertices of ring
-	float dTheta = 2.0f*XM_PI/sliceCount;
-	for(UINT i = 0; i <= sliceCount; ++i)
-	{
-		float x = bottomRadius*cosf(i*dTheta);
-		float z = bottomRadius*sinf(i*dTheta);
-
-		// Scale down by the height to try and make top cap texture coord area
-		// proportional to base.
-		float u = x/height + 0.5f;
-		float v = z/height + 0.5f;
-
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
-	}
-
-	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
-
-	// Cache the index of center vertex.
-	UINT centerIndex = (UINT)meshData.Vertices.size()-1;
-
-	for(UINT i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices.push_back(centerIndex);
-		meshData.Indices.push_back(baseIndex + i);
-		meshData.Indices.push_back(baseIndex + i+1);
-	}
+	meshData.Vertices.resize(GetCylinderVertexCount(sliceCount, stackCount));
+	meshData.Indices.resize(GetCylinderIndexCount(sliceCount, stackCount));
+	CreateCylinder<VertexPolicy>(bottomRadius, topRadius, height, sliceCount, stackCount, meshData.Vertices.data(), meshData.Indices.data());
 }
 
 void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, MeshData& meshData)
 {
-	UINT vertexCount = m*n;
-	UINT faceCount   = (m-1)*(n-1)*2;
-
-	//
-	// Create the vertices.
-	//
-
-	float halfWidth = 0.5f*width;
-	float halfDepth = 0.5f*depth;
-
-	float dx = width / (n-1);
-	float dz = depth / (m-1);
-
-	float du = 1.0f / (n-1);
-	float dv = 1.0f / (m-1);
-
-	meshData.Vertices.resize(vertexCount);
-	for(UINT i = 0; i < m; ++i)
-	{
-		float z = halfDepth - i*dz;
-		for(UINT j = 0; j < n; ++j)
-		{
-			float x = -halfWidth + j*dx;
-
-			meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-			// Stretch texture over grid.
-			meshData.Vertices[i*n+j].TexC.x = j*du;
-			meshData.Vertices[i*n+j].TexC.y = i*dv;
-		}
-	}
- 
-	//
-	// Create the indices.
-	//
-
-	meshData.Indices.resize(faceCount*3); // 3 indices per face
-
-	// Iterate over each quad and compute indices.
-	UINT k = 0;
-	for(UINT i = 0; i < m-1; ++i)
-	{
-		for(UINT j = 0; j < n-1; ++j)
-		{
-			meshData.Indices[k]   = i*n+j;
-			meshData.Indices[k+1] = i*n+j+1;
-			meshData.Indices[k+2] = (i+1)*n+j;
-
-			meshData.Indices[k+3] = (i+1)*n+j;
-			meshData.Indices[k+4] = i*n+j+1;
-			meshData.Indices[k+5] = (i+1)*n+j+1;
-
-			k += 6; // next quad
-		}
-	}
+	meshData.Vertices.resize(GetGridVertexCount(m, n));
+	meshData.Indices.resize(GetGridIndexCount(m, n));
+	CreateGrid<VertexPolicy>(width, depth, m, n, meshData.Vertices.data(), meshData.Indices.data());
 }
 
 void GeometryGenerator::CreateFullscreenQuad(MeshData& meshData)
 {
-	meshData.Vertices.resize(4);
-	meshData.Indices.resize(6);
-
-	// Position coordinates specified in NDC space.
-	meshData.Vertices[0] = Vertex(
-		-1.0f, -1.0f, 0.0f, 
-		0.0f, 0.0f, -1.0f,
-		1.0f, 0.0f, 0.0f,
-		0.0f, 1.0f);
-
-	meshData.Vertices[1] = Vertex(
-		-1.0f, +1.0f, 0.0f, 
-		0.0f, 0.0f, -1.0f,
-		1.0f, 0.0f, 0.0f,
-		0.0f, 0.0f);
-
-	meshData.Vertices[2] = Vertex(
-		+1.0f, +1.0f, 0.0f, 
-		0.0f, 0.0f, -1.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f);
-
-	meshData.Vertices[3] = Vertex(
-		+1.0f, -1.0f, 0.0f, 
-		0.0f, 0.0f, -1.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 1.0f);
-
-	meshData.Indices[0] = 0;
-	meshData.Indices[1] = 1;
-	meshData.Indices[2] = 2;
-
-	meshData.Indices[3] = 0;
-	meshData.Indices[4] = 2;
-	meshData.Indices[5] = 3;
+	meshData.Vertices.resize(GetFullscreenQuadVertexCount());
+	meshData.Indices.resize(GetFullscreenQuadIndexCount());
+	CreateFullscreenQuad<VertexPolicy>(meshData.Vertices.data(), meshData.Indices.data());
 }
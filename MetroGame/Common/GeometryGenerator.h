@@ -14,10 +14,48 @@
 
 #pragma once
 
-#include "DirectXHelper.h"
+#include "MathHelper.h"
+#include <vector>
 
 namespace DX
 {
+	// Output vertex policies of the templated generators, which write straight into a caller
+	// buffer of VertexType. Attributes a policy does not store are never computed, so tangents
+	// cost nothing for Basic32 and only positions are computed for position only vertices.
+	template<typename V>
+	struct PosPolicy
+	{
+		typedef V VertexType;
+		static const bool HasNormal = false;
+		static const bool HasTexC = false;
+		static const bool HasTangent = false;
+
+		static void SetPosition(V& v, const DirectX::XMFLOAT3& p) { v.Pos = p; }
+		static void SetNormal(V&, const DirectX::XMFLOAT3&) {}
+		static void SetTexC(V&, const DirectX::XMFLOAT2&) {}
+		static void SetTangent(V&, const DirectX::XMFLOAT3&) {}
+	};
+
+	// Pos, Normal and Tex, such as Basic32
+	template<typename V>
+	struct PosNormalTexPolicy : PosPolicy<V>
+	{
+		static const bool HasNormal = true;
+		static const bool HasTexC = true;
+
+		static void SetNormal(V& v, const DirectX::XMFLOAT3& n) { v.Normal = n; }
+		static void SetTexC(V& v, const DirectX::XMFLOAT2& t) { v.Tex = t; }
+	};
+
+	// TangentU as well, such as PosNormalTexTan
+	template<typename V>
+	struct PosNormalTexTanPolicy : PosNormalTexPolicy<V>
+	{
+		static const bool HasTangent = true;
+
+		static void SetTangent(V& v, const DirectX::XMFLOAT3& t) { v.TangentU = t; }
+	};
+
 	class GeometryGenerator
 	{
 	public:
@@ -40,28 +78,73 @@ namespace DX
 			DirectX::XMFLOAT2 TexC;
 		};
 
+		// Policy of Vertex, used by the MeshData overloads.
+		struct VertexPolicy
+		{
+			typedef Vertex VertexType;
+			static const bool HasNormal = true;
+			static const bool HasTexC = true;
+			static const bool HasTangent = true;
+
+			static void SetPosition(Vertex& v, const DirectX::XMFLOAT3& p) { v.Position = p; }
+			static void SetNormal(Vertex& v, const DirectX::XMFLOAT3& n) { v.Normal = n; }
+			static void SetTexC(Vertex& v, const DirectX::XMFLOAT2& t) { v.TexC = t; }
+			static void SetTangent(Vertex& v, const DirectX::XMFLOAT3& t) { v.TangentU = t; }
+		};
+
 		struct MeshData
 		{
 			std::vector<Vertex> Vertices;
 			std::vector<UINT> Indices;
 		};
 
+		static const UINT MaxGeosphereSubdivisions = 8;
+
+		///<summary>
+		/// Vertex and index counts of each shape, so that callers of the templated
+		/// generators allocate the output buffers once.
+		///</summary>
+		static constexpr UINT GetBoxVertexCount() { return 24; }
+		static constexpr UINT GetBoxIndexCount() { return 36; }
+		static constexpr UINT GetSphereVertexCount(UINT sliceCount, UINT stackCount) { return (stackCount-1)*(sliceCount+1) + 2; }
+		static constexpr UINT GetSphereIndexCount(UINT sliceCount, UINT stackCount) { return (stackCount-1)*sliceCount*6; }
+		static constexpr UINT GetGeosphereVertexCount(UINT numSubdivisions)
+		{
+			return 10*(1u << (2*(numSubdivisions < MaxGeosphereSubdivisions ? numSubdivisions : MaxGeosphereSubdivisions))) + 2;
+		}
+		static constexpr UINT GetGeosphereIndexCount(UINT numSubdivisions)
+		{
+			return 60*(1u << (2*(numSubdivisions < MaxGeosphereSubdivisions ? numSubdivisions : MaxGeosphereSubdivisions)));
+		}
+		static constexpr UINT GetCylinderVertexCount(UINT sliceCount, UINT stackCount) { return (stackCount+1)*(sliceCount+1) + 2*(sliceCount+2); }
+		static constexpr UINT GetCylinderIndexCount(UINT sliceCount, UINT stackCount) { return (stackCount+1)*sliceCount*6; }
+		static constexpr UINT GetGridVertexCount(UINT m, UINT n) { return m*n; }
+		static constexpr UINT GetGridIndexCount(UINT m, UINT n) { return (m-1)*(n-1)*6; }
+		static constexpr UINT GetFullscreenQuadVertexCount() { return 4; }
+		static constexpr UINT GetFullscreenQuadIndexCount() { return 6; }
+
 		///<summary>
 		/// Creates a box centered at the origin with the given dimensions.
 		///</summary>
 		void CreateBox(float width, float height, float depth, MeshData& meshData);
+		template<typename Policy>
+		void CreateBox(float width, float height, float depth, typename Policy::VertexType* vertices, UINT* indices);
 
 		///<summary>
 		/// Creates a sphere centered at the origin with the given radius.  The
 		/// slices and stacks parameters control the degree of tessellation.
 		///</summary>
 		void CreateSphere(float radius, UINT sliceCount, UINT stackCount, MeshData& meshData);
+		template<typename Policy>
+		void CreateSphere(float radius, UINT sliceCount, UINT stackCount, typename Policy::VertexType* vertices, UINT* indices);
 
 		///<summary>
 		/// Creates a geosphere centered at the origin with the given radius.  The
 		/// depth controls the level of tessellation.
 		///</summary>
 		void CreateGeosphere(float radius, UINT numSubdivisions, MeshData& meshData);
+		template<typename Policy>
+		void CreateGeosphere(float radius, UINT numSubdivisions, typename Policy::VertexType* vertices, UINT* indices);
 
 		///<summary>
 		/// Creates a cylinder parallel to the y-axis, and centered about the origin.  
@@ -69,22 +152,567 @@ namespace DX
 		// cylinders.  The slices and stacks parameters control the degree of tessellation.
 		///</summary>
 		void CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
+		template<typename Policy>
+		void CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+			typename Policy::VertexType* vertices, UINT* indices);
 
 		///<summary>
 		/// Creates an mxn grid in the xz-plane with m rows and n columns, centered
 		/// at the origin with the specified width and depth.
 		///</summary>
 		void CreateGrid(float width, float depth, UINT m, UINT n, MeshData& meshData);
+		template<typename Policy>
+		void CreateGrid(float width, float depth, UINT m, UINT n, typename Policy::VertexType* vertices, UINT* indices);
 
 		///<summary>
 		/// Creates a quad covering the screen in NDC coordinates.  This is useful for
 		/// postprocessing effects.
 		///</summary>
 		void CreateFullscreenQuad(MeshData& meshData);
+		template<typename Policy>
+		void CreateFullscreenQuad(typename Policy::VertexType* vertices, UINT* indices);
 
 	private:
-		void Subdivide(MeshData& meshData);
-		void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
-		void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount, MeshData& meshData);
+		static void Subdivide(std::vector<DirectX::XMFLOAT3>& positions, std::vector<UINT>& indices);
+		static void BuildGeosphere(UINT numSubdivisions, std::vector<DirectX::XMFLOAT3>& positions, std::vector<UINT>& indices);
+		template<typename Policy>
+		static void SetVertex(typename Policy::VertexType& vertex,
+			float px, float py, float pz,
+			float nx, float ny, float nz,
+			float tx, float ty, float tz,
+			float u, float v);
+		template<typename Policy>
+		void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+			typename Policy::VertexType* vertices, UINT* indices, UINT baseIndex);
+		template<typename Policy>
+		void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+			typename Policy::VertexType* vertices, UINT* indices, UINT baseIndex);
 	};
+
+	// The generators fill exactly the Get*VertexCount and Get*IndexCount elements of the
+	// output buffers, in the order the MeshData overloads always used.
+
+	template<typename Policy>
+	void GeometryGenerator::SetVertex(typename Policy::VertexType& vertex,
+		float px, float py, float pz,
+		float nx, float ny, float nz,
+		float tx, float ty, float tz,
+		float u, float v)
+	{
+		Policy::SetPosition(vertex, DirectX::XMFLOAT3(px, py, pz));
+		if(Policy::HasNormal)
+			Policy::SetNormal(vertex, DirectX::XMFLOAT3(nx, ny, nz));
+		if(Policy::HasTangent)
+			Policy::SetTangent(vertex, DirectX::XMFLOAT3(tx, ty, tz));
+		if(Policy::HasTexC)
+			Policy::SetTexC(vertex, DirectX::XMFLOAT2(u, v));
+	}
+
+	template<typename Policy>
+	void GeometryGenerator::CreateBox(float width, float height, float depth, typename Policy::VertexType* vertices, UINT* indices)
+	{
+		//
+		// Create the vertices.
+		//
+
+		auto* v = vertices;
+
+		float w2 = 0.5f*width;
+		float h2 = 0.5f*height;
+		float d2 = 0.5f*depth;
+
+		// Fill in the front face vertex data.
+		SetVertex<Policy>(v[0], -w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+		SetVertex<Policy>(v[1], -w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+		SetVertex<Policy>(v[2], +w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+		SetVertex<Policy>(v[3], +w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+
+		// Fill in the back face vertex data.
+		SetVertex<Policy>(v[4], -w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+		SetVertex<Policy>(v[5], +w2, -h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+		SetVertex<Policy>(v[6], +w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+		SetVertex<Policy>(v[7], -w2, +h2, +d2, 0.0f, 0.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+
+		// Fill in the top face vertex data.
+		SetVertex<Policy>(v[8],  -w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+		SetVertex<Policy>(v[9],  -w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+		SetVertex<Policy>(v[10], +w2, +h2, +d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+		SetVertex<Policy>(v[11], +w2, +h2, -d2, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+
+		// Fill in the bottom face vertex data.
+		SetVertex<Policy>(v[12], -w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f);
+		SetVertex<Policy>(v[13], +w2, -h2, -d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+		SetVertex<Policy>(v[14], +w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+		SetVertex<Policy>(v[15], -w2, -h2, +d2, 0.0f, -1.0f, 0.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f);
+
+		// Fill in the left face vertex data.
+		SetVertex<Policy>(v[16], -w2, -h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f);
+		SetVertex<Policy>(v[17], -w2, +h2, +d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f);
+		SetVertex<Policy>(v[18], -w2, +h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f);
+		SetVertex<Policy>(v[19], -w2, -h2, -d2, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 1.0f, 1.0f);
+
+		// Fill in the right face vertex data.
+		SetVertex<Policy>(v[20], +w2, -h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f);
+		SetVertex<Policy>(v[21], +w2, +h2, -d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+		SetVertex<Policy>(v[22], +w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
+		SetVertex<Policy>(v[23], +w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
+
+		//
+		// Create the indices.
+		//
+
+		UINT* i = indices;
+
+		// Fill in the front face index data
+		i[0] = 0; i[1] = 1; i[2] = 2;
+		i[3] = 0; i[4] = 2; i[5] = 3;
+
+		// Fill in the back face index data
+		i[6] = 4; i[7]  = 5; i[8]  = 6;
+		i[9] = 4; i[10] = 6; i[11] = 7;
+
+		// Fill in the top face index data
+		i[12] = 8; i[13] =  9; i[14] = 10;
+		i[15] = 8; i[16] = 10; i[17] = 11;
+
+		// Fill in the bottom face index data
+		i[18] = 12; i[19] = 13; i[20] = 14;
+		i[21] = 12; i[22] = 14; i[23] = 15;
+
+		// Fill in the left face index data
+		i[24] = 16; i[25] = 17; i[26] = 18;
+		i[27] = 16; i[28] = 18; i[29] = 19;
+
+		// Fill in the right face index data
+		i[30] = 20; i[31] = 21; i[32] = 22;
+		i[33] = 20; i[34] = 22; i[35] = 23;
+	}
+
+	template<typename Policy>
+	void GeometryGenerator::CreateSphere(float radius, UINT sliceCount, UINT stackCount, typename Policy::VertexType* vertices, UINT* indices)
+	{
+		//
+		// Compute the vertices stating at the top pole and moving down the stacks.
+		//
+
+		// Poles: note that there will be texture coordinate distortion as there is
+		// not a unique point on the texture map to assign to the pole when mapping
+		// a rectangular texture onto a sphere.
+		UINT vertexCount = GetSphereVertexCount(sliceCount, stackCount);
+		SetVertex<Policy>(vertices[0], 0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+		SetVertex<Policy>(vertices[vertexCount-1], 0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+
+		float phiStep   = DirectX::XM_PI/stackCount;
+		float thetaStep = 2.0f*DirectX::XM_PI/sliceCount;
+
+		// Compute vertices for each stack ring (do not count the poles as rings).
+		UINT k = 1;
+		for(UINT i = 1; i <= stackCount-1; ++i)
+		{
+			float phi = i*phiStep;
+
+			// Vertices of ring.
+			for(UINT j = 0; j <= sliceCount; ++j, ++k)
+			{
+				float theta = j*thetaStep;
+				auto& v = vertices[k];
+
+				// spherical to cartesian
+				DirectX::XMFLOAT3 position(
+					radius*sinf(phi)*cosf(theta),
+					radius*cosf(phi),
+					radius*sinf(phi)*sinf(theta));
+				Policy::SetPosition(v, position);
+
+				if(Policy::HasTangent)
+				{
+					// Partial derivative of P with respect to theta
+					DirectX::XMFLOAT3 tangent(
+						-radius*sinf(phi)*sinf(theta),
+						0.0f,
+						+radius*sinf(phi)*cosf(theta));
+					DirectX::XMStoreFloat3(&tangent, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&tangent)));
+					Policy::SetTangent(v, tangent);
+				}
+
+				if(Policy::HasNormal)
+				{
+					DirectX::XMFLOAT3 normal;
+					DirectX::XMStoreFloat3(&normal, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&position)));
+					Policy::SetNormal(v, normal);
+				}
+
+				if(Policy::HasTexC)
+					Policy::SetTexC(v, DirectX::XMFLOAT2(theta / DirectX::XM_2PI, phi / DirectX::XM_PI));
+			}
+		}
+
+		//
+		// Compute indices for top stack.  The top stack was written first to the vertex buffer
+		// and connects the top pole to the first ring.
+		//
+
+		UINT* out = indices;
+		for(UINT i = 1; i <= sliceCount; ++i)
+		{
+			*out++ = 0;
+			*out++ = i+1;
+			*out++ = i;
+		}
+
+		//
+		// Compute indices for inner stacks (not connected to poles).
+		//
+
+		// Offset the indices to the index of the first vertex in the first ring.
+		// This is just skipping the top pole vertex.
+		UINT baseIndex = 1;
+		UINT ringVertexCount = sliceCount+1;
+		for(UINT i = 0; i < stackCount-2; ++i)
+		{
+			for(UINT j = 0; j < sliceCount; ++j)
+			{
+				*out++ = baseIndex + i*ringVertexCount + j;
+				*out++ = baseIndex + i*ringVertexCount + j+1;
+				*out++ = baseIndex + (i+1)*ringVertexCount + j;
+
+				*out++ = baseIndex + (i+1)*ringVertexCount + j;
+				*out++ = baseIndex + i*ringVertexCount + j+1;
+				*out++ = baseIndex + (i+1)*ringVertexCount + j+1;
+			}
+		}
+
+		//
+		// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
+		// and connects the bottom pole to the bottom ring.
+		//
+
+		// South pole vertex was added last.
+		UINT southPoleIndex = vertexCount-1;
+
+		// Offset the indices to the index of the first vertex in the last ring.
+		baseIndex = southPoleIndex - ringVertexCount;
+
+		for(UINT i = 0; i < sliceCount; ++i)
+		{
+			*out++ = southPoleIndex;
+			*out++ = baseIndex+i;
+			*out++ = baseIndex+i+1;
+		}
+	}
+
+	template<typename Policy>
+	void GeometryGenerator::CreateGeosphere(float radius, UINT numSubdivisions, typename Policy::VertexType* vertices, UINT* indices)
+	{
+		std::vector<DirectX::XMFLOAT3> positions;
+		std::vector<UINT> geoIndices;
+		BuildGeosphere(numSubdivisions, positions, geoIndices);
+		memcpy(indices, geoIndices.data(), geoIndices.size()*sizeof(UINT));
+
+		// Project vertices onto sphere and scale.
+		for(UINT i = 0; i < (UINT)positions.size(); ++i)
+		{
+			auto& v = vertices[i];
+
+			// Project onto unit sphere.
+			DirectX::XMVECTOR n = DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&positions[i]));
+
+			// Project onto sphere.
+			DirectX::XMFLOAT3 position;
+			DirectX::XMStoreFloat3(&position, DirectX::XMVectorScale(n, radius));
+			Policy::SetPosition(v, position);
+
+			if(Policy::HasNormal)
+			{
+				DirectX::XMFLOAT3 normal;
+				DirectX::XMStoreFloat3(&normal, n);
+				Policy::SetNormal(v, normal);
+			}
+
+			if(!Policy::HasTexC && !Policy::HasTangent)
+				continue;
+
+			// Derive texture coordinates from spherical coordinates.
+			float theta = MathHelper::AngleFromXY(position.x, position.z);
+			float phi = acosf(position.y / radius);
+
+			if(Policy::HasTexC)
+				Policy::SetTexC(v, DirectX::XMFLOAT2(theta/DirectX::XM_2PI, phi/DirectX::XM_PI));
+
+			if(Policy::HasTangent)
+			{
+				// Partial derivative of P with respect to theta
+				DirectX::XMFLOAT3 tangent(
+					-radius*sinf(phi)*sinf(theta),
+					0.0f,
+					+radius*sinf(phi)*cosf(theta));
+				DirectX::XMStoreFloat3(&tangent, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&tangent)));
+				Policy::SetTangent(v, tangent);
+			}
+		}
+	}
+
+	template<typename Policy>
+	void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+		typename Policy::VertexType* vertices, UINT* indices)
+	{
+		//
+		// Build Stacks.
+		// 
+
+		float stackHeight = height / stackCount;
+
+		// Amount to increment radius as we move up each stack level from bottom to top.
+		float radiusStep = (topRadius - bottomRadius) / stackCount;
+
+		UINT ringCount = stackCount+1;
+
+		// Compute vertices for each stack ring starting at the bottom and moving up.
+		UINT k = 0;
+		for(UINT i = 0; i < ringCount; ++i)
+		{
+			float y = -0.5f*height + i*stackHeight;
+			float r = bottomRadius + i*radiusStep;
+
+			// vertices of ring
+			float dTheta = 2.0f*DirectX::XM_PI/sliceCount;
+			for(UINT j = 0; j <= sliceCount; ++j, ++k)
+			{
+				auto& vertex = vertices[k];
+
+				float c = cosf(j*dTheta);
+				float s = sinf(j*dTheta);
+
+				Policy::SetPosition(vertex, DirectX::XMFLOAT3(r*c, y, r*s));
+
+				if(Policy::HasTexC)
+					Policy::SetTexC(vertex, DirectX::XMFLOAT2((float)j/sliceCount, 1.0f - (float)i/stackCount));
+
+				// Cylinder can be parameterized as follows, where we introduce v
+				// parameter that goes in the same direction as the v tex-coord
+				// so that the bitangent goes in the same direction as the v tex-coord.
+				//   Let r0 be the bottom radius and let r1 be the top radius.
+				//   y(v) = h - hv for v in [0,1].
+				//   r(v) = r1 + (r0-r1)v
+				//
+				//   x(t, v) = r(v)*cos(t)
+				//   y(t, v) = h - hv
+				//   z(t, v) = r(v)*sin(t)
+				// 
+				//  dx/dt = -r(v)*sin(t)
+				//  dy/dt = 0
+				//  dz/dt = +r(v)*cos(t)
+				//
+				//  dx/dv = (r0-r1)*cos(t)
+				//  dy/dv = -h
+				//  dz/dv = (r0-r1)*sin(t)
+
+				// This is unit length.
+				DirectX::XMFLOAT3 tangent(-s, 0.0f, c);
+				if(Policy::HasTangent)
+					Policy::SetTangent(vertex, tangent);
+
+				if(Policy::HasNormal)
+				{
+					float dr = bottomRadius-topRadius;
+					DirectX::XMFLOAT3 bitangent(dr*c, -height, dr*s);
+
+					DirectX::XMVECTOR T = DirectX::XMLoadFloat3(&tangent);
+					DirectX::XMVECTOR B = DirectX::XMLoadFloat3(&bitangent);
+					DirectX::XMFLOAT3 normal;
+					DirectX::XMStoreFloat3(&normal, DirectX::XMVector3Normalize(DirectX::XMVector3Cross(T, B)));
+					Policy::SetNormal(vertex, normal);
+				}
+			}
+		}
+
+		// Add one because we duplicate the first and last vertex per ring
+		// since the texture coordinates are different.
+		UINT ringVertexCount = sliceCount+1;
+
+		// Compute indices for each stack.
+		UINT* out = indices;
+		for(UINT i = 0; i < stackCount; ++i)
+		{
+			for(UINT j = 0; j < sliceCount; ++j)
+			{
+				*out++ = i*ringVertexCount + j;
+				*out++ = (i+1)*ringVertexCount + j;
+				*out++ = (i+1)*ringVertexCount + j+1;
+
+				*out++ = i*ringVertexCount + j;
+				*out++ = (i+1)*ringVertexCount + j+1;
+				*out++ = i*ringVertexCount + j+1;
+			}
+		}
+
+		// Each cap adds a ring and a center vertex, and a triangle per slice.
+		UINT capVertexCount = sliceCount+2;
+		UINT capIndexCount = sliceCount*3;
+		BuildCylinderTopCap<Policy>(bottomRadius, topRadius, height, sliceCount, stackCount, vertices + k, out, k);
+		BuildCylinderBottomCap<Policy>(bottomRadius, topRadius, height, sliceCount, stackCount,
+			vertices + k + capVertexCount, out + capIndexCount, k + capVertexCount);
+	}
+
+	template<typename Policy>
+	void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+		typename Policy::VertexType* vertices, UINT* indices, UINT baseIndex)
+	{
+		float y = 0.5f*height;
+		float dTheta = 2.0f*DirectX::XM_PI/sliceCount;
+
+		// Duplicate cap ring vertices because the texture coordinates and normals differ.
+		for(UINT i = 0; i <= sliceCount; ++i)
+		{
+			float x = topRadius*cosf(i*dTheta);
+			float z = topRadius*sinf(i*dTheta);
+
+			// Scale down by the height to try and make top cap texture coord area
+			// proportional to base.
+			float u = x/height + 0.5f;
+			float v = z/height + 0.5f;
+
+			SetVertex<Policy>(vertices[i], x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v);
+		}
+
+		// Cap center vertex.
+		SetVertex<Policy>(vertices[sliceCount+1], 0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f);
+
+		// Index of center vertex.
+		UINT centerIndex = baseIndex + sliceCount+1;
+
+		for(UINT i = 0; i < sliceCount; ++i)
+		{
+			*indices++ = centerIndex;
+			*indices++ = baseIndex + i+1;
+			*indices++ = baseIndex + i;
+		}
+	}
+
+	template<typename Policy>
+	void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, UINT sliceCount, UINT stackCount,
+		typename Policy::VertexType* vertices, UINT* indices, UINT baseIndex)
+	{
+		// 
+		// Build bottom cap.
+		//
+
+		float y = -0.5f*height;
+
+		// vertices of ring
+		float dTheta = 2.0f*DirectX::XM_PI/sliceCount;
+		for(UINT i = 0; i <= sliceCount; ++i)
+		{
+			float x = bottomRadius*cosf(i*dTheta);
+			float z = bottomRadius*sinf(i*dTheta);
+
+			// Scale down by the height to try and make top cap texture coord area
+			// proportional to base.
+			float u = x/height + 0.5f;
+			float v = z/height + 0.5f;
+
+			SetVertex<Policy>(vertices[i], x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v);
+		}
+
+		// Cap center vertex.
+		SetVertex<Policy>(vertices[sliceCount+1], 0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f);
+
+		// Cache the index of center vertex.
+		UINT centerIndex = baseIndex + sliceCount+1;
+
+		for(UINT i = 0; i < sliceCount; ++i)
+		{
+			*indices++ = centerIndex;
+			*indices++ = baseIndex + i;
+			*indices++ = baseIndex + i+1;
+		}
+	}
+
+	template<typename Policy>
+	void GeometryGenerator::CreateGrid(float width, float depth, UINT m, UINT n, typename Policy::VertexType* vertices, UINT* indices)
+	{
+		//
+		// Create the vertices.
+		//
+
+		float halfWidth = 0.5f*width;
+		float halfDepth = 0.5f*depth;
+
+		float dx = width / (n-1);
+		float dz = depth / (m-1);
+
+		float du = 1.0f / (n-1);
+		float dv = 1.0f / (m-1);
+
+		for(UINT i = 0; i < m; ++i)
+		{
+			float z = halfDepth - i*dz;
+			for(UINT j = 0; j < n; ++j)
+			{
+				float x = -halfWidth + j*dx;
+
+				// Stretch texture over grid.
+				SetVertex<Policy>(vertices[i*n+j], x, 0.0f, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, j*du, i*dv);
+			}
+		}
+
+		//
+		// Create the indices.
+		//
+
+		// Iterate over each quad and compute indices.
+		UINT k = 0;
+		for(UINT i = 0; i < m-1; ++i)
+		{
+			for(UINT j = 0; j < n-1; ++j)
+			{
+				indices[k]   = i*n+j;
+				indices[k+1] = i*n+j+1;
+				indices[k+2] = (i+1)*n+j;
+
+				indices[k+3] = (i+1)*n+j;
+				indices[k+4] = i*n+j+1;
+				indices[k+5] = (i+1)*n+j+1;
+
+				k += 6; // next quad
+			}
+		}
+	}
+
+	template<typename Policy>
+	void GeometryGenerator::CreateFullscreenQuad(typename Policy::VertexType* vertices, UINT* indices)
+	{
+		// Position coordinates specified in NDC space.
+		SetVertex<Policy>(vertices[0],
+			-1.0f, -1.0f, 0.0f,
+			0.0f, 0.0f, -1.0f,
+			1.0f, 0.0f, 0.0f,
+			0.0f, 1.0f);
+
+		SetVertex<Policy>(vertices[1],
+			-1.0f, +1.0f, 0.0f,
+			0.0f, 0.0f, -1.0f,
+			1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f);
+
+		SetVertex<Policy>(vertices[2],
+			+1.0f, +1.0f, 0.0f,
+			0.0f, 0.0f, -1.0f,
+			1.0f, 0.0f, 0.0f,
+			1.0f, 0.0f);
+
+		SetVertex<Policy>(vertices[3],
+			+1.0f, -1.0f, 0.0f,
+			0.0f, 0.0f, -1.0f,
+			1.0f, 0.0f, 0.0f,
+			1.0f, 1.0f);
+
+		indices[0] = 0;
+		indices[1] = 1;
+		indices[2] = 2;
+
+		indices[3] = 0;
+		indices[4] = 2;
+		indices[5] = 3;
+	}
 }
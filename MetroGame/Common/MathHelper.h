@@ -72,5 +72,9 @@ namespace DX
 		static const float Pi;
 
 	};
+
+	// Normalized inward planes of the frustum of M, a view projection that is not transposed:
+	// left, right, bottom, top, near, far.
+	void ExtractFrustumPlanes(DirectX::XMFLOAT4 planes[6], const DirectX::XMFLOAT4X4& M);
 }
 
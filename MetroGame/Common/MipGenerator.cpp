@@ -0,0 +1,272 @@
+#include "pch.h"
+#include "MipGenerator.h"
+#include "MathHelper.h"
+#include <ppl.h>
+#include <DirectXPackedVector.h>
+
+using namespace DX;
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// Levels with fewer texels are filtered on the calling thread
+static const UINT ParallelTexels = 64 * 64;
+static const UINT KaiserTaps = 8;
+
+template<typename Func>
+static void ForEachRow(UINT rows, UINT texels, const Func& func)
+{
+	if (texels < ParallelTexels)
+	{
+		for (UINT y = 0; y < rows; ++y)
+			func(y);
+	}
+	else
+	{
+		concurrency::parallel_for(UINT(0), rows, func);
+	}
+}
+
+static const float* GetSrgbToLinearTable()
+{
+	static float table[256];
+	static bool initialized = [&]()
+	{
+		for (UINT i = 0; i < 256; ++i)
+			table[i] = XMVectorGetX(XMColorSRGBToRGB(XMVectorReplicate(i / 255.0f)));
+		return true;
+	}();
+	return table;
+}
+
+static float BesselI0(float x)
+{
+	float sum = 1.0f;
+	float term = 1.0f;
+	for (int k = 1; k < 20; ++k)
+	{
+		term *= (x * 0.5f / k) * (x * 0.5f / k);
+		sum += term;
+	}
+	return sum;
+}
+
+// Weights of source texels 2x-3 .. 2x+4 for destination texel x. The sinc is scaled to the
+// destination texel size and the Kaiser window spans two destination texels.
+static const float* GetKaiserWeights()
+{
+	static float weights[KaiserTaps];
+	static bool initialized = [&]()
+	{
+		const float alpha = 4.0f;
+		const float radius = 2.0f;
+		float sum = 0.0f;
+		for (UINT i = 0; i < KaiserTaps; ++i)
+		{
+			float t = fabsf(((float)i - 3.5f) * 0.5f);
+			float sinc = sinf(XM_PI * t) / (XM_PI * t);
+			float window = BesselI0(alpha * sqrtf(1.0f - (t / radius) * (t / radius))) / BesselI0(alpha);
+			weights[i] = sinc * window;
+			sum += weights[i];
+		}
+		for (UINT i = 0; i < KaiserTaps; ++i)
+			weights[i] /= sum;
+		return true;
+	}();
+	return weights;
+}
+
+static void BoxDownsample(const std::vector<XMFLOAT4>& src, UINT sw, UINT sh, std::vector<XMFLOAT4>& dst, UINT dw, UINT dh)
+{
+	ForEachRow(dh, dw * dh, [&](UINT y)
+	{
+		const XMFLOAT4* row0 = &src[MathHelper::Min(2 * y, sh - 1) * sw];
+		const XMFLOAT4* row1 = &src[MathHelper::Min(2 * y + 1, sh - 1) * sw];
+		XMFLOAT4* out = &dst[y * dw];
+		for (UINT x = 0; x < dw; ++x)
+		{
+			UINT x0 = MathHelper::Min(2 * x, sw - 1);
+			UINT x1 = MathHelper::Min(2 * x + 1, sw - 1);
+			XMVECTOR v = XMVectorAdd(XMVectorAdd(XMLoadFloat4(&row0[x0]), XMLoadFloat4(&row0[x1])),
+				XMVectorAdd(XMLoadFloat4(&row1[x0]), XMLoadFloat4(&row1[x1])));
+			XMStoreFloat4(&out[x], XMVectorScale(v, 0.25f));
+		}
+	});
+}
+
+static void KaiserDownsample(const std::vector<XMFLOAT4>& src, UINT sw, UINT sh, std::vector<XMFLOAT4>& dst, UINT dw, UINT dh,
+	std::vector<XMFLOAT4>& temp)
+{
+	const float* weights = GetKaiserWeights();
+
+	// Horizontal pass into a dw x sh image
+	temp.resize(dw * sh);
+	ForEachRow(sh, dw * sh, [&](UINT y)
+	{
+		const XMFLOAT4* row = &src[y * sw];
+		XMFLOAT4* out = &temp[y * dw];
+		for (UINT x = 0; x < dw; ++x)
+		{
+			XMVECTOR v = XMVectorZero();
+			for (UINT i = 0; i < KaiserTaps; ++i)
+			{
+				int sx = MathHelper::Clamp((int)(2 * x + i) - 3, 0, (int)sw - 1);
+				v = XMVectorMultiplyAdd(XMLoadFloat4(&row[sx]), XMVectorReplicate(weights[i]), v);
+			}
+			XMStoreFloat4(&out[x], v);
+		}
+	});
+
+	// Vertical pass, the negative lobes can leave the [0, 1] range
+	ForEachRow(dh, dw * dh, [&](UINT y)
+	{
+		const XMFLOAT4* rows[KaiserTaps];
+		for (UINT i = 0; i < KaiserTaps; ++i)
+			rows[i] = &temp[MathHelper::Clamp((int)(2 * y + i) - 3, 0, (int)sh - 1) * dw];
+		XMFLOAT4* out = &dst[y * dw];
+		for (UINT x = 0; x < dw; ++x)
+		{
+			XMVECTOR v = XMVectorZero();
+			for (UINT i = 0; i < KaiserTaps; ++i)
+				v = XMVectorMultiplyAdd(XMLoadFloat4(&rows[i][x]), XMVectorReplicate(weights[i]), v);
+			XMStoreFloat4(&out[x], XMVectorSaturate(v));
+		}
+	});
+}
+
+void MipImage::Initialize(const BYTE* pixels, UINT width, UINT height, UINT rowPitch)
+{
+	Width = width;
+	Height = height;
+	Pixels.resize((size_t)width * height * 4);
+	for (UINT y = 0; y < height; ++y)
+		memcpy(&Pixels[(size_t)y * width * 4], pixels + (size_t)y * rowPitch, width * 4);
+	MipLevel level = { 0, width, height, width * 4 };
+	Levels.assign(1, level);
+}
+
+void MipImage::FillSubresources(D3D11_SUBRESOURCE_DATA* data, UINT count)const
+{
+	for (UINT i = 0; i < count; ++i)
+	{
+		data[i].pSysMem = GetLevel(i);
+		data[i].SysMemPitch = Levels[i].RowPitch;
+		data[i].SysMemSlicePitch = 0;
+	}
+}
+
+UINT DX::GetFullMipCount(UINT width, UINT height)
+{
+	UINT count = 1;
+	while (width > 1 || height > 1)
+	{
+		width = MathHelper::Max(width / 2, 1u);
+		height = MathHelper::Max(height / 2, 1u);
+		++count;
+	}
+	return count;
+}
+
+bool DX::CanGenerateMips(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool DX::IsSrgbFormat(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void DX::GenerateMips(MipImage& image, bool srgb, MipFilter filter, UINT mipCount)
+{
+	UINT fullCount = GetFullMipCount(image.Width, image.Height);
+	UINT count = mipCount ? MathHelper::Min(mipCount, fullCount) : fullCount;
+
+	// Lay out the chain behind level 0
+	image.Levels.resize(count);
+	size_t offset = 0;
+	UINT w = image.Width;
+	UINT h = image.Height;
+	for (UINT i = 0; i < count; ++i)
+	{
+		MipLevel& level = image.Levels[i];
+		level.Offset = offset;
+		level.Width = w;
+		level.Height = h;
+		level.RowPitch = w * 4;
+		offset += (size_t)w * h * 4;
+		w = MathHelper::Max(w / 2, 1u);
+		h = MathHelper::Max(h / 2, 1u);
+	}
+	image.Pixels.resize(offset);
+	if (count == 1)
+		return;
+
+	// Level 0 to linear float
+	std::vector<XMFLOAT4> src((size_t)image.Width * image.Height);
+	std::vector<XMFLOAT4> dst;
+	std::vector<XMFLOAT4> temp;
+	const float* toLinear = GetSrgbToLinearTable();
+	ForEachRow(image.Height, image.Width * image.Height, [&](UINT y)
+	{
+		const BYTE* row = image.GetLevel(0) + (size_t)y * image.Levels[0].RowPitch;
+		XMFLOAT4* out = &src[(size_t)y * image.Width];
+		for (UINT x = 0; x < image.Width; ++x)
+		{
+			const BYTE* texel = row + x * 4;
+			if (srgb)
+				out[x] = XMFLOAT4(toLinear[texel[0]], toLinear[texel[1]], toLinear[texel[2]], texel[3] / 255.0f);
+			else
+				XMStoreFloat4(&out[x], XMLoadUByteN4((const XMUBYTEN4*)texel));
+		}
+	});
+
+	for (UINT i = 1; i < count; ++i)
+	{
+		const MipLevel& prev = image.Levels[i - 1];
+		const MipLevel& level = image.Levels[i];
+		dst.resize((size_t)level.Width * level.Height);
+		if (filter == MipFilter::Kaiser)
+			KaiserDownsample(src, prev.Width, prev.Height, dst, level.Width, level.Height, temp);
+		else
+			BoxDownsample(src, prev.Width, prev.Height, dst, level.Width, level.Height);
+
+		// Quantize for storage, the next level is filtered from the float data
+		BYTE* pixels = image.Pixels.data() + level.Offset;
+		ForEachRow(level.Height, level.Width * level.Height, [&](UINT y)
+		{
+			const XMFLOAT4* row = &dst[(size_t)y * level.Width];
+			XMUBYTEN4* out = (XMUBYTEN4*)(pixels + (size_t)y * level.RowPitch);
+			for (UINT x = 0; x < level.Width; ++x)
+			{
+				XMVECTOR v = XMLoadFloat4(&row[x]);
+				if (srgb)
+					v = XMColorRGBToSRGB(v);
+				XMStoreUByteN4(&out[x], v);
+			}
+		});
+		src.swap(dst);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+// CPU mip chain generation for 8 bit four channel images (RGBA or BGRA, alpha last). Level 0
+// is converted to float once, every level is filtered from the float level above it and only
+// quantized for storage, so errors do not add up along the chain. sRGB images are filtered in
+// linear space. Rows are filtered in parallel with DirectXMath vector code, so a chain is
+// built on worker threads without a device or a render target.
+
+namespace DX
+{
+	enum class MipFilter
+	{
+		Box,		// 2x2 average
+		Kaiser		// Separable 8 tap Kaiser windowed sinc, keeps more detail
+	};
+
+	struct MipLevel
+	{
+		size_t Offset;
+		UINT Width;
+		UINT Height;
+		UINT RowPitch;
+	};
+
+	// Four bytes per texel, the levels tightly packed one after another.
+	struct MipImage
+	{
+		MipImage() : Width(0), Height(0) {}
+
+		// Copy level 0 and drop any other level.
+		void Initialize(const BYTE* pixels, UINT width, UINT height, UINT rowPitch);
+		const BYTE* GetLevel(UINT mip)const { return Pixels.data() + Levels[mip].Offset; }
+		UINT GetMipCount()const { return (UINT)Levels.size(); }
+		// Initial data of the first count levels, as one texture array element.
+		void FillSubresources(D3D11_SUBRESOURCE_DATA* data, UINT count)const;
+
+		UINT Width;
+		UINT Height;
+		std::vector<MipLevel> Levels;
+		std::vector<BYTE> Pixels;
+	};
+
+	// Levels of a full chain down to 1x1.
+	UINT GetFullMipCount(UINT width, UINT height);
+	// Formats GenerateMips works on.
+	bool CanGenerateMips(DXGI_FORMAT format);
+	bool IsSrgbFormat(DXGI_FORMAT format);
+
+	// Rebuild the chain of image from level 0. mipCount 0 builds the full chain.
+	void GenerateMips(MipImage& image, bool srgb, MipFilter filter = MipFilter::Box, UINT mipCount = 0);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <ppl.h>
+#include <algorithm>
+#include <atomic>
+
+// Work sharing loop of the per instance updates. Up to workerCount PPL workers pull chunks of
+// chunkSize consecutive indices from one shared counter until [0, count) is drained, so fast
+// workers take over the work of slow ones and no index is visited twice. body(worker, index)
+// gets the worker number in [0, workerCount) to pick per worker scratch. The calling thread
+// waits for all chunks.
+
+namespace DX
+{
+	template<typename Body>
+	void ParallelForChunks(UINT count, UINT workerCount, UINT chunkSize, const Body& body)
+	{
+		workerCount = (std::min)(workerCount, (count + chunkSize - 1) / chunkSize);
+		std::atomic<UINT> nextChunk(0);
+		concurrency::parallel_for(0u, workerCount, [&](UINT worker)
+		{
+			for (;;)
+			{
+				UINT begin = nextChunk.fetch_add(chunkSize);
+				if (begin >= count)
+					break;
+				UINT end = (std::min)(begin + chunkSize, count);
+				for (UINT k = begin; k < end; ++k)
+					body(worker, k);
+			}
+		});
+	}
+}
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "ShaderMgr.h"
+#include "BasicReaderWriter.h"
 #include "DirectXHelper.h"
 #include "TaskExtensions.h"
 
@@ -68,6 +69,38 @@ D3D11_INPUT_ELEMENT_DESC BasicParticleDesc[5] =
 	{ "TYPE",     0, DXGI_FORMAT_R32_UINT,        0, 36, D3D11_INPUT_PER_VERTEX_DATA, 0 },
 };
 
+// Slot 1 holds DX::BasicInstance.
+D3D11_INPUT_ELEMENT_DESC Basic32InstancedDesc[11] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 0,   D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 12,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,       0, 24,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "WORLD",    0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0,   D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD",    1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD",    2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD",    3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLDINVTRANSPOSE", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 64, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLDINVTRANSPOSE", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 80, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLDINVTRANSPOSE", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 96, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "MATINDEX", 0, DXGI_FORMAT_R32_UINT,           1, 112, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+};
+
+D3D11_INPUT_ELEMENT_DESC PosNormalTexTanInstancedDesc[12] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 0,   D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT,    0, 12,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,       0, 24,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TANGENT",  0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 32,  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "WORLD",    0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0,   D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD",    1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD",    2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLD",    3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48,  D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLDINVTRANSPOSE", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 64, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLDINVTRANSPOSE", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 80, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "WORLDINVTRANSPOSE", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 96, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	{ "MATINDEX", 0, DXGI_FORMAT_R32_UINT,           1, 112, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+};
+
 #pragma endregion
 
 #pragma region StreamOut declaration
@@ -85,9 +118,69 @@ D3D11_SO_DECLARATION_ENTRY  BasicParticleDecl[5] =
 
 #pragma endregion
 
+// Layout description of an input layout type, false for None and unknown types.
+static bool GetLayoutDesc(InputLayoutType type, D3D11_INPUT_ELEMENT_DESC*& desc, uint32& count)
+{
+	switch (type)
+	{
+	case InputLayoutType::Pos: desc = PosDesc; count = _countof(PosDesc); return true;
+	case InputLayoutType::Basic32: desc = Basic32Desc; count = _countof(Basic32Desc); return true;
+	case InputLayoutType::PosNormalTexTan: desc = PosNormalTexTanDesc; count = _countof(PosNormalTexTanDesc); return true;
+	case InputLayoutType::PosNormalTexTanSkinned: desc = PosNormalTexTanSkinnedDesc; count = _countof(PosNormalTexTanSkinnedDesc); return true;
+	case InputLayoutType::PosColor: desc = PosColorDesc; count = _countof(PosColorDesc); return true;
+	case InputLayoutType::PointSize: desc = PointSizeDesc; count = _countof(PointSizeDesc); return true;
+	case InputLayoutType::PosTexBound: desc = PosTexBoundDesc; count = _countof(PosTexBoundDesc); return true;
+	case InputLayoutType::BasicParticle: desc = BasicParticleDesc; count = _countof(BasicParticleDesc); return true;
+	case InputLayoutType::Basic32Instanced: desc = Basic32InstancedDesc; count = _countof(Basic32InstancedDesc); return true;
+	case InputLayoutType::PosNormalTexTanInstanced: desc = PosNormalTexTanInstancedDesc; count = _countof(PosNormalTexTanInstancedDesc); return true;
+	default: return false;
+	}
+}
+
+// Shaders loaded by file name alone
+template<typename T>
+static T* GetShader(AsyncCache<ComPtr<T>>& cache, const std::shared_ptr<BasicLoader>& loader, const std::wstring& name)
+{
+	return cache.GetOrLoad(name, [&]()
+	{
+		Platform::String^ file = ref new Platform::String(name.c_str());
+		ComPtr<T> shader;
+
+		loader->LoadShader(file, shader.GetAddressOf());
+		return shader;
+	}).Get();
+}
+template<typename T>
+static concurrency::task<T*> GetShaderAsync(AsyncCache<ComPtr<T>>& cache, const std::shared_ptr<BasicLoader>& loader, const std::wstring& name)
+{
+	return cache.GetOrLoadAsync(name, [&]()
+	{
+		Platform::String^ file = ref new Platform::String(name.c_str());
+		std::shared_ptr<ComPtr<T>> shader = std::make_shared<ComPtr<T>>();
+
+		return loader->LoadShaderAsync(file, shader->GetAddressOf()).then([=]()
+		{
+			return *shader;
+		});
+	}).then([](ComPtr<T> shader)
+	{
+		return shader.Get();
+	});
+}
+
+// Layout of a vertex shader permutation, the same as BasicObject uses
+static InputLayoutType GetPermutationLayout(UINT key)
+{
+	bool normal = (key & ShaderPermutations::Normal) != 0;
+	if (ShaderPermutations::GetFamily(key) == ShaderPermutations::BasicInstVS)
+		return normal ? InputLayoutType::PosNormalTexTanInstanced : InputLayoutType::Basic32Instanced;
+	return normal ? InputLayoutType::PosNormalTexTan : InputLayoutType::Basic32;
+}
+
 ShaderMgr* ShaderMgr::m_instance = nullptr;
 
-ShaderMgr::ShaderMgr(const std::shared_ptr<BasicLoader>& loader) : m_loader(loader)
+ShaderMgr::ShaderMgr(const std::shared_ptr<BasicLoader>& loader) : m_loader(loader),
+	m_permutationsLoaded(concurrency::task_from_result()), m_permutationBlob(std::make_shared<PermutationBlob>())
 {
 	if (m_instance == nullptr)
 		m_instance = this;
@@ -97,6 +190,7 @@ ShaderMgr::ShaderMgr(const std::shared_ptr<BasicLoader>& loader) : m_loader(load
 
 ID3D11InputLayout* ShaderMgr::GetInputLayout(InputLayoutType type)
 {
+	std::lock_guard<std::mutex> lock(m_inputLayoutLock);
 	// Does it already exist?
 	if (m_inputLayout.find(type) != m_inputLayout.end())
 	{
@@ -108,283 +202,107 @@ ID3D11InputLayout* ShaderMgr::GetInputLayout(InputLayoutType type)
 	}
 }
 
+// None when the layout of type exists already, otherwise type itself
+InputLayoutType ShaderMgr::GetMissingLayout(InputLayoutType type)
+{
+	std::lock_guard<std::mutex> lock(m_inputLayoutLock);
+	return m_inputLayout.find(type) != m_inputLayout.end() ? InputLayoutType::None : type;
+}
+
+void ShaderMgr::SetInputLayout(InputLayoutType type, ID3D11InputLayout* inputLayout)
+{
+	std::lock_guard<std::mutex> lock(m_inputLayoutLock);
+	m_inputLayout[type] = inputLayout;
+}
+
 ID3D11VertexShader* ShaderMgr::GetVS(std::wstring name, InputLayoutType type)
 {
-	// Does it already exist?
-	if (m_vs.find(name) != m_vs.end())
-	{
-		return m_vs[name].Get();
-	}
-	else
+	return m_vs.GetOrLoad(name, [&]()
 	{
 		Platform::String^ file = ref new Platform::String(name.c_str());
 		ComPtr<ID3D11VertexShader> vs;
 		ComPtr<ID3D11InputLayout> inputLayout;
 
-		if (m_inputLayout.find(type) != m_inputLayout.end())
+		InputLayoutType missing = GetMissingLayout(type);
+		D3D11_INPUT_ELEMENT_DESC* desc = nullptr;
+		uint32 count = 0;
+		if (missing == InputLayoutType::None)
 		{
-			type = InputLayoutType::None;
-		}
-
-		switch (type)
-		{
-		case InputLayoutType::Pos:
-			m_loader->LoadShader(file, PosDesc, 1, vs.GetAddressOf(), inputLayout.GetAddressOf());
-			break;
-		case InputLayoutType::Basic32:
-			m_loader->LoadShader(file, Basic32Desc, 3, vs.GetAddressOf(), inputLayout.GetAddressOf());
-			break;
-		case InputLayoutType::PosNormalTexTan:
-			m_loader->LoadShader(file, PosNormalTexTanDesc, 4, vs.GetAddressOf(), inputLayout.GetAddressOf());
-			break;
-		case InputLayoutType::PosNormalTexTanSkinned:
-			m_loader->LoadShader(file, PosNormalTexTanSkinnedDesc, 6, vs.GetAddressOf(), inputLayout.GetAddressOf());
-			break;
-		case InputLayoutType::PosColor:
-			m_loader->LoadShader(file, PosColorDesc, 2, vs.GetAddressOf(), inputLayout.GetAddressOf());
-			break;
-		case InputLayoutType::PointSize:
-			m_loader->LoadShader(file, PointSizeDesc, 2, vs.GetAddressOf(), inputLayout.GetAddressOf());
-			break;
-		case InputLayoutType::PosTexBound:
-			m_loader->LoadShader(file, PosTexBoundDesc, 3, vs.GetAddressOf(), inputLayout.GetAddressOf());
-			break;
-		case InputLayoutType::BasicParticle:
-			m_loader->LoadShader(file, BasicParticleDesc, 5, vs.GetAddressOf(), inputLayout.GetAddressOf());
-			break;
-		case InputLayoutType::None:
 			m_loader->LoadShader(file, nullptr, 0, vs.GetAddressOf(), nullptr);
-			break;
-		default:
-			throw ref new Platform::InvalidArgumentException("No such input layout type!");
 		}
-
-		m_vs[name] = vs;
-
-		if (type != InputLayoutType::None)
+		else if (GetLayoutDesc(missing, desc, count))
 		{
-			m_inputLayout[type] = inputLayout;
+			m_loader->LoadShader(file, desc, count, vs.GetAddressOf(), inputLayout.GetAddressOf());
+			SetInputLayout(missing, inputLayout.Get());
 		}
-		return vs.Get();
-	}
+		else
+			throw ref new Platform::InvalidArgumentException("No such input layout type!");
+
+		return vs;
+	}).Get();
 }
 concurrency::task<ID3D11VertexShader*> ShaderMgr::GetVSAsync(std::wstring name, InputLayoutType type)
 {
-	// Does it already exist?
-	if (m_vs.find(name) != m_vs.end())
-	{
-		return concurrency::task_from_result(m_vs[name].Get());
-	}
-	else
+	return m_vs.GetOrLoadAsync(name, [=]()
 	{
 		Platform::String^ file = ref new Platform::String(name.c_str());
 		std::shared_ptr<ComPtr<ID3D11VertexShader>> vs = std::make_shared<ComPtr<ID3D11VertexShader>>();
 		std::shared_ptr<ComPtr<ID3D11InputLayout>> inputLayout = std::make_shared<ComPtr<ID3D11InputLayout>>();
 
-		if (m_inputLayout.find(type) != m_inputLayout.end())
-		{
-			type = InputLayoutType::None;
-		}
-
-		switch (type)
+		InputLayoutType missing = GetMissingLayout(type);
+		D3D11_INPUT_ELEMENT_DESC* desc = nullptr;
+		uint32 count = 0;
+		if (missing == InputLayoutType::None)
 		{
-		case InputLayoutType::Pos:
-			return m_loader->LoadShaderAsync(file, PosDesc, 1, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
-			{
-				m_vs[name] = vs->Get();
-
-				m_inputLayout[type] = inputLayout->Get();
-				return vs->Get();
-			});			
-		case InputLayoutType::Basic32:
-			return m_loader->LoadShaderAsync(file, Basic32Desc, 3, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
-			{
-				m_vs[name] = vs->Get();
-
-				m_inputLayout[type] = inputLayout->Get();
-				return vs->Get();
-			});
-		case InputLayoutType::PosNormalTexTan:
-			return m_loader->LoadShaderAsync(file, PosNormalTexTanDesc, 4, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
-			{
-				m_vs[name] = vs->Get();
-
-				m_inputLayout[type] = inputLayout->Get();
-				return vs->Get();
-			});
-		case InputLayoutType::PosNormalTexTanSkinned:
-			return m_loader->LoadShaderAsync(file, PosNormalTexTanSkinnedDesc, 6, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
-			{
-				m_vs[name] = vs->Get();
-
-				m_inputLayout[type] = inputLayout->Get();
-				return vs->Get();
-			});
-		case InputLayoutType::PosColor:
-			return m_loader->LoadShaderAsync(file, PosColorDesc, 2, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
-			{
-				m_vs[name] = vs->Get();
-
-				m_inputLayout[type] = inputLayout->Get();
-				return vs->Get();
-			});
-		case InputLayoutType::PointSize:
-			return m_loader->LoadShaderAsync(file, PointSizeDesc, 2, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
-			{
-				m_vs[name] = vs->Get();
-
-				m_inputLayout[type] = inputLayout->Get();
-				return vs->Get();
-			});
-		case InputLayoutType::PosTexBound:
-			return m_loader->LoadShaderAsync(file, PosTexBoundDesc, 3, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
-			{
-				m_vs[name] = vs->Get();
-
-				m_inputLayout[type] = inputLayout->Get();
-				return vs->Get();
-			});
-		case InputLayoutType::BasicParticle:
-			return m_loader->LoadShaderAsync(file, BasicParticleDesc, 5, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
-			{
-				m_vs[name] = vs->Get();
-
-				m_inputLayout[type] = inputLayout->Get();
-				return vs->Get();
-			});
-		case InputLayoutType::None:
 			return m_loader->LoadShaderAsync(file, nullptr, 0, vs->GetAddressOf(), nullptr).then([=]()
 			{
-				m_vs[name] = vs->Get();
-				return vs->Get();
+				return *vs;
 			});
-		default:
-			throw ref new Platform::InvalidArgumentException("No such input layout type!");
 		}
-	}
+		if (!GetLayoutDesc(missing, desc, count))
+			throw ref new Platform::InvalidArgumentException("No such input layout type!");
+
+		return m_loader->LoadShaderAsync(file, desc, count, vs->GetAddressOf(), inputLayout->GetAddressOf()).then([=]()
+		{
+			SetInputLayout(missing, inputLayout->Get());
+			return *vs;
+		});
+	}).then([](ComPtr<ID3D11VertexShader> vs)
+	{
+		return vs.Get();
+	});
 }
 
 ID3D11PixelShader* ShaderMgr::GetPS(std::wstring name)
 {
-	// Does it already exist?
-	if (m_ps.find(name) != m_ps.end())
-	{
-		return m_ps[name].Get();
-	}
-	else
-	{
-		Platform::String^ file = ref new Platform::String(name.c_str());
-		ComPtr<ID3D11PixelShader> ps;
-
-		m_loader->LoadShader(file, ps.GetAddressOf());
-
-		m_ps[name] = ps.Get();
-		
-		return ps.Get();
-	}
+	return GetShader(m_ps, m_loader, name);
 }
 concurrency::task<ID3D11PixelShader*> ShaderMgr::GetPSAsync(std::wstring name)
 {
-	// Does it already exist?
-	if (m_ps.find(name) != m_ps.end())
-	{
-		return concurrency::task_from_result(m_ps[name].Get());
-	}
-	else
-	{
-		Platform::String^ file = ref new Platform::String(name.c_str());
-		std::shared_ptr<ComPtr<ID3D11PixelShader>> ps = std::make_shared<ComPtr<ID3D11PixelShader>>();
-
-		return m_loader->LoadShaderAsync(file, ps->GetAddressOf()).then([=]()
-		{
-			m_ps[name] = ps->Get();
-			return ps->Get();
-		});
-	}
+	return GetShaderAsync(m_ps, m_loader, name);
 }
 
 ID3D11ComputeShader* ShaderMgr::GetCS(std::wstring name)
 {
-	// Does it already exist?
-	if (m_cs.find(name) != m_cs.end())
-	{
-		return m_cs[name].Get();
-	}
-	else
-	{
-		Platform::String^ file = ref new Platform::String(name.c_str());
-		ComPtr<ID3D11ComputeShader> cs;
-
-		m_loader->LoadShader(file, cs.GetAddressOf());
-		m_cs[name] = cs.Get();
-		return cs.Get();
-	}
+	return GetShader(m_cs, m_loader, name);
 }
 concurrency::task<ID3D11ComputeShader*> ShaderMgr::GetCSAsync(std::wstring name)
 {
-	// Does it already exist?
-	if (m_cs.find(name) != m_cs.end())
-	{
-		return concurrency::task_from_result(m_cs[name].Get());
-	}
-	else
-	{
-		Platform::String^ file = ref new Platform::String(name.c_str());
-		std::shared_ptr<ComPtr<ID3D11ComputeShader>> cs = std::make_shared<ComPtr<ID3D11ComputeShader>>();
-
-		return m_loader->LoadShaderAsync(file, cs->GetAddressOf()).then([=]()
-		{
-			m_cs[name] = cs->Get();
-			return cs->Get();
-		});
-	}
+	return GetShaderAsync(m_cs, m_loader, name);
 }
 
 ID3D11GeometryShader* ShaderMgr::GetGS(std::wstring name)
 {
-	// Does it already exist?
-	if (m_gs.find(name) != m_gs.end())
-	{
-		return m_gs[name].Get();
-	}
-	else
-	{
-		Platform::String^ file = ref new Platform::String(name.c_str());
-		ComPtr<ID3D11GeometryShader> gs;
-
-		m_loader->LoadShader(file, gs.GetAddressOf());
-		m_gs[name] = gs.Get();
-		return gs.Get();
-	}
+	return GetShader(m_gs, m_loader, name);
 }
 concurrency::task<ID3D11GeometryShader*> ShaderMgr::GetGSAsync(std::wstring name)
 {
-	// Does it already exist?
-	if (m_gs.find(name) != m_gs.end())
-	{
-		return concurrency::task_from_result(m_gs[name].Get());
-	}
-	else
-	{
-		Platform::String^ file = ref new Platform::String(name.c_str());
-		std::shared_ptr<ComPtr<ID3D11GeometryShader>> gs = std::make_shared<ComPtr<ID3D11GeometryShader>>();
-
-		return m_loader->LoadShaderAsync(file, gs->GetAddressOf()).then([=]()
-		{
-			m_gs[name] = gs->Get();
-			return gs->Get();
-		});
-	}
+	return GetShaderAsync(m_gs, m_loader, name);
 }
 
 ID3D11GeometryShader* ShaderMgr::GetGS(std::wstring name, StreamOutType type)
 {
-	// Does it already exist?
-	if (m_gs.find(name) != m_gs.end())
-	{
-		return m_gs[name].Get();
-	}
-	else
+	return m_gs.GetOrLoad(name, [&]()
 	{
 		Platform::String^ file = ref new Platform::String(name.c_str());
 		ComPtr<ID3D11GeometryShader> gs;
@@ -401,18 +319,12 @@ ID3D11GeometryShader* ShaderMgr::GetGS(std::wstring name, StreamOutType type)
 			throw ref new Platform::InvalidArgumentException("No such stream out type!");
 		}
 
-		m_gs[name] = gs.Get();
-		return gs.Get();
-	}
+		return gs;
+	}).Get();
 }
 concurrency::task<ID3D11GeometryShader*> ShaderMgr::GetGSAsync(std::wstring name, StreamOutType type)
 {
-	// Does it already exist?
-	if (m_gs.find(name) != m_gs.end())
-	{
-		return concurrency::task_from_result(m_gs[name].Get());
-	}
-	else
+	return m_gs.GetOrLoadAsync(name, [=]()
 	{
 		Platform::String^ file = ref new Platform::String(name.c_str());
 		std::shared_ptr<ComPtr<ID3D11GeometryShader>> gs = std::make_shared<ComPtr<ID3D11GeometryShader>>();
@@ -424,86 +336,178 @@ concurrency::task<ID3D11GeometryShader*> ShaderMgr::GetGSAsync(std::wstring name
 			uint32 strides[] = { sizeof(BasicParticle) };
 			return m_loader->LoadShaderAsync(file, BasicParticleDecl, 5, strides, 1, 0, gs->GetAddressOf()).then([=]()
 			{
-				m_gs[name] = gs->Get();
-				return gs->Get();
+				return *gs;
 			});
 		}
 		default:
 			throw ref new Platform::InvalidArgumentException("No such stream out type!");
 		}
-	}
+	}).then([](ComPtr<ID3D11GeometryShader> gs)
+	{
+		return gs.Get();
+	});
 }
 
 ID3D11HullShader* ShaderMgr::GetHS(std::wstring name)
 {
-	// Does it already exist?
-	if (m_hs.find(name) != m_hs.end())
-	{
-		return m_hs[name].Get();
-	}
-	else
-	{
-		Platform::String^ file = ref new Platform::String(name.c_str());
-		ComPtr<ID3D11HullShader> hs;
-
-		m_loader->LoadShader(file, hs.GetAddressOf());
-		m_hs[name] = hs.Get();
-		return hs.Get();
-	}
+	return GetShader(m_hs, m_loader, name);
 }
 concurrency::task<ID3D11HullShader*> ShaderMgr::GetHSAsync(std::wstring name)
 {
-	// Does it already exist?
-	if (m_hs.find(name) != m_hs.end())
-	{
-		return concurrency::task_from_result(m_hs[name].Get());
-	}
-	else
+	return GetShaderAsync(m_hs, m_loader, name);
+}
+
+ID3D11DomainShader* ShaderMgr::GetDS(std::wstring name)
+{
+	return GetShader(m_ds, m_loader, name);
+}
+concurrency::task<ID3D11DomainShader*> ShaderMgr::GetDSAsync(std::wstring name)
+{
+	return GetShaderAsync(m_ds, m_loader, name);
+}
+
+concurrency::task<void> ShaderMgr::LoadPermutationsAsync(Platform::String^ filename)
+{
+	BasicReaderWriter reader;
+	std::shared_ptr<PermutationBlob> state = m_permutationBlob;
+	concurrency::task<void> loaded = reader.ReadDataAsync(filename).then([state](concurrency::task<Platform::Array<byte>^> t)
 	{
-		Platform::String^ file = ref new Platform::String(name.c_str());
-		std::shared_ptr<ComPtr<ID3D11HullShader>> hs = std::make_shared<ComPtr<ID3D11HullShader>>();
+		Platform::Array<byte>^ blob;
+		try
+		{
+			blob = t.get();
+		}
+		catch (Platform::Exception^)
+		{
+			OutputDebugString(L"No shader permutation blob, permutations are loaded from their own files.\n");
+			return;
+		}
 
-		return m_loader->LoadShaderAsync(file, hs->GetAddressOf()).then([=]()
+		const ShaderPermutations::BlobEntry* entries = nullptr;
+		uint32_t count = 0;
+		if (!ShaderPermutations::ReadIndex(blob->Data, blob->Length, entries, count))
 		{
-			m_hs[name] = hs->Get();
-			return hs->Get();
-		});
-	}
+			OutputDebugString(L"Invalid shader permutation blob, permutations are loaded from their own files.\n");
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(state->Lock);
+		state->Data = blob;
+		state->Entries = entries;
+		state->Count = count;
+	});
+
+	std::lock_guard<std::mutex> lock(m_permutationLock);
+	m_permutationsLoaded = loaded;
+	return loaded;
 }
 
-ID3D11DomainShader* ShaderMgr::GetDS(std::wstring name)
+// Entry of key in the permutation blob, nullptr when the blob does not hold key. blob keeps
+// the bytecode alive.
+const ShaderPermutations::BlobEntry* ShaderMgr::FindPermutation(UINT key, Platform::Array<byte>^& blob)
 {
-	// Does it already exist?
-	if (m_ds.find(name) != m_ds.end())
+	std::lock_guard<std::mutex> lock(m_permutationBlob->Lock);
+	blob = m_permutationBlob->Data;
+	if (blob == nullptr)
+		return nullptr;
+	return ShaderPermutations::FindEntry(m_permutationBlob->Entries, m_permutationBlob->Count, key);
+}
+
+template<typename T>
+concurrency::task<T*> ShaderMgr::GetPermutationAsync(AsyncCache<ComPtr<T>, UINT>& cache, UINT key,
+	const std::function<concurrency::task<T*>(std::wstring)>& loadFile)
+{
+	concurrency::task<void> loaded;
 	{
-		return m_ds[name].Get();
+		std::lock_guard<std::mutex> lock(m_permutationLock);
+		loaded = m_permutationsLoaded;
 	}
-	else
+	return cache.GetOrLoadAsync(key, [=]()
 	{
-		Platform::String^ file = ref new Platform::String(name.c_str());
-		ComPtr<ID3D11DomainShader> ds;
-
-		m_loader->LoadShader(file, ds.GetAddressOf());
-		m_ds[name] = ds.Get();
-		return ds.Get();
-	}
+		// Task based, a request never fails because of the blob read
+		return loaded.then([=](concurrency::task<void>)
+		{
+			std::wstring name = ShaderPermutations::GetFileName(key);
+			Platform::Array<byte>^ blob;
+			const ShaderPermutations::BlobEntry* entry = FindPermutation(key, blob);
+			if (entry == nullptr)
+			{
+				return loadFile(name).then([](T* shader)
+				{
+					return ComPtr<T>(shader);
+				});
+			}
+
+			ComPtr<T> shader;
+			m_loader->CreateShader(blob->Data + entry->Offset, entry->Size, ref new Platform::String(name.c_str()), shader.GetAddressOf());
+			return concurrency::task_from_result(shader);
+		});
+	}).then([](ComPtr<T> shader)
+	{
+		return shader.Get();
+	});
 }
-concurrency::task<ID3D11DomainShader*> ShaderMgr::GetDSAsync(std::wstring name)
+
+concurrency::task<ID3D11VertexShader*> ShaderMgr::GetVSAsync(UINT key)
 {
-	// Does it already exist?
-	if (m_ds.find(name) != m_ds.end())
+	concurrency::task<void> loaded;
 	{
-		return concurrency::task_from_result(m_ds[name].Get());
+		std::lock_guard<std::mutex> lock(m_permutationLock);
+		loaded = m_permutationsLoaded;
 	}
-	else
+	return m_permutationVS.GetOrLoadAsync(key, [=]()
 	{
-		Platform::String^ file = ref new Platform::String(name.c_str());
-		std::shared_ptr<ComPtr<ID3D11DomainShader>> ds = std::make_shared<ComPtr<ID3D11DomainShader>>();
-
-		return m_loader->LoadShaderAsync(file, ds->GetAddressOf()).then([=]()
+		// Task based, a request never fails because of the blob read
+		return loaded.then([=](concurrency::task<void>)
 		{
-			m_ds[name] = ds->Get();
-			return ds->Get();
+			std::wstring name = ShaderPermutations::GetFileName(key);
+			InputLayoutType type = GetPermutationLayout(key);
+			Platform::Array<byte>^ blob;
+			const ShaderPermutations::BlobEntry* entry = FindPermutation(key, blob);
+			if (entry == nullptr)
+			{
+				return GetVSAsync(name, type).then([](ID3D11VertexShader* vs)
+				{
+					return ComPtr<ID3D11VertexShader>(vs);
+				});
+			}
+
+			Platform::String^ debugName = ref new Platform::String(name.c_str());
+			const byte* bytecode = blob->Data + entry->Offset;
+			ComPtr<ID3D11VertexShader> vs;
+			ComPtr<ID3D11InputLayout> inputLayout;
+			InputLayoutType missing = GetMissingLayout(type);
+			D3D11_INPUT_ELEMENT_DESC* desc = nullptr;
+			uint32 count = 0;
+			if (missing == InputLayoutType::None)
+			{
+				m_loader->CreateShader(bytecode, entry->Size, debugName, nullptr, 0, vs.GetAddressOf(), nullptr);
+			}
+			else if (GetLayoutDesc(missing, desc, count))
+			{
+				m_loader->CreateShader(bytecode, entry->Size, debugName, desc, count, vs.GetAddressOf(), inputLayout.GetAddressOf());
+				SetInputLayout(missing, inputLayout.Get());
+			}
+			return concurrency::task_from_result(vs);
 		});
-	}
+	}).then([](ComPtr<ID3D11VertexShader> vs)
+	{
+		return vs.Get();
+	});
+}
+
+concurrency::task<ID3D11PixelShader*> ShaderMgr::GetPSAsync(UINT key)
+{
+	return GetPermutationAsync<ID3D11PixelShader>(m_permutationPS, key, [this](std::wstring name)
+	{
+		return GetPSAsync(name);
+	});
+}
+
+concurrency::task<ID3D11DomainShader*> ShaderMgr::GetDSAsync(UINT key)
+{
+	return GetPermutationAsync<ID3D11DomainShader>(m_permutationDS, key, [this](std::wstring name)
+	{
+		return GetDSAsync(name);
+	});
 }
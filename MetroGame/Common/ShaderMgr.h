@@ -1,6 +1,8 @@
 #pragma once
 
 #include "BasicLoader.h"
+#include "AsyncCache.h"
+#include "ShaderPermutations.h"
 #include <map>
 #include <ppltasks.h>
 
@@ -61,6 +63,16 @@ namespace DX
 		unsigned int Type;
 	};
 
+	// Per instance data of the instanced BasicObject path, bound to input slot 1.
+	// World is not transposed, WorldInvTranspose holds the first three rows of the
+	// transposed inverse transpose.
+	struct BasicInstance
+	{
+		DirectX::XMFLOAT4X4 World;
+		DirectX::XMFLOAT4 WorldInvTranspose[3];
+		UINT MatIndex;
+	};
+
 	enum class InputLayoutType
 	{
 		None,
@@ -71,7 +83,9 @@ namespace DX
 		PosColor,
 		PointSize,
 		PosTexBound,
-		BasicParticle
+		BasicParticle,
+		Basic32Instanced,
+		PosNormalTexTanInstanced
 	};
 
 	enum class StreamOutType
@@ -106,16 +120,57 @@ namespace DX
 		ID3D11DomainShader* GetDS(std::wstring name);
 		concurrency::task<ID3D11DomainShader*> GetDSAsync(std::wstring name);
 
+		// BasicObject permutations by key, see ShaderPermutations.h. The blob written by the
+		// ShaderPacker tool is read in one go; keys it does not hold, or all keys when there is
+		// no blob, are loaded from the file GetFileName gives. Requests made while the blob is
+		// being read wait for it. The returned task never fails, a missing or invalid blob is
+		// logged and every key then comes from its file.
+		concurrency::task<void> LoadPermutationsAsync(Platform::String^ filename);
+		concurrency::task<ID3D11VertexShader*> GetVSAsync(UINT key);
+		concurrency::task<ID3D11PixelShader*> GetPSAsync(UINT key);
+		concurrency::task<ID3D11DomainShader*> GetDSAsync(UINT key);
+
+		AsyncCacheStats GetVSStats()const { return m_vs.GetStats(); }
+		AsyncCacheStats GetPSStats()const { return m_ps.GetStats(); }
+
+	private:
+		InputLayoutType GetMissingLayout(InputLayoutType type);
+		void SetInputLayout(InputLayoutType type, ID3D11InputLayout* inputLayout);
+		const ShaderPermutations::BlobEntry* FindPermutation(UINT key, Platform::Array<byte>^& blob);
+		template<typename T>
+		concurrency::task<T*> GetPermutationAsync(AsyncCache<Microsoft::WRL::ComPtr<T>, UINT>& cache, UINT key,
+			const std::function<concurrency::task<T*>(std::wstring)>& loadFile);
+
 	private:
 		std::shared_ptr<BasicLoader> m_loader;
 
+		// Requests for a shader that is still loading join that load, see AsyncCache
+		std::mutex m_inputLayoutLock;
 		std::map<InputLayoutType, Microsoft::WRL::ComPtr<ID3D11InputLayout>> m_inputLayout;
-		std::map<std::wstring, Microsoft::WRL::ComPtr<ID3D11VertexShader>> m_vs;
-		std::map<std::wstring, Microsoft::WRL::ComPtr<ID3D11PixelShader>> m_ps;
-		std::map<std::wstring, Microsoft::WRL::ComPtr<ID3D11ComputeShader>> m_cs;
-		std::map<std::wstring, Microsoft::WRL::ComPtr<ID3D11GeometryShader>> m_gs;
-		std::map<std::wstring, Microsoft::WRL::ComPtr<ID3D11HullShader>> m_hs;
-		std::map<std::wstring, Microsoft::WRL::ComPtr<ID3D11DomainShader>> m_ds;
+		AsyncCache<Microsoft::WRL::ComPtr<ID3D11VertexShader>> m_vs;
+		AsyncCache<Microsoft::WRL::ComPtr<ID3D11PixelShader>> m_ps;
+		AsyncCache<Microsoft::WRL::ComPtr<ID3D11ComputeShader>> m_cs;
+		AsyncCache<Microsoft::WRL::ComPtr<ID3D11GeometryShader>> m_gs;
+		AsyncCache<Microsoft::WRL::ComPtr<ID3D11HullShader>> m_hs;
+		AsyncCache<Microsoft::WRL::ComPtr<ID3D11DomainShader>> m_ds;
+
+		// Permutation blob, entries point into it. The blob read only holds this state, so a
+		// ShaderMgr can be destroyed, and the next one created, while the read is in flight.
+		struct PermutationBlob
+		{
+			PermutationBlob() : Data(nullptr), Entries(nullptr), Count(0) {}
+
+			std::mutex Lock;
+			Platform::Array<byte>^ Data;
+			const ShaderPermutations::BlobEntry* Entries;
+			uint32_t Count;
+		};
+		std::mutex m_permutationLock;
+		concurrency::task<void> m_permutationsLoaded;
+		std::shared_ptr<PermutationBlob> m_permutationBlob;
+		AsyncCache<Microsoft::WRL::ComPtr<ID3D11VertexShader>, UINT> m_permutationVS;
+		AsyncCache<Microsoft::WRL::ComPtr<ID3D11PixelShader>, UINT> m_permutationPS;
+		AsyncCache<Microsoft::WRL::ComPtr<ID3D11DomainShader>, UINT> m_permutationDS;
 		
 		// Singleton
 		static ShaderMgr* m_instance;
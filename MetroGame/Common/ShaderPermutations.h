@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <string>
+
+// Keys and on disk layout of the BasicObject shader permutations, shared by ShaderMgr and the
+// ShaderPacker tool, so it only depends on the standard library.
+//
+// A key holds the shader family in the top byte and the feature bits below it. Each family
+// keeps only the features it is compiled for, so equal permutations always get equal keys.
+// GetFileName gives the name of the compiled shader of a key, the digits follow the defines
+// of the files in Shaders/BasicObject/Specific.
+//
+//   BlobHeader | BlobEntry index, sorted by Key | bytecode, each aligned to EntryAlignment
+//
+// The index is small enough to be searched in place once the blob is read.
+
+namespace DX
+{
+	namespace ShaderPermutations
+	{
+		const uint32_t Magic = 0x5048534D;		// "MSHP"
+		const uint32_t Version = 1;
+		const uint32_t EntryAlignment = 16;
+
+		enum Family : uint32_t
+		{
+			BasicVS = 1,
+			BasicPS = 2,
+			BasicInstVS = 3,
+			BasicInstPS = 4,
+			BasicDS = 5
+		};
+		const uint32_t FamilyShift = 24;
+
+		enum Feature : uint32_t
+		{
+			Normal = 1 << 0,
+			Tess = 1 << 1,
+			Shadow = 1 << 2,
+			Ssao = 1 << 3,
+			Skinned = 1 << 4,
+			Texture = 1 << 5,
+			Clip = 1 << 6,
+			Reflect = 1 << 7,
+			Fog = 1 << 8,
+			LightCount = 3 << 9		// 0 to 3 lights
+		};
+		const uint32_t LightCountShift = 9;
+
+		struct BlobHeader
+		{
+			uint32_t Magic;
+			uint32_t Version;
+			uint32_t EntryCount;
+			uint32_t EntryAlignment;
+		};
+
+		struct BlobEntry
+		{
+			uint32_t Key;
+			uint32_t Offset;		// From the start of the blob
+			uint32_t Size;
+			uint32_t Reserved;
+		};
+
+		namespace Detail
+		{
+			// File name prefix and digits of a family, nullptr for unknown families
+			inline const wchar_t* GetFamilyLayout(uint32_t family, const uint32_t*& digits, size_t& digitCount)
+			{
+				static const uint32_t vs[] = { Normal, Tess, Shadow, Ssao, Skinned };
+				static const uint32_t ps[] = { Texture, Clip, Normal, Shadow, Ssao, LightCount, Reflect, Fog };
+				static const uint32_t instVS[] = { Normal, Shadow, Ssao };
+				static const uint32_t ds[] = { Shadow, Ssao };
+				switch (family)
+				{
+				case BasicVS: digits = vs; digitCount = 5; return L"BasicVS";
+				case BasicPS: digits = ps; digitCount = 8; return L"BasicPS";
+				case BasicInstVS: digits = instVS; digitCount = 3; return L"BasicInstVS";
+				case BasicInstPS: digits = ps; digitCount = 8; return L"BasicInstPS";
+				case BasicDS: digits = ds; digitCount = 2; return L"BasicDS";
+				default: return nullptr;
+				}
+			}
+		}
+
+		inline uint32_t GetFamilyFeatures(uint32_t family)
+		{
+			const uint32_t* digits;
+			size_t digitCount;
+			if (!Detail::GetFamilyLayout(family, digits, digitCount))
+				return 0;
+			uint32_t features = 0;
+			for (size_t i = 0; i < digitCount; ++i)
+				features |= digits[i];
+			return features;
+		}
+
+		inline uint32_t MakeKey(uint32_t family, uint32_t features)
+		{
+			return (family << FamilyShift) | (features & GetFamilyFeatures(family));
+		}
+
+		inline uint32_t GetFamily(uint32_t key)
+		{
+			return key >> FamilyShift;
+		}
+
+		inline uint32_t MakeLightCount(uint32_t count)
+		{
+			return (count << LightCountShift) & LightCount;
+		}
+
+		// Empty for keys of unknown families.
+		inline std::wstring GetFileName(uint32_t key)
+		{
+			const uint32_t* digits;
+			size_t digitCount;
+			const wchar_t* prefix = Detail::GetFamilyLayout(GetFamily(key), digits, digitCount);
+			if (!prefix)
+				return std::wstring();
+			std::wstring name(prefix);
+			for (size_t i = 0; i < digitCount; ++i)
+			{
+				if (digits[i] == LightCount)
+					name += (wchar_t)(L'0' + ((key & LightCount) >> LightCountShift));
+				else
+					name += (key & digits[i]) ? L'1' : L'0';
+			}
+			name += L".cso";
+			return name;
+		}
+
+		// Inverse of GetFileName, false for names of other shaders.
+		inline bool ParseFileName(const std::wstring& name, uint32_t& key)
+		{
+			for (uint32_t family = BasicVS; family <= BasicDS; ++family)
+			{
+				const uint32_t* digits;
+				size_t digitCount;
+				const wchar_t* prefix = Detail::GetFamilyLayout(family, digits, digitCount);
+				size_t prefixLength = wcslen(prefix);
+				if (name.size() != prefixLength + digitCount + 4 || name.compare(0, prefixLength, prefix) != 0
+					|| name.compare(prefixLength + digitCount, 4, L".cso") != 0)
+					continue;
+
+				uint32_t features = 0;
+				size_t i = 0;
+				for (; i < digitCount; ++i)
+				{
+					wchar_t c = name[prefixLength + i];
+					if (digits[i] == LightCount && c >= L'0' && c <= L'3')
+						features |= MakeLightCount(c - L'0');
+					else if (c == L'1' && digits[i] != LightCount)
+						features |= digits[i];
+					else if (c != L'0')
+						break;
+				}
+				if (i != digitCount)
+					continue;
+				key = MakeKey(family, features);
+				return true;
+			}
+			return false;
+		}
+
+		// Header and index of a blob, false when either does not fit size or an entry lies
+		// outside the blob. entries points into data.
+		inline bool ReadIndex(const uint8_t* data, size_t size, const BlobEntry*& entries, uint32_t& entryCount)
+		{
+			BlobHeader header;
+			if (size < sizeof(header))
+				return false;
+			memcpy(&header, data, sizeof(header));
+			if (header.Magic != Magic || header.Version != Version
+				|| header.EntryCount > (size - sizeof(header)) / sizeof(BlobEntry))
+				return false;
+			entries = (const BlobEntry*)(data + sizeof(header));
+			entryCount = header.EntryCount;
+			for (uint32_t i = 0; i < entryCount; ++i)
+			{
+				if (entries[i].Offset > size || entries[i].Size > size - entries[i].Offset
+					|| (i > 0 && entries[i - 1].Key >= entries[i].Key))
+					return false;
+			}
+			return true;
+		}
+
+		// nullptr when key is not in the index.
+		inline const BlobEntry* FindEntry(const BlobEntry* entries, uint32_t entryCount, uint32_t key)
+		{
+			const BlobEntry* end = entries + entryCount;
+			const BlobEntry* it = std::lower_bound(entries, end, key,
+				[](const BlobEntry& entry, uint32_t k) { return entry.Key < k; });
+			return (it != end && it->Key == key) ? it : nullptr;
+		}
+	}
+}
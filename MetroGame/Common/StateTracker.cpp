@@ -0,0 +1,467 @@
+#include "pch.h"
+#include "StateTracker.h"
+
+using namespace DX;
+
+// Only the null backend exists where the Windows SDK is missing, device calls compile out there.
+#ifdef _WIN32
+#define ISSUE(call) do { if (m_context) m_context->call; } while (0)
+
+static_assert(StateTracker::ConstantBufferSlots == D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, "Constant buffer slots");
+static_assert(StateTracker::SamplerSlots == D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT, "Sampler slots");
+static_assert(StateTracker::UnorderedAccessSlots == D3D11_PS_CS_UAV_REGISTER_COUNT, "Unordered access slots");
+static_assert(StateTracker::RenderTargetSlots == D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, "Render target slots");
+#else
+#define ISSUE(call) do {} while (0)
+#endif
+
+// Bind points hold this after Invalidate so that any value, nullptr included, differs from it.
+template<typename T>
+static T* Unknown() { return reinterpret_cast<T*>(~(uintptr_t)0); }
+
+template<typename T>
+static void Forget(T** cache, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+		cache[i] = Unknown<T>();
+}
+
+// The range [first, first + count) of a call that has to be issued, given the changed slots
+// relative to start (changedFirst == num for none). Calls reaching past the tracked slots are
+// issued whole.
+static bool IssuedRange(uint32_t cacheSize, uint32_t start, uint32_t num, uint32_t changedFirst, uint32_t changedLast, uint32_t& first, uint32_t& count)
+{
+	if (start + num > cacheSize)
+	{
+		first = start;
+		count = num;
+		return true;
+	}
+	if (changedFirst == num)
+		return false;
+	first = start + changedFirst;
+	count = changedLast - changedFirst + 1;
+	return true;
+}
+
+// Store values in the tracked slots and return the range that has to be issued
+template<typename T>
+static bool UpdateSlots(T** cache, uint32_t cacheSize, uint32_t start, uint32_t num, T* const* values, uint32_t& first, uint32_t& count)
+{
+	uint32_t changedFirst = num, changedLast = 0;
+	for (uint32_t i = 0; i < num && start + i < cacheSize; ++i)
+	{
+		if (cache[start + i] != values[i])
+		{
+			cache[start + i] = values[i];
+			if (changedFirst == num)
+				changedFirst = i;
+			changedLast = i;
+		}
+	}
+	return IssuedRange(cacheSize, start, num, changedFirst, changedLast, first, count);
+}
+
+// The resource behind a view. With a context the view is asked, the reference GetResource
+// adds is dropped at once since only the address is compared.
+template<typename View>
+static const void* ResourceOf(ID3D11DeviceContext1* context, const std::map<const void*, const void*>& resources, View* view)
+{
+#ifdef _WIN32
+	if (context)
+	{
+		ID3D11Resource* resource = nullptr;
+		view->GetResource(&resource);
+		resource->Release();
+		return resource;
+	}
+#endif
+	auto it = resources.find(view);
+	return it != resources.end() ? it->second : view;
+}
+
+uint32_t StateCounts::GetTotalRequested()const
+{
+	uint32_t total = 0;
+	for (int i = 0; i < (int)StateCategory::Count; ++i)
+		total += Requested[i];
+	return total;
+}
+
+uint32_t StateCounts::GetTotalIssued()const
+{
+	uint32_t total = 0;
+	for (int i = 0; i < (int)StateCategory::Count; ++i)
+		total += Issued[i];
+	return total;
+}
+
+StateTracker::StateTracker(ID3D11DeviceContext1* context /* = nullptr */)
+	: m_context(context), m_component(nullptr)
+{
+	Invalidate();
+}
+
+void StateTracker::Invalidate()
+{
+	m_inputLayout = Unknown<ID3D11InputLayout>();
+	m_topology = (uint32_t)-1;
+	Forget(m_vertexBuffers, VertexBufferSlots);
+	m_indexBuffer = Unknown<ID3D11Buffer>();
+	Forget(m_shaders, (uint32_t)ShaderStage::Count);
+	for (int stage = 0; stage < (int)ShaderStage::Count; ++stage)
+	{
+		Forget(m_constantBuffers[stage], ConstantBufferSlots);
+		Forget(m_shaderResources[stage], ShaderResourceSlots);
+		Forget(m_samplers[stage], SamplerSlots);
+	}
+	Forget(m_unorderedAccess, UnorderedAccessSlots);
+	m_rasterizerState = Unknown<ID3D11RasterizerState>();
+	m_blendState = Unknown<ID3D11BlendState>();
+	m_depthStencilState = Unknown<ID3D11DepthStencilState>();
+	m_renderTargetCount = (uint32_t)-1;
+	m_depthView = Unknown<ID3D11DepthStencilView>();
+}
+
+void StateTracker::BeginFrame()
+{
+	m_frameCounts = StateCounts();
+	// Entries are reset rather than erased, m_component may point at one of them.
+	for (auto& entry : m_componentCounts)
+		entry.second = StateCounts();
+}
+
+void StateTracker::SetComponent(const char* name)
+{
+	m_component = name ? &m_componentCounts[name] : nullptr;
+}
+
+void StateTracker::SetViewResource(const void* view, const void* resource)
+{
+	m_viewResources[view] = resource;
+}
+
+void StateTracker::Count(StateCategory category, bool issued)
+{
+	++m_frameCounts.Requested[(int)category];
+	m_frameCounts.Issued[(int)category] += issued;
+	if (m_component)
+	{
+		++m_component->Requested[(int)category];
+		m_component->Issued[(int)category] += issued;
+	}
+}
+
+#pragma region Input assembler
+
+void StateTracker::IASetInputLayout(ID3D11InputLayout* layout)
+{
+	bool issue = layout != m_inputLayout;
+	Count(StateCategory::InputLayout, issue);
+	if (!issue)
+		return;
+	m_inputLayout = layout;
+	ISSUE(IASetInputLayout(layout));
+}
+
+void StateTracker::IASetPrimitiveTopology(uint32_t topology)
+{
+	bool issue = topology != m_topology;
+	Count(StateCategory::Topology, issue);
+	if (!issue)
+		return;
+	m_topology = topology;
+	ISSUE(IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology));
+}
+
+void StateTracker::IASetVertexBuffers(uint32_t startSlot, uint32_t numBuffers, ID3D11Buffer* const* buffers, const uint32_t* strides, const uint32_t* offsets)
+{
+	// A slot differs when any of buffer, stride and offset does
+	bool issue = startSlot + numBuffers > VertexBufferSlots;
+	for (uint32_t i = 0; i < numBuffers && startSlot + i < VertexBufferSlots; ++i)
+	{
+		uint32_t slot = startSlot + i;
+		if (m_vertexBuffers[slot] != buffers[i] || m_strides[slot] != strides[i] || m_offsets[slot] != offsets[i])
+		{
+			m_vertexBuffers[slot] = buffers[i];
+			m_strides[slot] = strides[i];
+			m_offsets[slot] = offsets[i];
+			issue = true;
+		}
+	}
+	Count(StateCategory::VertexBuffer, issue);
+	if (issue)
+		ISSUE(IASetVertexBuffers(startSlot, numBuffers, buffers, strides, offsets));
+}
+
+void StateTracker::IASetIndexBuffer(ID3D11Buffer* buffer, uint32_t format, uint32_t offset)
+{
+	bool issue = buffer != m_indexBuffer || format != m_indexFormat || offset != m_indexOffset;
+	Count(StateCategory::IndexBuffer, issue);
+	if (!issue)
+		return;
+	m_indexBuffer = buffer;
+	m_indexFormat = format;
+	m_indexOffset = offset;
+	ISSUE(IASetIndexBuffer(buffer, (DXGI_FORMAT)format, offset));
+}
+
+#pragma endregion
+
+#pragma region Shader stages
+
+void StateTracker::SetShader(ShaderStage stage, void* shader)
+{
+	bool issue = shader != m_shaders[(int)stage];
+	Count(StateCategory::Shader, issue);
+	if (!issue)
+		return;
+	m_shaders[(int)stage] = shader;
+	switch (stage)
+	{
+	case ShaderStage::VS: ISSUE(VSSetShader(static_cast<ID3D11VertexShader*>(shader), nullptr, 0)); break;
+	case ShaderStage::HS: ISSUE(HSSetShader(static_cast<ID3D11HullShader*>(shader), nullptr, 0)); break;
+	case ShaderStage::DS: ISSUE(DSSetShader(static_cast<ID3D11DomainShader*>(shader), nullptr, 0)); break;
+	case ShaderStage::GS: ISSUE(GSSetShader(static_cast<ID3D11GeometryShader*>(shader), nullptr, 0)); break;
+	case ShaderStage::PS: ISSUE(PSSetShader(static_cast<ID3D11PixelShader*>(shader), nullptr, 0)); break;
+	case ShaderStage::CS: ISSUE(CSSetShader(static_cast<ID3D11ComputeShader*>(shader), nullptr, 0)); break;
+	default: break;
+	}
+}
+
+void StateTracker::SetConstantBuffers(ShaderStage stage, uint32_t startSlot, uint32_t numBuffers, ID3D11Buffer* const* buffers)
+{
+	SetConstantBuffers1(stage, startSlot, numBuffers, buffers, nullptr, nullptr);
+}
+
+void StateTracker::SetConstantBuffers1(ShaderStage stage, uint32_t startSlot, uint32_t numBuffers, ID3D11Buffer* const* buffers,
+	const uint32_t* firstConstants, const uint32_t* numConstants)
+{
+	// A slot differs when the buffer or its range does, a plain bind is the range 0, 0
+	ID3D11Buffer** cache = m_constantBuffers[(int)stage];
+	uint32_t* cacheFirst = m_constantFirst[(int)stage];
+	uint32_t* cacheCount = m_constantCount[(int)stage];
+	uint32_t changedFirst = numBuffers, changedLast = 0;
+	for (uint32_t i = 0; i < numBuffers && startSlot + i < ConstantBufferSlots; ++i)
+	{
+		uint32_t slot = startSlot + i;
+		uint32_t firstConstant = firstConstants ? firstConstants[i] : 0;
+		uint32_t numConstant = numConstants ? numConstants[i] : 0;
+		if (cache[slot] != buffers[i] || cacheFirst[slot] != firstConstant || cacheCount[slot] != numConstant)
+		{
+			cache[slot] = buffers[i];
+			cacheFirst[slot] = firstConstant;
+			cacheCount[slot] = numConstant;
+			if (changedFirst == numBuffers)
+				changedFirst = i;
+			changedLast = i;
+		}
+	}
+	uint32_t first, count;
+	bool issue = IssuedRange(ConstantBufferSlots, startSlot, numBuffers, changedFirst, changedLast, first, count);
+	Count(StateCategory::ConstantBuffer, issue);
+	if (!issue)
+		return;
+
+	buffers += first - startSlot;
+	if (firstConstants)
+	{
+		firstConstants += first - startSlot;
+		numConstants += first - startSlot;
+		switch (stage)
+		{
+		case ShaderStage::VS: ISSUE(VSSetConstantBuffers1(first, count, buffers, firstConstants, numConstants)); break;
+		case ShaderStage::HS: ISSUE(HSSetConstantBuffers1(first, count, buffers, firstConstants, numConstants)); break;
+		case ShaderStage::DS: ISSUE(DSSetConstantBuffers1(first, count, buffers, firstConstants, numConstants)); break;
+		case ShaderStage::GS: ISSUE(GSSetConstantBuffers1(first, count, buffers, firstConstants, numConstants)); break;
+		case ShaderStage::PS: ISSUE(PSSetConstantBuffers1(first, count, buffers, firstConstants, numConstants)); break;
+		case ShaderStage::CS: ISSUE(CSSetConstantBuffers1(first, count, buffers, firstConstants, numConstants)); break;
+		default: break;
+		}
+		return;
+	}
+	switch (stage)
+	{
+	case ShaderStage::VS: ISSUE(VSSetConstantBuffers(first, count, buffers)); break;
+	case ShaderStage::HS: ISSUE(HSSetConstantBuffers(first, count, buffers)); break;
+	case ShaderStage::DS: ISSUE(DSSetConstantBuffers(first, count, buffers)); break;
+	case ShaderStage::GS: ISSUE(GSSetConstantBuffers(first, count, buffers)); break;
+	case ShaderStage::PS: ISSUE(PSSetConstantBuffers(first, count, buffers)); break;
+	case ShaderStage::CS: ISSUE(CSSetConstantBuffers(first, count, buffers)); break;
+	default: break;
+	}
+}
+
+void StateTracker::SetShaderResources(ShaderStage stage, uint32_t startSlot, uint32_t numViews, ID3D11ShaderResourceView* const* views)
+{
+	uint32_t first, count;
+	bool issue = UpdateSlots(m_shaderResources[(int)stage], ShaderResourceSlots, startSlot, numViews, views, first, count);
+	Count(StateCategory::ShaderResource, issue);
+	if (!issue)
+		return;
+	views += first - startSlot;
+	switch (stage)
+	{
+	case ShaderStage::VS: ISSUE(VSSetShaderResources(first, count, views)); break;
+	case ShaderStage::HS: ISSUE(HSSetShaderResources(first, count, views)); break;
+	case ShaderStage::DS: ISSUE(DSSetShaderResources(first, count, views)); break;
+	case ShaderStage::GS: ISSUE(GSSetShaderResources(first, count, views)); break;
+	case ShaderStage::PS: ISSUE(PSSetShaderResources(first, count, views)); break;
+	case ShaderStage::CS: ISSUE(CSSetShaderResources(first, count, views)); break;
+	default: break;
+	}
+}
+
+void StateTracker::SetSamplers(ShaderStage stage, uint32_t startSlot, uint32_t numSamplers, ID3D11SamplerState* const* samplers)
+{
+	uint32_t first, count;
+	bool issue = UpdateSlots(m_samplers[(int)stage], SamplerSlots, startSlot, numSamplers, samplers, first, count);
+	Count(StateCategory::Sampler, issue);
+	if (!issue)
+		return;
+	samplers += first - startSlot;
+	switch (stage)
+	{
+	case ShaderStage::VS: ISSUE(VSSetSamplers(first, count, samplers)); break;
+	case ShaderStage::HS: ISSUE(HSSetSamplers(first, count, samplers)); break;
+	case ShaderStage::DS: ISSUE(DSSetSamplers(first, count, samplers)); break;
+	case ShaderStage::GS: ISSUE(GSSetSamplers(first, count, samplers)); break;
+	case ShaderStage::PS: ISSUE(PSSetSamplers(first, count, samplers)); break;
+	case ShaderStage::CS: ISSUE(CSSetSamplers(first, count, samplers)); break;
+	default: break;
+	}
+}
+
+void StateTracker::CSSetUnorderedAccessViews(uint32_t startSlot, uint32_t numViews, ID3D11UnorderedAccessView* const* views)
+{
+	uint32_t first, count;
+	bool issue = UpdateSlots(m_unorderedAccess, UnorderedAccessSlots, startSlot, numViews, views, first, count);
+	Count(StateCategory::UnorderedAccess, issue);
+	if (issue)
+		ISSUE(CSSetUnorderedAccessViews(first, count, views + (first - startSlot), nullptr));
+}
+
+#pragma endregion
+
+#pragma region Rasterizer and output merger
+
+void StateTracker::RSSetState(ID3D11RasterizerState* state)
+{
+	bool issue = state != m_rasterizerState;
+	Count(StateCategory::Rasterizer, issue);
+	if (!issue)
+		return;
+	m_rasterizerState = state;
+	ISSUE(RSSetState(state));
+}
+
+void StateTracker::OMSetBlendState(ID3D11BlendState* state, const float blendFactor[4], uint32_t sampleMask)
+{
+	static const float defaultFactor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	const float* factor = blendFactor ? blendFactor : defaultFactor;
+	bool issue = state != m_blendState || sampleMask != m_sampleMask || memcmp(factor, m_blendFactor, sizeof(m_blendFactor)) != 0;
+	Count(StateCategory::Blend, issue);
+	if (!issue)
+		return;
+	m_blendState = state;
+	m_sampleMask = sampleMask;
+	memcpy(m_blendFactor, factor, sizeof(m_blendFactor));
+	ISSUE(OMSetBlendState(state, blendFactor, sampleMask));
+}
+
+void StateTracker::OMSetDepthStencilState(ID3D11DepthStencilState* state, uint32_t stencilRef)
+{
+	bool issue = state != m_depthStencilState || stencilRef != m_stencilRef;
+	Count(StateCategory::DepthStencil, issue);
+	if (!issue)
+		return;
+	m_depthStencilState = state;
+	m_stencilRef = stencilRef;
+	ISSUE(OMSetDepthStencilState(state, stencilRef));
+}
+
+void StateTracker::OMSetRenderTargets(uint32_t numViews, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthView)
+{
+	// Render targets unbind every slot above numViews, so the set is compared as a whole
+	bool issue = numViews > RenderTargetSlots || numViews != m_renderTargetCount || depthView != m_depthView;
+	for (uint32_t i = 0; !issue && i < numViews; ++i)
+		issue = views[i] != m_renderTargets[i];
+	Count(StateCategory::RenderTarget, issue);
+	if (!issue)
+		return;
+	UnbindOutputs(numViews, views, depthView);
+	m_renderTargetCount = numViews;
+	m_depthView = depthView;
+	for (uint32_t i = 0; i < numViews && i < RenderTargetSlots; ++i)
+		m_renderTargets[i] = views[i];
+	ISSUE(OMSetRenderTargets(numViews, views, depthView));
+}
+
+// The runtime unbinds shader resource views whose resource is bound as an output, so the
+// cached views go as well. Unbinding them first also keeps the debug layer quiet.
+void StateTracker::UnbindOutputs(uint32_t numViews, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthView)
+{
+	const void* outputs[RenderTargetSlots + 1];
+	uint32_t outputCount = 0;
+	for (uint32_t i = 0; i < numViews && i < RenderTargetSlots; ++i)
+	{
+		if (views[i])
+			outputs[outputCount++] = ResourceOf(m_context, m_viewResources, views[i]);
+	}
+	if (depthView)
+		outputs[outputCount++] = ResourceOf(m_context, m_viewResources, depthView);
+	if (outputCount == 0)
+		return;
+
+	for (int stage = 0; stage < (int)ShaderStage::Count; ++stage)
+	{
+		for (uint32_t slot = 0; slot < ShaderResourceSlots; ++slot)
+		{
+			ID3D11ShaderResourceView* view = m_shaderResources[stage][slot];
+			if (!view || view == Unknown<ID3D11ShaderResourceView>())
+				continue;
+			const void* resource = ResourceOf(m_context, m_viewResources, view);
+			for (uint32_t k = 0; k < outputCount; ++k)
+			{
+				if (resource != outputs[k])
+					continue;
+				ID3D11ShaderResourceView* nullView = nullptr;
+				SetShaderResources((ShaderStage)stage, slot, 1, &nullView);
+				++m_frameCounts.HazardUnbinds;
+				if (m_component)
+					++m_component->HazardUnbinds;
+				break;
+			}
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region Draw
+
+void StateTracker::Draw(uint32_t vertexCount, uint32_t startVertex)
+{
+	Count(StateCategory::Draw, true);
+	ISSUE(Draw(vertexCount, startVertex));
+}
+
+void StateTracker::DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	Count(StateCategory::Draw, true);
+	ISSUE(DrawIndexed(indexCount, startIndex, baseVertex));
+}
+
+void StateTracker::DrawInstanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t startVertex, uint32_t startInstance)
+{
+	Count(StateCategory::Draw, true);
+	ISSUE(DrawInstanced(vertexCount, instanceCount, startVertex, startInstance));
+}
+
+void StateTracker::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	Count(StateCategory::Draw, true);
+	ISSUE(DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance));
+}
+
+#pragma endregion
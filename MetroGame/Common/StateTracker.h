@@ -0,0 +1,190 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+
+// Device context front end that remembers what is bound at every bind point and drops calls
+// that would bind the same thing again. Calls are counted per frame by category, both as
+// requested by the caller and as issued to the context, and attributed to the component set
+// by SetComponent. Without a context (the null backend) only tracking and counting happen,
+// so call counts can be checked without a device.
+// ShaderChangement only covers shaders, input layout, topology and rasterizer state, this
+// covers constant buffers, resources and samplers of every stage as well. Code that binds
+// on the context directly must call Invalidate before going through the tracker again.
+// Read/write hazards are modeled like the runtime does: binding render targets or a depth
+// view unbinds the shader resource views of the same resources. The d3d11 interfaces are only
+// declared here, so the header and the null backend build without the Windows SDK.
+
+struct ID3D11DeviceContext1;
+struct ID3D11InputLayout;
+struct ID3D11Buffer;
+struct ID3D11VertexShader;
+struct ID3D11HullShader;
+struct ID3D11DomainShader;
+struct ID3D11GeometryShader;
+struct ID3D11PixelShader;
+struct ID3D11ComputeShader;
+struct ID3D11ShaderResourceView;
+struct ID3D11SamplerState;
+struct ID3D11UnorderedAccessView;
+struct ID3D11RasterizerState;
+struct ID3D11BlendState;
+struct ID3D11DepthStencilState;
+struct ID3D11RenderTargetView;
+struct ID3D11DepthStencilView;
+
+namespace DX
+{
+	enum class ShaderStage
+	{
+		VS,
+		HS,
+		DS,
+		GS,
+		PS,
+		CS,
+		Count
+	};
+
+	enum class StateCategory
+	{
+		InputLayout,
+		Topology,
+		VertexBuffer,
+		IndexBuffer,
+		Shader,
+		ConstantBuffer,
+		ShaderResource,
+		Sampler,
+		UnorderedAccess,
+		Rasterizer,
+		Blend,
+		DepthStencil,
+		RenderTarget,
+		Draw,
+		Count
+	};
+
+	struct StateCounts
+	{
+		StateCounts() { memset(this, 0, sizeof(StateCounts)); }
+
+		uint32_t GetFiltered(StateCategory c)const { return Requested[(int)c] - Issued[(int)c]; }
+		uint32_t GetTotalRequested()const;
+		uint32_t GetTotalIssued()const;
+
+		uint32_t Requested[(int)StateCategory::Count];
+		uint32_t Issued[(int)StateCategory::Count];
+		// Shader resource views unbound because their resource became an output
+		uint32_t HazardUnbinds;
+	};
+
+	class StateTracker
+	{
+	public:
+		// Slots above these are passed through without filtering. All but the vertex buffer and
+		// shader resource counts are the D3D11_* limits, checked in the source.
+		static const uint32_t VertexBufferSlots = 16;
+		static const uint32_t ConstantBufferSlots = 14;
+		static const uint32_t ShaderResourceSlots = 16;
+		static const uint32_t SamplerSlots = 16;
+		static const uint32_t UnorderedAccessSlots = 8;
+		static const uint32_t RenderTargetSlots = 8;
+
+		// A null context selects the null backend.
+		StateTracker(ID3D11DeviceContext1* context = nullptr);
+
+		void SetContext(ID3D11DeviceContext1* context) { m_context = context; Invalidate(); }
+		ID3D11DeviceContext1* GetContext()const { return m_context; }
+		// Forget every binding, the next call at each bind point is issued.
+		void Invalidate();
+		// Reset the per frame counts. Tracked bindings are kept.
+		void BeginFrame();
+		// Component the following calls are counted for, nullptr for none.
+		void SetComponent(const char* name);
+		// Null backend only, the resource behind a view. Views of one resource alias each other,
+		// a view never given here is its own resource. With a context the view is asked.
+		void SetViewResource(const void* view, const void* resource);
+
+		const StateCounts& GetFrameCounts()const { return m_frameCounts; }
+		const std::map<std::string, StateCounts>& GetComponentCounts()const { return m_componentCounts; }
+
+	public:
+		// Input assembler. Topology and format take the D3D11_PRIMITIVE_TOPOLOGY and
+		// DXGI_FORMAT values.
+		void IASetInputLayout(ID3D11InputLayout* layout);
+		void IASetPrimitiveTopology(uint32_t topology);
+		void IASetVertexBuffers(uint32_t startSlot, uint32_t numBuffers, ID3D11Buffer* const* buffers, const uint32_t* strides, const uint32_t* offsets);
+		void IASetIndexBuffer(ID3D11Buffer* buffer, uint32_t format, uint32_t offset);
+
+		// Shader stages
+		void VSSetShader(ID3D11VertexShader* shader) { SetShader(ShaderStage::VS, shader); }
+		void HSSetShader(ID3D11HullShader* shader) { SetShader(ShaderStage::HS, shader); }
+		void DSSetShader(ID3D11DomainShader* shader) { SetShader(ShaderStage::DS, shader); }
+		void GSSetShader(ID3D11GeometryShader* shader) { SetShader(ShaderStage::GS, shader); }
+		void PSSetShader(ID3D11PixelShader* shader) { SetShader(ShaderStage::PS, shader); }
+		void CSSetShader(ID3D11ComputeShader* shader) { SetShader(ShaderStage::CS, shader); }
+		void SetConstantBuffers(ShaderStage stage, uint32_t startSlot, uint32_t numBuffers, ID3D11Buffer* const* buffers);
+		// Binds a range of each buffer, in 16 byte constants (D3D 11.1).
+		void SetConstantBuffers1(ShaderStage stage, uint32_t startSlot, uint32_t numBuffers, ID3D11Buffer* const* buffers,
+			const uint32_t* firstConstants, const uint32_t* numConstants);
+		void SetShaderResources(ShaderStage stage, uint32_t startSlot, uint32_t numViews, ID3D11ShaderResourceView* const* views);
+		void SetSamplers(ShaderStage stage, uint32_t startSlot, uint32_t numSamplers, ID3D11SamplerState* const* samplers);
+		void CSSetUnorderedAccessViews(uint32_t startSlot, uint32_t numViews, ID3D11UnorderedAccessView* const* views);
+
+		// Rasterizer and output merger
+		void RSSetState(ID3D11RasterizerState* state);
+		void OMSetBlendState(ID3D11BlendState* state, const float blendFactor[4], uint32_t sampleMask);
+		void OMSetDepthStencilState(ID3D11DepthStencilState* state, uint32_t stencilRef);
+		void OMSetRenderTargets(uint32_t numViews, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthView);
+
+		// Draws are never filtered, only counted.
+		void Draw(uint32_t vertexCount, uint32_t startVertex);
+		void DrawIndexed(uint32_t indexCount, uint32_t startIndex, int32_t baseVertex);
+		void DrawInstanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t startVertex, uint32_t startInstance);
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t startIndex, int32_t baseVertex, uint32_t startInstance);
+
+	private:
+		void SetShader(ShaderStage stage, void* shader);
+		void Count(StateCategory category, bool issued);
+		void UnbindOutputs(uint32_t numViews, ID3D11RenderTargetView* const* views, ID3D11DepthStencilView* depthView);
+
+	private:
+		ID3D11DeviceContext1* m_context;
+
+		ID3D11InputLayout* m_inputLayout;
+		uint32_t m_topology;
+		ID3D11Buffer* m_vertexBuffers[VertexBufferSlots];
+		uint32_t m_strides[VertexBufferSlots];
+		uint32_t m_offsets[VertexBufferSlots];
+		ID3D11Buffer* m_indexBuffer;
+		uint32_t m_indexFormat;
+		uint32_t m_indexOffset;
+
+		void* m_shaders[(int)ShaderStage::Count];
+		ID3D11Buffer* m_constantBuffers[(int)ShaderStage::Count][ConstantBufferSlots];
+		// Bound range of each constant buffer, 0 and 0 for the whole buffer
+		uint32_t m_constantFirst[(int)ShaderStage::Count][ConstantBufferSlots];
+		uint32_t m_constantCount[(int)ShaderStage::Count][ConstantBufferSlots];
+		ID3D11ShaderResourceView* m_shaderResources[(int)ShaderStage::Count][ShaderResourceSlots];
+		ID3D11SamplerState* m_samplers[(int)ShaderStage::Count][SamplerSlots];
+		ID3D11UnorderedAccessView* m_unorderedAccess[UnorderedAccessSlots];
+
+		ID3D11RasterizerState* m_rasterizerState;
+		ID3D11BlendState* m_blendState;
+		float m_blendFactor[4];
+		uint32_t m_sampleMask;
+		ID3D11DepthStencilState* m_depthStencilState;
+		uint32_t m_stencilRef;
+		uint32_t m_renderTargetCount;
+		ID3D11RenderTargetView* m_renderTargets[RenderTargetSlots];
+		ID3D11DepthStencilView* m_depthView;
+
+		std::map<const void*, const void*> m_viewResources;
+		StateCounts* m_component;
+		StateCounts m_frameCounts;
+		std::map<std::string, StateCounts> m_componentCounts;
+	};
+}
@@ -17,29 +17,18 @@ TextureMgr::TextureMgr(const std::shared_ptr<BasicLoader>& loader) : m_loader(lo
 
 ID3D11ShaderResourceView* TextureMgr::GetTexture(std::wstring filename)
 {
-	// Does it already exist?
-	if(m_textureSRV.find(filename) != m_textureSRV.end())
-	{
-		return m_textureSRV[filename].Get();
-	}
-	else
+	return m_textureSRV.GetOrLoad(filename, [=]()
 	{
 		Platform::String^ file = ref new Platform::String(filename.c_str());
 		ComPtr<ID3D11ShaderResourceView> textureView;
 
 		m_loader->LoadTexture(file, false, nullptr, textureView.GetAddressOf());
-		m_textureSRV[filename] = textureView.Get();
-		return textureView.Get();
-	}
+		return textureView;
+	}).Get();
 }
 concurrency::task<ID3D11ShaderResourceView*> TextureMgr::GetTextureAsync(std::wstring filename)
 {
-	// Does it already exist?
-	if (m_textureSRV.find(filename) != m_textureSRV.end())
-	{
-		return concurrency::task_from_result(m_textureSRV[filename].Get());
-	}
-	else
+	return m_textureSRV.GetOrLoadAsync(filename, [=]()
 	{
 		Platform::String^ file = ref new Platform::String(filename.c_str());
 		std::shared_ptr<ComPtr<ID3D11ShaderResourceView>> textureView = std::make_shared<ComPtr<ID3D11ShaderResourceView>>();
@@ -56,20 +45,43 @@ concurrency::task<ID3D11ShaderResourceView*> TextureMgr::GetTextureAsync(std::ws
 				throw ref new Platform::FailureException("Cannot load file " + file);
 			}
 
-			m_textureSRV[filename] = textureView->Get();
-			return textureView->Get();
+			return *textureView;
 		});
-	}
+	}).then([](ComPtr<ID3D11ShaderResourceView> textureView)
+	{
+		return textureView.Get();
+	});
+}
+concurrency::task<ID3D11ShaderResourceView*> TextureMgr::GetTextureWithMipsAsync(std::wstring filename, bool srgb)
+{
+	// Cached apart from the file loaded as is
+	return m_textureSRV.GetOrLoadAsync(filename + L"|mips", [=]()
+	{
+		Platform::String^ file = ref new Platform::String(filename.c_str());
+		std::shared_ptr<ComPtr<ID3D11ShaderResourceView>> textureView = std::make_shared<ComPtr<ID3D11ShaderResourceView>>();
+
+		return m_loader->LoadTextureWithMipsAsync(file, srgb, textureView->GetAddressOf()).then([=](concurrency::task<void> t)
+		{
+			try
+			{
+				t.get();
+			}
+			catch (Platform::COMException^ e)
+			{
+				throw ref new Platform::FailureException("Cannot load file " + file);
+			}
+
+			return *textureView;
+		});
+	}).then([](ComPtr<ID3D11ShaderResourceView> textureView)
+	{
+		return textureView.Get();
+	});
 }
 
 ID3D11ShaderResourceView* TextureMgr::GetTextureArray(std::vector<std::wstring>& filenames, std::wstring name)
 {
-	// Does it already exist?
-	if (m_textureSRV.find(name) != m_textureSRV.end())
-	{
-		return m_textureSRV[name].Get();
-	}
-	else
+	return m_textureSRV.GetOrLoad(name, [&]()
 	{
 		Platform::Array<Platform::String^>^ files = ref new Platform::Array<Platform::String^>(filenames.size());
 		for (size_t i = 0; i < filenames.size(); ++i)
@@ -78,29 +90,141 @@ ID3D11ShaderResourceView* TextureMgr::GetTextureArray(std::vector<std::wstring>&
 		ComPtr<ID3D11ShaderResourceView> textureView;
 
 		m_loader->LoadTextureArray(files, textureView.GetAddressOf());
-		m_textureSRV[name] = textureView.Get();
-		return textureView.Get();
-	}
+		return textureView;
+	}).Get();
 }
 concurrency::task<ID3D11ShaderResourceView*> TextureMgr::GetTextureArrayAsync(std::vector<std::wstring>& filenames, std::wstring name)
 {
-	// Does it already exist?
-	if (m_textureSRV.find(name) != m_textureSRV.end())
-	{
-		return concurrency::task_from_result(m_textureSRV[name].Get());
-	}
-	else
+	// The file list is copied, the load may start after the caller's vector is gone
+	std::vector<std::wstring> names(filenames);
+	return m_textureSRV.GetOrLoadAsync(name, [=]()
 	{
-		Platform::Array<Platform::String^>^ files = ref new Platform::Array<Platform::String^>(filenames.size());
-		for (size_t i = 0; i < filenames.size(); ++i)
-			files[i] = ref new Platform::String(filenames[i].c_str());
+		Platform::Array<Platform::String^>^ files = ref new Platform::Array<Platform::String^>(names.size());
+		for (size_t i = 0; i < names.size(); ++i)
+			files[i] = ref new Platform::String(names[i].c_str());
 
 		std::shared_ptr<ComPtr<ID3D11ShaderResourceView>> textureView = std::make_shared<ComPtr<ID3D11ShaderResourceView>>();
 
 		return m_loader->LoadTextureArrayAsync(files, textureView->GetAddressOf()).then([=]()
 		{
-			m_textureSRV[name] = textureView->Get();
-			return textureView->Get();
+			return *textureView;
+		});
+	}).then([](ComPtr<ID3D11ShaderResourceView> textureView)
+	{
+		return textureView.Get();
+	});
+}
+
+bool TextureMgr::IsStreamable(const std::wstring& filename)
+{
+	size_t dot = filename.find_last_of(L'.');
+	if (dot == std::wstring::npos || filename.size() - dot != 4)
+		return false;
+	return towlower(filename[dot + 1]) == L'd' && towlower(filename[dot + 2]) == L'd' && towlower(filename[dot + 3]) == L's';
+}
+
+void TextureMgr::SetStreamingSettings(const ResidencySettings& settings)
+{
+	std::lock_guard<std::mutex> lock(m_streamingLock);
+	m_residency.SetSettings(settings);
+}
+
+concurrency::task<UINT> TextureMgr::GetStreamedTextureAsync(std::wstring filename)
+{
+	return m_streamedIds.GetOrLoadAsync(filename, [=]()
+	{
+		Platform::String^ file = ref new Platform::String(filename.c_str());
+		std::shared_ptr<ComPtr<ID3D11ShaderResourceView>> textureView = std::make_shared<ComPtr<ID3D11ShaderResourceView>>();
+		std::shared_ptr<DDSMipLayout> layout = std::make_shared<DDSMipLayout>();
+		UINT tailSize;
+		{
+			std::lock_guard<std::mutex> lock(m_streamingLock);
+			tailSize = m_residency.GetSettings().TailSize;
+		}
+
+		// The mip tail is loaded right away, finer mips follow as the texture is used
+		return m_loader->LoadDDSTextureAsync(file, tailSize, textureView->GetAddressOf(), layout.get()).then([=](concurrency::task<void> t)
+		{
+			try
+			{
+				t.get();
+			}
+			catch (Platform::COMException^ e)
+			{
+				throw ref new Platform::FailureException("Cannot load file " + file);
+			}
+
+			std::lock_guard<std::mutex> lock(m_streamingLock);
+			UINT id = m_residency.Register(*layout);
+			m_residency.OnLoaded(id, m_residency.GetTailMip(id));
+			StreamedTexture texture;
+			texture.File = file;
+			texture.View = *textureView;
+			m_streamed.push_back(texture);
+			return id;
+		});
+	});
+}
+
+ComPtr<ID3D11ShaderResourceView> TextureMgr::GetStreamedTexture(UINT id)
+{
+	std::lock_guard<std::mutex> lock(m_streamingLock);
+	return m_streamed[id].View;
+}
+
+void TextureMgr::NoteTextureUse(UINT id, float screenSize)
+{
+	std::lock_guard<std::mutex> lock(m_streamingLock);
+	m_residency.NoteUse(id, screenSize);
+}
+
+void TextureMgr::UpdateStreaming()
+{
+	struct Load
+	{
+		UINT Id;
+		UINT TopMip;
+		UINT MaxSize;
+		Platform::String^ File;
+	};
+	std::vector<Load> loads;
+	{
+		std::lock_guard<std::mutex> lock(m_streamingLock);
+		m_residency.Update(m_requests);
+		for (auto& request : m_requests)
+		{
+			Load load = { request.Id, request.TopMip, m_residency.GetMipSize(request.Id, request.TopMip), m_streamed[request.Id].File };
+			loads.push_back(load);
+		}
+	}
+
+	// Each texture has at most one load in flight. Evictions are loads of the tail, so the
+	// view is only ever replaced when a load finishes, never released while in use.
+	for (auto& load : loads)
+	{
+		std::shared_ptr<ComPtr<ID3D11ShaderResourceView>> textureView = std::make_shared<ComPtr<ID3D11ShaderResourceView>>();
+		m_loader->LoadDDSTextureAsync(load.File, load.MaxSize, textureView->GetAddressOf()).then([=](concurrency::task<void> t)
+		{
+			UINT topMip = load.TopMip;
+			try
+			{
+				t.get();
+			}
+			catch (Platform::Exception^ e)
+			{
+				topMip = TextureResidency::NotResident;
+			}
+
+			std::lock_guard<std::mutex> lock(m_streamingLock);
+			if (topMip != TextureResidency::NotResident)
+				m_streamed[load.Id].View = *textureView;
+			m_residency.OnLoaded(load.Id, topMip);
 		});
 	}
-}
\ No newline at end of file
+}
+
+ResidencyStats TextureMgr::GetStreamingStats()
+{
+	std::lock_guard<std::mutex> lock(m_streamingLock);
+	return m_residency.GetStats();
+}
@@ -4,10 +4,15 @@
 #include "BasicLoader.h"
 #include <ppltasks.h>
 #include <collection.h>
-#include <map>
+#include "AsyncCache.h"
+#include "TextureResidency.h"
+#include <mutex>
 
 /// Simple texture manager to avoid loading duplicate textures from file.  That can
 /// happen, for example, if multiple meshes reference the same texture filename. 
+/// Requests for a file that is still loading join that load, so each file is read once.
+/// Textures loaded by GetTexture stay resident. DDS textures requested as streamed start with
+/// their mip tail and are refined or evicted by UpdateStreaming under a memory budget.
 namespace DX
 {
 	class TextureMgr
@@ -20,12 +25,43 @@ namespace DX
 
 		ID3D11ShaderResourceView* GetTexture(std::wstring filename);
 		concurrency::task<ID3D11ShaderResourceView*> GetTextureAsync(std::wstring filename);
+		// Same file with a mip chain generated on the CPU, see BasicLoader::LoadTextureWithMipsAsync.
+		concurrency::task<ID3D11ShaderResourceView*> GetTextureWithMipsAsync(std::wstring filename, bool srgb);
 		ID3D11ShaderResourceView* GetTextureArray(std::vector<std::wstring>& filenames, std::wstring name);
 		concurrency::task<ID3D11ShaderResourceView*> GetTextureArrayAsync(std::vector<std::wstring>& filenames, std::wstring name);
 
+		AsyncCacheStats GetStats()const { return m_textureSRV.GetStats(); }
+
+		// Streamed textures. The returned id stays valid, the view behind it changes as mips
+		// are loaded and is null while the texture is evicted. Only DDS files can be streamed.
+		static const UINT NotStreamed = 0xffffffff;
+		static bool IsStreamable(const std::wstring& filename);
+		void SetStreamingSettings(const ResidencySettings& settings);
+		concurrency::task<UINT> GetStreamedTextureAsync(std::wstring filename);
+		// A reference is returned, a finishing load may replace the view at any time.
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetStreamedTexture(UINT id);
+		// screenSize is the pixels a user covers along the texture's larger axis this frame.
+		void NoteTextureUse(UINT id, float screenSize);
+		// Once per frame. Starts the loads and releases the evicted textures of this frame.
+		void UpdateStreaming();
+		ResidencyStats GetStreamingStats();
+
+	private:
+		struct StreamedTexture
+		{
+			Platform::String^ File;
+			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> View;
+		};
+
 	private:
 		std::shared_ptr<BasicLoader> m_loader;
-		std::map<std::wstring, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_textureSRV;
+		AsyncCache<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_textureSRV;
+
+		std::mutex m_streamingLock;
+		TextureResidency m_residency;
+		std::vector<StreamedTexture> m_streamed;
+		std::vector<ResidencyRequest> m_requests;
+		AsyncCache<UINT> m_streamedIds;
 
 		static TextureMgr* m_instance;
 	};
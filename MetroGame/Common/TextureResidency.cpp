@@ -0,0 +1,185 @@
+#include "pch.h"
+#include "TextureResidency.h"
+#include <algorithm>
+#include <cfloat>
+
+using namespace DX;
+
+TextureResidency::TextureResidency(const ResidencySettings& settings) :
+	m_settings(settings), m_frame(1)
+{
+}
+
+UINT TextureResidency::Register(const DDSMipLayout& layout)
+{
+	Entry entry;
+	entry.Bytes.resize(layout.MipCount);
+	entry.MipSizes.resize(layout.MipCount);
+	for (UINT i = 0; i < layout.MipCount; ++i)
+	{
+		entry.Bytes[i] = layout.GetBytes(i);
+		entry.MipSizes[i] = std::max<UINT>(layout.Mips[i].Width, layout.Mips[i].Height);
+	}
+	entry.Tail = layout.GetTopMip(m_settings.TailSize);
+	entry.Resident = NotResident;
+	entry.Pending = NotResident;
+	entry.Wanted = entry.Tail;
+	entry.ScreenSize = 0.0f;
+	entry.LastUse = 0;
+	m_stats.TailBytes += entry.Bytes[entry.Tail];
+	m_entries.push_back(entry);
+	return (UINT)m_entries.size() - 1;
+}
+
+UINT TextureResidency::GetTailMip(UINT id)const
+{
+	return m_entries[id].Tail;
+}
+
+void TextureResidency::NoteUse(UINT id, float screenSize)
+{
+	Entry& entry = m_entries[id];
+	entry.LastUse = m_frame;
+	entry.ScreenSize = std::max<float>(entry.ScreenSize, screenSize);
+}
+
+UINT64 TextureResidency::GetCommitted(const Entry& entry)const
+{
+	if (entry.Pending != NotResident)
+		return entry.Bytes[entry.Pending];
+	if (entry.Resident != NotResident)
+		return entry.Bytes[entry.Resident];
+	return 0;
+}
+
+bool TextureResidency::MakeRoom(UINT64 bytes, UINT except, std::vector<ResidencyRequest>& requests)
+{
+	if (m_stats.CommittedBytes + bytes <= m_settings.BudgetBytes)
+		return true;
+
+	// Textures not used this frame, least recently used first, go back to their tail. The
+	// finer mips stay until the tail is reloaded, their bytes are already given to the load.
+	m_order.clear();
+	for (UINT i = 0; i < (UINT)m_entries.size(); ++i)
+	{
+		const Entry& entry = m_entries[i];
+		if (i != except && entry.LastUse < m_frame && entry.Resident != NotResident && entry.Resident < entry.Tail &&
+			entry.Pending == NotResident)
+			m_order.push_back(i);
+	}
+	std::sort(m_order.begin(), m_order.end(), [this](UINT a, UINT b) { return m_entries[a].LastUse < m_entries[b].LastUse; });
+	for (UINT id : m_order)
+	{
+		Entry& entry = m_entries[id];
+		m_stats.CommittedBytes -= entry.Bytes[entry.Resident] - entry.Bytes[entry.Tail];
+		entry.Pending = entry.Tail;
+		ResidencyRequest request = { id, entry.Tail };
+		requests.push_back(request);
+		++m_stats.Evictions;
+		if (m_stats.CommittedBytes + bytes <= m_settings.BudgetBytes)
+			return true;
+	}
+
+	// Then textures in use that hold finer mips than they need are reloaded with fewer mips
+	m_order.clear();
+	for (UINT i = 0; i < (UINT)m_entries.size(); ++i)
+	{
+		const Entry& entry = m_entries[i];
+		if (i != except && entry.Resident != NotResident && entry.Pending == NotResident && entry.Resident < entry.Wanted)
+			m_order.push_back(i);
+	}
+	std::sort(m_order.begin(), m_order.end(), [this](UINT a, UINT b) { return m_entries[a].ScreenSize < m_entries[b].ScreenSize; });
+	for (UINT id : m_order)
+	{
+		Entry& entry = m_entries[id];
+		m_stats.CommittedBytes -= entry.Bytes[entry.Resident] - entry.Bytes[entry.Wanted];
+		entry.Pending = entry.Wanted;
+		ResidencyRequest request = { id, entry.Wanted };
+		requests.push_back(request);
+		++m_stats.Trims;
+		if (m_stats.CommittedBytes + bytes <= m_settings.BudgetBytes)
+			return true;
+	}
+	return false;
+}
+
+void TextureResidency::Update(std::vector<ResidencyRequest>& requests)
+{
+	requests.clear();
+	m_stats.Loads = 0;
+	m_stats.Evictions = 0;
+	m_stats.Trims = 0;
+	m_stats.Deferred = 0;
+
+	// Finest mip each texture needs, the smallest one still covering its screen size
+	m_stats.CommittedBytes = 0;
+	std::vector<UINT> candidates;
+	for (UINT i = 0; i < (UINT)m_entries.size(); ++i)
+	{
+		Entry& entry = m_entries[i];
+		entry.Wanted = entry.Tail;
+		if (entry.LastUse == m_frame)
+		{
+			while (entry.Wanted > 0 && (float)entry.MipSizes[entry.Wanted] < entry.ScreenSize)
+				--entry.Wanted;
+			if (entry.Pending == NotResident && (entry.Resident == NotResident || entry.Wanted < entry.Resident))
+				candidates.push_back(i);
+		}
+		m_stats.CommittedBytes += GetCommitted(entry);
+	}
+
+	// Missing textures first, then the largest on screen. Each load adds one mip level.
+	std::sort(candidates.begin(), candidates.end(), [this](UINT a, UINT b)
+	{
+		bool missingA = m_entries[a].Resident == NotResident;
+		bool missingB = m_entries[b].Resident == NotResident;
+		if (missingA != missingB)
+			return missingA;
+		return m_entries[a].ScreenSize > m_entries[b].ScreenSize;
+	});
+	for (UINT id : candidates)
+	{
+		Entry& entry = m_entries[id];
+		if (m_stats.Loads >= m_settings.MaxLoadsPerFrame)
+		{
+			++m_stats.Deferred;
+			continue;
+		}
+		UINT target = entry.Resident == NotResident ? entry.Tail : entry.Resident - 1;
+		UINT64 current = entry.Resident == NotResident ? 0 : entry.Bytes[entry.Resident];
+		UINT64 extra = entry.Bytes[target] - current;
+		if (!MakeRoom(extra, id, requests))
+		{
+			++m_stats.Deferred;
+			continue;
+		}
+		entry.Pending = target;
+		m_stats.CommittedBytes += extra;
+		ResidencyRequest request = { id, target };
+		requests.push_back(request);
+		++m_stats.Loads;
+	}
+
+	for (auto& entry : m_entries)
+		entry.ScreenSize = 0.0f;
+	++m_frame;
+}
+
+void TextureResidency::OnLoaded(UINT id, UINT topMip)
+{
+	Entry& entry = m_entries[id];
+	entry.Pending = NotResident;
+	if (topMip == NotResident)
+		return;
+	if (entry.Resident != NotResident)
+		m_stats.ResidentBytes -= entry.Bytes[entry.Resident];
+	entry.Resident = topMip;
+	m_stats.ResidentBytes += entry.Bytes[topMip];
+}
+
+float TextureResidency::ProjectedSize(float radius, float distance, float projScale, float viewportHeight)
+{
+	if (distance <= radius)
+		return FLT_MAX;
+	return radius / distance * projScale * viewportHeight;
+}
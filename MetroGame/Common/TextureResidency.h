@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+#include "DDSParser.h"
+
+// Residency policy of streamed textures under a byte budget. Every texture starts with its
+// mip tail (mips no larger than TailSize) and gets finer mips one level per load, as far as
+// the on screen size of its users asks for. When a load does not fit the budget, textures
+// not used this frame are evicted back to their tail least recently used first, then
+// textures holding more detail than they need are trimmed. Tails are never evicted, so every
+// texture keeps a view to draw with and the tails are a fixed floor of the budget. The class
+// only decides, the owner performs the loads and reports them back, so the policy runs
+// without a device.
+
+namespace DX
+{
+	struct ResidencySettings
+	{
+		ResidencySettings() : BudgetBytes(256ull * 1024 * 1024), TailSize(64), MaxLoadsPerFrame(4) {}
+
+		UINT64 BudgetBytes;
+		UINT TailSize;
+		UINT MaxLoadsPerFrame;
+	};
+
+	// Load texture Id with mips TopMip and smaller. Evictions and trims are loads of fewer
+	// mips, the owner keeps the current mips until they finish.
+	struct ResidencyRequest
+	{
+		UINT Id;
+		UINT TopMip;
+	};
+
+	struct ResidencyStats
+	{
+		ResidencyStats() : ResidentBytes(0), CommittedBytes(0), TailBytes(0), Loads(0), Evictions(0), Trims(0), Deferred(0) {}
+
+		UINT64 ResidentBytes;
+		UINT64 CommittedBytes;	// Resident plus pending loads
+		UINT64 TailBytes;		// Tails of every texture, never evicted
+		// Counts of the last Update
+		UINT Loads;
+		UINT Evictions;
+		UINT Trims;
+		UINT Deferred;			// Loads that did not fit the budget or the per frame limit
+	};
+
+	class TextureResidency
+	{
+	public:
+		static const UINT NotResident = 0xffffffff;
+
+		TextureResidency(const ResidencySettings& settings = ResidencySettings());
+
+		void SetSettings(const ResidencySettings& settings) { m_settings = settings; }
+		const ResidencySettings& GetSettings()const { return m_settings; }
+
+		// Returns the id of the texture. Nothing is resident until its first load is reported.
+		UINT Register(const DDSMipLayout& layout);
+		// First mip of the tail, where every texture starts.
+		UINT GetTailMip(UINT id)const;
+
+		// A user of the texture covers screenSize pixels along its larger axis this frame.
+		void NoteUse(UINT id, float screenSize);
+		// Decide the loads and evictions of this frame and start the next frame. Evictions
+		// take effect at once, loads when reported through OnLoaded.
+		void Update(std::vector<ResidencyRequest>& requests);
+		// A load requested by Update finished, or failed when topMip is NotResident. A failed
+		// load keeps the mips resident before it.
+		void OnLoaded(UINT id, UINT topMip);
+
+		// Larger of width and height of a mip, the maxSize that loads mips mip and smaller.
+		UINT GetMipSize(UINT id, UINT mip)const { return m_entries[id].MipSizes[mip]; }
+		UINT GetResidentMip(UINT id)const { return m_entries[id].Resident; }
+		UINT GetWantedMip(UINT id)const { return m_entries[id].Wanted; }
+		UINT64 GetLastUse(UINT id)const { return m_entries[id].LastUse; }
+		UINT64 GetFrame()const { return m_frame; }
+		const ResidencyStats& GetStats()const { return m_stats; }
+
+		// Pixels covered by a sphere of radius at distance, projScale is _22 of the projection.
+		static float ProjectedSize(float radius, float distance, float projScale, float viewportHeight);
+
+	private:
+		struct Entry
+		{
+			std::vector<UINT64> Bytes;	// Bytes[i] holds mips i and smaller
+			std::vector<UINT> MipSizes;	// Larger of width and height per mip
+			UINT Tail;
+			UINT Resident;
+			UINT Pending;
+			UINT Wanted;
+			float ScreenSize;			// Largest use this frame
+			UINT64 LastUse;
+		};
+
+		UINT64 GetCommitted(const Entry& entry)const;
+		bool MakeRoom(UINT64 bytes, UINT except, std::vector<ResidencyRequest>& requests);
+
+	private:
+		ResidencySettings m_settings;
+		std::vector<Entry> m_entries;
+		std::vector<UINT> m_order;
+		UINT64 m_frame;
+		ResidencyStats m_stats;
+	};
+}
@@ -0,0 +1,189 @@
+#include "pch.h"
+#include "AnimationBaker.h"
+#include <algorithm>
+#include <istream>
+#include <ostream>
+
+using namespace DXFramework;
+using namespace DirectX;
+
+AnimationPaletteAtlas::AnimationPaletteAtlas()
+	: m_boneCount(0), m_frameCount(0), m_frameRate(0.0f)
+{
+}
+
+void AnimationPaletteAtlas::Clear()
+{
+	m_boneCount = 0;
+	m_frameCount = 0;
+	m_frameRate = 0.0f;
+	m_clips.clear();
+	m_texels.clear();
+}
+
+bool AnimationPaletteAtlas::Bake(PaletteSource& source, float frameRate /* = 30.0f */)
+{
+	Clear();
+	if (!(frameRate > 0.0f))
+		return false;
+
+	UINT boneCount = source.GetBoneCount();
+	if (boneCount == 0 || boneCount > MaxDimension / TexelsPerBone)
+		return false;
+	m_boneCount = boneCount;
+	m_frameRate = frameRate;
+	m_clips.resize(source.GetClipCount());
+
+	// Frames cover [start, end), so a looping instance wraps from the last row to the first.
+	for (UINT c = 0; c < m_clips.size(); ++c)
+	{
+		float duration = source.GetClipEndTime(c) - source.GetClipStartTime(c);
+		m_clips[c].FirstFrame = m_frameCount;
+		// Clamped before the conversion, the fit is checked right after
+		float frames = duration > 0.0f ? std::min(duration * frameRate + 0.5f, (float)MaxDimension + 1.0f) : 0.0f;
+		m_clips[c].FrameCount = std::max((UINT)frames, 1u);
+		if (m_clips[c].FrameCount > MaxDimension - m_frameCount)
+		{
+			Clear();
+			return false;
+		}
+		m_frameCount += m_clips[c].FrameCount;
+	}
+
+	UINT rowTexels = GetWidth();
+	m_texels.resize(rowTexels * m_frameCount);
+	std::vector<XMFLOAT4X4> palette(m_boneCount);
+	for (UINT c = 0; c < m_clips.size(); ++c)
+	{
+		float startTime = source.GetClipStartTime(c);
+		for (UINT f = 0; f < m_clips[c].FrameCount; ++f)
+		{
+			source.GetFinalTransforms(c, startTime + f / frameRate, &palette[0]);
+			XMFLOAT4* row = &m_texels[(m_clips[c].FirstFrame + f) * rowTexels];
+			for (UINT b = 0; b < m_boneCount; ++b)
+			{
+				for (UINT k = 0; k < TexelsPerBone; ++k)
+					row[b * TexelsPerBone + k] = XMFLOAT4(palette[b].m[k]);
+			}
+		}
+	}
+	return true;
+}
+
+BakedAnimationInstance AnimationPaletteAtlas::MakeInstance(UINT clipIndex, float startTime, float speed /* = 1.0f */)const
+{
+	BakedAnimationInstance instance;
+	instance.FirstFrame = m_clips[clipIndex].FirstFrame;
+	instance.FrameCount = m_clips[clipIndex].FrameCount;
+	instance.StartFrame = startTime * m_frameRate;
+	instance.FrameSpeed = speed * m_frameRate;
+	return instance;
+}
+
+UINT AnimationPaletteAtlas::GetFrame(const BakedAnimationInstance& instance, float timePos)const
+{
+	float frame = std::max(instance.StartFrame + timePos * instance.FrameSpeed, 0.0f);
+	return instance.FirstFrame + (UINT)frame % instance.FrameCount;
+}
+
+void AnimationPaletteAtlas::GetFinalTransforms(UINT frame, XMFLOAT4X4* finalTransforms)const
+{
+	const XMFLOAT4* row = &m_texels[frame * GetWidth()];
+	for (UINT b = 0; b < m_boneCount; ++b)
+	{
+		const XMFLOAT4* texels = row + b * TexelsPerBone;
+		finalTransforms[b] = XMFLOAT4X4(
+			texels[0].x, texels[0].y, texels[0].z, texels[0].w,
+			texels[1].x, texels[1].y, texels[1].z, texels[1].w,
+			texels[2].x, texels[2].y, texels[2].z, texels[2].w,
+			0.0f, 0.0f, 0.0f, 1.0f);
+	}
+}
+
+void AnimationPaletteAtlas::Write(std::ostream& out)const
+{
+	UINT clipCount = (UINT)m_clips.size();
+	out.write((const char*)&m_boneCount, sizeof(UINT));
+	out.write((const char*)&m_frameCount, sizeof(UINT));
+	out.write((const char*)&m_frameRate, sizeof(float));
+	out.write((const char*)&clipCount, sizeof(UINT));
+	if (clipCount > 0)
+		out.write((const char*)&m_clips[0], clipCount * sizeof(BakedClipInfo));
+	if (!m_texels.empty())
+		out.write((const char*)&m_texels[0], m_texels.size() * sizeof(XMFLOAT4));
+}
+
+bool AnimationPaletteAtlas::Read(std::istream& in)
+{
+	Clear();
+	UINT boneCount = 0;
+	UINT frameCount = 0;
+	float frameRate = 0.0f;
+	UINT clipCount = 0;
+	in.read((char*)&boneCount, sizeof(UINT));
+	in.read((char*)&frameCount, sizeof(UINT));
+	in.read((char*)&frameRate, sizeof(float));
+	in.read((char*)&clipCount, sizeof(UINT));
+	// The texel count follows from the header, so check the header before sizing anything.
+	// The bone count is checked by division, GetWidth multiplies it and could wrap.
+	if (!in || boneCount == 0 || boneCount > MaxDimension / TexelsPerBone || frameCount > MaxDimension
+		|| clipCount > frameCount || !(frameRate > 0.0f))
+		return false;
+
+	std::vector<BakedClipInfo> clips(clipCount);
+	if (clipCount > 0)
+		in.read((char*)&clips[0], clipCount * sizeof(BakedClipInfo));
+	std::vector<XMFLOAT4> texels(boneCount * TexelsPerBone * frameCount);
+	if (!texels.empty())
+		in.read((char*)&texels[0], texels.size() * sizeof(XMFLOAT4));
+	if (!in)
+		return false;
+
+	for (auto& clip : clips)
+	{
+		if (clip.FrameCount == 0 || clip.FirstFrame > frameCount || clip.FrameCount > frameCount - clip.FirstFrame)
+			return false;
+	}
+
+	m_boneCount = boneCount;
+	m_frameCount = frameCount;
+	m_frameRate = frameRate;
+	m_clips.swap(clips);
+	m_texels.swap(texels);
+	return true;
+}
+
+bool AnimationPaletteAtlas::CreateShaderResourceView(ID3D11Device* device, ID3D11ShaderResourceView** srv)const
+{
+	if (m_texels.empty())
+		return false;
+
+#ifdef _WIN32
+	D3D11_TEXTURE2D_DESC texDesc;
+	texDesc.Width = GetWidth();
+	texDesc.Height = m_frameCount;
+	texDesc.MipLevels = 1;
+	texDesc.ArraySize = 1;
+	texDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	texDesc.SampleDesc.Count = 1;
+	texDesc.SampleDesc.Quality = 0;
+	texDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	texDesc.CPUAccessFlags = 0;
+	texDesc.MiscFlags = 0;
+
+	D3D11_SUBRESOURCE_DATA initData;
+	initData.pSysMem = &m_texels[0];
+	initData.SysMemPitch = GetWidth() * sizeof(XMFLOAT4);
+	initData.SysMemSlicePitch = 0;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> atlasTex;
+	if (FAILED(device->CreateTexture2D(&texDesc, &initData, atlasTex.GetAddressOf())))
+		return false;
+	return SUCCEEDED(device->CreateShaderResourceView(atlasTex.Get(), nullptr, srv));
+#else
+	(void)device;
+	(void)srv;
+	return false;
+#endif
+}
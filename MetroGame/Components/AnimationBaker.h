@@ -0,0 +1,108 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <iosfwd>
+#include <vector>
+
+// Baked skinning palettes for crowds. Every clip is sampled at a fixed rate into one
+// palette atlas, so an instanced draw only needs the atlas and a small per instance
+// record; the CPU cost no longer grows with the number of animated instances.
+//
+// Atlas layout: RGBA32F texture, one row per baked frame and three texels per bone. The
+// texels of bone b are the first three rows of its pre-transposed final transform (the
+// fourth row is always 0,0,0,1), so a shader rebuilds the matrix with three loads at
+// (3 * b + k, frame). Clips are stacked by row in clip index order.
+//
+// Baking samples a PaletteSource, SkinnedPaletteSource of SkinnedData.h for a skeleton, so
+// the baker, the layout and the binary form build without the engine or a device. Like
+// StateTracker the d3d11 interfaces are only declared here.
+
+struct ID3D11Device;
+struct ID3D11ShaderResourceView;
+
+namespace DXFramework
+{
+	// What Bake samples: the clips of a skeleton and their pre-transposed final transforms,
+	// as SkinnedData::GetFinalTransforms returns them.
+	class PaletteSource
+	{
+	public:
+		virtual ~PaletteSource() {}
+
+		virtual UINT GetBoneCount()const = 0;
+		virtual UINT GetClipCount()const = 0;
+		virtual float GetClipStartTime(UINT clipIndex)const = 0;
+		virtual float GetClipEndTime(UINT clipIndex)const = 0;
+		// finalTransforms holds GetBoneCount() matrices.
+		virtual void GetFinalTransforms(UINT clipIndex, float timePos, DirectX::XMFLOAT4X4* finalTransforms) = 0;
+	};
+
+	struct BakedClipInfo
+	{
+		// First atlas row of the clip
+		UINT FirstFrame;
+		UINT FrameCount;
+	};
+
+	// Per instance data, laid out to be used directly as an instance vertex stream.
+	// The shader computes row = FirstFrame + (uint)(StartFrame + time * FrameSpeed) % FrameCount.
+	struct BakedAnimationInstance
+	{
+		UINT FirstFrame;
+		UINT FrameCount;
+		// Phase offset in frames
+		float StartFrame;
+		// Frames per second: bake rate times playback speed
+		float FrameSpeed;
+	};
+
+	class AnimationPaletteAtlas
+	{
+	public:
+		static const UINT TexelsPerBone = 3;
+		// D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION, both the width and the height are limited by it
+		static const UINT MaxDimension = 16384;
+
+		AnimationPaletteAtlas();
+
+		// Sample every clip of source at frameRate, the default one is the resampling rate of
+		// SampledAnimationClip. Pure CPU work, no device is needed. Returns false, leaving the
+		// atlas empty, if frameRate is not positive or the frames do not fit in one texture.
+		bool Bake(PaletteSource& source, float frameRate = 30.0f);
+
+		UINT GetBoneCount()const { return m_boneCount; }
+		UINT GetClipCount()const { return (UINT)m_clips.size(); }
+		float GetFrameRate()const { return m_frameRate; }
+		const BakedClipInfo& GetClip(UINT clipIndex)const { return m_clips[clipIndex]; }
+		// Texture size in texels
+		UINT GetWidth()const { return m_boneCount * TexelsPerBone; }
+		UINT GetHeight()const { return m_frameCount; }
+		const DirectX::XMFLOAT4* GetTexels()const { return m_texels.empty() ? nullptr : &m_texels[0]; }
+		UINT GetMemorySize()const { return (UINT)(m_texels.size() * sizeof(DirectX::XMFLOAT4)); }
+
+		BakedAnimationInstance MakeInstance(UINT clipIndex, float startTime, float speed = 1.0f)const;
+		// Atlas row an instance shows at the given time. Matches the shader side formula.
+		UINT GetFrame(const BakedAnimationInstance& instance, float timePos)const;
+		// Expand one atlas row back into pre-transposed 4x4 final transforms.
+		void GetFinalTransforms(UINT frame, DirectX::XMFLOAT4X4* finalTransforms)const;
+
+		// Binary form for offline baking. Read returns false, leaving the atlas empty, if the
+		// stream is truncated or malformed.
+		void Write(std::ostream& out)const;
+		bool Read(std::istream& in);
+
+		// Immutable RGBA32F texture of the atlas. Returns false if the atlas is empty or the
+		// device calls fail, and always off Windows.
+		bool CreateShaderResourceView(ID3D11Device* device, ID3D11ShaderResourceView** srv)const;
+
+	private:
+		void Clear();
+
+	private:
+		UINT m_boneCount;
+		UINT m_frameCount;
+		float m_frameRate;
+		std::vector<BakedClipInfo> m_clips;
+		std::vector<DirectX::XMFLOAT4> m_texels;
+	};
+}
@@ -0,0 +1,344 @@
+#include "pch.h"
+#include "AnimationBlend.h"
+#include "Common/MathHelper.h"
+
+using namespace DXFramework;
+using namespace DirectX;
+
+using namespace DX;
+
+// SoA quaternion helpers. Each XMVECTOR holds one component of four quaternions.
+struct QuaternionSoA
+{
+	XMVECTOR X, Y, Z, W;
+};
+
+static QuaternionSoA LoadRotation(const BonePosePacket& p)
+{
+	QuaternionSoA q = { XMLoadFloat4(&p.Qx), XMLoadFloat4(&p.Qy), XMLoadFloat4(&p.Qz), XMLoadFloat4(&p.Qw) };
+	return q;
+}
+
+static void StoreRotation(BonePosePacket& p, const QuaternionSoA& q)
+{
+	XMStoreFloat4(&p.Qx, q.X);
+	XMStoreFloat4(&p.Qy, q.Y);
+	XMStoreFloat4(&p.Qz, q.Z);
+	XMStoreFloat4(&p.Qw, q.W);
+}
+
+static XMVECTOR Dot(const QuaternionSoA& a, const QuaternionSoA& b)
+{
+	XMVECTOR d = XMVectorMultiply(a.X, b.X);
+	d = XMVectorMultiplyAdd(a.Y, b.Y, d);
+	d = XMVectorMultiplyAdd(a.Z, b.Z, d);
+	return XMVectorMultiplyAdd(a.W, b.W, d);
+}
+
+static QuaternionSoA Normalize(const QuaternionSoA& q)
+{
+	XMVECTOR invLength = XMVectorReciprocalSqrt(Dot(q, q));
+	QuaternionSoA r = { XMVectorMultiply(q.X, invLength), XMVectorMultiply(q.Y, invLength),
+		XMVectorMultiply(q.Z, invLength), XMVectorMultiply(q.W, invLength) };
+	return r;
+}
+
+// Normalized lerp along the shorter arc.
+static QuaternionSoA Nlerp(const QuaternionSoA& a, const QuaternionSoA& b, FXMVECTOR t)
+{
+	XMVECTOR sign = XMVectorSelect(XMVectorSplatOne(), XMVectorNegate(XMVectorSplatOne()), XMVectorLess(Dot(a, b), XMVectorZero()));
+	QuaternionSoA r = {
+		XMVectorLerpV(a.X, XMVectorMultiply(b.X, sign), t),
+		XMVectorLerpV(a.Y, XMVectorMultiply(b.Y, sign), t),
+		XMVectorLerpV(a.Z, XMVectorMultiply(b.Z, sign), t),
+		XMVectorLerpV(a.W, XMVectorMultiply(b.W, sign), t) };
+	return Normalize(r);
+}
+
+// Hamilton product a * b
+static QuaternionSoA Multiply(const QuaternionSoA& a, const QuaternionSoA& b)
+{
+	QuaternionSoA r;
+	r.W = XMVectorSubtract(XMVectorMultiply(a.W, b.W), XMVectorMultiplyAdd(a.X, b.X, XMVectorMultiplyAdd(a.Y, b.Y, XMVectorMultiply(a.Z, b.Z))));
+	r.X = XMVectorAdd(XMVectorMultiplyAdd(a.W, b.X, XMVectorMultiply(a.X, b.W)), XMVectorSubtract(XMVectorMultiply(a.Y, b.Z), XMVectorMultiply(a.Z, b.Y)));
+	r.Y = XMVectorAdd(XMVectorSubtract(XMVectorMultiply(a.W, b.Y), XMVectorMultiply(a.X, b.Z)), XMVectorMultiplyAdd(a.Y, b.W, XMVectorMultiply(a.Z, b.X)));
+	r.Z = XMVectorAdd(XMVectorMultiplyAdd(a.W, b.Z, XMVectorMultiply(a.X, b.Y)), XMVectorSubtract(XMVectorMultiply(a.Z, b.W), XMVectorMultiply(a.Y, b.X)));
+	return r;
+}
+
+static XMVECTOR LayerWeight(float weight, const BoneMask* mask, UINT packet)
+{
+	XMVECTOR w = XMVectorReplicate(weight);
+	return mask ? XMVectorMultiply(w, XMLoadFloat4(&mask->GetPacked()[packet])) : w;
+}
+
+BoneMask::BoneMask(UINT boneCount, float weight)
+	: m_weights(MathHelper::Max(SampledAnimationClip::GetPacketCount(boneCount), 1u), XMFLOAT4(weight, weight, weight, weight))
+{
+}
+
+void PoseBlend::Blend(const BonePosePacket* a, const BonePosePacket* b, float weight,
+	const BoneMask* mask, UINT packetCount, BonePosePacket* result)
+{
+	for (UINT i = 0; i < packetCount; ++i)
+	{
+		XMVECTOR w = LayerWeight(weight, mask, i);
+		QuaternionSoA q = Nlerp(LoadRotation(a[i]), LoadRotation(b[i]), w);
+
+		XMStoreFloat4(&result[i].Tx, XMVectorLerpV(XMLoadFloat4(&a[i].Tx), XMLoadFloat4(&b[i].Tx), w));
+		XMStoreFloat4(&result[i].Ty, XMVectorLerpV(XMLoadFloat4(&a[i].Ty), XMLoadFloat4(&b[i].Ty), w));
+		XMStoreFloat4(&result[i].Tz, XMVectorLerpV(XMLoadFloat4(&a[i].Tz), XMLoadFloat4(&b[i].Tz), w));
+		XMStoreFloat4(&result[i].Sx, XMVectorLerpV(XMLoadFloat4(&a[i].Sx), XMLoadFloat4(&b[i].Sx), w));
+		XMStoreFloat4(&result[i].Sy, XMVectorLerpV(XMLoadFloat4(&a[i].Sy), XMLoadFloat4(&b[i].Sy), w));
+		XMStoreFloat4(&result[i].Sz, XMVectorLerpV(XMLoadFloat4(&a[i].Sz), XMLoadFloat4(&b[i].Sz), w));
+		StoreRotation(result[i], q);
+	}
+}
+
+void PoseBlend::AddDelta(const BonePosePacket* base, const BonePosePacket* additive, const BonePosePacket* reference,
+	float weight, const BoneMask* mask, UINT packetCount, BonePosePacket* result)
+{
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR zero = XMVectorZero();
+	QuaternionSoA identity = { zero, zero, zero, one };
+
+	for (UINT i = 0; i < packetCount; ++i)
+	{
+		XMVECTOR w = LayerWeight(weight, mask, i);
+
+		// The rotation delta is taken in the bone's local frame: additive = reference * delta.
+		QuaternionSoA ref = LoadRotation(reference[i]);
+		QuaternionSoA refInverse = { XMVectorNegate(ref.X), XMVectorNegate(ref.Y), XMVectorNegate(ref.Z), ref.W };
+		QuaternionSoA delta = Nlerp(identity, Multiply(refInverse, LoadRotation(additive[i])), w);
+		QuaternionSoA q = Normalize(Multiply(LoadRotation(base[i]), delta));
+
+		XMStoreFloat4(&result[i].Tx, XMVectorMultiplyAdd(w, XMVectorSubtract(XMLoadFloat4(&additive[i].Tx), XMLoadFloat4(&reference[i].Tx)), XMLoadFloat4(&base[i].Tx)));
+		XMStoreFloat4(&result[i].Ty, XMVectorMultiplyAdd(w, XMVectorSubtract(XMLoadFloat4(&additive[i].Ty), XMLoadFloat4(&reference[i].Ty)), XMLoadFloat4(&base[i].Ty)));
+		XMStoreFloat4(&result[i].Tz, XMVectorMultiplyAdd(w, XMVectorSubtract(XMLoadFloat4(&additive[i].Tz), XMLoadFloat4(&reference[i].Tz)), XMLoadFloat4(&base[i].Tz)));
+		// Scale deltas are ratios: base * lerp(1, additive / reference, w)
+		XMStoreFloat4(&result[i].Sx, XMVectorMultiply(XMLoadFloat4(&base[i].Sx), XMVectorLerpV(one, XMVectorDivide(XMLoadFloat4(&additive[i].Sx), XMLoadFloat4(&reference[i].Sx)), w)));
+		XMStoreFloat4(&result[i].Sy, XMVectorMultiply(XMLoadFloat4(&base[i].Sy), XMVectorLerpV(one, XMVectorDivide(XMLoadFloat4(&additive[i].Sy), XMLoadFloat4(&reference[i].Sy)), w)));
+		XMStoreFloat4(&result[i].Sz, XMVectorMultiply(XMLoadFloat4(&base[i].Sz), XMVectorLerpV(one, XMVectorDivide(XMLoadFloat4(&additive[i].Sz), XMLoadFloat4(&reference[i].Sz)), w)));
+		StoreRotation(result[i], q);
+	}
+}
+
+PoseCache::PoseCache(float quantizeRate)
+	: m_skinInfo(nullptr), m_quantizeRate(quantizeRate), m_used(0), m_hits(0), m_misses(0)
+{
+}
+
+void PoseCache::Initialize(const SkinnedData* skinInfo)
+{
+	m_skinInfo = skinInfo;
+	m_entries.clear();
+	m_storage.clear();
+	m_used = 0;
+}
+
+void PoseCache::BeginFrame()
+{
+	m_entries.clear();
+	m_used = 0;
+	m_hits = 0;
+	m_misses = 0;
+}
+
+float PoseCache::Quantize(float timePos)const
+{
+	return floorf(timePos * m_quantizeRate + 0.5f) / m_quantizeRate;
+}
+
+PoseCache::Entry* PoseCache::Acquire(UINT64 key, bool& owner)
+{
+	concurrency::critical_section::scoped_lock lock(m_lock);
+
+	auto it = m_entries.find(key);
+	if (it != m_entries.end())
+	{
+		owner = false;
+		++m_hits;
+		return it->second;
+	}
+
+	if (m_used == m_storage.size())
+		m_storage.emplace_back();
+	Entry* entry = &m_storage[m_used++];
+	entry->Ready.store(false, std::memory_order_relaxed);
+	m_entries[key] = entry;
+	owner = true;
+	++m_misses;
+	return entry;
+}
+
+void PoseCache::WaitReady(Entry* entry)const
+{
+	while (!entry->Ready.load(std::memory_order_acquire))
+		concurrency::Context::Yield();
+}
+
+const BonePosePacket* PoseCache::GetPose(UINT clipIndex, float timePos)
+{
+	INT32 frame = (INT32)floorf(timePos * m_quantizeRate + 0.5f);
+	UINT64 key = ((UINT64)clipIndex << 32) | (UINT32)frame;
+
+	bool owner;
+	Entry* entry = Acquire(key, owner);
+	if (owner)
+	{
+		entry->Pose.resize(m_skinInfo->GetPoseScratchSize());
+		m_skinInfo->GetPose(clipIndex, frame / m_quantizeRate, &entry->Pose[0]);
+		entry->Ready.store(true, std::memory_order_release);
+	}
+	else
+	{
+		WaitReady(entry);
+	}
+	return &entry->Pose[0];
+}
+
+const XMFLOAT4X4* PoseCache::GetFinalTransforms(UINT clipIndex, float timePos)
+{
+	INT32 frame = (INT32)floorf(timePos * m_quantizeRate + 0.5f);
+	// Palettes use their own key space next to the poses.
+	UINT64 key = (1ull << 63) | ((UINT64)clipIndex << 32) | (UINT32)frame;
+
+	bool owner;
+	Entry* entry = Acquire(key, owner);
+	if (owner)
+	{
+		const BonePosePacket* pose = GetPose(clipIndex, timePos);
+		entry->Palette.resize(m_skinInfo->GetBoneCount());
+		m_skinInfo->GetFinalTransforms(pose, &entry->Palette[0]);
+		entry->Ready.store(true, std::memory_order_release);
+	}
+	else
+	{
+		WaitReady(entry);
+	}
+	return &entry->Palette[0];
+}
+
+AnimationController::AnimationController()
+	: m_clip(0), m_timePos(0.0f), m_loop(true), m_playing(false),
+	m_fadeClip(0), m_fadeTimePos(0.0f), m_fadeLoop(true), m_fadeElapsed(0.0f), m_fadeDuration(0.0f)
+{
+}
+
+void AnimationController::Play(UINT clipIndex, bool loop)
+{
+	m_clip = clipIndex;
+	m_timePos = 0.0f;
+	m_loop = loop;
+	m_playing = true;
+	m_fadeDuration = 0.0f;
+}
+
+void AnimationController::CrossFade(UINT clipIndex, float duration, bool loop)
+{
+	if (!m_playing || duration <= 0.0f)
+	{
+		Play(clipIndex, loop);
+		return;
+	}
+
+	// The current clip keeps running while it fades out.
+	m_fadeClip = m_clip;
+	m_fadeTimePos = m_timePos;
+	m_fadeLoop = m_loop;
+	m_fadeElapsed = 0.0f;
+	m_fadeDuration = duration;
+
+	m_clip = clipIndex;
+	m_timePos = 0.0f;
+	m_loop = loop;
+}
+
+UINT AnimationController::AddLayer(const AnimationLayer& layer)
+{
+	m_layers.push_back(layer);
+	return (UINT)m_layers.size() - 1;
+}
+
+bool AnimationController::IsSimple()const
+{
+	if (m_fadeDuration > 0.0f)
+		return false;
+	for (auto& layer : m_layers)
+		if (layer.Weight > 0.0f)
+			return false;
+	return true;
+}
+
+// Advance a clip clock. Returns false when a non looping clip ran past its end.
+static bool AdvanceClip(const SkinnedData& skinInfo, UINT clip, bool loop, float dt, float& timePos)
+{
+	timePos += dt;
+	float startTime = skinInfo.GetClipStartTime(clip);
+	float endTime = skinInfo.GetClipEndTime(clip);
+	if (timePos <= endTime)
+		return true;
+
+	float length = endTime - startTime;
+	if (loop && length > 0.0f)
+	{
+		timePos = startTime + fmodf(timePos - startTime, length);
+		return true;
+	}
+	timePos = startTime;
+	return loop;
+}
+
+bool AnimationController::Update(float dt, const SkinnedData& skinInfo)
+{
+	if (!m_playing)
+		return false;
+
+	// A finished clip is evaluated once more at its start pose, then stays stopped.
+	m_playing = AdvanceClip(skinInfo, m_clip, m_loop, dt, m_timePos);
+
+	if (m_fadeDuration > 0.0f)
+	{
+		AdvanceClip(skinInfo, m_fadeClip, m_fadeLoop, dt, m_fadeTimePos);
+		m_fadeElapsed += dt;
+		if (m_fadeElapsed >= m_fadeDuration)
+			m_fadeDuration = 0.0f;
+	}
+
+	for (auto& layer : m_layers)
+		AdvanceClip(skinInfo, layer.Clip, layer.Loop, dt, layer.TimePos);
+
+	return true;
+}
+
+void AnimationController::Evaluate(PoseCache& cache, UINT packetCount, BonePosePacket* pose)const
+{
+	const BonePosePacket* base = cache.GetPose(m_clip, m_timePos);
+	if (m_fadeDuration > 0.0f)
+	{
+		const BonePosePacket* from = cache.GetPose(m_fadeClip, m_fadeTimePos);
+		PoseBlend::Blend(from, base, m_fadeElapsed / m_fadeDuration, nullptr, packetCount, pose);
+	}
+	else
+	{
+		CopyMemory(pose, base, sizeof(BonePosePacket) * packetCount);
+	}
+
+	for (auto& layer : m_layers)
+	{
+		if (layer.Weight <= 0.0f)
+			continue;
+
+		const BonePosePacket* layerPose = cache.GetPose(layer.Clip, layer.TimePos);
+		if (layer.Mode == AnimationBlendMode::Override)
+		{
+			PoseBlend::Blend(pose, layerPose, layer.Weight, layer.Mask.get(), packetCount, pose);
+		}
+		else
+		{
+			// Additive clips are authored relative to their first frame.
+			const BonePosePacket* reference = cache.GetPose(layer.Clip, cache.GetSkinnedData()->GetClipStartTime(layer.Clip));
+			PoseBlend::AddDelta(pose, layerPose, reference, layer.Weight, layer.Mask.get(), packetCount, pose);
+		}
+	}
+}
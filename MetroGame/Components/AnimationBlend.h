@@ -0,0 +1,150 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <concrt.h>
+#include "SkinnedData.h"
+
+// Pose blending on top of SkinnedData. An AnimationController plays one base clip with
+// optional crossfade and a stack of override or additive layers, each of which may be
+// masked per bone. Poses come from a PoseCache, so instances that sample the same clip
+// at the same (quantized) time share one evaluation.
+
+namespace DXFramework
+{
+	enum class AnimationBlendMode
+	{
+		Override,
+		Additive
+	};
+
+	// Per bone layer weights, packed four bones per entry like BonePosePacket.
+	class BoneMask
+	{
+	public:
+		BoneMask(UINT boneCount = 0, float weight = 1.0f);
+
+		void SetWeight(UINT bone, float weight) { (&m_weights[bone / 4].x)[bone % 4] = weight; }
+		float GetWeight(UINT bone)const { return (&m_weights[bone / 4].x)[bone % 4]; }
+		const DirectX::XMFLOAT4* GetPacked()const { return &m_weights[0]; }
+
+	private:
+		std::vector<DirectX::XMFLOAT4> m_weights;
+	};
+
+	// Whole pose operations, four bones per step. The result may alias any input.
+	class PoseBlend
+	{
+	public:
+		// result = lerp(a, b, weight * mask), rotations take the shortest path.
+		static void Blend(const BonePosePacket* a, const BonePosePacket* b, float weight,
+			const BoneMask* mask, UINT packetCount, BonePosePacket* result);
+		// Apply the difference between additive and reference on top of base.
+		static void AddDelta(const BonePosePacket* base, const BonePosePacket* additive, const BonePosePacket* reference,
+			float weight, const BoneMask* mask, UINT packetCount, BonePosePacket* result);
+	};
+
+	// Pose and palette cache keyed by (clip, quantized time). Thread safe: the first caller
+	// for a key evaluates it while later callers for the same key wait for the result.
+	class PoseCache
+	{
+	public:
+		PoseCache(float quantizeRate = 60.0f);
+
+		void Initialize(const SkinnedData* skinInfo);
+		// Drop all entries. Storage is kept, so steady state frames do not allocate.
+		// Must not run concurrently with the getters.
+		void BeginFrame();
+
+		const BonePosePacket* GetPose(UINT clipIndex, float timePos);
+		// Pre-transposed final transforms, ready to copy into the skinned constant buffer.
+		const DirectX::XMFLOAT4X4* GetFinalTransforms(UINT clipIndex, float timePos);
+
+		float Quantize(float timePos)const;
+		const SkinnedData* GetSkinnedData()const { return m_skinInfo; }
+		UINT GetHitCount()const { return m_hits; }
+		UINT GetMissCount()const { return m_misses; }
+
+	private:
+		struct Entry
+		{
+			Entry() : Ready(false) {}
+
+			std::vector<BonePosePacket> Pose;
+			std::vector<DirectX::XMFLOAT4X4> Palette;
+			std::atomic<bool> Ready;
+		};
+
+		Entry* Acquire(UINT64 key, bool& owner);
+		void WaitReady(Entry* entry)const;
+
+	private:
+		const SkinnedData* m_skinInfo;
+		float m_quantizeRate;
+		concurrency::critical_section m_lock;
+		std::unordered_map<UINT64, Entry*> m_entries;
+		// Deque so that growing never moves entries other threads are reading.
+		std::deque<Entry> m_storage;
+		UINT m_used;
+		std::atomic<UINT> m_hits;
+		std::atomic<UINT> m_misses;
+	};
+
+	struct AnimationLayer
+	{
+		AnimationLayer() : Clip(0), TimePos(0.0f), Weight(1.0f), Mode(AnimationBlendMode::Override), Loop(true) {}
+
+		UINT Clip;
+		float TimePos;
+		float Weight;
+		AnimationBlendMode Mode;
+		bool Loop;
+		// Optional, nullptr affects every bone
+		std::shared_ptr<BoneMask> Mask;
+	};
+
+	// Playback state of one instance.
+	class AnimationController
+	{
+	public:
+		AnimationController();
+
+		void Play(UINT clipIndex, bool loop);
+		void CrossFade(UINT clipIndex, float duration, bool loop);
+		void Stop() { m_playing = false; }
+		// Select the clip without starting it
+		void SetClip(UINT clipIndex) { m_clip = clipIndex; m_playing = false; m_fadeDuration = 0.0f; }
+
+		UINT AddLayer(const AnimationLayer& layer);
+		void RemoveLayer(UINT layer) { m_layers.erase(m_layers.begin() + layer); }
+		AnimationLayer& GetLayer(UINT layer) { return m_layers[layer]; }
+		UINT GetLayerCount()const { return (UINT)m_layers.size(); }
+
+		bool IsPlaying()const { return m_playing; }
+		UINT GetClip()const { return m_clip; }
+		float GetTimePos()const { return m_timePos; }
+		// A single clip without fade or active layers can use the shared palette directly.
+		bool IsSimple()const;
+
+		// Advance clocks. Returns false once a non looping base clip has finished.
+		bool Update(float dt, const SkinnedData& skinInfo);
+		void Evaluate(PoseCache& cache, UINT packetCount, BonePosePacket* pose)const;
+
+	private:
+		UINT m_clip;
+		float m_timePos;
+		bool m_loop;
+		bool m_playing;
+
+		// Clip being faded out
+		UINT m_fadeClip;
+		float m_fadeTimePos;
+		bool m_fadeLoop;
+		float m_fadeElapsed;
+		float m_fadeDuration;
+
+		std::vector<AnimationLayer> m_layers;
+	};
+}
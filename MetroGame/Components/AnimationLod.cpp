@@ -0,0 +1,103 @@
+#include "pch.h"
+#include "AnimationLod.h"
+#include "Common/MathHelper.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace DXFramework;
+using namespace DirectX;
+
+using namespace DX;
+
+AnimationLod::AnimationLod()
+	: m_stats(), m_eyePosW(0.0f, 0.0f, 0.0f), m_viewSet(false), m_frame(0)
+{
+}
+
+void AnimationLod::Initialize(UINT instanceCount)
+{
+	m_instances.assign(instanceCount, AnimationInstanceLod());
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void AnimationLod::SetSettings(const AnimationLodSettings& settings)
+{
+	m_settings = settings;
+	m_settings.MaxInterval = MathHelper::Max(settings.MaxInterval, 1u);
+	Initialize((UINT)m_instances.size());
+}
+
+void AnimationLod::SetView(const XMFLOAT3& eyePosW, const XMFLOAT4 planes[6])
+{
+	m_eyePosW = eyePosW;
+	for (UINT p = 0; p < 6; ++p)
+		m_frustumPlanes[p] = planes[p];
+	m_viewSet = true;
+}
+
+void AnimationLod::Select(std::vector<UINT>& activeInstances, UINT boneCount,
+	const std::function<BoundingSphere(UINT)>& getSphere, std::vector<UINT>& extrapolated)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+	extrapolated.clear();
+	UINT kept = 0;
+
+	// Filter the playing instances in place. Clocks keep running for the skipped ones, so
+	// they pick up at the right time on their next update.
+	for (UINT k = 0; k < activeInstances.size(); ++k)
+	{
+		UINT i = activeInstances[k];
+		AnimationInstanceLod& lod = m_instances[i];
+		++lod.FramesSinceUpdate;
+
+		float size = FLT_MAX;
+		if (m_viewSet)
+		{
+			BoundingSphere sphere = getSphere(i);
+			XMVECTOR center = XMLoadFloat3(&sphere.Center);
+			if (m_settings.FreezeOutsideFrustum)
+			{
+				bool inside = true;
+				for (UINT p = 0; p < 6 && inside; ++p)
+					inside = XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&m_frustumPlanes[p]), center)) >= -sphere.Radius;
+				if (!inside)
+				{
+					++m_stats.FrozenInstances;
+					m_stats.SkippedBones += boneCount;
+					continue;
+				}
+			}
+			float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, XMLoadFloat3(&m_eyePosW))));
+			size = sphere.Radius / MathHelper::Max(distance, 1e-4f);
+		}
+
+		lod.Interval = 1;
+		if (size < m_settings.FullRateSize)
+			lod.Interval = MathHelper::Min(m_settings.MaxInterval, (UINT)ceilf(m_settings.FullRateSize / MathHelper::Max(size, 1e-6f)));
+		// Stagger the phases so the far instances do not all update on the same frame.
+		if (lod.Interval > 1 && (m_frame + i) % lod.Interval != 0)
+		{
+			++m_stats.DeferredInstances;
+			m_stats.SkippedBones += boneCount;
+			if (m_settings.Extrapolate && lod.HasVelocity && lod.Extrapolated + 1 < lod.Interval)
+				extrapolated.push_back(i);
+			continue;
+		}
+
+		lod.Reduced = size < m_settings.DetailBoneSize && !m_boneLod.IsEmpty();
+		if (lod.Reduced)
+		{
+			++m_stats.ReducedInstances;
+			m_stats.SkippedBones += m_boneLod.GetFoldedBoneCount();
+			m_stats.EvaluatedBones += boneCount - m_boneLod.GetFoldedBoneCount();
+		}
+		else
+		{
+			m_stats.EvaluatedBones += boneCount;
+		}
+		activeInstances[kept++] = i;
+	}
+	activeInstances.resize(kept);
+	++m_frame;
+}
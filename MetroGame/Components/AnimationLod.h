@@ -0,0 +1,97 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <functional>
+#include <vector>
+#include "SkinnedData.h"
+
+// Animation level of detail of a crowd. Each frame Select picks which playing instances
+// evaluate their pose: small ones on screen update every Nth frame with staggered phases,
+// the smallest ones with their detail bones folded, and those outside the view are frozen.
+// Only the choice is made here, the owner (MeshObject) evaluates and extrapolates. Standard
+// library and DirectXMath only, so crowds can be measured without a device.
+
+namespace DXFramework
+{
+	// Screen size is the bounding radius over the distance to the eye.
+	struct AnimationLodSettings
+	{
+		AnimationLodSettings() : Enabled(false), FullRateSize(0.1f), MaxInterval(4), DetailBoneSize(0.04f),
+			Extrapolate(true), FreezeOutsideFrustum(true) {}
+
+		bool Enabled;
+		// At or above this size instances update every frame, below it every Nth frame.
+		float FullRateSize;
+		UINT MaxInterval;
+		// Below this size detail bones follow their proxy bones (see SetDetailBones).
+		float DetailBoneSize;
+		// Move palettes along their last velocity on frames without an update.
+		bool Extrapolate;
+		bool FreezeOutsideFrustum;
+	};
+
+	// Per frame counters of the animation LOD. Bone counts are bone transforms built or saved.
+	struct AnimationLodStats
+	{
+		UINT EvaluatedBones;
+		UINT SkippedBones;
+		UINT FrozenInstances;
+		UINT DeferredInstances;
+		UINT ReducedInstances;
+	};
+
+	// LOD state of one instance. The owner resets FramesSinceUpdate and Extrapolated when it
+	// evaluates the instance and counts Extrapolated up when it extrapolates it.
+	struct AnimationInstanceLod
+	{
+		AnimationInstanceLod() : FramesSinceUpdate(0), Extrapolated(0), Interval(1), LastTimePos(0.0f), Reduced(false), HasVelocity(false) {}
+
+		UINT FramesSinceUpdate;
+		UINT Extrapolated;
+		UINT Interval;
+		float LastTimePos;
+		bool Reduced;
+		bool HasVelocity;
+	};
+
+	class AnimationLod
+	{
+	public:
+		AnimationLod();
+
+		// Reset the state of instanceCount instances and the stats.
+		void Initialize(UINT instanceCount);
+		void SetSettings(const AnimationLodSettings& settings);
+		const AnimationLodSettings& GetSettings()const { return m_settings; }
+		bool IsEnabled()const { return m_settings.Enabled; }
+		// Palette velocities are needed, the owner keeps them
+		bool TracksVelocity()const { return m_settings.Enabled && m_settings.Extrapolate; }
+
+		// proxyBones[i] is the bone that bone i follows at low detail, -1 keeps it.
+		void SetDetailBones(const std::vector<int>& proxyBones) { m_boneLod.Build(proxyBones); }
+		const BoneLodMap& GetBoneLod()const { return m_boneLod; }
+		// Viewer, planes are the normalized inward planes of DX::ExtractFrustumPlanes. Without
+		// a viewer every instance updates at full rate and detail.
+		void SetView(const DirectX::XMFLOAT3& eyePosW, const DirectX::XMFLOAT4 planes[6]);
+
+		// Filter the playing instances in place, keeping the ones to evaluate this frame.
+		// getSphere returns the world bounds of an instance and is only called with a viewer.
+		// Deferred instances due for extrapolation are listed in extrapolated.
+		void Select(std::vector<UINT>& activeInstances, UINT boneCount,
+			const std::function<DirectX::BoundingSphere(UINT)>& getSphere, std::vector<UINT>& extrapolated);
+
+		AnimationInstanceLod& GetInstance(UINT i) { return m_instances[i]; }
+		const AnimationLodStats& GetStats()const { return m_stats; }
+
+	private:
+		AnimationLodSettings m_settings;
+		AnimationLodStats m_stats;
+		BoneLodMap m_boneLod;
+		std::vector<AnimationInstanceLod> m_instances;
+		DirectX::XMFLOAT3 m_eyePosW;
+		DirectX::XMFLOAT4 m_frustumPlanes[6];
+		bool m_viewSet;
+		UINT m_frame;
+	};
+}
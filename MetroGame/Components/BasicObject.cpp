@@ -17,11 +17,17 @@ BasicObject::BasicObject(
 	const std::shared_ptr<DX::DeviceResources>& deviceResources,
 	const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerFrameCB>>& perFrameCB,
 	const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerObjectCB>>& perObjectCB)
-	: m_loadingComplete(false), m_initialized(false),
+	: m_loadingComplete(false), m_initialized(false), m_cullEnabled(true), m_bvh(nullptr), m_streamTextures(false),
+	m_instanceCount(0), m_instanceMaterialCount(0), m_materialsDirty(false),
 	m_deviceResources(deviceResources), m_perFrameCB(perFrameCB), m_perObjectCB(perObjectCB)
 {
 }
 
+BasicObject::~BasicObject()
+{
+	DetachFromBvh();
+}
+
 void BasicObject::Initialize(BasicObjectData* data, BasicFeatureConfigure feature)
 {
 	m_object = std::unique_ptr<BasicObjectData>(data);
@@ -56,6 +62,41 @@ void BasicObject::Initialize(BasicObjectData* data, BasicFeatureConfigure featur
 		}
 	}
 
+	m_visibleOffsets.resize(m_object->Units.size());
+	UINT instanceCount = 0;
+	for (UINT i = 0; i < m_object->Units.size(); ++i)
+	{
+		m_visibleOffsets[i] = instanceCount;
+		instanceCount += m_object->Units[i].Worlds.size();
+	}
+	m_visible.assign(instanceCount, 1);
+	std::vector<XMFLOAT4X4> worlds;
+	worlds.reserve(instanceCount);
+	for (auto& item : m_object->Units)
+		worlds.insert(worlds.end(), item.Worlds.begin(), item.Worlds.end());
+	m_transforms.Initialize(worlds.data(), instanceCount);
+
+	// Units drawn with one instanced call when InstanceEnable is set: several instances that
+	// share their textures and texture transform. Materials are looked up per instance.
+	m_unitInstanced.assign(m_object->Units.size(), 0);
+	m_unitMaterialBase.assign(m_object->Units.size(), 0);
+	m_unitInstanceStart.assign(m_object->Units.size(), 0);
+	m_unitTexBase.assign(m_object->Units.size(), 0);
+	m_unitNorBase.assign(m_object->Units.size(), 0);
+	m_instanceCount = m_instanceMaterialCount = 0;
+	for (UINT i = 0; i < m_object->Units.size(); ++i)
+	{
+		auto& item = m_object->Units[i];
+		UINT count = item.Worlds.size();
+		if (count < 2 || item.Material.empty() || item.TextureStepRate < count
+			|| item.NorTextureStepRate < count || item.TextureTransformStepRate < count)
+			continue;
+		m_unitInstanced[i] = 1;
+		m_unitMaterialBase[i] = m_instanceMaterialCount;
+		m_instanceMaterialCount += item.Material.size();
+		m_instanceCount += count;
+	}
+
 	m_texture = true;
 	m_normal = true;
 	auto& units = m_object->Units;
@@ -139,109 +180,90 @@ void BasicObject::Render(bool recover /* = false */)
 
 	auto renderStateMgr = RenderStateMgr::Instance();
 	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	StateTracker* tracker = m_deviceResources->GetStateTracker();
+	tracker->SetComponent("BasicObject");
 	// Set IA stage.
 	UINT stride = m_object->UseEx ? sizeof(PosNormalTexTan) : sizeof(Basic32);
 	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
+	tracker->IASetInputLayout(m_inputLayout.Get());
+	ShaderChangement::InputLayout = m_inputLayout.Get();
 	if (m_feature.TessEnable)
 	{
-		if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST)
-		{
-			context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-			ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST;
-		}
+		tracker->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
+		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST;
 	}
 	else
 	{
-		if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-		{
-			context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-			ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		}
+		tracker->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	}
 	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
+	tracker->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
 	if (m_object->UseIndex)
 	{
-		context->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
+		tracker->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
 	}
 
 	// Bind shaders, constant buffers, srvs and samplers
-	ID3D11Buffer* cbuffers[3] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer(), m_tessSettingsCB.GetBuffer() };
-	ID3D11Buffer* cbuffersT[2] = { cbuffers[0], cbuffers[2] };
+	// b0 is the per-frame buffer, bound by itself as it may be a range of the constant ring
+	ID3D11Buffer* cbuffers[2] = { m_perObjectCB->GetBuffer(), m_tessSettingsCB.GetBuffer() };
 	ID3D11SamplerState* samplers[2] = { renderStateMgr->LinearSam(), renderStateMgr->ShadowSam() };
 	ID3D11ShaderResourceView* srvs[3] = { m_depthMapSRV.Get(), m_ssaoMapSRV.Get(),  m_reflectMapSRV.Get() };
 	
 	// vs
-	if (ShaderChangement::VS != m_basicVS.Get())
-	{
-		context->VSSetShader(m_basicVS.Get(), nullptr, 0);
-		ShaderChangement::VS = m_basicVS.Get();
-	}
+	tracker->VSSetShader(m_basicVS.Get());
+	ShaderChangement::VS = m_basicVS.Get();
+	m_perFrameCB->Bind(tracker, ShaderStage::VS, 0);
 	if (m_feature.TessEnable)
-		context->VSSetConstantBuffers(0, 3, cbuffers);
+		tracker->SetConstantBuffers(ShaderStage::VS, 1, 2, cbuffers);
 	else
-		context->VSSetConstantBuffers(0, 2, cbuffers);
+		tracker->SetConstantBuffers(ShaderStage::VS, 1, 1, cbuffers);
 	// ps
-	if (ShaderChangement::PS != m_basicPS.Get())
-	{
-		context->PSSetShader(m_basicPS.Get(), nullptr, 0);
-		ShaderChangement::PS = m_basicPS.Get();
-	}
-	context->PSSetConstantBuffers(0, 2, cbuffers);
-	context->PSSetShaderResources(2, 3, srvs);
-	context->PSSetSamplers(0, 2, samplers);
+	tracker->PSSetShader(m_basicPS.Get());
+	ShaderChangement::PS = m_basicPS.Get();
+	m_perFrameCB->Bind(tracker, ShaderStage::PS, 0);
+	tracker->SetConstantBuffers(ShaderStage::PS, 1, 1, cbuffers);
+	tracker->SetShaderResources(ShaderStage::PS, 2, 3, srvs);
+	tracker->SetSamplers(ShaderStage::PS, 0, 2, samplers);
 
 	// hs and ds
 	if (m_feature.TessEnable)
 	{
-		if (ShaderChangement::HS != m_basicHS.Get())
-		{
-			context->HSSetShader(m_basicHS.Get(), nullptr, 0);
-			ShaderChangement::HS = m_basicHS.Get();
-		}
-		if (ShaderChangement::DS != m_basicDS.Get())
-		{
-			context->DSSetShader(m_basicDS.Get(), nullptr, 0);
-			ShaderChangement::DS = m_basicDS.Get();
-		}
-		context->DSSetConstantBuffers(0, 2, cbuffersT);
-		context->DSSetSamplers(0, 1, samplers);
+		tracker->HSSetShader(m_basicHS.Get());
+		ShaderChangement::HS = m_basicHS.Get();
+		tracker->DSSetShader(m_basicDS.Get());
+		ShaderChangement::DS = m_basicDS.Get();
+		m_perFrameCB->Bind(tracker, ShaderStage::DS, 0);
+		tracker->SetConstantBuffers(ShaderStage::DS, 1, 1, &cbuffers[1]);
+		tracker->SetSamplers(ShaderStage::DS, 0, 1, samplers);
 	}
 	else
 	{
-		if (ShaderChangement::HS != nullptr)
-		{
-			context->HSSetShader(nullptr, nullptr, 0);
-			ShaderChangement::HS = nullptr;
-		}
-		if (ShaderChangement::DS != nullptr)
-		{
-			context->DSSetShader(nullptr, nullptr, 0);
-			ShaderChangement::DS =nullptr;
-		}
+		tracker->HSSetShader(nullptr);
+		ShaderChangement::HS = nullptr;
+		tracker->DSSetShader(nullptr);
+		ShaderChangement::DS = nullptr;
 	}
 
 	if (m_feature.ClipEnable)
 	{
-		if (ShaderChangement::RSS != renderStateMgr->NoCullRS())
-		{
-			context->RSSetState(renderStateMgr->NoCullRS());
-			ShaderChangement::RSS = renderStateMgr->NoCullRS();
-		}
+		tracker->RSSetState(renderStateMgr->NoCullRS());
+		ShaderChangement::RSS = renderStateMgr->NoCullRS();
 	}
-	else if (ShaderChangement::RSS != nullptr)
+	else
 	{
-		context->RSSetState(nullptr);
+		tracker->RSSetState(nullptr);
 		ShaderChangement::RSS = nullptr;
 	}
 
+	m_transforms.Update();
+	CullInstances(CullPass::Render);
+	UpdateStreamedTextures();
+	bool instancing = m_feature.InstanceEnable && !m_feature.TessEnable && m_instanceVB && m_instanceVS;
+
 	// Iterate over each unit
 	int totalNum, matBase, matInc, transBase, transInc, texBase, texInc, norBase, norInc;
+	int boundTex = -1, boundNor = -1;
 	texBase = norBase = 0;
 	if (m_feature.TextureEnable)
 	{
@@ -263,82 +285,352 @@ void BasicObject::Render(bool recover /* = false */)
 		if (norInc > 0) norInc = 0;
 		if (transInc > 0) transInc = 0;
 
+		if (instancing && m_unitInstanced[i])
+		{
+			// Drawn by RenderInstanced. All its instances share the textures bound here, so
+			// the counters advance by the whole unit at once.
+			m_unitTexBase[i] = texBase;
+			m_unitNorBase[i] = norBase;
+			if (texInc >= 0 && (texInc += totalNum) >= (int)item.TextureStepRate)
+			{
+				texInc = 0;
+				++texBase;
+			}
+			if (norInc >= 0 && (norInc += totalNum) >= (int)item.NorTextureStepRate)
+			{
+				norInc = 0;
+				++norBase;
+			}
+			continue;
+		}
+
+		UINT unitBase = m_visibleOffsets[i];
+		const UINT8* visible = &m_visible[unitBase];
 		for (int k = 0; k < totalNum; ++k)
 		{
-			// Set world
-			XMMATRIX world = XMLoadFloat4x4(&item.Worlds[k]);
-			XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-			XMStoreFloat4x4(&m_perObjectCB->Data.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&m_perObjectCB->Data.WorldInvTranspose, XMMatrixTranspose(worldInvTranspose));
-			// Set material
-			if (matInc == 0)
+			// Culled instances still advance the step rate counters. Per instance state is
+			// set for every drawn instance since the first one of a run may have been culled.
+			if (visible[k])
+			{
+				// Set world
+				m_perObjectCB->Data.World = m_transforms.GetWorldT(unitBase + k);
+				m_perObjectCB->Data.WorldInvTranspose = m_transforms.GetWorldInvTransposeT(unitBase + k);
+				// Set material
 				m_perObjectCB->Data.Mat = item.Material[matBase];
+				// Set texture transform
+				if (transInc >= 0)
+				{
+					XMMATRIX texTransform = XMLoadFloat4x4(&item.TextureTransform[transBase]);
+					XMStoreFloat4x4(&m_perObjectCB->Data.TexTransform, XMMatrixTranspose(texTransform));
+				}
+				// Set diffuse texture
+				if (texInc >= 0 && texBase != boundTex)
+				{
+					tracker->SetShaderResources(ShaderStage::PS, 0, 1, m_diffuseMapSRV[texBase].GetAddressOf());
+					boundTex = texBase;
+				}
+				// Set normal texture
+				if (norInc >= 0 && norBase != boundNor)
+				{
+					tracker->SetShaderResources(ShaderStage::PS, 1, 1, m_norMapSRV[norBase].GetAddressOf());
+					if (m_feature.TessEnable)
+						tracker->SetShaderResources(ShaderStage::DS, 0, 1, m_norMapSRV[norBase].GetAddressOf());
+					boundNor = norBase;
+				}
+
+				// Update constant buffer
+				m_perObjectCB->ApplyChanges(context);
+
+				// Draw
+				if (m_object->UseIndex)
+					tracker->DrawIndexed(item.Count, item.Start, item.Base);
+				else
+					tracker->Draw(item.VCount, item.Base);
+			}
+
 			if (++matInc >= (int)item.MaterialStepRate)
 			{
 				matInc = 0;
 				++matBase;
 			}
-			// Set texture transform
-			if (transInc == 0)
-			{
-				XMMATRIX texTransform = XMLoadFloat4x4(&item.TextureTransform[transBase]);
-				XMStoreFloat4x4(&m_perObjectCB->Data.TexTransform, XMMatrixTranspose(texTransform));
-			}
 			if (transInc >= 0 && ++transInc >= (int)item.TextureTransformStepRate)
 			{
 				transInc = 0;
 				++transBase;
 			}
-			// Set diffuse texture
-			if (texInc == 0)
-				context->PSSetShaderResources(0, 1, m_diffuseMapSRV[texBase].GetAddressOf());
 			if (texInc >= 0 && ++texInc >= (int)item.TextureStepRate)
 			{
 				texInc = 0;
 				++texBase;
 			}
-			// Set normal texture
-			if (norInc == 0)
-			{
-				context->PSSetShaderResources(1, 1, m_norMapSRV[norBase].GetAddressOf());
-				if (m_feature.TessEnable)
-					context->DSSetShaderResources(0, 1, m_norMapSRV[norBase].GetAddressOf());
-			}
 			if (norInc >= 0 && ++norInc >= (int)item.NorTextureStepRate)
 			{
 				norInc = 0;
 				++norBase;
 			}
-
-			// Update constant buffer
-			m_perObjectCB->ApplyChanges(context);
-
-			// Draw
-			if (m_object->UseIndex)
-				context->DrawIndexed(item.Count, item.Start, item.Base);
-			else
-				context->Draw(item.VCount, item.Base);
 		}
 	}
 
+	if (instancing)
+		RenderInstanced(context);
+
 	// Recovery
 	if (recover)
 	{
 		ID3D11ShaderResourceView* nullSRV[3] = { nullptr, nullptr, nullptr };
-		context->PSSetShaderResources(2, 3, nullSRV);
+		tracker->SetShaderResources(ShaderStage::PS, 2, 3, nullSRV);
+		if (instancing)
+			tracker->SetShaderResources(ShaderStage::PS, 5, 1, nullSRV);
 		if (m_feature.ClipEnable)
 		{
-			context->RSSetState(nullptr);
+			tracker->RSSetState(nullptr);
 			ShaderChangement::RSS = nullptr;
 		}
 		if (m_feature.TessEnable)
 		{
 			ShaderChangement::HS = nullptr;
 			ShaderChangement::DS = nullptr;
-			context->HSSetShader(nullptr, nullptr, 0);
-			context->DSSetShader(nullptr, nullptr, 0);
+			tracker->HSSetShader(nullptr);
+			tracker->DSSetShader(nullptr);
+		}
+	}
+}
+
+// Writes the visible instances of every instanced unit in one pass, returns the count.
+UINT BasicObject::WriteInstances(ID3D11DeviceContext* context)
+{
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	ThrowIfFailed(context->Map(m_instanceVB.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource));
+	BasicInstance* dest = (BasicInstance*)mappedResource.pData;
+	UINT written = 0;
+	for (size_t i = 0; i < m_object->Units.size(); ++i)
+	{
+		m_unitInstanceStart[i] = written;
+		if (!m_unitInstanced[i])
+			continue;
+		BasicElementUnit& item = m_object->Units[i];
+		UINT unitBase = m_visibleOffsets[i];
+		written += m_transforms.WriteInstances(unitBase, item.Worlds.size(), &m_visible[unitBase],
+			m_unitMaterialBase[i], item.MaterialStepRate, dest + written);
+	}
+	context->Unmap(m_instanceVB.Get(), 0);
+
+	if (m_materialsDirty)
+	{
+		ThrowIfFailed(context->Map(m_instanceMaterials.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource));
+		Material* materials = (Material*)mappedResource.pData;
+		for (size_t i = 0; i < m_object->Units.size(); ++i)
+		{
+			if (m_unitInstanced[i])
+				CopyMemory(materials + m_unitMaterialBase[i], &m_object->Units[i].Material[0], sizeof(Material) * m_object->Units[i].Material.size());
+		}
+		context->Unmap(m_instanceMaterials.Get(), 0);
+		m_materialsDirty = false;
+	}
+	return written;
+}
+
+void BasicObject::RenderInstanced(ID3D11DeviceContext* context)
+{
+	UINT written = WriteInstances(context);
+	if (written == 0)
+		return;
+	StateTracker* tracker = m_deviceResources->GetStateTracker();
+
+	// The per vertex stream stays in slot 0
+	UINT stride = sizeof(BasicInstance);
+	UINT offset = 0;
+	tracker->IASetVertexBuffers(1, 1, m_instanceVB.GetAddressOf(), &stride, &offset);
+	tracker->IASetInputLayout(m_instanceInputLayout.Get());
+	ShaderChangement::InputLayout = m_instanceInputLayout.Get();
+	tracker->VSSetShader(m_instanceVS.Get());
+	ShaderChangement::VS = m_instanceVS.Get();
+	tracker->PSSetShader(m_instancePS.Get());
+	ShaderChangement::PS = m_instancePS.Get();
+	tracker->SetShaderResources(ShaderStage::PS, 5, 1, m_instanceMaterialsSRV.GetAddressOf());
+
+	for (size_t i = 0; i < m_object->Units.size(); ++i)
+	{
+		UINT count = (i + 1 < m_object->Units.size() ? m_unitInstanceStart[i + 1] : written) - m_unitInstanceStart[i];
+		if (!m_unitInstanced[i] || count == 0)
+			continue;
+		BasicElementUnit& item = m_object->Units[i];
+
+		// One texture transform and one set of textures per unit
+		if (m_feature.TextureEnable)
+		{
+			XMMATRIX texTransform = XMLoadFloat4x4(&item.TextureTransform[0]);
+			XMStoreFloat4x4(&m_perObjectCB->Data.TexTransform, XMMatrixTranspose(texTransform));
+			tracker->SetShaderResources(ShaderStage::PS, 0, 1, m_diffuseMapSRV[m_unitTexBase[i]].GetAddressOf());
+			if (m_feature.NormalEnable)
+				tracker->SetShaderResources(ShaderStage::PS, 1, 1, m_norMapSRV[m_unitNorBase[i]].GetAddressOf());
+		}
+		m_perObjectCB->ApplyChanges(context);
+
+		if (m_object->UseIndex)
+			tracker->DrawIndexedInstanced(item.Count, count, item.Start, item.Base, m_unitInstanceStart[i]);
+		else
+			tracker->DrawInstanced(item.VCount, count, item.Base, m_unitInstanceStart[i]);
+	}
+}
+
+void BasicObject::Submit(RenderQueue& queue)
+{
+	if (!m_loadingComplete)
+		return;
+
+	auto renderStateMgr = RenderStateMgr::Instance();
+	m_transforms.Update();
+	CullInstances(CullPass::Render);
+	UpdateStreamedTextures();
+	bool instancing = m_feature.InstanceEnable && !m_feature.TessEnable && m_instanceVB && m_instanceVS;
+
+	// State shared by every packet of this object
+	DrawPacket packet;
+	packet.InputLayout = m_inputLayout.Get();
+	packet.Topology = m_feature.TessEnable ? D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST : D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	packet.VertexBuffer = m_objectVB.Get();
+	packet.Stride = m_object->UseEx ? sizeof(PosNormalTexTan) : sizeof(Basic32);
+	packet.IndexBuffer = m_object->UseIndex ? m_objectIB.Get() : nullptr;
+	packet.VS = m_basicVS.Get();
+	packet.PS = m_basicPS.Get();
+	if (m_feature.TessEnable)
+	{
+		packet.HS = m_basicHS.Get();
+		packet.DS = m_basicDS.Get();
+		packet.TessSettings = m_tessSettingsCB.GetBuffer();
+	}
+	packet.RasterizerState = m_feature.ClipEnable ? renderStateMgr->NoCullRS() : nullptr;
+	packet.PSResources[2] = m_depthMapSRV.Get();
+	packet.PSResources[3] = m_ssaoMapSRV.Get();
+	packet.PSResources[4] = m_reflectMapSRV.Get();
+	RenderPass pass = m_feature.ClipEnable ? RenderPass::AlphaTested : RenderPass::Opaque;
+
+	BasicPerObjectCB objectData;
+	XMStoreFloat4x4(&objectData.TexTransform, XMMatrixIdentity());
+
+	// Same step rate walk as Render
+	int totalNum, matBase, matInc, transBase, transInc, texBase, texInc, norBase, norInc;
+	texBase = norBase = 0;
+	if (m_feature.TextureEnable)
+	{
+		texInc = transInc = 0;
+		if (m_feature.NormalEnable)
+			norInc = 0;
+		else
+			norInc = -1;
+	}
+	else
+		texInc = norInc = transInc = -1;
+	for (size_t i = 0; i < m_object->Units.size(); ++i)
+	{
+		BasicElementUnit& item = m_object->Units[i];
+
+		totalNum = (int)item.Worlds.size();
+		matBase = matInc = transBase = 0;
+		if (texInc > 0) texInc = 0;
+		if (norInc > 0) norInc = 0;
+		if (transInc > 0) transInc = 0;
+
+		if (instancing && m_unitInstanced[i])
+		{
+			// Submitted below once the instance stream is written
+			m_unitTexBase[i] = texBase;
+			m_unitNorBase[i] = norBase;
+			if (texInc >= 0 && (texInc += totalNum) >= (int)item.TextureStepRate)
+			{
+				texInc = 0;
+				++texBase;
+			}
+			if (norInc >= 0 && (norInc += totalNum) >= (int)item.NorTextureStepRate)
+			{
+				norInc = 0;
+				++norBase;
+			}
+			continue;
+		}
+
+		packet.Count = m_object->UseIndex ? item.Count : item.VCount;
+		packet.Start = item.Start;
+		packet.Base = item.Base;
+
+		UINT unitBase = m_visibleOffsets[i];
+		const UINT8* visible = &m_visible[unitBase];
+		for (int k = 0; k < totalNum; ++k)
+		{
+			if (visible[k])
+			{
+				objectData.World = m_transforms.GetWorldT(unitBase + k);
+				objectData.WorldInvTranspose = m_transforms.GetWorldInvTransposeT(unitBase + k);
+				objectData.Mat = item.Material[matBase];
+				if (transInc >= 0)
+					XMStoreFloat4x4(&objectData.TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&item.TextureTransform[transBase])));
+				packet.PSResources[0] = texInc >= 0 ? m_diffuseMapSRV[texBase].Get() : nullptr;
+				packet.PSResources[1] = norInc >= 0 ? m_norMapSRV[norBase].Get() : nullptr;
+				packet.DSResource = (norInc >= 0 && m_feature.TessEnable) ? m_norMapSRV[norBase].Get() : nullptr;
+
+				XMFLOAT3 center;
+				XMStoreFloat3(&center, XMVector3Transform(XMLoadFloat3(&m_boundingBox[i].Center), XMLoadFloat4x4(&m_transforms.GetWorld(unitBase + k))));
+				queue.Add(packet, objectData, pass, &item.Material[matBase], center);
+			}
+
+			if (++matInc >= (int)item.MaterialStepRate)
+			{
+				matInc = 0;
+				++matBase;
+			}
+			if (transInc >= 0 && ++transInc >= (int)item.TextureTransformStepRate)
+			{
+				transInc = 0;
+				++transBase;
+			}
+			if (texInc >= 0 && ++texInc >= (int)item.TextureStepRate)
+			{
+				texInc = 0;
+				++texBase;
+			}
+			if (norInc >= 0 && ++norInc >= (int)item.NorTextureStepRate)
+			{
+				norInc = 0;
+				++norBase;
+			}
 		}
 	}
+
+	if (!instancing)
+		return;
+
+	// One instanced packet per unit. Depth is taken at the first instance of the unit.
+	UINT written = WriteInstances(m_deviceResources->GetD3DDeviceContext());
+	packet.InputLayout = m_instanceInputLayout.Get();
+	packet.VS = m_instanceVS.Get();
+	packet.PS = m_instancePS.Get();
+	packet.InstanceBuffer = m_instanceVB.Get();
+	packet.InstanceStride = sizeof(BasicInstance);
+	packet.PSResources[5] = m_instanceMaterialsSRV.Get();
+	packet.DSResource = nullptr;
+	XMStoreFloat4x4(&objectData.TexTransform, XMMatrixIdentity());
+	for (size_t i = 0; i < m_object->Units.size(); ++i)
+	{
+		UINT count = (i + 1 < m_object->Units.size() ? m_unitInstanceStart[i + 1] : written) - m_unitInstanceStart[i];
+		if (!m_unitInstanced[i] || count == 0)
+			continue;
+		BasicElementUnit& item = m_object->Units[i];
+
+		if (m_feature.TextureEnable)
+			XMStoreFloat4x4(&objectData.TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&item.TextureTransform[0])));
+		packet.PSResources[0] = m_feature.TextureEnable ? m_diffuseMapSRV[m_unitTexBase[i]].Get() : nullptr;
+		packet.PSResources[1] = m_feature.TextureEnable && m_feature.NormalEnable ? m_norMapSRV[m_unitNorBase[i]].Get() : nullptr;
+		packet.Count = m_object->UseIndex ? item.Count : item.VCount;
+		packet.Start = item.Start;
+		packet.Base = item.Base;
+		packet.InstanceCount = count;
+		packet.StartInstance = m_unitInstanceStart[i];
+
+		XMFLOAT3 center;
+		XMStoreFloat3(&center, XMVector3Transform(XMLoadFloat3(&m_boundingBox[i].Center), XMLoadFloat4x4(&m_transforms.GetWorld(m_visibleOffsets[i]))));
+		queue.Add(packet, objectData, pass, &item.Material[0], center);
+	}
 }
 
 void BasicObject::DepthRender(bool recover /* = false */)
@@ -348,111 +640,83 @@ void BasicObject::DepthRender(bool recover /* = false */)
 
 	auto renderStateMgr = RenderStateMgr::Instance();
 	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	StateTracker* tracker = m_deviceResources->GetStateTracker();
+	tracker->SetComponent("BasicObject");
 	// Set IA stage
 	UINT stride = m_object->UseEx ? sizeof(PosNormalTexTan) : sizeof(Basic32);
 	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
+	tracker->IASetInputLayout(m_inputLayout.Get());
+	ShaderChangement::InputLayout = m_inputLayout.Get();
 	if (m_feature.Enhance)
 	{
-		if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST)
-		{
-			context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-			ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST;
-		}
+		tracker->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
+		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST;
 	}
 	else
 	{
-		if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-		{
-			context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-			ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		}
+		tracker->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	}
 	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
+	tracker->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
 	if (m_object->UseIndex)
 	{
-		context->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
+		tracker->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
 	}
 
 	// Bind shaders, constant buffers, srvs and samplers
-	ID3D11Buffer* cbuffers[3] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer(), m_tessSettingsCB.GetBuffer() };
-	ID3D11Buffer* cbuffersT[2] = { cbuffers[0], cbuffers[2] };
+	// b0 is the per-frame buffer, bound by itself as it may be a range of the constant ring
+	ID3D11Buffer* cbuffers[2] = { m_perObjectCB->GetBuffer(), m_tessSettingsCB.GetBuffer() };
 	ID3D11SamplerState* samplers[1] = { renderStateMgr->LinearSam() };
 	// vs
-	if (ShaderChangement::VS != m_depthVS.Get())
-	{
-		context->VSSetShader(m_depthVS.Get(), nullptr, 0);
-		ShaderChangement::VS = m_depthVS.Get();
-	}
+	tracker->VSSetShader(m_depthVS.Get());
+	ShaderChangement::VS = m_depthVS.Get();
+	m_perFrameCB->Bind(tracker, ShaderStage::VS, 0);
 	if (m_feature.Enhance)
-		context->VSSetConstantBuffers(0, 3, cbuffers);
+		tracker->SetConstantBuffers(ShaderStage::VS, 1, 2, cbuffers);
 	else
-		context->VSSetConstantBuffers(0, 2, cbuffers);
+		tracker->SetConstantBuffers(ShaderStage::VS, 1, 1, cbuffers);
 	// ps
 	if (m_feature.ClipEnable)
 	{
-		if (ShaderChangement::PS != m_depthPS.Get())
-		{
-			context->PSSetShader(m_depthPS.Get(), nullptr, 0);
-			ShaderChangement::PS = m_depthPS.Get();
-		}
-		context->PSSetSamplers(0, 1, samplers);
-		if (ShaderChangement::RSS != renderStateMgr->DepthBiasNoCullRS())
-		{
-			context->RSSetState(renderStateMgr->DepthBiasNoCullRS());
-			ShaderChangement::RSS = renderStateMgr->DepthBiasNoCullRS();
-		}
+		tracker->PSSetShader(m_depthPS.Get());
+		ShaderChangement::PS = m_depthPS.Get();
+		tracker->SetSamplers(ShaderStage::PS, 0, 1, samplers);
+		tracker->RSSetState(renderStateMgr->DepthBiasNoCullRS());
+		ShaderChangement::RSS = renderStateMgr->DepthBiasNoCullRS();
 	}
 	else
 	{
-		if (ShaderChangement::PS != nullptr)
-		{
-			context->PSSetShader(nullptr, nullptr, 0);
-			ShaderChangement::PS = nullptr;
-		}
-		if (ShaderChangement::RSS != renderStateMgr->DepthBiasRS())
-		{
-			context->RSSetState(renderStateMgr->DepthBiasRS());
-			ShaderChangement::RSS = renderStateMgr->DepthBiasRS();
-		}
+		tracker->PSSetShader(nullptr);
+		ShaderChangement::PS = nullptr;
+		tracker->RSSetState(renderStateMgr->DepthBiasRS());
+		ShaderChangement::RSS = renderStateMgr->DepthBiasRS();
 	}
 	// hs and ds
 	if (m_feature.Enhance)
 	{
-		if (ShaderChangement::HS != m_depthHS.Get())
-		{
-			context->HSSetShader(m_depthHS.Get(), nullptr, 0);
-			ShaderChangement::HS = m_depthHS.Get();
-		}
-		if (ShaderChangement::DS != m_depthDS.Get())
-		{
-			context->DSSetShader(m_depthDS.Get(), nullptr, 0);
-			ShaderChangement::DS = m_depthDS.Get();
-		}
-		context->DSSetConstantBuffers(0, 2, cbuffersT);
-		context->DSSetSamplers(0, 1, samplers);
+		tracker->HSSetShader(m_depthHS.Get());
+		ShaderChangement::HS = m_depthHS.Get();
+		tracker->DSSetShader(m_depthDS.Get());
+		ShaderChangement::DS = m_depthDS.Get();
+		m_perFrameCB->Bind(tracker, ShaderStage::DS, 0);
+		tracker->SetConstantBuffers(ShaderStage::DS, 1, 1, &cbuffers[1]);
+		tracker->SetSamplers(ShaderStage::DS, 0, 1, samplers);
 	}
 	else
 	{
-		if (ShaderChangement::HS != nullptr)
-		{
-			context->HSSetShader(nullptr, nullptr, 0);
-			ShaderChangement::HS = nullptr;
-		}
-		if (ShaderChangement::DS != nullptr)
-		{
-			context->DSSetShader(nullptr, nullptr, 0);
-			ShaderChangement::DS = nullptr;
-		}
+		tracker->HSSetShader(nullptr);
+		ShaderChangement::HS = nullptr;
+		tracker->DSSetShader(nullptr);
+		ShaderChangement::DS = nullptr;
 	}
 
+	m_transforms.Update();
+	CullInstances(CullPass::Depth);
+
 	// Iterate over each unit
 	int totalNum, texBase, texInc, norBase, norInc;
+	int boundTex = -1, boundNor = -1;
 	texBase = norBase = 0;
 	if (m_feature.TextureEnable)
 	{
@@ -470,52 +734,62 @@ void BasicObject::DepthRender(bool recover /* = false */)
 		if (texInc > 0) texInc = 0;
 		if (norInc > 0) norInc = 0;
 
+		UINT unitBase = m_visibleOffsets[i];
+		const UINT8* visible = &m_visible[unitBase];
 		for (int k = 0; k < totalNum; ++k)
 		{
-			// Set world
-			XMMATRIX world = XMLoadFloat4x4(&item.Worlds[k]);
-			XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-			XMStoreFloat4x4(&m_perObjectCB->Data.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&m_perObjectCB->Data.WorldInvTranspose, XMMatrixTranspose(worldInvTranspose));
-			// Set diffuse texture
-			if (texInc == 0)
-				context->PSSetShaderResources(0, 1, m_diffuseMapSRV[texBase].GetAddressOf());
+			if (visible[k])
+			{
+				// Set world
+				m_perObjectCB->Data.World = m_transforms.GetWorldT(unitBase + k);
+				m_perObjectCB->Data.WorldInvTranspose = m_transforms.GetWorldInvTransposeT(unitBase + k);
+				// Set diffuse texture
+				if (texInc >= 0 && texBase != boundTex)
+				{
+					tracker->SetShaderResources(ShaderStage::PS, 0, 1, m_diffuseMapSRV[texBase].GetAddressOf());
+					boundTex = texBase;
+				}
+				// Set normal texture
+				if (m_feature.Enhance && norInc >= 0 && norBase != boundNor)
+				{
+					tracker->SetShaderResources(ShaderStage::DS, 0, 1, m_norMapSRV[norBase].GetAddressOf());
+					boundNor = norBase;
+				}
+
+				// Update constant buffer
+				m_perObjectCB->ApplyChanges(context);
+
+				// Draw
+				if (m_object->UseIndex)
+					tracker->DrawIndexed(item.Count, item.Start, item.Base);
+				else
+					tracker->Draw(item.VCount, item.Base);
+			}
+
 			if (texInc >= 0 && ++texInc >= (int)item.TextureStepRate)
 			{
 				texInc = 0;
 				++texBase;
 			}
-			// Set normal texture
-			if (m_feature.Enhance && norInc == 0)
-				context->DSSetShaderResources(0, 1, m_norMapSRV[norBase].GetAddressOf());
 			if (norInc >= 0 && ++norInc >= (int)item.NorTextureStepRate)
 			{
 				norInc = 0;
 				++norBase;
 			}
-
-			// Update constant buffer
-			m_perObjectCB->ApplyChanges(context);
-
-			// Draw
-			if (m_object->UseIndex)
-				context->DrawIndexed(item.Count, item.Start, item.Base);
-			else
-				context->Draw(item.VCount, item.Base);
 		}
 	}
 
 	// Recovery
 	if (recover)
 	{
-		context->RSSetState(nullptr);
+		tracker->RSSetState(nullptr);
 		ShaderChangement::RSS = nullptr;
 		if (m_feature.Enhance)
 		{
 			ShaderChangement::HS = nullptr;
 			ShaderChangement::DS = nullptr;
-			context->HSSetShader(nullptr, nullptr, 0);
-			context->DSSetShader(nullptr, nullptr, 0);
+			tracker->HSSetShader(nullptr);
+			tracker->DSSetShader(nullptr);
 		}
 	}
 }
@@ -527,105 +801,83 @@ void BasicObject::NorDepRender(bool recover /* = false */)
 
 	auto renderStateMgr = RenderStateMgr::Instance();
 	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	StateTracker* tracker = m_deviceResources->GetStateTracker();
+	tracker->SetComponent("BasicObject");
 	// Set IA stage.
 	UINT stride = m_object->UseEx ? sizeof(PosNormalTexTan) : sizeof(Basic32);
 	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
+	tracker->IASetInputLayout(m_inputLayout.Get());
+	ShaderChangement::InputLayout = m_inputLayout.Get();
 	if (m_feature.Enhance)
 	{
-		if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST)
-		{
-			context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-			ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST;
-		}
+		tracker->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
+		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST;
 	}
 	else
 	{
-		if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-		{
-			context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-			ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		}
+		tracker->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	}
 	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
+	tracker->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
 	if (m_object->UseIndex)
 	{
-		context->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
+		tracker->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
 	}
 
 	// Bind shaders, constant buffers, srvs and samplers
-	ID3D11Buffer* cbuffers[3] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer(), m_tessSettingsCB.GetBuffer() };
-	ID3D11Buffer* cbuffersT[2] = { cbuffers[0], cbuffers[2] };
+	// b0 is the per-frame buffer, bound by itself as it may be a range of the constant ring
+	ID3D11Buffer* cbuffers[2] = { m_perObjectCB->GetBuffer(), m_tessSettingsCB.GetBuffer() };
 	ID3D11SamplerState* samplers[1] = { renderStateMgr->LinearSam() };
 	// vs
-	if (ShaderChangement::VS != m_norDepVS.Get())
-	{
-		context->VSSetShader(m_norDepVS.Get(), nullptr, 0);
-		ShaderChangement::VS = m_norDepVS.Get();
-	}
+	tracker->VSSetShader(m_norDepVS.Get());
+	ShaderChangement::VS = m_norDepVS.Get();
+	m_perFrameCB->Bind(tracker, ShaderStage::VS, 0);
 	if (m_feature.Enhance)
-		context->VSSetConstantBuffers(0, 3, cbuffers);
+		tracker->SetConstantBuffers(ShaderStage::VS, 1, 2, cbuffers);
 	else
-		context->VSSetConstantBuffers(0, 2, cbuffers);
+		tracker->SetConstantBuffers(ShaderStage::VS, 1, 1, cbuffers);
 	// ps
-	if (ShaderChangement::PS != m_norDepPS.Get())
-	{
-		context->PSSetShader(m_norDepPS.Get(), nullptr, 0);
-		ShaderChangement::PS = m_norDepPS.Get();
-	}
+	tracker->PSSetShader(m_norDepPS.Get());
+	ShaderChangement::PS = m_norDepPS.Get();
 
 	if (m_feature.ClipEnable)
 	{
-		context->PSSetSamplers(0, 1, samplers);
-		if (ShaderChangement::RSS != renderStateMgr->NoCullRS())
-		{
-			context->RSSetState(renderStateMgr->NoCullRS());
-			ShaderChangement::RSS = renderStateMgr->NoCullRS();
-		}
+		tracker->SetSamplers(ShaderStage::PS, 0, 1, samplers);
+		tracker->RSSetState(renderStateMgr->NoCullRS());
+		ShaderChangement::RSS = renderStateMgr->NoCullRS();
 	}
-	else if (ShaderChangement::RSS != nullptr)
+	else
 	{
-		context->RSSetState(nullptr);
+		tracker->RSSetState(nullptr);
 		ShaderChangement::RSS = nullptr;
 	}
 
 	// hs and ds
 	if (m_feature.Enhance)
 	{
-		if (ShaderChangement::HS != m_norDepHS.Get())
-		{
-			context->HSSetShader(m_norDepHS.Get(), nullptr, 0);
-			ShaderChangement::HS = m_norDepHS.Get();
-		}
-		if (ShaderChangement::DS != m_norDepDS.Get())
-		{
-			context->DSSetShader(m_norDepDS.Get(), nullptr, 0);
-			ShaderChangement::DS = m_norDepDS.Get();
-		}
-		context->DSSetConstantBuffers(0, 2, cbuffersT);
-		context->DSSetSamplers(0, 1, samplers);
+		tracker->HSSetShader(m_norDepHS.Get());
+		ShaderChangement::HS = m_norDepHS.Get();
+		tracker->DSSetShader(m_norDepDS.Get());
+		ShaderChangement::DS = m_norDepDS.Get();
+		m_perFrameCB->Bind(tracker, ShaderStage::DS, 0);
+		tracker->SetConstantBuffers(ShaderStage::DS, 1, 1, &cbuffers[1]);
+		tracker->SetSamplers(ShaderStage::DS, 0, 1, samplers);
 	}
 	else
 	{
-		if (ShaderChangement::HS != nullptr)
-		{
-			context->HSSetShader(nullptr, nullptr, 0);
-			ShaderChangement::HS = nullptr;
-		}
-		if (ShaderChangement::DS != nullptr)
-		{
-			context->DSSetShader(nullptr, nullptr, 0);
-			ShaderChangement::DS = nullptr;
-		}
+		tracker->HSSetShader(nullptr);
+		ShaderChangement::HS = nullptr;
+		tracker->DSSetShader(nullptr);
+		ShaderChangement::DS = nullptr;
 	}
 
+	m_transforms.Update();
+	CullInstances(CullPass::NorDep);
+
 	// Iterate over each unit
 	int totalNum, texBase, texInc, norBase, norInc;
+	int boundTex = -1, boundNor = -1;
 	texBase = norBase = 0;
 	if (m_feature.TextureEnable)
 	{
@@ -644,38 +896,48 @@ void BasicObject::NorDepRender(bool recover /* = false */)
 		if (texInc > 0) texInc = 0;
 		if (norInc > 0) norInc = 0;
 
+		UINT unitBase = m_visibleOffsets[i];
+		const UINT8* visible = &m_visible[unitBase];
 		for (int k = 0; k < totalNum; ++k)
 		{
-			// Set world
-			XMMATRIX world = XMLoadFloat4x4(&item.Worlds[k]);
-			XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-			XMStoreFloat4x4(&m_perObjectCB->Data.World, XMMatrixTranspose(world));
-			XMStoreFloat4x4(&m_perObjectCB->Data.WorldInvTranspose, XMMatrixTranspose(worldInvTranspose));
-			// Set diffuse texture
-			if (texInc == 0)
-				context->PSSetShaderResources(0, 1, m_diffuseMapSRV[texBase].GetAddressOf());
+			if (visible[k])
+			{
+				// Set world
+				m_perObjectCB->Data.World = m_transforms.GetWorldT(unitBase + k);
+				m_perObjectCB->Data.WorldInvTranspose = m_transforms.GetWorldInvTransposeT(unitBase + k);
+				// Set diffuse texture
+				if (texInc >= 0 && texBase != boundTex)
+				{
+					tracker->SetShaderResources(ShaderStage::PS, 0, 1, m_diffuseMapSRV[texBase].GetAddressOf());
+					boundTex = texBase;
+				}
+				// Set normal texture
+				if (m_feature.Enhance && norInc >= 0 && norBase != boundNor)
+				{
+					tracker->SetShaderResources(ShaderStage::DS, 0, 1, m_norMapSRV[norBase].GetAddressOf());
+					boundNor = norBase;
+				}
+
+				// Update constant buffer
+				m_perObjectCB->ApplyChanges(context);
+
+				// Draw
+				if (m_object->UseIndex)
+					tracker->DrawIndexed(item.Count, item.Start, item.Base);
+				else
+					tracker->Draw(item.VCount, item.Base);
+			}
+
 			if (texInc >= 0 && ++texInc >= (int)item.TextureStepRate)
 			{
 				texInc = 0;
 				++texBase;
 			}
-			// Set normal texture
-			if (m_feature.Enhance && norInc == 0)
-				context->DSSetShaderResources(0, 1, m_norMapSRV[norBase].GetAddressOf());
 			if (norInc >= 0 && ++norInc >= (int)item.NorTextureStepRate)
 			{
 				norInc = 0;
 				++norBase;
 			}
-
-			// Update constant buffer
-			m_perObjectCB->ApplyChanges(context);
-
-			// Draw
-			if (m_object->UseIndex)
-				context->DrawIndexed(item.Count, item.Start, item.Base);
-			else
-				context->Draw(item.VCount, item.Base);
 		}
 	}
 
@@ -684,13 +946,13 @@ void BasicObject::NorDepRender(bool recover /* = false */)
 	{
 		if (m_feature.ClipEnable)
 		{
-			context->RSSetState(nullptr);
+			tracker->RSSetState(nullptr);
 			ShaderChangement::RSS = nullptr;
 		}
 		ShaderChangement::HS = nullptr;
 		ShaderChangement::DS = nullptr;
-		context->HSSetShader(nullptr, nullptr, 0);
-		context->DSSetShader(nullptr, nullptr, 0);
+		tracker->HSSetShader(nullptr);
+		tracker->DSSetShader(nullptr);
 	}
 }
 
@@ -702,6 +964,9 @@ void BasicObject::ReleaseDeviceDependentResources()
 	m_objectVB.Reset();
 	m_objectIB.Reset();
 	m_tessSettingsCB.Reset();
+	m_instanceVB.Reset();
+	m_instanceMaterials.Reset();
+	m_instanceMaterialsSRV.Reset();
 
 	// Shaders
 	m_inputLayout.Reset();
@@ -717,10 +982,15 @@ void BasicObject::ReleaseDeviceDependentResources()
 	m_norDepPS.Reset();
 	m_norDepHS.Reset();
 	m_norDepDS.Reset();
+	m_instanceInputLayout.Reset();
+	m_instanceVS.Reset();
+	m_instancePS.Reset();
 
 	// SRV
 	m_diffuseMapSRV.clear();
 	m_norMapSRV.clear();
+	m_diffuseStreamIds.clear();
+	m_norStreamIds.clear();
 	m_reflectMapSRV.Reset();
 	m_depthMapSRV.Reset();
 	m_ssaoMapSRV.Reset();
@@ -755,48 +1025,54 @@ concurrency::task<void> BasicObject::LoadFeatureAsync(const BasicFeatureConfigur
 	std::shared_ptr<ComPtr<ID3D11HullShader>> norDepHS = std::make_shared<ComPtr<ID3D11HullShader>>();
 	std::shared_ptr<ComPtr<ID3D11DomainShader>> norDepDS = std::make_shared<ComPtr<ID3D11DomainShader>>();
 	std::shared_ptr<ComPtr<ID3D11ShaderResourceView>> reflectMapSRV = std::make_shared<ComPtr<ID3D11ShaderResourceView>>();
+	std::shared_ptr<ComPtr<ID3D11InputLayout>> instanceInputLayout = std::make_shared<ComPtr<ID3D11InputLayout>>();
+	std::shared_ptr<ComPtr<ID3D11VertexShader>> instanceVS = std::make_shared<ComPtr<ID3D11VertexShader>>();
+	std::shared_ptr<ComPtr<ID3D11PixelShader>> instancePS = std::make_shared<ComPtr<ID3D11PixelShader>>();
 
 	// Load shaders
 	std::vector<concurrency::task<void>> CreateTasks;
+	// Permutations share one feature key, each family keeps the features it is compiled for
+	UINT features = (feature.NormalEnable ? ShaderPermutations::Normal : 0)
+		| (feature.TessEnable ? ShaderPermutations::Tess : 0)
+		| (feature.ShadowEnable ? ShaderPermutations::Shadow : 0)
+		| (feature.SsaoEnable ? ShaderPermutations::Ssao : 0)
+		| (feature.TextureEnable ? ShaderPermutations::Texture : 0)
+		| (feature.ClipEnable ? ShaderPermutations::Clip : 0)
+		| (feature.ReflectEnable ? ShaderPermutations::Reflect : 0)
+		| (feature.FogEnable ? ShaderPermutations::Fog : 0)
+		| ShaderPermutations::MakeLightCount(feature.LightCount);
 	// basicVS
-	std::wstring shaderName = L"BasicVS";
 	InputLayoutType inputLayoutType = feature.NormalEnable ? InputLayoutType::PosNormalTexTan : InputLayoutType::Basic32;
-	shaderName += feature.NormalEnable ? L'1' : L'0';
-	shaderName += feature.TessEnable ? L'1' : L'0';
-	shaderName += feature.ShadowEnable ? L'1' : L'0';
-	shaderName += feature.SsaoEnable ? L'1' : L'0';
-	shaderName += L'0';
-	shaderName += L".cso";
-	CreateTasks.push_back(shaderMgr->GetVSAsync(shaderName, inputLayoutType)
+	CreateTasks.push_back(shaderMgr->GetVSAsync(ShaderPermutations::MakeKey(ShaderPermutations::BasicVS, features))
 		.then([=](ID3D11VertexShader* vs)
 	{
 		*basicVS = vs;
 		*inputLayout = shaderMgr->GetInputLayout(inputLayoutType);
 	}));
 	// basicPS
-	shaderName = L"BasicPS";
-	shaderName += feature.TextureEnable ? L'1' : L'0';
-	shaderName += feature.ClipEnable ? L'1' : L'0';
-	shaderName += feature.NormalEnable ? L'1' : L'0';
-	shaderName += feature.ShadowEnable ? L'1' : L'0';
-	shaderName += feature.SsaoEnable ? L'1' : L'0';
-	shaderName += (L'0' + feature.LightCount);
-	shaderName += feature.ReflectEnable ? L'1' : L'0';
-	shaderName += feature.FogEnable ? L'1' : L'0';
-	shaderName += L".cso";
-	CreateTasks.push_back(shaderMgr->GetPSAsync(shaderName)
+	CreateTasks.push_back(shaderMgr->GetPSAsync(ShaderPermutations::MakeKey(ShaderPermutations::BasicPS, features))
 		.then([=](ID3D11PixelShader* ps) { *basicPS = ps; }));
+	// instanceVS and instancePS, same features without tessellation
+	if (feature.InstanceEnable && !feature.TessEnable)
+	{
+		CreateTasks.push_back(shaderMgr->GetPSAsync(ShaderPermutations::MakeKey(ShaderPermutations::BasicInstPS, features))
+			.then([=](ID3D11PixelShader* ps) { *instancePS = ps; }));
+		InputLayoutType instanceLayoutType = feature.NormalEnable ? InputLayoutType::PosNormalTexTanInstanced : InputLayoutType::Basic32Instanced;
+		CreateTasks.push_back(shaderMgr->GetVSAsync(ShaderPermutations::MakeKey(ShaderPermutations::BasicInstVS, features))
+			.then([=](ID3D11VertexShader* vs)
+		{
+			*instanceVS = vs;
+			*instanceInputLayout = shaderMgr->GetInputLayout(instanceLayoutType);
+		}));
+	}
 	// basicHS and basicDS
+	std::wstring shaderName;
 	if (feature.TessEnable)
 	{
 		shaderName = L"BasicHS.cso";
 		CreateTasks.push_back(shaderMgr->GetHSAsync(shaderName)
 			.then([=](ID3D11HullShader* hs) { *basicHS = hs; }));
-		shaderName = L"BasicDS";
-		shaderName += feature.ShadowEnable ? L'1' : L'0';
-		shaderName += feature.SsaoEnable ? L'1' : L'0';
-		shaderName += L".cso";
-		CreateTasks.push_back(shaderMgr->GetDSAsync(shaderName)
+		CreateTasks.push_back(shaderMgr->GetDSAsync(ShaderPermutations::MakeKey(ShaderPermutations::BasicDS, features))
 			.then([=](ID3D11DomainShader* ds) { *basicDS = ds; }));
 	}
 	// Shadow -- get depth
@@ -865,6 +1141,9 @@ concurrency::task<void> BasicObject::LoadFeatureAsync(const BasicFeatureConfigur
 		m_norDepPS = norDepPS->Get();
 		m_norDepHS = norDepHS->Get();
 		m_norDepDS = norDepDS->Get();
+		m_instanceInputLayout = instanceInputLayout->Get();
+		m_instanceVS = instanceVS->Get();
+		m_instancePS = instancePS->Get();
 
 		// Update tess constant buffer
 		if (m_feature.TessEnable)
@@ -928,6 +1207,36 @@ concurrency::task<void> BasicObject::BuildDataAsync()
 		ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&ibd, &iinitData, m_objectIB.GetAddressOf()));
 	}
 
+	// Instance stream and materials of the instanced units
+	if (m_instanceCount > 0)
+	{
+		D3D11_BUFFER_DESC instbd;
+		instbd.Usage = D3D11_USAGE_DYNAMIC;
+		instbd.ByteWidth = sizeof(BasicInstance) * m_instanceCount;
+		instbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		instbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		instbd.MiscFlags = 0;
+		instbd.StructureByteStride = 0;
+		ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&instbd, nullptr, m_instanceVB.GetAddressOf()));
+
+		D3D11_BUFFER_DESC matbd;
+		matbd.Usage = D3D11_USAGE_DYNAMIC;
+		matbd.ByteWidth = sizeof(Material) * m_instanceMaterialCount;
+		matbd.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		matbd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		matbd.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		matbd.StructureByteStride = sizeof(Material);
+		ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&matbd, nullptr, m_instanceMaterials.GetAddressOf()));
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = m_instanceMaterialCount;
+		ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateShaderResourceView(m_instanceMaterials.Get(), &srvDesc, m_instanceMaterialsSRV.GetAddressOf()));
+		m_materialsDirty = true;
+	}
+
 	// Load texture. Avoid loading same file at the same time.
 	std::vector<concurrency::task<void>> LoadTasks;
 	std::vector<std::wstring> fileCache;
@@ -944,6 +1253,8 @@ concurrency::task<void> BasicObject::BuildDataAsync()
 	}
 	m_diffuseMapSRV.resize(textureCount);
 	m_norMapSRV.resize(normalCount);
+	m_diffuseStreamIds.assign(textureCount, TextureMgr::NotStreamed);
+	m_norStreamIds.assign(normalCount, TextureMgr::NotStreamed);
 	textureCount = 0;
 	normalCount = 0;
 	for (auto& item : m_object->Units)
@@ -952,6 +1263,17 @@ concurrency::task<void> BasicObject::BuildDataAsync()
 		{
 			for (size_t k = 0; k < item.TextureFileNames.size(); ++k)
 			{
+				if (m_streamTextures && TextureMgr::IsStreamable(item.TextureFileNames[k]))
+				{
+					// TextureMgr joins the requests of a file itself
+					LoadTasks.push_back(textureMgr->GetStreamedTextureAsync(item.TextureFileNames[k]).then([=](UINT id)
+					{
+						m_diffuseStreamIds[textureCount] = id;
+						m_diffuseMapSRV[textureCount] = textureMgr->GetStreamedTexture(id);
+					}));
+					++textureCount;
+					continue;
+				}
 				cacheFlag = false;
 				for (auto& file : fileCache)
 					if (file == item.TextureFileNames[k])
@@ -973,6 +1295,16 @@ concurrency::task<void> BasicObject::BuildDataAsync()
 		{
 			for (size_t k = 0; k < item.NorTextureFileNames.size(); ++k)
 			{
+				if (m_streamTextures && TextureMgr::IsStreamable(item.NorTextureFileNames[k]))
+				{
+					LoadTasks.push_back(textureMgr->GetStreamedTextureAsync(item.NorTextureFileNames[k]).then([=](UINT id)
+					{
+						m_norStreamIds[normalCount] = id;
+						m_norMapSRV[normalCount] = textureMgr->GetStreamedTexture(id);
+					}));
+					++normalCount;
+					continue;
+				}
 				cacheFlag = false;
 				for (auto& file : fileCache)
 					if (file == item.NorTextureFileNames[k])
@@ -1030,6 +1362,110 @@ void BasicObject::UpdateNormalMapSRV(int i, ID3D11ShaderResourceView* srv)
 	m_norMapSRV[i] = srv;
 }
 
+void BasicObject::CullInstances(CullPass pass)
+{
+	CullStats& stats = m_cullStats[(int)pass];
+	stats.Tested = m_visible.size();
+	if (!m_cullEnabled)
+	{
+		m_visible.assign(m_visible.size(), 1);
+		stats.Visible = stats.Tested;
+		return;
+	}
+
+	XMFLOAT4 planes[6];
+	InstanceCuller::ExtractPlanes(m_perFrameCB->Data, planes);
+	stats.Visible = 0;
+	for (size_t i = 0; i < m_object->Units.size(); ++i)
+	{
+		auto& worlds = m_object->Units[i].Worlds;
+		if (!worlds.empty())
+			stats.Visible += InstanceCuller::Cull(m_boundingBox[i], &worlds[0], worlds.size(), planes, &m_visible[m_visibleOffsets[i]]);
+	}
+}
+
+void BasicObject::UpdateStreamedTextures()
+{
+	if (!m_streamTextures)
+		return;
+
+	const BasicPerFrameCB& frame = m_perFrameCB->Data;
+	float viewportHeight = m_deviceResources->GetScreenViewport().Height;
+	auto textureMgr = TextureMgr::Instance();
+	UINT texBase = 0, norBase = 0;
+	for (size_t i = 0; i < m_object->Units.size(); ++i)
+	{
+		// Pixels covered by the largest visible instance of the unit
+		BasicElementUnit& item = m_object->Units[i];
+		float screenSize = 0.0f;
+		for (UINT j = 0; j < item.Worlds.size(); ++j)
+		{
+			if (!m_visible[m_visibleOffsets[i] + j])
+				continue;
+			BoundingSphere sphere = GetTransBoundingSphere(i, j);
+			float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&sphere.Center) - XMLoadFloat3(&frame.EyePosW)));
+			screenSize = std::max<float>(screenSize, TextureResidency::ProjectedSize(sphere.Radius, distance, frame.Proj._22, viewportHeight));
+		}
+
+		// Views change as mips arrive and are evicted, so they are fetched again every frame
+		for (UINT k = texBase; k < texBase + item.TextureFileNames.size(); ++k)
+		{
+			if (m_diffuseStreamIds[k] == TextureMgr::NotStreamed)
+				continue;
+			if (screenSize > 0.0f)
+				textureMgr->NoteTextureUse(m_diffuseStreamIds[k], screenSize);
+			m_diffuseMapSRV[k] = textureMgr->GetStreamedTexture(m_diffuseStreamIds[k]);
+		}
+		for (UINT k = norBase; k < norBase + item.NorTextureFileNames.size(); ++k)
+		{
+			if (m_norStreamIds[k] == TextureMgr::NotStreamed)
+				continue;
+			if (screenSize > 0.0f)
+				textureMgr->NoteTextureUse(m_norStreamIds[k], screenSize);
+			m_norMapSRV[k] = textureMgr->GetStreamedTexture(m_norStreamIds[k]);
+		}
+		texBase += item.TextureFileNames.size();
+		norBase += item.NorTextureFileNames.size();
+	}
+}
+
+void BasicObject::SetWorld(int i, int j, const XMFLOAT4X4& world)
+{
+	m_object->Units[i].Worlds[j] = world;
+	m_transforms.Set(m_visibleOffsets[i] + j, world);
+	if (m_bvh)
+		m_bvh->Update(m_bvhIds[m_visibleOffsets[i] + j], GetTransBoundingBox(i, j));
+}
+
+void BasicObject::AttachToBvh(SceneBvh* bvh)
+{
+	DetachFromBvh();
+	m_bvh = bvh;
+	// Destroying the BVH first leaves nothing to remove
+	bvh->AddOwner(this, [this]()
+	{
+		m_bvh = nullptr;
+		m_bvhIds.clear();
+	});
+	m_bvhIds.resize(m_visible.size());
+	for (UINT i = 0; i < m_object->Units.size(); ++i)
+	{
+		for (UINT j = 0; j < m_object->Units[i].Worlds.size(); ++j)
+			m_bvhIds[m_visibleOffsets[i] + j] = bvh->Insert(GetTransBoundingBox(i, j), SceneBvhItem(this, i, j));
+	}
+}
+
+void BasicObject::DetachFromBvh()
+{
+	if (!m_bvh)
+		return;
+	for (UINT id : m_bvhIds)
+		m_bvh->Remove(id);
+	m_bvh->RemoveOwner(this);
+	m_bvhIds.clear();
+	m_bvh = nullptr;
+}
+
 BoundingBox BasicObject::GetTransBoundingBox(int i, int j)
 {
 	BoundingBox res;
@@ -9,6 +9,10 @@
 #include "Common/GameTimer.h"
 #include "Common/ConstantBuffer.h"
 #include "Common/DeviceResources.h"
+#include "InstanceCuller.h"
+#include "SceneBvh.h"
+#include "TransformStore.h"
+#include "RenderQueue.h"
 
 
 // Manage basic objects which takes "DX::Basic32" as the input data structure.
@@ -66,6 +70,7 @@ namespace DXFramework
 		bool FogEnable;
 		bool TessEnable;
 		bool Enhance;
+		bool InstanceEnable;	// Draw units whose instances share textures with one instanced call. No tessellation.
 		DX::BasicTessSettings TessDesc;
 		std::wstring ReflectFileName;
 	};
@@ -78,6 +83,7 @@ namespace DXFramework
 			const std::shared_ptr<DX::DeviceResources>& deviceResources,
 			const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerFrameCB>>& perFrameCB,
 			const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerObjectCB>>& perObjectCB);
+		~BasicObject();
 
 		void Initialize(BasicObjectData* data, BasicFeatureConfigure feature);
 		concurrency::task<void> CreateDeviceDependentResourcesAsync();
@@ -85,6 +91,9 @@ namespace DXFramework
 		void Render(bool recover = false);
 		void DepthRender(bool recover = false);
 		void NorDepRender(bool recover = false);
+		// Add one packet per visible instance to a render queue instead of drawing. With
+		// InstanceEnable each instanced unit is one instanced packet instead.
+		void Submit(RenderQueue& queue);
 
 	public:
 		// Config functions
@@ -96,8 +105,8 @@ namespace DXFramework
 		void UpdateDiffuseMapSRV(int i, ID3D11ShaderResourceView* srv);
 		void UpdateNormalMapSRV(int i, ID3D11ShaderResourceView* srv);
 
-		void SetWorld(int i, int j, const DirectX::XMFLOAT4X4& world) { m_object->Units[i].Worlds[j] = world; }
-		void SetMaterial(int i, int j, const DX::Material& mat) { m_object->Units[i].Material[j] = mat; }
+		void SetWorld(int i, int j, const DirectX::XMFLOAT4X4& world);
+		void SetMaterial(int i, int j, const DX::Material& mat) { m_object->Units[i].Material[j] = mat; m_materialsDirty = true; }
 		void SetTexTranform(int i, int j, const DirectX::XMFLOAT4X4& transform) { m_object->Units[i].TextureTransform[j] = transform; }
 
 		DirectX::XMFLOAT4X4 GetWorld(int i, int j) { return m_object->Units[i].Worlds[j]; }
@@ -106,9 +115,28 @@ namespace DXFramework
 		DirectX::BoundingBox GetTransBoundingBox(int i, int j = 0);
 		DirectX::BoundingSphere GetTransBoundingSphere(int i, int j = 0);
 
+		// Frustum culling of instances, on by default. Stats are from the last call of each pass.
+		void SetCullingEnabled(bool enable) { m_cullEnabled = enable; }
+		CullStats GetCullStats(CullPass pass) { return m_cullStats[(int)pass]; }
+
+		// Load the DDS maps as streamed textures of TextureMgr, off by default. The mips of a
+		// unit's maps follow the on screen size of its largest visible instance. Set before
+		// the resources are created.
+		void SetTextureStreaming(bool enable) { m_streamTextures = enable; }
+
+		// Insert every instance into a scene BVH. SetWorld keeps the items up to date, the owner
+		// of the BVH calls Refresh once per frame. Items are removed when the object is destroyed,
+		// a BVH destroyed first detaches the object.
+		void AttachToBvh(SceneBvh* bvh);
+		void DetachFromBvh();
+
 	private:
 		concurrency::task<void> BuildDataAsync();
 		concurrency::task<void> LoadFeatureAsync(const BasicFeatureConfigure& feature);
+		void CullInstances(CullPass pass);
+		void UpdateStreamedTextures();
+		UINT WriteInstances(ID3D11DeviceContext* context);
+		void RenderInstanced(ID3D11DeviceContext* context);
 
 	private:
 		// Cached pointer to shared resources
@@ -137,10 +165,16 @@ namespace DXFramework
 		Microsoft::WRL::ComPtr<ID3D11PixelShader> m_norDepPS;
 		Microsoft::WRL::ComPtr<ID3D11HullShader> m_norDepHS;
 		Microsoft::WRL::ComPtr<ID3D11DomainShader> m_norDepDS;
+		Microsoft::WRL::ComPtr<ID3D11InputLayout> m_instanceInputLayout;
+		Microsoft::WRL::ComPtr<ID3D11VertexShader> m_instanceVS;
+		Microsoft::WRL::ComPtr<ID3D11PixelShader> m_instancePS;
 
 		// SRV
 		std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_diffuseMapSRV;
 		std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_norMapSRV;
+		// Streamed ids of the maps, TextureMgr::NotStreamed for maps loaded whole
+		std::vector<UINT> m_diffuseStreamIds;
+		std::vector<UINT> m_norStreamIds;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_reflectMapSRV;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_depthMapSRV;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_ssaoMapSRV;
@@ -148,10 +182,37 @@ namespace DXFramework
 		// Custom data
 		bool m_texture;
 		bool m_normal;
+		bool m_streamTextures;
 
 		std::vector<DirectX::BoundingBox> m_boundingBox;
 		std::vector<DirectX::BoundingSphere> m_boundingSphere;
 
+		// Upload ready transforms per instance, units packed one after another like m_visible
+		TransformStore m_transforms;
+		// Visibility flag per instance, units packed one after another
+		std::vector<UINT8> m_visible;
+		std::vector<UINT> m_visibleOffsets;
+		CullStats m_cullStats[(int)CullPass::Count];
+		bool m_cullEnabled;
+
+		// Scene BVH item per instance, same layout as m_visible
+		SceneBvh* m_bvh;
+		std::vector<UINT> m_bvhIds;
+
+		// Instanced units. The instance stream is rewritten every frame with the visible
+		// instances, the material buffer only after SetMaterial.
+		Microsoft::WRL::ComPtr<ID3D11Buffer> m_instanceVB;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> m_instanceMaterials;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_instanceMaterialsSRV;
+		std::vector<UINT8> m_unitInstanced;
+		std::vector<UINT> m_unitMaterialBase;
+		std::vector<UINT> m_unitInstanceStart;
+		std::vector<UINT> m_unitTexBase;
+		std::vector<UINT> m_unitNorBase;
+		UINT m_instanceCount;
+		UINT m_instanceMaterialCount;
+		bool m_materialsDirty;
+
 		bool m_initialized;
 		bool m_loadingComplete;
 	};
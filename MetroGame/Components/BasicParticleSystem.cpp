@@ -195,6 +195,7 @@ void BasicParticleSystem::Render()
 	ShaderChangement::VS = m_drawVS.Get();
 	ShaderChangement::GS = nullptr;
 	ShaderChangement::PS = m_drawPS.Get();
+	m_deviceResources->GetStateTracker()->Invalidate();
 }
 
 void BasicParticleSystem::ReleaseDeviceDependentResources()
@@ -152,6 +152,7 @@ void BillboardTrees::Render()
 	// Remove gs
 	context->GSSetShader(nullptr, 0, 0);
 	ShaderChangement::GS = nullptr;
+	m_deviceResources->GetStateTracker()->Invalidate();
 }
 
 void BillboardTrees::ReleaseDeviceDependentResources()
@@ -0,0 +1,188 @@
+#include "pch.h"
+#include "D3DDrawContext.h"
+#include "Common/RenderStateMgr.h"
+#include "Common/ShaderChangement.h"
+
+using namespace DXFramework;
+using namespace DirectX;
+
+using namespace DX;
+
+D3DDrawContext::D3DDrawContext(
+	const std::shared_ptr<DX::DeviceResources>& deviceResources,
+	const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerFrameCB>>& perFrameCB,
+	const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerObjectCB>>& perObjectCB)
+	: m_deviceResources(deviceResources), m_perFrameCB(perFrameCB), m_perObjectCB(perObjectCB), m_context(nullptr),
+	m_defaultRasterizerState(nullptr), m_tracker(nullptr)
+{
+}
+
+void D3DDrawContext::CreateDeviceDependentResources()
+{
+	m_skinnedCB.Initialize(m_deviceResources->GetD3DDevice());
+}
+
+void D3DDrawContext::ReleaseDeviceDependentResources()
+{
+	m_skinnedCB.Reset();
+	m_context = nullptr;
+	m_tracker = nullptr;
+}
+
+void D3DDrawContext::Begin()
+{
+	// Bindings shared by every packet
+	auto renderStateMgr = RenderStateMgr::Instance();
+	m_context = m_deviceResources->GetD3DDeviceContext();
+	// Shared with the components, so binds left by them are filtered as well
+	m_tracker = m_deviceResources->GetStateTracker();
+	m_tracker->SetComponent("RenderQueue");
+	ID3D11Buffer* perObject = m_perObjectCB->GetBuffer();
+	ID3D11Buffer* skinned = m_skinnedCB.GetBuffer();
+	ID3D11SamplerState* samplers[2] = { renderStateMgr->LinearSam(), renderStateMgr->ShadowSam() };
+	m_perFrameCB->Bind(m_tracker, ShaderStage::VS, 0);
+	m_perFrameCB->Bind(m_tracker, ShaderStage::PS, 0);
+	m_perFrameCB->Bind(m_tracker, ShaderStage::DS, 0);
+	m_tracker->SetConstantBuffers(ShaderStage::VS, 1, 1, &perObject);
+	m_tracker->SetConstantBuffers(ShaderStage::VS, 3, 1, &skinned);
+	m_tracker->SetConstantBuffers(ShaderStage::PS, 1, 1, &perObject);
+	m_tracker->SetSamplers(ShaderStage::PS, 0, 2, samplers);
+	m_tracker->SetSamplers(ShaderStage::DS, 0, 1, samplers);
+	m_objectData = RingAllocation();
+}
+
+void D3DDrawContext::PrepareObjectData(const BasicPerObjectCB* data, UINT count)
+{
+	// Too much for the ring leaves the allocation empty, the packets map one by one then
+	ConstantRing* ring = m_deviceResources->GetConstantRing();
+	if (ring)
+		m_objectData = ring->UploadArray(m_context, data, sizeof(BasicPerObjectCB), count);
+}
+
+void D3DDrawContext::End()
+{
+	ID3D11ShaderResourceView* nullSRV[4] = { nullptr, nullptr, nullptr, nullptr };
+	m_tracker->SetShaderResources(ShaderStage::PS, 2, 4, nullSRV);
+	m_tracker->RSSetState(nullptr);
+	m_tracker->HSSetShader(nullptr);
+	m_tracker->DSSetShader(nullptr);
+	ShaderChangement::RSS = nullptr;
+	ShaderChangement::HS = nullptr;
+	ShaderChangement::DS = nullptr;
+}
+
+void D3DDrawContext::SetInputLayout(ID3D11InputLayout* layout)
+{
+	m_tracker->IASetInputLayout(layout);
+	ShaderChangement::InputLayout = layout;
+}
+
+void D3DDrawContext::SetTopology(D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	m_tracker->IASetPrimitiveTopology(topology);
+	ShaderChangement::PrimitiveType = topology;
+}
+
+void D3DDrawContext::SetVertexBuffer(ID3D11Buffer* buffer, UINT stride)
+{
+	UINT offset = 0;
+	m_tracker->IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
+}
+
+void D3DDrawContext::SetInstanceBuffer(ID3D11Buffer* buffer, UINT stride)
+{
+	UINT offset = 0;
+	m_tracker->IASetVertexBuffers(1, 1, &buffer, &stride, &offset);
+}
+
+void D3DDrawContext::SetIndexBuffer(ID3D11Buffer* buffer)
+{
+	m_tracker->IASetIndexBuffer(buffer, DXGI_FORMAT_R32_UINT, 0);
+}
+
+void D3DDrawContext::SetVS(ID3D11VertexShader* vs)
+{
+	m_tracker->VSSetShader(vs);
+	ShaderChangement::VS = vs;
+}
+
+void D3DDrawContext::SetHS(ID3D11HullShader* hs)
+{
+	m_tracker->HSSetShader(hs);
+	ShaderChangement::HS = hs;
+}
+
+void D3DDrawContext::SetDS(ID3D11DomainShader* ds)
+{
+	m_tracker->DSSetShader(ds);
+	ShaderChangement::DS = ds;
+}
+
+void D3DDrawContext::SetPS(ID3D11PixelShader* ps)
+{
+	m_tracker->PSSetShader(ps);
+	ShaderChangement::PS = ps;
+}
+
+void D3DDrawContext::SetRasterizerState(ID3D11RasterizerState* state)
+{
+	if (!state)
+		state = m_defaultRasterizerState;
+	m_tracker->RSSetState(state);
+	ShaderChangement::RSS = state;
+}
+
+void D3DDrawContext::SetTessSettings(ID3D11Buffer* buffer)
+{
+	m_tracker->SetConstantBuffers(ShaderStage::VS, 2, 1, &buffer);
+	m_tracker->SetConstantBuffers(ShaderStage::DS, 1, 1, &buffer);
+}
+
+void D3DDrawContext::SetPSResource(UINT slot, ID3D11ShaderResourceView* srv)
+{
+	m_tracker->SetShaderResources(ShaderStage::PS, slot, 1, &srv);
+}
+
+void D3DDrawContext::SetDSResource(ID3D11ShaderResourceView* srv)
+{
+	m_tracker->SetShaderResources(ShaderStage::DS, 0, 1, &srv);
+}
+
+void D3DDrawContext::SetObjectData(UINT index, const BasicPerObjectCB& data)
+{
+	if (m_objectData.Size > 0)
+	{
+		RingAllocation element = ConstantRing::GetElement(m_objectData, sizeof(BasicPerObjectCB), index);
+		ConstantRing::Bind(m_tracker, ShaderStage::VS, 1, element);
+		ConstantRing::Bind(m_tracker, ShaderStage::PS, 1, element);
+		return;
+	}
+	m_perObjectCB->Data = data;
+	m_perObjectCB->ApplyChanges(m_context);
+}
+
+void D3DDrawContext::SetBonePalette(const void* palette, UINT size)
+{
+	CopyMemory(m_skinnedCB.Data.BoneTransforms, palette, size);
+	m_skinnedCB.ApplyChanges(m_context);
+}
+
+void D3DDrawContext::Draw(UINT vertexCount, UINT baseVertex)
+{
+	m_tracker->Draw(vertexCount, baseVertex);
+}
+
+void D3DDrawContext::DrawIndexed(UINT indexCount, UINT startIndex, UINT baseVertex)
+{
+	m_tracker->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3DDrawContext::DrawInstanced(UINT vertexCount, UINT instanceCount, UINT baseVertex, UINT startInstance)
+{
+	m_tracker->DrawInstanced(vertexCount, instanceCount, baseVertex, startInstance);
+}
+
+void D3DDrawContext::DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, UINT baseVertex, UINT startInstance)
+{
+	m_tracker->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "RenderQueue.h"
+#include "Common/ConstantBuffer.h"
+#include "Common/DeviceResources.h"
+#include "Common/StateTracker.h"
+
+// Replays render queue packets on the device context. Begin binds the constant buffers and
+// samplers every packet shares, End unbinds the shadow, ssao, reflect and instance material
+// maps and the tessellation stages, as the Render(true) of the components does. With the
+// constant ring of the device resources the object data of all packets is uploaded under one
+// map and each packet binds its range, else each packet maps the per-object buffer.
+
+namespace DXFramework
+{
+	class D3DDrawContext : public DrawContext
+	{
+	public:
+		D3DDrawContext(
+			const std::shared_ptr<DX::DeviceResources>& deviceResources,
+			const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerFrameCB>>& perFrameCB,
+			const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerObjectCB>>& perObjectCB);
+
+		void CreateDeviceDependentResources();
+		void ReleaseDeviceDependentResources();
+
+		virtual void Begin() override;
+		virtual void PrepareObjectData(const DX::BasicPerObjectCB* data, UINT count) override;
+		virtual void End() override;
+		virtual void SetInputLayout(ID3D11InputLayout* layout) override;
+		virtual void SetTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override;
+		virtual void SetVertexBuffer(ID3D11Buffer* buffer, UINT stride) override;
+		virtual void SetInstanceBuffer(ID3D11Buffer* buffer, UINT stride) override;
+		virtual void SetIndexBuffer(ID3D11Buffer* buffer) override;
+		virtual void SetVS(ID3D11VertexShader* vs) override;
+		virtual void SetHS(ID3D11HullShader* hs) override;
+		virtual void SetDS(ID3D11DomainShader* ds) override;
+		virtual void SetPS(ID3D11PixelShader* ps) override;
+		virtual void SetRasterizerState(ID3D11RasterizerState* state) override;
+		virtual void SetTessSettings(ID3D11Buffer* buffer) override;
+		virtual void SetPSResource(UINT slot, ID3D11ShaderResourceView* srv) override;
+		virtual void SetDSResource(ID3D11ShaderResourceView* srv) override;
+		virtual void SetObjectData(UINT index, const DX::BasicPerObjectCB& data) override;
+		virtual void SetBonePalette(const void* palette, UINT size) override;
+		virtual void Draw(UINT vertexCount, UINT baseVertex) override;
+		virtual void DrawIndexed(UINT indexCount, UINT startIndex, UINT baseVertex) override;
+		virtual void DrawInstanced(UINT vertexCount, UINT instanceCount, UINT baseVertex, UINT startInstance) override;
+		virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, UINT baseVertex, UINT startInstance) override;
+
+		// Rasterizer state for packets that leave it null, nullptr for the device default.
+		void SetDefaultRasterizerState(ID3D11RasterizerState* state) { m_defaultRasterizerState = state; }
+
+		// Binds go through the tracker of the device resources, valid after Begin.
+		DX::StateTracker* GetTracker() { return m_tracker; }
+
+	private:
+		std::shared_ptr<DX::DeviceResources> m_deviceResources;
+		std::shared_ptr<DX::ConstantBuffer<DX::BasicPerFrameCB>> m_perFrameCB;
+		std::shared_ptr<DX::ConstantBuffer<DX::BasicPerObjectCB>> m_perObjectCB;
+		DX::ConstantBuffer<DX::SkinnedTransforms> m_skinnedCB;
+		// Object data of the packets in the constant ring, empty without one
+		DX::RingAllocation m_objectData;
+		ID3D11DeviceContext1* m_context;
+		ID3D11RasterizerState* m_defaultRasterizerState;
+		DX::StateTracker* m_tracker;
+	};
+}
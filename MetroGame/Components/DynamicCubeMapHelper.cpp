@@ -12,6 +12,19 @@ using namespace DirectX;
 
 using namespace DX;
 
+// View, projection and eye of a camera into per-frame data.
+static void StoreCamera(BasicPerFrameCB& data, const Camera& camera)
+{
+	XMMATRIX view = camera.View();
+	XMMATRIX proj = camera.Proj();
+	XMMATRIX viewProj = camera.ViewProj();
+	XMStoreFloat4x4(&data.View, XMMatrixTranspose(view));
+	XMStoreFloat4x4(&data.InvView, XMMatrixTranspose(XMMatrixInverse(&XMMatrixDeterminant(view), view)));
+	XMStoreFloat4x4(&data.Proj, XMMatrixTranspose(proj));
+	XMStoreFloat4x4(&data.InvProj, XMMatrixTranspose(XMMatrixInverse(&XMMatrixDeterminant(proj), proj)));
+	XMStoreFloat4x4(&data.ViewProj, XMMatrixTranspose(viewProj));
+	data.EyePosW = camera.GetPosition();
+}
 
 DynamicCubeMapHelper::DynamicCubeMapHelper(
 	const std::shared_ptr<DX::DeviceResources>& deviceResources, 
@@ -56,11 +69,28 @@ void DynamicCubeMapHelper::Render(const std::function<void()>& DrawMap)
 		return;
 
 	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	StateTracker* tracker = m_deviceResources->GetStateTracker();
+
+	// With the constant ring the six face frames go up under one map, each face then binds
+	// its range. Data still follows the face drawn, objects cull and size their textures from
+	// it, and gets the camera frame back afterwards.
+	ConstantRing* ring = m_deviceResources->GetConstantRing();
+	const BasicPerFrameCB cameraFrame = m_perFrameCB->Data;
+	BasicPerFrameCB faceFrames[6];
+	RingAllocation faces;
+	if (ring)
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			faceFrames[i] = cameraFrame;
+			StoreCamera(faceFrames[i], m_cubeMapCamera[i]);
+		}
+		faces = ring->UploadArray(context, faceFrames, sizeof(BasicPerFrameCB), 6);
+	}
 
 	ID3D11RenderTargetView* renderTargets[1];
 	// Generate the cube map.
 	context->RSSetViewports(1, &m_cubeMapViewport);
-	XMMATRIX view, proj, viewProj;
 	for (int i = 0; i < 6; ++i)
 	{
 		// Clear cube map face and depth buffer.
@@ -69,20 +99,23 @@ void DynamicCubeMapHelper::Render(const std::function<void()>& DrawMap)
 
 		// Bind cube map face as render target.
 		renderTargets[0] = m_cubeMapRTV[i].Get();
-		context->OMSetRenderTargets(1, renderTargets, m_cubeMapDSV.Get());
+		tracker->OMSetRenderTargets(1, renderTargets, m_cubeMapDSV.Get());
 
 		// Draw the scene with the exception of the center sphere to this cube map face.
 		// Update per-frame constant buffer according to m_cubeMapCamera[i].
-		view = m_cubeMapCamera[i].View();
-		proj = m_cubeMapCamera[i].Proj();
-		viewProj = m_cubeMapCamera[i].ViewProj();
-		XMStoreFloat4x4(&m_perFrameCB->Data.View, XMMatrixTranspose(view));
-		XMStoreFloat4x4(&m_perFrameCB->Data.InvView, XMMatrixTranspose(XMMatrixInverse(&XMMatrixDeterminant(view), view)));
-		XMStoreFloat4x4(&m_perFrameCB->Data.Proj, XMMatrixTranspose(proj));
-		XMStoreFloat4x4(&m_perFrameCB->Data.InvProj, XMMatrixTranspose(XMMatrixInverse(&XMMatrixDeterminant(proj), proj)));
-		XMStoreFloat4x4(&m_perFrameCB->Data.ViewProj, XMMatrixTranspose(viewProj));
-		m_perFrameCB->Data.EyePosW = m_cubeMapCamera[i].GetPosition();
-		m_perFrameCB->ApplyChanges(context);
+		if (faces.Size > 0)
+		{
+			// Uploads while drawing an earlier face may have restarted the ring
+			if (!ring->IsValid(faces))
+				faces = ring->UploadArray(context, faceFrames, sizeof(BasicPerFrameCB), 6);
+			m_perFrameCB->Data = faceFrames[i];
+			m_perFrameCB->UseAllocation(ring, ConstantRing::GetElement(faces, sizeof(BasicPerFrameCB), i));
+		}
+		else
+		{
+			StoreCamera(m_perFrameCB->Data, m_cubeMapCamera[i]);
+			m_perFrameCB->ApplyChanges(context);
+		}
 
 		DrawMap();
 	}
@@ -92,7 +125,7 @@ void DynamicCubeMapHelper::Render(const std::function<void()>& DrawMap)
 	context->RSSetViewports(1, &viewport);
 
 	renderTargets[0] = m_deviceResources->GetBackBufferRenderTargetView();
-	context->OMSetRenderTargets(1, renderTargets, m_deviceResources->GetDepthStencilView());
+	tracker->OMSetRenderTargets(1, renderTargets, m_deviceResources->GetDepthStencilView());
 
 	// Have hardware generate lower mipmap levels of cube map.
 	context->GenerateMips(m_cubeMapSRV.Get());
@@ -101,16 +134,16 @@ void DynamicCubeMapHelper::Render(const std::function<void()>& DrawMap)
 	context->ClearDepthStencilView(m_deviceResources->GetDepthStencilView(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 
 	// Recovery per-frame constant buffer according to m_camera.
-	view = m_camera->View();
-	proj = m_camera->Proj();
-	viewProj = m_camera->ViewProj();
-	XMStoreFloat4x4(&m_perFrameCB->Data.View, XMMatrixTranspose(view));
-	XMStoreFloat4x4(&m_perFrameCB->Data.InvView, XMMatrixTranspose(XMMatrixInverse(&XMMatrixDeterminant(view), view)));
-	XMStoreFloat4x4(&m_perFrameCB->Data.Proj, XMMatrixTranspose(proj));
-	XMStoreFloat4x4(&m_perFrameCB->Data.InvProj, XMMatrixTranspose(XMMatrixInverse(&XMMatrixDeterminant(proj), proj)));
-	XMStoreFloat4x4(&m_perFrameCB->Data.ViewProj, XMMatrixTranspose(viewProj));
-	m_perFrameCB->Data.EyePosW = m_camera->GetPosition();
-	m_perFrameCB->ApplyChanges(context);
+	if (faces.Size > 0)
+	{
+		m_perFrameCB->Data = cameraFrame;
+		m_perFrameCB->UseAllocation(nullptr, RingAllocation());
+	}
+	else
+	{
+		StoreCamera(m_perFrameCB->Data, *m_camera);
+		m_perFrameCB->ApplyChanges(context);
+	}
 }
 
 void DynamicCubeMapHelper::ReleaseDeviceDependentResources()
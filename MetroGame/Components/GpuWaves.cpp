@@ -295,6 +295,7 @@ void GpuWaves::Render()
 
 	// recover default blend state
 	context->OMSetBlendState(nullptr, blendFactor, 0xffffffff);
+	m_deviceResources->GetStateTracker()->Invalidate();
 }
 
 void GpuWaves::ReleaseDeviceDependentResources()
@@ -324,29 +325,21 @@ void GpuWaves::ReleaseDeviceDependentResources()
 
 void GpuWaves::BuildWaveGeometryBuffers()
 {
-	GeometryGenerator::MeshData grid;
-	GeometryGenerator geoGen;
-
 	float width = m_numCols*m_spatialStep;
 	float depth = m_numRows*m_spatialStep;
 
-	geoGen.CreateGrid(width, depth, m_numRows, m_numCols, grid);
-
-	m_indexCount = grid.Indices.size();
-
-	// Extract the vertex elements we are interested.
+	// Generate the grid straight into the vertex and index buffers, without tangents.
+	// The flat grid already has the up normal of the calm water.
+	std::vector<Basic32> vertices(GeometryGenerator::GetGridVertexCount(m_numRows, m_numCols));
+	std::vector<UINT> indices(GeometryGenerator::GetGridIndexCount(m_numRows, m_numCols));
+	GeometryGenerator geoGen;
+	geoGen.CreateGrid<PosNormalTexPolicy<Basic32>>(width, depth, m_numRows, m_numCols, vertices.data(), indices.data());
 
-	std::vector<Basic32> vertices(grid.Vertices.size());
-	for (UINT i = 0; i < grid.Vertices.size(); ++i)
-	{
-		vertices[i].Pos = grid.Vertices[i].Position;
-		vertices[i].Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
-		vertices[i].Tex = grid.Vertices[i].TexC;
-	}
+	m_indexCount = indices.size();
 
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Basic32) * grid.Vertices.size();
+	vbd.ByteWidth = sizeof(Basic32) * vertices.size();
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -362,7 +355,7 @@ void GpuWaves::BuildWaveGeometryBuffers()
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
 	D3D11_SUBRESOURCE_DATA iinitData;
-	iinitData.pSysMem = &grid.Indices[0];
+	iinitData.pSysMem = &indices[0];
 	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&ibd, &iinitData, m_wavesIB.GetAddressOf()));
 }
 
@@ -0,0 +1,73 @@
+#include "pch.h"
+#include "InstanceCuller.h"
+#include "Common/MathHelper.h"
+
+using namespace DXFramework;
+using namespace DirectX;
+
+using namespace DX;
+
+// boxStride is 0 when every instance uses the same box.
+static UINT CullBoxes(const BoundingBox* boxes, UINT boxStride, const XMFLOAT4X4* worlds, UINT count,
+	const XMFLOAT4 planes[6], UINT8* visible)
+{
+	UINT visibleCount = 0;
+	for (UINT base = 0; base < count; base += 4)
+	{
+		// Transform four boxes. The last group repeats its final instance.
+		XMMATRIX centers, extents;
+		for (UINT lane = 0; lane < 4; ++lane)
+		{
+			UINT i = base + MathHelper::Min(lane, count - 1 - base);
+			const BoundingBox& box = boxes[i * boxStride];
+			XMMATRIX W = XMLoadFloat4x4(&worlds[i]);
+			centers.r[lane] = XMVector3Transform(XMLoadFloat3(&box.Center), W);
+			XMVECTOR e = XMVectorMultiply(XMVectorAbs(W.r[0]), XMVectorReplicate(box.Extents.x));
+			e = XMVectorMultiplyAdd(XMVectorAbs(W.r[1]), XMVectorReplicate(box.Extents.y), e);
+			extents.r[lane] = XMVectorMultiplyAdd(XMVectorAbs(W.r[2]), XMVectorReplicate(box.Extents.z), e);
+		}
+		centers = XMMatrixTranspose(centers);
+		extents = XMMatrixTranspose(extents);
+
+		// A box is outside when it lies fully behind any plane: n.c + d < -|n|.e
+		XMVECTOR outside = XMVectorFalseInt();
+		for (UINT p = 0; p < 6; ++p)
+		{
+			XMVECTOR plane = XMLoadFloat4(&planes[p]);
+			XMVECTOR nx = XMVectorSplatX(plane), ny = XMVectorSplatY(plane), nz = XMVectorSplatZ(plane);
+			XMVECTOR dist = XMVectorMultiplyAdd(nx, centers.r[0], XMVectorMultiplyAdd(ny, centers.r[1], XMVectorMultiplyAdd(nz, centers.r[2], XMVectorSplatW(plane))));
+			XMVECTOR radius = XMVectorMultiplyAdd(XMVectorAbs(nx), extents.r[0], XMVectorMultiplyAdd(XMVectorAbs(ny), extents.r[1], XMVectorMultiply(XMVectorAbs(nz), extents.r[2])));
+			outside = XMVectorOrInt(outside, XMVectorLess(dist, XMVectorNegate(radius)));
+		}
+
+		XMUINT4 mask;
+		XMStoreUInt4(&mask, outside);
+		UINT lanes = MathHelper::Min(4u, count - base);
+		const UINT* flags = &mask.x;
+		for (UINT lane = 0; lane < lanes; ++lane)
+		{
+			visible[base + lane] = flags[lane] == 0;
+			visibleCount += visible[base + lane];
+		}
+	}
+	return visibleCount;
+}
+
+void InstanceCuller::ExtractPlanes(const BasicPerFrameCB& perFrame, XMFLOAT4 planes[6])
+{
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, XMMatrixTranspose(XMLoadFloat4x4(&perFrame.ViewProj)));
+	ExtractFrustumPlanes(planes, viewProj);
+}
+
+UINT InstanceCuller::Cull(const BoundingBox& localBox, const XMFLOAT4X4* worlds, UINT count,
+	const XMFLOAT4 planes[6], UINT8* visible)
+{
+	return CullBoxes(&localBox, 0, worlds, count, planes, visible);
+}
+
+UINT InstanceCuller::Cull(const BoundingBox* localBoxes, const XMFLOAT4X4* worlds, UINT count,
+	const XMFLOAT4 planes[6], UINT8* visible)
+{
+	return CullBoxes(localBoxes, 1, worlds, count, planes, visible);
+}
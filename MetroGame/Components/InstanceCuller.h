@@ -0,0 +1,44 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include "Common/ConstantBufferLayouts.h"
+
+// Batched view frustum culling of instance bounds. Each pass transforms the local boxes
+// by the instance worlds and tests them against the six frustum planes, four instances
+// per iteration, and leaves one visibility flag per instance for the draw loop. Only
+// DirectXMath and the constant buffer layouts are needed, so it builds without a device.
+
+namespace DXFramework
+{
+	enum class CullPass
+	{
+		Render,
+		Depth,
+		NorDep,
+		Count
+	};
+
+	struct CullStats
+	{
+		CullStats() : Tested(0), Visible(0) {}
+
+		UINT Tested;
+		UINT Visible;
+	};
+
+	class InstanceCuller
+	{
+	public:
+		// Frustum of the pass being drawn. The per frame buffer holds the transposed ViewProj,
+		// which is the light's during depth passes.
+		static void ExtractPlanes(const DX::BasicPerFrameCB& perFrame, DirectX::XMFLOAT4 planes[6]);
+
+		// All instances share localBox. Returns the number of visible instances.
+		static UINT Cull(const DirectX::BoundingBox& localBox, const DirectX::XMFLOAT4X4* worlds, UINT count,
+			const DirectX::XMFLOAT4 planes[6], UINT8* visible);
+		// One local box per instance.
+		static UINT Cull(const DirectX::BoundingBox* localBoxes, const DirectX::XMFLOAT4X4* worlds, UINT count,
+			const DirectX::XMFLOAT4 planes[6], UINT8* visible);
+	};
+}
@@ -160,6 +160,7 @@ void MapDisplayer::Render()
 		ID3D11ShaderResourceView* nullSRV[1] = { nullptr };
 		context->PSSetShaderResources(0, 1, nullSRV);
 	}
+	m_deviceResources->GetStateTracker()->Invalidate();
 }
 
 void MapDisplayer::ReleaseDeviceDependentResources()
@@ -186,24 +187,15 @@ void MapDisplayer::ReleaseDeviceDependentResources()
 
 void MapDisplayer::BuildQuadGeometryBuffers()
 {
-	GeometryGenerator::MeshData quad;
-
+	// Generate the quad straight into the vertex and index buffers, without tangents.
+	std::vector<Basic32> vertices(GeometryGenerator::GetFullscreenQuadVertexCount());
+	std::vector<UINT> indices(GeometryGenerator::GetFullscreenQuadIndexCount());
 	GeometryGenerator geoGen;
-	geoGen.CreateFullscreenQuad(quad);
-
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
-	std::vector<Basic32> vertices(quad.Vertices.size());
-	for (UINT i = 0; i < quad.Vertices.size(); ++i)
-	{
-		vertices[i].Pos = quad.Vertices[i].Position;
-		vertices[i].Normal = quad.Vertices[i].Normal;
-		vertices[i].Tex = quad.Vertices[i].TexC;
-	}
+	geoGen.CreateFullscreenQuad<PosNormalTexPolicy<Basic32>>(vertices.data(), indices.data());
 
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Basic32) * quad.Vertices.size();
+	vbd.ByteWidth = sizeof(Basic32) * vertices.size();
 	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vbd.CPUAccessFlags = 0;
 	vbd.MiscFlags = 0;
@@ -211,15 +203,14 @@ void MapDisplayer::BuildQuadGeometryBuffers()
 	vinitData.pSysMem = &vertices[0];
 	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vbd, &vinitData, m_quadVB.GetAddressOf()));
 
-	// Pack the indices of all the meshes into one index buffer.
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(UINT) * quad.Indices.size();
+	ibd.ByteWidth = sizeof(UINT) * indices.size();
 	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	ibd.CPUAccessFlags = 0;
 	ibd.MiscFlags = 0;
 	D3D11_SUBRESOURCE_DATA iinitData;
-	iinitData.pSysMem = &quad.Indices[0];
+	iinitData.pSysMem = &indices[0];
 	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&ibd, &iinitData, m_quadIB.GetAddressOf()));
 }
 
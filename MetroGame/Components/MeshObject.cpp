@@ -2,8 +2,10 @@
 #include "MeshObject.h"
 #include <algorithm>
 #include <vector>
+#include <cfloat>
 #include "Common/DirectXHelper.h"
 #include "Common/MathHelper.h"
+#include "Common/ParallelChunks.h"
 #include "Common/ShaderChangement.h"
 #include "Common/RenderStateMgr.h"
 
@@ -13,11 +15,16 @@ using namespace DirectX;
 
 using namespace DX;
 
+// Instances grabbed per step by an update worker, and the fewest active instances worth splitting.
+static const UINT UpdateChunkSize = 8;
+static const UINT ParallelUpdateThreshold = 32;
+
 bool MeshObject::m_resetFlag = false;
 DX::ConstantBuffer<DX::SkinnedTransforms> MeshObject::m_skinnedCB;
 
 MeshObject::~MeshObject()
 {
+	DetachFromBvh();
 	if (!m_resetFlag)
 	{
 		m_resetFlag = true;
@@ -30,7 +37,8 @@ MeshObject::MeshObject(
 	const std::shared_ptr<DX::DeviceResources>& deviceResources,
 	const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerFrameCB>>& perFrameCB,
 	const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerObjectCB>>& perObjectCB)
-	: m_loadingComplete(false), m_initialized(false),
+	: m_loadingComplete(false), m_initialized(false), m_paletteStride(0), m_dualQuaternionStride(0), m_dualQuaternion(false), m_updateWorkerCount(1),
+	m_cullEnabled(true), m_bvh(nullptr), m_streamTextures(false),
 	m_deviceResources(deviceResources), m_perFrameCB(perFrameCB), m_perObjectCB(perObjectCB)
 {
 }
@@ -76,16 +84,47 @@ void MeshObject::Initialize(MeshObjectData* data, const MeshFeatureConfigure& fe
 
 	if (m_object->Skinned)
 	{
-		m_timePositions.resize(m_object->Worlds.size());
-		m_timePositions.assign(m_timePositions.size(), -1.0f);
-		m_finalTransforms.resize(m_object->Worlds.size());
+		m_animators.assign(m_object->Worlds.size(), AnimationController());
+		m_animationLod.Initialize(m_object->Worlds.size());
+		m_skinnedBounds.Build(m_object->VertexDataSkinned, m_object->SkinInfo.GetBoneCount());
+		m_animatedBounds.resize(m_object->Worlds.size());
+		m_boundsDirty.assign(m_object->Worlds.size(), 1);
+		m_poseCache.Initialize(&m_object->SkinInfo);
+		m_paletteStride = m_object->SkinInfo.GetBoneCount();
+		size_t paletteBytes = sizeof(XMFLOAT4X4) * m_paletteStride * m_object->Worlds.size();
+		m_finalTransforms.reset((XMFLOAT4X4*)_aligned_malloc(paletteBytes, 64));
+		if (!m_finalTransforms)
+			throw ref new Platform::OutOfMemoryException();
+		m_paletteSlots.assign(m_object->Worlds.size(), RingSlot());
+		m_dualQuaternion = m_feature.DualQuaternion && !m_object->SkinInfo.HasScale();
+		if (m_feature.DualQuaternion && !m_dualQuaternion)
+			OutputDebugString(L"The skeleton has scale, skinning with matrices instead of dual quaternions!");
+		if (m_dualQuaternion)
+		{
+			// Two bones per cache line, the stride rounded up to whole lines
+			m_dualQuaternionStride = ((m_paletteStride + 1) & ~1u) * 2;
+			m_dualQuaternions.reset((XMFLOAT4*)_aligned_malloc(sizeof(XMFLOAT4) * m_dualQuaternionStride * m_object->Worlds.size(), 64));
+			if (!m_dualQuaternions)
+				throw ref new Platform::OutOfMemoryException();
+		}
+		m_paletteStale.assign(m_object->Worlds.size(), 0);
+		m_activeInstances.reserve(m_object->Worlds.size());
+		m_poseScratch.resize(m_object->SkinInfo.GetPoseScratchSize());
 		for (UINT i = 0; i < m_object->Worlds.size(); ++i)
 		{
-			m_finalTransforms[i].resize(m_object->SkinInfo.GetBoneCount());
-			m_object->SkinInfo.GetFinalTransforms(m_object->ClipNames[i], 0.0f, m_finalTransforms[i]);
+			m_animators[i].SetClip(m_object->SkinInfo.GetClipIndex(m_object->ClipNames[i]));
+			m_object->SkinInfo.GetFinalTransforms(m_animators[i].GetClip(), 0.0f, GetPalette(i), &m_poseScratch[0]);
+			PaletteChanged(i);
 		}
+		SetUpdateWorkerCount(m_updateWorkerCount);
+		SetAnimationLod(m_animationLod.GetSettings());
 	}
 	
+	m_visible.assign(m_object->Worlds.size(), 1);
+	m_transforms.Initialize(m_object->Worlds.data(), m_object->Worlds.size());
+	if (m_object->Skinned)
+		m_cullBoxes.resize(m_object->Worlds.size());
+
 	m_generateMips = generateMips;
 	m_initialized = true;
 }
@@ -123,19 +162,214 @@ void MeshObject::Update(float dt)
 	if (!m_object->Skinned)
 		return;
 
-	for (UINT i = 0; i < m_finalTransforms.size(); ++i)
+	// Advance the clocks serially; the pose evaluations below are independent of each other.
+	m_poseCache.BeginFrame();
+	m_activeInstances.clear();
+	for (UINT i = 0; i < m_animators.size(); ++i)
 	{
-		if (m_timePositions[i] < 0)
-			continue;
-		m_timePositions[i] += dt;
-		// Loop animation
-		if (m_timePositions[i] > m_object->SkinInfo.GetClipEndTime(m_object->ClipNames[i]))
-			if (m_feature.Loop)
-				m_timePositions[i] = 0.0f;
-			else
-				m_timePositions[i] = -1.0f;
-		m_object->SkinInfo.GetFinalTransforms(m_object->ClipNames[i], m_timePositions[i], m_finalTransforms[i]);
-	}	
+		if (m_animators[i].Update(dt, m_object->SkinInfo))
+			m_activeInstances.push_back(i);
+	}
+
+	if (m_animationLod.IsEnabled())
+	{
+		m_animationLod.Select(m_activeInstances, m_paletteStride,
+			[this](UINT i) { return GetTransBoundingSphere(i); }, m_extrapolatedInstances);
+	}
+
+	if (m_updateWorkerCount > 1 && m_activeInstances.size() >= ParallelUpdateThreshold)
+		UpdateParallel();
+	else
+	{
+		for (UINT i : m_activeInstances)
+			EvaluateInstance(i, &m_poseScratch[0]);
+	}
+
+	for (UINT i : m_extrapolatedInstances)
+		ExtrapolateInstance(i);
+
+	if (m_bvh)
+	{
+		for (UINT i = 0; i < m_boundsDirty.size(); ++i)
+		{
+			if (m_boundsDirty[i])
+				m_bvh->Update(m_bvhIds[i], GetTransBoundingBox(i));
+		}
+	}
+}
+
+void MeshObject::ExtrapolateInstance(UINT i)
+{
+	XMFLOAT4X4* palette = GetMatrixPalette(i);
+	const XMFLOAT4X4* velocity = GetPaletteVelocity(i);
+	for (UINT b = 0; b < m_paletteStride; ++b)
+	{
+		// Only the first three rows; the last row of the transposed affine transform is constant.
+		for (UINT r = 0; r < 3; ++r)
+		{
+			XMVECTOR v = XMVectorAdd(XMLoadFloat4((const XMFLOAT4*)palette[b].m[r]), XMLoadFloat4((const XMFLOAT4*)velocity[b].m[r]));
+			XMStoreFloat4((XMFLOAT4*)palette[b].m[r], v);
+		}
+	}
+	++m_animationLod.GetInstance(i).Extrapolated;
+	PaletteChanged(i);
+}
+
+void MeshObject::PaletteChanged(UINT i)
+{
+	if (m_dualQuaternion)
+		SkinnedData::GetDualQuaternions(GetPalette(i), m_paletteStride, GetDualQuaternions(i));
+	m_paletteStale[i] = 0;
+	m_boundsDirty[i] = 1;
+	m_paletteSlots[i].Dirty = true;
+}
+
+// Dual quaternions evaluated straight from the pose leave the matrix palette behind, it is
+// built from them once something reads it.
+XMFLOAT4X4* MeshObject::GetMatrixPalette(UINT i)
+{
+	if (m_paletteStale[i])
+	{
+		SkinnedData::GetFinalTransforms(GetDualQuaternions(i), m_paletteStride, GetPalette(i));
+		m_paletteStale[i] = 0;
+	}
+	return GetPalette(i);
+}
+
+const void* MeshObject::GetSkinningPalette(UINT i)
+{
+	if (m_dualQuaternion)
+		return GetDualQuaternions(i);
+	return GetPalette(i);
+}
+
+UINT MeshObject::GetSkinningPaletteSize()const
+{
+	return m_dualQuaternion ? sizeof(XMFLOAT4) * 2 * m_paletteStride : sizeof(XMFLOAT4X4) * m_paletteStride;
+}
+
+void MeshObject::BindSkinningPalette(ID3D11DeviceContext* context, StateTracker* tracker, UINT i)
+{
+	ConstantRing* ring = m_deviceResources->GetConstantRing();
+	if (ring)
+	{
+		// Passes after the first reuse the palette uploaded this frame
+		RingAllocation palette = ring->UploadIfDirty(context, GetSkinningPalette(i), GetSkinningPaletteSize(), m_paletteSlots[i]);
+		if (palette.Size > 0)
+		{
+			ConstantRing::Bind(tracker, ShaderStage::VS, 3, palette);
+			return;
+		}
+	}
+	CopyMemory(m_skinnedCB.Data.BoneTransforms, GetSkinningPalette(i), GetSkinningPaletteSize());
+	m_skinnedCB.ApplyChanges(context);
+	ID3D11Buffer* skinned = m_skinnedCB.GetBuffer();
+	tracker->SetConstantBuffers(ShaderStage::VS, 3, 1, &skinned);
+}
+
+void MeshObject::EvaluateInstance(UINT i, BonePosePacket* poseScratch)
+{
+	const AnimationController& animator = m_animators[i];
+	AnimationInstanceLod& lod = m_animationLod.GetInstance(i);
+	const BoneLodMap& boneLod = m_animationLod.GetBoneLod();
+	bool trackVelocity = m_animationLod.TracksVelocity();
+
+	// Dual quaternions come from the rotations and translations of the pose, no matrix is
+	// built. Extrapolation steps the matrices and keeps the matrix path.
+	if (m_dualQuaternion && !trackVelocity)
+	{
+		const BonePosePacket* pose = poseScratch;
+		if (animator.IsSimple())
+			pose = m_poseCache.GetPose(animator.GetClip(), animator.GetTimePos());
+		else
+			animator.Evaluate(m_poseCache, m_object->SkinInfo.GetPoseScratchSize(), poseScratch);
+		XMFLOAT4* dualQuaternions = GetDualQuaternions(i);
+		m_object->SkinInfo.GetDualQuaternions(pose, dualQuaternions);
+		if (lod.Reduced)
+		{
+			for (UINT bone : boneLod.GetFoldedBones())
+			{
+				UINT proxy = boneLod.GetProxy(bone);
+				dualQuaternions[bone * 2] = dualQuaternions[proxy * 2];
+				dualQuaternions[bone * 2 + 1] = dualQuaternions[proxy * 2 + 1];
+			}
+		}
+		lod.LastTimePos = animator.GetTimePos();
+		lod.FramesSinceUpdate = 0;
+		lod.Extrapolated = 0;
+		m_paletteStale[i] = 1;
+		m_boundsDirty[i] = 1;
+		m_paletteSlots[i].Dirty = true;
+		return;
+	}
+
+	XMFLOAT4X4* palette = GetMatrixPalette(i);
+
+	// Recover the last evaluated palette into the velocity slot by undoing the extrapolation.
+	XMFLOAT4X4* velocity = trackVelocity ? GetPaletteVelocity(i) : nullptr;
+	if (trackVelocity)
+	{
+		float undo = lod.HasVelocity ? -(float)lod.Extrapolated : 0.0f;
+		for (UINT b = 0; b < m_paletteStride; ++b)
+		{
+			for (UINT r = 0; r < 3; ++r)
+			{
+				XMVECTOR v = XMVectorMultiplyAdd(XMLoadFloat4((const XMFLOAT4*)velocity[b].m[r]), XMVectorReplicate(undo),
+					XMLoadFloat4((const XMFLOAT4*)palette[b].m[r]));
+				XMStoreFloat4((XMFLOAT4*)velocity[b].m[r], v);
+			}
+		}
+	}
+
+	if (animator.IsSimple() && !lod.Reduced)
+	{
+		const XMFLOAT4X4* cached = m_poseCache.GetFinalTransforms(animator.GetClip(), animator.GetTimePos());
+		CopyMemory(palette, cached, sizeof(XMFLOAT4X4) * m_paletteStride);
+	}
+	else
+	{
+		animator.Evaluate(m_poseCache, m_object->SkinInfo.GetPoseScratchSize(), poseScratch);
+		m_object->SkinInfo.GetFinalTransforms(poseScratch, palette, lod.Reduced ? &boneLod : nullptr);
+	}
+
+	if (trackVelocity)
+	{
+		// A clock that went backwards wrapped or switched clips; the difference means nothing then.
+		lod.HasVelocity = animator.GetTimePos() >= lod.LastTimePos;
+		XMVECTOR scale = XMVectorReplicate(1.0f / MathHelper::Max(lod.FramesSinceUpdate, 1u));
+		for (UINT b = 0; b < m_paletteStride; ++b)
+		{
+			for (UINT r = 0; r < 3; ++r)
+			{
+				XMVECTOR v = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4((const XMFLOAT4*)palette[b].m[r]),
+					XMLoadFloat4((const XMFLOAT4*)velocity[b].m[r])), scale);
+				XMStoreFloat4((XMFLOAT4*)velocity[b].m[r], v);
+			}
+		}
+	}
+	lod.LastTimePos = animator.GetTimePos();
+	lod.FramesSinceUpdate = 0;
+	lod.Extrapolated = 0;
+	PaletteChanged(i);
+}
+
+void MeshObject::UpdateParallel()
+{
+	ParallelForChunks(m_activeInstances.size(), m_updateWorkerCount, UpdateChunkSize, [this](UINT worker, UINT k)
+	{
+		EvaluateInstance(m_activeInstances[k], &m_workerPoseScratch[worker][0]);
+	});
+}
+
+void MeshObject::SetUpdateWorkerCount(UINT count)
+{
+	m_updateWorkerCount = MathHelper::Max(count, 1u);
+	if (!m_object || !m_object->Skinned)
+		return;
+
+	m_workerPoseScratch.resize(m_updateWorkerCount);
+	for (auto& scratch : m_workerPoseScratch)
+		scratch.resize(m_object->SkinInfo.GetPoseScratchSize());
 }
 
 void MeshObject::Render(bool recover /* = false */)
@@ -144,53 +378,48 @@ void MeshObject::Render(bool recover /* = false */)
 		return;
 
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	ID3D11DeviceContext1* context = m_deviceResources->GetD3DDeviceContext();
+	StateTracker* tracker = m_deviceResources->GetStateTracker();
+	tracker->SetComponent("MeshObject");
 	// Set IA stage.
 	UINT stride = m_object->Skinned ? sizeof(PosNormalTexTanSkinned) : sizeof(PosNormalTexTan);
 	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	}
+	tracker->IASetInputLayout(m_inputLayout.Get());
+	ShaderChangement::InputLayout = m_inputLayout.Get();
+	tracker->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
+	tracker->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
+	tracker->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
 
-	ID3D11Buffer* cbuffers0[2] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer() };
-	ID3D11Buffer* cbuffers1[1] = { m_skinnedCB.GetBuffer() };
+	ID3D11Buffer* perObject = m_perObjectCB->GetBuffer();
 	ID3D11SamplerState* samplers[2] = { renderStateMgr->LinearSam(), renderStateMgr->ShadowSam() };
 	ID3D11ShaderResourceView* srvs[3] = { m_depthMapSRV.Get(), m_ssaoMapSRV.Get(), m_reflectMapSRV.Get() };
 
-	// Set constant buffers
-	context->VSSetConstantBuffers(0, 2, cbuffers0);
-	if (m_object->Skinned)
-		context->VSSetConstantBuffers(3, 1, cbuffers1);
-	context->PSSetConstantBuffers(0, 2, cbuffers0);
+	// Set constant buffers, the per-frame one may be a range of the constant ring
+	m_perFrameCB->Bind(tracker, ShaderStage::VS, 0);
+	m_perFrameCB->Bind(tracker, ShaderStage::PS, 0);
+	tracker->SetConstantBuffers(ShaderStage::VS, 1, 1, &perObject);
+	tracker->SetConstantBuffers(ShaderStage::PS, 1, 1, &perObject);
 
 	// Set srvs & samplers
-	context->PSSetShaderResources(2, 3, srvs);
-	context->PSSetSamplers(0, 2, samplers);
+	tracker->SetShaderResources(ShaderStage::PS, 2, 3, srvs);
+	tracker->SetSamplers(ShaderStage::PS, 0, 2, samplers);
 
+	m_transforms.Update();
+	CullInstances(CullPass::Render);
+	UpdateStreamedTextures();
 	for (UINT i = 0; i < m_object->Worlds.size(); ++i)
 	{
+		if (!m_visible[i])
+			continue;
+
 		// Update constant buffers
-		XMMATRIX world = XMLoadFloat4x4(&m_object->Worlds[i]);
-		XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-		XMStoreFloat4x4(&m_perObjectCB->Data.World, XMMatrixTranspose(world));
-		XMStoreFloat4x4(&m_perObjectCB->Data.WorldInvTranspose, XMMatrixTranspose(worldInvTranspose));
+		m_perObjectCB->Data.World = m_transforms.GetWorldT(i);
+		m_perObjectCB->Data.WorldInvTranspose = m_transforms.GetWorldInvTransposeT(i);
 		XMStoreFloat4x4(&m_perObjectCB->Data.TexTransform, XMMatrixIdentity());
 		if (m_object->Skinned)
-		{
-			for (UINT j = 0; j < m_object->SkinInfo.GetBoneCount(); ++j)
-				m_skinnedCB.Data.BoneTransforms[j] = m_finalTransforms[i][j];
-			m_skinnedCB.ApplyChanges(context);
-		}
+			BindSkinningPalette(context, tracker, i);
 
 		// Iterate over each subSet. Each subSet is corespondent to one material of the same index.
 		for (UINT j = 0; j < m_object->Subsets.size(); ++j)
@@ -203,45 +432,33 @@ void MeshObject::Render(bool recover /* = false */)
 			m_perObjectCB->ApplyChanges(context);
 			// Bind srv
 			ID3D11ShaderResourceView* srvs[2] = { m_diffuseMapSRV[index].Get(), m_norMapSRV[index].Get() };
-			context->PSSetShaderResources(0, 2, srvs);
+			tracker->SetShaderResources(ShaderStage::PS, 0, 2, srvs);
 			// Bind shaders
 			if (material.Effect != EffectType::Normal)
 			{
-				if (ShaderChangement::VS != m_meshVS.Get())
-				{
-					context->VSSetShader(m_meshVS.Get(), nullptr, 0);
-					ShaderChangement::VS = m_meshVS.Get();
-				}
+				tracker->VSSetShader(m_meshVS.Get());
+				ShaderChangement::VS = m_meshVS.Get();
 			}
 			else
 			{
-				if (ShaderChangement::VS != m_meshVSNormal.Get())
-				{
-					context->VSSetShader(m_meshVSNormal.Get(), nullptr, 0);
-					ShaderChangement::VS = m_meshVSNormal.Get();
-				}
-			}
-			if (ShaderChangement::PS != m_meshPS[index].Get())
-			{
-				context->PSSetShader(m_meshPS[index].Get(), nullptr, 0);
-				ShaderChangement::PS = m_meshPS[index].Get();
+				tracker->VSSetShader(m_meshVSNormal.Get());
+				ShaderChangement::VS = m_meshVSNormal.Get();
 			}
+			tracker->PSSetShader(m_meshPS[index].Get());
+			ShaderChangement::PS = m_meshPS[index].Get();
 
 			if (m_feature.AlphaClip)
 			{
-				if (ShaderChangement::RSS != renderStateMgr->NoCullRS())
-				{
-					context->RSSetState(renderStateMgr->NoCullRS());
-					ShaderChangement::RSS = renderStateMgr->NoCullRS();
-				}
+				tracker->RSSetState(renderStateMgr->NoCullRS());
+				ShaderChangement::RSS = renderStateMgr->NoCullRS();
 			}
-			else if(ShaderChangement::RSS != nullptr)
+			else
 			{
-				context->RSSetState(nullptr);
+				tracker->RSSetState(nullptr);
 				ShaderChangement::RSS = nullptr;
 			}
 
-			context->DrawIndexed(item.IndexCount, item.IndexStart, item.VertexBase);
+			tracker->DrawIndexed(item.IndexCount, item.IndexStart, item.VertexBase);
 		}
 	}
 
@@ -249,12 +466,65 @@ void MeshObject::Render(bool recover /* = false */)
 	if (recover)
 	{
 		ID3D11ShaderResourceView* nullSRV[3] = { nullptr, nullptr, nullptr };
-		context->PSSetShaderResources(2, 3, nullSRV);
+		tracker->SetShaderResources(ShaderStage::PS, 2, 3, nullSRV);
+
+		tracker->RSSetState(nullptr);
+		ShaderChangement::RSS = nullptr;
+	}
+}
+
+void MeshObject::Submit(RenderQueue& queue)
+{
+	if (!m_loadingComplete)
+		return;
+
+	auto renderStateMgr = RenderStateMgr::Instance();
+	m_transforms.Update();
+	CullInstances(CullPass::Render);
+	UpdateStreamedTextures();
+
+	DrawPacket packet;
+	packet.InputLayout = m_inputLayout.Get();
+	packet.VertexBuffer = m_objectVB.Get();
+	packet.Stride = m_object->Skinned ? sizeof(PosNormalTexTanSkinned) : sizeof(PosNormalTexTan);
+	packet.IndexBuffer = m_objectIB.Get();
+	packet.RasterizerState = m_feature.AlphaClip ? renderStateMgr->NoCullRS() : nullptr;
+	packet.PSResources[2] = m_depthMapSRV.Get();
+	packet.PSResources[3] = m_ssaoMapSRV.Get();
+	packet.PSResources[4] = m_reflectMapSRV.Get();
+	if (m_object->Skinned)
+		packet.BonePaletteSize = GetSkinningPaletteSize();
+	RenderPass pass = m_feature.AlphaClip ? RenderPass::AlphaTested : RenderPass::Opaque;
 
-		if (ShaderChangement::RSS != nullptr)
+	BasicPerObjectCB objectData;
+	XMStoreFloat4x4(&objectData.TexTransform, XMMatrixIdentity());
+	for (UINT i = 0; i < m_object->Worlds.size(); ++i)
+	{
+		if (!m_visible[i])
+			continue;
+
+		objectData.World = m_transforms.GetWorldT(i);
+		objectData.WorldInvTranspose = m_transforms.GetWorldInvTransposeT(i);
+		if (m_object->Skinned)
+			packet.BonePalette = GetSkinningPalette(i);
+		XMFLOAT3 center;
+		XMStoreFloat3(&center, XMVector3Transform(XMLoadFloat3(&m_boundingBox.Center), XMLoadFloat4x4(&m_transforms.GetWorld(i))));
+
+		// One packet per subset, each subset uses the material of the same index
+		for (UINT j = 0; j < m_object->Subsets.size(); ++j)
 		{
-			context->RSSetState(nullptr);
-			ShaderChangement::RSS = nullptr;
+			Subset& item = m_object->Subsets[j];
+			UINT index = item.MtlIndex;
+			X3dMaterial& material = m_object->Material[index];
+			objectData.Mat = material.Mat;
+			packet.VS = material.Effect != EffectType::Normal ? m_meshVS.Get() : m_meshVSNormal.Get();
+			packet.PS = m_meshPS[index].Get();
+			packet.PSResources[0] = m_diffuseMapSRV[index].Get();
+			packet.PSResources[1] = m_norMapSRV[index].Get();
+			packet.Count = item.IndexCount;
+			packet.Start = item.IndexStart;
+			packet.Base = item.VertexBase;
+			queue.Add(packet, objectData, pass, &material, center);
 		}
 	}
 }
@@ -265,70 +535,58 @@ void MeshObject::DepthRender(bool recover /* = false */)
 		return;
 
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	ID3D11DeviceContext1* context = m_deviceResources->GetD3DDeviceContext();
+	StateTracker* tracker = m_deviceResources->GetStateTracker();
+	tracker->SetComponent("MeshObject");
 	// Set IA stage
 	UINT stride = m_object->Skinned ? sizeof(PosNormalTexTanSkinned) : sizeof(PosNormalTexTan);
 	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	}
+	tracker->IASetInputLayout(m_inputLayout.Get());
+	ShaderChangement::InputLayout = m_inputLayout.Get();
+	tracker->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
+	tracker->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
+	tracker->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
 
-	ID3D11Buffer* cbuffers0[2] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer() };
-	ID3D11Buffer* cbuffers1[1] = { m_skinnedCB.GetBuffer() };
+	ID3D11Buffer* perObject = m_perObjectCB->GetBuffer();
 	ID3D11SamplerState* samplers[1] = { renderStateMgr->LinearSam() };
 
-	// Set constant buffers
-	context->VSSetConstantBuffers(0, 2, cbuffers0);
-	if (m_object->Skinned)
-		context->VSSetConstantBuffers(3, 1, cbuffers1);
-	context->PSSetConstantBuffers(0, 2, cbuffers0);
+	// Set constant buffers, the per-frame one may be a range of the constant ring
+	m_perFrameCB->Bind(tracker, ShaderStage::VS, 0);
+	m_perFrameCB->Bind(tracker, ShaderStage::PS, 0);
+	tracker->SetConstantBuffers(ShaderStage::VS, 1, 1, &perObject);
+	tracker->SetConstantBuffers(ShaderStage::PS, 1, 1, &perObject);
 
 	// Set srvs & samplers
-	context->PSSetSamplers(0, 1, samplers);
+	tracker->SetSamplers(ShaderStage::PS, 0, 1, samplers);
 
 	// vs
 	if (m_object->Skinned)
 	{
-		if (ShaderChangement::VS != m_depthVSSkinned.Get())
-		{
-			context->VSSetShader(m_depthVSSkinned.Get(), nullptr, 0);
-			ShaderChangement::VS = m_depthVSSkinned.Get();
-		}
+		tracker->VSSetShader(m_depthVSSkinned.Get());
+		ShaderChangement::VS = m_depthVSSkinned.Get();
 	}
 	else
 	{
-		if (ShaderChangement::VS != m_depthVS.Get())
-		{
-			context->VSSetShader(m_depthVS.Get(), nullptr, 0);
-			ShaderChangement::VS = m_depthVS.Get();
-		}
+		tracker->VSSetShader(m_depthVS.Get());
+		ShaderChangement::VS = m_depthVS.Get();
 	}
 
+	m_transforms.Update();
+	CullInstances(CullPass::Depth);
 	for (UINT i = 0; i < m_object->Worlds.size(); ++i)
 	{
+		if (!m_visible[i])
+			continue;
+
 		// Set world
-		XMMATRIX world = XMLoadFloat4x4(&m_object->Worlds[i]);
-		XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-		XMStoreFloat4x4(&m_perObjectCB->Data.World, XMMatrixTranspose(world));
-		XMStoreFloat4x4(&m_perObjectCB->Data.WorldInvTranspose, XMMatrixTranspose(worldInvTranspose));
+		m_perObjectCB->Data.World = m_transforms.GetWorldT(i);
+		m_perObjectCB->Data.WorldInvTranspose = m_transforms.GetWorldInvTransposeT(i);
 		XMStoreFloat4x4(&m_perObjectCB->Data.TexTransform, XMMatrixIdentity());
 		m_perObjectCB->ApplyChanges(context);
 		if (m_object->Skinned)
-		{
-			for (UINT j = 0; j < m_object->SkinInfo.GetBoneCount(); ++j)
-				m_skinnedCB.Data.BoneTransforms[j] = m_finalTransforms[i][j];
-			m_skinnedCB.ApplyChanges(context);
-		}
+			BindSkinningPalette(context, tracker, i);
 
 		// Iterate over each subSet. Each subSet is corespondent to one material of the same index.
 		for (UINT j = 0; j < m_object->Subsets.size(); ++j)
@@ -339,37 +597,29 @@ void MeshObject::DepthRender(bool recover /* = false */)
 
 			if (m_feature.AlphaClip)
 			{
-				context->PSSetShaderResources(0, 1, m_diffuseMapSRV[i].GetAddressOf());
-				if (ShaderChangement::PS != m_depthPSClip.Get())
-				{
-					context->PSSetShader(m_depthPSClip.Get(), nullptr, 0);
-					ShaderChangement::PS = m_depthPSClip.Get();
-				}
-				if (ShaderChangement::RSS != renderStateMgr->DepthBiasNoCullRS())
-				{
-					context->RSSetState(renderStateMgr->DepthBiasNoCullRS());
-					ShaderChangement::RSS = renderStateMgr->DepthBiasNoCullRS();
-				}
+				tracker->SetShaderResources(ShaderStage::PS, 0, 1, m_diffuseMapSRV[i].GetAddressOf());
+				tracker->PSSetShader(m_depthPSClip.Get());
+				ShaderChangement::PS = m_depthPSClip.Get();
+				tracker->RSSetState(renderStateMgr->DepthBiasNoCullRS());
+				ShaderChangement::RSS = renderStateMgr->DepthBiasNoCullRS();
 			}
 			else
 			{
-				context->PSSetShader(nullptr, nullptr, 0);
+				tracker->PSSetShader(nullptr);
 				ShaderChangement::PS = nullptr;
-				if (ShaderChangement::RSS != renderStateMgr->DepthBiasRS())
-				{
-					context->RSSetState(renderStateMgr->DepthBiasRS());
-					ShaderChangement::RSS = renderStateMgr->DepthBiasRS();
-				}
+				tracker->RSSetState(renderStateMgr->DepthBiasRS());
+				ShaderChangement::RSS = renderStateMgr->DepthBiasRS();
 			}
 
-			context->DrawIndexed(item.IndexCount, item.IndexStart, item.VertexBase);
+			tracker->DrawIndexed(item.IndexCount, item.IndexStart, item.VertexBase);
 		}
 	}
 
 	// Recovery
 	if (recover)
 	{
-		context->RSSetState(nullptr);
+		tracker->RSSetState(nullptr);
+		ShaderChangement::RSS = nullptr;
 	}
 }
 
@@ -379,70 +629,58 @@ void MeshObject::NorDepRender(bool recover /* = false */)
 		return;
 
 	auto renderStateMgr = RenderStateMgr::Instance();
-	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	ID3D11DeviceContext1* context = m_deviceResources->GetD3DDeviceContext();
+	StateTracker* tracker = m_deviceResources->GetStateTracker();
+	tracker->SetComponent("MeshObject");
 	// Set IA stage.
 	UINT stride = m_object->Skinned ? sizeof(PosNormalTexTanSkinned) : sizeof(PosNormalTexTan);
 	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	}
+	tracker->IASetInputLayout(m_inputLayout.Get());
+	ShaderChangement::InputLayout = m_inputLayout.Get();
+	tracker->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
+	tracker->IASetVertexBuffers(0, 1, m_objectVB.GetAddressOf(), &stride, &offset);
+	tracker->IASetIndexBuffer(m_objectIB.Get(), DXGI_FORMAT_R32_UINT, 0);
 
-	ID3D11Buffer* cbuffers0[2] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer() };
-	ID3D11Buffer* cbuffers1[1] = { m_skinnedCB.GetBuffer() };
+	ID3D11Buffer* perObject = m_perObjectCB->GetBuffer();
 	ID3D11SamplerState* samplers[1] = { renderStateMgr->LinearSam() };
 
-	// Set constant buffers
-	context->VSSetConstantBuffers(0, 2, cbuffers0);
-	if (m_object->Skinned)
-		context->VSSetConstantBuffers(3, 1, cbuffers1);
-	context->PSSetConstantBuffers(0, 2, cbuffers0);
+	// Set constant buffers, the per-frame one may be a range of the constant ring
+	m_perFrameCB->Bind(tracker, ShaderStage::VS, 0);
+	m_perFrameCB->Bind(tracker, ShaderStage::PS, 0);
+	tracker->SetConstantBuffers(ShaderStage::VS, 1, 1, &perObject);
+	tracker->SetConstantBuffers(ShaderStage::PS, 1, 1, &perObject);
 
 	// Set srvs & samplers
-	context->PSSetSamplers(0, 1, samplers);
+	tracker->SetSamplers(ShaderStage::PS, 0, 1, samplers);
 
 	// vs
 	if (m_object->Skinned)
 	{
-		if (ShaderChangement::VS != m_norDepVSSkinned.Get())
-		{
-			context->VSSetShader(m_norDepVSSkinned.Get(), nullptr, 0);
-			ShaderChangement::VS = m_norDepVSSkinned.Get();
-		}
+		tracker->VSSetShader(m_norDepVSSkinned.Get());
+		ShaderChangement::VS = m_norDepVSSkinned.Get();
 	}
 	else
 	{
-		if (ShaderChangement::VS != m_norDepVS.Get())
-		{
-			context->VSSetShader(m_norDepVS.Get(), nullptr, 0);
-			ShaderChangement::VS = m_norDepVS.Get();
-		}
+		tracker->VSSetShader(m_norDepVS.Get());
+		ShaderChangement::VS = m_norDepVS.Get();
 	}
 
+	m_transforms.Update();
+	CullInstances(CullPass::NorDep);
 	for (UINT i = 0; i < m_object->Worlds.size(); ++i)
 	{
+		if (!m_visible[i])
+			continue;
+
 		// Set world
-		XMMATRIX world = XMLoadFloat4x4(&m_object->Worlds[i]);
-		XMMATRIX worldInvTranspose = MathHelper::InverseTranspose(world);
-		XMStoreFloat4x4(&m_perObjectCB->Data.World, XMMatrixTranspose(world));
-		XMStoreFloat4x4(&m_perObjectCB->Data.WorldInvTranspose, XMMatrixTranspose(worldInvTranspose));
+		m_perObjectCB->Data.World = m_transforms.GetWorldT(i);
+		m_perObjectCB->Data.WorldInvTranspose = m_transforms.GetWorldInvTransposeT(i);
 		XMStoreFloat4x4(&m_perObjectCB->Data.TexTransform, XMMatrixIdentity());
 		m_perObjectCB->ApplyChanges(context);
 		if (m_object->Skinned)
-		{
-			for (UINT j = 0; j < m_object->SkinInfo.GetBoneCount(); ++j)
-				m_skinnedCB.Data.BoneTransforms[j] = m_finalTransforms[i][j];
-			m_skinnedCB.ApplyChanges(context);
-		}
+			BindSkinningPalette(context, tracker, i);
 
 		// Iterate over each subSet. Each subSet is corespondent to one material of the same index.
 		for (UINT j = 0; j < m_object->Subsets.size(); ++j)
@@ -453,39 +691,27 @@ void MeshObject::NorDepRender(bool recover /* = false */)
 
 			if (m_feature.AlphaClip)
 			{
-				context->PSSetShaderResources(0, 1, m_diffuseMapSRV[index].GetAddressOf());
-				if (ShaderChangement::PS != m_norDepPSClip.Get())
-				{
-					context->PSSetShader(m_norDepPSClip.Get(), nullptr, 0);
-					ShaderChangement::PS = m_norDepPSClip.Get();
-				}
-				if (ShaderChangement::RSS != renderStateMgr->NoCullRS())
-				{
-					context->RSSetState(renderStateMgr->NoCullRS());
-					ShaderChangement::RSS = renderStateMgr->NoCullRS();
-				}
+				tracker->SetShaderResources(ShaderStage::PS, 0, 1, m_diffuseMapSRV[index].GetAddressOf());
+				tracker->PSSetShader(m_norDepPSClip.Get());
+				ShaderChangement::PS = m_norDepPSClip.Get();
+				tracker->RSSetState(renderStateMgr->NoCullRS());
+				ShaderChangement::RSS = renderStateMgr->NoCullRS();
 			}
 			else 
 			{
-				if (ShaderChangement::PS != m_norDepPS.Get())
-				{
-					context->PSSetShader(m_norDepPS.Get(), nullptr, 0);
-					ShaderChangement::PS = m_norDepPS.Get();
-				}
-				if (ShaderChangement::RSS != nullptr)
-				{
-					context->RSSetState(nullptr);
-					ShaderChangement::RSS = nullptr;
-				}
+				tracker->PSSetShader(m_norDepPS.Get());
+				ShaderChangement::PS = m_norDepPS.Get();
+				tracker->RSSetState(nullptr);
+				ShaderChangement::RSS = nullptr;
 			}
 
-			context->DrawIndexed(item.IndexCount, item.IndexStart, item.VertexBase);
+			tracker->DrawIndexed(item.IndexCount, item.IndexStart, item.VertexBase);
 		}
 	}
 
-	if (recover && ShaderChangement::RSS != nullptr)
+	if (recover)
 	{
-		context->RSSetState(nullptr);
+		tracker->RSSetState(nullptr);
 		ShaderChangement::RSS = nullptr;
 	}
 }
@@ -513,6 +739,8 @@ void MeshObject::ReleaseDeviceDependentResources()
 	// SRV
 	m_diffuseMapSRV.clear();
 	m_norMapSRV.clear();
+	m_diffuseStreamIds.clear();
+	m_norStreamIds.clear();
 	m_reflectMapSRV.Reset();
 	m_depthMapSRV.Reset();
 	m_ssaoMapSRV.Reset();
@@ -532,18 +760,21 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 	std::map<UINT, std::wstring> normalAd;
 	bool cacheFlag;
 
-	// VS
-	std::wstring shaderName = L"BasicVS";
+	// VS. The dual quaternion variants have no tessellation and skinned digits.
+	std::wstring shaderName = m_dualQuaternion ? L"BasicDQVS" : L"BasicVS";
 	InputLayoutType inputLayoutType = m_object->Skinned ? InputLayoutType::PosNormalTexTanSkinned : InputLayoutType::PosNormalTexTan;
+	size_t normalDigit = shaderName.size();
 	shaderName += L'0';
-	shaderName += L'0';
+	if (!m_dualQuaternion)
+		shaderName += L'0';
 	shaderName += m_feature.Shadow ? L'1' : L'0';
 	shaderName += m_feature.Ssao ? L'1' : L'0';
-	shaderName += m_object->Skinned ? L'1' : L'0';
+	if (!m_dualQuaternion)
+		shaderName += m_object->Skinned ? L'1' : L'0';
 	shaderName += L".cso";
 	CreateTasks.push_back(shaderMgr->GetVSAsync(shaderName, InputLayoutType::None)
 		.then([=](ID3D11VertexShader* vs) { m_meshVS = vs; }));
-	shaderName[7] = L'1';
+	shaderName[normalDigit] = L'1';
 	CreateTasks.push_back(shaderMgr->GetVSAsync(shaderName, inputLayoutType)
 		.then([=](ID3D11VertexShader* vs)
 	{ 
@@ -554,6 +785,8 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 	m_meshPS.resize(m_object->Material.size());
 	m_diffuseMapSRV.resize(m_object->Material.size());
 	m_norMapSRV.resize(m_object->Material.size());
+	m_diffuseStreamIds.assign(m_object->Material.size(), TextureMgr::NotStreamed);
+	m_norStreamIds.assign(m_object->Material.size(), TextureMgr::NotStreamed);
 	for (UINT i = 0; i < m_object->Material.size(); ++i)
 	{
 		auto& material = m_object->Material[i];
@@ -585,6 +818,15 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 			
 		if (material.DiffuseMap == L"" || material.DiffuseMap == L"Null")
 			m_diffuseMapSRV.push_back(nullptr);
+		else if (m_streamTextures && TextureMgr::IsStreamable(material.DiffuseMap))
+		{
+			// TextureMgr joins the requests of a file itself
+			CreateTasks.push_back(textureMgr->GetStreamedTextureAsync(material.DiffuseMap).then([=](UINT id)
+			{
+				m_diffuseStreamIds[i] = id;
+				m_diffuseMapSRV[i] = textureMgr->GetStreamedTexture(id);
+			}));
+		}
 		else
 		{
 			cacheFlag = false;
@@ -597,11 +839,10 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 				}
 			if(!cacheFlag)
 			{
-				CreateTasks.push_back(textureMgr->GetTextureAsync(material.DiffuseMap)
-					.then([=](ID3D11ShaderResourceView* srv)
+				// Mips are generated on the CPU when asked for, diffuse maps hold sRGB color
+				auto load = m_generateMips ? textureMgr->GetTextureWithMipsAsync(material.DiffuseMap, true) : textureMgr->GetTextureAsync(material.DiffuseMap);
+				CreateTasks.push_back(load.then([=](ID3D11ShaderResourceView* srv)
 				{
-					if (m_generateMips)
-						m_deviceResources->GetD3DDeviceContext()->GenerateMips(srv);
 					m_diffuseMapSRV[i] = srv; 
 				}));
 				fileCache.push_back(material.DiffuseMap);
@@ -609,6 +850,14 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 		}
 		if (material.NormalMap == L"" || material.NormalMap == L"Null")
 			m_norMapSRV.push_back(nullptr);
+		else if (m_streamTextures && TextureMgr::IsStreamable(material.NormalMap))
+		{
+			CreateTasks.push_back(textureMgr->GetStreamedTextureAsync(material.NormalMap).then([=](UINT id)
+			{
+				m_norStreamIds[i] = id;
+				m_norMapSRV[i] = textureMgr->GetStreamedTexture(id);
+			}));
+		}
 		else
 		{
 			cacheFlag = false;
@@ -621,11 +870,10 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 				}
 			if (!cacheFlag)
 			{
-				CreateTasks.push_back(textureMgr->GetTextureAsync(material.NormalMap)
-					.then([=](ID3D11ShaderResourceView* srv) 
+				// Normal maps hold vectors, their mips are filtered as is
+				auto load = m_generateMips ? textureMgr->GetTextureWithMipsAsync(material.NormalMap, false) : textureMgr->GetTextureAsync(material.NormalMap);
+				CreateTasks.push_back(load.then([=](ID3D11ShaderResourceView* srv)
 				{
-					if (m_generateMips)
-						m_deviceResources->GetD3DDeviceContext()->GenerateMips(srv);
 					m_norMapSRV[i] = srv; 
 				}));
 				fileCache.push_back(material.NormalMap);
@@ -638,7 +886,7 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 	{
 		if (m_object->Skinned)
 		{
-			CreateTasks.push_back(shaderMgr->GetVSAsync(L"GetDepthVSSkinned.cso", InputLayoutType::None)
+			CreateTasks.push_back(shaderMgr->GetVSAsync(m_dualQuaternion ? L"GetDepthVSDQ.cso" : L"GetDepthVSSkinned.cso", InputLayoutType::None)
 				.then([=](ID3D11VertexShader* vs) { m_depthVSSkinned = vs; }));
 		}
 		CreateTasks.push_back(shaderMgr->GetVSAsync(L"GetDepthVS.cso", InputLayoutType::None)
@@ -651,7 +899,7 @@ concurrency::task<void> MeshObject::BuildDataAsync()
 	{
 		if (m_object->Skinned)
 		{
-			CreateTasks.push_back(shaderMgr->GetVSAsync(L"GetNorDepVSSkinned.cso", InputLayoutType::None)
+			CreateTasks.push_back(shaderMgr->GetVSAsync(m_dualQuaternion ? L"GetNorDepVSDQ.cso" : L"GetNorDepVSSkinned.cso", InputLayoutType::None)
 				.then([=](ID3D11VertexShader* vs) { m_norDepVSSkinned = vs; }));
 		}
 		CreateTasks.push_back(shaderMgr->GetVSAsync(L"GetNorDepVS.cso", InputLayoutType::None)
@@ -738,16 +986,188 @@ void MeshObject::UpdateNormalMapSRV(int i, ID3D11ShaderResourceView* srv)
 	m_norMapSRV[i] = srv;
 }
 
+void MeshObject::SetClipName(int i, const std::wstring& clipName)
+{
+	m_object->ClipNames[i] = clipName;
+	m_animators[i].SetClip(m_object->SkinInfo.GetClipIndex(clipName));
+}
+
+void MeshObject::CrossFade(int i, const std::wstring& clipName, float duration)
+{
+	m_object->ClipNames[i] = clipName;
+	m_animators[i].CrossFade(m_object->SkinInfo.GetClipIndex(clipName), duration, m_feature.Loop);
+}
+
+UINT MeshObject::AddAnimationLayer(int i, const std::wstring& clipName, float weight,
+	AnimationBlendMode mode /* = AnimationBlendMode::Override */, const std::shared_ptr<BoneMask>& mask /* = nullptr */)
+{
+	AnimationLayer layer;
+	layer.Clip = m_object->SkinInfo.GetClipIndex(clipName);
+	layer.TimePos = m_object->SkinInfo.GetClipStartTime(layer.Clip);
+	layer.Weight = weight;
+	layer.Mode = mode;
+	layer.Mask = mask;
+	return m_animators[i].AddLayer(layer);
+}
+
+void MeshObject::SetAnimationLod(const AnimationLodSettings& settings)
+{
+	m_animationLod.SetSettings(settings);
+	m_extrapolatedInstances.clear();
+	if (!m_object || !m_object->Skinned)
+		return;
+
+	m_paletteVelocity.reset();
+	if (m_animationLod.TracksVelocity())
+	{
+		size_t paletteBytes = sizeof(XMFLOAT4X4) * m_paletteStride * m_object->Worlds.size();
+		m_paletteVelocity.reset((XMFLOAT4X4*)_aligned_malloc(paletteBytes, 64));
+		if (!m_paletteVelocity)
+			throw ref new Platform::OutOfMemoryException();
+		ZeroMemory(m_paletteVelocity.get(), paletteBytes);
+	}
+}
+
+void MeshObject::SetAnimationView(const XMFLOAT3& eyePosW, const XMFLOAT4X4& viewProj)
+{
+	XMFLOAT4 planes[6];
+	ExtractFrustumPlanes(planes, viewProj);
+	m_animationLod.SetView(eyePosW, planes);
+}
+
+void MeshObject::SetWorld(int i, const XMFLOAT4X4& world)
+{
+	m_object->Worlds[i] = world;
+	m_transforms.Set(i, world);
+	if (m_bvh)
+		m_bvh->Update(m_bvhIds[i], GetTransBoundingBox(i));
+}
+
+void MeshObject::AttachToBvh(SceneBvh* bvh)
+{
+	DetachFromBvh();
+	m_bvh = bvh;
+	// Destroying the BVH first leaves nothing to remove
+	bvh->AddOwner(this, [this]()
+	{
+		m_bvh = nullptr;
+		m_bvhIds.clear();
+	});
+	m_bvhIds.resize(m_object->Worlds.size());
+	for (UINT i = 0; i < m_object->Worlds.size(); ++i)
+		m_bvhIds[i] = bvh->Insert(GetTransBoundingBox(i), SceneBvhItem(this, 0, i));
+}
+
+void MeshObject::DetachFromBvh()
+{
+	if (!m_bvh)
+		return;
+	for (UINT id : m_bvhIds)
+		m_bvh->Remove(id);
+	m_bvh->RemoveOwner(this);
+	m_bvhIds.clear();
+	m_bvh = nullptr;
+}
+
+void MeshObject::CullInstances(CullPass pass)
+{
+	CullStats& stats = m_cullStats[(int)pass];
+	UINT count = m_object->Worlds.size();
+	stats.Tested = count;
+	if (!m_cullEnabled)
+	{
+		m_visible.assign(count, 1);
+		stats.Visible = count;
+		return;
+	}
+
+	XMFLOAT4 planes[6];
+	InstanceCuller::ExtractPlanes(m_perFrameCB->Data, planes);
+	if (m_object->Skinned)
+	{
+		for (UINT i = 0; i < count; ++i)
+			m_cullBoxes[i] = GetAnimatedBoundingBox(i);
+		stats.Visible = InstanceCuller::Cull(&m_cullBoxes[0], &m_object->Worlds[0], count, planes, &m_visible[0]);
+	}
+	else
+		stats.Visible = InstanceCuller::Cull(m_boundingBox, &m_object->Worlds[0], count, planes, &m_visible[0]);
+}
+
+void MeshObject::UpdateStreamedTextures()
+{
+	if (!m_streamTextures)
+		return;
+
+	// Pixels covered by the largest visible instance, all of them share the materials
+	const BasicPerFrameCB& frame = m_perFrameCB->Data;
+	float viewportHeight = m_deviceResources->GetScreenViewport().Height;
+	float screenSize = 0.0f;
+	for (UINT i = 0; i < m_object->Worlds.size(); ++i)
+	{
+		if (!m_visible[i])
+			continue;
+		BoundingSphere sphere = GetTransBoundingSphere(i);
+		float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&sphere.Center) - XMLoadFloat3(&frame.EyePosW)));
+		screenSize = std::max<float>(screenSize, TextureResidency::ProjectedSize(sphere.Radius, distance, frame.Proj._22, viewportHeight));
+	}
+
+	// Views change as mips arrive and are evicted, so they are fetched again every frame
+	auto textureMgr = TextureMgr::Instance();
+	for (UINT i = 0; i < m_diffuseStreamIds.size(); ++i)
+	{
+		if (m_diffuseStreamIds[i] != TextureMgr::NotStreamed)
+		{
+			if (screenSize > 0.0f)
+				textureMgr->NoteTextureUse(m_diffuseStreamIds[i], screenSize);
+			m_diffuseMapSRV[i] = textureMgr->GetStreamedTexture(m_diffuseStreamIds[i]);
+		}
+		if (m_norStreamIds[i] != TextureMgr::NotStreamed)
+		{
+			if (screenSize > 0.0f)
+				textureMgr->NoteTextureUse(m_norStreamIds[i], screenSize);
+			m_norMapSRV[i] = textureMgr->GetStreamedTexture(m_norStreamIds[i]);
+		}
+	}
+}
+
+const BoundingBox& MeshObject::GetAnimatedBoundingBox(UINT i)
+{
+	if (m_boundsDirty[i])
+	{
+		m_animatedBounds[i] = m_skinnedBounds.GetBounds(GetMatrixPalette(i));
+		m_boundsDirty[i] = 0;
+	}
+	return m_animatedBounds[i];
+}
+
 BoundingBox MeshObject::GetTransBoundingBox(int i)
 {
 	BoundingBox res;
-	m_boundingBox.Transform(res, XMLoadFloat4x4(&m_object->Worlds[i]));
+	const BoundingBox& local = m_object->Skinned ? GetAnimatedBoundingBox(i) : m_boundingBox;
+	local.Transform(res, XMLoadFloat4x4(&m_object->Worlds[i]));
 	return res;
 }
 
 BoundingSphere MeshObject::GetTransBoundingSphere(int i)
 {
 	BoundingSphere res;
-	m_boundingSphere.Transform(res, XMLoadFloat4x4(&m_object->Worlds[i]));
+	if (m_object->Skinned)
+	{
+		BoundingSphere local;
+		BoundingSphere::CreateFromBoundingBox(local, GetAnimatedBoundingBox(i));
+		local.Transform(res, XMLoadFloat4x4(&m_object->Worlds[i]));
+	}
+	else
+	{
+		m_boundingSphere.Transform(res, XMLoadFloat4x4(&m_object->Worlds[i]));
+	}
 	return res;
+}
+
+BoundingBox MeshObject::GetSkinnedBoundingBox(int i)
+{
+	if (!m_object->Skinned)
+		return m_boundingBox;
+	return SkinningHelper::ComputeBounds(&m_object->VertexDataSkinned[0], m_object->VertexDataSkinned.size(),
+		GetMatrixPalette(i), m_skinnedPositions);
 }
\ No newline at end of file
@@ -9,7 +9,15 @@
 #include "Common/GameTimer.h"
 #include "Common/ConstantBuffer.h"
 #include "Common/DeviceResources.h"
+#include "Common/ConstantRing.h"
 #include "MeshGeometry.h"
+#include "AnimationBlend.h"
+#include "AnimationLod.h"
+#include "SkinningHelper.h"
+#include "InstanceCuller.h"
+#include "SceneBvh.h"
+#include "TransformStore.h"
+#include "RenderQueue.h"
 
 
 // Support "Normal", "Reflect", "NoTexture", "Texture".
@@ -40,6 +48,9 @@ namespace DXFramework
 		bool Shadow;
 		bool Ssao;
 		bool Loop;
+		// Skin with a dual quaternion palette, half the constant data of the matrix palette.
+		// Skeletons with scale keep the matrix palette.
+		bool DualQuaternion;
 		UINT LightCount;
 		std::wstring ReflectFileName;
 	};
@@ -59,6 +70,9 @@ namespace DXFramework
 		void ReleaseDeviceDependentResources();
 		void Update(float dt);
 		void Render(bool recover = false);
+		// Add one packet per visible instance and subset to a render queue instead of drawing.
+		// Skinned packets point at the instance palette, which must stay valid until Execute.
+		void Submit(RenderQueue& queue);
 		void DepthRender(bool recover = false);
 		void NorDepRender(bool recover = false);
 
@@ -69,19 +83,76 @@ namespace DXFramework
 		void UpdateDiffuseMapSRV(int i, ID3D11ShaderResourceView* srv);
 		void UpdateNormalMapSRV(int i, ID3D11ShaderResourceView* srv);
 
-		void StartAnimation(int i) { m_timePositions[i] = 0.0f; }
-		void StopAnimation(int i) { m_timePositions[i] = -1.0f; }
-		void SetWorld(int i, const DirectX::XMFLOAT4X4& world) { m_object->Worlds[i] = world; }
-		void SetClipName(int i, const std::wstring& clipName) { m_object->ClipNames[i] = clipName; m_timePositions[i] = -1.0f; }
+		// Evaluate instances on several workers when there are enough of them. 1 keeps the serial path.
+		void SetUpdateWorkerCount(UINT count);
+
+		void StartAnimation(int i) { m_animators[i].Play(m_animators[i].GetClip(), m_feature.Loop); }
+		void StopAnimation(int i) { m_animators[i].Stop(); }
+		void SetWorld(int i, const DirectX::XMFLOAT4X4& world);
+		void SetClipName(int i, const std::wstring& clipName);
+		// Blend from the playing clip into clipName over duration seconds.
+		void CrossFade(int i, const std::wstring& clipName, float duration);
+		// Layer a clip on top of the base clip. A null mask affects every bone. Returns the layer index.
+		UINT AddAnimationLayer(int i, const std::wstring& clipName, float weight,
+			AnimationBlendMode mode = AnimationBlendMode::Override, const std::shared_ptr<BoneMask>& mask = nullptr);
+		void SetAnimationLayerWeight(int i, UINT layer, float weight) { m_animators[i].GetLayer(layer).Weight = weight; }
+		void RemoveAnimationLayer(int i, UINT layer) { m_animators[i].RemoveLayer(layer); }
+		AnimationController& GetAnimator(int i) { return m_animators[i]; }
+		const PoseCache& GetPoseCache()const { return m_poseCache; }
+
+		void SetAnimationLod(const AnimationLodSettings& settings);
+		// proxyBones[i] is the bone that bone i follows at low detail, -1 keeps it.
+		void SetDetailBones(const std::vector<int>& proxyBones) { m_animationLod.SetDetailBones(proxyBones); }
+		// Viewer of the animation LOD, set before Update. viewProj is not transposed.
+		void SetAnimationView(const DirectX::XMFLOAT3& eyePosW, const DirectX::XMFLOAT4X4& viewProj);
+		const AnimationLodStats& GetAnimationLodStats()const { return m_animationLod.GetStats(); }
 
 		DirectX::XMFLOAT4X4 GetWorld(int i) { return m_object->Worlds[i]; }
 		DirectX::BoundingBox GetOrgBoundingBox() { return m_boundingBox; }
 		DirectX::BoundingSphere GetOrgBoundingSphere() { return m_boundingSphere; }
+		// Skinned objects return bounds that follow the current pose of instance i.
 		DirectX::BoundingBox GetTransBoundingBox(int i);
 		DirectX::BoundingSphere GetTransBoundingSphere(int i);
+		// Exact model space bounds of the skinned vertices of instance i. Skins every vertex.
+		DirectX::BoundingBox GetSkinnedBoundingBox(int i);
+
+		// Frustum culling of instances, on by default. Stats are from the last call of each pass.
+		void SetCullingEnabled(bool enable) { m_cullEnabled = enable; }
+		CullStats GetCullStats(CullPass pass) { return m_cullStats[(int)pass]; }
+
+		// Load the DDS maps as streamed textures of TextureMgr, off by default. Their mips follow
+		// the on screen size of the largest visible instance. Set before the resources are created.
+		void SetTextureStreaming(bool enable) { m_streamTextures = enable; }
+
+		// Insert every instance into a scene BVH. SetWorld and animated bounds keep the items up
+		// to date, the owner of the BVH calls Refresh once per frame. Items are removed when the
+		// object is destroyed, a BVH destroyed first detaches the object.
+		void AttachToBvh(SceneBvh* bvh);
+		void DetachFromBvh();
 
 	private:
 		concurrency::task<void> BuildDataAsync();
+		void UpdateParallel();
+		void EvaluateInstance(UINT i, BonePosePacket* poseScratch);
+		void ExtrapolateInstance(UINT i);
+		DirectX::XMFLOAT4X4* GetPaletteVelocity(UINT i) { return m_paletteVelocity.get() + i * m_paletteStride; }
+		const DirectX::BoundingBox& GetAnimatedBoundingBox(UINT i);
+		void CullInstances(CullPass pass);
+		void UpdateStreamedTextures();
+		DirectX::XMFLOAT4X4* GetPalette(UINT i) { return m_finalTransforms.get() + i * m_paletteStride; }
+		DirectX::XMFLOAT4* GetDualQuaternions(UINT i) { return m_dualQuaternions.get() + i * m_dualQuaternionStride; }
+		DirectX::XMFLOAT4X4* GetMatrixPalette(UINT i);
+		// The palette the vertex shaders read, matrices or dual quaternions
+		const void* GetSkinningPalette(UINT i);
+		UINT GetSkinningPaletteSize()const;
+		void BindSkinningPalette(ID3D11DeviceContext* context, DX::StateTracker* tracker, UINT i);
+		void PaletteChanged(UINT i);
+
+		struct AlignedDeleter
+		{
+			void operator()(DirectX::XMFLOAT4X4* p) const { _aligned_free(p); }
+			void operator()(DirectX::XMFLOAT4* p) const { _aligned_free(p); }
+		};
 
 	private:
 		// Cached pointer to shared resources
@@ -96,6 +167,8 @@ namespace DXFramework
 		Microsoft::WRL::ComPtr<ID3D11Buffer> m_objectIB;
 		
 		static bool m_resetFlag;
+		// Palettes go to the ring of the device resources, each instance keeps its last upload
+		// for the next pass. Without a ring they go through this buffer.
 		static DX::ConstantBuffer<DX::SkinnedTransforms> m_skinnedCB;
 		
 		// Shaders
@@ -114,18 +187,62 @@ namespace DXFramework
 		// SRV
 		std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_diffuseMapSRV;
 		std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> m_norMapSRV;
+		// Streamed ids of the maps, TextureMgr::NotStreamed for maps loaded whole
+		std::vector<UINT> m_diffuseStreamIds;
+		std::vector<UINT> m_norStreamIds;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_reflectMapSRV;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_depthMapSRV;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_ssaoMapSRV;
 
 		// Custom data
-		std::vector<std::vector<DirectX::XMFLOAT4X4>> m_finalTransforms;
-		std::vector<float> m_timePositions;
+		// Palettes of all instances in one cache line aligned block. Every matrix fills a whole
+		// line, so workers writing neighbouring instances never share a line.
+		std::unique_ptr<DirectX::XMFLOAT4X4[], AlignedDeleter> m_finalTransforms;
+		UINT m_paletteStride;
+		std::vector<DX::RingSlot> m_paletteSlots;
+		// Evaluated from the pose, or converted from the matrix palette after extrapolation.
+		// The stride holds whole cache lines like the matrices. A stale matrix palette is built
+		// from them when the bounds need it.
+		std::unique_ptr<DirectX::XMFLOAT4[], AlignedDeleter> m_dualQuaternions;
+		UINT m_dualQuaternionStride;
+		std::vector<BYTE> m_paletteStale;
+		bool m_dualQuaternion;
+		// Playback state per instance, clip handles resolved from ClipNames.
+		std::vector<AnimationController> m_animators;
+		// Instances sampling the same clip at the same time share one evaluation.
+		PoseCache m_poseCache;
+		std::vector<UINT> m_activeInstances;
+		std::vector<std::vector<BonePosePacket>> m_workerPoseScratch;
+		UINT m_updateWorkerCount;
+		std::vector<BonePosePacket> m_poseScratch;
+
+		// Animation LOD
+		AnimationLod m_animationLod;
+		// Per frame change of each palette, same layout as m_finalTransforms.
+		std::unique_ptr<DirectX::XMFLOAT4X4[], AlignedDeleter> m_paletteVelocity;
+		std::vector<UINT> m_extrapolatedInstances;
 
 		DirectX::BoundingBox m_boundingBox;
 		DirectX::BoundingSphere m_boundingSphere;
+		// Per bone boxes for the animated bounds, refreshed lazily when a palette changed.
+		SkinnedBounds m_skinnedBounds;
+		std::vector<DirectX::BoundingBox> m_animatedBounds;
+		std::vector<UINT8> m_boundsDirty;
+		std::vector<DirectX::XMFLOAT3> m_skinnedPositions;
+
+		// Upload ready world and inverse transpose per instance
+		TransformStore m_transforms;
+		// Visibility flag per instance. Skinned instances are culled with their animated boxes.
+		std::vector<UINT8> m_visible;
+		std::vector<DirectX::BoundingBox> m_cullBoxes;
+		CullStats m_cullStats[(int)CullPass::Count];
+		bool m_cullEnabled;
+
+		SceneBvh* m_bvh;
+		std::vector<UINT> m_bvhIds;
 
 		bool m_generateMips;
+		bool m_streamTextures;
 		bool m_initialized;
 		bool m_loadingComplete;
 	};
@@ -0,0 +1,198 @@
+#include "pch.h"
+#include "RenderQueue.h"
+
+using namespace DXFramework;
+using namespace DirectX;
+
+using namespace DX;
+
+static LONGLONG GetTicks()
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+static double TicksToMs(LONGLONG ticks)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return ticks * 1000.0 / frequency.QuadPart;
+}
+
+#pragma region RecordingDrawContext
+
+void RecordingDrawContext::Reset()
+{
+	m_commands.clear();
+	ZeroMemory(m_counts, sizeof(m_counts));
+}
+
+void RecordingDrawContext::Record(DrawCommandType type, const void* object, UINT arg0, UINT arg1, UINT arg2, UINT arg3, UINT arg4)
+{
+	++m_counts[(int)type];
+	if (!m_keepCommands)
+		return;
+	RecordedCommand command;
+	command.Type = type;
+	command.Object = object;
+	command.Args[0] = arg0;
+	command.Args[1] = arg1;
+	command.Args[2] = arg2;
+	command.Args[3] = arg3;
+	command.Args[4] = arg4;
+	m_commands.push_back(command);
+}
+
+#pragma endregion
+
+#pragma region RenderQueue
+
+void RenderQueue::Clear()
+{
+	m_packets.clear();
+	m_objectData.clear();
+	m_keys.clear();
+	m_order.clear();
+
+	// Sweep once per lifetime, so an unused id lives between one and two lifetimes
+	if (++m_frame % IdLifetime == 0)
+	{
+		m_ids.Expire(m_frame, IdLifetime);
+		m_shaderIds.Expire(m_frame, IdLifetime);
+	}
+}
+
+void RenderQueue::ResetIds()
+{
+	m_ids.Reset();
+	m_shaderIds.Reset();
+}
+
+UINT RenderQueue::GetId(const void* object, UINT bits)
+{
+	if (!object)
+		return 0;
+	return m_ids.Get(object, m_frame) & ((1u << bits) - 1);
+}
+
+UINT RenderQueue::GetShaderId(const DrawPacket& packet)
+{
+	auto key = std::make_pair((const void*)packet.VS, (const void*)packet.PS);
+	return m_shaderIds.Get(key, m_frame) & 0x3fff;
+}
+
+void RenderQueue::Add(const DrawPacket& packet, const BasicPerObjectCB& objectData, RenderPass pass,
+	const void* material, const XMFLOAT3& center)
+{
+	// The bits of a positive float sort like its value, the top 24 are enough for ordering.
+	float depth = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&center), XMLoadFloat3(&m_eyePosW))));
+	UINT depthBits = *reinterpret_cast<UINT*>(&depth) >> 8;
+	if (pass == RenderPass::Translucent)
+		depthBits = ~depthBits & 0xffffff;
+
+	UINT64 key = (UINT64)pass << 60;
+	key |= (UINT64)GetShaderId(packet) << 46;
+	key |= (UINT64)GetId(packet.PSResources[0], 14) << 32;
+	key |= (UINT64)GetId(material, 8) << 24;
+	key |= depthBits;
+
+	m_keys.push_back(key);
+	m_order.push_back(m_packets.size());
+	m_packets.push_back(packet);
+	m_packets.back().ObjectData = m_objectData.size();
+	m_objectData.push_back(objectData);
+}
+
+void RenderQueue::Sort()
+{
+	LONGLONG start = GetTicks();
+
+	// LSD radix sort, one byte per pass. Passes where every key has the same byte are skipped,
+	// which is common for the pass and shader bytes.
+	UINT count = m_keys.size();
+	m_sortKeys.resize(count);
+	m_sortOrder.resize(count);
+	for (UINT shift = 0; shift < 64; shift += 8)
+	{
+		UINT histogram[256] = { 0 };
+		for (UINT i = 0; i < count; ++i)
+			++histogram[(m_keys[i] >> shift) & 0xff];
+		if (count == 0 || histogram[(m_keys[0] >> shift) & 0xff] == count)
+			continue;
+
+		UINT offset = 0;
+		for (UINT b = 0; b < 256; ++b)
+		{
+			UINT n = histogram[b];
+			histogram[b] = offset;
+			offset += n;
+		}
+		for (UINT i = 0; i < count; ++i)
+		{
+			UINT dest = histogram[(m_keys[i] >> shift) & 0xff]++;
+			m_sortKeys[dest] = m_keys[i];
+			m_sortOrder[dest] = m_order[i];
+		}
+		m_keys.swap(m_sortKeys);
+		m_order.swap(m_sortOrder);
+	}
+
+	m_stats.Packets = count;
+	m_stats.SortMs = TicksToMs(GetTicks() - start);
+}
+
+void RenderQueue::Execute(DrawContext& context)
+{
+	LONGLONG start = GetTicks();
+	UINT changes = 0;
+
+	context.Begin();
+	if (!m_objectData.empty())
+		context.PrepareObjectData(&m_objectData[0], (UINT)m_objectData.size());
+	const DrawPacket* last = nullptr;
+	for (UINT i = 0; i < m_order.size(); ++i)
+	{
+		const DrawPacket& p = m_packets[m_order[i]];
+		// Only bind what differs from the previous packet
+		if (!last || p.InputLayout != last->InputLayout) { context.SetInputLayout(p.InputLayout); ++changes; }
+		if (!last || p.Topology != last->Topology) { context.SetTopology(p.Topology); ++changes; }
+		if (!last || p.VertexBuffer != last->VertexBuffer || p.Stride != last->Stride) { context.SetVertexBuffer(p.VertexBuffer, p.Stride); ++changes; }
+		if (p.InstanceBuffer && (!last || p.InstanceBuffer != last->InstanceBuffer || p.InstanceStride != last->InstanceStride)) { context.SetInstanceBuffer(p.InstanceBuffer, p.InstanceStride); ++changes; }
+		if (p.IndexBuffer && (!last || p.IndexBuffer != last->IndexBuffer)) { context.SetIndexBuffer(p.IndexBuffer); ++changes; }
+		if (!last || p.VS != last->VS) { context.SetVS(p.VS); ++changes; }
+		if (!last || p.HS != last->HS) { context.SetHS(p.HS); ++changes; }
+		if (!last || p.DS != last->DS) { context.SetDS(p.DS); ++changes; }
+		if (!last || p.PS != last->PS) { context.SetPS(p.PS); ++changes; }
+		if (!last || p.RasterizerState != last->RasterizerState) { context.SetRasterizerState(p.RasterizerState); ++changes; }
+		if (p.TessSettings && (!last || p.TessSettings != last->TessSettings)) { context.SetTessSettings(p.TessSettings); ++changes; }
+		for (UINT slot = 0; slot < 6; ++slot)
+		{
+			if (!last || p.PSResources[slot] != last->PSResources[slot]) { context.SetPSResource(slot, p.PSResources[slot]); ++changes; }
+		}
+		if (p.DSResource && (!last || p.DSResource != last->DSResource)) { context.SetDSResource(p.DSResource); ++changes; }
+
+		context.SetObjectData(p.ObjectData, m_objectData[p.ObjectData]);
+		// Subsets of one skinned instance share its palette
+		if (p.BonePalette && (!last || p.BonePalette != last->BonePalette))
+			context.SetBonePalette(p.BonePalette, p.BonePaletteSize);
+		if (p.InstanceCount > 0)
+		{
+			if (p.IndexBuffer)
+				context.DrawIndexedInstanced(p.Count, p.InstanceCount, p.Start, p.Base, p.StartInstance);
+			else
+				context.DrawInstanced(p.Count, p.InstanceCount, p.Base, p.StartInstance);
+		}
+		else if (p.IndexBuffer)
+			context.DrawIndexed(p.Count, p.Start, p.Base);
+		else
+			context.Draw(p.Count, p.Base);
+		last = &p;
+	}
+	context.End();
+
+	m_stats.StateChanges = changes;
+	m_stats.ExecuteMs = TicksToMs(GetTicks() - start);
+}
+
+#pragma endregion
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <map>
+#include <vector>
+#include "Common/ConstantBufferLayouts.h"
+
+// Sorted submission of draw packets. Components add one packet per draw with the full
+// pipeline state it needs, the queue builds a 64 bit key per packet, radix sorts the keys
+// and replays the packets through a DrawContext, skipping state that did not change since
+// the previous packet. Key layout from the most significant bit:
+//   pass (4) | shader pair (14) | diffuse texture (14) | material (8) | depth (24)
+// Depth is front to back except in the translucent pass, where it is inverted.
+
+namespace DXFramework
+{
+	enum class RenderPass
+	{
+		Opaque,
+		AlphaTested,
+		Translucent
+	};
+
+	struct DrawPacket
+	{
+		DrawPacket() { ZeroMemory(this, sizeof(DrawPacket)); Topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST; }
+
+		ID3D11InputLayout* InputLayout;
+		D3D11_PRIMITIVE_TOPOLOGY Topology;
+		ID3D11Buffer* VertexBuffer;
+		UINT Stride;
+		ID3D11Buffer* IndexBuffer;	// nullptr for non indexed draws
+
+		ID3D11VertexShader* VS;
+		ID3D11HullShader* HS;
+		ID3D11DomainShader* DS;
+		ID3D11PixelShader* PS;
+		ID3D11RasterizerState* RasterizerState;
+		ID3D11Buffer* TessSettings;	// VS b2 and DS b1 when tessellating
+
+		// Pixel shader t0-t5: diffuse, normal, shadow, ssao and reflect maps, instance materials
+		ID3D11ShaderResourceView* PSResources[6];
+		// Domain shader t0, the displacement map
+		ID3D11ShaderResourceView* DSResource;
+
+		// Skinned draws only, bone matrices or dual quaternions
+		const void* BonePalette;
+		UINT BonePaletteSize;	// Bytes
+
+		UINT Count;		// Index count, or vertex count without index buffer
+		UINT Start;		// Index start
+		UINT Base;		// Base vertex
+
+		// Instanced draws only, the per instance stream goes to IA slot 1
+		ID3D11Buffer* InstanceBuffer;
+		UINT InstanceStride;
+		UINT InstanceCount;	// 0 for a plain draw
+		UINT StartInstance;
+
+		// Filled by the queue
+		UINT ObjectData;
+	};
+
+	// Where the sorted packets are replayed. The D3D implementation (D3DDrawContext.h) binds
+	// on the device context, the recording one only logs the calls so sorting and filtering can be
+	// measured without a device.
+	class DrawContext
+	{
+	public:
+		virtual ~DrawContext() {}
+
+		virtual void Begin() {}
+		// The object data of every packet, after Begin and before the first packet. Contexts
+		// that upload all of it at once do so here, SetObjectData then gets the index.
+		virtual void PrepareObjectData(const DX::BasicPerObjectCB* data, UINT count) {}
+		// Called after the last packet, to unbind what later draws must not see.
+		virtual void End() {}
+		virtual void SetInputLayout(ID3D11InputLayout* layout) = 0;
+		virtual void SetTopology(D3D11_PRIMITIVE_TOPOLOGY topology) = 0;
+		virtual void SetVertexBuffer(ID3D11Buffer* buffer, UINT stride) = 0;
+		virtual void SetInstanceBuffer(ID3D11Buffer* buffer, UINT stride) = 0;
+		virtual void SetIndexBuffer(ID3D11Buffer* buffer) = 0;
+		virtual void SetVS(ID3D11VertexShader* vs) = 0;
+		virtual void SetHS(ID3D11HullShader* hs) = 0;
+		virtual void SetDS(ID3D11DomainShader* ds) = 0;
+		virtual void SetPS(ID3D11PixelShader* ps) = 0;
+		virtual void SetRasterizerState(ID3D11RasterizerState* state) = 0;
+		virtual void SetTessSettings(ID3D11Buffer* buffer) = 0;
+		virtual void SetPSResource(UINT slot, ID3D11ShaderResourceView* srv) = 0;
+		virtual void SetDSResource(ID3D11ShaderResourceView* srv) = 0;
+		virtual void SetObjectData(UINT index, const DX::BasicPerObjectCB& data) = 0;
+		virtual void SetBonePalette(const void* palette, UINT size) = 0;
+		virtual void Draw(UINT vertexCount, UINT baseVertex) = 0;
+		virtual void DrawIndexed(UINT indexCount, UINT startIndex, UINT baseVertex) = 0;
+		virtual void DrawInstanced(UINT vertexCount, UINT instanceCount, UINT baseVertex, UINT startInstance) = 0;
+		virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, UINT baseVertex, UINT startInstance) = 0;
+	};
+
+	enum class DrawCommandType
+	{
+		InputLayout,
+		Topology,
+		VertexBuffer,
+		InstanceBuffer,
+		IndexBuffer,
+		VS,
+		HS,
+		DS,
+		PS,
+		RasterizerState,
+		TessSettings,
+		PSResource,
+		DSResource,
+		ObjectData,
+		BonePalette,
+		Draw,
+		DrawIndexed,
+		DrawInstanced,
+		DrawIndexedInstanced,
+		Count
+	};
+
+	struct RecordedCommand
+	{
+		DrawCommandType Type;
+		const void* Object;
+		UINT Args[5];
+	};
+
+	class RecordingDrawContext : public DrawContext
+	{
+	public:
+		RecordingDrawContext(bool keepCommands = true) : m_keepCommands(keepCommands) { Reset(); }
+
+		void Reset();
+		const std::vector<RecordedCommand>& GetCommands()const { return m_commands; }
+		UINT GetCount(DrawCommandType type)const { return m_counts[(int)type]; }
+
+		virtual void SetInputLayout(ID3D11InputLayout* layout) override { Record(DrawCommandType::InputLayout, layout); }
+		virtual void SetTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override { Record(DrawCommandType::Topology, nullptr, topology); }
+		virtual void SetVertexBuffer(ID3D11Buffer* buffer, UINT stride) override { Record(DrawCommandType::VertexBuffer, buffer, stride); }
+		virtual void SetInstanceBuffer(ID3D11Buffer* buffer, UINT stride) override { Record(DrawCommandType::InstanceBuffer, buffer, stride); }
+		virtual void SetIndexBuffer(ID3D11Buffer* buffer) override { Record(DrawCommandType::IndexBuffer, buffer); }
+		virtual void SetVS(ID3D11VertexShader* vs) override { Record(DrawCommandType::VS, vs); }
+		virtual void SetHS(ID3D11HullShader* hs) override { Record(DrawCommandType::HS, hs); }
+		virtual void SetDS(ID3D11DomainShader* ds) override { Record(DrawCommandType::DS, ds); }
+		virtual void SetPS(ID3D11PixelShader* ps) override { Record(DrawCommandType::PS, ps); }
+		virtual void SetRasterizerState(ID3D11RasterizerState* state) override { Record(DrawCommandType::RasterizerState, state); }
+		virtual void SetTessSettings(ID3D11Buffer* buffer) override { Record(DrawCommandType::TessSettings, buffer); }
+		virtual void SetPSResource(UINT slot, ID3D11ShaderResourceView* srv) override { Record(DrawCommandType::PSResource, srv, slot); }
+		virtual void SetDSResource(ID3D11ShaderResourceView* srv) override { Record(DrawCommandType::DSResource, srv); }
+		virtual void SetObjectData(UINT index, const DX::BasicPerObjectCB& data) override { Record(DrawCommandType::ObjectData, &data, index); }
+		virtual void SetBonePalette(const void* palette, UINT size) override { Record(DrawCommandType::BonePalette, palette, size); }
+		virtual void Draw(UINT vertexCount, UINT baseVertex) override { Record(DrawCommandType::Draw, nullptr, vertexCount, baseVertex); }
+		virtual void DrawIndexed(UINT indexCount, UINT startIndex, UINT baseVertex) override { Record(DrawCommandType::DrawIndexed, nullptr, indexCount, startIndex, baseVertex); }
+		virtual void DrawInstanced(UINT vertexCount, UINT instanceCount, UINT baseVertex, UINT startInstance) override
+		{
+			Record(DrawCommandType::DrawInstanced, nullptr, vertexCount, instanceCount, baseVertex, startInstance);
+		}
+		virtual void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, UINT baseVertex, UINT startInstance) override
+		{
+			Record(DrawCommandType::DrawIndexedInstanced, nullptr, indexCount, instanceCount, startIndex, baseVertex, startInstance);
+		}
+
+	private:
+		void Record(DrawCommandType type, const void* object, UINT arg0 = 0, UINT arg1 = 0, UINT arg2 = 0, UINT arg3 = 0, UINT arg4 = 0);
+
+		bool m_keepCommands;
+		std::vector<RecordedCommand> m_commands;
+		UINT m_counts[(int)DrawCommandType::Count];
+	};
+
+	struct RenderQueueStats
+	{
+		RenderQueueStats() : Packets(0), StateChanges(0), SortMs(0.0), ExecuteMs(0.0) {}
+
+		UINT Packets;
+		UINT StateChanges;	// Bind calls made by the last Execute, draws excluded
+		double SortMs;
+		double ExecuteMs;
+	};
+
+	// Small ids for the state objects in the keys. An id is kept while its key is seen so keys
+	// stay stable across frames, and is recycled once the key has not been seen for a while,
+	// since the object may have been released and its address reused.
+	template<class Key>
+	class IdTable
+	{
+	public:
+		IdTable() : m_next(1) {}
+
+		UINT Get(const Key& key, UINT frame)
+		{
+			auto it = m_entries.find(key);
+			if (it == m_entries.end())
+			{
+				Entry entry;
+				if (m_free.empty())
+					entry.Id = m_next++;
+				else
+				{
+					entry.Id = m_free.back();
+					m_free.pop_back();
+				}
+				it = m_entries.insert(std::make_pair(key, entry)).first;
+			}
+			it->second.LastFrame = frame;
+			return it->second.Id;
+		}
+
+		// Release the ids of keys not seen in the last lifetime frames.
+		void Expire(UINT frame, UINT lifetime)
+		{
+			for (auto it = m_entries.begin(); it != m_entries.end();)
+			{
+				if (frame - it->second.LastFrame >= lifetime)
+				{
+					m_free.push_back(it->second.Id);
+					it = m_entries.erase(it);
+				}
+				else
+					++it;
+			}
+		}
+
+		void Reset() { m_entries.clear(); m_free.clear(); m_next = 1; }
+		UINT GetCount()const { return m_entries.size(); }
+
+	private:
+		struct Entry
+		{
+			UINT Id;
+			UINT LastFrame;
+		};
+
+		std::map<Key, Entry> m_entries;
+		std::vector<UINT> m_free;
+		UINT m_next;
+	};
+
+	class RenderQueue
+	{
+	public:
+		// Clears an id survives without being used.
+		static const UINT IdLifetime = 120;
+
+		RenderQueue() : m_eyePosW(0.0f, 0.0f, 0.0f), m_frame(0) {}
+
+		// Viewer used for the depth part of the keys.
+		void SetView(const DirectX::XMFLOAT3& eyePosW) { m_eyePosW = eyePosW; }
+		// Starts a frame, or a pass when several passes share the queue. Ids unused for
+		// IdLifetime clears are released here.
+		void Clear();
+		// Forget every id, for when the device resources are released.
+		void ResetIds();
+		// material only identifies the material, center is the world position used for depth.
+		void Add(const DrawPacket& packet, const DX::BasicPerObjectCB& objectData, RenderPass pass,
+			const void* material, const DirectX::XMFLOAT3& center);
+
+		void Sort();
+		void Execute(DrawContext& context);
+
+		UINT GetPacketCount()const { return m_packets.size(); }
+		const DrawPacket& GetSortedPacket(UINT i)const { return m_packets[m_order[i]]; }
+		const RenderQueueStats& GetStats()const { return m_stats; }
+		UINT GetIdCount()const { return m_ids.GetCount() + m_shaderIds.GetCount(); }
+
+	private:
+		UINT GetId(const void* object, UINT bits);
+		UINT GetShaderId(const DrawPacket& packet);
+
+	private:
+		DirectX::XMFLOAT3 m_eyePosW;
+		std::vector<DrawPacket> m_packets;
+		std::vector<DX::BasicPerObjectCB> m_objectData;
+		std::vector<UINT64> m_keys;
+		std::vector<UINT> m_order;
+		std::vector<UINT64> m_sortKeys;
+		std::vector<UINT> m_sortOrder;
+
+		IdTable<const void*> m_ids;
+		IdTable<std::pair<const void*, const void*>> m_shaderIds;
+		UINT m_frame;
+
+		RenderQueueStats m_stats;
+	};
+}
@@ -0,0 +1,564 @@
+#include "pch.h"
+#include "SceneBvh.h"
+#include "Common/MathHelper.h"
+#include <algorithm>
+#include <queue>
+#include <cfloat>
+
+using namespace DXFramework;
+using namespace DirectX;
+
+using namespace DX;
+
+static const UINT LeafSize = 4;
+static const UINT InvalidIndex = 0xffffffff;
+static const UINT AllPlanes = 0x3f;
+
+static LONGLONG GetTicks()
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+static double TicksToMs(LONGLONG ticks)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return ticks * 1000.0 / frequency.QuadPart;
+}
+
+// Spread the low 10 bits of v so that two zero bits follow every bit.
+static UINT ExpandBits(UINT v)
+{
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+// First index of the right half of [first, last): where the highest bit that differs
+// between the first and last code switches from 0 to 1.
+static UINT FindSplit(const std::vector<UINT64>& codes, UINT first, UINT last)
+{
+	UINT a = (UINT)(codes[first] >> 32);
+	UINT b = (UINT)(codes[last - 1] >> 32);
+	if (a == b)
+		return (first + last) / 2;
+
+	unsigned long bit;
+	_BitScanReverse(&bit, a ^ b);
+	UINT lo = first, hi = last - 1;
+	while (lo + 1 < hi)
+	{
+		UINT mid = (lo + hi) / 2;
+		if ((UINT)(codes[mid] >> 32) & (1u << bit))
+			hi = mid;
+		else
+			lo = mid;
+	}
+	return hi;
+}
+
+static void GetMinMax(const BoundingBox& box, float mn[3], float mx[3])
+{
+	mn[0] = box.Center.x - box.Extents.x; mx[0] = box.Center.x + box.Extents.x;
+	mn[1] = box.Center.y - box.Extents.y; mx[1] = box.Center.y + box.Extents.y;
+	mn[2] = box.Center.z - box.Extents.z; mx[2] = box.Center.z + box.Extents.z;
+}
+
+// -1 when the box is behind the plane, 1 when fully in front of it, 0 when it straddles.
+static int ClassifyBox(const float mn[3], const float mx[3], const XMFLOAT4& plane)
+{
+	float c[3] = { (mn[0] + mx[0]) * 0.5f, (mn[1] + mx[1]) * 0.5f, (mn[2] + mx[2]) * 0.5f };
+	float e[3] = { (mx[0] - mn[0]) * 0.5f, (mx[1] - mn[1]) * 0.5f, (mx[2] - mn[2]) * 0.5f };
+	float dist = plane.x * c[0] + plane.y * c[1] + plane.z * c[2] + plane.w;
+	float radius = fabsf(plane.x) * e[0] + fabsf(plane.y) * e[1] + fabsf(plane.z) * e[2];
+	if (dist < -radius)
+		return -1;
+	return dist >= radius ? 1 : 0;
+}
+
+// Planes of mask still to be tested. Returns false when the box is outside, and clears the
+// bits of planes the box lies fully in front of.
+static bool TestPlanes(const float mn[3], const float mx[3], const XMFLOAT4 planes[6], UINT& mask)
+{
+	for (UINT p = 0; p < 6; ++p)
+	{
+		if (!(mask & (1u << p)))
+			continue;
+		int side = ClassifyBox(mn, mx, planes[p]);
+		if (side < 0)
+			return false;
+		if (side > 0)
+			mask &= ~(1u << p);
+	}
+	return true;
+}
+
+static float DistanceSq(const float p[3], const float mn[3], const float mx[3])
+{
+	float distSq = 0.0f;
+	for (UINT k = 0; k < 3; ++k)
+	{
+		float d = MathHelper::Max(MathHelper::Max(mn[k] - p[k], p[k] - mx[k]), 0.0f);
+		distSq += d * d;
+	}
+	return distSq;
+}
+
+// Slab test clamped to [0, maxDist].
+static bool RayBox(const float o[3], const float invDir[3], const float mn[3], const float mx[3], float maxDist, float& tNear)
+{
+	float t0 = 0.0f, t1 = maxDist;
+	for (UINT k = 0; k < 3; ++k)
+	{
+		// Parallel to the slab. The products below would be 0 * inf = NaN for an origin on
+		// one of its planes, and NaN compares false everywhere.
+		if (!_finite(invDir[k]))
+		{
+			if (o[k] < mn[k] || o[k] > mx[k])
+				return false;
+			continue;
+		}
+		float ta = (mn[k] - o[k]) * invDir[k];
+		float tb = (mx[k] - o[k]) * invDir[k];
+		if (ta > tb)
+			std::swap(ta, tb);
+		t0 = MathHelper::Max(t0, ta);
+		t1 = MathHelper::Min(t1, tb);
+		if (t0 > t1)
+			return false;
+	}
+	tNear = t0;
+	return true;
+}
+
+SceneBvh::SceneBvh() : m_needsBuild(false)
+{
+}
+
+SceneBvh::~SceneBvh()
+{
+	// The callbacks may call back into RemoveOwner, walk a copy.
+	auto owners = std::move(m_owners);
+	m_owners.clear();
+	for (auto& owner : owners)
+		owner.second();
+}
+
+void SceneBvh::AddOwner(void* owner, const std::function<void()>& onDestroyed)
+{
+	RemoveOwner(owner);
+	m_owners.push_back(std::make_pair(owner, onDestroyed));
+}
+
+void SceneBvh::RemoveOwner(void* owner)
+{
+	auto it = std::find_if(m_owners.begin(), m_owners.end(),
+		[owner](const std::pair<void*, std::function<void()>>& entry) { return entry.first == owner; });
+	if (it != m_owners.end())
+		m_owners.erase(it);
+}
+
+UINT SceneBvh::Insert(const BoundingBox& worldBox, const SceneBvhItem& item)
+{
+	UINT id;
+	if (!m_freeItems.empty())
+	{
+		id = m_freeItems.back();
+		m_freeItems.pop_back();
+	}
+	else
+	{
+		id = m_items.size();
+		m_items.push_back(ItemEntry());
+	}
+
+	ItemEntry& entry = m_items[id];
+	entry.Bounds = worldBox;
+	entry.Item = item;
+	entry.Leaf = InvalidIndex;
+	entry.Alive = true;
+	entry.Dirty = false;
+	++m_stats.ItemCount;
+	m_needsBuild = true;
+	return id;
+}
+
+void SceneBvh::Remove(UINT id)
+{
+	if (!m_items[id].Alive)
+		return;
+	m_items[id].Alive = false;
+	m_freeItems.push_back(id);
+	--m_stats.ItemCount;
+	m_needsBuild = true;
+}
+
+void SceneBvh::Update(UINT id, const BoundingBox& worldBox)
+{
+	ItemEntry& entry = m_items[id];
+	entry.Bounds = worldBox;
+	if (!entry.Dirty)
+	{
+		entry.Dirty = true;
+		m_dirtyItems.push_back(id);
+	}
+}
+
+void SceneBvh::Build()
+{
+	LONGLONG start = GetTicks();
+
+	// Quantize the item centers to 10 bits per axis inside the bounds of all centers.
+	XMVECTOR minPoint = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxPoint = XMVectorReplicate(-FLT_MAX);
+	for (auto& entry : m_items)
+	{
+		if (!entry.Alive)
+			continue;
+		XMVECTOR center = XMLoadFloat3(&entry.Bounds.Center);
+		minPoint = XMVectorMin(minPoint, center);
+		maxPoint = XMVectorMax(maxPoint, center);
+	}
+	XMVECTOR scale = XMVectorDivide(XMVectorReplicate(1023.0f), XMVectorMax(XMVectorSubtract(maxPoint, minPoint), XMVectorReplicate(1e-6f)));
+
+	m_codes.clear();
+	for (UINT id = 0; id < m_items.size(); ++id)
+	{
+		ItemEntry& entry = m_items[id];
+		entry.Dirty = false;
+		entry.Leaf = InvalidIndex;
+		if (!entry.Alive)
+			continue;
+		XMVECTOR cell = XMVectorClamp(XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&entry.Bounds.Center), minPoint), scale),
+			XMVectorZero(), XMVectorReplicate(1023.0f));
+		XMUINT3 q;
+		XMStoreUInt3(&q, XMVectorTruncate(cell));
+		UINT code = (ExpandBits(q.x) << 2) | (ExpandBits(q.y) << 1) | ExpandBits(q.z);
+		m_codes.push_back(((UINT64)code << 32) | id);
+	}
+	std::sort(m_codes.begin(), m_codes.end());
+	m_dirtyItems.clear();
+
+	m_leafItems.resize(m_codes.size());
+	for (UINT i = 0; i < m_codes.size(); ++i)
+		m_leafItems[i] = (UINT)m_codes[i];
+
+	m_nodes.clear();
+	m_parents.clear();
+	if (!m_codes.empty())
+	{
+		m_nodes.reserve(m_codes.size() * 2);
+		m_parents.reserve(m_codes.size() * 2);
+		m_nodes.push_back(Node());
+		m_parents.push_back(InvalidIndex);
+		BuildRange(0, 0, m_codes.size());
+	}
+	m_nodeMarks.assign(m_nodes.size(), 0);
+
+	m_needsBuild = false;
+	m_stats.NodeCount = m_nodes.size();
+	m_stats.BuildMs = TicksToMs(GetTicks() - start);
+}
+
+void SceneBvh::BuildRange(UINT node, UINT first, UINT last)
+{
+	if (last - first <= LeafSize)
+	{
+		m_nodes[node].Left = first;
+		m_nodes[node].Count = last - first;
+		for (UINT i = first; i < last; ++i)
+			m_items[m_leafItems[i]].Leaf = node;
+		FitLeaf(node);
+		return;
+	}
+
+	// Children are allocated as a pair after their parent, so a reverse walk over the nodes
+	// always visits children first.
+	UINT split = FindSplit(m_codes, first, last);
+	UINT left = m_nodes.size();
+	m_nodes.resize(left + 2);
+	m_parents.resize(left + 2, node);
+	m_nodes[node].Left = left;
+	m_nodes[node].Count = 0;
+	BuildRange(left, first, split);
+	BuildRange(left + 1, split, last);
+	FitInner(node);
+}
+
+void SceneBvh::FitLeaf(UINT node)
+{
+	Node& n = m_nodes[node];
+	XMVECTOR minPoint = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxPoint = XMVectorReplicate(-FLT_MAX);
+	for (UINT i = n.Left; i < n.Left + n.Count; ++i)
+	{
+		const ItemEntry& entry = m_items[m_leafItems[i]];
+		// Removed items stay in their leaf until the next build
+		if (!entry.Alive)
+			continue;
+		XMVECTOR center = XMLoadFloat3(&entry.Bounds.Center);
+		XMVECTOR extents = XMLoadFloat3(&entry.Bounds.Extents);
+		minPoint = XMVectorMin(minPoint, XMVectorSubtract(center, extents));
+		maxPoint = XMVectorMax(maxPoint, XMVectorAdd(center, extents));
+	}
+	XMStoreFloat3(&n.Min, minPoint);
+	XMStoreFloat3(&n.Max, maxPoint);
+}
+
+void SceneBvh::FitInner(UINT node)
+{
+	Node& n = m_nodes[node];
+	const Node& a = m_nodes[n.Left];
+	const Node& b = m_nodes[n.Left + 1];
+	XMStoreFloat3(&n.Min, XMVectorMin(XMLoadFloat3(&a.Min), XMLoadFloat3(&b.Min)));
+	XMStoreFloat3(&n.Max, XMVectorMax(XMLoadFloat3(&a.Max), XMLoadFloat3(&b.Max)));
+}
+
+void SceneBvh::Refit()
+{
+	LONGLONG start = GetTicks();
+
+	// Mark the leaves of the moved items and every ancestor once, then fit the marked nodes
+	// children first. Shared ancestors are fitted a single time however many items moved.
+	m_refitNodes.clear();
+	for (UINT id : m_dirtyItems)
+	{
+		ItemEntry& entry = m_items[id];
+		entry.Dirty = false;
+		for (UINT node = entry.Leaf; node != InvalidIndex && !m_nodeMarks[node]; node = m_parents[node])
+		{
+			m_nodeMarks[node] = 1;
+			m_refitNodes.push_back(node);
+		}
+	}
+	std::sort(m_refitNodes.begin(), m_refitNodes.end());
+	for (auto it = m_refitNodes.rbegin(); it != m_refitNodes.rend(); ++it)
+	{
+		if (m_nodes[*it].Count > 0)
+			FitLeaf(*it);
+		else
+			FitInner(*it);
+		m_nodeMarks[*it] = 0;
+	}
+
+	m_stats.RefitItems = m_dirtyItems.size();
+	m_dirtyItems.clear();
+	m_stats.RefitMs = TicksToMs(GetTicks() - start);
+}
+
+void SceneBvh::Refresh()
+{
+	if (m_needsBuild)
+		Build();
+	else if (!m_dirtyItems.empty())
+		Refit();
+}
+
+void SceneBvh::QueryFrustum(const XMFLOAT4 planes[6], std::vector<UINT>& results)
+{
+	LONGLONG start = GetTicks();
+	UINT visited = 0;
+
+	m_stack.clear();
+	if (!m_nodes.empty())
+		m_stack.push_back((UINT64)AllPlanes << 32);
+	while (!m_stack.empty())
+	{
+		UINT node = (UINT)m_stack.back();
+		UINT mask = (UINT)(m_stack.back() >> 32);
+		m_stack.pop_back();
+		++visited;
+
+		const Node& n = m_nodes[node];
+		if (mask && !TestPlanes(&n.Min.x, &n.Max.x, planes, mask))
+			continue;
+		if (n.Count == 0)
+		{
+			m_stack.push_back(((UINT64)mask << 32) | (n.Left + 1));
+			m_stack.push_back(((UINT64)mask << 32) | n.Left);
+			continue;
+		}
+		for (UINT i = n.Left; i < n.Left + n.Count; ++i)
+		{
+			UINT id = m_leafItems[i];
+			const ItemEntry& entry = m_items[id];
+			if (!entry.Alive)
+				continue;
+			float mn[3], mx[3];
+			GetMinMax(entry.Bounds, mn, mx);
+			UINT itemMask = mask;
+			if (!itemMask || TestPlanes(mn, mx, planes, itemMask))
+				results.push_back(id);
+		}
+	}
+
+	m_stats.NodesVisited = visited;
+	m_stats.QueryMs = TicksToMs(GetTicks() - start);
+}
+
+void SceneBvh::QuerySphere(const BoundingSphere& sphere, std::vector<UINT>& results)
+{
+	LONGLONG start = GetTicks();
+	UINT visited = 0;
+	float center[3] = { sphere.Center.x, sphere.Center.y, sphere.Center.z };
+	float radiusSq = sphere.Radius * sphere.Radius;
+
+	m_stack.clear();
+	if (!m_nodes.empty())
+		m_stack.push_back(0);
+	while (!m_stack.empty())
+	{
+		const Node& n = m_nodes[(UINT)m_stack.back()];
+		m_stack.pop_back();
+		++visited;
+
+		if (DistanceSq(center, &n.Min.x, &n.Max.x) > radiusSq)
+			continue;
+		if (n.Count == 0)
+		{
+			m_stack.push_back(n.Left + 1);
+			m_stack.push_back(n.Left);
+			continue;
+		}
+		for (UINT i = n.Left; i < n.Left + n.Count; ++i)
+		{
+			UINT id = m_leafItems[i];
+			const ItemEntry& entry = m_items[id];
+			float mn[3], mx[3];
+			GetMinMax(entry.Bounds, mn, mx);
+			if (entry.Alive && DistanceSq(center, mn, mx) <= radiusSq)
+				results.push_back(id);
+		}
+	}
+
+	m_stats.NodesVisited = visited;
+	m_stats.QueryMs = TicksToMs(GetTicks() - start);
+}
+
+bool SceneBvh::Raycast(FXMVECTOR origin, FXMVECTOR direction, float maxDist, UINT& id, float& dist)
+{
+	LONGLONG start = GetTicks();
+	UINT visited = 0;
+	XMFLOAT3 o, invDir;
+	XMStoreFloat3(&o, origin);
+	XMStoreFloat3(&invDir, XMVectorReciprocal(direction));
+
+	// Closest first: the nearer child is pushed last, and nodes entered beyond the best
+	// hit so far are skipped when popped.
+	bool hit = false;
+	float best = maxDist;
+	float tNear;
+	m_stack.clear();
+	if (!m_nodes.empty() && RayBox(&o.x, &invDir.x, &m_nodes[0].Min.x, &m_nodes[0].Max.x, best, tNear))
+		m_stack.push_back(0);
+	while (!m_stack.empty())
+	{
+		const Node& n = m_nodes[(UINT)m_stack.back()];
+		m_stack.pop_back();
+		++visited;
+
+		if (!RayBox(&o.x, &invDir.x, &n.Min.x, &n.Max.x, best, tNear))
+			continue;
+		if (n.Count == 0)
+		{
+			float tLeft, tRight;
+			bool hitLeft = RayBox(&o.x, &invDir.x, &m_nodes[n.Left].Min.x, &m_nodes[n.Left].Max.x, best, tLeft);
+			bool hitRight = RayBox(&o.x, &invDir.x, &m_nodes[n.Left + 1].Min.x, &m_nodes[n.Left + 1].Max.x, best, tRight);
+			UINT nearNode = n.Left, farNode = n.Left + 1;
+			if (hitLeft && hitRight && tRight < tLeft)
+				std::swap(nearNode, farNode);
+			if (hitLeft && hitRight)
+			{
+				m_stack.push_back(farNode);
+				m_stack.push_back(nearNode);
+			}
+			else if (hitLeft)
+				m_stack.push_back(n.Left);
+			else if (hitRight)
+				m_stack.push_back(n.Left + 1);
+			continue;
+		}
+		for (UINT i = n.Left; i < n.Left + n.Count; ++i)
+		{
+			const ItemEntry& entry = m_items[m_leafItems[i]];
+			if (!entry.Alive)
+				continue;
+			float mn[3], mx[3];
+			GetMinMax(entry.Bounds, mn, mx);
+			if (RayBox(&o.x, &invDir.x, mn, mx, best, tNear))
+			{
+				best = tNear;
+				id = m_leafItems[i];
+				hit = true;
+			}
+		}
+	}
+	if (hit)
+		dist = best;
+
+	m_stats.NodesVisited = visited;
+	m_stats.QueryMs = TicksToMs(GetTicks() - start);
+	return hit;
+}
+
+void SceneBvh::QueryNearest(FXMVECTOR point, UINT k, std::vector<UINT>& results)
+{
+	LONGLONG start = GetTicks();
+	UINT visited = 0;
+	XMFLOAT3 p;
+	XMStoreFloat3(&p, point);
+
+	typedef std::pair<float, UINT> Entry;
+	// Nodes by distance, nearest on top, and the best k items so far, farthest on top.
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> nodes;
+	std::priority_queue<Entry> nearest;
+	if (!m_nodes.empty() && k > 0)
+		nodes.push(Entry(DistanceSq(&p.x, &m_nodes[0].Min.x, &m_nodes[0].Max.x), 0));
+	while (!nodes.empty())
+	{
+		Entry top = nodes.top();
+		nodes.pop();
+		if (nearest.size() == k && top.first >= nearest.top().first)
+			break;
+		++visited;
+
+		const Node& n = m_nodes[top.second];
+		if (n.Count == 0)
+		{
+			nodes.push(Entry(DistanceSq(&p.x, &m_nodes[n.Left].Min.x, &m_nodes[n.Left].Max.x), n.Left));
+			nodes.push(Entry(DistanceSq(&p.x, &m_nodes[n.Left + 1].Min.x, &m_nodes[n.Left + 1].Max.x), n.Left + 1));
+			continue;
+		}
+		for (UINT i = n.Left; i < n.Left + n.Count; ++i)
+		{
+			const ItemEntry& entry = m_items[m_leafItems[i]];
+			if (!entry.Alive)
+				continue;
+			float mn[3], mx[3];
+			GetMinMax(entry.Bounds, mn, mx);
+			float distSq = DistanceSq(&p.x, mn, mx);
+			if (nearest.size() < k)
+				nearest.push(Entry(distSq, m_leafItems[i]));
+			else if (distSq < nearest.top().first)
+			{
+				nearest.pop();
+				nearest.push(Entry(distSq, m_leafItems[i]));
+			}
+		}
+	}
+
+	size_t base = results.size();
+	results.resize(base + nearest.size());
+	for (size_t i = results.size(); i > base; --i)
+	{
+		results[i - 1] = nearest.top().second;
+		nearest.pop();
+	}
+
+	m_stats.NodesVisited = visited;
+	m_stats.QueryMs = TicksToMs(GetTicks() - start);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <functional>
+
+// Bounding volume hierarchy over world space instance bounds, shared by culling, picking
+// and gameplay queries. The tree is a linear BVH: items are sorted along a Morton curve of
+// their centers and split at the highest differing code bit. Moving items only refits the
+// boxes on their path to the root, inserting or removing items rebuilds on the next Refresh.
+
+namespace DXFramework
+{
+	// Who owns an item, filled by the caller. BasicObject uses Group for the unit and Index for
+	// the instance, MeshObject only Index.
+	struct SceneBvhItem
+	{
+		SceneBvhItem() : Owner(nullptr), Group(0), Index(0) {}
+		SceneBvhItem(void* owner, UINT group, UINT index) : Owner(owner), Group(group), Index(index) {}
+
+		void* Owner;
+		UINT Group;
+		UINT Index;
+	};
+
+	struct SceneBvhStats
+	{
+		SceneBvhStats() : BuildMs(0.0), RefitMs(0.0), QueryMs(0.0), NodeCount(0), ItemCount(0),
+			RefitItems(0), NodesVisited(0) {}
+
+		// Timing of the last build, the last refit and the last query
+		double BuildMs;
+		double RefitMs;
+		double QueryMs;
+		UINT NodeCount;
+		UINT ItemCount;
+		UINT RefitItems;
+		UINT NodesVisited;
+	};
+
+	class SceneBvh
+	{
+	public:
+		SceneBvh();
+		~SceneBvh();
+
+		// Returns the item id used by every other call and returned by the queries.
+		UINT Insert(const DirectX::BoundingBox& worldBox, const SceneBvhItem& item);
+		void Remove(UINT id);
+		// New world bounds of an item. Applied by the next Refit or Refresh.
+		void Update(UINT id, const DirectX::BoundingBox& worldBox);
+		const SceneBvhItem& GetItem(UINT id)const { return m_items[id].Item; }
+		const DirectX::BoundingBox& GetBounds(UINT id)const { return m_items[id].Bounds; }
+
+		// Objects that keep a pointer to the BVH register a callback that drops it. The
+		// destructor calls the callbacks of the owners still attached.
+		void AddOwner(void* owner, const std::function<void()>& onDestroyed);
+		void RemoveOwner(void* owner);
+
+		void Build();
+		// Refit the boxes above the items updated since the last build or refit.
+		void Refit();
+		// Build when items were inserted or removed, refit otherwise. Call once per frame.
+		void Refresh();
+
+		// Queries append item ids to results.
+		// planes are the normalized inward planes of DX::ExtractFrustumPlanes.
+		void QueryFrustum(const DirectX::XMFLOAT4 planes[6], std::vector<UINT>& results);
+		void QuerySphere(const DirectX::BoundingSphere& sphere, std::vector<UINT>& results);
+		// Closest item whose box the ray hits within maxDist. direction must be normalized.
+		bool Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float maxDist, UINT& id, float& dist);
+		// The k items whose boxes are closest to point, nearest first.
+		void QueryNearest(DirectX::FXMVECTOR point, UINT k, std::vector<UINT>& results);
+
+		const SceneBvhStats& GetStats()const { return m_stats; }
+		UINT GetItemCount()const { return m_stats.ItemCount; }
+
+	private:
+		struct Node
+		{
+			DirectX::XMFLOAT3 Min;
+			UINT Left;		// First child, the second one follows it. First leaf item when Count > 0.
+			DirectX::XMFLOAT3 Max;
+			UINT Count;		// Items of a leaf, 0 for inner nodes
+		};
+
+		struct ItemEntry
+		{
+			DirectX::BoundingBox Bounds;
+			SceneBvhItem Item;
+			UINT Leaf;
+			bool Alive;
+			bool Dirty;
+		};
+
+		void BuildRange(UINT node, UINT first, UINT last);
+		void FitLeaf(UINT node);
+		void FitInner(UINT node);
+
+	private:
+		std::vector<ItemEntry> m_items;
+		std::vector<UINT> m_freeItems;
+		std::vector<UINT> m_dirtyItems;
+		std::vector<std::pair<void*, std::function<void()>>> m_owners;
+
+		std::vector<Node> m_nodes;
+		std::vector<UINT> m_parents;
+		std::vector<UINT> m_leafItems;
+		// Sorted (morton code << 32 | item id) during a build
+		std::vector<UINT64> m_codes;
+		// Traversal stack entries (plane mask << 32 | node) and refit marks
+		std::vector<UINT64> m_stack;
+		std::vector<UINT8> m_nodeMarks;
+		std::vector<UINT> m_refitNodes;
+
+		bool m_needsBuild;
+		SceneBvhStats m_stats;
+	};
+}
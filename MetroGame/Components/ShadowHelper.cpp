@@ -80,12 +80,13 @@ void ShadowHelper::Render(const std::function<void()>& DrawMap)
 		return;
 
 	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	StateTracker* tracker = m_deviceResources->GetStateTracker();
 
 	context->RSSetViewports(1, &m_viewport);
 	// Set null render target because we are only going to draw to depth buffer.
 	// Setting a null render target will disable color writes.
 	ID3D11RenderTargetView* renderTargets[1] = { nullptr };
-	context->OMSetRenderTargets(1, renderTargets, m_depthMapDSV.Get());
+	tracker->OMSetRenderTargets(1, renderTargets, m_depthMapDSV.Get());
 	context->ClearDepthStencilView(m_depthMapDSV.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 	
 	// Update per-frame constant buffer according to light
@@ -105,7 +106,7 @@ void ShadowHelper::Render(const std::function<void()>& DrawMap)
 	auto viewport = m_deviceResources->GetScreenViewport();
 	context->RSSetViewports(1, &viewport);
 	renderTargets[0] = m_deviceResources->GetBackBufferRenderTargetView();
-	context->OMSetRenderTargets(1, renderTargets, m_deviceResources->GetDepthStencilView());
+	tracker->OMSetRenderTargets(1, renderTargets, m_deviceResources->GetDepthStencilView());
 	context->ClearRenderTargetView(m_deviceResources->GetBackBufferRenderTargetView(), DirectX::Colors::Silver);
 	context->ClearDepthStencilView(m_deviceResources->GetDepthStencilView(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 	// Recovery per-frame constant buffer according to m_camera.
@@ -0,0 +1,973 @@
+#include "pch.h"
+#include "SkinnedData.h"
+#include "Common/MathHelper.h"
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+using namespace DXFramework;
+using namespace DirectX;
+
+using namespace DX;
+
+Keyframe::Keyframe()
+	: TimePos(0.0f),
+	Translation(0.0f, 0.0f, 0.0f),
+	Scale(1.0f, 1.0f, 1.0f),
+	RotationQuat(0.0f, 0.0f, 0.0f, 1.0f)
+{
+}
+
+Keyframe::~Keyframe()
+{
+}
+
+float BoneAnimation::GetStartTime()const
+{
+	// Keyframes are sorted by time, so first keyframe gives start time.
+	return Keyframes.front().TimePos;
+}
+
+float BoneAnimation::GetEndTime()const
+{
+	// Keyframes are sorted by time, so last keyframe gives end time.
+	float f = Keyframes.back().TimePos;
+
+	return f;
+}
+
+void BoneAnimation::Interpolate(float t, XMFLOAT4X4& M)const
+{
+	if (t <= Keyframes.front().TimePos)
+	{
+		XMVECTOR S = XMLoadFloat3(&Keyframes.front().Scale);
+		XMVECTOR P = XMLoadFloat3(&Keyframes.front().Translation);
+		XMVECTOR Q = XMLoadFloat4(&Keyframes.front().RotationQuat);
+
+		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+	}
+	else if (t >= Keyframes.back().TimePos)
+	{
+		XMVECTOR S = XMLoadFloat3(&Keyframes.back().Scale);
+		XMVECTOR P = XMLoadFloat3(&Keyframes.back().Translation);
+		XMVECTOR Q = XMLoadFloat4(&Keyframes.back().RotationQuat);
+
+		XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+	}
+	else
+	{
+		for (UINT i = 0; i < Keyframes.size() - 1; ++i)
+		{
+			if (t >= Keyframes[i].TimePos && t <= Keyframes[i + 1].TimePos)
+			{
+				float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i + 1].TimePos - Keyframes[i].TimePos);
+
+				XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
+				XMVECTOR s1 = XMLoadFloat3(&Keyframes[i + 1].Scale);
+
+				XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
+				XMVECTOR p1 = XMLoadFloat3(&Keyframes[i + 1].Translation);
+
+				XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
+				XMVECTOR q1 = XMLoadFloat4(&Keyframes[i + 1].RotationQuat);
+
+				XMVECTOR S = XMVectorLerp(s0, s1, lerpPercent);
+				XMVECTOR P = XMVectorLerp(p0, p1, lerpPercent);
+				XMVECTOR Q = XMQuaternionSlerp(q0, q1, lerpPercent);
+
+				XMVECTOR zero = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+				XMStoreFloat4x4(&M, XMMatrixAffineTransformation(S, zero, Q, P));
+
+				break;
+			}
+		}
+	}
+}
+
+void BoneAnimation::Interpolate(float t, XMFLOAT3& S, XMFLOAT3& P, XMFLOAT4& Q)const
+{
+	if (t <= Keyframes.front().TimePos)
+	{
+		S = Keyframes.front().Scale;
+		P = Keyframes.front().Translation;
+		Q = Keyframes.front().RotationQuat;
+	}
+	else if (t >= Keyframes.back().TimePos)
+	{
+		S = Keyframes.back().Scale;
+		P = Keyframes.back().Translation;
+		Q = Keyframes.back().RotationQuat;
+	}
+	else
+	{
+		for (UINT i = 0; i < Keyframes.size() - 1; ++i)
+		{
+			if (t >= Keyframes[i].TimePos && t <= Keyframes[i + 1].TimePos)
+			{
+				float lerpPercent = (t - Keyframes[i].TimePos) / (Keyframes[i + 1].TimePos - Keyframes[i].TimePos);
+
+				XMVECTOR s0 = XMLoadFloat3(&Keyframes[i].Scale);
+				XMVECTOR s1 = XMLoadFloat3(&Keyframes[i + 1].Scale);
+
+				XMVECTOR p0 = XMLoadFloat3(&Keyframes[i].Translation);
+				XMVECTOR p1 = XMLoadFloat3(&Keyframes[i + 1].Translation);
+
+				XMVECTOR q0 = XMLoadFloat4(&Keyframes[i].RotationQuat);
+				XMVECTOR q1 = XMLoadFloat4(&Keyframes[i + 1].RotationQuat);
+
+				XMStoreFloat3(&S, XMVectorLerp(s0, s1, lerpPercent));
+				XMStoreFloat3(&P, XMVectorLerp(p0, p1, lerpPercent));
+				XMStoreFloat4(&Q, XMQuaternionSlerp(q0, q1, lerpPercent));
+
+				break;
+			}
+		}
+	}
+}
+
+float AnimationClip::GetClipStartTime()const
+{
+	// Find smallest start time over all bones in this clip.
+	float t = MathHelper::Infinity;
+	for (UINT i = 0; i < BoneAnimations.size(); ++i)
+	{
+		t = MathHelper::Min(t, BoneAnimations[i].GetStartTime());
+	}
+
+	return t;
+}
+
+float AnimationClip::GetClipEndTime()const
+{
+	// Find largest end time over all bones in this clip.
+	float t = 0.0f;
+	for (UINT i = 0; i < BoneAnimations.size(); ++i)
+	{
+		t = MathHelper::Max(t, BoneAnimations[i].GetEndTime());
+	}
+
+	return t;
+}
+
+void AnimationClip::Interpolate(float t, std::vector<XMFLOAT4X4>& boneTransforms)const
+{
+	for (UINT i = 0; i < BoneAnimations.size(); ++i)
+	{
+		BoneAnimations[i].Interpolate(t, boneTransforms[i]);
+	}
+}
+
+// Write one bone's transform into its lane of a pose packet.
+static void StorePoseLane(BonePosePacket& packet, UINT lane, const XMFLOAT3& P, const XMFLOAT3& S, const XMFLOAT4& Q)
+{
+	(&packet.Tx.x)[lane] = P.x;
+	(&packet.Ty.x)[lane] = P.y;
+	(&packet.Tz.x)[lane] = P.z;
+	(&packet.Sx.x)[lane] = S.x;
+	(&packet.Sy.x)[lane] = S.y;
+	(&packet.Sz.x)[lane] = S.z;
+	(&packet.Qx.x)[lane] = Q.x;
+	(&packet.Qy.x)[lane] = Q.y;
+	(&packet.Qz.x)[lane] = Q.z;
+	(&packet.Qw.x)[lane] = Q.w;
+}
+
+const float SampledAnimationClip::DefaultSampleRate = 30.0f;
+
+SampledAnimationClip::SampledAnimationClip()
+	: m_startTime(0.0f), m_endTime(0.0f), m_sampleRate(DefaultSampleRate),
+	m_frameCount(0), m_boneCount(0), m_packetCount(0)
+{
+}
+
+void SampledAnimationClip::Build(const AnimationClip& clip, float sampleRate)
+{
+	m_boneCount = clip.BoneAnimations.size();
+	m_packetCount = GetPacketCount(m_boneCount);
+	m_sampleRate = sampleRate;
+	m_startTime = clip.GetClipStartTime();
+	m_endTime = clip.GetClipEndTime();
+	if (m_boneCount == 0)
+	{
+		m_frameCount = 0;
+		m_frames.clear();
+		return;
+	}
+
+	// Always keep the last key, even if the clip length is not a multiple of the frame step.
+	m_frameCount = (UINT)ceilf((m_endTime - m_startTime) * m_sampleRate) + 1;
+	m_frames.resize(m_frameCount * m_packetCount);
+
+	XMFLOAT3 S, P;
+	XMFLOAT4 Q;
+	for (UINT frame = 0; frame < m_frameCount; ++frame)
+	{
+		float t = MathHelper::Min(m_startTime + frame / m_sampleRate, m_endTime);
+		BonePosePacket* packets = &m_frames[frame * m_packetCount];
+		const BonePosePacket* prevPackets = frame > 0 ? packets - m_packetCount : nullptr;
+		for (UINT bone = 0; bone < m_packetCount * 4; ++bone)
+		{
+			if (bone < m_boneCount && !clip.BoneAnimations[bone].Keyframes.empty())
+			{
+				clip.BoneAnimations[bone].Interpolate(t, S, P, Q);
+			}
+			else
+			{
+				// Padding lanes and empty tracks hold the identity.
+				S = XMFLOAT3(1.0f, 1.0f, 1.0f);
+				P = XMFLOAT3(0.0f, 0.0f, 0.0f);
+				Q = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+			}
+
+			// Keep neighbouring frames in the same hemisphere so runtime nlerp needs no sign test.
+			if (prevPackets)
+			{
+				const BonePosePacket& prev = prevPackets[bone / 4];
+				UINT lane = bone % 4;
+				float dot = (&prev.Qx.x)[lane] * Q.x + (&prev.Qy.x)[lane] * Q.y
+					+ (&prev.Qz.x)[lane] * Q.z + (&prev.Qw.x)[lane] * Q.w;
+				if (dot < 0.0f)
+					Q = XMFLOAT4(-Q.x, -Q.y, -Q.z, -Q.w);
+			}
+			StorePoseLane(packets[bone / 4], bone % 4, P, S, Q);
+		}
+	}
+}
+
+void SampledAnimationClip::SamplePose(float t, BonePosePacket* pose)const
+{
+	if (m_frameCount == 0)
+		return;
+
+	float framePos = (MathHelper::Clamp(t, m_startTime, m_endTime) - m_startTime) * m_sampleRate;
+	UINT frame0 = MathHelper::Min((UINT)framePos, m_frameCount - 1);
+	UINT frame1 = MathHelper::Min(frame0 + 1, m_frameCount - 1);
+	XMVECTOR lerpPercent = XMVectorReplicate(framePos - (float)frame0);
+
+	const BonePosePacket* a = &m_frames[frame0 * m_packetCount];
+	const BonePosePacket* b = &m_frames[frame1 * m_packetCount];
+	for (UINT i = 0; i < m_packetCount; ++i)
+	{
+		XMStoreFloat4(&pose[i].Tx, XMVectorLerpV(XMLoadFloat4(&a[i].Tx), XMLoadFloat4(&b[i].Tx), lerpPercent));
+		XMStoreFloat4(&pose[i].Ty, XMVectorLerpV(XMLoadFloat4(&a[i].Ty), XMLoadFloat4(&b[i].Ty), lerpPercent));
+		XMStoreFloat4(&pose[i].Tz, XMVectorLerpV(XMLoadFloat4(&a[i].Tz), XMLoadFloat4(&b[i].Tz), lerpPercent));
+		XMStoreFloat4(&pose[i].Sx, XMVectorLerpV(XMLoadFloat4(&a[i].Sx), XMLoadFloat4(&b[i].Sx), lerpPercent));
+		XMStoreFloat4(&pose[i].Sy, XMVectorLerpV(XMLoadFloat4(&a[i].Sy), XMLoadFloat4(&b[i].Sy), lerpPercent));
+		XMStoreFloat4(&pose[i].Sz, XMVectorLerpV(XMLoadFloat4(&a[i].Sz), XMLoadFloat4(&b[i].Sz), lerpPercent));
+
+		// Frames are densely sampled and sign aligned, so nlerp is close enough to slerp.
+		XMVECTOR qx = XMVectorLerpV(XMLoadFloat4(&a[i].Qx), XMLoadFloat4(&b[i].Qx), lerpPercent);
+		XMVECTOR qy = XMVectorLerpV(XMLoadFloat4(&a[i].Qy), XMLoadFloat4(&b[i].Qy), lerpPercent);
+		XMVECTOR qz = XMVectorLerpV(XMLoadFloat4(&a[i].Qz), XMLoadFloat4(&b[i].Qz), lerpPercent);
+		XMVECTOR qw = XMVectorLerpV(XMLoadFloat4(&a[i].Qw), XMLoadFloat4(&b[i].Qw), lerpPercent);
+		XMVECTOR lengthSq = XMVectorMultiply(qx, qx);
+		lengthSq = XMVectorMultiplyAdd(qy, qy, lengthSq);
+		lengthSq = XMVectorMultiplyAdd(qz, qz, lengthSq);
+		lengthSq = XMVectorMultiplyAdd(qw, qw, lengthSq);
+		XMVECTOR invLength = XMVectorReciprocalSqrt(lengthSq);
+		XMStoreFloat4(&pose[i].Qx, XMVectorMultiply(qx, invLength));
+		XMStoreFloat4(&pose[i].Qy, XMVectorMultiply(qy, invLength));
+		XMStoreFloat4(&pose[i].Qz, XMVectorMultiply(qz, invLength));
+		XMStoreFloat4(&pose[i].Qw, XMVectorMultiply(qw, invLength));
+	}
+}
+
+void SampledAnimationClip::BuildTransforms(const BonePosePacket* pose, UINT boneCount, XMFLOAT4X4* boneTransforms,
+	const UINT8* packetSkip /* = nullptr */)
+{
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR two = XMVectorReplicate(2.0f);
+	XMVECTOR zero = XMVectorZero();
+	XMFLOAT4X4 packed[4];
+
+	UINT packetCount = GetPacketCount(boneCount);
+	for (UINT i = 0; i < packetCount; ++i)
+	{
+		if (packetSkip && packetSkip[i])
+			continue;
+
+		const BonePosePacket& p = pose[i];
+		XMVECTOR qx = XMLoadFloat4(&p.Qx);
+		XMVECTOR qy = XMLoadFloat4(&p.Qy);
+		XMVECTOR qz = XMLoadFloat4(&p.Qz);
+		XMVECTOR qw = XMLoadFloat4(&p.Qw);
+		XMVECTOR sx = XMLoadFloat4(&p.Sx);
+		XMVECTOR sy = XMLoadFloat4(&p.Sy);
+		XMVECTOR sz = XMLoadFloat4(&p.Sz);
+
+		XMVECTOR xx = XMVectorMultiply(qx, qx), yy = XMVectorMultiply(qy, qy), zz = XMVectorMultiply(qz, qz);
+		XMVECTOR xy = XMVectorMultiply(qx, qy), xz = XMVectorMultiply(qx, qz), yz = XMVectorMultiply(qy, qz);
+		XMVECTOR wx = XMVectorMultiply(qw, qx), wy = XMVectorMultiply(qw, qy), wz = XMVectorMultiply(qw, qz);
+
+		// Same layout as XMMatrixAffineTransformation(S, 0, Q, T): scaled rotation rows plus translation.
+		XMMATRIX rows[4];
+		rows[0].r[0] = XMVectorMultiply(sx, XMVectorNegativeMultiplySubtract(two, XMVectorAdd(yy, zz), one));
+		rows[0].r[1] = XMVectorMultiply(sx, XMVectorMultiply(two, XMVectorAdd(xy, wz)));
+		rows[0].r[2] = XMVectorMultiply(sx, XMVectorMultiply(two, XMVectorSubtract(xz, wy)));
+		rows[0].r[3] = zero;
+		rows[1].r[0] = XMVectorMultiply(sy, XMVectorMultiply(two, XMVectorSubtract(xy, wz)));
+		rows[1].r[1] = XMVectorMultiply(sy, XMVectorNegativeMultiplySubtract(two, XMVectorAdd(xx, zz), one));
+		rows[1].r[2] = XMVectorMultiply(sy, XMVectorMultiply(two, XMVectorAdd(yz, wx)));
+		rows[1].r[3] = zero;
+		rows[2].r[0] = XMVectorMultiply(sz, XMVectorMultiply(two, XMVectorAdd(xz, wy)));
+		rows[2].r[1] = XMVectorMultiply(sz, XMVectorMultiply(two, XMVectorSubtract(yz, wx)));
+		rows[2].r[2] = XMVectorMultiply(sz, XMVectorNegativeMultiplySubtract(two, XMVectorAdd(xx, yy), one));
+		rows[2].r[3] = zero;
+		rows[3].r[0] = XMLoadFloat4(&p.Tx);
+		rows[3].r[1] = XMLoadFloat4(&p.Ty);
+		rows[3].r[2] = XMLoadFloat4(&p.Tz);
+		rows[3].r[3] = one;
+
+		// Transposing a row group turns the four lanes into that row of each of the four bones.
+		XMMATRIX r0 = XMMatrixTranspose(rows[0]);
+		XMMATRIX r1 = XMMatrixTranspose(rows[1]);
+		XMMATRIX r2 = XMMatrixTranspose(rows[2]);
+		XMMATRIX r3 = XMMatrixTranspose(rows[3]);
+
+		UINT base = i * 4;
+		UINT count = MathHelper::Min(4u, boneCount - base);
+		XMFLOAT4X4* dest = count == 4 ? &boneTransforms[base] : packed;
+		for (UINT lane = 0; lane < 4; ++lane)
+			XMStoreFloat4x4(&dest[lane], XMMATRIX(r0.r[lane], r1.r[lane], r2.r[lane], r3.r[lane]));
+		if (count < 4)
+		{
+			for (UINT lane = 0; lane < count; ++lane)
+				boneTransforms[base + lane] = packed[lane];
+		}
+	}
+}
+
+// Smallest-three quaternion packing: the largest component is dropped (and made positive,
+// since q and -q are the same rotation), the other three use 15 bits each over
+// [-1/sqrt(2), 1/sqrt(2)]. The two bit index of the dropped component lives in the top
+// bits of the first two words.
+static const float QuatComponentRange = 0.70710678f;
+
+static void PackQuaternion(const XMFLOAT4& q, UINT16 data[3])
+{
+	const float* c = &q.x;
+	UINT largest = 0;
+	for (UINT i = 1; i < 4; ++i)
+		if (fabsf(c[i]) > fabsf(c[largest]))
+			largest = i;
+	float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+
+	UINT k = 0;
+	for (UINT i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+		float v = MathHelper::Clamp(c[i] * sign, -QuatComponentRange, QuatComponentRange);
+		data[k++] = (UINT16)((v + QuatComponentRange) / (2.0f * QuatComponentRange) * 32767.0f + 0.5f);
+	}
+	data[0] |= (UINT16)((largest & 1) << 15);
+	data[1] |= (UINT16)((largest >> 1) << 15);
+}
+
+static XMFLOAT4 UnpackQuaternion(const UINT16 data[3])
+{
+	UINT largest = (data[0] >> 15) | ((data[1] >> 15) << 1);
+	float v[3];
+	for (UINT i = 0; i < 3; ++i)
+		v[i] = (data[i] & 0x7fff) * (2.0f * QuatComponentRange / 32767.0f) - QuatComponentRange;
+
+	XMFLOAT4 q;
+	float* c = &q.x;
+	UINT k = 0;
+	for (UINT i = 0; i < 4; ++i)
+	{
+		if (i != largest)
+			c[i] = v[k++];
+	}
+	c[largest] = sqrtf(MathHelper::Max(0.0f, 1.0f - v[0] * v[0] - v[1] * v[1] - v[2] * v[2]));
+	return q;
+}
+
+static XMFLOAT3 LerpFloat3(const XMFLOAT3& a, const XMFLOAT3& b, float t)
+{
+	return XMFLOAT3(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+}
+
+static XMFLOAT4 NlerpQuaternion(const XMFLOAT4& a, const XMFLOAT4& b, float t)
+{
+	// Packed keys are not sign aligned, so pick the short way here.
+	float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+	float s = dot < 0.0f ? -1.0f : 1.0f;
+	XMFLOAT4 q(
+		a.x + (s * b.x - a.x) * t,
+		a.y + (s * b.y - a.y) * t,
+		a.z + (s * b.z - a.z) * t,
+		a.w + (s * b.w - a.w) * t);
+	float invLength = 1.0f / sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+	q.x *= invLength;
+	q.y *= invLength;
+	q.z *= invLength;
+	q.w *= invLength;
+	return q;
+}
+
+static float MaxAbsDifference(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return MathHelper::Max(fabsf(a.x - b.x), MathHelper::Max(fabsf(a.y - b.y), fabsf(a.z - b.z)));
+}
+
+static float Distance(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	float x = a.x - b.x, y = a.y - b.y, z = a.z - b.z;
+	return sqrtf(x * x + y * y + z * z);
+}
+
+// Displacement of a point at the given radius when rotated by a instead of b.
+static float RotationError(const XMFLOAT4& a, const XMFLOAT4& b, float radius)
+{
+	float dot = MathHelper::Min(1.0f, fabsf(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w));
+	return 2.0f * radius * sqrtf(1.0f - dot * dot);
+}
+
+// Greedy key reduction. Starting from the last kept key, extend the linear segment as far as
+// every skipped key stays within tolerance. The first and last keys are always kept, and a
+// track whose keys all lie within tolerance of the first one collapses to that key.
+// values are the keys as they will be stored, source the keys they were made from; segments
+// interpolate the stored keys and are measured against the source ones.
+template<typename T, typename LerpFunc, typename ErrorFunc>
+static void ReduceKeys(const std::vector<float>& times, const std::vector<T>& values, const std::vector<T>& source,
+	float tolerance, LerpFunc lerp, ErrorFunc error, std::vector<UINT>& kept)
+{
+	UINT count = values.size();
+	kept.clear();
+	kept.push_back(0);
+
+	bool constant = true;
+	for (UINT i = 1; i < count && constant; ++i)
+		constant = error(values[0], source[i]) <= tolerance;
+	if (constant)
+		return;
+
+	UINT anchor = 0;
+	for (UINT end = 2; end < count; ++end)
+	{
+		float span = times[end] - times[anchor];
+		for (UINT k = anchor + 1; k < end; ++k)
+		{
+			float f = span > 0.0f ? (times[k] - times[anchor]) / span : 0.0f;
+			if (error(lerp(values[anchor], values[end], f), source[k]) > tolerance)
+			{
+				anchor = end - 1;
+				kept.push_back(anchor);
+				break;
+			}
+		}
+	}
+	kept.push_back(count - 1);
+}
+
+// Index of the segment [i, i + 1] containing u, for a track with at least two keys.
+static UINT FindKey(const UINT16* times, UINT count, float u)
+{
+	const UINT16* it = std::upper_bound(times, times + count, u, [](float value, UINT16 time) { return value < time; });
+	UINT index = (UINT)(it - times);
+	return MathHelper::Clamp(index, 1u, count - 1) - 1;
+}
+
+CompressedAnimationClip::CompressedAnimationClip()
+	: m_startTime(0.0f), m_endTime(0.0f), m_timeScale(0.0f)
+{
+}
+
+void CompressedAnimationClip::Build(const AnimationClip& clip, const std::vector<float>& boneRadii,
+	const AnimationCompressionSettings& settings)
+{
+	m_startTime = clip.GetClipStartTime();
+	m_endTime = clip.GetClipEndTime();
+	m_timeScale = m_endTime > m_startTime ? 65535.0f / (m_endTime - m_startTime) : 0.0f;
+	m_bones.resize(clip.BoneAnimations.size());
+	m_vectorTimes.clear();
+	m_vectorKeys.clear();
+	m_rotationTimes.clear();
+	m_rotationKeys.clear();
+
+	// Translation, scale and rotation each get a third of the budget, so their sum stays in bounds.
+	float tolerance = settings.Tolerance / 3.0f;
+
+	std::vector<float> times;
+	std::vector<XMFLOAT3> translations, scales;
+	std::vector<XMFLOAT4> rotations, sourceRotations;
+	std::vector<PackedQuaternion> packed;
+	std::vector<UINT> kept;
+	for (UINT bone = 0; bone < m_bones.size(); ++bone)
+	{
+		const std::vector<Keyframe>& keys = clip.BoneAnimations[bone].Keyframes;
+		float radius = bone < boneRadii.size() ? boneRadii[bone] : 0.0f;
+		BoneTracks& tracks = m_bones[bone];
+		if (keys.empty())
+		{
+			// Identity tracks
+			Keyframe identity;
+			tracks.Translation.KeyStart = m_vectorKeys.size();
+			tracks.Translation.KeyCount = 1;
+			m_vectorKeys.push_back(identity.Translation);
+			m_vectorTimes.push_back(0);
+			tracks.Scale.KeyStart = m_vectorKeys.size();
+			tracks.Scale.KeyCount = 1;
+			m_vectorKeys.push_back(identity.Scale);
+			m_vectorTimes.push_back(0);
+			PackedQuaternion q;
+			PackQuaternion(identity.RotationQuat, q.Data);
+			tracks.Rotation.KeyStart = m_rotationKeys.size();
+			tracks.Rotation.KeyCount = 1;
+			m_rotationKeys.push_back(q);
+			m_rotationTimes.push_back(0);
+			continue;
+		}
+
+		times.resize(keys.size());
+		translations.resize(keys.size());
+		scales.resize(keys.size());
+		rotations.resize(keys.size());
+		sourceRotations.resize(keys.size());
+		packed.resize(keys.size());
+		for (UINT i = 0; i < keys.size(); ++i)
+		{
+			times[i] = keys[i].TimePos;
+			translations[i] = keys[i].Translation;
+			scales[i] = keys[i].Scale;
+			// Segments run between the quantized rotations, so skipped keys include the packing
+			// error. A kept key is off its source by the packing error alone.
+			XMStoreFloat4(&sourceRotations[i], XMQuaternionNormalize(XMLoadFloat4(&keys[i].RotationQuat)));
+			PackQuaternion(sourceRotations[i], packed[i].Data);
+			rotations[i] = UnpackQuaternion(packed[i].Data);
+		}
+
+		auto storeVectorTrack = [&](Track& track, const std::vector<XMFLOAT3>& values)
+		{
+			track.KeyStart = m_vectorKeys.size();
+			track.KeyCount = kept.size();
+			for (UINT k : kept)
+			{
+				m_vectorKeys.push_back(values[k]);
+				m_vectorTimes.push_back((UINT16)((times[k] - m_startTime) * m_timeScale + 0.5f));
+			}
+		};
+
+		ReduceKeys(times, translations, translations, tolerance, LerpFloat3,
+			[](const XMFLOAT3& a, const XMFLOAT3& b) { return Distance(a, b); }, kept);
+		storeVectorTrack(tracks.Translation, translations);
+
+		ReduceKeys(times, scales, scales, tolerance, LerpFloat3,
+			[=](const XMFLOAT3& a, const XMFLOAT3& b) { return radius * MaxAbsDifference(a, b); }, kept);
+		storeVectorTrack(tracks.Scale, scales);
+
+		ReduceKeys(times, rotations, sourceRotations, tolerance, NlerpQuaternion,
+			[=](const XMFLOAT4& a, const XMFLOAT4& b) { return RotationError(a, b, radius); }, kept);
+		tracks.Rotation.KeyStart = m_rotationKeys.size();
+		tracks.Rotation.KeyCount = kept.size();
+		for (UINT k : kept)
+		{
+			m_rotationKeys.push_back(packed[k]);
+			m_rotationTimes.push_back((UINT16)((times[k] - m_startTime) * m_timeScale + 0.5f));
+		}
+	}
+}
+
+size_t CompressedAnimationClip::GetMemorySize()const
+{
+	return sizeof(*this) + m_bones.size() * sizeof(BoneTracks)
+		+ m_vectorTimes.size() * sizeof(UINT16) + m_vectorKeys.size() * sizeof(XMFLOAT3)
+		+ m_rotationTimes.size() * sizeof(UINT16) + m_rotationKeys.size() * sizeof(PackedQuaternion);
+}
+
+void CompressedAnimationClip::SampleVector(const Track& track, float u, XMFLOAT3& value)const
+{
+	const XMFLOAT3* keys = &m_vectorKeys[track.KeyStart];
+	if (track.KeyCount == 1)
+	{
+		value = keys[0];
+		return;
+	}
+
+	const UINT16* times = &m_vectorTimes[track.KeyStart];
+	UINT i = FindKey(times, track.KeyCount, u);
+	float span = (float)(times[i + 1] - times[i]);
+	float f = span > 0.0f ? MathHelper::Clamp((u - times[i]) / span, 0.0f, 1.0f) : 0.0f;
+	value = LerpFloat3(keys[i], keys[i + 1], f);
+}
+
+void CompressedAnimationClip::SampleRotation(const Track& track, float u, XMFLOAT4& value)const
+{
+	const PackedQuaternion* keys = &m_rotationKeys[track.KeyStart];
+	if (track.KeyCount == 1)
+	{
+		value = UnpackQuaternion(keys[0].Data);
+		return;
+	}
+
+	const UINT16* times = &m_rotationTimes[track.KeyStart];
+	UINT i = FindKey(times, track.KeyCount, u);
+	float span = (float)(times[i + 1] - times[i]);
+	float f = span > 0.0f ? MathHelper::Clamp((u - times[i]) / span, 0.0f, 1.0f) : 0.0f;
+	value = NlerpQuaternion(UnpackQuaternion(keys[i].Data), UnpackQuaternion(keys[i + 1].Data), f);
+}
+
+void CompressedAnimationClip::SamplePose(float t, BonePosePacket* pose)const
+{
+	float u = (MathHelper::Clamp(t, m_startTime, m_endTime) - m_startTime) * m_timeScale;
+
+	XMFLOAT3 P, S;
+	XMFLOAT4 Q;
+	UINT boneCount = m_bones.size();
+	UINT laneCount = SampledAnimationClip::GetPacketCount(boneCount) * 4;
+	for (UINT bone = 0; bone < laneCount; ++bone)
+	{
+		if (bone < boneCount)
+		{
+			const BoneTracks& tracks = m_bones[bone];
+			SampleVector(tracks.Translation, u, P);
+			SampleVector(tracks.Scale, u, S);
+			SampleRotation(tracks.Rotation, u, Q);
+		}
+		else
+		{
+			P = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			S = XMFLOAT3(1.0f, 1.0f, 1.0f);
+			Q = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+		StorePoseLane(pose[bone / 4], bone % 4, P, S, Q);
+	}
+}
+
+template<typename T>
+static void WriteVector(std::ostream& out, const std::vector<T>& data)
+{
+	UINT count = data.size();
+	out.write((const char*)&count, sizeof(UINT));
+	if (count > 0)
+		out.write((const char*)&data[0], count * sizeof(T));
+}
+
+template<typename T>
+static void ReadVector(std::istream& in, std::vector<T>& data)
+{
+	UINT count = 0;
+	in.read((char*)&count, sizeof(UINT));
+
+	// Check the count against the rest of the stream before allocating for it.
+	std::streampos pos = in.tellg();
+	in.seekg(0, std::ios::end);
+	std::streampos end = in.tellg();
+	in.seekg(pos);
+	if (!in || pos < 0 || (UINT64)count * sizeof(T) > (UINT64)(end - pos))
+		throw std::runtime_error("Corrupted compressed animation clip!");
+
+	data.resize(count);
+	if (count > 0)
+		in.read((char*)&data[0], count * sizeof(T));
+}
+
+void CompressedAnimationClip::Write(std::ostream& out)const
+{
+	out.write((const char*)&m_startTime, sizeof(float));
+	out.write((const char*)&m_endTime, sizeof(float));
+	out.write((const char*)&m_timeScale, sizeof(float));
+	WriteVector(out, m_bones);
+	WriteVector(out, m_vectorTimes);
+	WriteVector(out, m_vectorKeys);
+	WriteVector(out, m_rotationTimes);
+	WriteVector(out, m_rotationKeys);
+}
+
+void CompressedAnimationClip::Read(std::istream& in)
+{
+	in.read((char*)&m_startTime, sizeof(float));
+	in.read((char*)&m_endTime, sizeof(float));
+	in.read((char*)&m_timeScale, sizeof(float));
+	ReadVector(in, m_bones);
+	ReadVector(in, m_vectorTimes);
+	ReadVector(in, m_vectorKeys);
+	ReadVector(in, m_rotationTimes);
+	ReadVector(in, m_rotationKeys);
+	if (!in)
+		throw std::runtime_error("Can not read compressed animation clip!");
+
+	// Validate track ranges so a bad file can not index out of bounds. Written as subtractions,
+	// KeyStart + KeyCount may wrap.
+	auto isValid = [](const Track& track, size_t keyCount)
+	{
+		return track.KeyCount != 0 && track.KeyStart <= keyCount && track.KeyCount <= keyCount - track.KeyStart;
+	};
+	if (m_vectorTimes.size() != m_vectorKeys.size() || m_rotationTimes.size() != m_rotationKeys.size())
+		throw std::runtime_error("Corrupted compressed animation clip!");
+	for (auto& tracks : m_bones)
+	{
+		if (!isValid(tracks.Translation, m_vectorKeys.size()) || !isValid(tracks.Scale, m_vectorKeys.size())
+			|| !isValid(tracks.Rotation, m_rotationKeys.size()))
+			throw std::runtime_error("Corrupted compressed animation clip!");
+	}
+}
+
+UINT SkinnedData::GetClipIndex(const std::wstring& clipName)const
+{
+	auto clip = m_clipIndices.find(clipName);
+	if (clip == m_clipIndices.end())
+		throw std::invalid_argument("No such animation data!");
+	return clip->second;
+}
+
+float SkinnedData::GetClipStartTime(const std::wstring& clipName)const
+{
+	return GetClipStartTime(GetClipIndex(clipName));
+}
+
+float SkinnedData::GetClipEndTime(const std::wstring& clipName)const
+{
+	return GetClipEndTime(GetClipIndex(clipName));
+}
+
+void BoneLodMap::Build(const std::vector<int>& proxyBones)
+{
+	UINT boneCount = proxyBones.size();
+	m_proxies.resize(boneCount);
+	m_foldedBones.clear();
+	for (UINT i = 0; i < boneCount; ++i)
+	{
+		// Follow the chain up to a kept bone. A chain longer than the bone count is a cycle.
+		int bone = i;
+		UINT steps = 0;
+		while (proxyBones[bone] >= 0)
+		{
+			bone = proxyBones[bone];
+			if (bone >= (int)boneCount || ++steps > boneCount)
+				throw std::invalid_argument("Invalid proxy bone!");
+		}
+		m_proxies[i] = bone;
+		if (bone != (int)i)
+			m_foldedBones.push_back(i);
+	}
+
+	UINT packetCount = SampledAnimationClip::GetPacketCount(boneCount);
+	m_packetSkip.assign(packetCount, 1);
+	for (UINT i = 0; i < boneCount; ++i)
+	{
+		if (m_proxies[i] == i)
+			m_packetSkip[i / 4] = 0;
+	}
+}
+
+UINT SkinnedData::GetBoneCount()const
+{
+	return m_boneOffsets.size();
+}
+
+void SkinnedData::Initialize(std::vector<XMFLOAT4X4>& boneOffsets,
+	std::map<std::wstring, AnimationClip>& animations, float sampleRate)
+{
+	m_boneOffsets = boneOffsets;
+	m_compressed = false;
+
+	m_clipIndices.clear();
+	m_clipTimes.clear();
+	m_compressedClips.clear();
+	m_clips.clear();
+	m_clips.reserve(animations.size());
+	for (auto& item : animations)
+	{
+		m_clipIndices[item.first] = m_clips.size();
+		m_clips.push_back(SampledAnimationClip());
+		m_clips.back().Build(item.second, sampleRate);
+		m_clipTimes.push_back(XMFLOAT2(m_clips.back().GetClipStartTime(), m_clips.back().GetClipEndTime()));
+	}
+	BuildOffsetPose(animations);
+}
+
+void SkinnedData::InitializeCompressed(std::vector<XMFLOAT4X4>& boneOffsets,
+	std::map<std::wstring, AnimationClip>& animations, const std::vector<float>& boneRadii,
+	const AnimationCompressionSettings& settings)
+{
+	m_boneOffsets = boneOffsets;
+	m_compressed = true;
+
+	m_clipIndices.clear();
+	m_clipTimes.clear();
+	m_clips.clear();
+	m_compressedClips.clear();
+	m_compressedClips.reserve(animations.size());
+	for (auto& item : animations)
+	{
+		m_clipIndices[item.first] = m_compressedClips.size();
+		m_compressedClips.push_back(CompressedAnimationClip());
+		m_compressedClips.back().Build(item.second, boneRadii, settings);
+		m_clipTimes.push_back(XMFLOAT2(m_compressedClips.back().GetClipStartTime(), m_compressedClips.back().GetClipEndTime()));
+	}
+	BuildOffsetPose(animations);
+}
+
+static bool IsUnitScale(FXMVECTOR scale)
+{
+	return XMVector3NearEqual(scale, XMVectorSplatOne(), XMVectorReplicate(1e-3f));
+}
+
+void SkinnedData::BuildOffsetPose(const std::map<std::wstring, AnimationClip>& animations)
+{
+	m_hasScale = false;
+	UINT numBones = m_boneOffsets.size();
+	m_offsetPose.assign(SampledAnimationClip::GetPacketCount(numBones), BonePosePacket());
+	for (UINT i = 0; i < numBones; ++i)
+	{
+		XMVECTOR S, Q, T;
+		if (!XMMatrixDecompose(&S, &Q, &T, XMLoadFloat4x4(&m_boneOffsets[i])) || !IsUnitScale(S))
+			m_hasScale = true;
+		XMFLOAT3 P, unit(1.0f, 1.0f, 1.0f);
+		XMFLOAT4 R;
+		XMStoreFloat3(&P, T);
+		XMStoreFloat4(&R, XMQuaternionNormalize(Q));
+		StorePoseLane(m_offsetPose[i / 4], i % 4, P, unit, R);
+	}
+	// Padding lanes stay zero; their output is never stored.
+
+	for (auto& item : animations)
+	{
+		for (auto& bone : item.second.BoneAnimations)
+		{
+			for (auto& key : bone.Keyframes)
+			{
+				if (!IsUnitScale(XMLoadFloat3(&key.Scale)))
+					m_hasScale = true;
+			}
+		}
+	}
+}
+
+void SkinnedData::GetPose(UINT clipIndex, float timePos, BonePosePacket* pose)const
+{
+	if (m_compressed)
+		m_compressedClips[clipIndex].SamplePose(timePos, pose);
+	else
+		m_clips[clipIndex].SamplePose(timePos, pose);
+}
+
+void SkinnedData::GetFinalTransforms(UINT clipIndex, float timePos, XMFLOAT4X4* finalTransforms, BonePosePacket* poseScratch)const
+{
+	// Interpolate all the bones of this clip at the given time instance.
+	GetPose(clipIndex, timePos, poseScratch);
+	GetFinalTransforms(poseScratch, finalTransforms);
+}
+
+void SkinnedData::GetFinalTransforms(const BonePosePacket* pose, XMFLOAT4X4* finalTransforms,
+	const BoneLodMap* lod /* = nullptr */)const
+{
+	UINT numBones = m_boneOffsets.size();
+	if (lod && lod->IsEmpty())
+		lod = nullptr;
+	SampledAnimationClip::BuildTransforms(pose, numBones, finalTransforms, lod ? lod->GetPacketSkip() : nullptr);
+
+	// Premultiply by the bone offset transform to get the final transform.
+	for (UINT i = 0; i < numBones; ++i)
+	{
+		if (lod && lod->GetProxy(i) != i)
+			continue;
+		XMMATRIX offset = XMLoadFloat4x4(&m_boneOffsets[i]);
+		XMMATRIX bone = XMLoadFloat4x4(&finalTransforms[i]);
+		// Pre-transpose
+		XMStoreFloat4x4(&finalTransforms[i], XMMatrixTranspose(XMMatrixMultiply(offset, bone)));
+	}
+
+	if (lod)
+	{
+		for (UINT bone : lod->GetFoldedBones())
+			finalTransforms[bone] = finalTransforms[lod->GetProxy(bone)];
+	}
+}
+
+void SkinnedData::GetDualQuaternions(UINT clipIndex, float timePos, XMFLOAT4* dualQuaternions, BonePosePacket* poseScratch)const
+{
+	GetPose(clipIndex, timePos, poseScratch);
+	GetDualQuaternions(poseScratch, dualQuaternions);
+}
+
+void SkinnedData::GetDualQuaternions(const BonePosePacket* pose, XMFLOAT4* dualQuaternions)const
+{
+	UINT numBones = m_boneOffsets.size();
+	UINT packetCount = SampledAnimationClip::GetPacketCount(numBones);
+	XMVECTOR two = XMVectorReplicate(2.0f);
+	XMVECTOR half = XMVectorReplicate(0.5f);
+
+	for (UINT i = 0; i < packetCount; ++i)
+	{
+		const BonePosePacket& b = pose[i];
+		const BonePosePacket& o = m_offsetPose[i];
+		XMVECTOR bx = XMLoadFloat4(&b.Qx), by = XMLoadFloat4(&b.Qy), bz = XMLoadFloat4(&b.Qz), bw = XMLoadFloat4(&b.Qw);
+		XMVECTOR ox = XMLoadFloat4(&o.Qx), oy = XMLoadFloat4(&o.Qy), oz = XMLoadFloat4(&o.Qz), ow = XMLoadFloat4(&o.Qw);
+
+		// The offset applies first: rotation = bone * offset (Hamilton order).
+		XMVECTOR qx = XMVectorAdd(XMVectorMultiplyAdd(bw, ox, XMVectorMultiply(bx, ow)), XMVectorSubtract(XMVectorMultiply(by, oz), XMVectorMultiply(bz, oy)));
+		XMVECTOR qy = XMVectorAdd(XMVectorMultiplyAdd(bw, oy, XMVectorMultiply(by, ow)), XMVectorSubtract(XMVectorMultiply(bz, ox), XMVectorMultiply(bx, oz)));
+		XMVECTOR qz = XMVectorAdd(XMVectorMultiplyAdd(bw, oz, XMVectorMultiply(bz, ow)), XMVectorSubtract(XMVectorMultiply(bx, oy), XMVectorMultiply(by, ox)));
+		XMVECTOR qw = XMVectorSubtract(XMVectorMultiply(bw, ow), XMVectorMultiplyAdd(bx, ox, XMVectorMultiplyAdd(by, oy, XMVectorMultiply(bz, oz))));
+
+		// translation = rotate(bone, offset translation) + bone translation,
+		// with rotate(q, v) = v + w * t + u x t and t = 2 * u x v.
+		XMVECTOR vx = XMLoadFloat4(&o.Tx), vy = XMLoadFloat4(&o.Ty), vz = XMLoadFloat4(&o.Tz);
+		XMVECTOR cx = XMVectorMultiply(two, XMVectorSubtract(XMVectorMultiply(by, vz), XMVectorMultiply(bz, vy)));
+		XMVECTOR cy = XMVectorMultiply(two, XMVectorSubtract(XMVectorMultiply(bz, vx), XMVectorMultiply(bx, vz)));
+		XMVECTOR cz = XMVectorMultiply(two, XMVectorSubtract(XMVectorMultiply(bx, vy), XMVectorMultiply(by, vx)));
+		XMVECTOR tx = XMVectorAdd(XMVectorAdd(vx, XMLoadFloat4(&b.Tx)), XMVectorMultiplyAdd(bw, cx, XMVectorSubtract(XMVectorMultiply(by, cz), XMVectorMultiply(bz, cy))));
+		XMVECTOR ty = XMVectorAdd(XMVectorAdd(vy, XMLoadFloat4(&b.Ty)), XMVectorMultiplyAdd(bw, cy, XMVectorSubtract(XMVectorMultiply(bz, cx), XMVectorMultiply(bx, cz))));
+		XMVECTOR tz = XMVectorAdd(XMVectorAdd(vz, XMLoadFloat4(&b.Tz)), XMVectorMultiplyAdd(bw, cz, XMVectorSubtract(XMVectorMultiply(bx, cy), XMVectorMultiply(by, cx))));
+
+		// dual = 0.5 * (t, 0) * rotation
+		XMVECTOR dx = XMVectorMultiply(half, XMVectorMultiplyAdd(qw, tx, XMVectorSubtract(XMVectorMultiply(ty, qz), XMVectorMultiply(tz, qy))));
+		XMVECTOR dy = XMVectorMultiply(half, XMVectorMultiplyAdd(qw, ty, XMVectorSubtract(XMVectorMultiply(tz, qx), XMVectorMultiply(tx, qz))));
+		XMVECTOR dz = XMVectorMultiply(half, XMVectorMultiplyAdd(qw, tz, XMVectorSubtract(XMVectorMultiply(tx, qy), XMVectorMultiply(ty, qx))));
+		XMVECTOR dw = XMVectorNegate(XMVectorMultiply(half, XMVectorMultiplyAdd(tx, qx, XMVectorMultiplyAdd(ty, qy, XMVectorMultiply(tz, qz)))));
+
+		// Back to one (real, dual) pair per bone.
+		XMMATRIX real = XMMatrixTranspose(XMMATRIX(qx, qy, qz, qw));
+		XMMATRIX dual = XMMatrixTranspose(XMMATRIX(dx, dy, dz, dw));
+		UINT count = MathHelper::Min(4u, numBones - i * 4);
+		XMFLOAT4* dest = dualQuaternions + i * 8;
+		for (UINT lane = 0; lane < count; ++lane)
+		{
+			XMStoreFloat4(&dest[lane * 2], real.r[lane]);
+			XMStoreFloat4(&dest[lane * 2 + 1], dual.r[lane]);
+		}
+	}
+}
+
+void SkinnedData::GetDualQuaternions(const XMFLOAT4X4* finalTransforms, UINT boneCount, XMFLOAT4* dualQuaternions)
+{
+	XMVECTOR half = XMVectorReplicate(0.5f);
+	for (UINT i = 0; i < boneCount; ++i)
+	{
+		// The palette is pre-transposed, the translation is the last column.
+		XMMATRIX m = XMMatrixTranspose(XMLoadFloat4x4(&finalTransforms[i]));
+		XMVECTOR real = XMQuaternionNormalize(XMQuaternionRotationMatrix(m));
+		XMVECTOR translation = XMVectorAndInt(m.r[3], g_XMMask3);
+		// dual = 0.5 * (t, 0) * real, XMQuaternionMultiply takes its operands the other way round
+		XMVECTOR dual = XMVectorMultiply(half, XMQuaternionMultiply(real, translation));
+		XMStoreFloat4(&dualQuaternions[i * 2], real);
+		XMStoreFloat4(&dualQuaternions[i * 2 + 1], dual);
+	}
+}
+
+void SkinnedData::GetFinalTransforms(const XMFLOAT4* dualQuaternions, UINT boneCount, XMFLOAT4X4* finalTransforms)
+{
+	for (UINT i = 0; i < boneCount; ++i)
+	{
+		XMVECTOR real = XMLoadFloat4(&dualQuaternions[i * 2]);
+		XMVECTOR dual = XMLoadFloat4(&dualQuaternions[i * 2 + 1]);
+		// t = 2 * dual * conjugate(real), operands the other way round as above
+		XMVECTOR translation = XMVectorScale(XMQuaternionMultiply(XMQuaternionConjugate(real), dual), 2.0f);
+		XMMATRIX m = XMMatrixRotationQuaternion(real);
+		m.r[3] = XMVectorSelect(g_XMIdentityR3, translation, g_XMSelect1110);
+		XMStoreFloat4x4(&finalTransforms[i], XMMatrixTranspose(m));
+	}
+}
+
+void SkinnedData::GetFinalTransforms(const std::wstring& clipName, float timePos, std::vector<XMFLOAT4X4>& finalTransforms)const
+{
+	std::vector<BonePosePacket> pose(GetPoseScratchSize());
+	finalTransforms.resize(GetBoneCount());
+	GetFinalTransforms(GetClipIndex(clipName), timePos, &finalTransforms[0], &pose[0]);
+}
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <algorithm>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+#include "AnimationBaker.h"
+
+// Skeletal animation: keyframed clips, their resampled and compressed forms and SkinnedData,
+// which evaluates them into skinning palettes. Standard library and DirectXMath only, so the
+// test programs build it; invalid arguments and malformed streams throw std exceptions.
+
+namespace DXFramework
+{
+	struct Keyframe
+	{
+		Keyframe();
+		~Keyframe();
+
+		float TimePos;
+		DirectX::XMFLOAT3 Translation;
+		DirectX::XMFLOAT3 Scale;
+		DirectX::XMFLOAT4 RotationQuat;
+	};
+
+	struct BoneAnimation
+	{
+		float GetStartTime()const;
+		float GetEndTime()const;
+
+		void Interpolate(float t, DirectX::XMFLOAT4X4& M)const;
+		void Interpolate(float t, DirectX::XMFLOAT3& S, DirectX::XMFLOAT3& P, DirectX::XMFLOAT4& Q)const;
+
+		std::vector<Keyframe> Keyframes;
+	};
+
+	struct AnimationClip
+	{
+		float GetClipStartTime()const;
+		float GetClipEndTime()const;
+
+		void Interpolate(float t, std::vector<DirectX::XMFLOAT4X4>& boneTransforms)const;
+
+		std::vector<BoneAnimation> BoneAnimations;
+	};
+
+	// Local transforms of four bones stored as structure of arrays. Each member holds
+	// one component for the four bones, so a whole packet is processed by one SIMD lane group.
+	struct BonePosePacket
+	{
+		DirectX::XMFLOAT4 Tx, Ty, Tz;
+		DirectX::XMFLOAT4 Sx, Sy, Sz;
+		DirectX::XMFLOAT4 Qx, Qy, Qz, Qw;
+	};
+
+	// Animation clip resampled at a uniform frame rate. All bones share the same frame
+	// times, so evaluation needs no key search and runs four bones at a time.
+	class SampledAnimationClip
+	{
+	public:
+		SampledAnimationClip();
+
+		static const float DefaultSampleRate;
+
+		void Build(const AnimationClip& clip, float sampleRate = DefaultSampleRate);
+
+		float GetClipStartTime()const { return m_startTime; }
+		float GetClipEndTime()const { return m_endTime; }
+		UINT GetBoneCount()const { return m_boneCount; }
+		UINT GetPacketCount()const { return m_packetCount; }
+
+		// Blend the two frames around t into the pose. The pose must hold GetPacketCount() packets.
+		void SamplePose(float t, BonePosePacket* pose)const;
+		// Convert a pose into affine bone matrices, four bones per iteration. Packets flagged
+		// in packetSkip (optional, one flag per packet) are left untouched.
+		static void BuildTransforms(const BonePosePacket* pose, UINT boneCount, DirectX::XMFLOAT4X4* boneTransforms,
+			const UINT8* packetSkip = nullptr);
+
+		static UINT GetPacketCount(UINT boneCount) { return (boneCount + 3) / 4; }
+
+	private:
+		float m_startTime;
+		float m_endTime;
+		float m_sampleRate;
+		UINT m_frameCount;
+		UINT m_boneCount;
+		UINT m_packetCount;
+		// Frame major: m_frames[frame * m_packetCount + packet]
+		std::vector<BonePosePacket> m_frames;
+	};
+
+	struct AnimationCompressionSettings
+	{
+		AnimationCompressionSettings() : Tolerance(0.001f) {}
+
+		// Largest displacement a skinned vertex may get from key reduction and quantization,
+		// in model space units.
+		float Tolerance;
+	};
+
+	// Animation clip with error bounded key reduction. Constant tracks keep a single key,
+	// key times are 16 bit and rotations are stored as 48 bit smallest-three quaternions.
+	class CompressedAnimationClip
+	{
+	public:
+		CompressedAnimationClip();
+
+		// boneRadii[i] is the farthest distance of a vertex skinned by bone i, measured in the
+		// bone's space. It turns rotation and scale errors into vertex displacements.
+		void Build(const AnimationClip& clip, const std::vector<float>& boneRadii,
+			const AnimationCompressionSettings& settings = AnimationCompressionSettings());
+
+		float GetClipStartTime()const { return m_startTime; }
+		float GetClipEndTime()const { return m_endTime; }
+		UINT GetBoneCount()const { return m_bones.size(); }
+		size_t GetMemorySize()const;
+
+		// Same contract as SampledAnimationClip::SamplePose.
+		void SamplePose(float t, BonePosePacket* pose)const;
+
+		// Binary form for offline tools. Read throws if the stream is malformed.
+		void Write(std::ostream& out)const;
+		void Read(std::istream& in);
+
+		// Vertex has the Pos, Weights and BoneIndices of DX::PosNormalTexTanSkinned.
+		template<typename Vertex>
+		static void ComputeBoneRadii(const std::vector<Vertex>& vertices,
+			const std::vector<DirectX::XMFLOAT4X4>& boneOffsets, std::vector<float>& boneRadii);
+
+	private:
+		struct Track
+		{
+			UINT KeyStart;
+			UINT KeyCount;	// One key means the track is constant
+		};
+		struct BoneTracks
+		{
+			Track Translation;
+			Track Scale;
+			Track Rotation;
+		};
+		struct PackedQuaternion
+		{
+			UINT16 Data[3];
+		};
+
+		void SampleVector(const Track& track, float u, DirectX::XMFLOAT3& value)const;
+		void SampleRotation(const Track& track, float u, DirectX::XMFLOAT4& value)const;
+
+	private:
+		float m_startTime;
+		float m_endTime;
+		// Key times are stored as (t - start) * m_timeScale in [0, 65535].
+		float m_timeScale;
+		std::vector<BoneTracks> m_bones;
+		std::vector<UINT16> m_vectorTimes;
+		std::vector<DirectX::XMFLOAT3> m_vectorKeys;
+		std::vector<UINT16> m_rotationTimes;
+		std::vector<PackedQuaternion> m_rotationKeys;
+	};
+
+	// Detail bones (fingers, face) that follow a proxy bone at low level of detail. A folded
+	// bone reuses the final transform of its proxy, so skinned vertices move rigidly with it.
+	class BoneLodMap
+	{
+	public:
+		// proxyBones[i] is the bone that bone i follows, or -1 to keep it. Chains are resolved
+		// to the first kept bone. Throws on cycles or out of range bones.
+		void Build(const std::vector<int>& proxyBones);
+
+		bool IsEmpty()const { return m_foldedBones.empty(); }
+		UINT GetFoldedBoneCount()const { return (UINT)m_foldedBones.size(); }
+		UINT GetProxy(UINT bone)const { return m_proxies[bone]; }
+		const std::vector<UINT>& GetFoldedBones()const { return m_foldedBones; }
+		// One flag per pose packet, set when all its bones are folded.
+		const UINT8* GetPacketSkip()const { return m_packetSkip.empty() ? nullptr : &m_packetSkip[0]; }
+
+	private:
+		std::vector<UINT> m_proxies;
+		std::vector<UINT> m_foldedBones;
+		std::vector<UINT8> m_packetSkip;
+	};
+
+	class SkinnedData
+	{
+	public:
+		SkinnedData() : m_compressed(false), m_hasScale(false) {}
+
+		UINT GetBoneCount()const;
+		UINT GetClipCount()const { return m_clipTimes.size(); }
+		// Resolve a clip name once and keep the handle. Throws if the clip does not exist.
+		UINT GetClipIndex(const std::wstring& clipName)const;
+		float GetClipStartTime(const std::wstring& clipName)const;
+		float GetClipEndTime(const std::wstring& clipName)const;
+		float GetClipStartTime(UINT clipIndex)const { return m_clipTimes[clipIndex].x; }
+		float GetClipEndTime(UINT clipIndex)const { return m_clipTimes[clipIndex].y; }
+		bool IsCompressed()const { return m_compressed; }
+		// Any bone offset or scale key away from unit scale. Dual quaternions can not carry scale,
+		// so such skeletons must stay on the matrix palette.
+		bool HasScale()const { return m_hasScale; }
+		// Number of pose packets the caller must provide to GetFinalTransforms.
+		UINT GetPoseScratchSize()const { return SampledAnimationClip::GetPacketCount(GetBoneCount()); }
+
+		void Initialize(
+			std::vector<DirectX::XMFLOAT4X4>& boneOffsets,
+			std::map<std::wstring, AnimationClip>& animations,
+			float sampleRate = SampledAnimationClip::DefaultSampleRate);
+		// Keep the clips compressed instead of resampled. Smaller, but evaluation searches keys.
+		void InitializeCompressed(
+			std::vector<DirectX::XMFLOAT4X4>& boneOffsets,
+			std::map<std::wstring, AnimationClip>& animations,
+			const std::vector<float>& boneRadii,
+			const AnimationCompressionSettings& settings = AnimationCompressionSettings());
+
+		// Hot path. Does not allocate: finalTransforms must hold GetBoneCount() matrices and
+		// poseScratch must hold GetPoseScratchSize() packets.
+		void GetFinalTransforms(UINT clipIndex, float timePos,
+			DirectX::XMFLOAT4X4* finalTransforms, BonePosePacket* poseScratch)const;
+		// Convenience overload for one-off evaluation. Looks the clip up by name and allocates scratch.
+		void GetFinalTransforms(const std::wstring& clipName, float timePos,
+			std::vector<DirectX::XMFLOAT4X4>& finalTransforms)const;
+
+		// Two halves of GetFinalTransforms, for callers that blend poses in between.
+		void GetPose(UINT clipIndex, float timePos, BonePosePacket* pose)const;
+		// With a lod map, folded bones copy the transform of their proxy instead of being built.
+		void GetFinalTransforms(const BonePosePacket* pose, DirectX::XMFLOAT4X4* finalTransforms,
+			const BoneLodMap* lod = nullptr)const;
+
+		// Dual quaternion palette: two XMFLOAT4 per bone (real, dual), half the size of the
+		// matrix palette, built from the pose rotation and translation without any matrix.
+		// Requires !HasScale(). dualQuaternions must hold 2 * GetBoneCount() entries.
+		void GetDualQuaternions(UINT clipIndex, float timePos,
+			DirectX::XMFLOAT4* dualQuaternions, BonePosePacket* poseScratch)const;
+		void GetDualQuaternions(const BonePosePacket* pose, DirectX::XMFLOAT4* dualQuaternions)const;
+		// Same layout from a palette of GetFinalTransforms, for palettes that were extrapolated
+		// instead of evaluated. The matrices must be rigid.
+		static void GetDualQuaternions(const DirectX::XMFLOAT4X4* finalTransforms, UINT boneCount,
+			DirectX::XMFLOAT4* dualQuaternions);
+		// And back, the pre-transposed palette of a dual quaternion palette.
+		static void GetFinalTransforms(const DirectX::XMFLOAT4* dualQuaternions, UINT boneCount,
+			DirectX::XMFLOAT4X4* finalTransforms);
+
+	private:
+		void BuildOffsetPose(const std::map<std::wstring, AnimationClip>& animations);
+
+	private:
+		std::vector<DirectX::XMFLOAT4X4> m_boneOffsets;
+		std::map<std::wstring, UINT> m_clipIndices;
+		// Start and end time per clip
+		std::vector<DirectX::XMFLOAT2> m_clipTimes;
+		bool m_compressed;
+		bool m_hasScale;
+		// Bone offsets as rotation and translation, four bones per packet
+		std::vector<BonePosePacket> m_offsetPose;
+		std::vector<SampledAnimationClip> m_clips;
+		std::vector<CompressedAnimationClip> m_compressedClips;
+	};
+
+	// Lets AnimationPaletteAtlas::Bake sample a SkinnedData, with the pose scratch it needs.
+	class SkinnedPaletteSource : public PaletteSource
+	{
+	public:
+		explicit SkinnedPaletteSource(const SkinnedData& skinInfo)
+			: m_skinInfo(skinInfo), m_poseScratch(skinInfo.GetPoseScratchSize()) {}
+
+		virtual UINT GetBoneCount()const override { return m_skinInfo.GetBoneCount(); }
+		virtual UINT GetClipCount()const override { return m_skinInfo.GetClipCount(); }
+		virtual float GetClipStartTime(UINT clipIndex)const override { return m_skinInfo.GetClipStartTime(clipIndex); }
+		virtual float GetClipEndTime(UINT clipIndex)const override { return m_skinInfo.GetClipEndTime(clipIndex); }
+		virtual void GetFinalTransforms(UINT clipIndex, float timePos, DirectX::XMFLOAT4X4* finalTransforms) override
+		{
+			m_skinInfo.GetFinalTransforms(clipIndex, timePos, finalTransforms, m_poseScratch.data());
+		}
+
+	private:
+		const SkinnedData& m_skinInfo;
+		std::vector<BonePosePacket> m_poseScratch;
+	};
+
+	template<typename Vertex>
+	void CompressedAnimationClip::ComputeBoneRadii(const std::vector<Vertex>& vertices,
+		const std::vector<DirectX::XMFLOAT4X4>& boneOffsets, std::vector<float>& boneRadii)
+	{
+		boneRadii.assign(boneOffsets.size(), 0.0f);
+		for (auto& v : vertices)
+		{
+			float weights[4] = { v.Weights.x, v.Weights.y, v.Weights.z, 1.0f - v.Weights.x - v.Weights.y - v.Weights.z };
+			DirectX::XMVECTOR pos = DirectX::XMLoadFloat3(&v.Pos);
+			for (UINT i = 0; i < 4; ++i)
+			{
+				UINT bone = v.BoneIndices[i];
+				if (weights[i] <= 0.0f || bone >= boneOffsets.size())
+					continue;
+				DirectX::XMVECTOR local = DirectX::XMVector3TransformCoord(pos, DirectX::XMLoadFloat4x4(&boneOffsets[bone]));
+				boneRadii[bone] = (std::max)(boneRadii[bone], DirectX::XMVectorGetX(DirectX::XMVector3Length(local)));
+			}
+		}
+	}
+}
@@ -0,0 +1,165 @@
+#include "pch.h"
+#include "SkinningHelper.h"
+#include "Common/MathHelper.h"
+#include <cfloat>
+
+using namespace DXFramework;
+using namespace DirectX;
+
+using namespace DX;
+
+// Gather row r of the palette entries of four bones and transpose them, so that each
+// result vector holds one matrix element for the four lanes.
+static XMMATRIX GatherRow(const XMFLOAT4X4* palette, const UINT bones[4], UINT r)
+{
+	XMMATRIX rows;
+	rows.r[0] = XMLoadFloat4((const XMFLOAT4*)palette[bones[0]].m[r]);
+	rows.r[1] = XMLoadFloat4((const XMFLOAT4*)palette[bones[1]].m[r]);
+	rows.r[2] = XMLoadFloat4((const XMFLOAT4*)palette[bones[2]].m[r]);
+	rows.r[3] = XMLoadFloat4((const XMFLOAT4*)palette[bones[3]].m[r]);
+	return XMMatrixTranspose(rows);
+}
+
+// Inverse of the SoA layout: four vertices back to XMFLOAT3.
+static void StoreLanes(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, XMFLOAT3* dest, UINT count)
+{
+	XMMATRIX soa(x, y, z, XMVectorZero());
+	XMMATRIX aos = XMMatrixTranspose(soa);
+	for (UINT lane = 0; lane < count; ++lane)
+		XMStoreFloat3(&dest[lane], aos.r[lane]);
+}
+
+void SkinningHelper::Skin(const PosNormalTexTanSkinned* vertices, UINT vertexCount, const XMFLOAT4X4* palette,
+	XMFLOAT3* positions, XMFLOAT3* normals /* = nullptr */, XMFLOAT3* tangents /* = nullptr */)
+{
+	XMVECTOR one = XMVectorSplatOne();
+	PosNormalTexTanSkinned tail[4];
+
+	for (UINT base = 0; base < vertexCount; base += 4)
+	{
+		// The last block is padded by repeating its final vertex.
+		UINT count = MathHelper::Min(4u, vertexCount - base);
+		const PosNormalTexTanSkinned* v = vertices + base;
+		if (count < 4)
+		{
+			for (UINT lane = 0; lane < 4; ++lane)
+				tail[lane] = v[MathHelper::Min(lane, count - 1)];
+			v = tail;
+		}
+
+		XMMATRIX pos = XMMatrixTranspose(XMMATRIX(XMLoadFloat3(&v[0].Pos), XMLoadFloat3(&v[1].Pos), XMLoadFloat3(&v[2].Pos), XMLoadFloat3(&v[3].Pos)));
+		XMMATRIX nor = XMMatrixTranspose(XMMATRIX(XMLoadFloat3(&v[0].Normal), XMLoadFloat3(&v[1].Normal), XMLoadFloat3(&v[2].Normal), XMLoadFloat3(&v[3].Normal)));
+		XMMATRIX tng = XMMatrixTranspose(XMMATRIX(XMLoadFloat3(&v[0].TangentU), XMLoadFloat3(&v[1].TangentU), XMLoadFloat3(&v[2].TangentU), XMLoadFloat3(&v[3].TangentU)));
+		XMMATRIX weights = XMMatrixTranspose(XMMATRIX(XMLoadFloat3(&v[0].Weights), XMLoadFloat3(&v[1].Weights), XMLoadFloat3(&v[2].Weights), XMLoadFloat3(&v[3].Weights)));
+		weights.r[3] = XMVectorSubtract(XMVectorSubtract(XMVectorSubtract(one, weights.r[0]), weights.r[1]), weights.r[2]);
+
+		XMVECTOR px = XMVectorZero(), py = XMVectorZero(), pz = XMVectorZero();
+		XMVECTOR nx = XMVectorZero(), ny = XMVectorZero(), nz = XMVectorZero();
+		XMVECTOR tx = XMVectorZero(), ty = XMVectorZero(), tz = XMVectorZero();
+		for (UINT s = 0; s < 4; ++s)
+		{
+			UINT bones[4] = { v[0].BoneIndices[s], v[1].BoneIndices[s], v[2].BoneIndices[s], v[3].BoneIndices[s] };
+			XMVECTOR w = weights.r[s];
+			// Palette rows are the columns of the bone matrix: out.k = dot(row k, (p, 1)).
+			XMMATRIX m[3] = { GatherRow(palette, bones, 0), GatherRow(palette, bones, 1), GatherRow(palette, bones, 2) };
+			XMVECTOR* outP[3] = { &px, &py, &pz };
+			XMVECTOR* outN[3] = { &nx, &ny, &nz };
+			XMVECTOR* outT[3] = { &tx, &ty, &tz };
+			for (UINT k = 0; k < 3; ++k)
+			{
+				XMVECTOR p = XMVectorMultiplyAdd(m[k].r[0], pos.r[0], XMVectorMultiplyAdd(m[k].r[1], pos.r[1], XMVectorMultiplyAdd(m[k].r[2], pos.r[2], m[k].r[3])));
+				*outP[k] = XMVectorMultiplyAdd(w, p, *outP[k]);
+				if (normals)
+				{
+					XMVECTOR n = XMVectorMultiplyAdd(m[k].r[0], nor.r[0], XMVectorMultiplyAdd(m[k].r[1], nor.r[1], XMVectorMultiply(m[k].r[2], nor.r[2])));
+					*outN[k] = XMVectorMultiplyAdd(w, n, *outN[k]);
+				}
+				if (tangents)
+				{
+					XMVECTOR t = XMVectorMultiplyAdd(m[k].r[0], tng.r[0], XMVectorMultiplyAdd(m[k].r[1], tng.r[1], XMVectorMultiply(m[k].r[2], tng.r[2])));
+					*outT[k] = XMVectorMultiplyAdd(w, t, *outT[k]);
+				}
+			}
+		}
+
+		StoreLanes(px, py, pz, positions + base, count);
+		if (normals)
+			StoreLanes(nx, ny, nz, normals + base, count);
+		if (tangents)
+			StoreLanes(tx, ty, tz, tangents + base, count);
+	}
+}
+
+BoundingBox SkinningHelper::ComputeBounds(const PosNormalTexTanSkinned* vertices, UINT vertexCount,
+	const XMFLOAT4X4* palette, std::vector<XMFLOAT3>& positionScratch)
+{
+	BoundingBox bounds;
+	if (vertexCount == 0)
+		return bounds;
+
+	positionScratch.resize(vertexCount);
+	Skin(vertices, vertexCount, palette, &positionScratch[0]);
+	BoundingBox::CreateFromPoints(bounds, vertexCount, &positionScratch[0], sizeof(XMFLOAT3));
+	return bounds;
+}
+
+void SkinnedBounds::Build(const std::vector<PosNormalTexTanSkinned>& vertices, UINT boneCount)
+{
+	// XMFLOAT3 storage, std::vector does not guarantee XMVECTOR alignment on every target.
+	std::vector<XMFLOAT3> minPoints(boneCount, XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX));
+	std::vector<XMFLOAT3> maxPoints(boneCount, XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+	std::vector<bool> used(boneCount, false);
+
+	for (auto& v : vertices)
+	{
+		float weights[4] = { v.Weights.x, v.Weights.y, v.Weights.z, 1.0f - v.Weights.x - v.Weights.y - v.Weights.z };
+		XMVECTOR pos = XMLoadFloat3(&v.Pos);
+		for (UINT i = 0; i < 4; ++i)
+		{
+			UINT bone = v.BoneIndices[i];
+			if (weights[i] <= 0.0f || bone >= boneCount)
+				continue;
+			XMStoreFloat3(&minPoints[bone], XMVectorMin(XMLoadFloat3(&minPoints[bone]), pos));
+			XMStoreFloat3(&maxPoints[bone], XMVectorMax(XMLoadFloat3(&maxPoints[bone]), pos));
+			used[bone] = true;
+		}
+	}
+
+	m_boxes.clear();
+	for (UINT bone = 0; bone < boneCount; ++bone)
+	{
+		if (!used[bone])
+			continue;
+		BoneBox box;
+		box.Bone = bone;
+		XMVECTOR minPoint = XMLoadFloat3(&minPoints[bone]);
+		XMVECTOR maxPoint = XMLoadFloat3(&maxPoints[bone]);
+		XMStoreFloat3(&box.Center, XMVectorScale(XMVectorAdd(minPoint, maxPoint), 0.5f));
+		XMStoreFloat3(&box.Extents, XMVectorScale(XMVectorSubtract(maxPoint, minPoint), 0.5f));
+		m_boxes.push_back(box);
+	}
+}
+
+BoundingBox SkinnedBounds::GetBounds(const XMFLOAT4X4* palette)const
+{
+	BoundingBox bounds;
+	if (m_boxes.empty())
+		return bounds;
+
+	XMVECTOR minPoint = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxPoint = XMVectorReplicate(-FLT_MAX);
+	for (auto& box : m_boxes)
+	{
+		// Undo the pre-transpose to get the row vector bone matrix back.
+		XMMATRIX M = XMMatrixTranspose(XMLoadFloat4x4(&palette[box.Bone]));
+		XMVECTOR center = XMVector3Transform(XMLoadFloat3(&box.Center), M);
+		// Extents of a transformed box: |M| applied to the extents.
+		XMVECTOR extents = XMVectorMultiply(XMVectorAbs(M.r[0]), XMVectorReplicate(box.Extents.x));
+		extents = XMVectorMultiplyAdd(XMVectorAbs(M.r[1]), XMVectorReplicate(box.Extents.y), extents);
+		extents = XMVectorMultiplyAdd(XMVectorAbs(M.r[2]), XMVectorReplicate(box.Extents.z), extents);
+		minPoint = XMVectorMin(minPoint, XMVectorSubtract(center, extents));
+		maxPoint = XMVectorMax(maxPoint, XMVectorAdd(center, extents));
+	}
+	BoundingBox::CreateFromPoints(bounds, minPoint, maxPoint);
+	return bounds;
+}
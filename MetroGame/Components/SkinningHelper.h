@@ -0,0 +1,44 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include "Common/ShaderMgr.h"
+
+// CPU skinning for hit tests and animated bounds. Palettes are the pre-transposed final
+// transforms from SkinnedData::GetFinalTransforms, the same data the skinned vertex shader
+// reads, and vertices follow the shader convention: Weights.xyz plus 1 - sum for the fourth.
+
+namespace DXFramework
+{
+	class SkinningHelper
+	{
+	public:
+		// Skin four vertices per iteration. normals and tangents are optional and, like in the
+		// shader, not renormalized.
+		static void Skin(const DX::PosNormalTexTanSkinned* vertices, UINT vertexCount, const DirectX::XMFLOAT4X4* palette,
+			DirectX::XMFLOAT3* positions, DirectX::XMFLOAT3* normals = nullptr, DirectX::XMFLOAT3* tangents = nullptr);
+		// Exact model space bounds of the skinned positions.
+		static DirectX::BoundingBox ComputeBounds(const DX::PosNormalTexTanSkinned* vertices, UINT vertexCount,
+			const DirectX::XMFLOAT4X4* palette, std::vector<DirectX::XMFLOAT3>& positionScratch);
+	};
+
+	// Conservative bounds without per vertex work. A skinned position is a convex blend of
+	// the vertex transformed by each of its bones, so the union of every bone's bind pose
+	// box moved by that bone contains the whole skinned mesh.
+	class SkinnedBounds
+	{
+	public:
+		void Build(const std::vector<DX::PosNormalTexTanSkinned>& vertices, UINT boneCount);
+		DirectX::BoundingBox GetBounds(const DirectX::XMFLOAT4X4* palette)const;
+
+	private:
+		struct BoneBox
+		{
+			UINT Bone;
+			DirectX::XMFLOAT3 Center;
+			DirectX::XMFLOAT3 Extents;
+		};
+		// Only bones that influence at least one vertex
+		std::vector<BoneBox> m_boxes;
+	};
+}
@@ -12,6 +12,12 @@ using namespace DirectX;
 
 using namespace DX;
 
+// The sky vertices are bare positions.
+struct SkyVertexPolicy : PosPolicy<XMFLOAT3>
+{
+	static void SetPosition(XMFLOAT3& v, const XMFLOAT3& p) { v = p; }
+};
+
 Sky::Sky(
 	const std::shared_ptr<DX::DeviceResources>& deviceResources,
 	const std::shared_ptr<DX::ConstantBuffer<DX::BasicPerFrameCB>>& perFrameCB,
@@ -110,8 +116,11 @@ void Sky::Render()
 	ShaderChangement::VS = m_skyVS.Get();
 	context->PSSetShader(m_skyPS.Get(), 0, 0);
 	ShaderChangement::PS = m_skyPS.Get();
-	ID3D11Buffer* cbuffers[2] = { m_perFrameCB->GetBuffer(), m_perObjectCB->GetBuffer() };
-	context->VSSetConstantBuffers(0, 2, cbuffers);
+	// The per-frame buffer may be a range of the constant ring, a cube face of a dynamic map
+	StateTracker* tracker = m_deviceResources->GetStateTracker();
+	ID3D11Buffer* perObject = m_perObjectCB->GetBuffer();
+	m_perFrameCB->Bind(tracker, ShaderStage::VS, 0);
+	tracker->SetConstantBuffers(ShaderStage::VS, 1, 1, &perObject);
 	ID3D11SamplerState* samplers[1] = { renderStateMgr->LinearSam() };
 	context->PSSetSamplers(0, 1, samplers);
 	context->PSSetShaderResources(0, 1, m_skyCubeMapSRV.GetAddressOf());
@@ -126,6 +135,7 @@ void Sky::Render()
 	context->OMSetDepthStencilState(nullptr, 0);
 	context->RSSetState(nullptr);
 	ShaderChangement::RSS = nullptr;
+	m_deviceResources->GetStateTracker()->Invalidate();
 }
 
 void Sky::ReleaseDeviceDependentResources()
@@ -142,16 +152,11 @@ void Sky::ReleaseDeviceDependentResources()
 
 void Sky::BuildSkyGeometryBuffers()
 {
-	GeometryGenerator::MeshData sphere;
+	// Positions only, generated straight into the vertex and index buffers.
+	std::vector<XMFLOAT3> vertices(GeometryGenerator::GetSphereVertexCount(30, 30));
+	std::vector<UINT> indices(GeometryGenerator::GetSphereIndexCount(30, 30));
 	GeometryGenerator geoGen;
-	geoGen.CreateSphere(m_sphereRadius, 30, 30, sphere);
-
-	std::vector<XMFLOAT3> vertices(sphere.Vertices.size());
-
-	for (size_t i = 0; i < sphere.Vertices.size(); ++i)
-	{
-		vertices[i] = sphere.Vertices[i].Position;
-	}
+	geoGen.CreateSphere<SkyVertexPolicy>(m_sphereRadius, 30, 30, vertices.data(), indices.data());
 
 	D3D11_BUFFER_DESC vbd;
 	vbd.Usage = D3D11_USAGE_IMMUTABLE;
@@ -164,7 +169,7 @@ void Sky::BuildSkyGeometryBuffers()
 	vinitData.pSysMem = &vertices[0];
 	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&vbd, &vinitData, m_skyVB.GetAddressOf()));
 
-	m_indexCount = sphere.Indices.size();
+	m_indexCount = indices.size();
 
 	D3D11_BUFFER_DESC ibd;
 	ibd.Usage = D3D11_USAGE_IMMUTABLE;
@@ -174,7 +179,7 @@ void Sky::BuildSkyGeometryBuffers()
 	ibd.StructureByteStride = 0;
 	ibd.MiscFlags = 0;
 	D3D11_SUBRESOURCE_DATA iinitData;
-	iinitData.pSysMem = &sphere.Indices[0];
+	iinitData.pSysMem = &indices[0];
 	ThrowIfFailed(m_deviceResources->GetD3DDevice()->CreateBuffer(&ibd, &iinitData, m_skyIB.GetAddressOf()));
 }
 
@@ -106,15 +106,17 @@ void SsaoHelper::Render(const std::function<void()>& DrawMap)
 		return;
 	auto renderStateMgr = RenderStateMgr::Instance();
 	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	StateTracker* tracker = m_deviceResources->GetStateTracker();
 
 	//
 	// Get normal depth map
 	//
 	ID3D11RenderTargetView* renderTargets[1] = { m_normalDepthRTV.Get() };
-	context->OMSetRenderTargets(1, renderTargets, m_depthStencilDSV.Get());
+	tracker->OMSetRenderTargets(1, renderTargets, m_depthStencilDSV.Get());
 	context->ClearRenderTargetView(m_normalDepthRTV.Get(), Colors::Silver);
 	context->ClearDepthStencilView(m_depthStencilDSV.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 	DrawMap();
+	tracker->SetComponent("SsaoHelper");
 
 	//
 	// Compute Ssao map
@@ -124,40 +126,34 @@ void SsaoHelper::Render(const std::function<void()>& DrawMap)
 	// a depth/stencil buffer--it does not need it, and without one, no depth test is
 	// performed, which is what we want.
 	renderTargets[0] = { m_ambientRTV0.Get() };
-	context->OMSetRenderTargets(1, renderTargets, nullptr);
+	tracker->OMSetRenderTargets(1, renderTargets, nullptr);
 	context->ClearRenderTargetView(m_ambientRTV0.Get(), Colors::Silver);
 	context->RSSetViewports(1, &m_ambientMapViewport);
 
 	// Set IA stage
 	UINT stride = sizeof(Basic32);
 	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	}
+	tracker->IASetInputLayout(m_inputLayout.Get());
+	ShaderChangement::InputLayout = m_inputLayout.Get();
+	tracker->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
 	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_quadVB.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_quadIB.Get(), DXGI_FORMAT_R32_UINT, 0);
+	tracker->IASetVertexBuffers(0, 1, m_quadVB.GetAddressOf(), &stride, &offset);
+	tracker->IASetIndexBuffer(m_quadIB.Get(), DXGI_FORMAT_R32_UINT, 0);
 
 	// Bind shaders, constant buffers, srvs and samplers
-	context->VSSetShader(m_ssaoVS.Get(), nullptr, 0);
+	tracker->VSSetShader(m_ssaoVS.Get());
 	ShaderChangement::VS = m_ssaoVS.Get();
-	context->PSSetShader(m_ssaoPS.Get(), nullptr, 0);
+	tracker->PSSetShader(m_ssaoPS.Get());
 	ShaderChangement::PS = m_ssaoPS.Get();
 	ID3D11Buffer* cbuffers[2] = { m_perFrameCB->GetBuffer(), m_ssaoSettingsCB.GetBuffer() };
 	ID3D11SamplerState* samplers[2] = { renderStateMgr->LinearSam(), renderStateMgr->SsaoSam() };
-	context->VSSetConstantBuffers(0, 1, cbuffers + 1);
-	context->PSSetConstantBuffers(0, 2, cbuffers);
-	context->PSSetSamplers(0, 2, samplers);
+	tracker->SetConstantBuffers(ShaderStage::VS, 0, 1, cbuffers + 1);
+	tracker->SetConstantBuffers(ShaderStage::PS, 0, 2, cbuffers);
+	tracker->SetSamplers(ShaderStage::PS, 0, 2, samplers);
 	ID3D11ShaderResourceView* srvs[2] = { m_normalDepthSRV.Get(), m_randomVectorSRV.Get() };
-	context->PSSetShaderResources(0, 2, srvs);
+	tracker->SetShaderResources(ShaderStage::PS, 0, 2, srvs);
 
 	// Update constant buffers
 	if (m_updateSsaoSettings)
@@ -166,7 +162,7 @@ void SsaoHelper::Render(const std::function<void()>& DrawMap)
 		m_ssaoSettingsCB.ApplyChanges(context);
 	}
 
-	context->DrawIndexed(6, 0, 0);
+	tracker->DrawIndexed(6, 0, 0);
 
 	//
 	// Blur the Ssao map
@@ -181,7 +177,7 @@ void SsaoHelper::Render(const std::function<void()>& DrawMap)
 	auto viewport = m_deviceResources->GetScreenViewport();
 	context->RSSetViewports(1, &viewport);
 	renderTargets[0] = m_deviceResources->GetBackBufferRenderTargetView();
-	context->OMSetRenderTargets(1, renderTargets, m_deviceResources->GetDepthStencilView());
+	tracker->OMSetRenderTargets(1, renderTargets, m_deviceResources->GetDepthStencilView());
 	context->ClearRenderTargetView(m_deviceResources->GetBackBufferRenderTargetView(), DirectX::Colors::Silver);
 	context->ClearDepthStencilView(m_deviceResources->GetDepthStencilView(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
 }
@@ -222,31 +218,26 @@ void SsaoHelper::BlurAmbientMap()
 
 	auto renderStateMgr = RenderStateMgr::Instance();
 	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	StateTracker* tracker = m_deviceResources->GetStateTracker();
 
 	// Set IA stage
 	UINT stride = sizeof(Basic32);
 	UINT offset = 0;
-	if (ShaderChangement::InputLayout != m_inputLayout.Get())
-	{
-		context->IASetInputLayout(m_inputLayout.Get());
-		ShaderChangement::InputLayout = m_inputLayout.Get();
-	}
-	if (ShaderChangement::PrimitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST)
-	{
-		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	}
+	tracker->IASetInputLayout(m_inputLayout.Get());
+	ShaderChangement::InputLayout = m_inputLayout.Get();
+	tracker->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	ShaderChangement::PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	// Bind VB and IB
-	context->IASetVertexBuffers(0, 1, m_quadVB.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(m_quadIB.Get(), DXGI_FORMAT_R32_UINT, 0);
+	tracker->IASetVertexBuffers(0, 1, m_quadVB.GetAddressOf(), &stride, &offset);
+	tracker->IASetIndexBuffer(m_quadIB.Get(), DXGI_FORMAT_R32_UINT, 0);
 	// Bind vs
-	context->VSSetShader(m_BilateralBlurVS.Get(), nullptr, 0);
+	tracker->VSSetShader(m_BilateralBlurVS.Get());
 	ShaderChangement::VS = m_BilateralBlurVS.Get();
 	// Set ps
 	ID3D11Buffer* cbuffers[1] = { m_texSettingsCB.GetBuffer() };
 	ID3D11SamplerState* samplers[1] = { renderStateMgr->LinearMipPointSam() };
-	context->PSSetConstantBuffers(0, 1, cbuffers);
-	context->PSSetSamplers(0, 1, samplers);
+	tracker->SetConstantBuffers(ShaderStage::PS, 0, 1, cbuffers);
+	tracker->SetSamplers(ShaderStage::PS, 0, 1, samplers);
 
 	// Update constant buffers
 	if (m_updateTexSettings)
@@ -269,31 +260,29 @@ void SsaoHelper::BlurAmbientMap()
 void SsaoHelper::BlurAmbientMap(ID3D11ShaderResourceView* inputSRV, ID3D11RenderTargetView* outputRTV, bool horzBlur)
 {
 	ID3D11DeviceContext* context = m_deviceResources->GetD3DDeviceContext();
+	StateTracker* tracker = m_deviceResources->GetStateTracker();
 	ID3D11RenderTargetView* renderTargets[1] = { outputRTV };
-	context->OMSetRenderTargets(1, renderTargets, nullptr);
+	tracker->OMSetRenderTargets(1, renderTargets, nullptr);
 	context->ClearRenderTargetView(outputRTV, Colors::Silver);
 	context->RSSetViewports(1, &m_ambientMapViewport);
 	
 	// Bind ps
 	if (horzBlur)
 	{
-		context->PSSetShader(m_BilateralBlurPSHori.Get(), nullptr, 0);
+		tracker->PSSetShader(m_BilateralBlurPSHori.Get());
 		ShaderChangement::PS = m_BilateralBlurPSHori.Get();
 	}
 	else
 	{
-		context->PSSetShader(m_BilateralBlurPSVert.Get(), nullptr, 0);
+		tracker->PSSetShader(m_BilateralBlurPSVert.Get());
 		ShaderChangement::PS = m_BilateralBlurPSVert.Get();
 	}
 	// Bind srv
 	ID3D11ShaderResourceView* srvs[2] = { inputSRV, m_normalDepthSRV.Get() };
-	context->PSSetShaderResources(0, 2, srvs);
-
-	context->DrawIndexed(6, 0, 0);
+	tracker->SetShaderResources(ShaderStage::PS, 0, 2, srvs);
 
-	// Unbind the input SRV as it is going to be an output in the next blur.
-	ID3D11ShaderResourceView* nullView[1] = { nullptr };
-	context->PSSetShaderResources(0, 1, nullView);
+	tracker->DrawIndexed(6, 0, 0);
+	// The input SRV is going to be an output in the next blur, the tracker unbinds it then.
 }
 
 void SsaoHelper::BuildFrustumFarCorners()
@@ -210,6 +210,7 @@ void Terrain::Render()
 	context->DSSetShader(nullptr, 0, 0);
 	ShaderChangement::DS = nullptr;
 	ShaderChangement::HS = nullptr;
+	m_deviceResources->GetStateTracker()->Invalidate();
 }
 
 void Terrain::ReleaseDeviceDependentResources()
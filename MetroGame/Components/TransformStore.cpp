@@ -0,0 +1,52 @@
+#include "pch.h"
+#include "TransformStore.h"
+#include <algorithm>
+
+using namespace DXFramework;
+using namespace DirectX;
+
+using namespace DX;
+
+void TransformStore::Initialize(const XMFLOAT4X4* worlds, UINT count)
+{
+	m_worlds.assign(worlds, worlds + count);
+	m_worldsT.resize(count);
+	m_worldInvTransposesT.resize(count);
+	m_dirty.assign(count, 1);
+	m_dirtyList.resize(count);
+	for (UINT i = 0; i < count; ++i)
+		m_dirtyList[i] = i;
+}
+
+void TransformStore::Set(UINT i, const XMFLOAT4X4& world)
+{
+	m_worlds[i] = world;
+	if (!m_dirty[i])
+	{
+		m_dirty[i] = 1;
+		m_dirtyList.push_back(i);
+	}
+}
+
+void TransformStore::Update()
+{
+	if (m_dirtyList.empty())
+		return;
+
+	// Walk the flagged entries in memory order
+	std::sort(m_dirtyList.begin(), m_dirtyList.end());
+	XMVECTOR lastRow = g_XMIdentityR3;
+	for (UINT i : m_dirtyList)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&m_worlds[i]);
+		XMStoreFloat4x4(&m_worldsT[i], XMMatrixTranspose(world));
+
+		// Same as MathHelper::InverseTranspose, whose transposed result is the plain inverse
+		// of the world without its translation.
+		world.r[3] = lastRow;
+		XMVECTOR det = XMMatrixDeterminant(world);
+		XMStoreFloat4x4(&m_worldInvTransposesT[i], XMMatrixInverse(&det, world));
+		m_dirty[i] = 0;
+	}
+	m_dirtyList.clear();
+}
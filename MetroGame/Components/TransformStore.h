@@ -0,0 +1,58 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstring>
+#include <vector>
+
+// World matrices of a set of instances together with their inverse transposes, both stored
+// transposed so they can be copied straight into a constant buffer. Set only flags an entry,
+// Update recomputes the flagged entries in one pass, so instances that never move cost nothing
+// per frame whatever the number of passes drawing them.
+
+namespace DXFramework
+{
+	class TransformStore
+	{
+	public:
+		TransformStore() {}
+
+		// Every entry starts dirty.
+		void Initialize(const DirectX::XMFLOAT4X4* worlds, UINT count);
+		void Set(UINT i, const DirectX::XMFLOAT4X4& world);
+		void Update();
+
+		UINT GetCount()const { return m_worlds.size(); }
+		UINT GetDirtyCount()const { return m_dirtyList.size(); }
+		const DirectX::XMFLOAT4X4& GetWorld(UINT i)const { return m_worlds[i]; }
+		// Transposed world and transposed inverse transpose. Valid after Update.
+		const DirectX::XMFLOAT4X4& GetWorldT(UINT i)const { return m_worldsT[i]; }
+		const DirectX::XMFLOAT4X4& GetWorldInvTransposeT(UINT i)const { return m_worldInvTransposesT[i]; }
+
+		// Append the visible entries of [first, first + count) to an instance stream and return
+		// how many were written. Instance needs World (not transposed), WorldInvTranspose (the
+		// first three rows of the transposed inverse transpose) and MatIndex, which starts at
+		// materialBase and advances every materialStepRate entries. Valid after Update.
+		template<typename Instance>
+		UINT WriteInstances(UINT first, UINT count, const UINT8* visible, UINT materialBase, UINT materialStepRate, Instance* dest)const
+		{
+			Instance* start = dest;
+			for (UINT k = 0; k < count; ++k)
+			{
+				if (!visible[k])
+					continue;
+				dest->World = m_worlds[first + k];
+				memcpy(dest->WorldInvTranspose, &m_worldInvTransposesT[first + k], sizeof(dest->WorldInvTranspose));
+				dest->MatIndex = materialBase + k / materialStepRate;
+				++dest;
+			}
+			return (UINT)(dest - start);
+		}
+
+	private:
+		std::vector<DirectX::XMFLOAT4X4> m_worlds;
+		std::vector<DirectX::XMFLOAT4X4> m_worldsT;
+		std::vector<DirectX::XMFLOAT4X4> m_worldInvTransposesT;
+		std::vector<UINT8> m_dirty;
+		std::vector<UINT> m_dirtyList;
+	};
+}
@@ -350,6 +350,7 @@ void Waves::Render()
 
 	// recover default blend state
 	context->OMSetBlendState(nullptr, blendFactor, 0xffffffff);
+	m_deviceResources->GetStateTracker()->Invalidate();
 }
 
 void Waves::ReleaseDeviceDependentResources()
@@ -48,7 +48,8 @@ void X3DLoader::LoadX3dSkinned(const std::wstring& filename,
 	std::vector<UINT>& indices,
 	std::vector<Subset>& subsets,
 	std::vector<X3dMaterial>& mats,
-	SkinnedData& skinInfo)
+	SkinnedData& skinInfo,
+	const AnimationCompressionSettings* compression)
 {
 	// Read binary data
 	std::ifstream fin(filename, std::ios::binary);
@@ -79,7 +80,16 @@ void X3DLoader::LoadX3dSkinned(const std::wstring& filename,
 		ReadBoneOffsets(fin, numBones, boneOffsets);
 		ReadAnimationClips(fin, numBones, numAnimationClips, animations);
 
-		skinInfo.Initialize(boneOffsets, animations);
+		if (compression)
+		{
+			std::vector<float> boneRadii;
+			CompressedAnimationClip::ComputeBoneRadii(vertices, boneOffsets, boneRadii);
+			skinInfo.InitializeCompressed(boneOffsets, animations, boneRadii, *compression);
+		}
+		else
+		{
+			skinInfo.Initialize(boneOffsets, animations);
+		}
 
 		return;
 	}
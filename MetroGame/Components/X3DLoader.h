@@ -20,7 +20,8 @@ namespace DXFramework
 			std::vector<UINT>& indices,
 			std::vector<Subset>& subsets,
 			std::vector<X3dMaterial>& mats,
-			SkinnedData& skinInfo);
+			SkinnedData& skinInfo,
+			const AnimationCompressionSettings* compression = nullptr);
 
 	private:
 		static void ReadMaterials(std::ifstream& fin, UINT numMaterials, std::vector<X3dMaterial>& mats);
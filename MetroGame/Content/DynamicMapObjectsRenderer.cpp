@@ -40,6 +40,7 @@ DynamicMapObjectsRenderer::DynamicMapObjectsRenderer(const std::shared_ptr<DX::D
 
 	m_perFrameCB = std::make_shared<ConstantBuffer<BasicPerFrameCB>>();
 	m_perObjectCB = std::make_shared<ConstantBuffer<BasicPerObjectCB>>();
+	m_drawContext = std::make_unique<D3DDrawContext>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_centerSphere = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_skull = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_sphere = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
@@ -77,6 +78,7 @@ void DynamicMapObjectsRenderer::CreateDeviceDependentResources()
 	// Initialize constant buffer
 	m_perFrameCB->Initialize(m_deviceResources->GetD3DDevice());
 	m_perObjectCB->Initialize(m_deviceResources->GetD3DDevice());
+	m_drawContext->CreateDeviceDependentResources();
 
 	m_centerSphere->CreateDeviceDependentResourcesAsync()
 		.then([=]()
@@ -162,20 +164,30 @@ void DynamicMapObjectsRenderer::Render()
 
 	m_perFrameCB->ApplyChanges(context.Get());
 
+	// The six faces and the main view go through the same queue, so the keys and their ids
+	// stay the same from one pass to the next.
 	m_dynamicCube->Render([&]()
 	{
-		m_skull->Render();
-		m_sphere->Render();
-		m_base->Render(true);
-		m_sky->Render();
+		DrawScene(false);
 	});
 
 	m_centerSphere->UpdateReflectMapSRV(m_dynamicCube->GetDynamicCubeMapSRV());
 
-	m_centerSphere->Render();
-	m_skull->Render();
-	m_sphere->Render();
-	m_base->Render(true);
+	DrawScene(true);
+}
+
+void DynamicMapObjectsRenderer::DrawScene(bool centerSphere)
+{
+	// The cube map helper leaves the face camera in the per-frame data
+	m_queue.Clear();
+	m_queue.SetView(m_perFrameCB->Data.EyePosW);
+	if (centerSphere)
+		m_centerSphere->Submit(m_queue);
+	m_skull->Submit(m_queue);
+	m_sphere->Submit(m_queue);
+	m_base->Submit(m_queue);
+	m_queue.Sort();
+	m_queue.Execute(*m_drawContext);
 	m_sky->Render();
 }
 
@@ -185,6 +197,8 @@ void DynamicMapObjectsRenderer::ReleaseDeviceDependentResources()
 
 	m_perFrameCB->Reset();
 	m_perObjectCB->Reset();
+	m_drawContext->ReleaseDeviceDependentResources();
+	m_queue.ResetIds();
 	m_centerSphere->ReleaseDeviceDependentResources();
 	m_skull->ReleaseDeviceDependentResources();
 	m_sphere->ReleaseDeviceDependentResources();
@@ -200,26 +214,16 @@ void DynamicMapObjectsRenderer::InitCenterSphere()
 	objectData->UseIndex = true;
 	objectData->UseEx = false;
 
-	GeometryGenerator::MeshData sphere;
-	GeometryGenerator geoGen;
-	geoGen.CreateSphere(0.5f, 20, 20, sphere);
-
-	int sphereIndexCount = sphere.Indices.size();
-
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
+	// Generate the sphere straight into the vertex and index buffers, without tangents.
 	auto& vertices = objectData->VertexData;
-	vertices.resize(sphere.Vertices.size());
-	for (size_t i = 0; i < sphere.Vertices.size(); ++i)
-	{
-		vertices[i].Pos = sphere.Vertices[i].Position;
-		vertices[i].Normal = sphere.Vertices[i].Normal;
-		vertices[i].Tex = sphere.Vertices[i].TexC;
-	}
-
-	// Pack the indices of all the meshes into one index buffer.
 	auto& indices = objectData->IndexData;
-	indices.assign(sphere.Indices.begin(), sphere.Indices.end());
+	vertices.resize(GeometryGenerator::GetSphereVertexCount(20, 20));
+	indices.resize(GeometryGenerator::GetSphereIndexCount(20, 20));
+
+	GeometryGenerator geoGen;
+	geoGen.CreateSphere<PosNormalTexPolicy<Basic32>>(0.5f, 20, 20, vertices.data(), indices.data());
+
+	int sphereIndexCount = indices.size();
 
 	// Set unit data
 	XMFLOAT4X4 centerSphereWorld;
@@ -324,26 +328,16 @@ void DynamicMapObjectsRenderer::InitSphere()
 	objectData->UseIndex = true;
 	objectData->UseEx = false;
 
-	GeometryGenerator::MeshData sphere;
-	GeometryGenerator geoGen;
-	geoGen.CreateSphere(0.5f, 20, 20, sphere);
-
-	int sphereIndexCount = sphere.Indices.size();
-
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
+	// Generate the sphere straight into the vertex and index buffers, without tangents.
 	auto& vertices = objectData->VertexData;
-	vertices.resize(sphere.Vertices.size());
-	for (size_t i = 0; i < sphere.Vertices.size(); ++i)
-	{
-		vertices[i].Pos = sphere.Vertices[i].Position;
-		vertices[i].Normal = sphere.Vertices[i].Normal;
-		vertices[i].Tex = sphere.Vertices[i].TexC;
-	}
-
-	// Pack the indices of all the meshes into one index buffer.
 	auto& indices = objectData->IndexData;
-	indices.assign(sphere.Indices.begin(), sphere.Indices.end());
+	vertices.resize(GeometryGenerator::GetSphereVertexCount(20, 20));
+	indices.resize(GeometryGenerator::GetSphereIndexCount(20, 20));
+
+	GeometryGenerator geoGen;
+	geoGen.CreateSphere<PosNormalTexPolicy<Basic32>>(0.5f, 20, 20, vertices.data(), indices.data());
+
+	int sphereIndexCount = indices.size();
 
 	// Set unit data
 	XMFLOAT4X4 m_sphereWorld[10];
@@ -392,25 +386,20 @@ void DynamicMapObjectsRenderer::InitBase()
 	objectData->UseIndex = true;
 	objectData->UseEx = true;
 
-	// Init shapes
-	GeometryGenerator::MeshData box;
-	GeometryGenerator::MeshData grid;
-	GeometryGenerator::MeshData cylinder;
-
-	GeometryGenerator geoGen;
-	geoGen.CreateBox(1.0f, 1.0f, 1.0f, box);
-	geoGen.CreateGrid(20.0f, 30.0f, 60, 40, grid);
-	geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20, cylinder);
+	// Cache the vertex count of each object.
+	UINT boxVertexCount = GeometryGenerator::GetBoxVertexCount();
+	UINT gridVertexCount = GeometryGenerator::GetGridVertexCount(60, 40);
+	UINT cylinderVertexCount = GeometryGenerator::GetCylinderVertexCount(20, 20);
 
 	// Cache the vertex offsets to each object in the concatenated vertex buffer.
 	int boxVertexOffset = 0;
-	int gridVertexOffset = box.Vertices.size();
-	int cylinderVertexOffset = gridVertexOffset + grid.Vertices.size();
+	int gridVertexOffset = boxVertexCount;
+	int cylinderVertexOffset = gridVertexOffset + gridVertexCount;
 
 	// Cache the index count of each object.
-	int boxIndexCount = box.Indices.size();
-	int gridIndexCount = grid.Indices.size();
-	int cylinderIndexCount = cylinder.Indices.size();
+	int boxIndexCount = GeometryGenerator::GetBoxIndexCount();
+	int gridIndexCount = GeometryGenerator::GetGridIndexCount(60, 40);
+	int cylinderIndexCount = GeometryGenerator::GetCylinderIndexCount(20, 20);
 
 	// Cache the starting index for each object in the concatenated index buffer.
 	int boxIndexOffset = 0;
@@ -418,51 +407,27 @@ void DynamicMapObjectsRenderer::InitBase()
 	int cylinderIndexOffset = gridIndexOffset + gridIndexCount;
 
 	UINT totalVertexCount =
-		box.Vertices.size() +
-		grid.Vertices.size() +
-		cylinder.Vertices.size();
+		boxVertexCount +
+		gridVertexCount +
+		cylinderVertexCount;
 
 	UINT totalIndexCount =
 		boxIndexCount +
 		gridIndexCount +
 		cylinderIndexCount;
 
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
-
+	// Generate the shapes straight into their part of one vertex buffer and one index
+	// buffer. Indices are relative to the first vertex of each shape.
 	auto& vertices = objectData->VertexDataEx;
+	auto& indices = objectData->IndexData;
 	vertices.resize(totalVertexCount);
+	indices.resize(totalIndexCount);
 
-	UINT k = 0;
-	for (size_t i = 0; i < box.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = box.Vertices[i].Position;
-		vertices[k].Normal = box.Vertices[i].Normal;
-		vertices[k].Tex = box.Vertices[i].TexC;
-		vertices[k].TangentU = box.Vertices[i].TangentU;
-	}
-
-	for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = grid.Vertices[i].Position;
-		vertices[k].Normal = grid.Vertices[i].Normal;
-		vertices[k].Tex = grid.Vertices[i].TexC;
-		vertices[k].TangentU = grid.Vertices[i].TangentU;
-	}
-
-	for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = cylinder.Vertices[i].Position;
-		vertices[k].Normal = cylinder.Vertices[i].Normal;
-		vertices[k].Tex = cylinder.Vertices[i].TexC;
-		vertices[k].TangentU = cylinder.Vertices[i].TangentU;
-	}
-
-	// Pack the indices of all the meshes into one index buffer.
-	auto& indices = objectData->IndexData;
-	indices.insert(indices.end(), box.Indices.begin(), box.Indices.end());
-	indices.insert(indices.end(), grid.Indices.begin(), grid.Indices.end());
-	indices.insert(indices.end(), cylinder.Indices.begin(), cylinder.Indices.end());
+	GeometryGenerator geoGen;
+	typedef PosNormalTexTanPolicy<PosNormalTexTan> Policy;
+	geoGen.CreateBox<Policy>(1.0f, 1.0f, 1.0f, &vertices[boxVertexOffset], &indices[boxIndexOffset]);
+	geoGen.CreateGrid<Policy>(20.0f, 30.0f, 60, 40, &vertices[gridVertexOffset], &indices[gridIndexOffset]);
+	geoGen.CreateCylinder<Policy>(0.5f, 0.3f, 3.0f, 20, 20, &vertices[cylinderVertexOffset], &indices[cylinderIndexOffset]);
 
 	// Set unit data
 	XMFLOAT4X4 gridWorld, boxWorld, cylWorld[10];
@@ -502,7 +467,7 @@ void DynamicMapObjectsRenderer::InitBase()
 	objectData->Units.resize(3);
 	// box
 	auto& unit0 = objectData->Units[0];
-	unit0.VCount = box.Vertices.size();
+	unit0.VCount = boxVertexCount;
 	unit0.Base = boxVertexOffset;
 	unit0.Count = boxIndexCount;
 	unit0.Start = boxIndexOffset;
@@ -514,7 +479,7 @@ void DynamicMapObjectsRenderer::InitBase()
 
 	// grid
 	auto& unit1 = objectData->Units[1];
-	unit1.VCount = grid.Vertices.size();
+	unit1.VCount = gridVertexCount;
 	unit1.Base = gridVertexOffset;
 	unit1.Count = gridIndexCount;
 	unit1.Start = gridIndexOffset;
@@ -528,7 +493,7 @@ void DynamicMapObjectsRenderer::InitBase()
 
 	// cylinder
 	auto& unit2 = objectData->Units[2];
-	unit2.VCount = cylinder.Vertices.size();
+	unit2.VCount = cylinderVertexCount;
 	unit2.Base = cylinderVertexOffset;
 	unit2.Count = cylinderIndexCount;
 	unit2.Start = cylinderIndexOffset;
@@ -11,6 +11,7 @@
 #include "Components\BasicObject.h"
 #include "Components\Sky.h"
 #include "Components\DynamicCubeMapHelper.h"
+#include "Components\D3DDrawContext.h"
 
 namespace DXFramework
 {
@@ -42,6 +43,8 @@ namespace DXFramework
 		void InitSkull();
 		void InitSphere();
 		void InitBase();
+		// One pass through the shared queue, from the viewer of the bound per-frame data.
+		void DrawScene(bool centerSphere);
 
 	private:
 		// Cached pointer to device resources.
@@ -57,6 +60,8 @@ namespace DXFramework
 		std::unique_ptr<BasicObject> m_base;
 		std::unique_ptr<Sky> m_sky;
 		std::unique_ptr<DynamicCubeMapHelper> m_dynamicCube;
+		RenderQueue m_queue;
+		std::unique_ptr<D3DDrawContext> m_drawContext;
 		DX::DirectionalLight m_dirLights[3];
 		DirectX::XMFLOAT4X4 m_skullWorld;
 
@@ -206,27 +206,21 @@ void GPUWavesRenderer::InitLand()
 	objectData->UseIndex = true;
 	objectData->UseEx = false;
 
-	GeometryGenerator::MeshData grid;
-	GeometryGenerator geoGen;
-	geoGen.CreateGrid(160.0f, 160.0f, 50, 50, grid);
-
-	// Extract the vertex elements we are interested and apply the height function to
-	// each vertex.  
+	// Generate the grid straight into the vertex and index buffers, then apply the height
+	// function to each vertex.
 	auto& vertices = objectData->VertexData;
-	vertices.resize(grid.Vertices.size());
-	for (UINT i = 0; i < grid.Vertices.size(); ++i)
-	{
-		XMFLOAT3 p = grid.Vertices[i].Position;
+	vertices.resize(GeometryGenerator::GetGridVertexCount(50, 50));
+	objectData->IndexData.resize(GeometryGenerator::GetGridIndexCount(50, 50));
 
+	GeometryGenerator geoGen;
+	geoGen.CreateGrid<PosNormalTexPolicy<Basic32>>(160.0f, 160.0f, 50, 50, vertices.data(), objectData->IndexData.data());
+	for (UINT i = 0; i < vertices.size(); ++i)
+	{
+		XMFLOAT3& p = vertices[i].Pos;
 		p.y = GetHillHeight(p.x, p.z);
-
-		vertices[i].Pos = p;
 		vertices[i].Normal = GetHillNormal(p.x, p.z);
-		vertices[i].Tex = grid.Vertices[i].TexC;
 	}
 
-	objectData->IndexData.assign(grid.Indices.begin(), grid.Indices.end());
-
 	// Set unit data
 	XMFLOAT4X4 One, grassTexTransform;
 	XMStoreFloat4x4(&One, XMMatrixIdentity());
@@ -261,22 +255,13 @@ void GPUWavesRenderer::InitCrate()
 	objectData->UseIndex = true;
 	objectData->UseEx = false;
 
-	GeometryGenerator::MeshData box;
-	GeometryGenerator geoGen;
-	geoGen.CreateBox(1.0f, 1.0f, 1.0f, box);
-
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
+	// Generate the box straight into the vertex and index buffers, without tangents.
 	auto& vertices = objectData->VertexData;
-	vertices.resize(box.Vertices.size());
-	for (UINT i = 0; i < box.Vertices.size(); ++i)
-	{
-		vertices[i].Pos = box.Vertices[i].Position;
-		vertices[i].Normal = box.Vertices[i].Normal;
-		vertices[i].Tex = box.Vertices[i].TexC;
-	}
+	vertices.resize(GeometryGenerator::GetBoxVertexCount());
+	objectData->IndexData.resize(GeometryGenerator::GetBoxIndexCount());
 
-	objectData->IndexData.assign(box.Indices.begin(), box.Indices.end());
+	GeometryGenerator geoGen;
+	geoGen.CreateBox<PosNormalTexPolicy<Basic32>>(1.0f, 1.0f, 1.0f, vertices.data(), objectData->IndexData.data());
 
 	// Set unit data
 	XMFLOAT4X4 One, boxWorld;
@@ -40,6 +40,7 @@ MeshModelRenderer::MeshModelRenderer(const std::shared_ptr<DX::DeviceResources>&
 
 	m_perFrameCB = std::make_shared<ConstantBuffer<BasicPerFrameCB>>();
 	m_perObjectCB = std::make_shared<ConstantBuffer<BasicPerObjectCB>>();
+	m_drawContext = std::make_unique<D3DDrawContext>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_mesh = std::make_unique<MeshObject>(deviceResources, m_perFrameCB, m_perObjectCB);
 }
 
@@ -67,6 +68,7 @@ void MeshModelRenderer::CreateDeviceDependentResources()
 	// Initialize constant buffer
 	m_perFrameCB->Initialize(m_deviceResources->GetD3DDevice());
 	m_perObjectCB->Initialize(m_deviceResources->GetD3DDevice());
+	m_drawContext->CreateDeviceDependentResources();
 
 	m_mesh->CreateDeviceDependentResourcesAsync()
 		.then([=]()
@@ -132,12 +134,14 @@ void MeshModelRenderer::Render()
 	m_perFrameCB->Data.FogColor = XMFLOAT4(0.65f, 0.65f, 0.65f, 1.0f);
 
 	m_perFrameCB->ApplyChanges(context.Get());
-	
-
-	auto renderStateMgr = RenderStateMgr::Instance();
-	context->RSSetState(renderStateMgr->NoCullRS());
 
-	m_mesh->Render(true);
+	// The model is drawn without culling
+	m_drawContext->SetDefaultRasterizerState(RenderStateMgr::Instance()->NoCullRS());
+	m_queue.Clear();
+	m_queue.SetView(m_camera->GetPosition());
+	m_mesh->Submit(m_queue);
+	m_queue.Sort();
+	m_queue.Execute(*m_drawContext);
 }
 
 void MeshModelRenderer::ReleaseDeviceDependentResources()
@@ -146,6 +150,8 @@ void MeshModelRenderer::ReleaseDeviceDependentResources()
 
 	m_perFrameCB->Reset();
 	m_perObjectCB->Reset();
+	m_drawContext->ReleaseDeviceDependentResources();
+	m_queue.ResetIds();
 	m_mesh->ReleaseDeviceDependentResources();
 }
 
@@ -14,6 +14,7 @@
 #include "Components\ShadowHelper.h"
 #include "Components\SsaoHelper.h"
 #include "Components\BasicObject.h"
+#include "Components\D3DDrawContext.h"
 
 #include <DirectXCollision.h>
 
@@ -54,6 +55,9 @@ namespace DXFramework
 		
 		// Custom data
 		std::unique_ptr<MeshObject> m_mesh;
+		// Subsets are submitted here and drawn sorted by state
+		RenderQueue m_queue;
+		std::unique_ptr<D3DDrawContext> m_drawContext;
 		DX::DirectionalLight m_dirLights[3];
 		DirectX::XMFLOAT3 m_originalLightDir[3];
 		float m_lightRotationAngle;
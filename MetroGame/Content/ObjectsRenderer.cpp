@@ -15,6 +15,9 @@ using namespace Microsoft::WRL;
 
 using namespace DX;
 
+// Farthest pick distance in world units
+static const float PickDistance = 1000.0f;
+
 // Loads vertex and pixel shaders from files and instantiates the cube geometry.
 ObjectsRenderer::ObjectsRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources, const std::shared_ptr<DX::Camera>& camera)
 	: m_loadingComplete(false), m_initialized(false), m_deviceResources(deviceResources), m_camera(camera)
@@ -36,10 +39,12 @@ ObjectsRenderer::ObjectsRenderer(const std::shared_ptr<DX::DeviceResources>& dev
 
 	m_perFrameCB = std::make_shared<ConstantBuffer<BasicPerFrameCB>>();
 	m_perObjectCB = std::make_shared<ConstantBuffer<BasicPerObjectCB>>();
+	m_drawContext = std::make_unique<D3DDrawContext>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_skull = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_sphere = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_base = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_sky = std::make_unique<Sky>(deviceResources, m_perFrameCB, m_perObjectCB, m_camera);
+	m_sceneBvh = std::make_unique<SceneBvh>();
 }
 
 // Initialize components
@@ -69,6 +74,7 @@ void ObjectsRenderer::CreateDeviceDependentResources()
 	// Initialize constant buffer
 	m_perFrameCB->Initialize(m_deviceResources->GetD3DDevice());
 	m_perObjectCB->Initialize(m_deviceResources->GetD3DDevice());
+	m_drawContext->CreateDeviceDependentResources();
 
 	m_skull->CreateDeviceDependentResourcesAsync()
 		.then([=]()
@@ -85,6 +91,9 @@ void ObjectsRenderer::CreateDeviceDependentResources()
 	})
 		.then([=]()
 	{
+		m_skull->AttachToBvh(m_sceneBvh.get());
+		m_sphere->AttachToBvh(m_sceneBvh.get());
+		m_base->AttachToBvh(m_sceneBvh.get());
 		// Once the data is loaded, the object is ready to be rendered.
 		m_loadingComplete = true;
 	});
@@ -105,6 +114,7 @@ void ObjectsRenderer::Update(DX::GameTimer const& timer)
 	}
 	// Update sky
 	m_sky->Update();
+	m_sceneBvh->Refresh();
 }
 
 // Renders one frame using the vertex and pixel shaders.
@@ -139,9 +149,13 @@ void ObjectsRenderer::Render()
 
 	m_perFrameCB->ApplyChanges(context.Get());
 
-	m_skull->Render();
-	m_sphere->Render();
-	m_base->Render(true);
+	m_queue.Clear();
+	m_queue.SetView(m_camera->GetPosition());
+	m_skull->Submit(m_queue);
+	m_sphere->Submit(m_queue);
+	m_base->Submit(m_queue);
+	m_queue.Sort();
+	m_queue.Execute(*m_drawContext);
 	m_sky->Render();
 }
 
@@ -151,6 +165,8 @@ void ObjectsRenderer::ReleaseDeviceDependentResources()
 
 	m_perFrameCB->Reset();
 	m_perObjectCB->Reset();
+	m_drawContext->ReleaseDeviceDependentResources();
+	m_queue.ResetIds();
 	m_skull->ReleaseDeviceDependentResources();
 	m_sphere->ReleaseDeviceDependentResources();
 	m_base->ReleaseDeviceDependentResources();
@@ -236,26 +252,16 @@ void ObjectsRenderer::InitSphere()
 	objectData->UseIndex = true;
 	objectData->UseEx = false;
 
-	GeometryGenerator::MeshData sphere;
-	GeometryGenerator geoGen;
-	geoGen.CreateSphere(0.5f, 20, 20, sphere);
-
-	int sphereIndexCount = sphere.Indices.size();
-
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
+	// Generate the sphere straight into the vertex and index buffers, without tangents.
 	auto& vertices = objectData->VertexData;
-	vertices.resize(sphere.Vertices.size());
-	for (size_t i = 0; i < sphere.Vertices.size(); ++i)
-	{
-		vertices[i].Pos = sphere.Vertices[i].Position;
-		vertices[i].Normal = sphere.Vertices[i].Normal;
-		vertices[i].Tex = sphere.Vertices[i].TexC;
-	}
-
-	// Pack the indices of all the meshes into one index buffer.
 	auto& indices = objectData->IndexData;
-	indices.assign(sphere.Indices.begin(), sphere.Indices.end());
+	vertices.resize(GeometryGenerator::GetSphereVertexCount(20, 20));
+	indices.resize(GeometryGenerator::GetSphereIndexCount(20, 20));
+
+	GeometryGenerator geoGen;
+	geoGen.CreateSphere<PosNormalTexPolicy<Basic32>>(0.5f, 20, 20, vertices.data(), indices.data());
+
+	int sphereIndexCount = indices.size();
 
 	// Set unit data
 	XMFLOAT4X4 sphereWorld[10];
@@ -293,6 +299,8 @@ void ObjectsRenderer::InitSphere()
 	objectFeature.TextureEnable = true;
 	objectFeature.ReflectEnable = true;
 	objectFeature.ReflectFileName = L"Media\\Textures\\grasscube1024.dds";
+	// The ten spheres share one texture, one instanced draw
+	objectFeature.InstanceEnable = true;
 
 	m_sphere->Initialize(objectData, objectFeature);
 }
@@ -304,25 +312,20 @@ void ObjectsRenderer::InitBase()
 	objectData->UseIndex = true;
 	objectData->UseEx = true;
 
-	// Init shapes
-	GeometryGenerator::MeshData box;
-	GeometryGenerator::MeshData grid;
-	GeometryGenerator::MeshData cylinder;
-
-	GeometryGenerator geoGen;
-	geoGen.CreateBox(1.0f, 1.0f, 1.0f, box);
-	geoGen.CreateGrid(20.0f, 30.0f, 60, 40, grid);
-	geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20, cylinder);
+	// Cache the vertex count of each object.
+	UINT boxVertexCount = GeometryGenerator::GetBoxVertexCount();
+	UINT gridVertexCount = GeometryGenerator::GetGridVertexCount(60, 40);
+	UINT cylinderVertexCount = GeometryGenerator::GetCylinderVertexCount(20, 20);
 
 	// Cache the vertex offsets to each object in the concatenated vertex buffer.
 	int boxVertexOffset = 0;
-	int gridVertexOffset = box.Vertices.size();
-	int cylinderVertexOffset = gridVertexOffset + grid.Vertices.size();
+	int gridVertexOffset = boxVertexCount;
+	int cylinderVertexOffset = gridVertexOffset + gridVertexCount;
 
 	// Cache the index count of each object.
-	int boxIndexCount = box.Indices.size();
-	int gridIndexCount = grid.Indices.size();
-	int cylinderIndexCount = cylinder.Indices.size();
+	int boxIndexCount = GeometryGenerator::GetBoxIndexCount();
+	int gridIndexCount = GeometryGenerator::GetGridIndexCount(60, 40);
+	int cylinderIndexCount = GeometryGenerator::GetCylinderIndexCount(20, 20);
 
 	// Cache the starting index for each object in the concatenated index buffer.
 	int boxIndexOffset = 0;
@@ -330,51 +333,27 @@ void ObjectsRenderer::InitBase()
 	int cylinderIndexOffset = gridIndexOffset + gridIndexCount;
 
 	UINT totalVertexCount =
-		box.Vertices.size() +
-		grid.Vertices.size() +
-		cylinder.Vertices.size();
+		boxVertexCount +
+		gridVertexCount +
+		cylinderVertexCount;
 
 	UINT totalIndexCount =
 		boxIndexCount +
 		gridIndexCount +
 		cylinderIndexCount;
 
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
-
+	// Generate the shapes straight into their part of one vertex buffer and one index
+	// buffer. Indices are relative to the first vertex of each shape.
 	auto& vertices = objectData->VertexDataEx;
+	auto& indices = objectData->IndexData;
 	vertices.resize(totalVertexCount);
+	indices.resize(totalIndexCount);
 
-	UINT k = 0;
-	for (size_t i = 0; i < box.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = box.Vertices[i].Position;
-		vertices[k].Normal = box.Vertices[i].Normal;
-		vertices[k].Tex = box.Vertices[i].TexC;
-		vertices[k].TangentU = box.Vertices[i].TangentU;
-	}
-
-	for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = grid.Vertices[i].Position;
-		vertices[k].Normal = grid.Vertices[i].Normal;
-		vertices[k].Tex = grid.Vertices[i].TexC;
-		vertices[k].TangentU = grid.Vertices[i].TangentU;
-	}
-
-	for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = cylinder.Vertices[i].Position;
-		vertices[k].Normal = cylinder.Vertices[i].Normal;
-		vertices[k].Tex = cylinder.Vertices[i].TexC;
-		vertices[k].TangentU = cylinder.Vertices[i].TangentU;
-	}
-
-	// Pack the indices of all the meshes into one index buffer.
-	auto& indices = objectData->IndexData;
-	indices.insert(indices.end(), box.Indices.begin(), box.Indices.end());
-	indices.insert(indices.end(), grid.Indices.begin(), grid.Indices.end());
-	indices.insert(indices.end(), cylinder.Indices.begin(), cylinder.Indices.end());
+	GeometryGenerator geoGen;
+	typedef PosNormalTexTanPolicy<PosNormalTexTan> Policy;
+	geoGen.CreateBox<Policy>(1.0f, 1.0f, 1.0f, &vertices[boxVertexOffset], &indices[boxIndexOffset]);
+	geoGen.CreateGrid<Policy>(20.0f, 30.0f, 60, 40, &vertices[gridVertexOffset], &indices[gridIndexOffset]);
+	geoGen.CreateCylinder<Policy>(0.5f, 0.3f, 3.0f, 20, 20, &vertices[cylinderVertexOffset], &indices[cylinderIndexOffset]);
 
 	// Set unit data
 	XMFLOAT4X4 gridWorld, boxWorld, cylWorld[10];
@@ -414,7 +393,7 @@ void ObjectsRenderer::InitBase()
 	objectData->Units.resize(3);
 	// box
 	auto& unit0 = objectData->Units[0];
-	unit0.VCount = box.Vertices.size();
+	unit0.VCount = boxVertexCount;
 	unit0.Base = boxVertexOffset;
 	unit0.Count = boxIndexCount;
 	unit0.Start = boxIndexOffset;
@@ -426,7 +405,7 @@ void ObjectsRenderer::InitBase()
 	
 	// grid
 	auto& unit1 = objectData->Units[1];
-	unit1.VCount = grid.Vertices.size();
+	unit1.VCount = gridVertexCount;
 	unit1.Base = gridVertexOffset;
 	unit1.Count = gridIndexCount;
 	unit1.Start = gridIndexOffset;
@@ -440,7 +419,7 @@ void ObjectsRenderer::InitBase()
 
 	// cylinder
 	auto& unit2 = objectData->Units[2];
-	unit2.VCount = cylinder.Vertices.size();
+	unit2.VCount = cylinderVertexCount;
 	unit2.Base = cylinderVertexOffset;
 	unit2.Count = cylinderIndexCount;
 	unit2.Start = cylinderIndexOffset;
@@ -458,6 +437,9 @@ void ObjectsRenderer::InitBase()
 	objectFeature.LightCount = 3;
 	objectFeature.TextureEnable = true;
 	objectFeature.NormalEnable = true;
+	// The cylinders share their textures and are drawn with one instanced call, the box and
+	// the grid keep the per instance path. Instancing does not combine with tessellation.
+	objectFeature.InstanceEnable = true;
 	/*objectFeature.TessEnable = true;
 	objectFeature.TessDesc.HeightScale = 0.07f;
 	objectFeature.TessDesc.MaxTessDistance = 1.0f;
@@ -466,12 +448,41 @@ void ObjectsRenderer::InitBase()
 	objectFeature.TessDesc.MinTessFactor = 1.0f;*/
 
 	m_base->Initialize(objectData, objectFeature);
+	// The ground and the walls fill most of the view, their maps are streamed
+	m_base->SetTextureStreaming(true);
+}
+
+// Report the closest instance under a point of the window, in DIPs.
+void ObjectsRenderer::Pick(float x, float y)
+{
+	// Ray through the point in view space, then to world space.
+	Size size = m_deviceResources->GetLogicalSize();
+	XMFLOAT4X4 proj;
+	XMStoreFloat4x4(&proj, m_camera->Proj());
+	float vx = (2.0f * x / size.Width - 1.0f) / proj(0, 0);
+	float vy = (-2.0f * y / size.Height + 1.0f) / proj(1, 1);
+
+	XMMATRIX view = m_camera->View();
+	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+	XMVECTOR direction = XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(vx, vy, 1.0f, 0.0f), invView));
+
+	UINT id;
+	float dist;
+	if (!m_sceneBvh->Raycast(m_camera->GetPositionXM(), direction, PickDistance, id, dist))
+		return;
+
+	const SceneBvhItem& item = m_sceneBvh->GetItem(id);
+	std::wstring name = item.Owner == m_skull.get() ? L"skull" : item.Owner == m_sphere.get() ? L"sphere" : L"base";
+	OutputDebugString((L"Picked " + name + L" unit " + std::to_wstring(item.Group) + L" instance " +
+		std::to_wstring(item.Index) + L" at " + std::to_wstring(dist) + L"\n").c_str());
 }
 
 // Input control
 void ObjectsRenderer::OnPointerPressed(Windows::UI::Core::PointerEventArgs^ args)
 {
-
+	if (!m_loadingComplete)
+		return;
+	Pick(args->CurrentPoint->Position.X, args->CurrentPoint->Position.Y);
 }
 void ObjectsRenderer::OnPointerReleased(Windows::UI::Core::PointerEventArgs^ args)
 {
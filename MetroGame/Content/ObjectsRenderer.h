@@ -10,6 +10,8 @@
 #include "Common\LightHelper.h"
 #include "Components\BasicObject.h"
 #include "Components\Sky.h"
+#include "Components\SceneBvh.h"
+#include "Components\D3DDrawContext.h"
 
 namespace DXFramework
 {
@@ -40,6 +42,7 @@ namespace DXFramework
 		void InitSkull();
 		void InitSphere();
 		void InitBase();
+		void Pick(float x, float y);
 
 	private:
 		// Cached pointer to device resources.
@@ -53,6 +56,11 @@ namespace DXFramework
 		std::unique_ptr<BasicObject> m_sphere;
 		std::unique_ptr<BasicObject> m_base;
 		std::unique_ptr<Sky> m_sky;
+		// Every instance of the objects above, for picking
+		std::unique_ptr<SceneBvh> m_sceneBvh;
+		// The objects are submitted here and drawn sorted by state
+		RenderQueue m_queue;
+		std::unique_ptr<D3DDrawContext> m_drawContext;
 		DX::DirectionalLight m_dirLights[3];
 
 		// Variables used with the rendering loop.
@@ -47,6 +47,7 @@ ShadowObjectsRenderer::ShadowObjectsRenderer(const std::shared_ptr<DX::DeviceRes
 
 	m_perFrameCB = std::make_shared<ConstantBuffer<BasicPerFrameCB>>();
 	m_perObjectCB = std::make_shared<ConstantBuffer<BasicPerObjectCB>>();
+	m_drawContext = std::make_unique<D3DDrawContext>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_skull = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_sphere = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
 	m_base = std::make_unique<BasicObject>(deviceResources, m_perFrameCB, m_perObjectCB);
@@ -89,6 +90,7 @@ void ShadowObjectsRenderer::CreateDeviceDependentResources()
 	// Initialize constant buffer
 	m_perFrameCB->Initialize(m_deviceResources->GetD3DDevice());
 	m_perObjectCB->Initialize(m_deviceResources->GetD3DDevice());
+	m_drawContext->CreateDeviceDependentResources();
 
 	m_skull->CreateDeviceDependentResourcesAsync()
 		.then([=]()
@@ -185,9 +187,13 @@ void ShadowObjectsRenderer::Render()
 	m_sphere->UpdateShadowMapSRV(m_shadowHelper->GetDepthMapSRV());
 	m_base->UpdateShadowMapSRV(m_shadowHelper->GetDepthMapSRV());
 
-	m_skull->Render();
-	m_sphere->Render();
-	m_base->Render(true);
+	m_queue.Clear();
+	m_queue.SetView(m_camera->GetPosition());
+	m_skull->Submit(m_queue);
+	m_sphere->Submit(m_queue);
+	m_base->Submit(m_queue);
+	m_queue.Sort();
+	m_queue.Execute(*m_drawContext);
 	m_sky->Render();
 }
 
@@ -197,6 +203,8 @@ void ShadowObjectsRenderer::ReleaseDeviceDependentResources()
 
 	m_perFrameCB->Reset();
 	m_perObjectCB->Reset();
+	m_drawContext->ReleaseDeviceDependentResources();
+	m_queue.ResetIds();
 	m_skull->ReleaseDeviceDependentResources();
 	m_sphere->ReleaseDeviceDependentResources();
 	m_base->ReleaseDeviceDependentResources();
@@ -284,26 +292,16 @@ void ShadowObjectsRenderer::InitSphere()
 	objectData->UseIndex = true;
 	objectData->UseEx = false;
 
-	GeometryGenerator::MeshData sphere;
-	GeometryGenerator geoGen;
-	geoGen.CreateSphere(0.5f, 20, 20, sphere);
-
-	int sphereIndexCount = sphere.Indices.size();
-
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
+	// Generate the sphere straight into the vertex and index buffers, without tangents.
 	auto& vertices = objectData->VertexData;
-	vertices.resize(sphere.Vertices.size());
-	for (size_t i = 0; i < sphere.Vertices.size(); ++i)
-	{
-		vertices[i].Pos = sphere.Vertices[i].Position;
-		vertices[i].Normal = sphere.Vertices[i].Normal;
-		vertices[i].Tex = sphere.Vertices[i].TexC;
-	}
-
-	// Pack the indices of all the meshes into one index buffer.
 	auto& indices = objectData->IndexData;
-	indices.assign(sphere.Indices.begin(), sphere.Indices.end());
+	vertices.resize(GeometryGenerator::GetSphereVertexCount(20, 20));
+	indices.resize(GeometryGenerator::GetSphereIndexCount(20, 20));
+
+	GeometryGenerator geoGen;
+	geoGen.CreateSphere<PosNormalTexPolicy<Basic32>>(0.5f, 20, 20, vertices.data(), indices.data());
+
+	int sphereIndexCount = indices.size();
 
 	// Set unit data
 	XMFLOAT4X4 sphereWorld[10];
@@ -353,25 +351,20 @@ void ShadowObjectsRenderer::InitBase()
 	objectData->UseIndex = true;
 	objectData->UseEx = true;
 
-	// Init shapes
-	GeometryGenerator::MeshData box;
-	GeometryGenerator::MeshData grid;
-	GeometryGenerator::MeshData cylinder;
-
-	GeometryGenerator geoGen;
-	geoGen.CreateBox(1.0f, 1.0f, 1.0f, box);
-	geoGen.CreateGrid(20.0f, 30.0f, 60, 40, grid);
-	geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20, cylinder);
+	// Cache the vertex count of each object.
+	UINT boxVertexCount = GeometryGenerator::GetBoxVertexCount();
+	UINT gridVertexCount = GeometryGenerator::GetGridVertexCount(60, 40);
+	UINT cylinderVertexCount = GeometryGenerator::GetCylinderVertexCount(20, 20);
 
 	// Cache the vertex offsets to each object in the concatenated vertex buffer.
 	int boxVertexOffset = 0;
-	int gridVertexOffset = box.Vertices.size();
-	int cylinderVertexOffset = gridVertexOffset + grid.Vertices.size();
+	int gridVertexOffset = boxVertexCount;
+	int cylinderVertexOffset = gridVertexOffset + gridVertexCount;
 
 	// Cache the index count of each object.
-	int boxIndexCount = box.Indices.size();
-	int gridIndexCount = grid.Indices.size();
-	int cylinderIndexCount = cylinder.Indices.size();
+	int boxIndexCount = GeometryGenerator::GetBoxIndexCount();
+	int gridIndexCount = GeometryGenerator::GetGridIndexCount(60, 40);
+	int cylinderIndexCount = GeometryGenerator::GetCylinderIndexCount(20, 20);
 
 	// Cache the starting index for each object in the concatenated index buffer.
 	int boxIndexOffset = 0;
@@ -379,51 +372,27 @@ void ShadowObjectsRenderer::InitBase()
 	int cylinderIndexOffset = gridIndexOffset + gridIndexCount;
 
 	UINT totalVertexCount =
-		box.Vertices.size() +
-		grid.Vertices.size() +
-		cylinder.Vertices.size();
+		boxVertexCount +
+		gridVertexCount +
+		cylinderVertexCount;
 
 	UINT totalIndexCount =
 		boxIndexCount +
 		gridIndexCount +
 		cylinderIndexCount;
 
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
-
+	// Generate the shapes straight into their part of one vertex buffer and one index
+	// buffer. Indices are relative to the first vertex of each shape.
 	auto& vertices = objectData->VertexDataEx;
+	auto& indices = objectData->IndexData;
 	vertices.resize(totalVertexCount);
+	indices.resize(totalIndexCount);
 
-	UINT k = 0;
-	for (size_t i = 0; i < box.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = box.Vertices[i].Position;
-		vertices[k].Normal = box.Vertices[i].Normal;
-		vertices[k].Tex = box.Vertices[i].TexC;
-		vertices[k].TangentU = box.Vertices[i].TangentU;
-	}
-
-	for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = grid.Vertices[i].Position;
-		vertices[k].Normal = grid.Vertices[i].Normal;
-		vertices[k].Tex = grid.Vertices[i].TexC;
-		vertices[k].TangentU = grid.Vertices[i].TangentU;
-	}
-
-	for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = cylinder.Vertices[i].Position;
-		vertices[k].Normal = cylinder.Vertices[i].Normal;
-		vertices[k].Tex = cylinder.Vertices[i].TexC;
-		vertices[k].TangentU = cylinder.Vertices[i].TangentU;
-	}
-
-	// Pack the indices of all the meshes into one index buffer.
-	auto& indices = objectData->IndexData;
-	indices.insert(indices.end(), box.Indices.begin(), box.Indices.end());
-	indices.insert(indices.end(), grid.Indices.begin(), grid.Indices.end());
-	indices.insert(indices.end(), cylinder.Indices.begin(), cylinder.Indices.end());
+	GeometryGenerator geoGen;
+	typedef PosNormalTexTanPolicy<PosNormalTexTan> Policy;
+	geoGen.CreateBox<Policy>(1.0f, 1.0f, 1.0f, &vertices[boxVertexOffset], &indices[boxIndexOffset]);
+	geoGen.CreateGrid<Policy>(20.0f, 30.0f, 60, 40, &vertices[gridVertexOffset], &indices[gridIndexOffset]);
+	geoGen.CreateCylinder<Policy>(0.5f, 0.3f, 3.0f, 20, 20, &vertices[cylinderVertexOffset], &indices[cylinderIndexOffset]);
 
 	// Set unit data
 	XMFLOAT4X4 gridWorld, boxWorld, cylWorld[10];
@@ -463,7 +432,7 @@ void ShadowObjectsRenderer::InitBase()
 	objectData->Units.resize(3);
 	// box
 	auto& unit0 = objectData->Units[0];
-	unit0.VCount = box.Vertices.size();
+	unit0.VCount = boxVertexCount;
 	unit0.Base = boxVertexOffset;
 	unit0.Count = boxIndexCount;
 	unit0.Start = boxIndexOffset;
@@ -475,7 +444,7 @@ void ShadowObjectsRenderer::InitBase()
 	
 	// grid
 	auto& unit1 = objectData->Units[1];
-	unit1.VCount = grid.Vertices.size();
+	unit1.VCount = gridVertexCount;
 	unit1.Base = gridVertexOffset;
 	unit1.Count = gridIndexCount;
 	unit1.Start = gridIndexOffset;
@@ -489,7 +458,7 @@ void ShadowObjectsRenderer::InitBase()
 
 	// cylinder
 	auto& unit2 = objectData->Units[2];
-	unit2.VCount = cylinder.Vertices.size();
+	unit2.VCount = cylinderVertexCount;
 	unit2.Base = cylinderVertexOffset;
 	unit2.Count = cylinderIndexCount;
 	unit2.Start = cylinderIndexOffset;
@@ -11,6 +11,7 @@
 #include "Components\BasicObject.h"
 #include "Components\Sky.h"
 #include "Components\ShadowHelper.h"
+#include "Components\D3DDrawContext.h"
 
 namespace DXFramework
 {
@@ -55,6 +56,8 @@ namespace DXFramework
 		std::unique_ptr<BasicObject> m_base;
 		std::unique_ptr<ShadowHelper> m_shadowHelper;
 		std::unique_ptr<Sky> m_sky;
+		RenderQueue m_queue;
+		std::unique_ptr<D3DDrawContext> m_drawContext;
 		DX::DirectionalLight m_dirLights[3];
 
 		DirectX::XMFLOAT3 m_originalLightDir[3];
@@ -100,6 +100,9 @@ void SkinnedMeshModelRenderer::Update(DX::GameTimer const& timer)
 		lightDir = XMVector3TransformNormal(lightDir, R);
 		XMStoreFloat3(&m_dirLights[i].Direction, lightDir);
 	}
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, m_camera->ViewProj());
+	m_mesh->SetAnimationView(m_camera->GetPosition(), viewProj);
 	m_mesh->Update((float)timer.GetElapsedSeconds());
 }
 
@@ -152,7 +155,9 @@ void SkinnedMeshModelRenderer::InitMesh()
 	MeshObjectData* objectData = new MeshObjectData();
 	MeshFeatureConfigure objectFeature = { 0 };
 	objectData->Skinned = true;
-	X3DLoader::LoadX3dSkinned(L"Media\\Meshes\\DHellFighter\\DHellFighter.x3d", objectData->VertexDataSkinned, objectData->IndexData, objectData->Subsets, objectData->Material, objectData->SkinInfo);
+	// Keep the clips compressed, the default tolerance is well below a pixel at this scale.
+	AnimationCompressionSettings compression;
+	X3DLoader::LoadX3dSkinned(L"Media\\Meshes\\DHellFighter\\DHellFighter.x3d", objectData->VertexDataSkinned, objectData->IndexData, objectData->Subsets, objectData->Material, objectData->SkinInfo, &compression);
 	
 	// Make sure that the clip name (or animation stack name) exists in the original file.
 	// Or a exception will be thrown.
@@ -165,6 +170,8 @@ void SkinnedMeshModelRenderer::InitMesh()
 	XMStoreFloat4x4(&objectData->Worlds[0], modelScale*modelRot*modelOffset);
 
 	objectFeature.Loop = true;
+	// Rigid skeleton, dual quaternions keep the joints from collapsing when they twist.
+	objectFeature.DualQuaternion = true;
 	objectFeature.LightCount = 3;
 
 	m_mesh->Initialize(objectData, objectFeature, L"Media\\Meshes\\DHellFighter\\");
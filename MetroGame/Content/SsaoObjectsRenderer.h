@@ -13,6 +13,7 @@
 #include "Components\ShadowHelper.h"
 #include "Components\SsaoHelper.h"
 #include "Components\MapDisplayer.h"
+#include "Components\D3DDrawContext.h"
 
 namespace DXFramework
 {
@@ -59,6 +60,8 @@ namespace DXFramework
 		std::unique_ptr<SsaoHelper> m_ssaoHelper;
 		std::unique_ptr<Sky> m_sky;
 		std::unique_ptr<MapDisplayer> m_mapDisplayer;
+		RenderQueue m_queue;
+		std::unique_ptr<D3DDrawContext> m_drawContext;
 		DX::DirectionalLight m_dirLights[3];
 
 		DirectX::XMFLOAT3 m_originalLightDir[3];
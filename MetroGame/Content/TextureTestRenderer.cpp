@@ -143,25 +143,17 @@ void TextureTestRenderer::InitPlane()
 	auto data = new std::vector<BasicElementData>(1);
 	auto& elementData = (*data)[0];
 
-	GeometryGenerator::MeshData grid;
-	GeometryGenerator geoGen;
-	geoGen.CreateGrid(40.0f, 60.0f, 120, 80, grid);
-	int gridIndexCount = grid.Indices.size();
-	int gridVerticesCount = grid.Vertices.size();
+	int gridIndexCount = GeometryGenerator::GetGridIndexCount(120, 80);
+	int gridVerticesCount = GeometryGenerator::GetGridVertexCount(120, 80);
 
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
+	// Generate the grid straight into the vertex and index buffers, without tangents.
 	auto& vertices = elementData.VertexData;
-	vertices.resize(gridVerticesCount);
-	for (int i = 0; i < gridVerticesCount; ++i)
-	{
-		vertices[i].Pos = grid.Vertices[i].Position;
-		vertices[i].Normal = grid.Vertices[i].Normal;
-		vertices[i].Tex = grid.Vertices[i].TexC;
-	}
-	// Pack index data
 	auto& indices = elementData.IndexData;
-	indices.insert(indices.end(), grid.Indices.begin(), grid.Indices.end());
+	vertices.resize(gridVerticesCount);
+	indices.resize(gridIndexCount);
+
+	GeometryGenerator geoGen;
+	geoGen.CreateGrid<PosNormalTexPolicy<Basic32>>(40.0f, 60.0f, 120, 80, vertices.data(), indices.data());
 
 	// Set unit data
 	XMFLOAT4X4 gridWorld;
@@ -22,11 +22,17 @@ DXFrameworkMain::DXFrameworkMain(const std::shared_ptr<DX::DeviceResources>& dev
 	// Register to be notified if the Device is lost or recreated
 	m_deviceResources->RegisterDeviceNotify(this);
 
+	// Assets found in the pack are read from it, the others from loose files
+	m_assetPack = std::make_unique<AssetPack>();
+	m_assetPack->Open("Assets.pak");
+
 	m_loader = std::make_shared<BasicLoader>(deviceResources->GetD3DDevice(), deviceResources->GetD3DDeviceContext(),
 		deviceResources->GetWicImagingFactory());
 	m_camera = std::make_shared<Camera>();
 
 	m_shaderMgr = std::make_unique<ShaderMgr>(m_loader);
+	// BasicObject shader permutations, read in one go while the scene starts loading
+	m_permutationsLoaded = m_shaderMgr->LoadPermutationsAsync("ShaderPermutations.bin");
 	m_textureMgr = std::make_unique<TextureMgr>(m_loader);
 	m_renderStateMgr = std::make_unique<RenderStateMgr>();
 	m_loadScreen = std::make_unique<LoadScreen>();
@@ -139,6 +145,13 @@ bool DXFrameworkMain::Render()
 	}
 
 	auto context = m_deviceResources->GetD3DDeviceContext();
+	// Start the frame counts, and start tracking from nothing as D2D drew on the context
+	auto tracker = m_deviceResources->GetStateTracker();
+	tracker->BeginFrame();
+	tracker->Invalidate();
+	// Constant data of the last frame is no longer needed, the ring starts over with DISCARD
+	if (m_deviceResources->GetConstantRing())
+		m_deviceResources->GetConstantRing()->BeginFrame();
 
 	// Reset the viewport to target the whole screen.
 	auto viewport = m_deviceResources->GetScreenViewport();
@@ -146,7 +159,7 @@ bool DXFrameworkMain::Render()
 
 	// Reset render targets to the screen.
 	ID3D11RenderTargetView *const targets[1] = { m_deviceResources->GetBackBufferRenderTargetView() };
-	context->OMSetRenderTargets(1, targets, m_deviceResources->GetDepthStencilView());
+	tracker->OMSetRenderTargets(1, targets, m_deviceResources->GetDepthStencilView());
 
 	// Clear the back buffer and depth stencil view.
 	context->ClearRenderTargetView(m_deviceResources->GetBackBufferRenderTargetView(), DirectX::Colors::Silver);
@@ -155,7 +168,8 @@ bool DXFrameworkMain::Render()
 	// Render the load screen
 	if (!m_sceneRenderer->GetLoadState())
 	{
-		if (!m_firstFlag && m_sceneRenderer->GetInitializedState())
+		// The scene shaders are created once the permutation blob is in, not queued behind it
+		if (!m_firstFlag && m_sceneRenderer->GetInitializedState() && m_permutationsLoaded.is_done())
 		{
 			m_firstFlag = true;
 			m_sceneRenderer->CreateDeviceDependentResources();
@@ -172,6 +186,9 @@ bool DXFrameworkMain::Render()
 	m_sceneRenderer->Render();
 	m_fpsTextRenderer->Render();
 
+	// The scene noted the streamed textures it used, load and evict for the next frame
+	m_textureMgr->UpdateStreaming();
+
 	return true;
 }
 
@@ -202,6 +219,7 @@ void DXFrameworkMain::OnDeviceRestored()
 	m_loader = std::make_shared<BasicLoader>(m_deviceResources->GetD3DDevice(), m_deviceResources->GetD3DDeviceContext(),
 		m_deviceResources->GetWicImagingFactory());
 	m_shaderMgr = std::make_unique<ShaderMgr>(m_loader);
+	m_permutationsLoaded = m_shaderMgr->LoadPermutationsAsync("ShaderPermutations.bin");
 	m_textureMgr = std::make_unique<TextureMgr>(m_loader);
 	m_renderStateMgr = std::make_unique<RenderStateMgr>();
 
@@ -13,6 +13,7 @@
 
 #include "Common\GameTimer.h"
 #include "Common\DeviceResources.h"
+#include "Common\AssetPack.h"
 #include "Common\BasicLoader.h"
 #include "Common\Camera.h"
 #include "Common\RenderStateMgr.h"
@@ -51,10 +52,12 @@ namespace DXFramework
 		std::shared_ptr<DX::DeviceResources> m_deviceResources;
 
 		// Shared between classes
+		std::unique_ptr<DX::AssetPack> m_assetPack;
 		std::shared_ptr<DX::BasicLoader> m_loader;
 		std::shared_ptr<DX::Camera> m_camera;
 		
 		std::unique_ptr<DX::ShaderMgr> m_shaderMgr;
+		concurrency::task<void> m_permutationsLoaded;
 		std::unique_ptr<DX::TextureMgr> m_textureMgr;
 		std::unique_ptr<DX::RenderStateMgr> m_renderStateMgr;
 		 
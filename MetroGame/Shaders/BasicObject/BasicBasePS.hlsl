@@ -1,6 +1,7 @@
 // Note the specific ps shader should be named in this pattern: 
 // "BasicPS11111311.hlsl", the digit is according to texture, clip,
 // normal, shadow, ssao, light count, reflect and fog features.
+// The instanced variants are named "BasicInstPS11111311.hlsl".
 
 #ifndef TEX_ENABLE
 #define TEX_ENABLE 0
@@ -34,6 +35,10 @@
 #define FOG_ENABLE 0
 #endif
 
+#ifndef INSTANCE_ENABLE
+#define INSTANCE_ENABLE 0
+#endif
+
 
 #include "../ShaderInclude.hlsl"
 
@@ -61,6 +66,10 @@ Texture2D gSsaoMap		: register(t3);
 #if REFLECT_ENABLE==1
 TextureCube gCubeMap	: register(t4);
 #endif
+#if INSTANCE_ENABLE==1
+// Materials of all instanced units, indexed by the instance stream.
+StructuredBuffer<Material> gInstanceMaterials : register(t5);
+#endif
 
 #if TEX_ENABLE==1 || SSAO_ENABLE==1 || REFLECT_ENABLE==1
 SamplerState sampleFilter				: register(s0);		// Often use linear sampler.
@@ -84,10 +93,19 @@ struct PixelIn
 #if SSAO_ENABLE==1
 	float4 SsaoPosH   : TEXCOORD2;
 #endif
+#if INSTANCE_ENABLE==1
+	nointerpolation uint MatIndex : MATINDEX;
+#endif
 };
 
 float4 main(PixelIn pin) : SV_TARGET
 {
+#if INSTANCE_ENABLE==1
+	Material mat = gInstanceMaterials[pin.MatIndex];
+#else
+	Material mat = gMaterial;
+#endif
+
 	// Interpolating normal can unnormalize it, so normalize it.
     pin.NormalW = normalize(pin.NormalW);
 
@@ -147,7 +165,7 @@ float4 main(PixelIn pin) : SV_TARGET
 	for(int i = 0; i < LIGHT_COUNT; ++i)
 	{
 		float4 A, D, S;
-		ComputeDirectionalLight(gMaterial, gDirLights[i], normalW, toEye, 
+		ComputeDirectionalLight(mat, gDirLights[i], normalW, toEye, 
 			A, D, S);
 
 		ambient += ambientAccess*A;
@@ -165,7 +183,7 @@ float4 main(PixelIn pin) : SV_TARGET
 	float3 reflectionVector = reflect(incident, normalW);
 	float4 reflectionColor = gCubeMap.Sample(sampleFilter, reflectionVector);
 
-	litColor += gMaterial.Reflect*reflectionColor;
+	litColor += mat.Reflect*reflectionColor;
 #endif
 
 	// Fogging
@@ -176,7 +194,7 @@ float4 main(PixelIn pin) : SV_TARGET
 #endif
 
 	// Common to take alpha from diffuse material and texture.
-	litColor.a = gMaterial.Diffuse.a * texColor.a;
+	litColor.a = mat.Diffuse.a * texColor.a;
 
     return litColor;
 }
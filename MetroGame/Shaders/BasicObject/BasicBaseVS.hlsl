@@ -1,6 +1,12 @@
 // Note the specific vs shader should be named in this pattern: 
 // "BasicVS1111.hlsl", the digit is according to normal, displace,
 // shadow and ssao features.
+// The instanced variants are named "BasicInstVS111.hlsl", the digit is
+// according to normal, shadow and ssao features. They take the world
+// matrices and material index from the instance stream and do not
+// support tessellation.
+// The dual quaternion skinned variants are named "BasicDQVS111.hlsl",
+// with the same digits. They read a (real, dual) pair per bone.
 
 #ifndef NORMAL_ENABLE
 #define NORMAL_ENABLE 0
@@ -22,6 +28,14 @@
 #define SKINNED_ENABLE 0
 #endif
 
+#ifndef DUAL_QUATERNION_ENABLE
+#define DUAL_QUATERNION_ENABLE 0
+#endif
+
+#ifndef INSTANCE_ENABLE
+#define INSTANCE_ENABLE 0
+#endif
+
 #include "../ShaderInclude.hlsl"
 
 cbuffer cbPerObject : register(b1)
@@ -46,7 +60,12 @@ cbuffer cbTessSettings  : register(b2)
 #if SKINNED_ENABLE==1
 cbuffer cbSkinned : register(b3)
 {
+#if DUAL_QUATERNION_ENABLE==1
+	// Real and dual part per bone
+	float4 gBoneDualQuaternions[96 * 2];
+#else
 	float4x4 gBoneTransforms[96];
+#endif
 };
 #endif
 
@@ -62,6 +81,17 @@ struct VertexIn
 	float3 Weights    : WEIGHTS;
 	uint4 BoneIndices : BONEINDICES;
 #endif
+#if INSTANCE_ENABLE==1
+	// Rows of the world matrix, and rows of the transposed inverse transpose.
+	float4 World0     : WORLD0;
+	float4 World1     : WORLD1;
+	float4 World2     : WORLD2;
+	float4 World3     : WORLD3;
+	float4 WorldInvTranspose0 : WORLDINVTRANSPOSE0;
+	float4 WorldInvTranspose1 : WORLDINVTRANSPOSE1;
+	float4 WorldInvTranspose2 : WORLDINVTRANSPOSE2;
+	uint MatIndex     : MATINDEX;
+#endif
 };
 
 #if NORMAL_ENABLE==1 && TESS_ENABLE==1
@@ -89,6 +119,9 @@ struct VertexOut
 #if SSAO_ENABLE==1
 	float4 SsaoPosH   : TEXCOORD2;
 #endif
+#if INSTANCE_ENABLE==1
+	nointerpolation uint MatIndex : MATINDEX;
+#endif
 };
 #endif
 
@@ -128,6 +161,20 @@ VertexOut main(VertexIn vin)
 	weights[2] = vin.Weights.z;
 	weights[3] = 1.0f - weights[0] - weights[1] - weights[2];
 
+#if DUAL_QUATERNION_ENABLE==1
+	float4 real[4];
+	float4 dual[4];
+	[unroll]
+	for (int i = 0; i < 4; ++i)
+	{
+		real[i] = gBoneDualQuaternions[vin.BoneIndices[i] * 2];
+		dual[i] = gBoneDualQuaternions[vin.BoneIndices[i] * 2 + 1];
+	}
+	float3 posL = vin.PosL;
+	float3 normalL = vin.NormalL;
+	float3 tangentL = vin.TangentL;
+	DualQuaternionSkin(real, dual, weights, posL, normalL, tangentL);
+#else
 	float3 posL = float3(0.0f, 0.0f, 0.0f);
 	float3 normalL = float3(0.0f, 0.0f, 0.0f);
 	float3 tangentL = float3(0.0f, 0.0f, 0.0f);
@@ -141,6 +188,7 @@ VertexOut main(VertexIn vin)
 		tangentL += weights[i] * mul(vin.TangentL.xyz, (float3x3)gBoneTransforms[vin.BoneIndices[i]]);
 #endif
 	}
+#endif
 
 	// Transform to world space space.
 	vout.PosW = mul(float4(posL, 1.0f), gWorld).xyz;
@@ -170,11 +218,19 @@ VertexOut main(VertexIn vin)
 VertexOut main(VertexIn vin)
 {
 	VertexOut vout;
+#if INSTANCE_ENABLE==1
+	float4x4 world = float4x4(vin.World0, vin.World1, vin.World2, vin.World3);
+	float3x3 worldInvTranspose = transpose(float3x3(vin.WorldInvTranspose0.xyz, vin.WorldInvTranspose1.xyz, vin.WorldInvTranspose2.xyz));
+	vout.MatIndex = vin.MatIndex;
+#else
+	float4x4 world = gWorld;
+	float3x3 worldInvTranspose = (float3x3)gWorldInvTranspose;
+#endif
 	// Transform to world space space.
-	vout.PosW = mul(float4(vin.PosL, 1.0f), gWorld).xyz;
-	vout.NormalW = mul(vin.NormalL, (float3x3)gWorldInvTranspose);
+	vout.PosW = mul(float4(vin.PosL, 1.0f), world).xyz;
+	vout.NormalW = mul(vin.NormalL, worldInvTranspose);
 #if NORMAL_ENABLE==1
-	vout.TangentW = mul(vin.TangentL, (float3x3)gWorld);
+	vout.TangentW = mul(vin.TangentL, (float3x3)world);
 #endif
 
 	// Transform to homogeneous clip space.
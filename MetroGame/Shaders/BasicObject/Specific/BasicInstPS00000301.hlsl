@@ -0,0 +1,11 @@
+#define TEX_ENABLE 0
+#define CLIP_ENABLE 0
+#define NORMAL_ENABLE 0
+#define SHADOW_ENABLE 0
+#define SSAO_ENABLE 0
+#define LIGHT_COUNT 3
+#define REFLECT_ENABLE 0
+#define FOG_ENABLE 1
+#define INSTANCE_ENABLE 1
+
+#include "../BasicBasePS.hlsl"
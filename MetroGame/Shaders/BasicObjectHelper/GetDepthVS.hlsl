@@ -6,6 +6,10 @@
 #define SKINNED_ENABLE 0
 #endif
 
+#ifndef DUAL_QUATERNION_ENABLE
+#define DUAL_QUATERNION_ENABLE 0
+#endif
+
 #include "../ShaderInclude.hlsl"
 
 cbuffer cbPerObject : register(b1)
@@ -30,7 +34,12 @@ cbuffer cbTessSettings  : register(b2)
 #if SKINNED_ENABLE==1
 cbuffer cbSkinned : register(b3)
 {
+#if DUAL_QUATERNION_ENABLE==1
+	// Real and dual part per bone
+	float4 gBoneDualQuaternions[96 * 2];
+#else
 	float4x4 gBoneTransforms[96];
+#endif
 };
 #endif
 
@@ -95,6 +104,20 @@ VertexOut main(VertexIn vin)
 	weights[2] = vin.Weights.z;
 	weights[3] = 1.0f - weights[0] - weights[1] - weights[2];
 
+#if DUAL_QUATERNION_ENABLE==1
+	float4 real[4];
+	float4 dual[4];
+	[unroll]
+	for (int i = 0; i < 4; ++i)
+	{
+		real[i] = gBoneDualQuaternions[vin.BoneIndices[i] * 2];
+		dual[i] = gBoneDualQuaternions[vin.BoneIndices[i] * 2 + 1];
+	}
+	float3 posL = vin.PosL;
+	float3 normalL = vin.NormalL;
+	float3 tangentL = vin.TangentL;
+	DualQuaternionSkin(real, dual, weights, posL, normalL, tangentL);
+#else
 	float3 posL = float3(0.0f, 0.0f, 0.0f);
 	for (int i = 0; i < 4; ++i)
 	{
@@ -102,6 +125,7 @@ VertexOut main(VertexIn vin)
 		// that we do not have to use the inverse-transpose.
 		posL += weights[i] * mul(float4(vin.PosL, 1.0f), gBoneTransforms[vin.BoneIndices[i]]).xyz;
 	}
+#endif
 
 	// Transform to world space space.
 	float3 posW = mul(float4(posL, 1.0f), gWorld).xyz;
@@ -280,4 +280,33 @@ float CalcShadowFactor(SamplerComparisonState samShadow,
 	}
 
 	return percentLit /= 9.0f;
+}
+
+//---------------------------------------------------------------------------------------
+// Blends up to four bone dual quaternions (real, dual) and skins a position, a normal
+// and a tangent.
+//---------------------------------------------------------------------------------------
+
+void DualQuaternionSkin(float4 real[4], float4 dual[4], float weights[4],
+	inout float3 pos, inout float3 normal, inout float3 tangent)
+{
+	// Keep every influence in the hemisphere of the first one.
+	float4 blendReal = float4(0.0f, 0.0f, 0.0f, 0.0f);
+	float4 blendDual = float4(0.0f, 0.0f, 0.0f, 0.0f);
+	[unroll]
+	for (int i = 0; i < 4; ++i)
+	{
+		float w = dot(real[0], real[i]) < 0.0f ? -weights[i] : weights[i];
+		blendReal += w * real[i];
+		blendDual += w * dual[i];
+	}
+	float invLength = rsqrt(dot(blendReal, blendReal));
+	blendReal *= invLength;
+	blendDual *= invLength;
+
+	float3 u = blendReal.xyz;
+	float3 translation = 2.0f * (blendReal.w * blendDual.xyz - blendDual.w * u + cross(u, blendDual.xyz));
+	pos = pos + 2.0f * cross(u, cross(u, pos) + blendReal.w * pos) + translation;
+	normal = normal + 2.0f * cross(u, cross(u, normal) + blendReal.w * normal);
+	tangent = tangent + 2.0f * cross(u, cross(u, tangent) + blendReal.w * tangent);
 }
\ No newline at end of file
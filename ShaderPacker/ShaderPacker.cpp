@@ -0,0 +1,127 @@
+#include <windows.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../MetroGame/Common/ShaderPermutations.h"
+
+using namespace std;
+using namespace DX::ShaderPermutations;
+
+struct Permutation
+{
+	uint32_t Key;
+	wstring Name;
+	vector<uint8_t> Bytecode;
+};
+
+vector<Permutation> Permutations;
+
+bool CollectShaders(const wstring& folder)
+{
+	WIN32_FIND_DATAW findData;
+	HANDLE find = FindFirstFileW((folder + L"*.cso").c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE)
+		return false;
+	do
+	{
+		Permutation permutation;
+		if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !ParseFileName(findData.cFileName, permutation.Key))
+			continue;
+		permutation.Name = findData.cFileName;
+		Permutations.push_back(permutation);
+	} while (FindNextFileW(find, &findData));
+	FindClose(find);
+	return true;
+}
+
+bool LoadBytecode(const wstring& folder, Permutation& permutation)
+{
+	ifstream fin(folder + permutation.Name, ios::binary | ios::ate);
+	if (!fin)
+		return false;
+	size_t size = (size_t)fin.tellg();
+	permutation.Bytecode.resize(size);
+	fin.seekg(0);
+	fin.read((char*)permutation.Bytecode.data(), size);
+	return true;
+}
+
+void WritePadding(ofstream& fout, uint32_t& offset)
+{
+	static const char zeros[EntryAlignment] = {};
+	uint32_t padding = (EntryAlignment - offset % EntryAlignment) % EntryAlignment;
+	fout.write(zeros, padding);
+	offset += padding;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	if (argc < 3)
+	{
+		wcout << L"Usage: ShaderPacker <cso folder> <output blob>" << endl;
+		wcout << L"Packs the BasicObject shader permutations of a build into one blob." << endl;
+		return -1;
+	}
+
+	wstring folder = argv[1];
+	if (folder.back() != L'\\' && folder.back() != L'/')
+		folder += L"\\";
+	wstring output = argv[2];
+
+	cout << "Read shaders ..." << endl;
+	if (!CollectShaders(folder))
+	{
+		wcout << L"No compiled shaders in " << folder << endl;
+		return -1;
+	}
+	uint32_t bytecodeBytes = 0;
+	for (auto& permutation : Permutations)
+	{
+		if (!LoadBytecode(folder, permutation))
+		{
+			wcout << L"Cannot read " << permutation.Name << endl;
+			return -1;
+		}
+		bytecodeBytes += (uint32_t)permutation.Bytecode.size();
+	}
+
+	// The index is sorted by key, the runtime binary searches it
+	sort(Permutations.begin(), Permutations.end(), [](const Permutation& a, const Permutation& b) { return a.Key < b.Key; });
+	BlobHeader header = { Magic, Version, (uint32_t)Permutations.size(), EntryAlignment };
+	vector<BlobEntry> entries(Permutations.size());
+	uint32_t offset = sizeof(header) + (uint32_t)(entries.size() * sizeof(BlobEntry));
+	for (size_t i = 0; i < Permutations.size(); ++i)
+	{
+		offset += (EntryAlignment - offset % EntryAlignment) % EntryAlignment;
+		entries[i].Key = Permutations[i].Key;
+		entries[i].Offset = offset;
+		entries[i].Size = (uint32_t)Permutations[i].Bytecode.size();
+		entries[i].Reserved = 0;
+		offset += entries[i].Size;
+	}
+
+	cout << "Write blob ..." << endl;
+	ofstream fout(output, ios::binary);
+	if (!fout)
+	{
+		wcout << L"Cannot create " << output << endl;
+		return -1;
+	}
+	fout.write((const char*)&header, sizeof(header));
+	fout.write((const char*)entries.data(), entries.size() * sizeof(BlobEntry));
+	offset = sizeof(header) + (uint32_t)(entries.size() * sizeof(BlobEntry));
+	for (auto& permutation : Permutations)
+	{
+		WritePadding(fout, offset);
+		fout.write((const char*)permutation.Bytecode.data(), permutation.Bytecode.size());
+		offset += (uint32_t)permutation.Bytecode.size();
+	}
+	fout.close();
+
+	cout << "Permutations: " << Permutations.size() << endl;
+	cout << "Bytecode bytes: " << bytecodeBytes << ", blob bytes: " << offset << endl;
+
+	return 0;
+}
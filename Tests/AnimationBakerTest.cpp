@@ -0,0 +1,270 @@
+// Bake of AnimationPaletteAtlas from a synthetic PaletteSource: clip rows and frame counts,
+// atlas rows equal to the final transforms of the source at each frame time, the frame an
+// instance shows wrapping at the end of its clip, Write/Read round trips and the rejection
+// of bad frame rates, atlases larger than one texture and truncated or malformed streams.
+// Then the bake of a keyframed SkinnedData, whose rows must equal its GetFinalTransforms.
+
+#include "pch.h"
+#include "Components/SkinnedData.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+using namespace DirectX;
+using namespace DXFramework;
+
+static int g_failures = 0;
+
+static void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		++g_failures;
+	}
+}
+
+// Final transforms as SkinnedData returns them: pre-transposed, so the fourth row is 0,0,0,1.
+// Every other element depends on the clip, the time, the bone and its position.
+class TestSource : public PaletteSource
+{
+public:
+	TestSource(UINT boneCount, const std::vector<XMFLOAT2>& clipTimes)
+		: Calls(0), m_boneCount(boneCount), m_clipTimes(clipTimes) {}
+
+	virtual UINT GetBoneCount()const override { return m_boneCount; }
+	virtual UINT GetClipCount()const override { return (UINT)m_clipTimes.size(); }
+	virtual float GetClipStartTime(UINT clipIndex)const override { return m_clipTimes[clipIndex].x; }
+	virtual float GetClipEndTime(UINT clipIndex)const override { return m_clipTimes[clipIndex].y; }
+	virtual void GetFinalTransforms(UINT clipIndex, float timePos, XMFLOAT4X4* finalTransforms) override
+	{
+		++Calls;
+		for (UINT b = 0; b < m_boneCount; ++b)
+			finalTransforms[b] = Expected(clipIndex, timePos, b);
+	}
+
+	static XMFLOAT4X4 Expected(UINT clipIndex, float timePos, UINT bone)
+	{
+		XMFLOAT4X4 m;
+		for (int k = 0; k < 4; ++k)
+		{
+			for (int j = 0; j < 4; ++j)
+				m.m[k][j] = k < 3 ? 100.0f * clipIndex + timePos * (bone + 1) + 0.01f * (4 * k + j) : (j == 3 ? 1.0f : 0.0f);
+		}
+		return m;
+	}
+
+	UINT Calls;
+
+private:
+	UINT m_boneCount;
+	std::vector<XMFLOAT2> m_clipTimes;
+};
+
+static void TestBake()
+{
+	// 1 s, 0.5 s starting late, and an empty clip which still gets one frame
+	std::vector<XMFLOAT2> clipTimes;
+	clipTimes.push_back(XMFLOAT2(0.0f, 1.0f));
+	clipTimes.push_back(XMFLOAT2(0.25f, 0.75f));
+	clipTimes.push_back(XMFLOAT2(0.0f, 0.0f));
+	const UINT boneCount = 7;
+	TestSource source(boneCount, clipTimes);
+
+	AnimationPaletteAtlas atlas;
+	Check(atlas.Bake(source, 30.0f), "bake succeeds");
+	Check(atlas.GetBoneCount() == boneCount && atlas.GetClipCount() == 3, "bone and clip counts");
+	Check(atlas.GetClip(0).FirstFrame == 0 && atlas.GetClip(0).FrameCount == 30, "first clip rows");
+	Check(atlas.GetClip(1).FirstFrame == 30 && atlas.GetClip(1).FrameCount == 15, "second clip stacked after the first");
+	Check(atlas.GetClip(2).FirstFrame == 45 && atlas.GetClip(2).FrameCount == 1, "empty clip gets one frame");
+	Check(atlas.GetWidth() == boneCount * AnimationPaletteAtlas::TexelsPerBone && atlas.GetHeight() == 46, "atlas size");
+	Check(atlas.GetMemorySize() == atlas.GetWidth() * atlas.GetHeight() * sizeof(XMFLOAT4), "memory size");
+	Check(source.Calls == 46, "source sampled once per frame");
+
+	// Rows match the source at the frame times, bit for bit
+	bool rowsMatch = true;
+	std::vector<XMFLOAT4X4> palette(boneCount);
+	for (UINT c = 0; c < atlas.GetClipCount(); ++c)
+	{
+		const BakedClipInfo& clip = atlas.GetClip(c);
+		for (UINT f = 0; f < clip.FrameCount; ++f)
+		{
+			atlas.GetFinalTransforms(clip.FirstFrame + f, &palette[0]);
+			for (UINT b = 0; b < boneCount; ++b)
+			{
+				XMFLOAT4X4 expected = TestSource::Expected(c, clipTimes[c].x + f / 30.0f, b);
+				rowsMatch = rowsMatch && memcmp(&palette[b], &expected, sizeof(XMFLOAT4X4)) == 0;
+			}
+		}
+	}
+	Check(rowsMatch, "atlas rows equal the source transforms");
+
+	// Bad input leaves the atlas empty
+	Check(!atlas.Bake(source, 0.0f) && atlas.GetHeight() == 0 && atlas.GetTexels() == nullptr, "zero frame rate rejected");
+	std::vector<XMFLOAT2> longClip(1, XMFLOAT2(0.0f, 1000.0f));
+	TestSource longSource(boneCount, longClip);
+	Check(!atlas.Bake(longSource, 30.0f) && atlas.GetClipCount() == 0 && longSource.Calls == 0, "too many frames rejected before sampling");
+	TestSource wideSource(AnimationPaletteAtlas::MaxDimension / AnimationPaletteAtlas::TexelsPerBone + 1, clipTimes);
+	Check(!atlas.Bake(wideSource, 30.0f) && wideSource.Calls == 0, "too many bones rejected");
+	TestSource noBones(0, clipTimes);
+	Check(!atlas.Bake(noBones, 30.0f), "no bones rejected");
+}
+
+static void TestFrames()
+{
+	std::vector<XMFLOAT2> clipTimes;
+	clipTimes.push_back(XMFLOAT2(0.0f, 1.0f));
+	clipTimes.push_back(XMFLOAT2(0.0f, 0.5f));
+	TestSource source(2, clipTimes);
+	AnimationPaletteAtlas atlas;
+	atlas.Bake(source, 30.0f);
+
+	BakedAnimationInstance instance = atlas.MakeInstance(1, 0.1f);
+	Check(instance.FirstFrame == 30 && instance.FrameCount == 15, "instance rows of its clip");
+	Check(atlas.GetFrame(instance, 0.0f) == 33, "start time offsets the frame");
+	Check(atlas.GetFrame(instance, 0.2f) == 39, "frame advances with time");
+	Check(atlas.GetFrame(instance, 0.4f) == 30, "frame wraps at the end of the clip");
+	Check(atlas.GetFrame(instance, 0.5f) == 33, "one clip length later shows the same frame");
+	Check(atlas.GetFrame(instance, 100.0f) == 30 + (UINT)(3.0f + 100.0f * 30.0f) % 15, "frame wraps after many loops");
+
+	bool inClip = true;
+	for (int i = 0; i < 1000; ++i)
+	{
+		UINT frame = atlas.GetFrame(instance, i * 0.0137f);
+		inClip = inClip && frame >= 30 && frame < 45;
+	}
+	Check(inClip, "frames stay inside the clip");
+
+	BakedAnimationInstance fast = atlas.MakeInstance(0, 0.0f, 2.0f);
+	Check(fast.FrameSpeed == 60.0f && atlas.GetFrame(fast, 0.25f) == 15, "speed scales the frame rate");
+	Check(atlas.GetFrame(fast, -1.0f) == 0, "negative times clamp to the first frame");
+}
+
+static void TestSerialization()
+{
+	std::vector<XMFLOAT2> clipTimes;
+	clipTimes.push_back(XMFLOAT2(0.0f, 0.4f));
+	clipTimes.push_back(XMFLOAT2(1.0f, 1.3f));
+	TestSource source(5, clipTimes);
+	AnimationPaletteAtlas atlas;
+	atlas.Bake(source, 24.0f);
+
+	std::stringstream stream;
+	atlas.Write(stream);
+	std::string data = stream.str();
+
+	AnimationPaletteAtlas read;
+	std::istringstream in(data);
+	Check(read.Read(in), "read succeeds");
+	bool same = read.GetBoneCount() == atlas.GetBoneCount() && read.GetHeight() == atlas.GetHeight()
+		&& read.GetFrameRate() == atlas.GetFrameRate() && read.GetClipCount() == atlas.GetClipCount();
+	for (UINT c = 0; same && c < atlas.GetClipCount(); ++c)
+		same = read.GetClip(c).FirstFrame == atlas.GetClip(c).FirstFrame && read.GetClip(c).FrameCount == atlas.GetClip(c).FrameCount;
+	same = same && memcmp(read.GetTexels(), atlas.GetTexels(), atlas.GetMemorySize()) == 0;
+	Check(same, "write and read round trip");
+
+	// Every truncation fails and leaves the atlas empty
+	bool truncated = true;
+	for (size_t size = 0; size < data.size(); size += 7)
+	{
+		std::istringstream cut(data.substr(0, size));
+		truncated = truncated && !read.Read(cut) && read.GetHeight() == 0 && read.GetClipCount() == 0;
+	}
+	Check(truncated, "truncated streams rejected");
+
+	// Header fields: bone count, frame count, frame rate, clip count, then the clips
+	auto corrupt = [&](size_t offset, UINT value)
+	{
+		std::string bad = data;
+		memcpy(&bad[offset], &value, sizeof(UINT));
+		std::istringstream badIn(bad);
+		return !read.Read(badIn);
+	};
+	Check(corrupt(0, 0), "no bones rejected");
+	Check(corrupt(0, 0x80000000u), "huge bone count rejected");
+	Check(corrupt(4, AnimationPaletteAtlas::MaxDimension + 1), "huge frame count rejected");
+	Check(corrupt(8, 0), "zero frame rate rejected");
+	Check(corrupt(12, 1000), "more clips than frames rejected");
+	Check(corrupt(16 + 8, 0x7fffffffu), "clip past the last row rejected");
+	Check(corrupt(16 + 12, 0), "clip without frames rejected");
+}
+
+// Bones chained along x, each swinging about its own axis at its own rate. The bind pose
+// puts bone b at x = b, the offsets undo it.
+static void BuildSkeleton(SkinnedData& skinInfo, UINT boneCount)
+{
+	std::vector<XMFLOAT4X4> boneOffsets(boneCount);
+	std::map<std::wstring, AnimationClip> animations;
+	const wchar_t* names[] = { L"Walk", L"Wave" };
+	const float durations[] = { 1.0f, 0.7f };
+	for (UINT c = 0; c < 2; ++c)
+	{
+		AnimationClip& clip = animations[names[c]];
+		clip.BoneAnimations.resize(boneCount);
+		for (UINT b = 0; b < boneCount; ++b)
+		{
+			for (UINT k = 0; k <= 4; ++k)
+			{
+				Keyframe key;
+				key.TimePos = durations[c] * k / 4;
+				key.Translation = XMFLOAT3(b == 0 ? 0.1f * k : 1.0f, 0.0f, 0.0f);
+				key.Scale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+				XMVECTOR axis = XMVectorSet(sinf(b + 1.0f), cosf(3.0f * b + c), 0.5f, 0.0f);
+				XMStoreFloat4(&key.RotationQuat, XMQuaternionRotationAxis(axis, 0.3f * (k + b) * (c + 1)));
+				clip.BoneAnimations[b].Keyframes.push_back(key);
+			}
+		}
+	}
+	for (UINT b = 0; b < boneCount; ++b)
+		XMStoreFloat4x4(&boneOffsets[b], XMMatrixTranslation(-(float)b, 0.0f, 0.0f));
+	skinInfo.Initialize(boneOffsets, animations);
+}
+
+static void TestSkinnedData()
+{
+	const UINT boneCount = 10;
+	SkinnedData skinInfo;
+	BuildSkeleton(skinInfo, boneCount);
+	SkinnedPaletteSource source(skinInfo);
+	AnimationPaletteAtlas atlas;
+	Check(atlas.Bake(source), "skinned data bake succeeds");
+	Check(atlas.GetBoneCount() == boneCount && atlas.GetClipCount() == skinInfo.GetClipCount(), "skinned data counts");
+
+	bool rowsMatch = true;
+	bool lastRowConstant = true;
+	std::vector<XMFLOAT4X4> baked(boneCount);
+	std::vector<XMFLOAT4X4> expected(boneCount);
+	std::vector<BonePosePacket> pose(skinInfo.GetPoseScratchSize());
+	for (UINT c = 0; c < atlas.GetClipCount(); ++c)
+	{
+		const BakedClipInfo& clip = atlas.GetClip(c);
+		for (UINT f = 0; f < clip.FrameCount; ++f)
+		{
+			atlas.GetFinalTransforms(clip.FirstFrame + f, &baked[0]);
+			skinInfo.GetFinalTransforms(c, skinInfo.GetClipStartTime(c) + f / atlas.GetFrameRate(), &expected[0], &pose[0]);
+			for (UINT b = 0; b < boneCount; ++b)
+			{
+				rowsMatch = rowsMatch && memcmp(baked[b].m, expected[b].m, 3 * sizeof(baked[b].m[0])) == 0;
+				lastRowConstant = lastRowConstant && expected[b]._41 == 0.0f && expected[b]._42 == 0.0f
+					&& expected[b]._43 == 0.0f && expected[b]._44 == 1.0f;
+			}
+		}
+	}
+	Check(rowsMatch, "atlas rows equal SkinnedData::GetFinalTransforms");
+	Check(lastRowConstant, "dropped row of the palette is 0,0,0,1");
+}
+
+int main()
+{
+	TestBake();
+	TestFrames();
+	TestSerialization();
+	TestSkinnedData();
+
+	if (g_failures)
+		return 1;
+	printf("All checks passed\n");
+	return 0;
+}
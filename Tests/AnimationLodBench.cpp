@@ -0,0 +1,314 @@
+// Bone evaluations saved by AnimationLod on a skinned crowd spread in front of and behind the
+// viewer, and the time of the pose evaluation of MeshObject::Update with the LOD on and off.
+// Each frame the evaluated and skipped bones must add up to the playing ones, the frozen
+// instances must be the ones outside the frustum and no visible instance may wait more than
+// MaxInterval frames for an update.
+
+#include "pch.h"
+#include "Components/AnimationLod.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace DirectX;
+using namespace DXFramework;
+
+static int g_failures = 0;
+
+static void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		++g_failures;
+	}
+}
+
+static const UINT BoneCount = 64;
+// Fingers and face: the last 16 bones, folded into bone 47 at low detail
+static const UINT DetailBoneCount = 16;
+static const UINT ClipCount = 4;
+static const float FrameTime = 1.0f / 60.0f;
+
+// A humanoid sized skeleton: bones chained along y, keys at 30 per second.
+static void BuildSkeleton(SkinnedData& skinInfo)
+{
+	std::vector<XMFLOAT4X4> boneOffsets(BoneCount);
+	std::map<std::wstring, AnimationClip> animations;
+	for (UINT c = 0; c < ClipCount; ++c)
+	{
+		AnimationClip& clip = animations[L"Clip" + std::to_wstring(c)];
+		clip.BoneAnimations.resize(BoneCount);
+		float duration = 1.0f + 0.5f * c;
+		UINT keyCount = (UINT)(duration * 30.0f) + 1;
+		for (UINT b = 0; b < BoneCount; ++b)
+		{
+			for (UINT k = 0; k < keyCount; ++k)
+			{
+				float t = duration * k / (keyCount - 1);
+				Keyframe key;
+				key.TimePos = t;
+				key.Translation = XMFLOAT3(0.0f, b == 0 ? 0.0f : 0.2f, 0.0f);
+				XMVECTOR axis = XMVectorSet(sinf(b * 1.3f), 1.0f, cosf(b * 0.7f + c), 0.0f);
+				XMStoreFloat4(&key.RotationQuat, XMQuaternionRotationAxis(axis, 0.4f * sinf(6.2832f * t / duration + b)));
+				clip.BoneAnimations[b].Keyframes.push_back(key);
+			}
+		}
+	}
+	for (UINT b = 0; b < BoneCount; ++b)
+		XMStoreFloat4x4(&boneOffsets[b], XMMatrixTranslation(0.0f, -0.2f * b, 0.0f));
+	skinInfo.Initialize(boneOffsets, animations);
+}
+
+// Inward planes of a 90 degree frustum at the origin looking down +z, as ExtractFrustumPlanes
+// gives them: left, right, bottom, top, near, far.
+static void BuildPlanes(XMFLOAT4 planes[6])
+{
+	const float s = 0.70710678f;
+	planes[0] = XMFLOAT4(s, 0.0f, s, 0.0f);
+	planes[1] = XMFLOAT4(-s, 0.0f, s, 0.0f);
+	planes[2] = XMFLOAT4(0.0f, s, s, 0.0f);
+	planes[3] = XMFLOAT4(0.0f, -s, s, 0.0f);
+	planes[4] = XMFLOAT4(0.0f, 0.0f, 1.0f, -1.0f);
+	planes[5] = XMFLOAT4(0.0f, 0.0f, -1.0f, 500.0f);
+}
+
+static bool Outside(const BoundingSphere& sphere, const XMFLOAT4 planes[6])
+{
+	for (UINT p = 0; p < 6; ++p)
+	{
+		const XMFLOAT4& n = planes[p];
+		if (n.x * sphere.Center.x + n.y * sphere.Center.y + n.z * sphere.Center.z + n.w < -sphere.Radius)
+			return true;
+	}
+	return false;
+}
+
+struct Crowd
+{
+	std::vector<BoundingSphere> Spheres;
+	std::vector<UINT> Clips;
+	std::vector<float> Times;
+};
+
+// A grid on the ground around the viewer, a quarter of it behind.
+static void BuildCrowd(Crowd& crowd, UINT side)
+{
+	for (UINT z = 0; z < side; ++z)
+	{
+		for (UINT x = 0; x < side; ++x)
+		{
+			UINT i = (UINT)crowd.Spheres.size();
+			float px = (x - side * 0.5f) * 3.0f;
+			float pz = z * 200.0f / side * 3.0f - 150.0f;
+			crowd.Spheres.push_back(BoundingSphere(XMFLOAT3(px, 0.0f, pz), 1.0f));
+			crowd.Clips.push_back(i % ClipCount);
+			crowd.Times.push_back(i * 0.0137f);
+		}
+	}
+}
+
+struct RunResult
+{
+	double Ms;
+	double EvaluatedBones;
+	double SkippedBones;
+	double Frozen;
+	double Deferred;
+	double Reduced;
+};
+
+static RunResult Run(AnimationLod& lod, const SkinnedData& skinInfo, Crowd& crowd, const XMFLOAT4 planes[6], int frames)
+{
+	UINT instanceCount = (UINT)crowd.Spheres.size();
+	UINT maxInterval = lod.GetSettings().MaxInterval;
+	std::vector<UINT> active;
+	std::vector<UINT> extrapolated;
+	std::vector<BonePosePacket> pose(skinInfo.GetPoseScratchSize());
+	std::vector<XMFLOAT4X4> palettes(instanceCount * BoneCount);
+	auto getSphere = [&](UINT i) { return crowd.Spheres[i]; };
+
+	RunResult result = {};
+	bool bonesAddUp = true;
+	bool frozenOutside = true;
+	bool updatedInTime = true;
+	bool extrapolatedDeferred = true;
+	bool foldedToProxy = true;
+	double seconds = 0.0;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		active.resize(instanceCount);
+		for (UINT i = 0; i < instanceCount; ++i)
+			active[i] = i;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		if (lod.IsEnabled())
+			lod.Select(active, BoneCount, getSphere, extrapolated);
+		for (UINT i : active)
+		{
+			AnimationInstanceLod& instance = lod.GetInstance(i);
+			skinInfo.GetPose(crowd.Clips[i], crowd.Times[i], &pose[0]);
+			skinInfo.GetFinalTransforms(&pose[0], &palettes[i * BoneCount], instance.Reduced ? &lod.GetBoneLod() : nullptr);
+		}
+		seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		std::vector<bool> kept(instanceCount, false);
+		for (UINT i : active)
+			kept[i] = true;
+		if (lod.IsEnabled())
+		{
+			const AnimationLodStats& stats = lod.GetStats();
+			bonesAddUp = bonesAddUp && stats.EvaluatedBones + stats.SkippedBones == instanceCount * BoneCount;
+			result.EvaluatedBones += stats.EvaluatedBones;
+			result.SkippedBones += stats.SkippedBones;
+			result.Frozen += stats.FrozenInstances;
+			result.Deferred += stats.DeferredInstances;
+			result.Reduced += stats.ReducedInstances;
+
+			UINT outside = 0;
+			for (UINT i = 0; i < instanceCount; ++i)
+			{
+				bool isOutside = Outside(crowd.Spheres[i], planes);
+				outside += isOutside;
+				if (isOutside)
+					frozenOutside = frozenOutside && !kept[i];
+				else
+					updatedInTime = updatedInTime && lod.GetInstance(i).FramesSinceUpdate <= maxInterval;
+			}
+			frozenOutside = frozenOutside && stats.FrozenInstances == outside;
+			for (UINT i : extrapolated)
+				extrapolatedDeferred = extrapolatedDeferred && !kept[i] && !Outside(crowd.Spheres[i], planes);
+		}
+		else
+		{
+			result.EvaluatedBones += instanceCount * BoneCount;
+		}
+
+		// What MeshObject does after the evaluation
+		for (UINT i : active)
+		{
+			AnimationInstanceLod& instance = lod.GetInstance(i);
+			if (instance.Reduced)
+			{
+				const BoneLodMap& boneLod = lod.GetBoneLod();
+				const XMFLOAT4X4* palette = &palettes[i * BoneCount];
+				for (UINT b : boneLod.GetFoldedBones())
+					foldedToProxy = foldedToProxy && memcmp(&palette[b], &palette[boneLod.GetProxy(b)], sizeof(XMFLOAT4X4)) == 0;
+			}
+			instance.FramesSinceUpdate = 0;
+			instance.Extrapolated = 0;
+			instance.HasVelocity = true;
+		}
+		for (UINT i : extrapolated)
+			++lod.GetInstance(i).Extrapolated;
+		for (UINT i = 0; i < instanceCount; ++i)
+		{
+			float duration = skinInfo.GetClipEndTime(crowd.Clips[i]) - skinInfo.GetClipStartTime(crowd.Clips[i]);
+			crowd.Times[i] = fmodf(crowd.Times[i] + FrameTime, duration);
+		}
+	}
+	if (lod.IsEnabled())
+	{
+		Check(bonesAddUp, "evaluated and skipped bones add up to the playing bones");
+		Check(frozenOutside, "frozen instances are the ones outside the frustum");
+		Check(updatedInTime, "visible instances update at least every MaxInterval frames");
+		Check(extrapolatedDeferred, "extrapolated instances are visible deferred ones");
+		Check(foldedToProxy, "folded bones take the transform of their proxy");
+	}
+
+	result.Ms = seconds * 1e3 / frames;
+	result.EvaluatedBones /= frames;
+	result.SkippedBones /= frames;
+	result.Frozen /= frames;
+	result.Deferred /= frames;
+	result.Reduced /= frames;
+	return result;
+}
+
+// Without a viewer, or with the LOD off in the settings, every playing instance is kept at
+// full detail.
+static void TestNoView(const Crowd& crowd)
+{
+	AnimationLodSettings settings;
+	settings.Enabled = true;
+	AnimationLod lod;
+	lod.Initialize((UINT)crowd.Spheres.size());
+	lod.SetSettings(settings);
+	std::vector<int> proxies(BoneCount, -1);
+	proxies[BoneCount - 1] = 0;
+	lod.SetDetailBones(proxies);
+
+	std::vector<UINT> active;
+	for (UINT i = 0; i < crowd.Spheres.size(); i += 3)
+		active.push_back(i);
+	std::vector<UINT> expected = active;
+	std::vector<UINT> extrapolated;
+	bool called = false;
+	lod.Select(active, BoneCount, [&](UINT i) { called = true; return crowd.Spheres[i]; }, extrapolated);
+	Check(active == expected, "no viewer: all playing instances kept");
+	Check(!called, "no viewer: bounds not asked for");
+	Check(extrapolated.empty(), "no viewer: nothing extrapolated");
+	Check(lod.GetStats().EvaluatedBones == expected.size() * BoneCount && lod.GetStats().SkippedBones == 0, "no viewer: every bone evaluated");
+	bool full = true;
+	for (UINT i : active)
+		full = full && !lod.GetInstance(i).Reduced;
+	Check(full, "no viewer: full detail");
+
+	settings.Enabled = false;
+	lod.SetSettings(settings);
+	Check(!lod.IsEnabled() && !lod.TracksVelocity(), "disabled: no selection and no velocity");
+	settings.Enabled = true;
+	settings.MaxInterval = 0;
+	lod.SetSettings(settings);
+	Check(lod.GetSettings().MaxInterval == 1, "MaxInterval clamped to 1");
+}
+
+int main()
+{
+	const int frames = 60;
+	SkinnedData skinInfo;
+	BuildSkeleton(skinInfo);
+	Crowd crowd;
+	BuildCrowd(crowd, 64);
+	UINT instanceCount = (UINT)crowd.Spheres.size();
+	XMFLOAT4 planes[6];
+	BuildPlanes(planes);
+
+	TestNoView(crowd);
+
+	std::vector<int> proxies(BoneCount, -1);
+	for (UINT b = BoneCount - DetailBoneCount; b < BoneCount; ++b)
+		proxies[b] = b - 1;
+
+	AnimationLod off;
+	off.Initialize(instanceCount);
+	Crowd offCrowd = crowd;
+	RunResult full = Run(off, skinInfo, offCrowd, planes, frames);
+
+	AnimationLodSettings settings;
+	settings.Enabled = true;
+	AnimationLod on;
+	on.Initialize(instanceCount);
+	on.SetSettings(settings);
+	on.SetDetailBones(proxies);
+	on.SetView(XMFLOAT3(0.0f, 0.0f, 0.0f), planes);
+	Crowd onCrowd = crowd;
+	RunResult lod = Run(on, skinInfo, onCrowd, planes, frames);
+
+	double playing = (double)instanceCount * BoneCount;
+	printf("%u instances of %u bones, %u detail bones, %d frames\n", instanceCount, BoneCount, DetailBoneCount, frames);
+	printf("%-6s %10s %12s %12s %8s %8s %8s %8s\n", "lod", "ms/frame", "evaluated", "skipped", "saved", "frozen", "deferred", "reduced");
+	printf("%-6s %10.3f %12.0f %12.0f %7.1f%% %8s %8s %8s\n", "off", full.Ms, full.EvaluatedBones, 0.0, 0.0, "-", "-", "-");
+	printf("%-6s %10.3f %12.0f %12.0f %7.1f%% %8.0f %8.0f %8.0f\n", "on", lod.Ms, lod.EvaluatedBones, lod.SkippedBones,
+		100.0 * lod.SkippedBones / playing, lod.Frozen, lod.Deferred, lod.Reduced);
+	printf("speedup %.2f\n", full.Ms / lod.Ms);
+
+	Check(lod.Frozen > 0 && lod.Deferred > 0 && lod.Reduced > 0, "the crowd exercises every LOD case");
+	Check(lod.EvaluatedBones < full.EvaluatedBones, "fewer bones evaluated with the LOD");
+
+	if (g_failures)
+		return 1;
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,158 @@
+// Time of the per instance pose evaluation of a skinned crowd spread by ParallelForChunks,
+// the loop of MeshObject::UpdateParallel, from 1 worker up to the hardware threads or the
+// count given on the command line. Every run must give the palettes of the serial evaluation,
+// and the loop must visit each index once whatever the count, chunk size and worker count.
+
+#include "pch.h"
+#include "Common/ParallelChunks.h"
+#include "Components/SkinnedData.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+using namespace DirectX;
+using namespace DXFramework;
+using namespace DX;
+
+static int g_failures = 0;
+
+static void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		++g_failures;
+	}
+}
+
+// Same as MeshObject
+static const UINT ChunkSize = 8;
+
+static void TestVisits()
+{
+	const UINT counts[] = { 0, 1, 7, 8, 9, 100, 1000 };
+	const UINT chunks[] = { 1, 3, 8, 64 };
+	bool once = true;
+	bool workersInRange = true;
+	for (UINT count : counts)
+	{
+		for (UINT chunk : chunks)
+		{
+			for (UINT workers = 1; workers <= 6; ++workers)
+			{
+				std::vector<std::atomic<UINT>> visits(count);
+				for (auto& v : visits)
+					v = 0;
+				std::atomic<UINT> badWorker(0);
+				ParallelForChunks(count, workers, chunk, [&](UINT worker, UINT k)
+				{
+					if (worker >= workers)
+						++badWorker;
+					++visits[k];
+				});
+				for (auto& v : visits)
+					once = once && v == 1;
+				workersInRange = workersInRange && badWorker == 0;
+			}
+		}
+	}
+	Check(once, "every index visited once");
+	Check(workersInRange, "worker numbers below the worker count");
+}
+
+// A humanoid sized skeleton: bones chained along y, keys at 30 per second.
+static void BuildSkeleton(SkinnedData& skinInfo, UINT boneCount, UINT clipCount)
+{
+	std::vector<XMFLOAT4X4> boneOffsets(boneCount);
+	std::map<std::wstring, AnimationClip> animations;
+	for (UINT c = 0; c < clipCount; ++c)
+	{
+		AnimationClip& clip = animations[L"Clip" + std::to_wstring(c)];
+		clip.BoneAnimations.resize(boneCount);
+		float duration = 1.0f + 0.5f * c;
+		UINT keyCount = (UINT)(duration * 30.0f) + 1;
+		for (UINT b = 0; b < boneCount; ++b)
+		{
+			for (UINT k = 0; k < keyCount; ++k)
+			{
+				float t = duration * k / (keyCount - 1);
+				Keyframe key;
+				key.TimePos = t;
+				key.Translation = XMFLOAT3(0.0f, b == 0 ? 0.0f : 0.2f, b == 0 ? 0.5f * t : 0.0f);
+				XMVECTOR axis = XMVectorSet(sinf(b * 1.3f), 1.0f, cosf(b * 0.7f + c), 0.0f);
+				XMStoreFloat4(&key.RotationQuat, XMQuaternionRotationAxis(axis, 0.4f * sinf(6.2832f * t / duration + b)));
+				clip.BoneAnimations[b].Keyframes.push_back(key);
+			}
+		}
+	}
+	for (UINT b = 0; b < boneCount; ++b)
+		XMStoreFloat4x4(&boneOffsets[b], XMMatrixTranslation(0.0f, -0.2f * b, 0.0f));
+	skinInfo.Initialize(boneOffsets, animations);
+}
+
+int main(int argc, char* argv[])
+{
+	TestVisits();
+
+	const UINT boneCount = 64;
+	const UINT clipCount = 4;
+	const UINT instanceCount = 4096;
+	SkinnedData skinInfo;
+	BuildSkeleton(skinInfo, boneCount, clipCount);
+
+	std::vector<UINT> clips(instanceCount);
+	std::vector<float> times(instanceCount);
+	for (UINT i = 0; i < instanceCount; ++i)
+	{
+		clips[i] = i % clipCount;
+		float duration = skinInfo.GetClipEndTime(clips[i]) - skinInfo.GetClipStartTime(clips[i]);
+		times[i] = fmodf(i * 0.0137f, duration);
+	}
+
+	// Serial reference
+	std::vector<XMFLOAT4X4> reference(instanceCount * boneCount);
+	std::vector<BonePosePacket> pose(skinInfo.GetPoseScratchSize());
+	for (UINT i = 0; i < instanceCount; ++i)
+		skinInfo.GetFinalTransforms(clips[i], times[i], &reference[i * boneCount], &pose[0]);
+
+	// Up to the hardware threads, or the count given on the command line
+	UINT maxWorkers = argc > 1 ? (UINT)atoi(argv[1]) : std::thread::hardware_concurrency();
+	maxWorkers = std::max(maxWorkers, 1u);
+	std::vector<std::vector<BonePosePacket>> workerPose(maxWorkers, std::vector<BonePosePacket>(skinInfo.GetPoseScratchSize()));
+	std::vector<XMFLOAT4X4> palettes(instanceCount * boneCount);
+	const int frames = 20;
+
+	printf("%u instances of %u bones\n", instanceCount, boneCount);
+	printf("%-8s %10s %10s %12s\n", "workers", "ms/frame", "speedup", "inst/ms");
+	double serialMs = 0.0;
+	bool same = true;
+	for (UINT workers = 1; workers <= maxWorkers; ++workers)
+	{
+		memset((void*)&palettes[0], 0, palettes.size() * sizeof(XMFLOAT4X4));
+		double seconds = 0.0;
+		for (int frame = 0; frame < frames; ++frame)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			ParallelForChunks(instanceCount, workers, ChunkSize, [&](UINT worker, UINT i)
+			{
+				skinInfo.GetFinalTransforms(clips[i], times[i], &palettes[i * boneCount], &workerPose[worker][0]);
+			});
+			seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+		double ms = seconds * 1e3 / frames;
+		if (workers == 1)
+			serialMs = ms;
+		printf("%-8u %10.3f %10.2f %12.1f\n", workers, ms, serialMs / ms, instanceCount / ms);
+		same = same && memcmp(&palettes[0], &reference[0], palettes.size() * sizeof(XMFLOAT4X4)) == 0;
+	}
+	Check(same, "palettes equal to the serial evaluation");
+
+	if (g_failures)
+		return 1;
+	printf("All checks passed\n");
+	return 0;
+}
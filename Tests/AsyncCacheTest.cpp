@@ -0,0 +1,149 @@
+// Checks of AsyncCache with loads that count their file reads. Many tasks ask for the same
+// names at once and every name must be read once, spelled in any case or separator. Loads
+// held in flight across Clear must complete their waiters without storing a stale entry,
+// also when a newer load of the name started meanwhile, and failed loads are retried.
+
+#include "pch.h"
+#include "Common/AsyncCache.h"
+#include <ppl.h>
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+using namespace concurrency;
+using namespace DX;
+
+static int g_failures = 0;
+
+static void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		++g_failures;
+	}
+}
+
+static void TestEachFileReadOnce()
+{
+	const int Files = 64;
+	const int Requests = 16;
+	AsyncCache<int> cache;
+	std::vector<std::atomic<int>> reads(Files);
+	for (auto& r : reads)
+		r = 0;
+
+	std::vector<task<int>> results(Files * Requests);
+	parallel_for(0, Files * Requests, [&](int i)
+	{
+		int file = i % Files;
+		// Every other request spells the name differently
+		std::wstring name = (i / Files) % 2 ? L"Media/Textures/File" : L"media\\textures\\FILE";
+		name += std::to_wstring(file) + L".dds";
+		results[i] = cache.GetOrLoadAsync(name, [&reads, file]()
+		{
+			return create_task([&reads, file]()
+			{
+				++reads[file];
+				return file;
+			});
+		});
+	});
+
+	bool values = true;
+	for (int i = 0; i < Files * Requests; ++i)
+		values = values && results[i].get() == i % Files;
+	bool once = true;
+	for (auto& r : reads)
+		once = once && r == 1;
+	AsyncCacheStats stats = cache.GetStats();
+	Check(values, "every request gets the value of its name");
+	Check(once, "each file is read once");
+	Check(stats.Loads == Files && stats.Hits + stats.Joins == Files * (Requests - 1), "the other requests hit or join");
+
+	// Finished loads are served without reading
+	int value = 0;
+	Check(cache.TryGet(L"MEDIA/textures/file3.dds", value) && value == 3, "finished loads are found");
+	cache.GetOrLoadAsync(L"media\\textures\\file3.dds", [&reads]() { ++reads[3]; return task_from_result(-1); }).get();
+	Check(reads[3] == 1, "a finished load is not read again");
+}
+
+// A load that waits for gate, then returns value and counts its read
+static std::function<task<int>()> GatedLoad(task_completion_event<void> gate, int value, std::atomic<int>& reads)
+{
+	return [gate, value, &reads]()
+	{
+		return create_task(gate).then([value, &reads]()
+		{
+			++reads;
+			return value;
+		});
+	};
+}
+
+static void TestClearInFlight()
+{
+	AsyncCache<int> cache;
+	std::atomic<int> reads(0);
+
+	// Cleared while loading, the waiters still get the result but it is not stored
+	task_completion_event<void> gate;
+	task<int> stale = cache.GetOrLoadAsync(L"a.dds", GatedLoad(gate, 1, reads));
+	task<int> joined = cache.GetOrLoadAsync(L"a.dds", GatedLoad(gate, -1, reads));
+	cache.Clear();
+	gate.set();
+	Check(stale.get() == 1 && joined.get() == 1, "loads in flight complete their waiters after Clear");
+	int value = 0;
+	Check(!cache.TryGet(L"a.dds", value), "a load in flight across Clear is not stored");
+	Check(cache.GetOrLoadAsync(L"a.dds", [] { return task_from_result(2); }).get() == 2, "the next request loads again");
+	Check(reads == 1, "the joined request did not read");
+
+	// A newer load started after Clear is not overwritten by the older one
+	task_completion_event<void> oldGate, newGate;
+	cache.Clear();
+	task<int> older = cache.GetOrLoadAsync(L"b.dds", GatedLoad(oldGate, 10, reads));
+	cache.Clear();
+	task<int> newer = cache.GetOrLoadAsync(L"b.dds", GatedLoad(newGate, 20, reads));
+	oldGate.set();
+	Check(older.get() == 10, "the older load completes its waiters");
+	Check(!cache.TryGet(L"b.dds", value), "the older load does not finish the newer entry");
+	newGate.set();
+	Check(newer.get() == 20, "the newer load completes its waiters");
+	Check(cache.TryGet(L"b.dds", value) && value == 20, "the newer load is stored");
+	Check(cache.GetStats().Loads == 4, "one load per generation");
+
+	// The synchronous getter does not store across Clear either
+	cache.Clear();
+	cache.GetOrLoad(L"c.dds", [&cache]() { cache.Clear(); return 30; });
+	Check(!cache.TryGet(L"c.dds", value), "a synchronous load across Clear is not stored");
+}
+
+static void TestFailureRetried()
+{
+	AsyncCache<int> cache;
+	task<int> failed = cache.GetOrLoadAsync(L"missing.dds", []() -> task<int> { throw std::exception(); });
+	bool threw = false;
+	try
+	{
+		failed.get();
+	}
+	catch (const std::exception&)
+	{
+		threw = true;
+	}
+	Check(threw, "the failure reaches the waiter");
+	Check(cache.GetStats().Failures == 1, "failure counted");
+	Check(cache.GetOrLoadAsync(L"missing.dds", [] { return task_from_result(5); }).get() == 5, "a failed load is retried");
+}
+
+int main()
+{
+	TestEachFileReadOnce();
+	TestClearInFlight();
+	TestFailureRetried();
+
+	if (g_failures)
+		return 1;
+	printf("All checks passed\n");
+	return 0;
+}
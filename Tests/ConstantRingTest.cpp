@@ -0,0 +1,162 @@
+// Checks of ConstantRing on the null backend. They cover the alignment of uploads, arrays
+// under one map and their elements, the restart of a full ring and the epochs, the reuse of
+// clean and unchanged slots, data larger than the ring and the binds through StateTracker.
+
+#include "pch.h"
+#include "Common/ConstantRing.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+using namespace DX;
+
+static int g_failures = 0;
+
+static void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		++g_failures;
+	}
+}
+
+// Bind points are only compared by address, so any distinct non null address will do
+template<typename T>
+static T* Fake(uint32_t kind, uint32_t index)
+{
+	return reinterpret_cast<T*>((uintptr_t)(kind << 20 | (index + 1) << 4));
+}
+
+// Same size as the per-object data of the engine, not a multiple of the alignment
+struct ObjectData
+{
+	float Values[72];
+};
+
+static void TestUploads()
+{
+	ConstantRing ring;
+	Check(ring.Initialize(nullptr, 1000), "null backend initializes");
+	Check(ring.GetCapacity() == 1024, "capacity rounded up to the alignment");
+	ring.BeginFrame();
+
+	float data[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+	RingAllocation a = ring.Upload(nullptr, data, sizeof(data));
+	RingAllocation b = ring.Upload(nullptr, data, sizeof(data));
+	Check(a.Offset == 0 && a.Size == 256, "first upload at 0, one aligned block");
+	Check(b.Offset == 256, "next upload on the next block");
+	Check(memcmp(ring.GetMemory(b), data, sizeof(data)) == 0, "data copied");
+	Check(ring.GetStats().Maps == 2 && ring.GetStats().Uploads == 2, "one map per upload");
+	Check(ring.GetStats().BytesWritten == 2 * sizeof(data), "bytes of the data, not of the blocks");
+
+	// Larger than the whole ring
+	std::vector<uint8_t> large(2048);
+	Check(ring.Upload(nullptr, &large[0], (uint32_t)large.size()).Size == 0, "too large data gives an empty allocation");
+	Check(ring.GetStats().Maps == 2, "too large data maps nothing");
+}
+
+static void TestArrays()
+{
+	const uint32_t Objects = 1000;
+	ConstantRing ring;
+	ring.Initialize(nullptr, 1024 * 1024);
+	ring.BeginFrame();
+
+	std::vector<ObjectData> objects(Objects);
+	for (uint32_t i = 0; i < Objects; ++i)
+		objects[i].Values[0] = (float)i;
+	RingAllocation array = ring.UploadArray(nullptr, &objects[0], sizeof(ObjectData), Objects);
+	Check(ring.GetStats().Maps == 1, "an array maps once");
+	Check(ring.GetStats().Uploads == Objects, "every element counts as an upload");
+	Check(array.Size == Objects * 512, "elements padded to whole blocks");
+
+	bool elementsMatch = true;
+	for (uint32_t i = 0; i < Objects; ++i)
+	{
+		RingAllocation element = ConstantRing::GetElement(array, sizeof(ObjectData), i);
+		elementsMatch = elementsMatch && element.Offset == array.Offset + i * 512 && element.Size == 512 && ring.IsValid(element);
+		elementsMatch = elementsMatch && memcmp(ring.GetMemory(element), &objects[i], sizeof(ObjectData)) == 0;
+	}
+	Check(elementsMatch, "each element starts on its block and holds its data");
+
+	// An array that does not fit in the rest of the ring restarts it, never splits
+	RingAllocation again = ring.UploadArray(nullptr, &objects[0], sizeof(ObjectData), Objects);
+	RingAllocation third = ring.UploadArray(nullptr, &objects[0], sizeof(ObjectData), Objects);
+	Check(again.Offset == Objects * 512 && third.Offset == 0, "a full ring restarts at 0");
+	Check(ring.GetStats().Wraps == 1, "the restart is counted");
+	Check(!ring.IsValid(array) && !ring.IsValid(again) && ring.IsValid(third), "allocations before a restart are invalid");
+
+	// Larger than the whole ring, even though each element fits
+	std::vector<ObjectData> tooMany(Objects * 3);
+	Check(ring.UploadArray(nullptr, &tooMany[0], sizeof(ObjectData), (uint32_t)tooMany.size()).Size == 0, "too large arrays give an empty allocation");
+}
+
+static void TestSlots()
+{
+	ConstantRing ring;
+	ring.Initialize(nullptr, 64 * 1024);
+	ring.BeginFrame();
+
+	float palette[16] = { 0 };
+	RingSlot dirtySlot, hashSlot;
+	for (int pass = 0; pass < 3; ++pass)
+	{
+		ring.UploadIfDirty(nullptr, palette, sizeof(palette), dirtySlot);
+		ring.UploadIfChanged(nullptr, palette, sizeof(palette), hashSlot);
+	}
+	Check(ring.GetStats().Uploads == 2 && ring.GetStats().SkippedUploads == 4, "clean and unchanged data is uploaded once");
+
+	dirtySlot.Dirty = true;
+	palette[3] = 1.0f;
+	ring.UploadIfDirty(nullptr, palette, sizeof(palette), dirtySlot);
+	ring.UploadIfChanged(nullptr, palette, sizeof(palette), hashSlot);
+	Check(ring.GetStats().Uploads == 4, "dirty and changed data is uploaded again");
+
+	// A new frame invalidates every allocation
+	ring.BeginFrame();
+	RingAllocation next = ring.UploadIfDirty(nullptr, palette, sizeof(palette), dirtySlot);
+	Check(ring.GetStats().Uploads == 1 && ring.GetStats().SkippedUploads == 0, "BeginFrame resets the stats and uploads again");
+	Check(next.Offset == 0, "BeginFrame restarts at 0");
+
+	// Allocations of a ring initialized again are not valid there
+	ring.Initialize(nullptr, 64 * 1024);
+	Check(!ring.IsValid(next), "a new ring does not take old allocations");
+}
+
+static void TestBind()
+{
+	StateTracker tracker;
+	tracker.BeginFrame();
+	RingAllocation array;
+	array.Buffer = Fake<ID3D11Buffer>(1, 0);
+	array.Offset = 1024;
+	array.Size = 4 * 512;
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		// The vertex and pixel shader of each object read the same range
+		RingAllocation element = ConstantRing::GetElement(array, sizeof(ObjectData), i);
+		ConstantRing::Bind(&tracker, ShaderStage::VS, 1, element);
+		ConstantRing::Bind(&tracker, ShaderStage::PS, 1, element);
+		ConstantRing::Bind(&tracker, ShaderStage::VS, 1, element);
+	}
+	Check(tracker.GetFrameCounts().Requested[(int)StateCategory::ConstantBuffer] == 12, "every bind is counted");
+	Check(tracker.GetFrameCounts().Issued[(int)StateCategory::ConstantBuffer] == 8, "a repeated range is filtered");
+
+	// The null backend ring has no buffer, nothing is bound
+	ConstantRing::Bind(&tracker, ShaderStage::VS, 1, RingAllocation());
+	Check(tracker.GetFrameCounts().Requested[(int)StateCategory::ConstantBuffer] == 12, "empty allocations are not bound");
+}
+
+int main()
+{
+	TestUploads();
+	TestArrays();
+	TestSlots();
+	TestBind();
+
+	if (g_failures)
+		return 1;
+	printf("All checks passed\n");
+	return 0;
+}
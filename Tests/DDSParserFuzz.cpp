@@ -0,0 +1,334 @@
+// Fuzzing and throughput of DDSParser. Seed files of every kind the parser accepts are built in
+// memory, and any DDS files named on the command line are added to them. Each seed must parse
+// with the expected layout, its last subresource ending where the data ends. Then random header
+// mutations and truncations of the seeds are parsed: whatever is accepted must keep every
+// subresource inside the data, and ParseDDS must agree with ParseDDSHeader. The copies are sized
+// exactly, so a build with a sanitizer also catches reads past the end. Last the headers parsed
+// per second, and the walk of every subresource of a large array one mip at a time against one
+// chain per slice.
+
+#include "pch.h"
+#include "Common/DDSParser.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+using namespace DX;
+
+static int g_failures = 0;
+// Keeps the bytes read from the subresources alive
+static volatile uint64_t g_sink = 0;
+
+static void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		++g_failures;
+	}
+}
+
+static void Put32(std::vector<uint8_t>& file, size_t offset, uint32_t value)
+{
+	memcpy(&file[offset], &value, sizeof(value));
+}
+
+static uint32_t FourCC(char a, char b, char c, char d)
+{
+	return (uint32_t)(uint8_t)a | (uint32_t)(uint8_t)b << 8 | (uint32_t)(uint8_t)c << 16 | (uint32_t)(uint8_t)d << 24;
+}
+
+// Bytes of one depth slice of a mip, for the formats of the seeds
+static size_t SurfaceBytes(DXGI_FORMAT format, uint32_t width, uint32_t height)
+{
+	size_t blocksWide = width < 4 ? 1 : (width + 3) / 4;
+	size_t blocksHigh = height < 4 ? 1 : (height + 3) / 4;
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+		return blocksWide * blocksHigh * 8;
+	case DXGI_FORMAT_BC3_UNORM:
+		return blocksWide * blocksHigh * 16;
+	default:
+		return (size_t)width * height * 4;
+	}
+}
+
+struct Seed
+{
+	std::string Name;
+	std::vector<uint8_t> File;
+	// Expected layout, ArraySize 0 for files from the command line
+	uint32_t MipCount;
+	uint32_t ArraySize;
+};
+
+// Headers of a DDS file with zeroed data for every subresource. dimension 0 writes a legacy
+// header, cube maps are six slices per array element either way.
+static Seed MakeSeed(const char* name, DXGI_FORMAT format, uint32_t dimension, uint32_t width, uint32_t height,
+	uint32_t depth, uint32_t mipCount, uint32_t arraySize, bool cube)
+{
+	Seed seed;
+	seed.Name = name;
+	seed.MipCount = mipCount;
+	seed.ArraySize = arraySize * (cube ? 6 : 1);
+
+	size_t sliceBytes = 0;
+	uint32_t w = width, h = height, d = depth;
+	for (uint32_t i = 0; i < mipCount; ++i)
+	{
+		sliceBytes += SurfaceBytes(format, w, h) * d;
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+		d = d > 1 ? d / 2 : 1;
+	}
+	size_t headerBytes = dimension ? 148 : 128;
+	seed.File.assign(headerBytes + sliceBytes * seed.ArraySize, 0);
+
+	std::vector<uint8_t>& file = seed.File;
+	Put32(file, 0, FourCC('D', 'D', 'S', ' '));
+	Put32(file, 4, 124);
+	Put32(file, 8, 0x1007 | 0x20000 | (depth > 1 ? 0x800000 : 0));
+	Put32(file, 12, height);
+	Put32(file, 16, width);
+	Put32(file, 24, depth);
+	Put32(file, 28, mipCount);
+	Put32(file, 76, 32);
+	if (dimension)
+	{
+		Put32(file, 80, 0x4);
+		Put32(file, 84, FourCC('D', 'X', '1', '0'));
+		Put32(file, 128, format);
+		Put32(file, 132, dimension);
+		Put32(file, 136, cube ? 0x4 : 0);
+		Put32(file, 140, arraySize);
+	}
+	else if (format == DXGI_FORMAT_BC1_UNORM)
+	{
+		Put32(file, 80, 0x4);
+		Put32(file, 84, FourCC('D', 'X', 'T', '1'));
+	}
+	else
+	{
+		// 32 bit RGBA masks, read as DXGI_FORMAT_R8G8B8A8_UNORM
+		Put32(file, 80, 0x41);
+		Put32(file, 88, 32);
+		Put32(file, 92, 0x000000ff);
+		Put32(file, 96, 0x0000ff00);
+		Put32(file, 100, 0x00ff0000);
+		Put32(file, 104, 0xff000000);
+	}
+	Put32(file, 108, 0x1000 | 0x400008);
+	if (cube && !dimension)
+		Put32(file, 112, 0xfe00);
+	return seed;
+}
+
+static std::vector<Seed> MakeSeeds(int argc, char** argv)
+{
+	const DXGI_FORMAT rgba = DXGI_FORMAT_R8G8B8A8_UNORM;
+	std::vector<Seed> seeds;
+	seeds.push_back(MakeSeed("legacy rgba", rgba, 0, 256, 256, 1, 9, 1, false));
+	seeds.push_back(MakeSeed("legacy dxt1", DXGI_FORMAT_BC1_UNORM, 0, 128, 64, 1, 8, 1, false));
+	seeds.push_back(MakeSeed("legacy cube", rgba, 0, 32, 32, 1, 6, 1, true));
+	seeds.push_back(MakeSeed("legacy volume", rgba, 0, 16, 16, 8, 5, 1, false));
+	seeds.push_back(MakeSeed("bc3 array", DXGI_FORMAT_BC3_UNORM, 3, 64, 64, 1, 7, 4, false));
+	seeds.push_back(MakeSeed("1d array", rgba, 2, 256, 1, 1, 9, 2, false));
+	seeds.push_back(MakeSeed("bc1 cube array", DXGI_FORMAT_BC1_UNORM, 3, 16, 16, 1, 5, 2, true));
+	seeds.push_back(MakeSeed("volume", rgba, 4, 32, 16, 4, 6, 1, false));
+	seeds.push_back(MakeSeed("long array", rgba, 3, 64, 64, 1, 7, 20, false));
+	for (int i = 1; i < argc; ++i)
+	{
+		std::ifstream stream(argv[i], std::ios::binary);
+		Seed seed;
+		seed.Name = argv[i];
+		seed.File.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+		seed.MipCount = seed.ArraySize = 0;
+		Check(!seed.File.empty(), "files named on the command line can be read");
+		if (!seed.File.empty())
+			seeds.push_back(seed);
+	}
+	return seeds;
+}
+
+// Every subresource of a file ParseDDSHeader accepted, walked one chain per slice. Returns
+// false when one of them leaves the data.
+static bool WalkAll(const std::vector<uint8_t>& file, const DDSTextureDesc& desc, uint64_t& touched)
+{
+	const uint8_t* begin = file.data();
+	const uint8_t* end = begin + file.size();
+	DDSSubresource mips[DDSMaxMipLevels];
+	for (uint32_t j = 0; j < desc.ArraySize; ++j)
+	{
+		GetDDSMipChain(begin, desc, j, mips);
+		for (uint32_t i = 0; i < desc.MipCount; ++i)
+		{
+			const DDSSubresource& mip = mips[i];
+			if (mip.Size == 0 || mip.Data < begin || mip.Data > end || mip.Size > (size_t)(end - mip.Data))
+				return false;
+			touched += mip.Data[0] + mip.Data[mip.Size - 1];
+		}
+	}
+	return true;
+}
+
+static void TestSeeds(const std::vector<Seed>& seeds)
+{
+	for (auto& seed : seeds)
+	{
+		DDSTextureDesc desc;
+		DDSResult result = ParseDDSHeader(seed.File.data(), seed.File.size(), desc);
+		Check(result == DDSResult::Ok, seed.Name.c_str());
+		if (result != DDSResult::Ok)
+			continue;
+
+		// The chains, one mip at a time and the descriptor agree
+		static DDSDescriptor descriptor;
+		DDSResult full = ParseDDS(seed.File.data(), seed.File.size(), descriptor);
+		bool fits = desc.MipCount * desc.ArraySize <= DDSMaxSubresources;
+		Check(full == (fits ? DDSResult::Ok : DDSResult::TooManySubresources), "ParseDDS only refuses too many subresources");
+		bool same = true;
+		DDSSubresource mips[DDSMaxMipLevels];
+		for (uint32_t j = 0; j < desc.ArraySize; ++j)
+		{
+			GetDDSMipChain(seed.File.data(), desc, j, mips);
+			for (uint32_t i = 0; i < desc.MipCount; ++i)
+			{
+				DDSSubresource one = GetDDSSubresource(seed.File.data(), desc, j, i);
+				same = same && one.Data == mips[i].Data && one.Size == mips[i].Size && one.RowPitch == mips[i].RowPitch;
+				if (fits)
+					same = same && descriptor.Get(j, i).Data == mips[i].Data && descriptor.Get(j, i).Size == mips[i].Size;
+			}
+		}
+		Check(same, "mip chains, single subresources and the descriptor agree");
+
+		// A file from the command line may carry trailing bytes, the built ones must not
+		const DDSSubresource& last = mips[desc.MipCount - 1];
+		size_t lastEnd = (size_t)(last.Data - seed.File.data()) + last.Size;
+		if (seed.ArraySize)
+		{
+			Check(desc.MipCount == seed.MipCount && desc.ArraySize == seed.ArraySize, "expected mips and slices");
+			Check(lastEnd == seed.File.size(), "the last subresource ends with the data");
+			std::vector<uint8_t> shorter(seed.File.begin(), seed.File.end() - 1);
+			Check(ParseDDSHeader(shorter.data(), shorter.size(), desc) == DDSResult::OutOfBounds, "one byte short is out of bounds");
+		}
+		else
+		{
+			Check(lastEnd <= seed.File.size(), "the last subresource is inside the file");
+		}
+	}
+}
+
+static void Fuzz(const std::vector<Seed>& seeds, int iterations)
+{
+	std::mt19937 random(1);
+	static DDSDescriptor descriptor;
+	int accepted = 0;
+	int results[8] = { 0 };
+	bool inside = true;
+	bool agree = true;
+	uint64_t touched = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int iteration = 0; iteration < iterations; ++iteration)
+	{
+		const Seed& seed = seeds[random() % seeds.size()];
+		std::vector<uint8_t> bytes(seed.File);
+
+		// Mostly the headers, sometimes a truncation anywhere
+		int mutations = 1 + random() % 8;
+		for (int m = 0; m < mutations; ++m)
+		{
+			size_t offset = random() % std::min<size_t>(bytes.size(), 148);
+			bytes[offset] = random() % 4 ? (uint8_t)random() : (uint8_t)(bytes[offset] ^ (1u << (random() % 8)));
+		}
+		if (random() % 4 == 0)
+			bytes.resize(random() % (bytes.size() + 1));
+
+		// An exactly sized copy, whatever the capacity of bytes
+		std::vector<uint8_t> file(bytes.begin(), bytes.end());
+		const uint8_t* data = file.empty() ? nullptr : file.data();
+		DDSTextureDesc desc;
+		DDSResult result = ParseDDSHeader(data, file.size(), desc);
+		++results[(int)result];
+		if (result != DDSResult::Ok)
+		{
+			agree = agree && ParseDDS(data, file.size(), descriptor) == result;
+			continue;
+		}
+		++accepted;
+		inside = inside && WalkAll(file, desc, touched);
+		DDSResult full = ParseDDS(data, file.size(), descriptor);
+		agree = agree && (full == DDSResult::Ok || full == DDSResult::TooManySubresources);
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	g_sink = touched;
+
+	printf("fuzz: %d inputs in %.2f s, %d accepted, rejected as not DDS %d, format %d, dimensions %d, bounds %d\n",
+		iterations, seconds, accepted, results[(int)DDSResult::NotDDS], results[(int)DDSResult::UnsupportedFormat],
+		results[(int)DDSResult::InvalidDimensions], results[(int)DDSResult::OutOfBounds]);
+	Check(inside, "accepted inputs keep every subresource inside the data");
+	Check(agree, "ParseDDS agrees with ParseDDSHeader");
+}
+
+static void Throughput(const std::vector<Seed>& seeds)
+{
+	// Header parses of the small seeds
+	const int Parses = 1000000;
+	DDSTextureDesc desc;
+	UINT64 ok = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < Parses; ++i)
+	{
+		const Seed& seed = seeds[i % 8];
+		ok += ParseDDSHeader(seed.File.data(), seed.File.size(), desc) == DDSResult::Ok;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	Check(ok == (UINT64)Parses, "the seeds parse");
+	printf("%-28s %10.2f M/s\n", "ParseDDSHeader", Parses / seconds / 1e6);
+
+	// Every subresource of a 13 mip, 256 slice array
+	Seed array = MakeSeed("wide array", DXGI_FORMAT_R8G8B8A8_UNORM, 3, 4096, 1, 1, 13, 256, false);
+	ParseDDSHeader(array.File.data(), array.File.size(), desc);
+	const int Walks = 50;
+	size_t bytes[2] = { 0, 0 };
+	double times[2];
+	for (int method = 0; method < 2; ++method)
+	{
+		start = std::chrono::high_resolution_clock::now();
+		for (int walk = 0; walk < Walks; ++walk)
+		{
+			DDSSubresource mips[DDSMaxMipLevels];
+			for (uint32_t j = 0; j < desc.ArraySize; ++j)
+			{
+				if (method == 1)
+					GetDDSMipChain(array.File.data(), desc, j, mips);
+				for (uint32_t i = 0; i < desc.MipCount; ++i)
+					bytes[method] += method == 0 ? GetDDSSubresource(array.File.data(), desc, j, i).Size : mips[i].Size;
+			}
+		}
+		times[method] = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+	Check(bytes[0] == bytes[1], "both walks cover the same bytes");
+	double subresources = (double)Walks * desc.ArraySize * desc.MipCount;
+	printf("%-28s %10.1f ns per subresource\n", "GetDDSSubresource per mip", times[0] * 1e9 / subresources);
+	printf("%-28s %10.1f ns per subresource\n", "GetDDSMipChain per slice", times[1] * 1e9 / subresources);
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<Seed> seeds = MakeSeeds(argc, argv);
+	TestSeeds(seeds);
+	Fuzz(seeds, 300000);
+	Throughput(seeds);
+
+	if (g_failures)
+		return 1;
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,102 @@
+// Time of CreateGeosphere from level 0 to 8, position only so that the edge subdivision
+// dominates. Each level is checked on the way: the vertex and index counts, vertices on the
+// sphere and no two alike, and every edge shared by exactly two triangles.
+
+#include "pch.h"
+#include "Common/GeometryGenerator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+using namespace DX;
+
+static int g_failures = 0;
+
+static void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		++g_failures;
+	}
+}
+
+struct PosVertex
+{
+	XMFLOAT3 Pos;
+};
+
+static void CheckMesh(const std::vector<PosVertex>& vertices, const std::vector<UINT>& indices, float radius)
+{
+	bool onSphere = true;
+	for (auto& v : vertices)
+		onSphere = onSphere && fabsf(sqrtf(v.Pos.x * v.Pos.x + v.Pos.y * v.Pos.y + v.Pos.z * v.Pos.z) - radius) < 1e-4f * radius;
+	Check(onSphere, "vertices on the sphere");
+
+	std::vector<XMFLOAT3> sorted(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+		sorted[i] = vertices[i].Pos;
+	auto less = [](const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+	};
+	std::sort(sorted.begin(), sorted.end(), less);
+	bool unique = true;
+	for (size_t i = 1; i < sorted.size(); ++i)
+		unique = unique && less(sorted[i - 1], sorted[i]);
+	Check(unique, "no duplicate vertices");
+
+	// Directed edges: each must appear once and its reverse once, so the mesh is closed and
+	// the two triangles of an edge share its vertices
+	bool inRange = true;
+	std::vector<UINT64> edges(indices.size());
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		UINT a = indices[i];
+		UINT b = indices[i % 3 == 2 ? i - 2 : i + 1];
+		inRange = inRange && a < vertices.size() && b < vertices.size();
+		edges[i] = (UINT64)a << 32 | b;
+	}
+	Check(inRange, "indices in range");
+	std::sort(edges.begin(), edges.end());
+	bool shared = std::adjacent_find(edges.begin(), edges.end()) == edges.end();
+	for (size_t i = 0; i < edges.size() && shared; ++i)
+		shared = std::binary_search(edges.begin(), edges.end(), edges[i] << 32 | edges[i] >> 32);
+	Check(shared, "every edge shared by two triangles");
+}
+
+int main()
+{
+	const float radius = 2.0f;
+	GeometryGenerator generator;
+
+	printf("%-6s %10s %10s %10s %10s\n", "level", "vertices", "triangles", "ms", "Mtri/s");
+	for (UINT level = 0; level <= GeometryGenerator::MaxGeosphereSubdivisions; ++level)
+	{
+		std::vector<PosVertex> vertices(GeometryGenerator::GetGeosphereVertexCount(level));
+		std::vector<UINT> indices(GeometryGenerator::GetGeosphereIndexCount(level));
+		UINT triangles = (UINT)indices.size() / 3;
+		int runs = level >= 7 ? 3 : level >= 5 ? 20 : 200;
+
+		double seconds = 0.0;
+		for (int run = 0; run < runs; ++run)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			generator.CreateGeosphere<PosPolicy<PosVertex>>(radius, level, vertices.data(), indices.data());
+			seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+		double ms = seconds * 1e3 / runs;
+		printf("%-6u %10u %10u %10.3f %10.1f\n", level, (UINT)vertices.size(), triangles, ms, triangles / (ms * 1e3));
+
+		Check(vertices.size() == 10 * ((size_t)1 << 2 * level) + 2, "10*4^n+2 vertices");
+		Check(indices.size() == 60 * ((size_t)1 << 2 * level), "20*4^n triangles");
+		CheckMesh(vertices, indices, radius);
+	}
+
+	if (g_failures)
+		return 1;
+	printf("All checks passed\n");
+	return 0;
+}
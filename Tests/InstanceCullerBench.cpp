@@ -0,0 +1,201 @@
+// Time of InstanceCuller on 100000 rotated and scaled instances, with a shared box and with
+// one box per instance, against a scalar loop of BoundingBox::Transform and the plane tests
+// of BoundingBox::Intersects. Both must flag the same instances, apart from boxes touching a
+// plane within rounding, including at counts that do not fill the last group of four.
+
+#include "pch.h"
+#include "Components/InstanceCuller.h"
+#include "Common/MathHelper.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace DirectX;
+using namespace DXFramework;
+using namespace DX;
+
+static int g_failures = 0;
+
+static void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		++g_failures;
+	}
+}
+
+// Scalar reference. margin is how far the box is from crossing the nearest plane, so the
+// caller can tell a real mismatch from a rounding one.
+static bool ReferenceVisible(const BoundingBox& localBox, const XMFLOAT4X4& world, const XMFLOAT4 planes[6], float& margin)
+{
+	BoundingBox box;
+	localBox.Transform(box, XMLoadFloat4x4(&world));
+	bool visible = true;
+	margin = MathHelper::Infinity;
+	for (UINT p = 0; p < 6; ++p)
+	{
+		XMVECTOR plane = XMLoadFloat4(&planes[p]);
+		if (box.Intersects(plane) == BACK)
+			visible = false;
+		float d = planes[p].x * box.Center.x + planes[p].y * box.Center.y + planes[p].z * box.Center.z + planes[p].w;
+		float r = fabsf(planes[p].x) * box.Extents.x + fabsf(planes[p].y) * box.Extents.y + fabsf(planes[p].z) * box.Extents.z;
+		margin = MathHelper::Min(margin, fabsf(d + r));
+	}
+	return visible;
+}
+
+static UINT ReferenceCull(const BoundingBox* boxes, UINT boxStride, const XMFLOAT4X4* worlds, UINT count,
+	const XMFLOAT4 planes[6], UINT8* visible)
+{
+	UINT visibleCount = 0;
+	for (UINT i = 0; i < count; ++i)
+	{
+		float margin;
+		visible[i] = ReferenceVisible(boxes[i * boxStride], worlds[i], planes, margin);
+		visibleCount += visible[i];
+	}
+	return visibleCount;
+}
+
+// Instances in a cube around the camera, turned about y and scaled.
+static void BuildScene(std::vector<XMFLOAT4X4>& worlds, std::vector<BoundingBox>& boxes, UINT count)
+{
+	srand(7);
+	worlds.resize(count);
+	boxes.resize(count);
+	for (UINT i = 0; i < count; ++i)
+	{
+		float scale = MathHelper::RandF(0.5f, 2.0f);
+		XMMATRIX W = XMMatrixScaling(scale, scale, scale) * XMMatrixRotationY(MathHelper::RandF(0.0f, 2.0f * MathHelper::Pi)) *
+			XMMatrixTranslation(MathHelper::RandF(-500.0f, 500.0f), MathHelper::RandF(-50.0f, 50.0f), MathHelper::RandF(-500.0f, 500.0f));
+		XMStoreFloat4x4(&worlds[i], W);
+		boxes[i] = BoundingBox(XMFLOAT3(MathHelper::RandF(-1.0f, 1.0f), 1.0f, 0.0f),
+			XMFLOAT3(MathHelper::RandF(0.5f, 4.0f), MathHelper::RandF(0.5f, 4.0f), MathHelper::RandF(0.5f, 4.0f)));
+	}
+}
+
+static void BuildPlanes(XMFLOAT4 planes[6], BasicPerFrameCB& perFrame)
+{
+	XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 10.0f, -20.0f, 1.0f), XMVectorSet(30.0f, 0.0f, 100.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f * MathHelper::Pi, 16.0f / 9.0f, 1.0f, 400.0f);
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, view * proj);
+	ExtractFrustumPlanes(planes, viewProj);
+	XMStoreFloat4x4(&perFrame.ViewProj, XMMatrixTranspose(view * proj));
+}
+
+// Flags of the culler against the reference. Differences are only allowed for boxes that
+// touch a plane.
+static bool SameFlags(const UINT8* visible, const BoundingBox* boxes, UINT boxStride, const XMFLOAT4X4* worlds, UINT count,
+	const XMFLOAT4 planes[6], UINT& rounding)
+{
+	bool same = true;
+	for (UINT i = 0; i < count; ++i)
+	{
+		float margin;
+		bool expected = ReferenceVisible(boxes[i * boxStride], worlds[i], planes, margin);
+		if ((visible[i] != 0) != expected)
+		{
+			if (margin < 1e-3f)
+				++rounding;
+			else
+				same = false;
+		}
+	}
+	return same;
+}
+
+static void TestSmallCounts(const std::vector<XMFLOAT4X4>& worlds, const std::vector<BoundingBox>& boxes, const XMFLOAT4 planes[6])
+{
+	bool same = true;
+	bool inBounds = true;
+	bool counted = true;
+	UINT rounding = 0;
+	for (UINT count = 0; count <= 9; ++count)
+	{
+		// One guard byte past the end, the last group must not write it
+		std::vector<UINT8> visible(count + 1, 0xcd);
+		UINT visibleCount = InstanceCuller::Cull(&boxes[0], &worlds[0], count, planes, &visible[0]);
+		inBounds = inBounds && visible[count] == 0xcd;
+		UINT flagged = 0;
+		for (UINT i = 0; i < count; ++i)
+			flagged += visible[i];
+		counted = counted && flagged == visibleCount;
+		same = same && SameFlags(&visible[0], &boxes[0], 1, &worlds[0], count, planes, rounding);
+
+		std::fill(visible.begin(), visible.end(), (UINT8)0xcd);
+		InstanceCuller::Cull(boxes[0], &worlds[0], count, planes, &visible[0]);
+		inBounds = inBounds && visible[count] == 0xcd;
+		same = same && SameFlags(&visible[0], &boxes[0], 0, &worlds[0], count, planes, rounding);
+	}
+	Check(same, "small counts: same flags as the reference");
+	Check(inBounds, "small counts: nothing written past the count");
+	Check(counted, "small counts: returned count matches the flags");
+}
+
+int main()
+{
+	const UINT instanceCount = 100000;
+	const int runs = 20;
+	std::vector<XMFLOAT4X4> worlds;
+	std::vector<BoundingBox> boxes;
+	BuildScene(worlds, boxes, instanceCount);
+	XMFLOAT4 planes[6];
+	BasicPerFrameCB perFrame;
+	BuildPlanes(planes, perFrame);
+
+	// ExtractPlanes reads the transposed ViewProj of the per frame buffer
+	XMFLOAT4 cbPlanes[6];
+	InstanceCuller::ExtractPlanes(perFrame, cbPlanes);
+	bool samePlanes = true;
+	for (UINT p = 0; p < 6; ++p)
+	{
+		samePlanes = samePlanes && fabsf(cbPlanes[p].x - planes[p].x) < 1e-5f && fabsf(cbPlanes[p].y - planes[p].y) < 1e-5f &&
+			fabsf(cbPlanes[p].z - planes[p].z) < 1e-5f && fabsf(cbPlanes[p].w - planes[p].w) < 1e-3f;
+	}
+	Check(samePlanes, "ExtractPlanes of the per frame buffer");
+
+	TestSmallCounts(worlds, boxes, planes);
+
+	std::vector<UINT8> visible(instanceCount);
+	std::vector<UINT8> reference(instanceCount);
+	printf("%u instances, %d runs\n", instanceCount, runs);
+	printf("%-12s %10s %10s %10s %10s %10s\n", "boxes", "visible", "culler ms", "scalar ms", "speedup", "Minst/s");
+	for (UINT boxStride = 0; boxStride <= 1; ++boxStride)
+	{
+		double cullerSeconds = 0.0;
+		double scalarSeconds = 0.0;
+		UINT visibleCount = 0;
+		UINT referenceCount = 0;
+		for (int run = 0; run < runs; ++run)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			if (boxStride)
+				visibleCount = InstanceCuller::Cull(&boxes[0], &worlds[0], instanceCount, planes, &visible[0]);
+			else
+				visibleCount = InstanceCuller::Cull(boxes[0], &worlds[0], instanceCount, planes, &visible[0]);
+			auto middle = std::chrono::high_resolution_clock::now();
+			referenceCount = ReferenceCull(&boxes[0], boxStride, &worlds[0], instanceCount, planes, &reference[0]);
+			auto end = std::chrono::high_resolution_clock::now();
+			cullerSeconds += std::chrono::duration<double>(middle - start).count();
+			scalarSeconds += std::chrono::duration<double>(end - middle).count();
+		}
+		double cullerMs = cullerSeconds * 1e3 / runs;
+		double scalarMs = scalarSeconds * 1e3 / runs;
+		printf("%-12s %10u %10.3f %10.3f %10.2f %10.1f\n", boxStride ? "per instance" : "shared", visibleCount,
+			cullerMs, scalarMs, scalarMs / cullerMs, instanceCount / (cullerMs * 1e3));
+
+		UINT rounding = 0;
+		Check(SameFlags(&visible[0], &boxes[0], boxStride, &worlds[0], instanceCount, planes, rounding), "same flags as the reference");
+		Check(rounding <= 2 && (UINT)abs((int)visibleCount - (int)referenceCount) <= rounding, "visible count of the reference");
+		Check(visibleCount > 0 && visibleCount < instanceCount, "the view sees part of the scene");
+	}
+
+	if (g_failures)
+		return 1;
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,123 @@
+// CPU cost and call counts of the two BasicObject draw paths, without a device. The per
+// instance path fills and uploads a BasicPerObjectCB and draws once per instance, the
+// instanced path writes the instance stream of a unit with TransformStore::WriteInstances
+// and draws the unit once. Map and draw calls are counted, the copies into the mapped memory
+// are timed. The ns columns are per instance and frame.
+
+#include "pch.h"
+#include "Components/TransformStore.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+using namespace DirectX;
+using namespace DXFramework;
+
+// Same layouts as DX::BasicPerObjectCB and DX::BasicInstance
+struct PerObjectData
+{
+	XMFLOAT4X4 World;
+	XMFLOAT4X4 WorldInvTranspose;
+	XMFLOAT4X4 TexTransform;
+	XMFLOAT4 Mat[4];
+};
+
+struct Instance
+{
+	XMFLOAT4X4 World;
+	XMFLOAT4 WorldInvTranspose[3];
+	UINT MatIndex;
+};
+
+struct Calls
+{
+	UINT Maps;
+	UINT Draws;
+};
+
+static const int Frames = 200;
+
+static double Run(UINT units, UINT instancesPerUnit, bool instanced, Calls& calls)
+{
+	UINT count = units * instancesPerUnit;
+	std::vector<XMFLOAT4X4> worlds(count);
+	for (UINT i = 0; i < count; ++i)
+		XMStoreFloat4x4(&worlds[i], XMMatrixMultiply(XMMatrixRotationY(i * 0.1f), XMMatrixTranslation((float)(i % 100), 0.0f, (float)(i / 100))));
+	TransformStore transforms;
+	transforms.Initialize(worlds.data(), count);
+	transforms.Update();
+
+	std::vector<UINT8> visible(count, 1);
+	XMFLOAT4 material[4] = {};
+	XMFLOAT4X4 texTransform;
+	XMStoreFloat4x4(&texTransform, XMMatrixIdentity());
+	// Stand-ins for the mapped constant buffer and the mapped instance stream
+	PerObjectData objectCB;
+	std::vector<Instance> stream(count);
+	volatile BYTE sink = 0;
+
+	calls.Maps = calls.Draws = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < Frames; ++frame)
+	{
+		if (!instanced)
+		{
+			for (UINT i = 0; i < count; ++i)
+			{
+				PerObjectData data;
+				data.World = transforms.GetWorldT(i);
+				data.WorldInvTranspose = transforms.GetWorldInvTransposeT(i);
+				data.TexTransform = texTransform;
+				memcpy(data.Mat, material, sizeof(material));
+				memcpy(&objectCB, &data, sizeof(data));
+				++calls.Maps;
+				++calls.Draws;
+			}
+		}
+		else
+		{
+			++calls.Maps;
+			UINT written = 0;
+			for (UINT u = 0; u < units; ++u)
+			{
+				UINT first = u * instancesPerUnit;
+				written += transforms.WriteInstances(first, instancesPerUnit, &visible[first], u, instancesPerUnit, &stream[written]);
+				memcpy(&objectCB.TexTransform, &texTransform, sizeof(texTransform));
+				++calls.Maps;
+				++calls.Draws;
+			}
+		}
+		sink = sink + ((BYTE*)&objectCB)[frame % sizeof(objectCB)] + ((BYTE*)stream.data())[frame];
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	calls.Maps /= Frames;
+	calls.Draws /= Frames;
+	return seconds * 1e9 / ((double)Frames * count);
+}
+
+int main()
+{
+	struct Scene { const char* Name; UINT Units; UINT Instances; } scenes[] =
+	{
+		{ "spheres, 1 x 10", 1, 10 },
+		{ "crates, 1 x 1000", 1, 1000 },
+		{ "mixed, 20 x 50", 20, 50 },
+		{ "forest, 4 x 10000", 4, 10000 }
+	};
+
+	printf("%-20s %10s %10s %10s %12s %12s %10s\n", "scene", "draws", "maps", "ns", "inst draws", "inst maps", "inst ns");
+	for (auto& scene : scenes)
+	{
+		Calls perInstance, instanced;
+		double perInstanceNs = Run(scene.Units, scene.Instances, false, perInstance);
+		double instancedNs = Run(scene.Units, scene.Instances, true, instanced);
+		printf("%-20s %10u %10u %10.1f %12u %12u %10.1f\n", scene.Name, perInstance.Draws, perInstance.Maps,
+			perInstanceNs, instanced.Draws, instanced.Maps, instancedNs);
+		if (instanced.Draws != scene.Units || perInstance.Draws != scene.Units * scene.Instances)
+		{
+			printf("FAILED: unexpected draw count\n");
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,111 @@
+// Time of GenerateMips for the box and the Kaiser filter, on linear and sRGB data, from level
+// 0 sizes of terrain and atlas textures. The ms column is one full chain, Mtex/s counts the
+// texels of level 0. A black and white checker checks the filtering space on the way: its
+// 1x1 level is half intensity, 128 filtered as is and 188 filtered in linear space.
+
+#include "pch.h"
+#include "Common/MipGenerator.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace DX;
+
+static int g_failures = 0;
+
+static void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		++g_failures;
+	}
+}
+
+// Smooth gradients with some noise, so no filter gets an easy input
+static std::vector<BYTE> MakePixels(UINT size)
+{
+	std::vector<BYTE> pixels((size_t)size * size * 4);
+	unsigned seed = 1;
+	for (UINT y = 0; y < size; ++y)
+	{
+		for (UINT x = 0; x < size; ++x)
+		{
+			seed = seed * 1103515245 + 12345;
+			BYTE* texel = &pixels[((size_t)y * size + x) * 4];
+			texel[0] = (BYTE)(x * 255 / size);
+			texel[1] = (BYTE)(y * 255 / size);
+			texel[2] = (BYTE)((seed >> 16) & 0xff);
+			texel[3] = 255;
+		}
+	}
+	return pixels;
+}
+
+static void TestFilteringSpace()
+{
+	const UINT size = 64;
+	std::vector<BYTE> pixels((size_t)size * size * 4);
+	for (UINT y = 0; y < size; ++y)
+	{
+		for (UINT x = 0; x < size; ++x)
+		{
+			BYTE value = (x + y) % 2 ? 255 : 0;
+			BYTE* texel = &pixels[((size_t)y * size + x) * 4];
+			texel[0] = texel[1] = texel[2] = value;
+			texel[3] = 255;
+		}
+	}
+
+	MipImage image;
+	image.Initialize(pixels.data(), size, size, size * 4);
+	GenerateMips(image, false);
+	const BYTE* last = image.GetLevel(image.GetMipCount() - 1);
+	Check(image.GetMipCount() == GetFullMipCount(size, size), "full chain down to 1x1");
+	Check(abs(last[0] - 128) <= 1, "linear data is averaged as is");
+
+	image.Initialize(pixels.data(), size, size, size * 4);
+	GenerateMips(image, true);
+	last = image.GetLevel(image.GetMipCount() - 1);
+	Check(abs(last[0] - 188) <= 1 && last[3] == 255, "sRGB data is averaged in linear space, alpha as is");
+}
+
+int main()
+{
+	TestFilteringSpace();
+
+	const UINT sizes[] = { 256, 1024, 2048, 4096 };
+	struct Mode { const char* Name; MipFilter Filter; bool Srgb; } modes[] =
+	{
+		{ "box", MipFilter::Box, false },
+		{ "box sRGB", MipFilter::Box, true },
+		{ "kaiser", MipFilter::Kaiser, false },
+		{ "kaiser sRGB", MipFilter::Kaiser, true }
+	};
+
+	printf("%-8s %-12s %10s %10s\n", "size", "filter", "ms", "Mtex/s");
+	for (UINT size : sizes)
+	{
+		std::vector<BYTE> pixels = MakePixels(size);
+		int runs = size >= 2048 ? 3 : 20;
+		for (auto& mode : modes)
+		{
+			MipImage image;
+			double seconds = 0.0;
+			for (int run = 0; run < runs; ++run)
+			{
+				// Initialize drops the chain of the last run, only GenerateMips is timed
+				image.Initialize(pixels.data(), size, size, size * 4);
+				auto start = std::chrono::high_resolution_clock::now();
+				GenerateMips(image, mode.Srgb, mode.Filter);
+				seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			}
+			double ms = seconds * 1e3 / runs;
+			printf("%-8u %-12s %10.2f %10.1f\n", size, mode.Name, ms, (double)size * size / (ms * 1e3));
+		}
+	}
+
+	if (g_failures)
+		return 1;
+	return 0;
+}
@@ -0,0 +1,246 @@
+// Checks and benchmark of RenderQueue, replayed through RecordingDrawContext so no device is
+// needed. The checks cover the key order (pass, then front to back, translucent back to
+// front), filtering of unchanged state, the object data indices, instanced and skinned packets
+// and the expiry of ids.
+// The benchmark submits a scene of many objects sharing a few shaders and textures and
+// compares the binds of the submission order with the sorted order.
+
+#include "pch.h"
+#include "Components/RenderQueue.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+using namespace DirectX;
+using namespace DXFramework;
+
+static int g_failures = 0;
+
+static void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		++g_failures;
+	}
+}
+
+// State objects are only compared by address, so any distinct non null address will do
+template<typename T>
+static T* Fake(UINT kind, UINT index)
+{
+	return reinterpret_cast<T*>((uintptr_t)(kind << 20 | (index + 1) << 4));
+}
+
+static DrawPacket MakePacket(UINT shader, UINT texture)
+{
+	DrawPacket packet;
+	packet.InputLayout = Fake<ID3D11InputLayout>(1, 0);
+	packet.VertexBuffer = Fake<ID3D11Buffer>(2, 0);
+	packet.Stride = 32;
+	packet.IndexBuffer = Fake<ID3D11Buffer>(3, 0);
+	packet.VS = Fake<ID3D11VertexShader>(4, shader);
+	packet.PS = Fake<ID3D11PixelShader>(5, shader);
+	packet.PSResources[0] = Fake<ID3D11ShaderResourceView>(6, texture);
+	packet.Count = 36;
+	return packet;
+}
+
+static DX::BasicPerObjectCB MakeObjectData(UINT tag)
+{
+	DX::BasicPerObjectCB data;
+	ZeroMemory(&data, sizeof(data));
+	data.World._44 = (float)tag;
+	return data;
+}
+
+static void TestPassAndDepthOrder()
+{
+	RenderQueue queue;
+	queue.Clear();
+	queue.SetView(XMFLOAT3(0.0f, 0.0f, 0.0f));
+	DrawPacket packet = MakePacket(0, 0);
+	int material = 0;
+	// Added far to near, translucent ones first
+	for (int i = 0; i < 4; ++i)
+	{
+		packet.Base = 100 + i;
+		queue.Add(packet, MakeObjectData(i), RenderPass::Translucent, &material, XMFLOAT3(0.0f, 0.0f, 40.0f - i * 10.0f));
+	}
+	for (int i = 0; i < 4; ++i)
+	{
+		packet.Base = i;
+		queue.Add(packet, MakeObjectData(i), RenderPass::Opaque, &material, XMFLOAT3(0.0f, 0.0f, 40.0f - i * 10.0f));
+	}
+	queue.Sort();
+
+	Check(queue.GetPacketCount() == 8, "every packet is kept");
+	for (UINT i = 0; i < 4; ++i)
+		Check(queue.GetSortedPacket(i).Base == 3 - i, "opaque packets come first, front to back");
+	for (UINT i = 4; i < 8; ++i)
+		Check(queue.GetSortedPacket(i).Base == 100 + i - 4, "translucent packets come last, back to front");
+}
+
+static void TestStateFiltering()
+{
+	RenderQueue queue;
+	queue.Clear();
+	int material = 0;
+	// Two shaders and two textures interleaved in submission order
+	for (UINT i = 0; i < 100; ++i)
+		queue.Add(MakePacket(i % 2, (i / 2) % 2), MakeObjectData(i), RenderPass::Opaque, &material, XMFLOAT3(0.0f, 0.0f, 1.0f + i));
+	queue.Sort();
+	RecordingDrawContext context;
+	queue.Execute(context);
+
+	Check(context.GetCount(DrawCommandType::DrawIndexed) == 100, "one draw per packet");
+	Check(context.GetCount(DrawCommandType::ObjectData) == 100, "object data per packet");
+	Check(context.GetCount(DrawCommandType::VS) == 2, "each vertex shader bound once");
+	Check(context.GetCount(DrawCommandType::PS) == 2, "each pixel shader bound once");
+	Check(context.GetCount(DrawCommandType::InputLayout) == 1, "shared input layout bound once");
+	Check(context.GetCount(DrawCommandType::VertexBuffer) == 1, "shared vertex buffer bound once");
+	Check(context.GetCount(DrawCommandType::IndexBuffer) == 1, "shared index buffer bound once");
+	// Slot 0 changes with the texture inside each shader, the other five slots are set once
+	Check(context.GetCount(DrawCommandType::PSResource) == 4 + 5, "textures bound once per shader and texture");
+	Check(context.GetCount(DrawCommandType::InstanceBuffer) == 0, "no instance stream without instanced packets");
+
+	const std::vector<RecordedCommand>& commands = context.GetCommands();
+	Check(!commands.empty() && commands.back().Type == DrawCommandType::DrawIndexed, "the last command is a draw");
+
+	// The index is the one of the data, so contexts can bind what they uploaded up front
+	bool indices = true;
+	for (const RecordedCommand& command : commands)
+	{
+		if (command.Type == DrawCommandType::ObjectData)
+			indices = indices && ((const DX::BasicPerObjectCB*)command.Object)->World._44 == (float)command.Args[0];
+	}
+	Check(indices, "object data comes with its index");
+}
+
+static void TestInstancedAndSkinned()
+{
+	RenderQueue queue;
+	queue.Clear();
+	int material = 0;
+	DrawPacket packet = MakePacket(0, 0);
+	packet.InstanceBuffer = Fake<ID3D11Buffer>(7, 0);
+	packet.InstanceStride = 112;
+	packet.InstanceCount = 50;
+	packet.StartInstance = 10;
+	packet.Start = 6;
+	packet.Base = 3;
+	queue.Add(packet, MakeObjectData(0), RenderPass::Opaque, &material, XMFLOAT3(0.0f, 0.0f, 1.0f));
+
+	// Three subsets of one skinned instance share its palette
+	float palette[16] = { 0 };
+	DrawPacket skinned = MakePacket(1, 0);
+	skinned.BonePalette = palette;
+	skinned.BonePaletteSize = sizeof(palette);
+	for (UINT i = 0; i < 3; ++i)
+		queue.Add(skinned, MakeObjectData(i), RenderPass::Opaque, &material, XMFLOAT3(0.0f, 0.0f, 2.0f));
+	queue.Sort();
+	RecordingDrawContext context;
+	queue.Execute(context);
+
+	Check(context.GetCount(DrawCommandType::DrawIndexedInstanced) == 1, "instanced packet drawn instanced");
+	Check(context.GetCount(DrawCommandType::InstanceBuffer) == 1, "instance stream bound once");
+	Check(context.GetCount(DrawCommandType::DrawIndexed) == 3, "skinned subsets drawn plainly");
+	Check(context.GetCount(DrawCommandType::BonePalette) == 1, "shared palette uploaded once");
+	for (const RecordedCommand& command : context.GetCommands())
+	{
+		if (command.Type == DrawCommandType::DrawIndexedInstanced)
+		{
+			Check(command.Args[0] == 36 && command.Args[1] == 50 && command.Args[2] == 6 && command.Args[3] == 3 && command.Args[4] == 10,
+				"instanced draw arguments");
+		}
+		if (command.Type == DrawCommandType::InstanceBuffer)
+			Check(command.Args[0] == 112, "instance stride");
+	}
+}
+
+static void TestIdExpiry()
+{
+	RenderQueue queue;
+	int material = 0;
+	// A frame with many textures, then only one for a while
+	queue.Clear();
+	for (UINT i = 0; i < 1000; ++i)
+		queue.Add(MakePacket(0, i), MakeObjectData(i), RenderPass::Opaque, &material, XMFLOAT3(0.0f, 0.0f, 1.0f));
+	UINT peak = queue.GetIdCount();
+	for (UINT frame = 0; frame < RenderQueue::IdLifetime * 2; ++frame)
+	{
+		queue.Clear();
+		queue.Add(MakePacket(0, 0), MakeObjectData(0), RenderPass::Opaque, &material, XMFLOAT3(0.0f, 0.0f, 1.0f));
+	}
+	Check(peak >= 1000, "one id per texture");
+	// Texture, material and shader pair of the packet still in use
+	Check(queue.GetIdCount() == 3, "ids of unused objects expire");
+
+	// New objects only add their own ids
+	queue.Clear();
+	for (UINT i = 0; i < 4; ++i)
+		queue.Add(MakePacket(0, 2000 + i), MakeObjectData(i), RenderPass::Opaque, &material, XMFLOAT3(0.0f, 0.0f, 1.0f));
+	Check(queue.GetIdCount() == 3 + 4, "released ids are not counted again");
+}
+
+static void Benchmark()
+{
+	struct Scene { const char* Name; UINT Objects; UINT Shaders; UINT Textures; } scenes[] =
+	{
+		{ "small, 100", 100, 4, 8 },
+		{ "city, 2000", 2000, 8, 64 },
+		{ "crowd, 10000", 10000, 16, 256 }
+	};
+	const int Frames = 100;
+
+	printf("%-14s %10s %10s %10s %10s %10s\n", "scene", "packets", "binds", "sorted", "sort ms", "exec ms");
+	for (auto& scene : scenes)
+	{
+		RenderQueue queue;
+		RecordingDrawContext context(false);
+		int materials[16];
+		UINT unsortedChanges = 0, sortedChanges = 0;
+		double sortMs = 0.0, executeMs = 0.0;
+		for (int frame = 0; frame < Frames; ++frame)
+		{
+			queue.Clear();
+			queue.SetView(XMFLOAT3(0.0f, 2.0f, -10.0f));
+			for (UINT i = 0; i < scene.Objects; ++i)
+			{
+				// Scattered like a scene graph walk, not grouped by state
+				UINT hash = i * 2654435761u;
+				DrawPacket packet = MakePacket(hash % scene.Shaders, (hash >> 8) % scene.Textures);
+				XMFLOAT3 center((float)(i % 100), 0.0f, (float)(i / 100));
+				queue.Add(packet, MakeObjectData(i), RenderPass::Opaque, &materials[(hash >> 16) % 16], center);
+			}
+			if (frame == 0)
+			{
+				// Submission order, before sorting
+				queue.Execute(context);
+				unsortedChanges = queue.GetStats().StateChanges;
+			}
+			queue.Sort();
+			queue.Execute(context);
+			sortedChanges = queue.GetStats().StateChanges;
+			sortMs += queue.GetStats().SortMs;
+			executeMs += queue.GetStats().ExecuteMs;
+		}
+		printf("%-14s %10u %10u %10u %10.3f %10.3f\n", scene.Name, scene.Objects, unsortedChanges, sortedChanges,
+			sortMs / Frames, executeMs / Frames);
+		Check(sortedChanges < unsortedChanges, "sorting reduces binds");
+	}
+}
+
+int main()
+{
+	TestPassAndDepthOrder();
+	TestStateFiltering();
+	TestInstancedAndSkinned();
+	TestIdExpiry();
+	Benchmark();
+
+	if (g_failures)
+		return 1;
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,425 @@
+// Build, refit and query times of SceneBvh on a synthetic scene of 50000 boxes, against brute
+// force loops over every box. The frustum, sphere, raycast and nearest queries must find what
+// the loops find after the build, after moving part of the items and refitting, and after
+// removing and inserting items, which rebuilds.
+
+#include "pch.h"
+#include "Components/SceneBvh.h"
+#include "Common/MathHelper.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace DirectX;
+using namespace DXFramework;
+using namespace DX;
+
+static int g_failures = 0;
+
+static void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		++g_failures;
+	}
+}
+
+// Boxes of the scene by item id, as the test inserted them
+struct Scene
+{
+	std::vector<BoundingBox> Bounds;
+	std::vector<bool> Alive;
+};
+
+static BoundingBox RandomBox()
+{
+	return BoundingBox(XMFLOAT3(MathHelper::RandF(-500.0f, 500.0f), MathHelper::RandF(0.0f, 100.0f), MathHelper::RandF(-500.0f, 500.0f)),
+		XMFLOAT3(MathHelper::RandF(0.5f, 3.0f), MathHelper::RandF(0.5f, 3.0f), MathHelper::RandF(0.5f, 3.0f)));
+}
+
+static void SetBox(Scene& scene, UINT id, const BoundingBox& box)
+{
+	if (id >= scene.Bounds.size())
+	{
+		scene.Bounds.resize(id + 1);
+		scene.Alive.resize(id + 1, false);
+	}
+	scene.Bounds[id] = box;
+	scene.Alive[id] = true;
+}
+
+static float DistanceSq(const XMFLOAT3& p, const BoundingBox& box)
+{
+	const float* c = &box.Center.x;
+	const float* e = &box.Extents.x;
+	const float* q = &p.x;
+	float distSq = 0.0f;
+	for (UINT k = 0; k < 3; ++k)
+	{
+		float d = MathHelper::Max(MathHelper::Max(c[k] - e[k] - q[k], q[k] - c[k] - e[k]), 0.0f);
+		distSq += d * d;
+	}
+	return distSq;
+}
+
+// Inside unless behind a plane. margin is how far the box is from crossing the nearest plane,
+// so rounding at a plane is not taken for a miss.
+static bool InFrustum(const BoundingBox& box, const XMFLOAT4 planes[6], float& margin)
+{
+	bool inside = true;
+	margin = MathHelper::Infinity;
+	for (UINT p = 0; p < 6; ++p)
+	{
+		if (box.Intersects(XMLoadFloat4(&planes[p])) == BACK)
+			inside = false;
+		float d = planes[p].x * box.Center.x + planes[p].y * box.Center.y + planes[p].z * box.Center.z + planes[p].w;
+		float r = fabsf(planes[p].x) * box.Extents.x + fabsf(planes[p].y) * box.Extents.y + fabsf(planes[p].z) * box.Extents.z;
+		margin = MathHelper::Min(margin, MathHelper::Min(fabsf(d + r), fabsf(d - r)));
+	}
+	return inside;
+}
+
+static bool Unique(std::vector<UINT> ids)
+{
+	std::sort(ids.begin(), ids.end());
+	return std::adjacent_find(ids.begin(), ids.end()) == ids.end();
+}
+
+struct QueryTimes
+{
+	double BvhMs;
+	double BruteMs;
+};
+
+static double Since(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static QueryTimes CheckFrustum(SceneBvh& bvh, const Scene& scene, const XMFLOAT4 planes[6], const char* stage)
+{
+	QueryTimes times = {};
+	std::vector<UINT> results;
+	auto start = std::chrono::high_resolution_clock::now();
+	bvh.QueryFrustum(planes, results);
+	times.BvhMs = Since(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<UINT8> expected(scene.Bounds.size(), 0);
+	std::vector<float> margins(scene.Bounds.size(), MathHelper::Infinity);
+	for (UINT id = 0; id < scene.Bounds.size(); ++id)
+	{
+		if (scene.Alive[id])
+			expected[id] = InFrustum(scene.Bounds[id], planes, margins[id]);
+	}
+	times.BruteMs = Since(start);
+
+	std::vector<UINT8> found(scene.Bounds.size(), 0);
+	bool alive = true;
+	for (UINT id : results)
+	{
+		alive = alive && id < scene.Bounds.size() && scene.Alive[id];
+		if (id < found.size())
+			found[id] = 1;
+	}
+	bool same = true;
+	for (UINT id = 0; id < scene.Bounds.size(); ++id)
+		same = same && (found[id] == expected[id] || margins[id] < 1e-3f);
+
+	char what[128];
+	sprintf(what, "%s: frustum query finds the boxes in the frustum", stage);
+	Check(same && alive, what);
+	sprintf(what, "%s: frustum query lists each item once", stage);
+	Check(Unique(results), what);
+	sprintf(what, "%s: the frustum sees part of the scene", stage);
+	Check(!results.empty() && results.size() < scene.Bounds.size() / 2, what);
+	return times;
+}
+
+static QueryTimes CheckSpheres(SceneBvh& bvh, const Scene& scene, const std::vector<BoundingSphere>& spheres, const char* stage)
+{
+	QueryTimes times = {};
+	bool same = true;
+	for (auto& sphere : spheres)
+	{
+		std::vector<UINT> results;
+		auto start = std::chrono::high_resolution_clock::now();
+		bvh.QuerySphere(sphere, results);
+		times.BvhMs += Since(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		std::vector<UINT> expected;
+		for (UINT id = 0; id < scene.Bounds.size(); ++id)
+		{
+			if (scene.Alive[id] && DistanceSq(sphere.Center, scene.Bounds[id]) <= sphere.Radius * sphere.Radius)
+				expected.push_back(id);
+		}
+		times.BruteMs += Since(start);
+
+		std::sort(results.begin(), results.end());
+		same = same && results == expected;
+	}
+	char what[128];
+	sprintf(what, "%s: sphere queries find the boxes within the radius", stage);
+	Check(same, what);
+	return times;
+}
+
+// Slab test of a box, the reference for the raycast.
+static bool RayBox(const XMFLOAT3& o, const XMFLOAT3& d, const BoundingBox& box, float maxDist, float& t)
+{
+	const float* po = &o.x;
+	const float* pd = &d.x;
+	const float* c = &box.Center.x;
+	const float* e = &box.Extents.x;
+	float t0 = 0.0f, t1 = maxDist;
+	for (UINT k = 0; k < 3; ++k)
+	{
+		if (pd[k] == 0.0f)
+		{
+			if (po[k] < c[k] - e[k] || po[k] > c[k] + e[k])
+				return false;
+			continue;
+		}
+		float ta = (c[k] - e[k] - po[k]) / pd[k];
+		float tb = (c[k] + e[k] - po[k]) / pd[k];
+		if (ta > tb)
+			std::swap(ta, tb);
+		t0 = MathHelper::Max(t0, ta);
+		t1 = MathHelper::Min(t1, tb);
+		if (t0 > t1)
+			return false;
+	}
+	t = t0;
+	return true;
+}
+
+static QueryTimes CheckRays(SceneBvh& bvh, const Scene& scene, const std::vector<std::pair<XMFLOAT3, XMFLOAT3>>& rays,
+	float maxDist, const char* stage)
+{
+	QueryTimes times = {};
+	bool same = true;
+	UINT hits = 0;
+	for (auto& ray : rays)
+	{
+		UINT id = 0;
+		float dist = 0.0f;
+		auto start = std::chrono::high_resolution_clock::now();
+		bool hit = bvh.Raycast(XMLoadFloat3(&ray.first), XMLoadFloat3(&ray.second), maxDist, id, dist);
+		times.BvhMs += Since(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		bool expectedHit = false;
+		float best = maxDist;
+		for (UINT i = 0; i < scene.Bounds.size(); ++i)
+		{
+			float t;
+			if (scene.Alive[i] && RayBox(ray.first, ray.second, scene.Bounds[i], best, t))
+			{
+				best = t;
+				expectedHit = true;
+			}
+		}
+		times.BruteMs += Since(start);
+
+		hits += hit;
+		// Ties between boxes may pick either, so compare distances; the item must be hit there
+		float t;
+		same = same && hit == expectedHit;
+		if (hit && expectedHit)
+		{
+			same = same && fabsf(dist - best) <= 1e-3f * MathHelper::Max(best, 1.0f) && scene.Alive[id] &&
+				RayBox(ray.first, ray.second, scene.Bounds[id], maxDist, t) && fabsf(t - dist) <= 1e-3f * MathHelper::Max(dist, 1.0f);
+		}
+	}
+	char what[128];
+	sprintf(what, "%s: raycasts hit the closest box", stage);
+	Check(same, what);
+	sprintf(what, "%s: some rays hit and some miss", stage);
+	Check(hits > 0 && hits < rays.size(), what);
+	return times;
+}
+
+static QueryTimes CheckNearest(SceneBvh& bvh, const Scene& scene, const std::vector<XMFLOAT3>& points, UINT k, const char* stage)
+{
+	QueryTimes times = {};
+	bool same = true;
+	bool ordered = true;
+	for (auto& point : points)
+	{
+		std::vector<UINT> results;
+		auto start = std::chrono::high_resolution_clock::now();
+		bvh.QueryNearest(XMLoadFloat3(&point), k, results);
+		times.BvhMs += Since(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		std::vector<float> expected;
+		for (UINT id = 0; id < scene.Bounds.size(); ++id)
+		{
+			if (scene.Alive[id])
+				expected.push_back(DistanceSq(point, scene.Bounds[id]));
+		}
+		std::partial_sort(expected.begin(), expected.begin() + k, expected.end());
+		times.BruteMs += Since(start);
+
+		// Ties may swap items of the same distance, the distances must be the k smallest
+		same = same && results.size() == k && Unique(results);
+		for (UINT i = 0; i < results.size() && same; ++i)
+		{
+			float distSq = DistanceSq(point, scene.Bounds[results[i]]);
+			same = scene.Alive[results[i]] && distSq == expected[i];
+			ordered = ordered && (i == 0 || distSq >= DistanceSq(point, scene.Bounds[results[i - 1]]));
+		}
+	}
+	char what[128];
+	sprintf(what, "%s: nearest queries find the k closest boxes", stage);
+	Check(same, what);
+	sprintf(what, "%s: nearest first", stage);
+	Check(ordered, what);
+	return times;
+}
+
+static void PrintTimes(const char* query, const QueryTimes& times, UINT count)
+{
+	printf("  %-10s %10.4f %10.4f %10.1f\n", query, times.BvhMs / count, times.BruteMs / count, times.BruteMs / MathHelper::Max(times.BvhMs, 1e-6));
+}
+
+static void CheckQueries(SceneBvh& bvh, const Scene& scene, const XMFLOAT4 planes[6], const char* stage)
+{
+	std::vector<BoundingSphere> spheres;
+	std::vector<std::pair<XMFLOAT3, XMFLOAT3>> rays;
+	std::vector<XMFLOAT3> points;
+	for (UINT i = 0; i < 100; ++i)
+	{
+		spheres.push_back(BoundingSphere(XMFLOAT3(MathHelper::RandF(-500.0f, 500.0f), MathHelper::RandF(0.0f, 100.0f),
+			MathHelper::RandF(-500.0f, 500.0f)), MathHelper::RandF(1.0f, 40.0f)));
+		XMFLOAT3 origin(MathHelper::RandF(-500.0f, 500.0f), MathHelper::RandF(0.0f, 100.0f), MathHelper::RandF(-500.0f, 500.0f));
+		XMFLOAT3 direction;
+		XMStoreFloat3(&direction, MathHelper::RandUnitVec3());
+		// Some rays along an axis, where the slab test meets infinite inverse directions
+		if (i % 10 == 0)
+			direction = XMFLOAT3(0.0f, 0.0f, i % 20 == 0 ? 1.0f : -1.0f);
+		rays.push_back(std::make_pair(origin, direction));
+		points.push_back(XMFLOAT3(MathHelper::RandF(-600.0f, 600.0f), MathHelper::RandF(-20.0f, 120.0f), MathHelper::RandF(-600.0f, 600.0f)));
+	}
+
+	printf("%s, %u items, %u nodes\n", stage, bvh.GetItemCount(), bvh.GetStats().NodeCount);
+	printf("  %-10s %10s %10s %10s\n", "query", "bvh ms", "brute ms", "speedup");
+	PrintTimes("frustum", CheckFrustum(bvh, scene, planes, stage), 1);
+	PrintTimes("sphere", CheckSpheres(bvh, scene, spheres, stage), (UINT)spheres.size());
+	PrintTimes("raycast", CheckRays(bvh, scene, rays, 200.0f, stage), (UINT)rays.size());
+	PrintTimes("nearest 8", CheckNearest(bvh, scene, points, 8, stage), (UINT)points.size());
+}
+
+static void TestEmpty()
+{
+	SceneBvh bvh;
+	bvh.Refresh();
+	XMFLOAT4 planes[6];
+	for (UINT p = 0; p < 6; ++p)
+		planes[p] = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+	std::vector<UINT> results;
+	bvh.QueryFrustum(planes, results);
+	bvh.QuerySphere(BoundingSphere(XMFLOAT3(0.0f, 0.0f, 0.0f), 10.0f), results);
+	bvh.QueryNearest(XMVectorZero(), 4, results);
+	UINT id;
+	float dist;
+	bool hit = bvh.Raycast(XMVectorZero(), XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), 100.0f, id, dist);
+	Check(results.empty() && !hit, "empty tree: no results");
+}
+
+static void TestOwners()
+{
+	int called = 0;
+	int other = 0;
+	{
+		SceneBvh bvh;
+		bvh.AddOwner(&called, [&called]() { ++called; });
+		bvh.AddOwner(&other, [&other]() { ++other; });
+		bvh.RemoveOwner(&other);
+	}
+	Check(called == 1 && other == 0, "destructor calls the callbacks of the attached owners only");
+}
+
+int main()
+{
+	const UINT itemCount = 50000;
+	srand(11);
+	TestEmpty();
+	TestOwners();
+
+	XMFLOAT4 planes[6];
+	XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 50.0f, -450.0f, 1.0f), XMVectorSet(50.0f, 30.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f * MathHelper::Pi, 16.0f / 9.0f, 1.0f, 600.0f);
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, view * proj);
+	ExtractFrustumPlanes(planes, viewProj);
+
+	SceneBvh bvh;
+	Scene scene;
+	int owner = 0;
+	for (UINT i = 0; i < itemCount; ++i)
+	{
+		BoundingBox box = RandomBox();
+		UINT id = bvh.Insert(box, SceneBvhItem(&owner, 0, i));
+		SetBox(scene, id, box);
+	}
+	bvh.Refresh();
+	Check(bvh.GetItemCount() == itemCount, "build: item count");
+	Check(bvh.GetStats().NodeCount > 0 && bvh.GetStats().NodeCount < 2 * itemCount, "build: fewer nodes than twice the items");
+	Check(bvh.GetItem(123).Index == 123 && bvh.GetItem(123).Owner == &owner, "build: items kept");
+	printf("build %.3f ms\n", bvh.GetStats().BuildMs);
+	CheckQueries(bvh, scene, planes, "build");
+
+	// Move a tenth of the items, some far across the scene
+	UINT moved = 0;
+	for (UINT id = 0; id < itemCount; id += 10)
+	{
+		BoundingBox box = scene.Bounds[id];
+		if (id % 100 == 0)
+			box = RandomBox();
+		else
+			box.Center = XMFLOAT3(box.Center.x + MathHelper::RandF(-5.0f, 5.0f), box.Center.y, box.Center.z + MathHelper::RandF(-5.0f, 5.0f));
+		bvh.Update(id, box);
+		// A second update of the same item in the frame counts once
+		bvh.Update(id, box);
+		SetBox(scene, id, box);
+		++moved;
+	}
+	double buildMs = bvh.GetStats().BuildMs;
+	bvh.Refresh();
+	Check(bvh.GetStats().RefitItems == moved, "refit: every moved item refitted once");
+	Check(bvh.GetStats().BuildMs == buildMs, "refit: no rebuild");
+	printf("refit of %u items %.3f ms\n", moved, bvh.GetStats().RefitMs);
+	CheckQueries(bvh, scene, planes, "refit");
+
+	// Remove a fifth of the items and insert new ones, which reuse their ids
+	UINT removed = 0;
+	for (UINT id = 3; id < itemCount; id += 5)
+	{
+		bvh.Remove(id);
+		scene.Alive[id] = false;
+		++removed;
+	}
+	bool reused = true;
+	for (UINT i = 0; i < removed / 2; ++i)
+	{
+		BoundingBox box = RandomBox();
+		UINT id = bvh.Insert(box, SceneBvhItem(&owner, 1, i));
+		reused = reused && id < itemCount && !scene.Alive[id];
+		SetBox(scene, id, box);
+	}
+	Check(reused, "insert: ids of removed items reused");
+	bvh.Refresh();
+	Check(bvh.GetItemCount() == itemCount - removed + removed / 2, "rebuild: item count");
+	printf("rebuild %.3f ms\n", bvh.GetStats().BuildMs);
+	CheckQueries(bvh, scene, planes, "rebuild");
+
+	if (g_failures)
+		return 1;
+	printf("All checks passed\n");
+	return 0;
+}
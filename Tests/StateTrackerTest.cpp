@@ -0,0 +1,174 @@
+// Checks of StateTracker on the null backend. They cover the filtering of repeated binds, the
+// counts per frame and per component, plain and ranged constant buffers, the unbinding of
+// shader resource views whose resource becomes a render target or depth view and Invalidate.
+
+#include "pch.h"
+#include "Common/StateTracker.h"
+#include <cstdint>
+#include <cstdio>
+
+using namespace DX;
+
+static int g_failures = 0;
+
+static void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		++g_failures;
+	}
+}
+
+// Bind points are only compared by address, so any distinct non null address will do
+template<typename T>
+static T* Fake(uint32_t kind, uint32_t index)
+{
+	return reinterpret_cast<T*>((uintptr_t)(kind << 20 | (index + 1) << 4));
+}
+
+static void TestFiltering()
+{
+	StateTracker tracker;
+	tracker.BeginFrame();
+	ID3D11VertexShader* vs = Fake<ID3D11VertexShader>(1, 0);
+	ID3D11Buffer* vb = Fake<ID3D11Buffer>(2, 0);
+	uint32_t stride = 32, offset = 0;
+	for (int i = 0; i < 10; ++i)
+	{
+		tracker.VSSetShader(vs);
+		tracker.IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+		tracker.IASetPrimitiveTopology(4);
+		tracker.DrawIndexed(36, 0, 0);
+	}
+	const StateCounts& counts = tracker.GetFrameCounts();
+	Check(counts.Requested[(int)StateCategory::Shader] == 10, "every shader bind is counted");
+	Check(counts.Issued[(int)StateCategory::Shader] == 1, "a repeated shader is filtered");
+	Check(counts.GetFiltered(StateCategory::VertexBuffer) == 9, "a repeated vertex buffer is filtered");
+	Check(counts.Issued[(int)StateCategory::Draw] == 10, "draws are never filtered");
+
+	// The same buffer with another stride is a change
+	stride = 16;
+	tracker.IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+	Check(counts.Issued[(int)StateCategory::VertexBuffer] == 2, "stride is part of the binding");
+
+	// Null is a binding of its own
+	tracker.VSSetShader(nullptr);
+	tracker.VSSetShader(nullptr);
+	Check(counts.Issued[(int)StateCategory::Shader] == 2, "null shader issued once");
+
+	tracker.BeginFrame();
+	tracker.VSSetShader(nullptr);
+	Check(tracker.GetFrameCounts().Requested[(int)StateCategory::Shader] == 1, "BeginFrame resets the counts");
+	Check(tracker.GetFrameCounts().Issued[(int)StateCategory::Shader] == 0, "BeginFrame keeps the bindings");
+}
+
+static void TestComponents()
+{
+	StateTracker tracker;
+	tracker.BeginFrame();
+	ID3D11ShaderResourceView* views[3] = { Fake<ID3D11ShaderResourceView>(1, 0), Fake<ID3D11ShaderResourceView>(1, 1), Fake<ID3D11ShaderResourceView>(1, 2) };
+	tracker.SetComponent("A");
+	tracker.SetShaderResources(ShaderStage::PS, 2, 3, views);
+	tracker.SetComponent("B");
+	tracker.SetShaderResources(ShaderStage::PS, 2, 3, views);
+	views[1] = Fake<ID3D11ShaderResourceView>(1, 7);
+	tracker.SetShaderResources(ShaderStage::PS, 2, 3, views);
+	tracker.SetComponent(nullptr);
+	tracker.SetShaderResources(ShaderStage::PS, 2, 3, views);
+
+	const std::map<std::string, StateCounts>& components = tracker.GetComponentCounts();
+	Check(components.size() == 2, "one entry per component");
+	Check(components.at("A").Issued[(int)StateCategory::ShaderResource] == 1, "first bind issued for A");
+	Check(components.at("B").Requested[(int)StateCategory::ShaderResource] == 2, "requests counted for B");
+	Check(components.at("B").Issued[(int)StateCategory::ShaderResource] == 1, "only the changed bind issued for B");
+	Check(tracker.GetFrameCounts().Requested[(int)StateCategory::ShaderResource] == 4, "frame counts every component");
+}
+
+static void TestConstantBuffers()
+{
+	StateTracker tracker;
+	tracker.BeginFrame();
+	ID3D11Buffer* ring = Fake<ID3D11Buffer>(1, 0);
+	ID3D11Buffer* buffers[2] = { ring, ring };
+	uint32_t first[2] = { 0, 16 }, count[2] = { 16, 16 };
+	tracker.SetConstantBuffers1(ShaderStage::VS, 0, 2, buffers, first, count);
+	tracker.SetConstantBuffers1(ShaderStage::VS, 0, 2, buffers, first, count);
+	Check(tracker.GetFrameCounts().Issued[(int)StateCategory::ConstantBuffer] == 1, "the same ranges are filtered");
+
+	// Another range of the same buffer, then the whole buffer
+	first[1] = 32;
+	tracker.SetConstantBuffers1(ShaderStage::VS, 0, 2, buffers, first, count);
+	tracker.SetConstantBuffers(ShaderStage::VS, 1, 1, &ring);
+	tracker.SetConstantBuffers(ShaderStage::VS, 1, 1, &ring);
+	Check(tracker.GetFrameCounts().Issued[(int)StateCategory::ConstantBuffer] == 3, "range and whole buffer differ");
+	// Stages are tracked apart
+	tracker.SetConstantBuffers(ShaderStage::PS, 1, 1, &ring);
+	Check(tracker.GetFrameCounts().Issued[(int)StateCategory::ConstantBuffer] == 4, "stages are tracked apart");
+}
+
+static void TestHazards()
+{
+	StateTracker tracker;
+	tracker.BeginFrame();
+	int shadowMap = 0, sceneColor = 0;
+	ID3D11ShaderResourceView* shadowView = Fake<ID3D11ShaderResourceView>(1, 0);
+	ID3D11ShaderResourceView* colorView = Fake<ID3D11ShaderResourceView>(1, 1);
+	ID3D11DepthStencilView* shadowDepth = Fake<ID3D11DepthStencilView>(2, 0);
+	ID3D11RenderTargetView* colorTarget = Fake<ID3D11RenderTargetView>(3, 0);
+	tracker.SetViewResource(shadowView, &shadowMap);
+	tracker.SetViewResource(shadowDepth, &shadowMap);
+	tracker.SetViewResource(colorView, &sceneColor);
+	tracker.SetViewResource(colorTarget, &sceneColor);
+
+	// The shadow map is sampled by the scene pass, then rendered again
+	ID3D11ShaderResourceView* views[2] = { shadowView, colorView };
+	tracker.SetShaderResources(ShaderStage::PS, 0, 2, views);
+	tracker.SetShaderResources(ShaderStage::VS, 3, 1, views);
+	tracker.OMSetRenderTargets(0, nullptr, shadowDepth);
+	Check(tracker.GetFrameCounts().HazardUnbinds == 2, "views of the depth target are unbound in every stage");
+
+	// The unbound slot must be bound again, the other one is still there
+	tracker.SetShaderResources(ShaderStage::PS, 0, 2, views);
+	Check(tracker.GetFrameCounts().Issued[(int)StateCategory::ShaderResource] == 2 + 1 + 2, "unbound view is bound again");
+
+	tracker.OMSetRenderTargets(1, &colorTarget, nullptr);
+	Check(tracker.GetFrameCounts().HazardUnbinds == 2 + 1, "only the view of the render target is unbound");
+	tracker.OMSetRenderTargets(1, &colorTarget, nullptr);
+	Check(tracker.GetFrameCounts().Issued[(int)StateCategory::RenderTarget] == 2, "repeated render targets are filtered");
+
+	// Views never described are their own resource and do not alias
+	ID3D11RenderTargetView* otherTarget = Fake<ID3D11RenderTargetView>(3, 1);
+	tracker.SetShaderResources(ShaderStage::PS, 0, 2, views);
+	tracker.OMSetRenderTargets(1, &otherTarget, nullptr);
+	Check(tracker.GetFrameCounts().HazardUnbinds == 3, "unrelated targets unbind nothing");
+}
+
+static void TestInvalidate()
+{
+	StateTracker tracker;
+	tracker.BeginFrame();
+	ID3D11RasterizerState* state = Fake<ID3D11RasterizerState>(1, 0);
+	tracker.RSSetState(state);
+	tracker.RSSetState(state);
+	tracker.Invalidate();
+	tracker.RSSetState(state);
+	tracker.OMSetBlendState(nullptr, nullptr, 0xffffffff);
+	tracker.OMSetBlendState(nullptr, nullptr, 0xffffffff);
+	Check(tracker.GetFrameCounts().Issued[(int)StateCategory::Rasterizer] == 2, "bind issued again after Invalidate");
+	Check(tracker.GetFrameCounts().Issued[(int)StateCategory::Blend] == 1, "null blend state issued once");
+}
+
+int main()
+{
+	TestFiltering();
+	TestComponents();
+	TestConstantBuffers();
+	TestHazards();
+	TestInvalidate();
+
+	if (g_failures)
+		return 1;
+	printf("All checks passed\n");
+	return 0;
+}
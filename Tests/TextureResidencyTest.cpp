@@ -0,0 +1,243 @@
+// Checks of the TextureResidency policy on synthetic mip layouts. They cover the start from the
+// mip tail, the refinement one level per load up to the on screen size, the order and limit of
+// loads, the eviction of unused textures to their tail least recently used first, the tails
+// kept under any budget, the trim of textures holding more detail than they need, failed
+// loads and the byte counts.
+
+#include "pch.h"
+#include "Common/TextureResidency.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace DX;
+
+static int g_failures = 0;
+
+static void Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		printf("FAILED: %s\n", what);
+		++g_failures;
+	}
+}
+
+// Square RGBA8 texture with a full mip chain, the data starting after a 148 byte header
+static DDSMipLayout MakeLayout(uint32_t size)
+{
+	DDSMipLayout layout;
+	layout.Width = layout.Height = size;
+	layout.Depth = 1;
+	layout.ArraySize = 1;
+	layout.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	layout.IsCubeMap = false;
+	layout.MipCount = 0;
+	size_t offset = 148;
+	for (uint32_t s = size; ; s /= 2)
+	{
+		DDSMipInfo mip;
+		mip.Offset = offset;
+		mip.Width = mip.Height = s;
+		mip.Depth = 1;
+		mip.RowPitch = s * 4;
+		mip.Size = mip.RowPitch * s;
+		offset += mip.Size;
+		layout.Mips.push_back(mip);
+		++layout.MipCount;
+		if (s == 1)
+			break;
+	}
+	return layout;
+}
+
+// Register a texture whose tail is loaded, the way TextureMgr starts streamed textures
+static UINT RegisterLoaded(TextureResidency& residency, uint32_t size)
+{
+	UINT id = residency.Register(MakeLayout(size));
+	residency.OnLoaded(id, residency.GetTailMip(id));
+	return id;
+}
+
+// Update, then report every requested load as finished
+static void RunFrame(TextureResidency& residency, std::vector<ResidencyRequest>& requests)
+{
+	residency.Update(requests);
+	for (auto& request : requests)
+		residency.OnLoaded(request.Id, request.TopMip);
+}
+
+static void TestRefinement()
+{
+	// 1024 texels, the tail starts at mip 4 (64 texels)
+	TextureResidency residency;
+	UINT id = RegisterLoaded(residency, 1024);
+	UINT idle = RegisterLoaded(residency, 1024);
+	const DDSMipLayout layout = MakeLayout(1024);
+	Check(residency.GetTailMip(id) == 4, "the tail holds the mips no larger than TailSize");
+	Check(residency.GetStats().ResidentBytes == 2 * layout.GetBytes(4), "the tails are resident");
+
+	// 300 pixels on screen want the 512 texel mip, reached one level per load
+	std::vector<ResidencyRequest> requests;
+	bool oneLevel = true;
+	for (UINT expected = 3; expected >= 1; --expected)
+	{
+		residency.NoteUse(id, 300.0f);
+		RunFrame(residency, requests);
+		oneLevel = oneLevel && requests.size() == 1 && requests[0].Id == id && requests[0].TopMip == expected;
+	}
+	Check(oneLevel, "each frame loads the next finer mip");
+	Check(residency.GetResidentMip(id) == 1 && residency.GetWantedMip(id) == 1, "refined up to the screen size");
+	residency.NoteUse(id, 300.0f);
+	RunFrame(residency, requests);
+	Check(requests.empty(), "nothing more is loaded once the screen size is covered");
+	Check(residency.GetResidentMip(idle) == 4, "unused textures keep their tail");
+	Check(residency.GetStats().ResidentBytes == layout.GetBytes(1) + layout.GetBytes(4), "resident bytes follow the loads");
+
+	// Closer than its radius, a texture wants every mip
+	residency.NoteUse(idle, TextureResidency::ProjectedSize(2.0f, 1.0f, 1.0f, 1000.0f));
+	residency.Update(requests);
+	Check(residency.GetWantedMip(idle) == 0, "a viewer inside the bounds wants the top mip");
+	Check(fabsf(TextureResidency::ProjectedSize(1.0f, 10.0f, 2.0f, 1000.0f) - 200.0f) < 0.01f, "projected size in pixels");
+}
+
+static void TestLoadOrder()
+{
+	ResidencySettings settings;
+	settings.MaxLoadsPerFrame = 1;
+	TextureResidency residency(settings);
+	UINT small = RegisterLoaded(residency, 1024);
+	UINT large = RegisterLoaded(residency, 1024);
+	UINT missing = residency.Register(MakeLayout(1024));
+
+	// Missing textures first, then the largest on screen, the rest waits
+	std::vector<ResidencyRequest> requests;
+	residency.NoteUse(small, 100.0f);
+	residency.NoteUse(large, 900.0f);
+	residency.NoteUse(missing, 100.0f);
+	RunFrame(residency, requests);
+	Check(requests.size() == 1 && requests[0].Id == missing && requests[0].TopMip == 4, "a missing texture loads its tail first");
+	Check(residency.GetStats().Deferred == 2, "loads over the limit are deferred");
+
+	residency.NoteUse(small, 100.0f);
+	residency.NoteUse(large, 900.0f);
+	RunFrame(residency, requests);
+	Check(requests.size() == 1 && requests[0].Id == large, "then the largest on screen");
+
+	// A failed load is requested again
+	residency.NoteUse(small, 100.0f);
+	residency.Update(requests);
+	Check(requests.size() == 1 && requests[0].Id == small && requests[0].TopMip == 3, "load requested");
+	residency.OnLoaded(small, TextureResidency::NotResident);
+	Check(residency.GetResidentMip(small) == 4, "a failed load keeps the resident mips");
+	residency.NoteUse(small, 100.0f);
+	residency.Update(requests);
+	Check(requests.size() == 1 && requests[0].Id == small && requests[0].TopMip == 3, "a failed load is retried");
+}
+
+static void TestEviction()
+{
+	// 256 texels, the tail starts at mip 2. Room for the three tails and mip 1 of two of them.
+	const DDSMipLayout layout = MakeLayout(256);
+	const UINT64 refined = layout.GetBytes(1) - layout.GetBytes(2);
+	ResidencySettings settings;
+	settings.BudgetBytes = 3 * layout.GetBytes(2) + 2 * refined;
+	TextureResidency residency(settings);
+	UINT a = RegisterLoaded(residency, 256);
+	UINT b = RegisterLoaded(residency, 256);
+	UINT c = RegisterLoaded(residency, 256);
+	Check(residency.GetStats().TailBytes == 3 * layout.GetBytes(2), "the tails are counted");
+
+	// a is refined, then b. Then c needs mip 1.
+	std::vector<ResidencyRequest> requests;
+	residency.NoteUse(a, 100.0f);
+	RunFrame(residency, requests);
+	residency.NoteUse(b, 100.0f);
+	RunFrame(residency, requests);
+	Check(residency.GetResidentMip(a) == 1 && residency.GetResidentMip(b) == 1, "a and b refined");
+	residency.NoteUse(c, 100.0f);
+	residency.Update(requests);
+	Check(requests.size() == 2, "one eviction and one load");
+	Check(requests[0].Id == a && requests[0].TopMip == 2, "the least recently used texture is evicted to its tail first");
+	Check(requests[1].Id == c && requests[1].TopMip == 1, "then the load proceeds");
+	Check(residency.GetStats().Evictions == 1 && residency.GetStats().CommittedBytes <= settings.BudgetBytes, "the budget holds");
+	Check(residency.GetResidentMip(a) == 1 && residency.GetResidentMip(b) == 1, "evicted mips stay until the tail is reloaded");
+	residency.OnLoaded(a, 2);
+	residency.OnLoaded(c, 1);
+	Check(residency.GetResidentMip(a) == 2, "the evicted texture keeps its tail");
+	Check(residency.GetStats().ResidentBytes == settings.BudgetBytes, "resident once the loads finish");
+
+	// Textures in use are never evicted, a load that finds no room waits
+	residency.NoteUse(a, 100.0f);
+	residency.NoteUse(b, 100.0f);
+	residency.NoteUse(c, 100.0f);
+	RunFrame(residency, requests);
+	Check(requests.empty() && residency.GetStats().Deferred == 1, "a load over the budget is deferred");
+	Check(residency.GetResidentMip(b) == 1 && residency.GetResidentMip(c) == 1, "textures in use stay resident");
+}
+
+static void TestTailFloor()
+{
+	// A budget below the tails: nothing is refined and no tail is ever evicted
+	const DDSMipLayout layout = MakeLayout(256);
+	ResidencySettings settings;
+	settings.BudgetBytes = 2 * layout.GetBytes(2);
+	TextureResidency residency(settings);
+	UINT a = RegisterLoaded(residency, 256);
+	UINT b = RegisterLoaded(residency, 256);
+	UINT c = RegisterLoaded(residency, 256);
+
+	std::vector<ResidencyRequest> requests;
+	bool resident = true;
+	UINT evictions = 0;
+	for (UINT frame = 0; frame < 4; ++frame)
+	{
+		residency.NoteUse(frame % 2 ? a : b, 200.0f);
+		RunFrame(residency, requests);
+		evictions += residency.GetStats().Evictions;
+		resident = resident && requests.empty() && residency.GetResidentMip(a) == 2 && residency.GetResidentMip(b) == 2 && residency.GetResidentMip(c) == 2;
+	}
+	Check(resident && evictions == 0, "tails stay resident over the budget");
+	Check(residency.GetStats().ResidentBytes == residency.GetStats().TailBytes, "only the tails are resident");
+}
+
+static void TestTrim()
+{
+	// Room for mip 1 of one texture and the tail of another
+	const DDSMipLayout layout = MakeLayout(256);
+	ResidencySettings settings;
+	settings.BudgetBytes = layout.GetBytes(1) + layout.GetBytes(2);
+	TextureResidency residency(settings);
+	UINT a = RegisterLoaded(residency, 256);
+	UINT b = RegisterLoaded(residency, 256);
+
+	std::vector<ResidencyRequest> requests;
+	residency.NoteUse(a, 200.0f);
+	RunFrame(residency, requests);
+	Check(residency.GetResidentMip(a) == 1, "a refined");
+
+	// a moves away and b comes close, a gives its finer mip back though it is still in use
+	residency.NoteUse(a, 10.0f);
+	residency.NoteUse(b, 200.0f);
+	residency.Update(requests);
+	Check(requests.size() == 2 && requests[0].Id == a && requests[0].TopMip == 2, "a is reloaded with the mips it needs");
+	Check(requests[1].Id == b && requests[1].TopMip == 1, "b gets the room");
+	Check(residency.GetStats().Trims == 1 && residency.GetStats().Evictions == 0, "trimmed, not evicted");
+	Check(residency.GetStats().CommittedBytes == settings.BudgetBytes, "pending loads are committed");
+	residency.OnLoaded(a, 2);
+	residency.OnLoaded(b, 1);
+	Check(residency.GetStats().ResidentBytes == settings.BudgetBytes, "resident once the loads finish");
+}
+
+int main()
+{
+	TestRefinement();
+	TestLoadOrder();
+	TestEviction();
+	TestTailFloor();
+	TestTrim();
+
+	if (g_failures)
+		return 1;
+	printf("All checks passed\n");
+	return 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Stand-in for the precompiled header of MetroGame, found first when engine sources are built
+// into the test programs. Desktop headers only, nothing of C++/CX. Off Windows only the
+// standard library and the integer names the portable sources use are available.
+
+#ifdef _WIN32
+#include <windows.h>
+#include <wrl/client.h>
+#include <d3d11_1.h>
+#include <DirectXMath.h>
+#else
+#include <cstdint>
+typedef uint8_t BYTE;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT;
+typedef uint64_t UINT64;
+#endif
+
+#include <cassert>
+#include <memory>
+#include <vector>
+
+// The engine sources all open the namespace of the framework
+namespace DX {}
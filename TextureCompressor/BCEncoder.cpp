@@ -0,0 +1,669 @@
+#include "BCEncoder.h"
+#include <xmmintrin.h>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	typedef float Block[16][4];
+
+	const int BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	float Clamp255(float v)
+	{
+		return v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v);
+	}
+
+	// Palette with its channels stored apart, padded to a multiple of 4 entries.
+	struct Palette
+	{
+		alignas(16) float R[16];
+		alignas(16) float G[16];
+		alignas(16) float B[16];
+		alignas(16) float A[16];
+		int Count;
+
+		void Set(int i, float r, float g, float b, float a)
+		{
+			R[i] = r;
+			G[i] = g;
+			B[i] = b;
+			A[i] = a;
+		}
+	};
+
+	// Closest palette entry to texel, four entries per step. Returns the squared error.
+	float FindClosest(const Palette& palette, const float texel[4], int& index)
+	{
+		__m128 tr = _mm_set1_ps(texel[0]);
+		__m128 tg = _mm_set1_ps(texel[1]);
+		__m128 tb = _mm_set1_ps(texel[2]);
+		__m128 ta = _mm_set1_ps(texel[3]);
+		__m128 best = _mm_set1_ps(FLT_MAX);
+		__m128 bestIndex = _mm_setzero_ps();
+		__m128 step = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+		for (int i = 0; i < palette.Count; i += 4)
+		{
+			__m128 dr = _mm_sub_ps(_mm_load_ps(palette.R + i), tr);
+			__m128 dg = _mm_sub_ps(_mm_load_ps(palette.G + i), tg);
+			__m128 db = _mm_sub_ps(_mm_load_ps(palette.B + i), tb);
+			__m128 da = _mm_sub_ps(_mm_load_ps(palette.A + i), ta);
+			__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_add_ps(_mm_mul_ps(db, db), _mm_mul_ps(da, da)));
+			__m128 less = _mm_cmplt_ps(d, best);
+			__m128 indices = _mm_add_ps(_mm_set1_ps((float)i), step);
+			best = _mm_min_ps(d, best);
+			bestIndex = _mm_or_ps(_mm_and_ps(less, indices), _mm_andnot_ps(less, bestIndex));
+		}
+
+		alignas(16) float errors[4];
+		alignas(16) float lanes[4];
+		_mm_store_ps(errors, best);
+		_mm_store_ps(lanes, bestIndex);
+		int lane = 0;
+		for (int i = 1; i < 4; ++i)
+		{
+			if (errors[i] < errors[lane] || (errors[i] == errors[lane] && lanes[i] < lanes[lane]))
+				lane = i;
+		}
+		index = (int)lanes[lane];
+		return errors[lane];
+	}
+
+	// Endpoints at the extremes of the block along its principal axis, over the first channels.
+	void FitPrincipalAxis(const Block& texels, int channels, float e0[4], float e1[4])
+	{
+		float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float low[4] = { 255.0f, 255.0f, 255.0f, 255.0f };
+		float high[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = 0; c < channels; ++c)
+			{
+				mean[c] += texels[i][c] / 16.0f;
+				low[c] = min(low[c], texels[i][c]);
+				high[c] = max(high[c], texels[i][c]);
+			}
+		}
+
+		float covariance[4][4] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int a = 0; a < channels; ++a)
+				for (int b = 0; b < channels; ++b)
+					covariance[a][b] += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+		}
+
+		// Power iteration from the bounding box diagonal
+		float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int c = 0; c < channels; ++c)
+			axis[c] = high[c] - low[c];
+		for (int iteration = 0; iteration < 8; ++iteration)
+		{
+			float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float length = 0.0f;
+			for (int a = 0; a < channels; ++a)
+			{
+				for (int b = 0; b < channels; ++b)
+					next[a] += covariance[a][b] * axis[b];
+				length = max(length, fabsf(next[a]));
+			}
+			if (length == 0.0f)
+				break;
+			for (int c = 0; c < channels; ++c)
+				axis[c] = next[c] / length;
+		}
+
+		float length = 0.0f;
+		for (int c = 0; c < channels; ++c)
+			length += axis[c] * axis[c];
+		for (int c = 0; c < 4; ++c)
+		{
+			e0[c] = mean[c];
+			e1[c] = mean[c];
+		}
+		if (length == 0.0f)
+			return;
+		length = sqrtf(length);
+
+		float tMin = FLT_MAX;
+		float tMax = -FLT_MAX;
+		for (int i = 0; i < 16; ++i)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < channels; ++c)
+				t += (texels[i][c] - mean[c]) * axis[c] / length;
+			tMin = min(tMin, t);
+			tMax = max(tMax, t);
+		}
+		for (int c = 0; c < channels; ++c)
+		{
+			e0[c] = Clamp255(mean[c] + axis[c] / length * tMax);
+			e1[c] = Clamp255(mean[c] + axis[c] / length * tMin);
+		}
+	}
+
+	// Endpoints that minimize the squared error for fixed interpolation weights, the weight
+	// of texel i being its fraction of e1. Returns false for a singular system.
+	bool LeastSquares(const Block& texels, int channels, const float weights[16], float e0[4], float e1[4])
+	{
+		float a = 0.0f, b = 0.0f, c = 0.0f;
+		float rhs0[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float rhs1[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; ++i)
+		{
+			float w1 = weights[i];
+			float w0 = 1.0f - w1;
+			a += w0 * w0;
+			b += w0 * w1;
+			c += w1 * w1;
+			for (int ch = 0; ch < channels; ++ch)
+			{
+				rhs0[ch] += w0 * texels[i][ch];
+				rhs1[ch] += w1 * texels[i][ch];
+			}
+		}
+		float det = a * c - b * b;
+		if (fabsf(det) < 1e-6f)
+			return false;
+		for (int ch = 0; ch < channels; ++ch)
+		{
+			e0[ch] = Clamp255((c * rhs0[ch] - b * rhs1[ch]) / det);
+			e1[ch] = Clamp255((a * rhs1[ch] - b * rhs0[ch]) / det);
+		}
+		return true;
+	}
+
+	void Write16(uint8_t* out, uint16_t v)
+	{
+		out[0] = (uint8_t)(v & 0xff);
+		out[1] = (uint8_t)(v >> 8);
+	}
+
+	uint16_t Read16(const uint8_t* in)
+	{
+		return (uint16_t)(in[0] | (in[1] << 8));
+	}
+
+#pragma region BC1
+	uint16_t To565(const float c[4])
+	{
+		int r = (int)(Clamp255(c[0]) * 31.0f / 255.0f + 0.5f);
+		int g = (int)(Clamp255(c[1]) * 63.0f / 255.0f + 0.5f);
+		int b = (int)(Clamp255(c[2]) * 31.0f / 255.0f + 0.5f);
+		return (uint16_t)((r << 11) | (g << 5) | b);
+	}
+
+	void From565(uint16_t v, int c[3])
+	{
+		int r = v >> 11;
+		int g = (v >> 5) & 63;
+		int b = v & 31;
+		c[0] = (r << 3) | (r >> 2);
+		c[1] = (g << 2) | (g >> 4);
+		c[2] = (b << 3) | (b >> 2);
+	}
+
+	float AssignColor(const Block& texels, uint16_t q0, uint16_t q1, uint32_t& indices)
+	{
+		int c0[3], c1[3];
+		From565(q0, c0);
+		From565(q1, c1);
+		Palette palette = {};
+		palette.Count = 4;
+		palette.Set(0, (float)c0[0], (float)c0[1], (float)c0[2], 0.0f);
+		palette.Set(1, (float)c1[0], (float)c1[1], (float)c1[2], 0.0f);
+		palette.Set(2, (2 * c0[0] + c1[0]) / 3.0f, (2 * c0[1] + c1[1]) / 3.0f, (2 * c0[2] + c1[2]) / 3.0f, 0.0f);
+		palette.Set(3, (c0[0] + 2 * c1[0]) / 3.0f, (c0[1] + 2 * c1[1]) / 3.0f, (c0[2] + 2 * c1[2]) / 3.0f, 0.0f);
+
+		float error = 0.0f;
+		indices = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			float texel[4] = { texels[i][0], texels[i][1], texels[i][2], 0.0f };
+			int index;
+			error += FindClosest(palette, texel, index);
+			if (q0 == q1)
+				index = 0;
+			indices |= (uint32_t)index << (2 * i);
+		}
+		return error;
+	}
+
+	// Always four color mode, which is what BC3 decoders assume.
+	void EncodeColorBlock(const Block& texels, uint8_t* out)
+	{
+		static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+		float e0[4], e1[4];
+		FitPrincipalAxis(texels, 3, e0, e1);
+		uint16_t c0 = 0, c1 = 0;
+		uint32_t indices = 0;
+		float bestError = FLT_MAX;
+		for (int iteration = 0; iteration < 2; ++iteration)
+		{
+			uint16_t q0 = To565(e0);
+			uint16_t q1 = To565(e1);
+			uint32_t candidate;
+			float error = AssignColor(texels, q0, q1, candidate);
+			if (error < bestError)
+			{
+				bestError = error;
+				c0 = q0;
+				c1 = q1;
+				indices = candidate;
+			}
+
+			float w[16];
+			for (int i = 0; i < 16; ++i)
+				w[i] = weights[(candidate >> (2 * i)) & 3];
+			if (!LeastSquares(texels, 3, w, e0, e1))
+				break;
+		}
+
+		// Four color mode needs c0 > c1, swapping the endpoints swaps indices 0/1 and 2/3
+		if (c0 < c1)
+		{
+			swap(c0, c1);
+			indices ^= 0x55555555;
+		}
+		else if (c0 == c1)
+		{
+			indices = 0;
+		}
+		Write16(out, c0);
+		Write16(out + 2, c1);
+		for (int i = 0; i < 4; ++i)
+			out[4 + i] = (uint8_t)(indices >> (8 * i));
+	}
+
+	void DecodeColorBlock(const uint8_t* in, uint8_t texels[64], bool alwaysFourColors)
+	{
+		uint16_t q0 = Read16(in);
+		uint16_t q1 = Read16(in + 2);
+		int c[4][4];
+		From565(q0, c[0]);
+		From565(q1, c[1]);
+		c[0][3] = c[1][3] = c[2][3] = c[3][3] = 255;
+		for (int ch = 0; ch < 3; ++ch)
+		{
+			if (q0 > q1 || alwaysFourColors)
+			{
+				c[2][ch] = (2 * c[0][ch] + c[1][ch]) / 3;
+				c[3][ch] = (c[0][ch] + 2 * c[1][ch]) / 3;
+			}
+			else
+			{
+				c[2][ch] = (c[0][ch] + c[1][ch]) / 2;
+				c[3][ch] = 0;
+			}
+		}
+		if (!(q0 > q1 || alwaysFourColors))
+			c[3][3] = 0;
+
+		uint32_t indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((uint32_t)in[7] << 24);
+		for (int i = 0; i < 16; ++i)
+		{
+			int index = (indices >> (2 * i)) & 3;
+			for (int ch = 0; ch < 4; ++ch)
+				texels[i * 4 + ch] = (uint8_t)c[index][ch];
+		}
+	}
+#pragma endregion
+
+#pragma region BC4
+	// One channel block, used for BC3 alpha and both BC5 channels.
+	void EncodeChannelBlock(const Block& texels, int channel, uint8_t* out)
+	{
+		float low = 255.0f;
+		float high = 0.0f;
+		for (int i = 0; i < 16; ++i)
+		{
+			low = min(low, texels[i][channel]);
+			high = max(high, texels[i][channel]);
+		}
+		int a0 = (int)(high + 0.5f);
+		int a1 = (int)(low + 0.5f);
+		out[0] = (uint8_t)a0;
+		out[1] = (uint8_t)a1;
+		memset(out + 2, 0, 6);
+		if (a0 == a1)
+			return;
+
+		// Eight value mode, a0 > a1
+		Palette palette = {};
+		palette.Count = 8;
+		palette.R[0] = (float)a0;
+		palette.R[1] = (float)a1;
+		for (int i = 2; i < 8; ++i)
+			palette.R[i] = (float)(((8 - i) * a0 + (i - 1) * a1) / 7);
+
+		uint64_t indices = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			float texel[4] = { texels[i][channel], 0.0f, 0.0f, 0.0f };
+			int index;
+			FindClosest(palette, texel, index);
+			indices |= (uint64_t)index << (3 * i);
+		}
+		for (int i = 0; i < 6; ++i)
+			out[2 + i] = (uint8_t)(indices >> (8 * i));
+	}
+
+	void DecodeChannelBlock(const uint8_t* in, uint8_t texels[64], int channel)
+	{
+		int a[8];
+		a[0] = in[0];
+		a[1] = in[1];
+		if (a[0] > a[1])
+		{
+			for (int i = 2; i < 8; ++i)
+				a[i] = ((8 - i) * a[0] + (i - 1) * a[1]) / 7;
+		}
+		else
+		{
+			for (int i = 2; i < 6; ++i)
+				a[i] = ((6 - i) * a[0] + (i - 1) * a[1]) / 5;
+			a[6] = 0;
+			a[7] = 255;
+		}
+
+		uint64_t indices = 0;
+		for (int i = 0; i < 6; ++i)
+			indices |= (uint64_t)in[2 + i] << (8 * i);
+		for (int i = 0; i < 16; ++i)
+			texels[i * 4 + channel] = (uint8_t)a[(indices >> (3 * i)) & 7];
+	}
+#pragma endregion
+
+#pragma region BC7
+	struct BitWriter
+	{
+		uint8_t* Out;
+		int Position;
+
+		void Write(uint32_t value, int bits)
+		{
+			for (int i = 0; i < bits; ++i, ++Position)
+			{
+				if (value & (1u << i))
+					Out[Position >> 3] |= (uint8_t)(1 << (Position & 7));
+			}
+		}
+	};
+
+	struct BitReader
+	{
+		const uint8_t* In;
+		int Position;
+
+		uint32_t Read(int bits)
+		{
+			uint32_t value = 0;
+			for (int i = 0; i < bits; ++i, ++Position)
+				value |= (uint32_t)((In[Position >> 3] >> (Position & 7)) & 1) << i;
+			return value;
+		}
+	};
+
+	// 7 bit endpoint and the shared bit closest to e.
+	void QuantizeEndpoint(const float e[4], int q[4], int& p)
+	{
+		float bestError = FLT_MAX;
+		for (int bit = 0; bit < 2; ++bit)
+		{
+			int candidate[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; ++c)
+			{
+				int v = (int)((Clamp255(e[c]) - bit) / 2.0f + 0.5f);
+				candidate[c] = v < 0 ? 0 : (v > 127 ? 127 : v);
+				float d = (float)(candidate[c] * 2 + bit) - e[c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				p = bit;
+				memcpy(q, candidate, sizeof(candidate));
+			}
+		}
+	}
+
+	float AssignBC7(const Block& texels, const int q0[4], int p0, const int q1[4], int p1, int indices[16])
+	{
+		Palette palette;
+		palette.Count = 16;
+		for (int i = 0; i < 16; ++i)
+		{
+			float v[4];
+			for (int c = 0; c < 4; ++c)
+			{
+				int a = q0[c] * 2 + p0;
+				int b = q1[c] * 2 + p1;
+				v[c] = (float)(((64 - BC7Weights[i]) * a + BC7Weights[i] * b + 32) >> 6);
+			}
+			palette.Set(i, v[0], v[1], v[2], v[3]);
+		}
+		float error = 0.0f;
+		for (int i = 0; i < 16; ++i)
+			error += FindClosest(palette, texels[i], indices[i]);
+		return error;
+	}
+
+	void EncodeBC7Block(const Block& texels, uint8_t* out)
+	{
+		float e0[4], e1[4];
+		FitPrincipalAxis(texels, 4, e0, e1);
+
+		int q0[4] = {}, q1[4] = {}, p0 = 0, p1 = 0, indices[16] = {};
+		float bestError = FLT_MAX;
+		for (int iteration = 0; iteration < 3; ++iteration)
+		{
+			int c0[4], c1[4], b0, b1, candidate[16];
+			QuantizeEndpoint(e0, c0, b0);
+			QuantizeEndpoint(e1, c1, b1);
+			float error = AssignBC7(texels, c0, b0, c1, b1, candidate);
+			if (error < bestError)
+			{
+				bestError = error;
+				memcpy(q0, c0, sizeof(q0));
+				memcpy(q1, c1, sizeof(q1));
+				p0 = b0;
+				p1 = b1;
+				memcpy(indices, candidate, sizeof(indices));
+			}
+
+			float w[16];
+			for (int i = 0; i < 16; ++i)
+				w[i] = BC7Weights[candidate[i]] / 64.0f;
+			if (!LeastSquares(texels, 4, w, e0, e1))
+				break;
+		}
+
+		// The anchor texel has no index MSB, swap the endpoints when it would be set
+		if (indices[0] >= 8)
+		{
+			for (int c = 0; c < 4; ++c)
+				swap(q0[c], q1[c]);
+			swap(p0, p1);
+			for (int i = 0; i < 16; ++i)
+				indices[i] = 15 - indices[i];
+		}
+
+		memset(out, 0, 16);
+		BitWriter writer = { out, 0 };
+		writer.Write(1 << 6, 7);
+		for (int c = 0; c < 4; ++c)
+		{
+			writer.Write(q0[c], 7);
+			writer.Write(q1[c], 7);
+		}
+		writer.Write(p0, 1);
+		writer.Write(p1, 1);
+		writer.Write(indices[0], 3);
+		for (int i = 1; i < 16; ++i)
+			writer.Write(indices[i], 4);
+	}
+
+	void DecodeBC7Block(const uint8_t* in, uint8_t texels[64])
+	{
+		BitReader reader = { in, 0 };
+		if (reader.Read(7) != (1 << 6))
+		{
+			for (int i = 0; i < 16; ++i)
+			{
+				texels[i * 4 + 0] = 255;
+				texels[i * 4 + 1] = 0;
+				texels[i * 4 + 2] = 255;
+				texels[i * 4 + 3] = 255;
+			}
+			return;
+		}
+
+		int q[2][4];
+		for (int c = 0; c < 4; ++c)
+		{
+			q[0][c] = reader.Read(7);
+			q[1][c] = reader.Read(7);
+		}
+		int p0 = reader.Read(1);
+		int p1 = reader.Read(1);
+		for (int i = 0; i < 16; ++i)
+		{
+			int index = reader.Read(i == 0 ? 3 : 4);
+			for (int c = 0; c < 4; ++c)
+			{
+				int a = q[0][c] * 2 + p0;
+				int b = q[1][c] * 2 + p1;
+				texels[i * 4 + c] = (uint8_t)(((64 - BC7Weights[index]) * a + BC7Weights[index] * b + 32) >> 6);
+			}
+		}
+	}
+#pragma endregion
+
+	void LoadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, uint8_t texels[64])
+	{
+		for (uint32_t y = 0; y < 4; ++y)
+		{
+			uint32_t sy = min(by * 4 + y, height - 1);
+			for (uint32_t x = 0; x < 4; ++x)
+			{
+				uint32_t sx = min(bx * 4 + x, width - 1);
+				memcpy(&texels[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+			}
+		}
+	}
+}
+
+size_t BC::GetBlockBytes(Format format)
+{
+	return format == Format::BC1 ? 8 : 16;
+}
+
+void BC::EncodeBlock(Format format, const uint8_t texels[64], uint8_t* block)
+{
+	Block t;
+	for (int i = 0; i < 16; ++i)
+		for (int c = 0; c < 4; ++c)
+			t[i][c] = texels[i * 4 + c];
+
+	switch (format)
+	{
+	case Format::BC1:
+		EncodeColorBlock(t, block);
+		break;
+	case Format::BC3:
+		EncodeChannelBlock(t, 3, block);
+		EncodeColorBlock(t, block + 8);
+		break;
+	case Format::BC5:
+		EncodeChannelBlock(t, 0, block);
+		EncodeChannelBlock(t, 1, block + 8);
+		break;
+	case Format::BC7:
+		EncodeBC7Block(t, block);
+		break;
+	}
+}
+
+void BC::DecodeBlock(Format format, const uint8_t* block, uint8_t texels[64])
+{
+	switch (format)
+	{
+	case Format::BC1:
+		DecodeColorBlock(block, texels, false);
+		break;
+	case Format::BC3:
+		DecodeColorBlock(block + 8, texels, true);
+		DecodeChannelBlock(block, texels, 3);
+		break;
+	case Format::BC5:
+		for (int i = 0; i < 16; ++i)
+		{
+			texels[i * 4 + 2] = 0;
+			texels[i * 4 + 3] = 255;
+		}
+		DecodeChannelBlock(block, texels, 0);
+		DecodeChannelBlock(block + 8, texels, 1);
+		break;
+	case Format::BC7:
+		DecodeBC7Block(block, texels);
+		break;
+	}
+}
+
+void BC::EncodeImage(Format format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks, unsigned threads)
+{
+	uint32_t blocksX = max(1u, (width + 3) / 4);
+	uint32_t blocksY = max(1u, (height + 3) / 4);
+	size_t blockBytes = GetBlockBytes(format);
+	if (threads == 0)
+		threads = max(1u, thread::hardware_concurrency());
+	threads = min(threads, blocksY);
+
+	// Workers take the next block row until none is left
+	atomic<uint32_t> nextRow(0);
+	auto work = [&]()
+	{
+		uint8_t texels[64];
+		for (uint32_t by = nextRow++; by < blocksY; by = nextRow++)
+		{
+			for (uint32_t bx = 0; bx < blocksX; ++bx)
+			{
+				LoadBlock(rgba, width, height, bx, by, texels);
+				EncodeBlock(format, texels, blocks + ((size_t)by * blocksX + bx) * blockBytes);
+			}
+		}
+	};
+	vector<thread> workers;
+	for (unsigned i = 1; i < threads; ++i)
+		workers.emplace_back(work);
+	work();
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void BC::DecodeImage(Format format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba)
+{
+	uint32_t blocksX = max(1u, (width + 3) / 4);
+	uint32_t blocksY = max(1u, (height + 3) / 4);
+	size_t blockBytes = GetBlockBytes(format);
+	uint8_t texels[64];
+	for (uint32_t by = 0; by < blocksY; ++by)
+	{
+		for (uint32_t bx = 0; bx < blocksX; ++bx)
+		{
+			DecodeBlock(format, blocks + ((size_t)by * blocksX + bx) * blockBytes, texels);
+			for (uint32_t y = 0; y < 4 && by * 4 + y < height; ++y)
+				for (uint32_t x = 0; x < 4 && bx * 4 + x < width; ++x)
+					memcpy(&rgba[((size_t)(by * 4 + y) * width + bx * 4 + x) * 4], &texels[(y * 4 + x) * 4], 4);
+		}
+	}
+}
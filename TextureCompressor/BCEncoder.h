@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Block compression of RGBA8 images into the BC formats the engine samples:
+//   BC1  RGB, 8 bytes per 4x4 block
+//   BC3  RGBA, the BC1 color block plus an 8 byte alpha block
+//   BC5  Two channel (red and green), for tangent space normal maps
+//   BC7  RGBA in mode 6 only: one subset, 7 bit endpoints with a shared bit, 4 bit indices
+// Endpoints come from the principal axis of each block and are refined by least squares.
+// Index search measures four palette entries per SSE instruction. Images are encoded by one
+// worker per hardware thread, a block row at a time.
+
+namespace BC
+{
+	enum class Format
+	{
+		BC1,
+		BC3,
+		BC5,
+		BC7
+	};
+
+	size_t GetBlockBytes(Format format);
+
+	// texels holds 16 RGBA8 texels, row by row.
+	void EncodeBlock(Format format, const uint8_t texels[64], uint8_t* block);
+	// BC7 blocks of other modes than 6 decode to magenta.
+	void DecodeBlock(Format format, const uint8_t* block, uint8_t texels[64]);
+
+	// Blocks are written row by row. Edge blocks of images whose size is not a multiple of 4
+	// repeat the last row and column. threads 0 uses every hardware thread.
+	void EncodeImage(Format format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks, unsigned threads = 0);
+	void DecodeImage(Format format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba);
+}
@@ -0,0 +1,324 @@
+#define NOMINMAX
+#include <windows.h>
+#include <wincodec.h>
+#include <wrl/client.h>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "BCEncoder.h"
+
+#pragma comment(lib, "windowscodecs.lib")
+
+using namespace std;
+using Microsoft::WRL::ComPtr;
+
+#pragma pack(push, 1)
+struct DDSPixelFormat
+{
+	uint32_t Size;
+	uint32_t Flags;
+	uint32_t FourCC;
+	uint32_t RGBBitCount;
+	uint32_t RBitMask;
+	uint32_t GBitMask;
+	uint32_t BBitMask;
+	uint32_t ABitMask;
+};
+
+struct DDSHeader
+{
+	uint32_t Size;
+	uint32_t Flags;
+	uint32_t Height;
+	uint32_t Width;
+	uint32_t PitchOrLinearSize;
+	uint32_t Depth;
+	uint32_t MipMapCount;
+	uint32_t Reserved1[11];
+	DDSPixelFormat PixelFormat;
+	uint32_t Caps;
+	uint32_t Caps2;
+	uint32_t Caps3;
+	uint32_t Caps4;
+	uint32_t Reserved2;
+};
+
+struct DDSHeaderDX10
+{
+	uint32_t DXGIFormat;
+	uint32_t ResourceDimension;
+	uint32_t MiscFlag;
+	uint32_t ArraySize;
+	uint32_t MiscFlags2;
+};
+#pragma pack(pop)
+
+const uint32_t DDSMagic = 0x20534444;	// "DDS "
+const uint32_t DDSD_CAPS = 0x1;
+const uint32_t DDSD_HEIGHT = 0x2;
+const uint32_t DDSD_WIDTH = 0x4;
+const uint32_t DDSD_PIXELFORMAT = 0x1000;
+const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+const uint32_t DDSD_LINEARSIZE = 0x80000;
+const uint32_t DDPF_FOURCC = 0x4;
+const uint32_t DDSCAPS_COMPLEX = 0x8;
+const uint32_t DDSCAPS_TEXTURE = 0x1000;
+const uint32_t DDSCAPS_MIPMAP = 0x400000;
+const uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+
+// DXGI_FORMAT values
+const uint32_t FormatBC1 = 71;
+const uint32_t FormatBC1Srgb = 72;
+const uint32_t FormatBC3 = 77;
+const uint32_t FormatBC3Srgb = 78;
+const uint32_t FormatBC5 = 83;
+const uint32_t FormatBC7 = 98;
+const uint32_t FormatBC7Srgb = 99;
+
+struct Level
+{
+	uint32_t Width;
+	uint32_t Height;
+	vector<uint8_t> Pixels;
+	vector<uint8_t> Blocks;
+};
+
+uint32_t MakeFourCC(char a, char b, char c, char d)
+{
+	return (uint32_t)(uint8_t)a | ((uint32_t)(uint8_t)b << 8) | ((uint32_t)(uint8_t)c << 16) | ((uint32_t)(uint8_t)d << 24);
+}
+
+bool LoadImageRGBA(const wstring& filename, Level& level)
+{
+	ComPtr<IWICImagingFactory> factory;
+	ComPtr<IWICBitmapDecoder> decoder;
+	ComPtr<IWICBitmapFrameDecode> frame;
+	ComPtr<IWICFormatConverter> converter;
+	if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))))
+		return false;
+	if (FAILED(factory->CreateDecoderFromFilename(filename.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder)))
+		return false;
+	if (FAILED(decoder->GetFrame(0, &frame)) || FAILED(factory->CreateFormatConverter(&converter)))
+		return false;
+	if (FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom)))
+		return false;
+	if (FAILED(converter->GetSize(&level.Width, &level.Height)))
+		return false;
+	level.Pixels.resize((size_t)level.Width * level.Height * 4);
+	return SUCCEEDED(converter->CopyPixels(nullptr, level.Width * 4, (UINT)level.Pixels.size(), level.Pixels.data()));
+}
+
+float SrgbToLinear(float v)
+{
+	return v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+}
+
+float LinearToSrgb(float v)
+{
+	return v <= 0.0031308f ? v * 12.92f : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+}
+
+// 2x2 box filter, color channels averaged in linear space when srgb is set.
+void Downsample(const Level& src, Level& dst, bool srgb)
+{
+	static float toLinear[256];
+	static bool initialized = [&]()
+	{
+		for (int i = 0; i < 256; ++i)
+			toLinear[i] = SrgbToLinear(i / 255.0f);
+		return true;
+	}();
+
+	dst.Width = max(src.Width / 2, 1u);
+	dst.Height = max(src.Height / 2, 1u);
+	dst.Pixels.resize((size_t)dst.Width * dst.Height * 4);
+	for (uint32_t y = 0; y < dst.Height; ++y)
+	{
+		for (uint32_t x = 0; x < dst.Width; ++x)
+		{
+			const uint8_t* texels[4] =
+			{
+				&src.Pixels[((size_t)min(2 * y, src.Height - 1) * src.Width + min(2 * x, src.Width - 1)) * 4],
+				&src.Pixels[((size_t)min(2 * y, src.Height - 1) * src.Width + min(2 * x + 1, src.Width - 1)) * 4],
+				&src.Pixels[((size_t)min(2 * y + 1, src.Height - 1) * src.Width + min(2 * x, src.Width - 1)) * 4],
+				&src.Pixels[((size_t)min(2 * y + 1, src.Height - 1) * src.Width + min(2 * x + 1, src.Width - 1)) * 4]
+			};
+			uint8_t* out = &dst.Pixels[((size_t)y * dst.Width + x) * 4];
+			for (int c = 0; c < 4; ++c)
+			{
+				float sum = 0.0f;
+				for (int i = 0; i < 4; ++i)
+					sum += (srgb && c < 3) ? toLinear[texels[i][c]] : texels[i][c] / 255.0f;
+				float v = sum * 0.25f;
+				if (srgb && c < 3)
+					v = LinearToSrgb(v);
+				out[c] = (uint8_t)(min(max(v, 0.0f), 1.0f) * 255.0f + 0.5f);
+			}
+		}
+	}
+}
+
+// PSNR over the channels the format stores.
+double ComputePSNR(BC::Format format, const Level& level)
+{
+	vector<uint8_t> decoded(level.Pixels.size());
+	BC::DecodeImage(format, level.Blocks.data(), level.Width, level.Height, decoded.data());
+	int channels = format == BC::Format::BC5 ? 2 : (format == BC::Format::BC1 ? 3 : 4);
+	double error = 0.0;
+	for (size_t i = 0; i < level.Pixels.size(); i += 4)
+	{
+		for (int c = 0; c < channels; ++c)
+		{
+			double d = (double)level.Pixels[i + c] - decoded[i + c];
+			error += d * d;
+		}
+	}
+	double mse = error / ((double)level.Width * level.Height * channels);
+	return mse == 0.0 ? 99.99 : 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+bool WriteDDS(const wstring& filename, BC::Format format, bool srgb, const vector<Level>& levels)
+{
+	DDSHeader header = {};
+	header.Size = sizeof(DDSHeader);
+	header.Flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
+	header.Height = levels[0].Height;
+	header.Width = levels[0].Width;
+	header.PitchOrLinearSize = (uint32_t)levels[0].Blocks.size();
+	header.MipMapCount = (uint32_t)levels.size();
+	header.PixelFormat.Size = sizeof(DDSPixelFormat);
+	header.PixelFormat.Flags = DDPF_FOURCC;
+	header.Caps = DDSCAPS_TEXTURE;
+	if (levels.size() > 1)
+	{
+		header.Flags |= DDSD_MIPMAPCOUNT;
+		header.Caps |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+	}
+
+	// Legacy FourCC where one exists, the DX10 extension otherwise
+	DDSHeaderDX10 dx10 = {};
+	dx10.ResourceDimension = D3D10_RESOURCE_DIMENSION_TEXTURE2D;
+	dx10.ArraySize = 1;
+	if (format == BC::Format::BC1 && !srgb)
+		header.PixelFormat.FourCC = MakeFourCC('D', 'X', 'T', '1');
+	else if (format == BC::Format::BC3 && !srgb)
+		header.PixelFormat.FourCC = MakeFourCC('D', 'X', 'T', '5');
+	else
+	{
+		header.PixelFormat.FourCC = MakeFourCC('D', 'X', '1', '0');
+		switch (format)
+		{
+		case BC::Format::BC1: dx10.DXGIFormat = FormatBC1Srgb; break;
+		case BC::Format::BC3: dx10.DXGIFormat = FormatBC3Srgb; break;
+		case BC::Format::BC5: dx10.DXGIFormat = FormatBC5; break;
+		case BC::Format::BC7: dx10.DXGIFormat = srgb ? FormatBC7Srgb : FormatBC7; break;
+		}
+	}
+
+	ofstream fout(filename, ios::binary);
+	if (!fout)
+		return false;
+	fout.write((const char*)&DDSMagic, sizeof(DDSMagic));
+	fout.write((const char*)&header, sizeof(header));
+	if (dx10.DXGIFormat != 0)
+		fout.write((const char*)&dx10, sizeof(dx10));
+	for (auto& level : levels)
+		fout.write((const char*)level.Blocks.data(), level.Blocks.size());
+	return fout.good();
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	if (argc < 3)
+	{
+		wcout << L"Usage: TextureCompressor <input image> <output dds> [-bc1|-bc3|-bc5|-bc7] [-srgb] [-linear] [-nomips]" << endl;
+		wcout << L"BC7 is the default. Use -bc7 -linear for normal maps, -srgb to write an sRGB format." << endl;
+		return -1;
+	}
+
+	wstring input = argv[1];
+	wstring output = argv[2];
+	BC::Format format = BC::Format::BC7;
+	bool srgb = false;
+	bool linear = false;
+	bool mips = true;
+	for (int i = 3; i < argc; ++i)
+	{
+		wstring option = argv[i];
+		if (option == L"-bc1")
+			format = BC::Format::BC1;
+		else if (option == L"-bc3")
+			format = BC::Format::BC3;
+		else if (option == L"-bc5")
+			format = BC::Format::BC5;
+		else if (option == L"-bc7")
+			format = BC::Format::BC7;
+		else if (option == L"-srgb")
+			srgb = true;
+		else if (option == L"-linear")
+			linear = true;
+		else if (option == L"-nomips")
+			mips = false;
+		else
+		{
+			wcout << L"Unknown option " << option << endl;
+			return -1;
+		}
+	}
+	// BC5 has no sRGB format and normal maps are filtered as plain vectors
+	if (format == BC::Format::BC5)
+	{
+		srgb = false;
+		linear = true;
+		cout << "BC5 keeps x and y only. The engine shaders read z and the height from the normal map, use -bc7 -linear for them." << endl;
+	}
+
+	CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	cout << "Read data ..." << endl;
+	vector<Level> levels(1);
+	if (!LoadImageRGBA(input, levels[0]))
+	{
+		wcout << L"Cannot read " << input << endl;
+		return -1;
+	}
+	if (levels[0].Width % 4 != 0 || levels[0].Height % 4 != 0)
+	{
+		cout << "Width and height must be multiples of 4." << endl;
+		return -1;
+	}
+	while (mips && (levels.back().Width > 1 || levels.back().Height > 1))
+	{
+		Level next;
+		Downsample(levels.back(), next, !linear);
+		levels.push_back(move(next));
+	}
+
+	cout << "Compress data ..." << endl;
+	uint64_t texels = 0;
+	auto start = chrono::steady_clock::now();
+	for (auto& level : levels)
+	{
+		size_t blocks = (size_t)max((level.Width + 3) / 4, 1u) * max((level.Height + 3) / 4, 1u);
+		level.Blocks.resize(blocks * BC::GetBlockBytes(format));
+		BC::EncodeImage(format, level.Pixels.data(), level.Width, level.Height, level.Blocks.data());
+		texels += (uint64_t)level.Width * level.Height;
+	}
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	cout << "Write data ..." << endl;
+	if (!WriteDDS(output, format, srgb, levels))
+	{
+		wcout << L"Cannot write " << output << endl;
+		return -1;
+	}
+
+	cout << "Size: " << levels[0].Width << "x" << levels[0].Height << ", mips: " << levels.size() << endl;
+	cout << "PSNR (mip 0): " << ComputePSNR(format, levels[0]) << " dB" << endl;
+	cout << "Throughput: " << texels / max(seconds, 1e-6) / 1e6 << " MPix/s" << endl;
+
+	CoUninitialize();
+	return 0;
+}